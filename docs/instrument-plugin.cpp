@@ -0,0 +1,29 @@
+/// \file instrument-plugin.cpp
+/// \brief Example instrumentation plugin counting the executed syscalls
+///
+/// Build it as a shared library against the revng headers and the LLVM ones:
+///
+///     c++ -shared -fPIC $(llvm-config --cxxflags) -I$REVNG/include \
+///       instrument-plugin.cpp -o instrument-plugin.so
+///
+/// Then translate a program with it, providing the callbacks through
+/// instrument-runtime.c:
+///
+///     clang -S -emit-llvm -O2 instrument-runtime.c -o instrument-runtime.ll
+///     revng translate --instrument instrument-plugin.so \
+///       --instrument-runtime instrument-runtime.ll program
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/BasicAnalyses/Instrument.h"
+
+class CountSyscalls : public InstrumentationPlugin {
+public:
+  void registerCallbacks(InstrumentationCallbacks &Callbacks) override {
+    Callbacks.onSyscall("count_syscall");
+  }
+};
+
+static RegisterInstrumentation<CountSyscalls> X;
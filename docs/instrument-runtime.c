@@ -0,0 +1,24 @@
+/*
+ * This file is distributed under the MIT License. See LICENSE.md for details.
+ */
+
+// Callbacks of the example instrumentation plugin, see instrument-plugin.cpp
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint64_t syscalls_count = 0;
+
+static void print_syscalls_count(void) {
+  fprintf(stderr, "%" PRIu64 " syscalls\n", syscalls_count);
+}
+
+void count_syscall(uint64_t pc, uint64_t number) {
+  (void) pc;
+  (void) number;
+
+  if (syscalls_count++ == 0)
+    atexit(print_syscalls_count);
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/iterator.h"
+#include "llvm/ADT/iterator_range.h"
+
+#include "revng/Support/Debug.h"
+
+/// \brief Frozen, densely numbered copy of the structure of a GenericGraph
+///
+/// The nodes are stored contiguously and numbered from 0 in the order of the
+/// original graph. Their successors and predecessors are stored in a single
+/// array in compressed sparse row form, so that visits (e.g., depth_first,
+/// scc_iterator and the dominator tree construction) touch as little memory as
+/// possible.
+///
+/// Only the structure of the graph is retained: edge labels are dropped and
+/// each node keeps a pointer to the node it has been built from. Predecessors
+/// are computed from the successors, therefore a graph of ForwardNode can be
+/// visited backwards too.
+///
+/// \note Changes to the original graph are not reflected.
+template<typename OriginalNodeT>
+class CompactGraph {
+public:
+  class Node {
+    friend class CompactGraph;
+
+  public:
+    static constexpr bool is_compact_node = true;
+
+  private:
+    OriginalNodeT *Original = nullptr;
+    CompactGraph *Parent = nullptr;
+    unsigned Index = 0;
+    llvm::ArrayRef<Node *> Successors;
+    llvm::ArrayRef<Node *> Predecessors;
+
+  public:
+    /// \brief The dense number of this node
+    unsigned getIndex() const { return Index; }
+    OriginalNodeT *getOriginal() const { return Original; }
+    CompactGraph *getParent() const { return Parent; }
+
+    llvm::ArrayRef<Node *> successors() const { return Successors; }
+    llvm::ArrayRef<Node *> predecessors() const { return Predecessors; }
+
+  public:
+    // This stuff is needed by the DominatorTree implementation
+    void printAsOperand(llvm::raw_ostream &, bool) const { revng_abort(); }
+  };
+
+  using nodes_iterator = llvm::pointer_iterator<
+    typename std::vector<Node>::iterator>;
+
+private:
+  std::vector<Node> Nodes;
+
+  /// Successors of all the nodes, in order, followed by their predecessors
+  std::vector<Node *> Edges;
+
+  llvm::DenseMap<const OriginalNodeT *, unsigned> Indices;
+  Node *EntryNode = nullptr;
+
+public:
+  template<typename GraphT>
+  explicit CompactGraph(GraphT &Graph) {
+    Nodes.resize(Graph.size());
+    Indices.reserve(Graph.size());
+
+    // Assign the numbers and count the edges
+    unsigned EdgesCount = 0;
+    std::vector<unsigned> PredecessorsCount(Graph.size(), 0);
+    unsigned I = 0;
+    for (OriginalNodeT *Original : Graph.nodes()) {
+      Nodes[I].Original = Original;
+      Nodes[I].Parent = this;
+      Nodes[I].Index = I;
+      Indices[Original] = I;
+      ++I;
+    }
+
+    for (OriginalNodeT *Original : Graph.nodes()) {
+      for (OriginalNodeT *Successor : Original->successors()) {
+        ++EdgesCount;
+        ++PredecessorsCount[indexOf(Successor)];
+      }
+    }
+
+    Edges.resize(2 * EdgesCount);
+
+    // Lay out the successors
+    unsigned Offset = 0;
+    for (Node &N : Nodes) {
+      unsigned Begin = Offset;
+      for (OriginalNodeT *Successor : N.Original->successors())
+        Edges[Offset++] = &Nodes[indexOf(Successor)];
+      N.Successors = llvm::makeArrayRef(Edges).slice(Begin, Offset - Begin);
+    }
+
+    // Lay out the predecessors, transposing the successors
+    std::vector<unsigned> Next(Nodes.size());
+    for (Node &N : Nodes) {
+      unsigned Count = PredecessorsCount[N.Index];
+      Next[N.Index] = Offset;
+      N.Predecessors = llvm::makeArrayRef(Edges).slice(Offset, Count);
+      Offset += Count;
+    }
+    revng_assert(Offset == Edges.size());
+
+    for (Node &N : Nodes)
+      for (Node *Successor : N.Successors)
+        Edges[Next[Successor->Index]++] = &N;
+
+    if constexpr (GraphT::hasEntryNode)
+      if (Graph.getEntryNode() != nullptr)
+        EntryNode = getNode(Graph.getEntryNode());
+  }
+
+  // Nodes point to their parent and to each other
+  CompactGraph(const CompactGraph &) = delete;
+  CompactGraph(CompactGraph &&) = delete;
+  CompactGraph &operator=(const CompactGraph &) = delete;
+  CompactGraph &operator=(CompactGraph &&) = delete;
+
+public:
+  Node *getEntryNode() const { return EntryNode; }
+
+  size_t size() const { return Nodes.size(); }
+
+  /// \brief Obtain the node with dense number \p Index
+  Node *getNodeAt(unsigned Index) {
+    revng_assert(Index < Nodes.size());
+    return &Nodes[Index];
+  }
+
+  /// \brief Obtain the node built from \p Original
+  Node *getNode(const OriginalNodeT *Original) {
+    return &Nodes[indexOf(Original)];
+  }
+
+  llvm::iterator_range<nodes_iterator> nodes() {
+    return llvm::make_range(nodes_iterator(Nodes.begin()),
+                            nodes_iterator(Nodes.end()));
+  }
+
+private:
+  /// \brief The dense number of the node built from \p Original
+  ///
+  /// \note \p Original must be a node of the original graph
+  unsigned indexOf(const OriginalNodeT *Original) const {
+    revng_assert(Original != nullptr);
+    auto It = Indices.find(Original);
+    revng_assert(It != Indices.end());
+    return It->second;
+  }
+};
+
+template<typename GraphT>
+CompactGraph(GraphT &) -> CompactGraph<typename GraphT::Node>;
+
+//
+// GraphTraits implementation for CompactGraph
+//
+namespace llvm {
+
+/// Implement GraphTraits<CompactGraph::Node>
+template<typename T>
+struct GraphTraits<T *, std::enable_if_t<T::is_compact_node>> {
+public:
+  using NodeRef = T *;
+  using ChildIteratorType = T *const *;
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->successors().begin();
+  }
+
+  static ChildIteratorType child_end(NodeRef N) {
+    return N->successors().end();
+  }
+
+  static NodeRef getEntryNode(NodeRef N) { return N; };
+};
+
+/// Implement GraphTraits<Inverse<CompactGraph::Node>>
+template<typename T>
+struct GraphTraits<llvm::Inverse<T *>, std::enable_if_t<T::is_compact_node>> {
+public:
+  using NodeRef = T *;
+  using ChildIteratorType = T *const *;
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->predecessors().begin();
+  }
+
+  static ChildIteratorType child_end(NodeRef N) {
+    return N->predecessors().end();
+  }
+
+  static NodeRef getEntryNode(llvm::Inverse<NodeRef> N) { return N.Graph; };
+};
+
+/// Implement GraphTraits<CompactGraph>
+template<typename T>
+struct GraphTraits<CompactGraph<T> *>
+  : public GraphTraits<typename CompactGraph<T>::Node *> {
+  using NodeRef = typename CompactGraph<T>::Node *;
+  using nodes_iterator = typename CompactGraph<T>::nodes_iterator;
+
+  static NodeRef getEntryNode(CompactGraph<T> *G) { return G->getEntryNode(); }
+
+  static nodes_iterator nodes_begin(CompactGraph<T> *G) {
+    return G->nodes().begin();
+  }
+
+  static nodes_iterator nodes_end(CompactGraph<T> *G) {
+    return G->nodes().end();
+  }
+
+  static size_t size(CompactGraph<T> *G) { return G->size(); }
+};
+
+} // namespace llvm
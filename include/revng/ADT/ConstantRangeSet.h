@@ -134,14 +134,31 @@ public:
 
 public:
   ConstantRangeSet unionWith(const ConstantRangeSet &Other) const {
+    // Fast paths: avoid merging when the result is one of the operands
+    if (Other.isEmptySet() or isFullSet())
+      return withWidthOf(*this, Other);
+    if (isEmptySet() or Other.isFullSet())
+      return withWidthOf(Other, *this);
+
     return merge<false>(Other);
   }
 
   ConstantRangeSet intersectWith(const ConstantRangeSet &Other) const {
+    // Fast paths: avoid merging when the result is one of the operands
+    if (isEmptySet() or Other.isFullSet())
+      return withWidthOf(*this, Other);
+    if (Other.isEmptySet() or isFullSet())
+      return withWidthOf(Other, *this);
+
     return merge<true>(Other);
   }
 
   bool contains(const ConstantRangeSet &Other) const {
+    if (Other.isEmptySet() or isFullSet())
+      return true;
+    if (isEmptySet())
+      return false;
+
     return intersectWith(Other) == Other;
   }
 
@@ -226,6 +243,17 @@ public:
   }
 
 private:
+  /// \brief Return a copy of \p Result with the bit width \p merge would
+  ///        produce combining it with \p Other
+  static ConstantRangeSet withWidthOf(const ConstantRangeSet &Result,
+                                      const ConstantRangeSet &Other) {
+    revng_assert(Result.BitWidth == 0 or Other.BitWidth == 0
+                 or Result.BitWidth == Other.BitWidth);
+    ConstantRangeSet Copy = Result;
+    Copy.BitWidth = std::max(Result.BitWidth, Other.BitWidth);
+    return Copy;
+  }
+
   template<bool And>
   ConstantRangeSet merge(const ConstantRangeSet &Other) const {
     using namespace llvm;
@@ -0,0 +1,75 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "revng/Support/Assert.h"
+
+/// \brief Visited marker for elements with a dense numbering, which can be
+///        cleared in constant time
+///
+/// Each index has a side table entry recording the epoch in which it has been
+/// last inserted: an element is in the set if its entry matches the current
+/// epoch. Clearing the set just starts a new epoch, therefore the same
+/// EpochSet can be reused across many visits of the same graph without paying
+/// for the size of the graph at each visit, and without allocations.
+///
+/// \tparam IndexOf a function object mapping a `T` to a `size_t`.
+template<typename T, typename IndexOf>
+class EpochSet {
+private:
+  using EpochType = uint32_t;
+
+private:
+  std::vector<EpochType> Epochs;
+  EpochType Current = 1;
+  IndexOf Index;
+
+public:
+  /// \param Capacity the expected number of distinct indices, the side table
+  ///        grows on demand anyway.
+  EpochSet(size_t Capacity = 0, IndexOf Index = IndexOf()) :
+    Epochs(Capacity, 0), Index(Index) {}
+
+public:
+  /// \return true if \p Element was not in the set.
+  bool insert(T Element) {
+    size_t I = Index(Element);
+    if (I >= Epochs.size())
+      Epochs.resize(std::max<size_t>(I + 1, 2 * Epochs.size()), 0);
+
+    if (Epochs[I] == Current)
+      return false;
+
+    Epochs[I] = Current;
+    return true;
+  }
+
+  void erase(T Element) {
+    size_t I = Index(Element);
+    if (I < Epochs.size() and Epochs[I] == Current)
+      Epochs[I] = 0;
+  }
+
+  size_t count(T Element) const {
+    size_t I = Index(Element);
+    return (I < Epochs.size() and Epochs[I] == Current) ? 1 : 0;
+  }
+
+  void clear() {
+    // On wrap around, the stale entries could match again, reset them all
+    if (Current == std::numeric_limits<EpochType>::max()) {
+      std::fill(Epochs.begin(), Epochs.end(), 0);
+      Current = 0;
+    }
+
+    ++Current;
+  }
+};
@@ -5,6 +5,7 @@
 //
 
 #include <set>
+#include <tuple>
 
 #include "llvm/Support/YAMLTraits.h"
 
@@ -137,6 +138,90 @@ using enable_if_not_tuple_end_t = std::enable_if_t<I != std::tuple_size_v<T>,
 template<typename T, typename R = void>
 using enable_if_has_tuple_size_t = std::enable_if_t<has_tuple_size_v<T>, R>;
 
+//
+// Key prefixes
+//
+
+namespace detail {
+
+template<size_t I, typename T>
+const auto &keyComponent(const T &Key) {
+  using std::get;
+  return get<I>(Key);
+}
+
+template<typename KeyT, typename PrefixT, typename = void>
+struct is_key_prefix : std::false_type {};
+
+template<typename KeyT, typename... Ts>
+struct is_key_prefix<KeyT,
+                     std::tuple<Ts...>,
+                     std::enable_if_t<has_tuple_size_v<KeyT>>>
+  : std::bool_constant<sizeof...(Ts) <= std::tuple_size_v<KeyT>> {};
+
+} // namespace detail
+
+/// \brief Is \p PrefixT a std::tuple of the first components of \p KeyT?
+///
+/// Keyed object containers accept prefixes of tuple-like keys (std::pair,
+/// std::tuple or classes with INTROSPECTION) in their lookup methods, e.g.,
+/// `CFG.prefix_range(std::tuple(Start))` returns all the basic blocks starting
+/// at Start, without building a key.
+///
+/// \note This requires the container to be sorted by the lexicographic order
+///       of the components of the keys, which is the case for std::pair,
+///       std::tuple and classes comparing a std::tie of their fields, using
+///       the default comparator.
+template<typename KeyT, typename PrefixT>
+constexpr bool is_key_prefix_v = detail::is_key_prefix<std::remove_cv_t<KeyT>,
+                                                       PrefixT>::value;
+
+template<typename KeyT, typename PrefixT, typename R = void>
+using enable_if_is_key_prefix_t = std::enable_if_t<is_key_prefix_v<KeyT,
+                                                                   PrefixT>,
+                                                   R>;
+
+/// \brief Compare the first components of \p Key with \p Prefix
+///
+/// \return a negative value, zero or a positive value if \p Key is lower than,
+///         starts with or is greater than \p Prefix, respectively.
+template<size_t I = 0, typename KeyT, typename... Ts>
+int compareKeyPrefix(const KeyT &Key, const std::tuple<Ts...> &Prefix) {
+  if constexpr (I == sizeof...(Ts)) {
+    return 0;
+  } else {
+    const auto &Component = detail::keyComponent<I>(Key);
+    const auto &Expected = std::get<I>(Prefix);
+    if (Component < Expected)
+      return -1;
+    if (Expected < Component)
+      return 1;
+    return compareKeyPrefix<I + 1>(Key, Prefix);
+  }
+}
+
+/// \brief Comparator of keys which also accepts key prefixes
+template<typename KeyT, typename Compare>
+struct KeyPrefixCompare : public Compare {
+  using is_transparent = void;
+
+  bool operator()(const KeyT &LHS, const KeyT &RHS) const {
+    return Compare::operator()(LHS, RHS);
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<KeyT, PrefixT, bool>
+  operator()(const KeyT &Key, const PrefixT &Prefix) const {
+    return compareKeyPrefix(Key, Prefix) < 0;
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<KeyT, PrefixT, bool>
+  operator()(const PrefixT &Prefix, const KeyT &Key) const {
+    return compareKeyPrefix(Key, Prefix) > 0;
+  }
+};
+
 //
 // is_iterable
 //
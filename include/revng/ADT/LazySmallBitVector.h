@@ -66,6 +66,26 @@ inline unsigned findFirstBit(T Value) {
   return findFirstBit<T>(Value);
 }
 
+template<typename T>
+inline unsigned populationCount(enable_if_int<T> Value) {
+  return __builtin_popcount(Value);
+}
+
+template<typename T>
+inline unsigned populationCount(enable_if_long<T> Value) {
+  return __builtin_popcountl(Value);
+}
+
+template<typename T>
+inline unsigned populationCount(enable_if_long_long<T> Value) {
+  return __builtin_popcountll(Value);
+}
+
+template<typename T>
+inline unsigned populationCount(T Value) {
+  return populationCount<T>(Value);
+}
+
 template<typename T>
 inline T excessDivide(T A, unsigned B) {
   return (A + (B - 1)) / B;
@@ -139,6 +159,21 @@ private:
       return Storage[Index];
     }
 
+    /// \brief Unchecked access to the words, for bulk operations
+    ///
+    /// The loops over data() are kept simple on purpose, so that the compiler
+    /// can vectorize them.
+    uintptr_t *data() { return Storage; }
+    const uintptr_t *data() const { return Storage; }
+
+    bool isZero(size_t From) const {
+      const uintptr_t *Words = data();
+      uintptr_t Result = 0;
+      for (size_t I = From; I < wordCount(); I++)
+        Result |= Words[I];
+      return Result == 0;
+    }
+
     void zero(size_t From, size_t Count) {
       revng_assert(From + Count <= wordCount());
       memset(&at(From), 0, Count * sizeof(uintptr_t));
@@ -314,36 +349,27 @@ public:
       unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
       Max /= BitsPerPointer;
 
-      for (unsigned I = 0; I < Max; I++)
-        if (ThisLarge.at(I) != OtherLarge.at(I))
-          return false;
+      size_t CommonSize = Max * sizeof(uintptr_t);
+      if (memcmp(ThisLarge.data(), OtherLarge.data(), CommonSize) != 0)
+        return false;
 
-      if (ThisLarge.capacity() > OtherLarge.capacity()) {
-        for (unsigned I = Max; I < ThisLarge.wordCount(); I++)
-          if (ThisLarge.at(I) != 0)
-            return false;
-      } else {
-        for (unsigned I = Max; I < OtherLarge.wordCount(); I++)
-          if (OtherLarge.at(I) != 0)
-            return false;
-      }
+      if (ThisLarge.capacity() > OtherLarge.capacity())
+        return ThisLarge.isZero(Max);
+      else
+        return OtherLarge.isZero(Max);
 
     } else if (!isSmall() && Other.isSmall()) {
       const LargeStorage &ThisLarge = getLarge();
       if (ThisLarge.at(0) != Other.getSmall())
         return false;
 
-      for (unsigned I = 1; I < ThisLarge.wordCount(); I++)
-        if (ThisLarge.at(I) != 0)
-          return false;
+      return ThisLarge.isZero(1);
     } else if (isSmall() && !Other.isSmall()) {
       const LargeStorage &OtherLarge = Other.getLarge();
       if (OtherLarge.at(0) != getSmall())
         return false;
 
-      for (unsigned I = 1; I < OtherLarge.wordCount(); I++)
-        if (OtherLarge.at(I) != 0)
-          return false;
+      return OtherLarge.isZero(1);
     }
 
     return true;
@@ -416,8 +442,10 @@ public:
 
       unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
       Max /= BitsPerPointer;
+      uintptr_t *ThisWords = ThisLarge.data();
+      const uintptr_t *OtherWords = OtherLarge.data();
       for (unsigned I = 0; I < Max; I++)
-        ThisLarge.at(I) = ThisLarge.at(I) ^ OtherLarge.at(I);
+        ThisWords[I] ^= OtherWords[I];
 
     } else if (!isSmall() && Other.isSmall()) {
       LargeStorage &ThisLarge = getLarge();
@@ -445,8 +473,10 @@ public:
       unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
       Max /= BitsPerPointer;
 
+      uintptr_t *ThisWords = ThisLarge.data();
+      const uintptr_t *OtherWords = OtherLarge.data();
       for (unsigned I = 0; I < Max; I++)
-        ThisLarge.at(I) = ThisLarge.at(I) | OtherLarge.at(I);
+        ThisWords[I] |= OtherWords[I];
 
     } else if (!isSmall() && Other.isSmall()) {
       LargeStorage &ThisLarge = getLarge();
@@ -456,6 +486,59 @@ public:
     return *this;
   }
 
+  /// \brief Perform `*this |= Other` and report whether this changed
+  ///
+  /// This is meant for fixed-point loops: it avoids a copy and a comparison
+  /// of the whole bit vector.
+  bool unionAndCheckChanged(const LazySmallBitVector &Other) {
+    // Ensure we have at least the same capacity as Other
+    if (Other.capacity() > this->capacity())
+      alloc(Other.capacity());
+
+    revng_assert(!(isSmall() && !Other.isSmall()));
+
+    if (isSmall()) {
+      uintptr_t Old = Storage;
+      Storage = Storage | Other.Storage;
+      return Storage != Old;
+    }
+
+    LargeStorage &ThisLarge = getLarge();
+    uintptr_t *ThisWords = ThisLarge.data();
+
+    if (Other.isSmall()) {
+      uintptr_t Old = ThisWords[0];
+      ThisWords[0] = Old | Other.getSmall();
+      return ThisWords[0] != Old;
+    }
+
+    const LargeStorage &OtherLarge = Other.getLarge();
+    const uintptr_t *OtherWords = OtherLarge.data();
+    unsigned Max = std::min(ThisLarge.wordCount(), OtherLarge.wordCount());
+
+    // Accumulate the new bits instead of branching on each word
+    uintptr_t Changed = 0;
+    for (unsigned I = 0; I < Max; I++) {
+      Changed |= OtherWords[I] & ~ThisWords[I];
+      ThisWords[I] |= OtherWords[I];
+    }
+
+    return Changed != 0;
+  }
+
+  /// \brief The number of set bits
+  unsigned size() const {
+    if (isSmall())
+      return populationCount(getSmall());
+
+    const LargeStorage &Large = getLarge();
+    const uintptr_t *Words = Large.data();
+    unsigned Result = 0;
+    for (unsigned I = 0; I < Large.wordCount(); I++)
+      Result += populationCount(Words[I]);
+    return Result;
+  }
+
   LazySmallBitVector &operator&=(const LazySmallBitVector &Other) {
     if (isSmall()) {
       uintptr_t OtherValue;
@@ -488,8 +571,10 @@ public:
         }
 
         unsigned Max = std::min(OtherPointersCount, ThisPointersCount);
+        uintptr_t *ThisWords = Large.data();
+        const uintptr_t *OtherWords = OtherLarge.data();
         for (unsigned I = 0; I < Max; I++)
-          Large.at(I) = Large.at(I) & OtherLarge.at(I);
+          ThisWords[I] &= OtherWords[I];
       }
     }
 
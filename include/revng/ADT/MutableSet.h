@@ -4,8 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
 #include "llvm/ADT/STLExtras.h"
 
+#include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/KeyedObjectTraits.h"
 
 template<typename T, class Compare>
@@ -17,7 +20,7 @@ public:
   using key_type = const decltype(KOT::key(std::declval<T>()));
 
 private:
-  using map_type = std::map<key_type, T, Compare>;
+  using map_type = std::map<key_type, T, KeyPrefixCompare<key_type, Compare>>;
 
 public:
   using size_type = typename map_type::size_type;
@@ -153,6 +156,74 @@ public:
     return wrapIterator(TheMap.upper_bound(Key));
   }
 
+public:
+  /// \name Lookups by key prefix, see is_key_prefix_v
+  /// @{
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, iterator>
+  lower_bound(const PrefixT &Prefix) {
+    static_assert(std::is_same_v<Compare, KOTCompare<T>>);
+    return wrapIterator(TheMap.lower_bound(Prefix));
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, const_iterator>
+  lower_bound(const PrefixT &Prefix) const {
+    static_assert(std::is_same_v<Compare, KOTCompare<T>>);
+    return wrapIterator(TheMap.lower_bound(Prefix));
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, iterator>
+  upper_bound(const PrefixT &Prefix) {
+    static_assert(std::is_same_v<Compare, KOTCompare<T>>);
+    return wrapIterator(TheMap.upper_bound(Prefix));
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, const_iterator>
+  upper_bound(const PrefixT &Prefix) const {
+    static_assert(std::is_same_v<Compare, KOTCompare<T>>);
+    return wrapIterator(TheMap.upper_bound(Prefix));
+  }
+
+  /// \brief Find the first element whose key starts with \p Prefix
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, iterator>
+  find(const PrefixT &Prefix) {
+    auto It = lower_bound(Prefix);
+    if (It != end() and compareKeyPrefix(KOT::key(*It), Prefix) == 0)
+      return It;
+    return end();
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, const_iterator>
+  find(const PrefixT &Prefix) const {
+    auto It = lower_bound(Prefix);
+    if (It != end() and compareKeyPrefix(KOT::key(*It), Prefix) == 0)
+      return It;
+    return end();
+  }
+
+  /// \brief All the elements whose key starts with \p Prefix
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, llvm::iterator_range<iterator>>
+  prefix_range(const PrefixT &Prefix) {
+    return llvm::make_range(lower_bound(Prefix), upper_bound(Prefix));
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type,
+                            PrefixT,
+                            llvm::iterator_range<const_iterator>>
+  prefix_range(const PrefixT &Prefix) const {
+    return llvm::make_range(lower_bound(Prefix), upper_bound(Prefix));
+  }
+
+  /// @}
+
 public:
   class BatchInserter {
   private:
@@ -161,6 +232,7 @@ public:
   public:
     BatchInserter(MutableSet &MS) : MS(MS) {}
     void insert(const T &Value) { MS.insert(Value); }
+    void reserve(size_type) {}
   };
 
   BatchInserter batch_insert() { return BatchInserter(*this); }
@@ -172,6 +244,7 @@ public:
   public:
     BatchInsertOrAssigner(MutableSet &MS) : MS(MS) {}
     void insert_or_assign(const T &Value) { MS.insert_or_assign(Value); }
+    void reserve(size_type) {}
   };
 
   BatchInsertOrAssigner batch_insert_or_assign() {
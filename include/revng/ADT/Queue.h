@@ -4,9 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <cstddef>
 #include <queue>
 #include <set>
 
+#include "llvm/ADT/BitVector.h"
+
 #include "revng/Support/Assert.h"
 
 /// \brief Queue where an element cannot be re-inserted if it's already in the
@@ -55,3 +59,69 @@ using UniquedQueue = QueueImpl<T, false>;
 
 template<typename T>
 using OnceQueue = QueueImpl<T, true>;
+
+/// \brief Variant of QueueImpl for elements with a dense numbering
+///
+/// Membership is tracked in a bit vector indexed by \p IndexOf, which must map
+/// each element to a small, unique, non-negative integer (e.g., the number of
+/// a basic block). This makes insert and pop O(1) and avoids an allocation
+/// for each element.
+///
+/// \tparam IndexOf a function object mapping a `T` to a `size_t`.
+template<typename T, typename IndexOf, bool Once>
+class DenseQueueImpl {
+public:
+  /// \param Capacity the expected number of distinct indices, the bit vector
+  ///        grows on demand anyway.
+  DenseQueueImpl(size_t Capacity = 0, IndexOf Index = IndexOf()) :
+    Set(Capacity), Index(Index) {}
+
+public:
+  void insert(T Element) {
+    size_t I = Index(Element);
+    if (I >= Set.size())
+      Set.resize(std::max<size_t>(I + 1, 2 * Set.size()));
+
+    if (not Set.test(I)) {
+      Set.set(I);
+      Queue.push(Element);
+    }
+  }
+
+  bool empty() const { return Queue.empty(); }
+
+  T head() const { return Queue.front(); }
+
+  T pop() {
+    T Result = head();
+    Queue.pop();
+    if (!Once)
+      Set.reset(Index(Result));
+    return Result;
+  }
+
+  size_t size() const { return Queue.size(); }
+
+  /// \brief Check whether \p Element has ever been inserted
+  bool visited(T Element) const {
+    revng_assert(Once);
+    size_t I = Index(Element);
+    return I < Set.size() and Set.test(I);
+  }
+
+  void clear() {
+    Set.reset();
+    std::queue<T>().swap(Queue);
+  }
+
+private:
+  llvm::BitVector Set;
+  std::queue<T> Queue;
+  IndexOf Index;
+};
+
+template<typename T, typename IndexOf>
+using DenseUniquedQueue = DenseQueueImpl<T, IndexOf, false>;
+
+template<typename T, typename IndexOf>
+using DenseOnceQueue = DenseQueueImpl<T, IndexOf, true>;
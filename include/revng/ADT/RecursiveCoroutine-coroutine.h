@@ -4,14 +4,103 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <cstddef>
 #include <experimental/coroutine>
+#include <memory>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "revng/Support/Assert.h"
 
+/// \brief Per-thread stack allocator for the frames of RecursiveCoroutine
+///
+/// Frames of recursive coroutines are created and destroyed in LIFO order, so
+/// they are allocated on a stack of large chunks, which are retained and
+/// reused. After the deepest recursion has been reached once, no further heap
+/// allocations take place.
+///
+/// Frames freed out of order are only marked as such, and their memory is
+/// reclaimed as soon as all the frames allocated after them are freed too.
+class CoroutineFrameArena {
+private:
+  static constexpr size_t Alignment = alignof(std::max_align_t);
+  static constexpr size_t MinChunkSize = 64 * 1024;
+
+  struct alignas(Alignment) Header {
+    size_t Size;
+    size_t ChunkIndex;
+    bool Freed;
+  };
+
+  struct Chunk {
+    std::unique_ptr<char[]> Memory;
+    size_t Size;
+    size_t Used;
+  };
+
+private:
+  std::vector<Chunk> Chunks;
+  std::vector<Header *> Allocations;
+  size_t Current = 0;
+
+public:
+  static CoroutineFrameArena &get() {
+    thread_local CoroutineFrameArena Arena;
+    return Arena;
+  }
+
+public:
+  void *allocate(size_t Size) {
+    Size = sizeof(Header) + (Size + Alignment - 1) / Alignment * Alignment;
+
+    // Move to the next chunk if this one is full, chunks after Current are all
+    // unused
+    if (Chunks.empty() or Chunks[Current].Used + Size > Chunks[Current].Size) {
+      if (not Chunks.empty() and Chunks[Current].Used != 0)
+        ++Current;
+
+      // Allocate a new chunk, or replace an unused one which is too small
+      size_t ChunkSize = std::max(Size, MinChunkSize);
+      if (Current == Chunks.size())
+        Chunks.push_back({ std::make_unique<char[]>(ChunkSize), ChunkSize, 0 });
+      else if (Chunks[Current].Size < Size)
+        Chunks[Current] = { std::make_unique<char[]>(ChunkSize), ChunkSize, 0 };
+    }
+
+    Chunk &Target = Chunks[Current];
+    auto *Result = reinterpret_cast<Header *>(&Target.Memory[Target.Used]);
+    Target.Used += Size;
+    *Result = { Size, Current, false };
+    Allocations.push_back(Result);
+
+    return Result + 1;
+  }
+
+  void deallocate(void *Pointer) {
+    static_cast<Header *>(Pointer)[-1].Freed = true;
+
+    // Pop all the freed allocations on top of the stack
+    while (not Allocations.empty() and Allocations.back()->Freed) {
+      Header *Top = Allocations.back();
+      Allocations.pop_back();
+      Chunks[Top->ChunkIndex].Used -= Top->Size;
+      Current = Top->ChunkIndex;
+    }
+  }
+};
+
 struct PromiseBase {
 
+  static void *operator new(size_t Size) noexcept {
+    return CoroutineFrameArena::get().allocate(Size);
+  }
+
+  static void operator delete(void *Pointer) {
+    CoroutineFrameArena::get().deallocate(Pointer);
+  }
+
   auto initial_suspend() const { return std::experimental::suspend_always(); }
   auto final_suspend() const noexcept {
     return std::experimental::suspend_always();
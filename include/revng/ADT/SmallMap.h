@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <array>
 #include <map>
 
@@ -158,7 +159,13 @@ private:
 /// \brief map that usually contains less than N elements
 ///
 /// SmallMap keeps a std::array of pairs inline which are search linearly if
-/// size() < N.
+/// size() < N. If the inline elements are known to be sorted, lookups use a
+/// binary search instead.
+///
+/// The pairs are kept together, rather than in separate arrays of keys and
+/// values, since iterators have to provide references to std::pair, as
+/// std::map does. For the same reason, and since references to the values
+/// must stay valid across insertions, the out of line container is a std::map.
 ///
 /// \note Since this data structure internally uses an std::array, expect the
 ///       default constructor to be used.
@@ -292,10 +299,12 @@ public:
       return { iterator(smallBegin() + Size - 1), true };
     }
 
-    // Otherwise, grow from vector to set.
+    // Otherwise, grow from vector to set. Once sorted, each element can be
+    // inserted at the end in constant time.
     revng_assert(Map.empty());
+    sort();
     for (unsigned I = 0; I < Size; I++)
-      Map.insert(Vector[I]);
+      Map.emplace_hint(Map.end(), Vector[I]);
 
     auto Result = Map.insert(P);
     return { iterator(Result.first), Result.second };
@@ -381,33 +390,41 @@ public:
 private:
   bool isSmall() const { return Map.empty(); }
 
+  /// \brief Below this size, a linear scan is faster than a binary search
+  static constexpr unsigned LinearScanThreshold = 8;
+
+  static bool compareKey(const Pair &P, const K &Key) {
+    return C()(P.first, Key);
+  }
+
   ConstVIterator vfind(const K &Key) const {
-    for (ConstVIterator I = smallBegin(), E = smallBegin() + Size; I != E; ++I)
+    ConstVIterator E = smallBegin() + Size;
+
+    if (IsSorted and Size > LinearScanThreshold) {
+      ConstVIterator I = std::lower_bound(smallBegin(), E, Key, compareKey);
+      if (I != E and not C()(Key, I->first))
+        return I;
+      return E;
+    }
+
+    for (ConstVIterator I = smallBegin(); I != E; ++I)
       if (I->first == Key)
         return I;
-    return smallBegin() + Size;
+    return E;
   }
 
   VIterator vfind(const K &Key) {
-    for (VIterator I = smallBegin(), E = smallBegin() + Size; I != E; ++I)
-      if (I->first == Key)
-        return I;
-    return smallBegin() + Size;
+    ConstVIterator Result = const_cast<const SmallMap *>(this)->vfind(Key);
+    return smallBegin() + (Result - smallBegin());
   }
 
   ConstVIterator vlower_bound(const K &Key) const {
     sort();
-    for (ConstVIterator I = smallBegin(), E = smallBegin() + Size; I != E; ++I)
-      if (!C()(I->first, Key))
-        return I;
-    return smallBegin() + Size;
+    return std::lower_bound(smallBegin(), smallBegin() + Size, Key, compareKey);
   }
 
   VIterator vlower_bound(const K &Key) {
     sort();
-    for (VIterator I = smallBegin(), E = smallBegin() + Size; I != E; ++I)
-      if (!C()(I->first, Key))
-        return I;
-    return smallBegin() + Size;
+    return std::lower_bound(smallBegin(), smallBegin() + Size, Key, compareKey);
   }
 };
@@ -193,6 +193,13 @@ public:
   std::pair<iterator, bool> insert(const T &Value) {
     revng_assert(not BatchInsertInProgress);
     auto Key = KeyedObjectTraits<T>::key(Value);
+
+    // Fast path for insertions in order
+    if (empty() or compareKeys(KOT::key(TheVector.back()), Key)) {
+      TheVector.push_back(Value);
+      return { --end(), true };
+    }
+
     auto It = lower_bound(Key);
     if (It == end()) {
       TheVector.push_back(Value);
@@ -207,6 +214,13 @@ public:
   std::pair<iterator, bool> insert_or_assign(const T &Value) {
     revng_assert(not BatchInsertInProgress);
     auto Key = KeyedObjectTraits<T>::key(Value);
+
+    // Fast path for insertions in order
+    if (empty() or compareKeys(KOT::key(TheVector.back()), Key)) {
+      TheVector.push_back(Value);
+      return { --end(), true };
+    }
+
     auto It = lower_bound(Key);
     if (It == end()) {
       TheVector.push_back(Value);
@@ -269,24 +283,96 @@ public:
 
   iterator lower_bound(const key_type &Key) {
     revng_assert(not BatchInsertInProgress);
-    return std::lower_bound(begin(), end(), KOT::fromKey(Key), compareElements);
+    return std::lower_bound(begin(), end(), Key, compareElementKey);
   }
 
   const_iterator lower_bound(const key_type &Key) const {
     revng_assert(not BatchInsertInProgress);
-    return std::lower_bound(begin(), end(), KOT::fromKey(Key), compareElements);
+    return std::lower_bound(begin(), end(), Key, compareElementKey);
   }
 
   iterator upper_bound(const key_type &Key) {
     revng_assert(not BatchInsertInProgress);
-    return std::upper_bound(begin(), end(), KOT::fromKey(Key), compareElements);
+    return std::upper_bound(begin(), end(), Key, compareKeyElement);
   }
 
   const_iterator upper_bound(const key_type &Key) const {
     revng_assert(not BatchInsertInProgress);
-    return std::upper_bound(begin(), end(), KOT::fromKey(Key), compareElements);
+    return std::upper_bound(begin(), end(), Key, compareKeyElement);
   }
 
+public:
+  /// \name Lookups by key prefix, see is_key_prefix_v
+  /// @{
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, iterator>
+  lower_bound(const PrefixT &Prefix) {
+    revng_assert(not BatchInsertInProgress);
+    auto *IsBefore = elementBeforePrefix<PrefixT>;
+    return std::lower_bound(begin(), end(), Prefix, IsBefore);
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, const_iterator>
+  lower_bound(const PrefixT &Prefix) const {
+    revng_assert(not BatchInsertInProgress);
+    auto *IsBefore = elementBeforePrefix<PrefixT>;
+    return std::lower_bound(begin(), end(), Prefix, IsBefore);
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, iterator>
+  upper_bound(const PrefixT &Prefix) {
+    revng_assert(not BatchInsertInProgress);
+    auto *IsAfter = prefixBeforeElement<PrefixT>;
+    return std::upper_bound(begin(), end(), Prefix, IsAfter);
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, const_iterator>
+  upper_bound(const PrefixT &Prefix) const {
+    revng_assert(not BatchInsertInProgress);
+    auto *IsAfter = prefixBeforeElement<PrefixT>;
+    return std::upper_bound(begin(), end(), Prefix, IsAfter);
+  }
+
+  /// \brief Find the first element whose key starts with \p Prefix
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, iterator>
+  find(const PrefixT &Prefix) {
+    auto It = lower_bound(Prefix);
+    if (It != end() and compareKeyPrefix(KOT::key(*It), Prefix) == 0)
+      return It;
+    return end();
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, const_iterator>
+  find(const PrefixT &Prefix) const {
+    auto It = lower_bound(Prefix);
+    if (It != end() and compareKeyPrefix(KOT::key(*It), Prefix) == 0)
+      return It;
+    return end();
+  }
+
+  /// \brief All the elements whose key starts with \p Prefix
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type, PrefixT, llvm::iterator_range<iterator>>
+  prefix_range(const PrefixT &Prefix) {
+    return llvm::make_range(lower_bound(Prefix), upper_bound(Prefix));
+  }
+
+  template<typename PrefixT>
+  enable_if_is_key_prefix_t<key_type,
+                            PrefixT,
+                            llvm::iterator_range<const_iterator>>
+  prefix_range(const PrefixT &Prefix) const {
+    return llvm::make_range(lower_bound(Prefix), upper_bound(Prefix));
+  }
+
+  /// @}
+
 public:
   template<bool KeepFirst>
   class BatchInserterBase {
@@ -321,11 +407,22 @@ public:
       }
     }
 
+    /// \brief Make room for \p NewSize elements, including the existing ones
+    void reserve(size_type NewSize) {
+      revng_assert(SV->BatchInsertInProgress);
+      SV->TheVector.reserve(NewSize);
+    }
+
   protected:
     void insertImpl(const T &Value) {
       revng_assert(SV->BatchInsertInProgress);
       SV->TheVector.push_back(Value);
     }
+
+    void insertImpl(T &&Value) {
+      revng_assert(SV->BatchInsertInProgress);
+      SV->TheVector.push_back(std::move(Value));
+    }
   };
 
   class BatchInserter : public BatchInserterBase<true> {
@@ -334,6 +431,7 @@ public:
 
   public:
     void insert(const T &Value) { this->insertImpl(Value); }
+    void insert(T &&Value) { this->insertImpl(std::move(Value)); }
   };
 
   BatchInserter batch_insert() {
@@ -347,6 +445,7 @@ public:
 
   public:
     void insert_or_assign(const T &Value) { this->insertImpl(Value); }
+    void insert_or_assign(T &&Value) { this->insertImpl(std::move(Value)); }
   };
 
   BatchInsertOrAssigner batch_insert_or_assign() {
@@ -364,6 +463,26 @@ private:
     return Compare()(LHS, RHS);
   }
 
+  static bool compareElementKey(const T &LHS, const key_type &RHS) {
+    return compareKeys(KOT::key(LHS), RHS);
+  }
+
+  static bool compareKeyElement(const key_type &LHS, const T &RHS) {
+    return compareKeys(LHS, KOT::key(RHS));
+  }
+
+  template<typename PrefixT>
+  static bool elementBeforePrefix(const T &Element, const PrefixT &Prefix) {
+    static_assert(std::is_same_v<Compare, KOTCompare<T>>);
+    return compareKeyPrefix(KOT::key(Element), Prefix) < 0;
+  }
+
+  template<typename PrefixT>
+  static bool prefixBeforeElement(const PrefixT &Prefix, const T &Element) {
+    static_assert(std::is_same_v<Compare, KOTCompare<T>>);
+    return compareKeyPrefix(KOT::key(Element), Prefix) > 0;
+  }
+
   static bool elementsEqual(const T &LHS, const T &RHS) {
     return keysEqual(KeyedObjectTraits<T>::key(LHS),
                      KeyedObjectTraits<T>::key(RHS));
@@ -375,8 +494,10 @@ private:
 
   template<bool KeepFirst>
   void sort() {
-    // Sort
-    std::stable_sort(begin(), end(), compareElements);
+    // Sort, unless the elements have been inserted in order, which is common
+    // and can be checked in linear time
+    if (not std::is_sorted(begin(), end(), compareElements))
+      std::stable_sort(begin(), end(), compareElements);
 
     // Remove duplicates keeping the last instance of each element
     auto NewEnd = end();
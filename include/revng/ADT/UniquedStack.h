@@ -5,13 +5,20 @@
 //
 
 #include <algorithm>
+#include <cstddef>
 #include <set>
 #include <vector>
 
+#include "llvm/ADT/BitVector.h"
+
 #include "revng/Support/Assert.h"
 
 /// \brief Stack where an element cannot be re-inserted in it's already in the
 ///        stack
+///
+/// Elements leave the set when popped, so the memory used is proportional to
+/// the size of the stack, not of the visit. To mark the visited elements of a
+/// large graph, see EpochSet.
 template<typename T>
 class UniquedStack {
 public:
@@ -41,3 +48,44 @@ private:
   std::set<T> Set;
   std::vector<T> Queue;
 };
+
+/// \brief Variant of UniquedStack for elements with a dense numbering
+///
+/// \see DenseQueueImpl
+template<typename T, typename IndexOf>
+class DenseUniquedStack {
+public:
+  DenseUniquedStack(size_t Capacity = 0, IndexOf Index = IndexOf()) :
+    Set(Capacity), Index(Index) {}
+
+public:
+  void insert(T Element) {
+    size_t I = Index(Element);
+    if (I >= Set.size())
+      Set.resize(std::max<size_t>(I + 1, 2 * Set.size()));
+
+    if (not Set.test(I)) {
+      Set.set(I);
+      Queue.push_back(Element);
+    }
+  }
+
+  bool empty() const { return Queue.empty(); }
+
+  T pop() {
+    T Result = Queue.back();
+    Queue.pop_back();
+    Set.reset(Index(Result));
+    return Result;
+  }
+
+  /// \brief Reverses the stack in its current status
+  void reverse() { std::reverse(Queue.begin(), Queue.end()); }
+
+  size_t size() const { return Queue.size(); }
+
+private:
+  llvm::BitVector Set;
+  std::vector<T> Queue;
+  IndexOf Index;
+};
@@ -309,3 +309,47 @@ zipmap_range(LeftMap &Left, RightMap &Right) {
                           zipmap_end<LeftMap, RightMap, Comparator>(Left,
                                                                     Right));
 }
+
+/// \brief Invoke \p Callback on each pair that zipmap_range would produce
+///
+/// This is equivalent to iterating over zipmap_range(Left, Right), but it's a
+/// plain merge loop: there's no iterator state to keep in sync and no end
+/// checks for the exhausted container. Prefer this in hot paths.
+///
+/// \p Callback is invoked with a pointer to the element of \p Left and one to
+/// the element of \p Right, one of which might be nullptr.
+template<typename LeftMap,
+         typename RightMap,
+         typename Comparator = DefaultComparator<LeftMap, RightMap>,
+         typename CallbackT>
+inline void
+zipmap_for_each(LeftMap &Left, RightMap &Right, CallbackT &&Callback) {
+  using left_pointer = element_pointer_t<LeftMap>;
+  using right_pointer = element_pointer_t<RightMap>;
+
+  auto LeftIt = Left.begin();
+  auto LeftEnd = Left.end();
+  auto RightIt = Right.begin();
+  auto RightEnd = Right.end();
+
+  while (LeftIt != LeftEnd and RightIt != RightEnd) {
+    int Result = Comparator::compare(*LeftIt, *RightIt);
+    if (Result == 0) {
+      Callback(&*LeftIt, &*RightIt);
+      ++LeftIt;
+      ++RightIt;
+    } else if (Result < 0) {
+      Callback(&*LeftIt, right_pointer(nullptr));
+      ++LeftIt;
+    } else {
+      Callback(left_pointer(nullptr), &*RightIt);
+      ++RightIt;
+    }
+  }
+
+  for (; LeftIt != LeftEnd; ++LeftIt)
+    Callback(&*LeftIt, right_pointer(nullptr));
+
+  for (; RightIt != RightEnd; ++RightIt)
+    Callback(left_pointer(nullptr), &*RightIt);
+}
@@ -6,6 +6,8 @@
 
 #include <set>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
@@ -22,8 +24,10 @@
 #include "revng/Support/GraphAlgorithms.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/MonotoneFramework.h"
+#include "revng/Support/Statistics.h"
 
 inline Logger<> AVILogger("avi");
+inline MemoryGauge AVIMemory("AVI");
 
 using range_size_t = uint64_t;
 const range_size_t MaxMaterializedValues = (1 << 16);
@@ -614,8 +618,11 @@ public:
   }
 
   /// \brief Materialize all the values in this expression
+  ///
+  /// \return the materialized values or an empty set if there would be
+  ///         \p MaxValues or more of them.
   template<typename MemoryOracle>
-  MaterializedValues materialize(MemoryOracle &MO) {
+  MaterializedValues materialize(MemoryOracle &MO, range_size_t MaxValues) {
     using namespace llvm;
 
     revng_assert(not Materialized);
@@ -631,7 +638,7 @@ public:
       }
     }
 
-    range_size_t WorstCase = MaxMaterializedValues;
+    range_size_t WorstCase = MaxValues;
     if (SmallestType != nullptr)
       WorstCase = std::min(SmallestType->getBitMask(), WorstCase);
 
@@ -663,160 +670,314 @@ public:
       OperationsStack.resize(SmallestRangeIndex);
     }
 
+    // If there's a load, compute its address for all the values and let the
+    // oracle read them all at once: this is typically a jump table
+    auto Begin = OperationsStack.rbegin();
+    auto End = OperationsStack.rend();
+    auto FirstLoad = std::find_if(Begin, End, [](const Operation &Op) {
+      return isa<LoadInst>(Op.V);
+    });
+    bool Bulk = FirstLoad != End and Values.size() > 1;
+
+    std::vector<Constant *> Addresses;
+    MaterializedValues Loaded;
+    if (Bulk) {
+      Addresses.reserve(Values.size());
+      auto AddressOperations = make_range(Begin, FirstLoad);
+      Type *T = SmallestOperationType;
+      if (not applyAffine(AddressOperations, T, Addresses)) {
+        for (MaterializedValue &Entry : Values) {
+          Constant *Current = toConstant(Entry, SmallestOperationType);
+          llvm::Optional<llvm::StringRef> SymbolName;
+          for (const Operation &Op : AddressOperations) {
+            bool Success = apply(Op, MO, Current, SymbolName, nullptr);
+            revng_assert(Success and not SymbolName);
+          }
+          Addresses.push_back(Current);
+        }
+      }
+
+      Loaded = MO.loadAll(Addresses);
+      revng_assert(Loaded.size() == Values.size());
+    }
+
     // Process one value at a time
     for (MaterializedValue &Entry : Values) {
-      using CI = ConstantInt;
-      using CE = ConstantExpr;
-
       if (AVILogger.isEnabled()) {
         AVILogger << "Now materializing ";
         Entry.dump(AVILogger);
         AVILogger << DoLog;
       }
 
+      // Materialize the value I through the operations stack
       llvm::Optional<llvm::StringRef> SymbolName;
       Constant *Current = nullptr;
-      {
-        auto Value = Entry.value();
-        if (SmallestOperationType->isIntegerTy()) {
-          Current = CI::get(SmallestOperationType, Value);
-        } else if (SmallestOperationType->isPointerTy()) {
-          auto &C = SmallestOperationType->getContext();
-          Current = CI::get(DL.getIntPtrType(C), Value);
-          Current = CE::getIntToPtr(Current, SmallestOperationType);
-        } else {
-          revng_abort();
+      auto It = Begin;
+      if (Bulk) {
+        unsigned Index = &Entry - &*Values.begin();
+        Current = Addresses[Index];
+        if (not apply(*FirstLoad, MO, Current, SymbolName, &Loaded[Index]))
+          return {};
+        It = std::next(FirstLoad);
+      } else {
+        Current = toConstant(Entry, SmallestOperationType);
+      }
+
+      for (const Operation &Op : make_range(It, End))
+        if (not apply(Op, MO, Current, SymbolName, nullptr))
+          return {};
+
+      APInt Value(getTypeSize(DL, Current->getType()), 0);
+      if (not Current->isNullValue())
+        Value = cast<ConstantInt>(skipCasts(Current))->getValue();
+
+      if (SymbolName)
+        Entry = { *SymbolName, Value };
+      else
+        Entry = { Value };
+    }
+
+    return std::move(Values);
+  }
+
+  void setPhiValues(MaterializedValues PhiValues) {
+    const Operation &SmallestOperation = OperationsStack.at(SmallestRangeIndex);
+    revng_assert(lastIsPhi());
+    revng_assert(PhiValues.size() < SmallestOperation.RangeSize);
+    Values = std::move(PhiValues);
+    PhiIsSmallest = true;
+    SmallestRangeIndex = OperationsStack.size() - 1;
+  }
+
+private:
+  /// \brief Build a constant of type \p T out of \p Entry
+  llvm::Constant *
+  toConstant(const MaterializedValue &Entry, llvm::Type *T) const {
+    using namespace llvm;
+    using CI = ConstantInt;
+    using CE = ConstantExpr;
+
+    auto Value = Entry.value();
+    if (T->isIntegerTy()) {
+      return CI::get(T, Value);
+    } else if (T->isPointerTy()) {
+      Constant *Result = CI::get(DL.getIntPtrType(T->getContext()), Value);
+      return CE::getIntToPtr(Result, T);
+    } else {
+      revng_abort();
+    }
+  }
+
+  /// \brief Apply \p Operations to all the values at once
+  ///
+  /// Computing the address of a load (e.g., of a jump table entry) applying
+  /// the operations one value at a time folds a constant expression per value
+  /// and per operation. If the address is an affine function of the values,
+  /// the operations are evaluated on plain integers instead.
+  ///
+  /// \param T the type of the values.
+  /// \param Result where the resulting constants are appended.
+  ///
+  /// \return false, leaving \p Result untouched, if one of \p Operations is
+  ///         not a cast or an affine operation with a constant operand.
+  template<typename R>
+  bool applyAffine(R Operations,
+                   llvm::Type *T,
+                   std::vector<llvm::Constant *> &Result) const {
+    using namespace llvm;
+
+    if (not T->isIntegerTy())
+      return false;
+
+    std::vector<APInt> Current;
+    Current.reserve(Values.size());
+    for (const MaterializedValue &Entry : Values)
+      Current.push_back(Entry.value());
+
+    for (const Operation &Op : Operations) {
+      auto *I = dyn_cast<Instruction>(Op.V);
+      if (I == nullptr or Op.usesSCEV())
+        return false;
+
+      T = I->getType();
+      unsigned BitWidth = getTypeSize(DL, T);
+
+      if (I->isCast()) {
+        switch (I->getOpcode()) {
+        case Instruction::ZExt:
+        case Instruction::Trunc:
+        case Instruction::PtrToInt:
+        case Instruction::IntToPtr:
+          for (APInt &Value : Current)
+            Value = Value.zextOrTrunc(BitWidth);
+          break;
+        case Instruction::SExt:
+          for (APInt &Value : Current)
+            Value = Value.sext(BitWidth);
+          break;
+        default:
+          return false;
         }
+
+        continue;
       }
 
-      // Materialize the value I through the operations stack
-      auto It = OperationsStack.rbegin();
-      auto End = OperationsStack.rend();
-      if (It != End) {
-        auto Range = make_range(It, End);
+      if (not isa<BinaryOperator>(I))
+        return false;
 
-        for (const Operation &Op : Range) {
+      bool FreeIsLHS = Op.FreeOperandIndex == 0;
+      auto *C = dyn_cast<ConstantInt>(I->getOperand(FreeIsLHS ? 1 : 0));
+      if (C == nullptr)
+        return false;
+      const APInt &Constant = C->getValue();
 
-          if (AVILogger.isEnabled()) {
-            AVILogger << "  Processing:";
-            Op.dump(AVILogger, 4);
-            AVILogger << DoLog;
-          }
+      switch (I->getOpcode()) {
+      case Instruction::Add:
+        for (APInt &Value : Current)
+          Value += Constant;
+        break;
+      case Instruction::Sub:
+        for (APInt &Value : Current)
+          Value = FreeIsLHS ? Value - Constant : Constant - Value;
+        break;
+      case Instruction::Mul:
+        for (APInt &Value : Current)
+          Value *= Constant;
+        break;
+      case Instruction::Shl:
+        if (not FreeIsLHS or Constant.uge(BitWidth))
+          return false;
+        for (APInt &Value : Current)
+          Value <<= Constant.getZExtValue();
+        break;
+      default:
+        return false;
+      }
+    }
 
-          // After we get a symbol name we only track casts, additions and
-          // subtractions
-          auto *I = dyn_cast<Instruction>(Op.V);
-
-          Module *M = nullptr;
-          LLVMContext *Context = nullptr;
-          const DataLayout *DL = nullptr;
-          if (I != nullptr) {
-            M = I->getParent()->getParent()->getParent();
-            Context = &M->getContext();
-            DL = &M->getDataLayout();
-          }
+    for (const APInt &Value : Current)
+      Result.push_back(toConstant({ Value }, T));
 
-          if (SymbolName
-              and not(I != nullptr
-                      and (I->isCast() or I->getOpcode() == Instruction::Add
-                           or I->getOpcode() == Instruction::Sub))) {
-            return {};
-          }
+    return true;
+  }
 
-          if (auto *C = dyn_cast<Constant>(Op.V)) {
-            Current = C;
-          } else if (auto *C = dyn_cast<Constant>(Op.V)) {
-            revng_assert(Op.V->getNumOperands() == 1);
-            Current = cast<Constant>(C->getOperand(0));
-          } else if (auto *Load = dyn_cast<LoadInst>(Op.V)) {
-            revng_assert(isMemory(skipCasts(Load->getPointerOperand())));
+  /// \brief Apply \p Op to \p Current
+  ///
+  /// \param SymbolName the symbol \p Current is relative to, if any.
+  /// \param Preloaded if \p Op is a load, its result, obtained in advance. If
+  ///        null, it will be obtained from \p MO.
+  ///
+  /// \return false if the value cannot be materialized.
+  template<typename MemoryOracle>
+  bool apply(const Operation &Op,
+             MemoryOracle &MO,
+             llvm::Constant *&Current,
+             llvm::Optional<llvm::StringRef> &SymbolName,
+             const MaterializedValue *Preloaded) {
+    using namespace llvm;
+    using CI = ConstantInt;
+    using CE = ConstantExpr;
 
-            MaterializedValue Loaded = MO.load(Current);
+    if (AVILogger.isEnabled()) {
+      AVILogger << "  Processing:";
+      Op.dump(AVILogger, 4);
+      AVILogger << DoLog;
+    }
 
-            if (AVILogger.isEnabled()) {
-              AVILogger << "  MemoryOracle says its ";
-              Loaded.dump(AVILogger);
-              AVILogger << DoLog;
-            }
+    // After we get a symbol name we only track casts, additions and
+    // subtractions
+    auto *I = dyn_cast<Instruction>(Op.V);
+
+    Module *M = nullptr;
+    LLVMContext *Context = nullptr;
+    const DataLayout *DL = nullptr;
+    if (I != nullptr) {
+      M = I->getParent()->getParent()->getParent();
+      Context = &M->getContext();
+      DL = &M->getDataLayout();
+    }
 
-            if (not Loaded.isValid()) {
-              // Couldn't read memory, bail out
-              return {};
-            }
+    if (SymbolName
+        and not(I != nullptr
+                and (I->isCast() or I->getOpcode() == Instruction::Add
+                     or I->getOpcode() == Instruction::Sub))) {
+      return false;
+    }
 
-            if (Loaded.hasSymbol())
-              SymbolName = Loaded.symbolName();
+    if (auto *C = dyn_cast<Constant>(Op.V)) {
+      Current = C;
+    } else if (auto *C = dyn_cast<Constant>(Op.V)) {
+      revng_assert(Op.V->getNumOperands() == 1);
+      Current = cast<Constant>(C->getOperand(0));
+    } else if (auto *Load = dyn_cast<LoadInst>(Op.V)) {
+      revng_assert(isMemory(skipCasts(Load->getPointerOperand())));
 
-            Type *LoadedType = Load->getType();
-            if (LoadedType->isPointerTy()) {
-              Current = CI::get(DL->getIntPtrType(*Context), Loaded.value());
-              Current = CE::getIntToPtr(Current, LoadedType);
-            } else {
-              Current = CI::get(cast<IntegerType>(LoadedType), Loaded.value());
-            }
+      MaterializedValue Loaded = (Preloaded != nullptr ? *Preloaded :
+                                                         MO.load(Current));
 
-          } else if (auto *Call = dyn_cast<CallInst>(Op.V)) {
-            Function *Callee = Call->getCalledFunction();
-            revng_assert(Callee != nullptr
-                         && Callee->getIntrinsicID() == Intrinsic::bswap);
-
-            using CI = ConstantInt;
-            Current = CI::get(*Context,
-                              cast<CI>(Current)->getValue().byteSwap());
-
-          } else if (I != nullptr) {
-
-            if (Op.usesSCEV()) {
-              Current = replaceAllUnknownsWith(SE,
-                                               SE.getSCEV(I),
-                                               cast<ConstantInt>(Current));
-            } else {
-              // Build operands list patching the free operand
-              SmallVector<Constant *, 4> Operands;
-              unsigned Index = 0;
-              for (Value *Operand : Op.V->operands()) {
-                if (auto *ConstantOperand = dyn_cast<Constant>(Operand)) {
-                  Operands.push_back(ConstantOperand);
-                } else {
-                  revng_assert(Index == Op.FreeOperandIndex);
-                  Operands.push_back(Current);
-                }
-                Index++;
-              }
-
-              Current = ConstantFoldInstOperands(I,
-                                                 Operands,
-                                                 MO.getDataLayout());
-            }
+      if (AVILogger.isEnabled()) {
+        AVILogger << "  MemoryOracle says its ";
+        Loaded.dump(AVILogger);
+        AVILogger << DoLog;
+      }
+
+      if (not Loaded.isValid()) {
+        // Couldn't read memory, bail out
+        return false;
+      }
+
+      if (Loaded.hasSymbol())
+        SymbolName = Loaded.symbolName();
+
+      Type *LoadedType = Load->getType();
+      if (LoadedType->isPointerTy()) {
+        Current = CI::get(DL->getIntPtrType(*Context), Loaded.value());
+        Current = CE::getIntToPtr(Current, LoadedType);
+      } else {
+        Current = CI::get(cast<IntegerType>(LoadedType), Loaded.value());
+      }
+
+    } else if (auto *Call = dyn_cast<CallInst>(Op.V)) {
+      Function *Callee = Call->getCalledFunction();
+      revng_assert(Callee != nullptr
+                   && Callee->getIntrinsicID() == Intrinsic::bswap);
+
+      using CI = ConstantInt;
+      Current = CI::get(*Context,
+                        cast<CI>(Current)->getValue().byteSwap());
 
-            revng_assert(Current != nullptr);
+    } else if (I != nullptr) {
 
+      if (Op.usesSCEV()) {
+        Current = replaceAllUnknownsWith(SE,
+                                         SE.getSCEV(I),
+                                         cast<ConstantInt>(Current));
+      } else {
+        // Build operands list patching the free operand
+        SmallVector<Constant *, 4> Operands;
+        unsigned Index = 0;
+        for (Value *Operand : Op.V->operands()) {
+          if (auto *ConstantOperand = dyn_cast<Constant>(Operand)) {
+            Operands.push_back(ConstantOperand);
           } else {
-            revng_abort();
+            revng_assert(Index == Op.FreeOperandIndex);
+            Operands.push_back(Current);
           }
+          Index++;
         }
+
+        Current = ConstantFoldInstOperands(I,
+                                           Operands,
+                                           MO.getDataLayout());
       }
 
-      APInt Value(getTypeSize(DL, Current->getType()), 0);
-      if (not Current->isNullValue())
-        Value = cast<ConstantInt>(skipCasts(Current))->getValue();
+      revng_assert(Current != nullptr);
 
-      if (SymbolName)
-        Entry = { *SymbolName, Value };
-      else
-        Entry = { Value };
+    } else {
+      revng_abort();
     }
 
-    return std::move(Values);
-  }
-
-  void setPhiValues(MaterializedValues PhiValues) {
-    const Operation &SmallestOperation = OperationsStack.at(SmallestRangeIndex);
-    revng_assert(lastIsPhi());
-    revng_assert(PhiValues.size() < SmallestOperation.RangeSize);
-    Values = std::move(PhiValues);
-    PhiIsSmallest = true;
-    SmallestRangeIndex = OperationsStack.size() - 1;
+    return true;
   }
 };
 
@@ -882,11 +1043,85 @@ public:
   }
 };
 
+/// \brief MemoryOracle memoizing the results of another MemoryOracle
+///
+/// The queries on the same function tend to read the same memory over and
+/// over, e.g., the entries of a jump table. The contents of memory do not
+/// change during the lifetime of the adaptor, so the result of each load is
+/// recorded. Loads are keyed by their address, which, being a uniqued
+/// constant, accounts for the size of the access too.
+template<typename MemoryOracle>
+class CachingMemoryOracle {
+private:
+  MemoryOracle &MO;
+  llvm::DenseMap<llvm::Constant *, MaterializedValue> Cache;
+
+  /// Size of Cache reported to AVIMemory
+  uint64_t Accounted = 0;
+
+public:
+  CachingMemoryOracle(MemoryOracle &MO) : MO(MO) {}
+  CachingMemoryOracle(const CachingMemoryOracle &) = delete;
+  ~CachingMemoryOracle() { AVIMemory.add(-static_cast<int64_t>(Accounted)); }
+
+  const llvm::DataLayout &getDataLayout() const { return MO.getDataLayout(); }
+
+  MaterializedValue load(llvm::Constant *Address) {
+    auto It = Cache.find(Address);
+    if (It != Cache.end())
+      return It->second;
+
+    MaterializedValue Result = MO.load(Address);
+    Cache[Address] = Result;
+    updateMemoryGauge();
+    return Result;
+  }
+
+  /// \brief Load all of \p Addresses, forwarding the missing ones in bulk
+  MaterializedValues loadAll(llvm::ArrayRef<llvm::Constant *> Addresses) {
+    using namespace llvm;
+
+    std::vector<Constant *> Missing;
+    SmallPtrSet<Constant *, 16> Visited;
+    for (Constant *Address : Addresses)
+      if (Cache.count(Address) == 0 and Visited.insert(Address).second)
+        Missing.push_back(Address);
+
+    if (not Missing.empty()) {
+      MaterializedValues Loaded = MO.loadAll(Missing);
+      revng_assert(Loaded.size() == Missing.size());
+      for (unsigned I = 0; I < Missing.size(); ++I)
+        Cache[Missing[I]] = Loaded[I];
+      updateMemoryGauge();
+    }
+
+    MaterializedValues Result;
+    Result.reserve(Addresses.size());
+    for (Constant *Address : Addresses)
+      Result.push_back(Cache.find(Address)->second);
+
+    return Result;
+  }
+
+private:
+  void updateMemoryGauge() {
+    uint64_t Bytes = Cache.getMemorySize();
+    if (Bytes == Accounted)
+      return;
+
+    AVIMemory.add(static_cast<int64_t>(Bytes) - Accounted);
+    Accounted = Bytes;
+  }
+};
+
 /// \brief Analyis to associate to each value a ConstantRangeSet using
 ///        LazyValueInfo
 ///
 /// \tparam MemoryOracle the type of the class used to produce obtain the result
 ///         of memory accesses from constant addresses.
+///         It has to provide `load`, taking a constant address, and
+///         `loadAll`, taking an array of them and returning the result of
+///         `load` on each of them, and it's free to perform them in bulk.
 template<typename MemoryOracle>
 class AdvancedValueInfo {
 private:
@@ -895,14 +1130,42 @@ private:
   const llvm::DominatorTree &DT;
   MemoryOracle &MO;
 
+  /// Maximum number of phis a single query can enter, 0 means no limit
+  unsigned PhiBudget;
+
+  /// Did the last query give up due to PhiBudget?
+  bool BudgetExceeded;
+
+  /// Maximum number of values a query can produce, including the intermediate
+  /// results of the phis it enters
+  range_size_t MaxValues;
+
 public:
   AdvancedValueInfo(llvm::LazyValueInfo &LVI,
                     llvm::ScalarEvolution &SE,
                     const llvm::DominatorTree &DT,
-                    MemoryOracle &MO) :
-    LVI(LVI), SE(SE), DT(DT), MO(MO) {}
+                    MemoryOracle &MO,
+                    unsigned PhiBudget = 0,
+                    range_size_t MaxValues = MaxMaterializedValues) :
+    LVI(LVI),
+    SE(SE),
+    DT(DT),
+    MO(MO),
+    PhiBudget(PhiBudget),
+    BudgetExceeded(false),
+    MaxValues(MaxValues) {
+    revng_assert(MaxValues > 0 and MaxValues <= MaxMaterializedValues);
+  }
 
+  /// \brief Compute the set of possible values of \p V in \p BB
+  ///
+  /// \return the possible values of \p V or an empty set if they could not be
+  ///         enumerated, e.g., because there are too many of them (see
+  ///         MaxValues) or because the query exceeded the phi budget.
   MaterializedValues explore(llvm::BasicBlock *BB, llvm::Value *V);
+
+  /// \brief Did the last call to explore give up due to the phi budget?
+  bool exceededBudget() const { return BudgetExceeded; }
 };
 
 template<class MemoryOracle>
@@ -913,6 +1176,8 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
 
   revng_log(AVILogger, "Exploring " << V << " in " << BB);
 
+  BudgetExceeded = false;
+
   // Create a fake Phi for the initial entry
   PHINode *FakePhi = PHINode::Create(V->getType(), 1);
   FakePhi->addIncoming(V, BB);
@@ -930,7 +1195,7 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
 
   std::set<Instruction *> VisitedPhis;
   std::vector<PhiProcess> PendingPhis{
-    { DL, SE, FakePhi, MaxMaterializedValues }
+    { DL, SE, FakePhi, MaxValues }
   };
   Expression::PhiEdges Edges;
 
@@ -972,6 +1237,14 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
       NextPhi = nullptr;
 
     if (NextPhi != nullptr) {
+      // Give up if this query is taking too long, the result would be
+      // discarded anyway
+      if (PhiBudget != 0 and VisitedPhis.size() >= PhiBudget) {
+        revng_log(AVILogger, "Phi budget exceeded");
+        BudgetExceeded = true;
+        return {};
+      }
+
       VisitedPhis.insert(NextPhi);
 
       Current.Unfinished = true;
@@ -995,16 +1268,23 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
       bool PhiDone = not IsSmallerThanUpperBound;
       if (IsSmallerThanUpperBound) {
         // Materialize the current expression
-        Result = std::move(Current.Expr.materialize<MemoryOracle>(MO));
+        Result = std::move(Current.Expr.materialize<MemoryOracle>(MO,
+                                                                  MaxValues));
 
         // Reset the unfinished flag
         Current.Unfinished = false;
 
         range_size_t NewSize = Current.Values.size() + Result.size();
-        if (Current.TooLarge or NewSize > MaxMaterializedValues) {
+        if (NewSize > MaxValues) {
+          // Stop early: the values of this phi are too many to be useful, no
+          // matter what the remaining incoming values are. The previous level
+          // will have to resort to its own smallest range.
+          revng_log(AVILogger, "Too many values, giving up on " << Current.Phi);
           Current.TooLarge = true;
           Current.Values.clear();
+          Result.clear();
           IsSmallerThanUpperBound = false;
+          PhiDone = true;
         } else {
           // Merge results in Current.Values
           Current.Values.insert(Current.Values.end(),
@@ -1021,7 +1301,8 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
           revng_abort();
         }
 
-        if (Current.NextIncomingIndex == IncomingCount) {
+        if (not Current.TooLarge
+            and Current.NextIncomingIndex == IncomingCount) {
           // We're done with this phi
           PhiDone = true;
 
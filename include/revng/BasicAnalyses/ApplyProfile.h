@@ -0,0 +1,42 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/Pass.h"
+
+/// \brief Annotate the module with an execution profile and lay it out
+///
+/// The profile is a coverage CSV, as dumped by a program instrumented with
+/// InstrumentCoverage (see `REVNG_COVERAGE_PATH`): the number of executions of
+/// each jump target. From it, this pass:
+///
+/// * sets the entry count of each function and the branch weights of the
+///   branches towards jump targets;
+/// * attaches a profile summary to the module, so that the hot/cold splitting
+///   pass and the back end can tell hot and cold code apart (e.g., moving
+///   functions to `.text.hot` and `.text.unlikely`);
+/// * sorts the functions by decreasing entry count, so that the hot ones are
+///   emitted next to each other.
+///
+/// Jump targets are recognized by their `newpc` call, so this pass has to run
+/// before they are dropped.
+class ApplyProfile : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  /// \brief Read the profile from the path specified with -apply-profile-path
+  ApplyProfile();
+
+  ApplyProfile(std::string Path) :
+    llvm::ModulePass(ID), Path(std::move(Path)) {}
+
+  bool runOnModule(llvm::Module &M) override;
+
+private:
+  std::string Path;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Tell LLVM what CSVs, guest memory and helper calls don't alias
+///
+/// Two kinds of alias scopes are attached to memory accesses:
+///
+/// * In the `revng.memory` domain, loads and stores targeting a CSV belong to
+///   the CSVs scope, while guest memory accesses (marked by the lifter with
+///   `revng.guestmemory`) belong to the guest memory scope. Each one is
+///   `!noalias` with the other scope.
+/// * In the `revng.csvs` domain, each CSV has its own scope. Each helper call
+///   with a known CSV usage summary (see GeneratedCodeBasicInfo::getCSVUsage)
+///   gets as `!noalias` the scopes of all the CSVs it neither reads nor
+///   writes.
+///
+/// This way, ScopedNoAliasAA can keep the CSVs in registers across guest
+/// memory accesses and unrelated helper calls.
+class CSVAliasScopes : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  CSVAliasScopes() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnModule(llvm::Module &M) override;
+};
@@ -4,32 +4,40 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <map>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng/Support/IRHelpers.h"
 
 namespace llvm {
 class BasicBlock;
 }
 
+class CustomCFG;
+
 /// \brief Node of a CustomCFG
 ///
-/// A simple container for nodes and a set of successors and predecessors.
+/// A simple container for nodes and a set of successors and predecessors. The
+/// links are stored by the CustomCFG, and are available only after
+/// CustomCFG::buildLinks has been called.
 class CustomCFGNode {
 public:
-  using links_container = std::vector<CustomCFGNode *>;
-  using links_iterator = typename links_container::iterator;
-  using links_const_iterator = typename links_container::const_iterator;
+  using links_iterator = CustomCFGNode **;
+  using links_const_iterator = CustomCFGNode *const *;
   using links_range = llvm::iterator_range<links_iterator>;
   using links_const_range = llvm::iterator_range<links_const_iterator>;
 
 private:
+  friend class CustomCFG;
+
   /// List of successors
-  links_container Successors;
+  links_iterator Successors = nullptr;
+  unsigned SuccessorsCount = 0;
 
   /// List of predecessors
-  links_container Predecessors;
+  links_iterator Predecessors = nullptr;
+  unsigned PredecessorsCount = 0;
 
   /// Reference to the corresponding basic block
   llvm::BasicBlock *BB;
@@ -37,35 +45,35 @@ private:
 public:
   CustomCFGNode(llvm::BasicBlock *BB) : BB(BB) {}
 
-  void addSuccessor(CustomCFGNode *Node) { Successors.push_back(Node); }
-
-  void addPredecessor(CustomCFGNode *Node) { Predecessors.push_back(Node); }
-
-  bool hasSuccessors() const { return Successors.size() != 0; }
-  size_t successor_size() const { return Successors.size(); }
+  bool hasSuccessors() const { return SuccessorsCount != 0; }
+  size_t successor_size() const { return SuccessorsCount; }
   links_const_range successors() const {
     return llvm::make_range(succ_begin(), succ_end());
   }
   links_range successors() {
     return llvm::make_range(succ_begin(), succ_end());
   }
-  links_const_iterator succ_begin() const { return Successors.begin(); }
-  links_const_iterator succ_end() const { return Successors.end(); }
-  links_iterator succ_begin() { return Successors.begin(); }
-  links_iterator succ_end() { return Successors.end(); }
+  links_const_iterator succ_begin() const { return Successors; }
+  links_const_iterator succ_end() const {
+    return Successors + SuccessorsCount;
+  }
+  links_iterator succ_begin() { return Successors; }
+  links_iterator succ_end() { return Successors + SuccessorsCount; }
 
-  bool hasPredecessors() const { return Predecessors.size() != 0; }
-  size_t predecessor_size() const { return Predecessors.size(); }
+  bool hasPredecessors() const { return PredecessorsCount != 0; }
+  size_t predecessor_size() const { return PredecessorsCount; }
   links_const_range predecessors() const {
     return llvm::make_range(pred_begin(), pred_end());
   }
-  links_const_iterator pred_begin() const { return Predecessors.begin(); }
-  links_const_iterator pred_end() const { return Predecessors.end(); }
+  links_const_iterator pred_begin() const { return Predecessors; }
+  links_const_iterator pred_end() const {
+    return Predecessors + PredecessorsCount;
+  }
   links_range predecessors() {
     return llvm::make_range(pred_begin(), pred_end());
   }
-  links_iterator pred_begin() { return Predecessors.begin(); }
-  links_iterator pred_end() { return Predecessors.end(); }
+  links_iterator pred_begin() { return Predecessors; }
+  links_iterator pred_end() { return Predecessors + PredecessorsCount; }
 
   llvm::BasicBlock *block() const { return BB; }
 
@@ -86,48 +94,110 @@ public:
 
 /// \brief A CFG representing a custom view on the actual CFG of a function
 ///
+/// Nodes and edges are stored in flat vectors, which keep their capacity when
+/// the CFG is cleared, so that rebuilding it doesn't allocate. The edges are
+/// first collected with addEdge, then buildLinks lays out the successors and
+/// the predecessors of each node in a single vector.
+///
 /// This class implements `GraphTraits`.
 class CustomCFG {
 public:
-  void clear() { Blocks.clear(); }
+  void clear() {
+    Nodes.clear();
+    Indices.clear();
+    Edges.clear();
+    Links.clear();
+  }
 
-  /// Populate the list of predecessors of each node based on the successors
-  void buildBackLinks() {
-    for (auto &P : Blocks)
-      for (CustomCFGNode *Successor : P.second.successors())
-        Successor->addPredecessor(&P.second);
+  /// \brief Reserve space for \p NodesCount nodes
+  void reserve(size_t NodesCount) {
+    Nodes.reserve(NodesCount);
+    Indices.reserve(NodesCount);
   }
 
-  bool hasNode(const llvm::BasicBlock *BB) const {
-    return Blocks.count(BB) != 0;
+  /// \brief Record the edge from \p From to \p To, creating the nodes if
+  ///        necessary
+  void addEdge(llvm::BasicBlock *From, llvm::BasicBlock *To) {
+    unsigned FromIndex = getIndex(From);
+    unsigned ToIndex = getIndex(To);
+    Edges.emplace_back(FromIndex, ToIndex);
   }
 
-  CustomCFGNode *getNode(llvm::BasicBlock *BB) {
-    auto It = Blocks.find(BB);
-    if (It != Blocks.end())
-      return &It->second;
-    else
-      return &Blocks.insert({ BB, CustomCFGNode(BB) }).first->second;
+  /// \brief Populate the list of successors and predecessors of each node based
+  ///        on the recorded edges
+  void buildLinks() {
+    for (CustomCFGNode &Node : Nodes) {
+      Node.SuccessorsCount = 0;
+      Node.PredecessorsCount = 0;
+    }
+
+    for (auto [From, To] : Edges) {
+      ++Nodes[From].SuccessorsCount;
+      ++Nodes[To].PredecessorsCount;
+    }
+
+    // Successors go in the first half, predecessors in the second
+    Links.assign(2 * Edges.size(), nullptr);
+    CustomCFGNode **Next = Links.data();
+    for (CustomCFGNode &Node : Nodes) {
+      Node.Successors = Next;
+      Next += Node.SuccessorsCount;
+    }
+    for (CustomCFGNode &Node : Nodes) {
+      Node.Predecessors = Next;
+      Next += Node.PredecessorsCount;
+    }
+
+    // Use the counters as insertion cursors, preserving the order of edges
+    for (CustomCFGNode &Node : Nodes) {
+      Node.SuccessorsCount = 0;
+      Node.PredecessorsCount = 0;
+    }
+
+    for (auto [From, To] : Edges) {
+      CustomCFGNode &Source = Nodes[From];
+      CustomCFGNode &Destination = Nodes[To];
+      Source.Successors[Source.SuccessorsCount++] = &Destination;
+      Destination.Predecessors[Destination.PredecessorsCount++] = &Source;
+    }
   }
 
+  bool hasNode(const llvm::BasicBlock *BB) const {
+    return Indices.count(BB) != 0;
+  }
+
+  /// \note The returned pointer is invalidated by the creation of new nodes
+  CustomCFGNode *getNode(llvm::BasicBlock *BB) { return &Nodes[getIndex(BB)]; }
+
   const CustomCFGNode *getNode(const llvm::BasicBlock *BB) const {
-    return &Blocks.at(BB);
+    auto It = Indices.find(BB);
+    revng_assert(It != Indices.end());
+    return &Nodes[It->second];
   }
 
   void dump() const debug_function { dump(dbg); }
 
   template<typename T>
   void dump(T &Output) const {
-    for (auto &P : Blocks) {
-      const llvm::BasicBlock *Block = P.first;
-      const CustomCFGNode *Node = &P.second;
-      Output << getName(Block) << ":\n";
-      Node->dump(Output, "  ");
+    for (const CustomCFGNode &Node : Nodes) {
+      Output << getName(Node.block()) << ":\n";
+      Node.dump(Output, "  ");
     }
   }
 
 private:
-  std::map<const llvm::BasicBlock *, CustomCFGNode> Blocks;
+  unsigned getIndex(llvm::BasicBlock *BB) {
+    auto [It, New] = Indices.try_emplace(BB, Nodes.size());
+    if (New)
+      Nodes.emplace_back(BB);
+    return It->second;
+  }
+
+private:
+  std::vector<CustomCFGNode> Nodes;
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> Indices;
+  std::vector<std::pair<unsigned, unsigned>> Edges;
+  std::vector<CustomCFGNode *> Links;
 };
 
 // Provide graph traits for usage with, e.g., llvm::ReversePostOrderTraversal
@@ -0,0 +1,30 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Erase the stores to CSVs that are overwritten before being read
+///
+/// Flag-setting guest instructions store all the flags they compute, even if,
+/// typically, the next instruction overwrites them. This pass computes which
+/// CSVs are live at each program point, across basic blocks, and erases the
+/// stores to dead CSVs along with the computations feeding them.
+///
+/// Helper calls read the CSVs listed in their usage summary (see
+/// GeneratedCodeBasicInfo::getCSVUsage). Any other instruction that might read
+/// memory we don't know about (e.g., calls to isolated functions, helpers
+/// without a summary, returns) makes all the CSVs live.
+class DeadCSVStoreElimination : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  DeadCSVStoreElimination() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnModule(llvm::Module &M) override;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Erase all the calls to `newpc`
+///
+/// The address of each original instruction is still available through the
+/// `oi` metadata and the debug information, but the generated code is no longer
+/// split at each instruction boundary. Don't use it if tracing is required.
+class DropNewPCCalls : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  DropNewPCCalls() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnModule(llvm::Module &M) override;
+};
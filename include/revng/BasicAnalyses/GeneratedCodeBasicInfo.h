@@ -5,9 +5,13 @@
 //
 
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
@@ -27,6 +31,9 @@ class MDNode;
 
 static const char *JTReasonMDName = "revng.jt.reasons";
 
+/// Named metadata where GeneratedCodeBasicInfo::persist stores its tables
+static const char *GCBIMDName = "revng.gcbi";
+
 /// \brief Pass to collect basic information about the generated code
 ///
 /// This pass provides useful information for other passes by extracting them
@@ -44,6 +51,8 @@ public:
     InstructionAlignment(0),
     DelaySlotSize(0),
     PC(nullptr),
+    SyscallHelper(nullptr),
+    SyscallNumberRegister(nullptr),
     Dispatcher(nullptr),
     DispatcherFail(nullptr),
     AnyPC(nullptr),
@@ -55,6 +64,19 @@ public:
 
   void run(llvm::Module &M);
 
+  /// \brief Store the dispatcher-related blocks and the jump targets in \p M
+  ///
+  /// Later runs of GCBI on \p M look them up by name in the symbol table of
+  /// the root function, instead of inspecting all of its basic blocks. The
+  /// tables come with a digest of the names of all the basic blocks of the
+  /// root function, and they are ignored if the digest changed in the
+  /// meantime, or if any of the stored blocks has a different type. A pass
+  /// turning a block into a jump target or a dispatcher block without adding
+  /// or renaming any block has to drop the revng.gcbi metadata.
+  ///
+  /// \note Nothing is stored if any of the blocks has no name.
+  void persist(llvm::Module &M) const;
+
   /// \brief Return the type of basic block, see BlockType.
   static BlockType::Values getType(llvm::BasicBlock *BB) {
     return getType(BB->getTerminator());
@@ -87,10 +109,7 @@ public:
       return BlockType::TranslatedBlock;
     }
 
-    auto *BlockTypeMD = cast<MDTuple>(MD);
-
-    QuickMetadata QMD(getContext(T));
-    return BlockType::fromName(QMD.extract<llvm::StringRef>(BlockTypeMD, 0));
+    return BlockType::fromMetadata(MD);
   }
 
   uint32_t getJTReasons(llvm::BasicBlock *BB) const {
@@ -165,6 +184,14 @@ public:
     return false;
   }
 
+  /// \brief Return the helper performing syscalls, if any
+  llvm::Function *syscallHelper() const { return SyscallHelper; }
+
+  /// \brief Return the CSV holding the syscall number, if any
+  llvm::GlobalVariable *syscallNumberRegister() const {
+    return SyscallNumberRegister;
+  }
+
   // TODO: this method should probably be deprecated
   /// \brief Return the CSV representing the program counter
   llvm::GlobalVariable *pcReg() const { return PC; }
@@ -300,6 +327,22 @@ public:
     return Result;
   }
 
+  /// \brief Decoded CSV usage of a helper call, along with dense bitsets
+  ///
+  /// Bit `I` of ReadSet and WrittenSet refers to `csvs()[I]`.
+  struct HelperCallCSVUsage {
+    CSVsUsedByHelperCall Used;
+    llvm::BitVector ReadSet;
+    llvm::BitVector WrittenSet;
+  };
+
+  /// \brief Interned version of getCSVUsedByHelperCall
+  ///
+  /// Call sites sharing the same (uniqued) CSV access metadata share the same
+  /// summary, which is decoded only once. The returned reference stays valid
+  /// as long as this object.
+  const HelperCallCSVUsage &getCSVUsage(llvm::Instruction *Call) const;
+
   const std::vector<llvm::GlobalVariable *> &abiRegisters() const {
     return ABIRegisters;
   }
@@ -327,6 +370,72 @@ public:
 
   llvm::Function *root() const { return RootFunction; }
 
+public:
+  /// \brief Dense, stable index of \p BB in the root function
+  ///
+  /// Indices are assigned in layout order the first time they are requested.
+  /// Basic blocks created later get the next free index on their first
+  /// lookup, so the indices of the existing ones never change. This allows to
+  /// use vectors as side tables instead of maps keyed by pointer, e.g., with
+  /// DenseOnceQueue or EpochSet through BlockIndexer.
+  ///
+  /// \note Call invalidateBlockIndices after erasing basic blocks from the
+  ///       root function, since their addresses could be reused.
+  unsigned getBlockIndex(const llvm::BasicBlock *BB) const {
+    revng_assert(BB->getParent() == RootFunction);
+
+    if (IndexedBlocks.empty())
+      for (llvm::BasicBlock &Block : *RootFunction)
+        indexBlock(&Block);
+
+    auto It = BlockIndices.find(BB);
+    if (It != BlockIndices.end())
+      return It->second;
+
+    return indexBlock(const_cast<llvm::BasicBlock *>(BB));
+  }
+
+  /// \brief The basic block with index \p Index
+  llvm::BasicBlock *getBlock(unsigned Index) const {
+    revng_assert(Index < IndexedBlocks.size());
+    return IndexedBlocks[Index];
+  }
+
+  /// \brief An upper bound on the indices assigned so far
+  unsigned getBlockIndicesCount() const { return IndexedBlocks.size(); }
+
+  void invalidateBlockIndices() {
+    BlockIndices.clear();
+    IndexedBlocks.clear();
+  }
+
+  /// \brief Function object mapping basic blocks to their index
+  struct BlockIndexer {
+    const GeneratedCodeBasicInfo *GCBI = nullptr;
+
+    size_t operator()(const llvm::BasicBlock *BB) const {
+      return GCBI->getBlockIndex(BB);
+    }
+  };
+
+  BlockIndexer blockIndexer() const { return { this }; }
+
+private:
+  /// \brief Collect the dispatcher-related blocks and the jump targets
+  void scanBlocks();
+
+  /// \brief Load what scanBlocks collects from the tables written by persist
+  ///
+  /// \return false if \p M has no tables, or they are stale.
+  bool loadBlocks(llvm::Module &M);
+
+  unsigned indexBlock(llvm::BasicBlock *BB) const {
+    unsigned Index = IndexedBlocks.size();
+    BlockIndices[BB] = Index;
+    IndexedBlocks.push_back(BB);
+    return Index;
+  }
+
 private:
   static std::vector<llvm::GlobalVariable *>
   extractCSVs(llvm::Instruction *Call, unsigned MDKindID) {
@@ -354,11 +463,13 @@ private:
   uint32_t DelaySlotSize;
   llvm::GlobalVariable *PC;
   llvm::GlobalVariable *SP;
+  llvm::Function *SyscallHelper;
+  llvm::GlobalVariable *SyscallNumberRegister;
   llvm::BasicBlock *Dispatcher;
   llvm::BasicBlock *DispatcherFail;
   llvm::BasicBlock *AnyPC;
   llvm::BasicBlock *UnexpectedPC;
-  std::map<MetaAddress, llvm::BasicBlock *> JumpTargets;
+  llvm::DenseMap<MetaAddress, llvm::BasicBlock *> JumpTargets;
   unsigned PCRegSize;
   llvm::Function *RootFunction;
   std::vector<llvm::GlobalVariable *> CSVs;
@@ -367,6 +478,16 @@ private:
   llvm::StructType *MetaAddressStruct;
   llvm::Function *NewPC;
   std::unique_ptr<ProgramCounterHandler> PCH;
+
+  // Lazily computed block numbering, see getBlockIndex
+  mutable llvm::DenseMap<const llvm::BasicBlock *, unsigned> BlockIndices;
+  mutable std::vector<llvm::BasicBlock *> IndexedBlocks;
+
+  // Interned CSV usage summaries, keyed by the load and store metadata
+  using CSVUsageKey = std::pair<const llvm::MDNode *, const llvm::MDNode *>;
+  llvm::DenseMap<const llvm::GlobalVariable *, unsigned> CSVIndices;
+  mutable llvm::DenseMap<CSVUsageKey, unsigned> CSVUsageIndices;
+  mutable std::deque<HelperCallCSVUsage> CSVUsages;
 };
 
 template<>
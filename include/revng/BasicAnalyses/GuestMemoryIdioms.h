@@ -0,0 +1,35 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Turn the loops filling or copying guest memory into memset/memmove
+///
+/// Guest memory is accessed through `inttoptr` of integer addresses, which
+/// hides the loops implementing `rep stos`, `rep movs` or a hand-written
+/// memset/memcpy from LLVM's LoopIdiomRecognize. This pass looks at the
+/// single-block loops whose only guest memory accesses are a store (and,
+/// possibly, the load feeding it) to an address advancing of its size at each
+/// iteration, and replaces them with `llvm.memset` (or `llvm.memmove`) before
+/// the loop. Accesses to CSVs are allowed in the loop, since they never alias
+/// guest memory.
+///
+/// A copy is equivalent to `memmove` unless the destination is inside the
+/// source range, ahead of the direction of the copy: in that case the
+/// original loop is executed. Run it after -O2, so that the loops are in
+/// canonical form and the CSVs have been promoted, followed by
+/// `-loop-deletion` to drop the loops left empty.
+class GuestMemoryIdioms : public llvm::FunctionPass {
+public:
+  static char ID;
+
+public:
+  GuestMemoryIdioms() : llvm::FunctionPass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnFunction(llvm::Function &F) override;
+};
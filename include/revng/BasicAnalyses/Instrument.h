@@ -0,0 +1,96 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Pass.h"
+
+/// \brief The callbacks an instrumentation plugin wants in the lifted code
+///
+/// Each callback is the name of a function of the instrumentation runtime, a
+/// module provided by the user and linked together with the lifted code (see
+/// `revng translate --instrument-runtime`). The calls are plain direct calls,
+/// so that, once linked, the optimizer can inline them. PCs are passed as the
+/// integer value of the address.
+class InstrumentationCallbacks {
+  friend class Instrument;
+
+public:
+  /// \brief Call `void Callback(uint64_t PC)` at each jump target
+  void onBlockEntry(llvm::StringRef Callback) {
+    BlockEntry.push_back(Callback.str());
+  }
+
+  /// \brief Call `void Callback(uint64_t PC, uint64_t Size)` at each
+  ///        instruction
+  void onNewPC(llvm::StringRef Callback) { NewPC.push_back(Callback.str()); }
+
+  /// \brief Call `void Callback(uint64_t PC)` before each call to a helper
+  ///        whose name starts with \p Prefix
+  void onHelperCall(llvm::StringRef Prefix, llvm::StringRef Callback) {
+    HelperCall.emplace_back(Prefix.str(), Callback.str());
+  }
+
+  /// \brief Call `void Callback(uint64_t PC, uint64_t Number)` before each
+  ///        syscall
+  void onSyscall(llvm::StringRef Callback) {
+    Syscall.push_back(Callback.str());
+  }
+
+private:
+  std::vector<std::string> BlockEntry;
+  std::vector<std::string> NewPC;
+  std::vector<std::pair<std::string, std::string>> HelperCall;
+  std::vector<std::string> Syscall;
+};
+
+/// \brief Base class of the instrumentation plugins
+///
+/// A plugin is a shared library loaded with `-load`, registering its
+/// implementation of this class with a static RegisterInstrumentation object:
+///
+///     class CountSyscalls : public InstrumentationPlugin {
+///     public:
+///       void registerCallbacks(InstrumentationCallbacks &C) override {
+///         C.onSyscall("count_syscall");
+///       }
+///     };
+///
+///     static RegisterInstrumentation<CountSyscalls> X;
+class InstrumentationPlugin {
+public:
+  virtual ~InstrumentationPlugin() {}
+
+  virtual void registerCallbacks(InstrumentationCallbacks &Callbacks) = 0;
+};
+
+void registerInstrumentationPlugin(std::unique_ptr<InstrumentationPlugin> P);
+
+template<typename T>
+struct RegisterInstrumentation {
+  RegisterInstrumentation() {
+    registerInstrumentationPlugin(std::make_unique<T>());
+  }
+};
+
+/// \brief Insert in the root function the callbacks of the loaded plugins
+///
+/// Has to run before the newpc calls are dropped.
+class Instrument : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  Instrument() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnModule(llvm::Module &M) override;
+};
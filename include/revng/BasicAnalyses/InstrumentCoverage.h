@@ -0,0 +1,26 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Count how many times each jump target is executed at run-time
+///
+/// Each jump target in the root function increments its own entry of the
+/// `revng_coverage_counters` array. The corresponding PCs, in their PC
+/// representation (e.g., with the LSB set for Thumb code), are stored in
+/// `revng_coverage_pcs` and the number of entries in `revng_coverage_count`.
+/// The runtime dumps them to `REVNG_COVERAGE_PATH` at exit.
+class InstrumentCoverage : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  InstrumentCoverage() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnModule(llvm::Module &M) override;
+};
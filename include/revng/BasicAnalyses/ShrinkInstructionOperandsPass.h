@@ -4,6 +4,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/DemandedBits.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Pass.h"
+
 #include "revng/Support/IRHelpers.h"
 
 enum Signedness { DontCare, Signed, Unsigned };
@@ -55,6 +63,150 @@ inline void replaceAndResizeOperand(llvm::Instruction *I,
   I->setOperand(Index, NewOperand);
 }
 
+/// \brief Return the size sufficient to compute the demanded bits of \p I, or 0
+///
+/// Only instructions whose lower bits depend exclusively on the lower bits of
+/// their operands are considered. The size is rounded up to a power of two of
+/// at least 8 bits, and 0 is returned if it wouldn't be smaller than the
+/// current one.
+inline unsigned getDemandedSize(llvm::DemandedBits &DB, llvm::Instruction *I) {
+  using namespace llvm;
+
+  unsigned Size = getSize(I);
+  if (Size == 0)
+    return 0;
+
+  switch (I->getOpcode()) {
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Add:
+  case Instruction::Mul:
+  case Instruction::Sub:
+  case Instruction::PHI:
+  case Instruction::Select:
+    break;
+
+  default:
+    return 0;
+  }
+
+  // Instructions with no demanded bits are dead, leave them to DCE
+  unsigned ActiveBits = DB.getDemandedBits(I).getActiveBits();
+  if (ActiveBits == 0)
+    return 0;
+
+  unsigned NewSize = std::max<uint64_t>(8, llvm::PowerOf2Ceil(ActiveBits));
+  return NewSize < Size ? NewSize : 0;
+}
+
+/// \brief Obtain the lower \p NewSize bits of \p V, looking through extensions
+inline llvm::Value *
+narrowOperand(llvm::IRBuilder<> &Builder, llvm::Value *V, unsigned NewSize) {
+  using namespace llvm;
+
+  Type *NewType = Builder.getIntNTy(NewSize);
+  if (isa<ZExtInst>(V) or isa<SExtInst>(V)) {
+    auto *Extension = cast<CastInst>(V);
+    Value *Source = Extension->getOperand(0);
+    unsigned SourceSize = getSize(Source);
+    if (SourceSize == NewSize)
+      return Source;
+    else if (SourceSize > NewSize)
+      return Builder.CreateTrunc(Source, NewType);
+    else
+      return Builder.CreateCast(Extension->getOpcode(), Source, NewType);
+  }
+
+  return Builder.CreateTrunc(V, NewType);
+}
+
+/// \brief Compute each instruction of \p F on the bits actually demanded
+///
+/// The narrowed instruction is zero-extended back to the original size, so
+/// that users that are narrowed too can look through the extension. This way
+/// sizes propagate along chains of instructions and through phis.
+inline void shrinkWholeFunction(llvm::Function &F, llvm::DemandedBits &DB) {
+  using namespace llvm;
+
+  // Take all the decisions first, DemandedBits is not updated as we go.
+  // Visiting in reverse post order ensures that, with the exception of
+  // incoming values of phis, operands are narrowed before their users.
+  std::vector<std::pair<Instruction *, unsigned>> ToShrink;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT)
+    for (Instruction &I : *BB)
+      if (unsigned NewSize = getDemandedSize(DB, &I))
+        ToShrink.emplace_back(&I, NewSize);
+
+  for (auto &[I, NewSize] : ToShrink) {
+    Instruction *Narrow = nullptr;
+    Instruction *InsertPoint = I;
+
+    if (auto *Phi = dyn_cast<PHINode>(I)) {
+      auto *NewType = IntegerType::get(F.getContext(), NewSize);
+      unsigned Count = Phi->getNumIncomingValues();
+      auto *NewPhi = PHINode::Create(NewType, Count, "", Phi);
+
+      // A predecessor can appear multiple times (e.g., a switch with multiple
+      // cases to the same block), and all its entries must have the same
+      // value: narrow the incoming value only once per predecessor
+      std::map<BasicBlock *, Value *> Narrowed;
+      for (unsigned Index = 0; Index < Count; ++Index) {
+        BasicBlock *Predecessor = Phi->getIncomingBlock(Index);
+        Value *&NarrowIncoming = Narrowed[Predecessor];
+        if (NarrowIncoming == nullptr) {
+          IRBuilder<> Builder(Predecessor->getTerminator());
+          Value *Incoming = Phi->getIncomingValue(Index);
+          NarrowIncoming = narrowOperand(Builder, Incoming, NewSize);
+        }
+        NewPhi->addIncoming(NarrowIncoming, Predecessor);
+      }
+      Narrow = NewPhi;
+      InsertPoint = &*Phi->getParent()->getFirstInsertionPt();
+    } else {
+      IRBuilder<> Builder(I);
+      if (auto *Select = dyn_cast<SelectInst>(I)) {
+        Value *True = narrowOperand(Builder, Select->getTrueValue(), NewSize);
+        Value *False = narrowOperand(Builder, Select->getFalseValue(), NewSize);
+        Narrow = SelectInst::Create(Select->getCondition(), True, False, "", I);
+      } else {
+        auto *Binary = cast<BinaryOperator>(I);
+        Value *Op0 = narrowOperand(Builder, Binary->getOperand(0), NewSize);
+        Value *Op1 = narrowOperand(Builder, Binary->getOperand(1), NewSize);
+
+        // Note: nuw/nsw flags are not valid on the narrower operation
+        Narrow = BinaryOperator::Create(Binary->getOpcode(), Op0, Op1, "", I);
+      }
+    }
+
+    Narrow->takeName(I);
+    I->replaceAllUsesWith(new ZExtInst(Narrow, I->getType(), "", InsertPoint));
+    I->eraseFromParent();
+  }
+
+  // Incoming values of phis coming from later instructions have been
+  // truncated before being narrowed, collapse the resulting trunc(zext(x))
+  if (ToShrink.size() == 0)
+    return;
+
+  std::vector<Instruction *> ToErase;
+  for (Instruction &I : instructions(F)) {
+    if (auto *Trunc = dyn_cast<TruncInst>(&I)) {
+      if (auto *Extension = dyn_cast<ZExtInst>(Trunc->getOperand(0))) {
+        Value *Source = Extension->getOperand(0);
+        if (Source->getType() == Trunc->getType()) {
+          Trunc->replaceAllUsesWith(Source);
+          ToErase.push_back(Trunc);
+        }
+      }
+    }
+  }
+
+  for (Instruction *I : ToErase)
+    I->eraseFromParent();
+}
+
 /// \brief Transformation to shrink operand sizes where possible
 ///
 /// This pass shrinks the operand of binary operators and comparison
@@ -73,15 +225,25 @@ inline void replaceAndResizeOperand(llvm::Instruction *I,
 ///
 /// This enables other analyses (LazyValueInfo in particular) to obtain more
 /// accurate results.
+///
+/// If \p WholeFunction is set, after handling the local patterns above,
+/// DemandedBits is used to compute each instruction of the function on the
+/// bits that are actually demanded by its users (see shrinkWholeFunction).
 class ShrinkInstructionOperandsPass
   : public llvm::PassInfoMixin<ShrinkInstructionOperandsPass> {
+private:
+  bool WholeFunction;
+
+public:
+  ShrinkInstructionOperandsPass(bool WholeFunction = false) :
+    WholeFunction(WholeFunction) {}
 
 public:
   llvm::PreservedAnalyses
   run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
 };
 
-llvm::PreservedAnalyses
+inline llvm::PreservedAnalyses
 ShrinkInstructionOperandsPass::run(llvm::Function &F,
                                    llvm::FunctionAnalysisManager &FAM) {
   using namespace llvm;
@@ -175,5 +337,27 @@ ShrinkInstructionOperandsPass::run(llvm::Function &F,
     }
   }
 
+  if (WholeFunction)
+    shrinkWholeFunction(F, FAM.getResult<DemandedBitsAnalysis>(F));
+
   return PreservedAnalyses::none();
 }
+
+/// \brief Compute each instruction on the bits actually demanded
+///
+/// This runs shrinkWholeFunction in the legacy pass manager, so that it can be
+/// applied to the translated program too, see `revng translate
+/// --shrink-whole-functions`.
+class ShrinkToDemandedBitsPass : public llvm::FunctionPass {
+public:
+  static char ID;
+
+public:
+  ShrinkToDemandedBitsPass() : llvm::FunctionPass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.addRequired<llvm::DemandedBitsWrapperPass>();
+  }
+
+  bool runOnFunction(llvm::Function &F) override;
+};
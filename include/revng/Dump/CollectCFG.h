@@ -5,12 +5,29 @@
 //
 
 #include <fstream>
-#include <map>
 #include <set>
+#include <vector>
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/IR/BasicBlock.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/MetaAddress.h"
+
+namespace CFGFormat {
+
+/// \brief Output formats of CollectCFG
+enum Values {
+  /// "source,destination" lines with the names of the basic blocks
+  CSV,
+  /// Varint-encoded address deltas, see CollectCFG::serializeBinary
+  Binary
+};
+
+} // namespace CFGFormat
 
 template<typename T>
 struct CompareByName {
@@ -32,10 +49,33 @@ public:
     AU.setPreservesAll();
   }
 
+  /// \brief Write the CFG as CSV, sorted by the name of the basic blocks
+  ///
+  /// The edges of each source are written as soon as they are collected, the
+  /// whole CFG is never kept in memory.
   void serialize(std::ostream &Output);
 
-private:
-  bool isNewInstruction(llvm::BasicBlock *BB);
+  /// \brief Write the CFG in a compact binary format
+  ///
+  /// The format starts with the "rcfg" magic and a ULEB128 version number,
+  /// followed by a record for each source basic block, sorted by address:
+  ///
+  /// * ULEB128 delta of the address w.r.t. the previous source;
+  /// * ULEB128 tag of the source (see below);
+  /// * ULEB128 number of destinations;
+  /// * for each destination, the SLEB128 delta of its address w.r.t. the
+  ///   source, followed by its ULEB128 tag.
+  ///
+  /// The tag of an address packs its type, address space and epoch, which
+  /// makes it a single byte in the common case.
+  void serializeBinary(llvm::raw_ostream &Output);
+
+  using EdgeCallback = llvm::function_ref<void(MetaAddress, MetaAddress)>;
+
+  /// \brief Decode a CFG produced by serializeBinary
+  ///
+  /// \return false if \p Buffer is malformed.
+  static bool readBinary(llvm::StringRef Buffer, EdgeCallback OnEdge);
 
 private:
   using BasicBlock = llvm::BasicBlock;
@@ -43,7 +83,17 @@ private:
   template<typename T, size_t N>
   using SmallVector = llvm::SmallVector<T, N>;
 
-  using Comparer = CompareByName<BasicBlock>;
-  std::map<BasicBlock *, SmallVector<BasicBlock *, 2>, Comparer> Result;
+private:
+  bool isNewInstruction(BasicBlock *BB);
+
+  /// \brief Collect the new instructions reachable from \p Source without
+  ///        going through other new instructions, sorted by name
+  void collectDestinations(BasicBlock *Source,
+                           llvm::SmallVectorImpl<BasicBlock *> &Destinations);
+
+  std::vector<BasicBlock *> sources();
+
+private:
+  llvm::Function *Root = nullptr;
   std::set<BasicBlock *> BlackList;
 };
@@ -51,11 +51,25 @@ public:
     return isFallthrough(I->getParent());
   }
 
+  const std::set<MetaAddress> &fallthroughAddresses() const {
+    return FallthroughAddresses;
+  }
+
+  /// \brief Return addresses of the calls marked by the last run
+  const std::vector<MetaAddress> &newFallthroughAddresses() const {
+    return NewFallthroughAddresses;
+  }
+
+  /// \brief True if the last run met calls marked by previous runs
+  bool foundMarkedCalls() const { return FoundMarkedCalls; }
+
 private:
   void buildFilteredCFG(llvm::Function &F);
 
 private:
   llvm::Function *FunctionCall;
   std::set<MetaAddress> FallthroughAddresses;
+  std::vector<MetaAddress> NewFallthroughAddresses;
+  bool FoundMarkedCalls = false;
   CustomCFG FilteredCFG;
 };
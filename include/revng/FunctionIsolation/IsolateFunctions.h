@@ -5,10 +5,12 @@
 //
 
 #include <memory>
+#include <set>
 
 #include "llvm/Pass.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Support/MetaAddress.h"
 
 class IsolateFunctions : public llvm::ModulePass {
 public:
@@ -17,10 +19,26 @@ public:
 public:
   IsolateFunctions() : ModulePass(ID) {}
 
+  /// \brief Isolate only the functions whose entry point is in \p Entries
+  ///
+  /// The other functions are left in the root function. Calls and jumps to
+  /// them from an isolated function raise an exception, as any other jump to
+  /// code outside of the current function.
+  ///
+  /// \param WithCallees also isolate the functions transitively called by the
+  ///        requested ones.
+  IsolateFunctions(std::set<MetaAddress> Entries, bool WithCallees) :
+    ModulePass(ID), Entries(std::move(Entries)), WithCallees(WithCallees) {}
+
   bool runOnModule(llvm::Module &M) override;
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
     AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
   }
+
+private:
+  /// Entry points of the functions to isolate, empty means all of them
+  std::set<MetaAddress> Entries;
+  bool WithCallees = false;
 };
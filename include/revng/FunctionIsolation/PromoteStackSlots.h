@@ -0,0 +1,33 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Promote the private stack slots of isolated functions to allocas
+///
+/// An isolated function accesses its stack frame as guest memory, through the
+/// stack pointer CSV. This pass tracks, for each program point, the offset of
+/// the stack pointer (and of any CSV or local variable derived from it) from
+/// its value at the function entry. If the stack pointer never escapes (it's
+/// not stored in memory, nor passed to a call) and each access through it has
+/// a known offset, the accesses below the entry stack pointer are redirected
+/// to an `alloca`, which SROA and mem2reg can then turn into SSA values.
+///
+/// The frame is copied from guest memory at the function entry and copied
+/// back before returning or raising an exception, so that the guest memory
+/// stays consistent. Only functions not calling other functions are
+/// considered.
+class PromoteStackSlots : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  PromoteStackSlots() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnModule(llvm::Module &M) override;
+};
@@ -7,7 +7,6 @@
 #include "llvm/ADT/SmallString.h"
 
 #include "revng/ADT/KeyedObjectContainer.h"
-#include "revng/ADT/MutableSet.h"
 #include "revng/ADT/SortedVector.h"
 #include "revng/Model/TupleTree.h"
 #include "revng/Support/MetaAddress.h"
@@ -254,14 +253,18 @@ struct KeyedObjectTraits<model::Function> {
   };
 };
 
-static_assert(is_KeyedObjectContainer_v<MutableSet<model::Function>>);
+static_assert(is_KeyedObjectContainer_v<SortedVector<model::Function>>);
 
 //
 // Binary
 //
 class model::Binary {
 public:
-  MutableSet<model::Function> Functions;
+  /// \note Functions are stored in a flat sorted array, which makes iterating
+  ///       over them (serialization, diffing) cache friendly. As for
+  ///       Function::CFG, inserting a new function invalidates references to
+  ///       the other ones.
+  SortedVector<model::Function> Functions;
 };
 INTROSPECTION_NS(model, Binary, Functions)
 
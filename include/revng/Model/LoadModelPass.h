@@ -4,12 +4,22 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/Model/Binary.h"
 
 inline const char *ModelMetadataName = "revng.model";
 
+/// \brief Maximum number of model diffs to keep in the IR before compacting
+///
+/// The first operand of the revng.model named metadata is always a full
+/// model, the following ones, if any, are diffs to apply to it in order.
+extern llvm::cl::opt<unsigned> MaxModelDiffs;
+
 class LoadModelPass : public llvm::ImmutablePass {
 public:
   static char ID;
@@ -18,6 +28,13 @@ private:
   model::Binary TheBinary;
   bool Modified = false;
 
+  /// Copy of the model as loaded, to compute the diff against, if
+  /// MaxModelDiffs allows diffs
+  llvm::Optional<model::Binary> Original;
+
+  /// The full model and the diffs it has been loaded from
+  std::vector<llvm::MDNode *> Serialized;
+
 public:
   LoadModelPass() : llvm::ImmutablePass(ID) {}
 
@@ -29,10 +46,37 @@ public:
   bool hasChanged() const { return Modified; }
 
   const model::Binary &getReadOnlyModel() { return TheBinary; }
+
+  /// The model as it was before any change, if diffs are enabled
+  const model::Binary *getOriginalModel() const {
+    return Original ? &*Original : nullptr;
+  }
+
+  llvm::ArrayRef<llvm::MDNode *> getSerializedModel() const {
+    return Serialized;
+  }
+
   model::Binary &getWriteableModel() {
     Modified = true;
     return TheBinary;
   }
 
   static model::Binary getModel(const llvm::Module &M);
+
+  /// \brief Obtain a single function from the model serialized in \p M
+  ///
+  /// If the model has been serialized with the binary encoding, only the
+  /// requested function is decoded. This is meant for code not running in a
+  /// pipeline with LoadModelPass, which removes the serialized model.
+  static llvm::Optional<model::Function>
+  getFunction(const llvm::Module &M, const MetaAddress &Entry);
+
+  /// \brief Invoke \p Callback on each function of the model serialized in
+  ///        \p M, in order
+  ///
+  /// If the model has been serialized with the binary encoding, and there are
+  /// no diffs, only one function at a time is decoded.
+  static void
+  forEachFunction(const llvm::Module &M,
+                  llvm::function_ref<void(const model::Function &)> Callback);
 };
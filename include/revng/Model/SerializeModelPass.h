@@ -9,6 +9,18 @@
 #include "revng/Model/Binary.h"
 #include "revng/Model/LoadModelPass.h"
 
+namespace ModelEncoding {
+
+/// \brief Encodings of the model in the IR
+enum Values {
+  /// Human readable, the default
+  YAML,
+  /// Compact and faster to load, see TupleTreeBinary.h
+  Binary
+};
+
+} // namespace ModelEncoding
+
 class SerializeModelPass : public llvm::ModulePass {
 public:
   static char ID;
@@ -4,12 +4,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <array>
+#include <functional>
+#include <optional>
 #include <set>
 #include <type_traits>
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/YAMLTraits.h"
 
 #include "revng/ADT/KeyTraits.h"
@@ -341,11 +345,17 @@ callOnPathSteps(Visitor &V, llvm::ArrayRef<KeyInt> Path, RootT &M) {
   auto TargetKey = KeyTraits<key_type>::fromInts(PathStep);
 
   value_type *Matching = nullptr;
-  for (value_type &Element : M) {
-    using KOT = KeyedObjectTraits<value_type>;
-    if (KOT::key(Element) == TargetKey) {
-      Matching = &Element;
-      break;
+  if constexpr (is_KeyedObjectContainer_v<RootT>) {
+    auto It = M.find(TargetKey);
+    if (It != M.end())
+      Matching = &*It;
+  } else {
+    for (value_type &Element : M) {
+      using KOT = KeyedObjectTraits<value_type>;
+      if (KOT::key(Element) == TargetKey) {
+        Matching = &Element;
+        break;
+      }
     }
   }
 
@@ -704,6 +714,222 @@ ResultT *getByPath(llvm::StringRef Path, RootT &M) {
     return getByPath<ResultT>(*MaybeKeyVector, M);
 }
 
+//
+// CompiledPath
+//
+
+namespace tupletree::detail {
+
+/// The address of TypeTag<T> identifies T, without RTTI
+template<typename T>
+inline const char TypeTag = 0;
+
+} // namespace tupletree::detail
+
+/// \brief A path in a tuple tree rooted in RootT, resolved once
+///
+/// getByPath decodes the path at each access, looking for the right field and
+/// decoding the keys. A CompiledPath does it upon construction: it's a list of
+/// steps, each one either picking a field or looking up a typed key in a
+/// container. Applying it to a tree is then only a matter of following the
+/// steps.
+///
+/// Paths are ordered as the KeyIntVector they come from: sorting them brings
+/// together the paths sharing a prefix (e.g., the changes to the same
+/// function), see CompiledPathSweep.
+template<typename RootT>
+class CompiledPath {
+private:
+  template<typename>
+  friend class CompiledPathSweep;
+
+  struct Step {
+    /// Given the object reached by the previous step, return the next one or
+    /// nullptr
+    std::function<void *(void *)> Resolve;
+
+    /// Index in Path where this step ends
+    size_t End;
+  };
+
+  class CompileVisitor;
+
+private:
+  KeyIntVector Path;
+  llvm::SmallVector<Step, 4> Steps;
+  const void *Target = &tupletree::detail::TypeTag<RootT>;
+
+private:
+  CompiledPath() = default;
+
+public:
+  static std::optional<CompiledPath> compile(const KeyIntVector &Path);
+
+  static std::optional<CompiledPath> compile(llvm::StringRef Path) {
+    auto MaybeKeyVector = stringAsPath<RootT>(Path);
+    if (not MaybeKeyVector)
+      return {};
+    return compile(*MaybeKeyVector);
+  }
+
+public:
+  const KeyIntVector &path() const { return Path; }
+
+  /// \brief Check if the path leads to an object of type \p T
+  template<typename T>
+  bool targets() const {
+    return Target == &tupletree::detail::TypeTag<T>;
+  }
+
+  /// \brief Return the object at the end of the path in \p Root, if any
+  template<typename ResultT>
+  ResultT *lookup(RootT &Root) const {
+    revng_assert(targets<ResultT>());
+    return static_cast<ResultT *>(resolve(&Root, 0));
+  }
+
+  bool operator<(const CompiledPath &Other) const { return Path < Other.Path; }
+  bool operator==(const CompiledPath &Other) const {
+    return Path == Other.Path;
+  }
+
+private:
+  void *resolve(void *Object, size_t FirstStep) const {
+    for (size_t I = FirstStep; I < Steps.size() and Object != nullptr; ++I)
+      Object = Steps[I].Resolve(Object);
+    return Object;
+  }
+
+  template<typename T, size_t I>
+  void addTupleStep() {
+    using element = std::tuple_element_t<I, T>;
+    auto Resolve = [](void *Object) -> void * {
+      return &get<I>(*static_cast<T *>(Object));
+    };
+    Steps.push_back({ Resolve, Steps.empty() ? 1 : Steps.back().End + 1 });
+    Target = &tupletree::detail::TypeTag<element>;
+  }
+
+  template<typename T, typename KeyT>
+  void addContainerStep(KeyT Key) {
+    using value_type = typename T::value_type;
+    auto Resolve = [Key](void *Object) -> void * {
+      T &Container = *static_cast<T *>(Object);
+      if constexpr (is_KeyedObjectContainer_v<T>) {
+        auto It = Container.find(Key);
+        return It == Container.end() ? nullptr : &*It;
+      } else {
+        using KOT = KeyedObjectTraits<value_type>;
+        for (value_type &Element : Container)
+          if (KOT::key(Element) == Key)
+            return &Element;
+        return nullptr;
+      }
+    };
+
+    constexpr size_t IntsCount = KeyTraits<KeyT>::IntsCount;
+    size_t Start = Steps.empty() ? 0 : Steps.back().End;
+    Steps.push_back({ Resolve, Start + IntsCount });
+    Target = &tupletree::detail::TypeTag<value_type>;
+  }
+};
+
+template<typename RootT>
+class CompiledPath<RootT>::CompileVisitor {
+public:
+  CompiledPath &Result;
+
+public:
+  template<typename T, int I>
+  void visitTupleElement() {
+    Result.template addTupleStep<T, I>();
+  }
+
+  template<typename T, typename KeyT>
+  void visitContainerElement(KeyT Key) {
+    Result.template addContainerStep<T>(Key);
+  }
+};
+
+template<typename RootT>
+std::optional<CompiledPath<RootT>>
+CompiledPath<RootT>::compile(const KeyIntVector &Path) {
+  CompiledPath Result;
+  Result.Path = Path;
+  if (not Path.empty()) {
+    CompileVisitor Visitor{ Result };
+    if (not callOnPathSteps<RootT>(Visitor, Path))
+      return {};
+  }
+
+  // Reject paths with a wrong field index, which stop being visited early
+  size_t Resolved = Result.Steps.empty() ? 0 : Result.Steps.back().End;
+  if (Resolved != Path.size())
+    return {};
+
+  return Result;
+}
+
+/// \brief Resolve a sequence of CompiledPath on the same tree
+///
+/// Each path is resolved starting from the deepest object it has in common
+/// with the previous one, so that a sorted sequence of paths visits each
+/// object once.
+///
+/// \note If an object is changed through a path, the following paths must not
+///       go through the objects it contains that might have been reallocated.
+///       This holds when each change only affects the object at the end of its
+///       path (as for TupleTreeDiff) and the paths are sorted.
+template<typename RootT>
+class CompiledPathSweep {
+private:
+  RootT &Root;
+
+  /// The last path successfully resolved
+  KeyIntVector LastPath;
+
+  /// Objects reached by each step of LastPath
+  llvm::SmallVector<void *, 8> Chain;
+
+public:
+  CompiledPathSweep(RootT &Root) : Root(Root) {}
+
+  template<typename ResultT>
+  ResultT *lookup(const CompiledPath<RootT> &Path) {
+    revng_assert(Path.template targets<ResultT>());
+
+    // Find the steps in common with the previous path: since they start from
+    // the same root, the same prefix implies the same steps
+    const KeyIntVector &Ints = Path.Path;
+    size_t Size = std::min(LastPath.size(), Ints.size());
+    auto Mismatch = std::mismatch(Ints.begin(),
+                                  Ints.begin() + Size,
+                                  LastPath.begin());
+    size_t Equal = Mismatch.first - Ints.begin();
+
+    size_t Common = 0;
+    size_t MaxCommon = std::min(Chain.size(), Path.Steps.size());
+    while (Common < MaxCommon and Path.Steps[Common].End <= Equal)
+      ++Common;
+
+    Chain.resize(Common);
+    void *Object = Common == 0 ? &Root : Chain.back();
+    for (size_t I = Common; I < Path.Steps.size() and Object != nullptr; ++I) {
+      Object = Path.Steps[I].Resolve(Object);
+      Chain.push_back(Object);
+    }
+
+    if (Object != nullptr) {
+      LastPath = Ints;
+    } else {
+      LastPath.clear();
+      Chain.clear();
+    }
+
+    return static_cast<ResultT *>(Object);
+  }
+};
+
 //
 // FOR_EACH macro implemenation
 //
@@ -0,0 +1,372 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+#include <type_traits>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/ADT/KeyTraits.h"
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/KeyedObjectTraits.h"
+#include "revng/Support/Assert.h"
+
+/// \brief Compact binary encoding of tuple trees
+///
+/// The encoding is driven by the same reflection used for YAML:
+///
+/// * tuple-like objects emit their fields in order, without names;
+/// * containers emit the number of elements followed by, for each element,
+///   its key (as in KeyTraits), the size in bytes of the element and then the
+///   element itself;
+/// * strings emit their size followed by their content;
+/// * integers and enums are emitted as ULEB128;
+/// * all the other types are emitted as the integers of their KeyTraits.
+///
+/// Thanks to the size of the elements, a single element can be looked up (see
+/// getByPath) by skipping over the others, without materializing them.
+///
+/// The encoding is not meant to be stable across versions of the model, use
+/// YAML for that.
+namespace tupletree::binary {
+
+/// Prefix of all the binary-encoded tuple trees, it can never appear at the
+/// beginning of a YAML document
+inline const llvm::StringRef Magic("\0RVNGTT\1", 8);
+
+inline bool isBinary(llvm::StringRef Buffer) {
+  return Buffer.startswith(Magic);
+}
+
+namespace detail {
+
+inline void writeInt(llvm::raw_ostream &Output, uint64_t Value) {
+  llvm::encodeULEB128(Value, Output);
+}
+
+template<typename T>
+void writeKey(llvm::raw_ostream &Output, const T &Key) {
+  for (KeyInt Int : KeyTraits<T>::toInts(Key))
+    writeInt(Output, Int);
+}
+
+template<typename T>
+void write(llvm::raw_ostream &Output, const T &Value);
+
+template<typename T, size_t I = 0>
+void writeTuple(llvm::raw_ostream &Output, const T &Value) {
+  if constexpr (I < std::tuple_size_v<T>) {
+    write(Output, get<I>(Value));
+    writeTuple<T, I + 1>(Output, Value);
+  }
+}
+
+template<typename T>
+void write(llvm::raw_ostream &Output, const T &Value) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    writeInt(Output, Value.size());
+    Output << Value;
+  } else if constexpr (has_tuple_size_v<T>) {
+    writeTuple(Output, Value);
+  } else if constexpr (is_container_v<T>) {
+    using value_type = typename T::value_type;
+    using KOT = KeyedObjectTraits<value_type>;
+    writeInt(Output, Value.size());
+    for (const value_type &Element : Value) {
+      writeKey(Output, KOT::key(Element));
+
+      llvm::SmallString<64> Buffer;
+      {
+        llvm::raw_svector_ostream ElementStream(Buffer);
+        write(ElementStream, Element);
+      }
+      writeInt(Output, Buffer.size());
+      Output << Buffer;
+    }
+  } else if constexpr (std::is_integral_v<T> or std::is_enum_v<T>) {
+    writeInt(Output, static_cast<uint64_t>(Value));
+  } else {
+    writeKey(Output, Value);
+  }
+}
+
+class Reader {
+private:
+  const uint8_t *Current;
+  const uint8_t *End;
+
+public:
+  Reader(llvm::StringRef Buffer) :
+    Current(Buffer.bytes_begin()), End(Buffer.bytes_end()) {}
+
+public:
+  bool atEnd() const { return Current == End; }
+
+  uint64_t readInt() {
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    uint64_t Result = llvm::decodeULEB128(Current, &Size, End, &Error);
+    revng_check(Error == nullptr, "Malformed binary tuple tree");
+    Current += Size;
+    return Result;
+  }
+
+  llvm::StringRef readBytes(uint64_t Size) {
+    revng_check(Size <= static_cast<uint64_t>(End - Current),
+                "Truncated binary tuple tree");
+    llvm::StringRef Result(reinterpret_cast<const char *>(Current), Size);
+    Current += Size;
+    return Result;
+  }
+
+  template<typename T>
+  typename KeyTraits<T>::IntsArray readKeyInts() {
+    typename KeyTraits<T>::IntsArray Ints;
+    for (KeyInt &Int : Ints)
+      Int = readInt();
+    return Ints;
+  }
+
+  template<typename T>
+  T readKey() {
+    return KeyTraits<T>::fromInts(readKeyInts<T>());
+  }
+
+  template<typename T>
+  void read(T &Value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      Value = readBytes(readInt()).str();
+    } else if constexpr (has_tuple_size_v<T>) {
+      readTuple(Value);
+    } else if constexpr (is_container_v<T>) {
+      using value_type = typename T::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = std::remove_cv_t<decltype(KOT::key(
+        std::declval<value_type>()))>;
+
+      // Elements have been emitted sorted by key, therefore each insertion
+      // happens at the end
+      uint64_t Size = readInt();
+      for (uint64_t I = 0; I < Size; ++I) {
+        value_type &Element = Value[readKey<key_type>()];
+        Reader ElementReader(readBytes(readInt()));
+        ElementReader.read(Element);
+        revng_check(ElementReader.atEnd(), "Malformed binary tuple tree");
+      }
+    } else if constexpr (std::is_integral_v<T> or std::is_enum_v<T>) {
+      Value = static_cast<T>(readInt());
+    } else {
+      Value = readKey<T>();
+    }
+  }
+
+  /// \brief Move past an object of type \p T without materializing it
+  template<typename T>
+  void skip() {
+    if constexpr (std::is_same_v<T, std::string>) {
+      readBytes(readInt());
+    } else if constexpr (has_tuple_size_v<T>) {
+      skipTuple<T>();
+    } else if constexpr (is_container_v<T>) {
+      using value_type = typename T::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = std::remove_cv_t<decltype(KOT::key(
+        std::declval<value_type>()))>;
+
+      uint64_t Size = readInt();
+      for (uint64_t I = 0; I < Size; ++I) {
+        readKeyInts<key_type>();
+        readBytes(readInt());
+      }
+    } else if constexpr (std::is_integral_v<T> or std::is_enum_v<T>) {
+      readInt();
+    } else {
+      readKeyInts<T>();
+    }
+  }
+
+  /// \brief Decode into \p Result the object of type \p ResultT at \p Path
+  ///        in the object of type \p T starting at the current position
+  ///
+  /// \return false if \p Path does not exist or does not lead to a
+  ///         \p ResultT.
+  template<typename T, typename ResultT>
+  bool readByPath(llvm::ArrayRef<KeyInt> Path, ResultT &Result) {
+    return visitByPath<T>(Path, [&Result](Reader &R, auto *Tag) {
+      if constexpr (std::is_same_v<std::remove_pointer_t<decltype(Tag)>,
+                                   ResultT>) {
+        R.read(Result);
+        return true;
+      } else {
+        return false;
+      }
+    });
+  }
+
+  /// \brief Decode one at a time the elements of the container of
+  ///        \p ElementT at \p Path and pass them to \p Callback
+  ///
+  /// Only one element at a time is materialized.
+  ///
+  /// \return false if \p Path does not exist or does not lead to a container
+  ///         of \p ElementT.
+  template<typename T, typename ElementT, typename CallbackT>
+  bool forEachByPath(llvm::ArrayRef<KeyInt> Path, CallbackT &&Callback) {
+    return visitByPath<T>(Path, [&Callback](Reader &R, auto *Tag) {
+      using Container = std::remove_pointer_t<decltype(Tag)>;
+      if constexpr (is_container_v<Container>) {
+        using value_type = typename Container::value_type;
+        if constexpr (std::is_same_v<value_type, ElementT>) {
+          using KOT = KeyedObjectTraits<value_type>;
+          using key_type = std::remove_cv_t<decltype(KOT::key(
+            std::declval<value_type>()))>;
+
+          uint64_t Size = R.readInt();
+          for (uint64_t I = 0; I < Size; ++I) {
+            value_type Element = KOT::fromKey(R.readKey<key_type>());
+            Reader ElementReader(R.readBytes(R.readInt()));
+            ElementReader.read(Element);
+            revng_check(ElementReader.atEnd(), "Malformed binary tuple tree");
+            Callback(std::move(Element));
+          }
+
+          return true;
+        }
+      }
+
+      return false;
+    });
+  }
+
+private:
+  /// \brief Move to the object at \p Path in the object of type \p T
+  ///        starting at the current position and invoke \p Visitor on it
+  ///
+  /// \p Visitor is invoked with this Reader and a null pointer to the type of
+  /// the object at \p Path.
+  template<typename T, typename VisitorT>
+  bool visitByPath(llvm::ArrayRef<KeyInt> Path, const VisitorT &Visitor) {
+    if (Path.empty())
+      return Visitor(*this, static_cast<T *>(nullptr));
+
+    if constexpr (has_tuple_size_v<T>) {
+      return visitTupleByPath<T>(Path, Visitor);
+    } else if constexpr (is_container_v<T>) {
+      using value_type = typename T::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = std::remove_cv_t<decltype(KOT::key(
+        std::declval<value_type>()))>;
+      constexpr size_t IntsCount = KeyTraits<key_type>::IntsCount;
+
+      if (Path.size() < IntsCount)
+        return false;
+
+      llvm::ArrayRef<KeyInt> Target = Path.take_front(IntsCount);
+      uint64_t Size = readInt();
+      for (uint64_t I = 0; I < Size; ++I) {
+        auto Key = readKeyInts<key_type>();
+        llvm::StringRef Bytes = readBytes(readInt());
+        if (llvm::ArrayRef<KeyInt>(Key) == Target) {
+          Reader ElementReader(Bytes);
+          auto Rest = Path.drop_front(IntsCount);
+          return ElementReader.visitByPath<value_type>(Rest, Visitor);
+        }
+      }
+
+      return false;
+    } else {
+      return false;
+    }
+  }
+
+  template<typename T, size_t I = 0>
+  void readTuple(T &Value) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      read(get<I>(Value));
+      readTuple<T, I + 1>(Value);
+    }
+  }
+
+  template<typename T, size_t I = 0>
+  void skipTuple() {
+    if constexpr (I < std::tuple_size_v<T>) {
+      skip<std::tuple_element_t<I, T>>();
+      skipTuple<T, I + 1>();
+    }
+  }
+
+  template<typename T, size_t I = 0, typename VisitorT>
+  bool visitTupleByPath(llvm::ArrayRef<KeyInt> Path, const VisitorT &Visitor) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      using element = std::tuple_element_t<I, T>;
+      if (Path[0] == I)
+        return visitByPath<element>(Path.drop_front(), Visitor);
+
+      skip<element>();
+      return visitTupleByPath<T, I + 1>(Path, Visitor);
+    } else {
+      return false;
+    }
+  }
+};
+
+} // namespace detail
+
+/// \brief Append to \p Output the binary encoding of \p Root
+template<typename T>
+void serialize(llvm::raw_ostream &Output, const T &Root) {
+  Output << Magic;
+  detail::write(Output, Root);
+}
+
+/// \brief Decode into \p Root the binary encoding in \p Buffer
+template<typename T>
+void deserialize(llvm::StringRef Buffer, T &Root) {
+  revng_check(isBinary(Buffer), "Not a binary tuple tree");
+  detail::Reader TheReader(Buffer.drop_front(Magic.size()));
+  TheReader.read(Root);
+  revng_check(TheReader.atEnd(), "Trailing data after binary tuple tree");
+}
+
+/// \brief Decode into \p Result only the object at \p Path in the binary
+///        encoding of a \p RootT in \p Buffer
+///
+/// The rest of the tree is skipped, not materialized. The cost of a lookup in
+/// a container is linear in the number of elements preceding the target,
+/// regardless of their size.
+///
+/// \return false if \p Path does not exist or does not lead to a \p ResultT.
+template<typename RootT, typename ResultT>
+bool getByPath(llvm::StringRef Buffer,
+               const KeyIntVector &Path,
+               ResultT &Result) {
+  revng_check(isBinary(Buffer), "Not a binary tuple tree");
+  detail::Reader TheReader(Buffer.drop_front(Magic.size()));
+  return TheReader.readByPath<RootT>(Path, Result);
+}
+
+/// \brief Decode one at a time the elements of the container at \p Path in
+///        the binary encoding of a \p RootT in \p Buffer and pass them to
+///        \p Callback
+///
+/// This allows to stream out large trees without materializing them.
+///
+/// \return false if \p Path does not exist or does not lead to a container
+///         of \p ElementT.
+template<typename RootT, typename ElementT, typename CallbackT>
+bool forEachByPath(llvm::StringRef Buffer,
+                   const KeyIntVector &Path,
+                   CallbackT &&Callback) {
+  revng_check(isBinary(Buffer), "Not a binary tuple tree");
+  detail::Reader TheReader(Buffer.drop_front(Magic.size()));
+  return TheReader.forEachByPath<RootT, ElementT>(Path, Callback);
+}
+
+} // namespace tupletree::binary
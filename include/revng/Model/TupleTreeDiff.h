@@ -12,6 +12,7 @@
 #include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/ZipMapIterator.h"
 #include "revng/Model/TupleTree.h"
+#include "revng/Model/TupleTreeBinary.h"
 
 template<typename>
 struct is_std_vector : std::false_type {};
@@ -86,6 +87,13 @@ struct TupleTreeDiff {
 //
 namespace tupletreediff::detail {
 
+/// Elements whose key is the element itself are identical whenever their keys
+/// match, there's no need to look inside them
+template<typename T>
+constexpr bool is_identity_keyed_v = std::is_base_of_v<
+  IdentityKeyedObjectTraits<T>,
+  KeyedObjectTraits<T>>;
+
 template<typename M>
 struct Diff {
   KeyIntVector Stack;
@@ -123,15 +131,15 @@ private:
     using KOT = KeyedObjectTraits<value_type>;
     using key_type = decltype(KOT::key(std::declval<value_type>()));
 
-    for (auto [LHSElement, RHSElement] : zipmap_range(LHS, RHS)) {
+    auto Visit = [this](auto *LHSElement, auto *RHSElement) {
       if (LHSElement == nullptr) {
         // Added
         Result.add(Stack, RHSElement);
       } else if (RHSElement == nullptr) {
         // Removed
         Result.remove(Stack, LHSElement);
-      } else {
-        // Identical
+      } else if constexpr (not is_identity_keyed_v<value_type>) {
+        // Same key, look for differences inside
         using KT = KeyTraits<key_type>;
         const auto &KeyInts = KT::toInts(KOT::key(*LHSElement));
         std::copy(KeyInts.begin(), KeyInts.end(), std::back_inserter(Stack));
@@ -141,7 +149,8 @@ private:
         // Delete key from the stack
         Stack.resize(Stack.size() - KeyTraits<key_type>::IntsCount);
       }
-    }
+    };
+    zipmap_for_each(LHS, RHS, Visit);
   }
 
   template<typename T>
@@ -162,8 +171,8 @@ private:
       } else if (RHSElement == nullptr) {
         // Removed
         Result.remove(Stack, LHSElement->second);
-      } else {
-        // Identical
+      } else if constexpr (not is_identity_keyed_v<value_type>) {
+        // Same key, look for differences inside
         const auto &KeysInt = KeyTraits<key_type>::toInts(LHSElement->first);
         std::copy(KeysInt.begin(), KeysInt.end(), std::back_inserter(Stack));
 
@@ -358,3 +367,136 @@ inline void TupleTreeDiff<T>::apply(T &M) const {
     callByPath(ADV, C.Path, M);
   }
 }
+
+//
+// Binary encoding of TupleTreeDiff
+//
+namespace tupletreediff::binary {
+
+/// Prefix of all the binary-encoded diffs
+inline const llvm::StringRef Magic("\0RVNGTD\1", 8);
+
+inline bool isBinaryDiff(llvm::StringRef Buffer) {
+  return Buffer.startswith(Magic);
+}
+
+namespace detail {
+
+enum ChangeKind { Set, Add, Remove };
+
+/// Emit the object a Change refers to, using the type found at its path
+template<typename T>
+struct WriteChangeVisitor {
+  using Change = typename TupleTreeDiff<T>::Change;
+  llvm::raw_ostream &Output;
+  const Change &C;
+
+  template<typename TupleT, int I>
+  void visitTupleElement() {
+    write<typename std::tuple_element<I, TupleT>::type>();
+  }
+
+  template<typename ContainerT, typename KeyT>
+  void visitContainerElement(KeyT) {
+    write<typename ContainerT::value_type>();
+  }
+
+  template<typename K>
+  void write() {
+    using namespace tupletree::binary::detail;
+    if constexpr (is_container_v<K>) {
+      using value_type = typename K::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      if (C.New != nullptr) {
+        auto *New = reinterpret_cast<value_type *>(C.New);
+        writeInt(Output, Add);
+        writeKey(Output, KOT::key(*New));
+        tupletree::binary::detail::write(Output, *New);
+      } else {
+        auto *Old = reinterpret_cast<value_type *>(C.Old);
+        writeInt(Output, Remove);
+        writeKey(Output, KOT::key(*Old));
+      }
+    } else {
+      writeInt(Output, Set);
+      tupletree::binary::detail::write(Output, *reinterpret_cast<K *>(C.New));
+    }
+  }
+};
+
+/// Apply an encoded change to the object found at the path of the change
+struct ApplyChangeVisitor {
+  tupletree::binary::detail::Reader &Reader;
+
+  template<typename TupleT, size_t I, typename K>
+  void visitTupleElement(K &Element) {
+    apply(Element);
+  }
+
+  template<typename ContainerT, typename K, typename KeyT>
+  void visitContainerElement(KeyT, K &Element) {
+    apply(Element);
+  }
+
+  template<typename K>
+  void apply(K &Element) {
+    uint64_t Kind = Reader.readInt();
+    if constexpr (is_container_v<K>) {
+      using value_type = typename K::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = std::remove_cv_t<decltype(KOT::key(
+        std::declval<value_type>()))>;
+
+      auto Key = Reader.readKey<key_type>();
+      if (Kind == Add) {
+        Reader.read(Element[Key]);
+      } else {
+        revng_check(Kind == Remove, "Malformed binary diff");
+        revng_check(Element.erase(Key) == 1, "Removing a missing element");
+      }
+    } else {
+      revng_check(Kind == Set, "Malformed binary diff");
+      Reader.read(Element);
+    }
+  }
+};
+
+} // namespace detail
+
+/// \brief Append to \p Output the binary encoding of \p Diff
+///
+/// The encoding is self-contained: it can be applied even after the two trees
+/// \p Diff has been computed from have been destroyed.
+template<typename T>
+void serialize(llvm::raw_ostream &Output, const TupleTreeDiff<T> &Diff) {
+  using namespace tupletree::binary::detail;
+  Output << Magic;
+  writeInt(Output, Diff.Changes.size());
+  for (const typename TupleTreeDiff<T>::Change &C : Diff.Changes) {
+    writeInt(Output, C.Path.size());
+    for (KeyInt Step : C.Path)
+      writeInt(Output, Step);
+
+    detail::WriteChangeVisitor<T> WCV{ Output, C };
+    revng_check(callByPath<T>(WCV, C.Path));
+  }
+}
+
+/// \brief Apply to \p Root a diff encoded with serialize
+template<typename T>
+void apply(llvm::StringRef Buffer, T &Root) {
+  revng_check(isBinaryDiff(Buffer), "Not a binary diff");
+  tupletree::binary::detail::Reader Reader(Buffer.drop_front(Magic.size()));
+  uint64_t Count = Reader.readInt();
+  for (uint64_t I = 0; I < Count; ++I) {
+    KeyIntVector Path(Reader.readInt());
+    for (KeyInt &Step : Path)
+      Step = Reader.readInt();
+
+    detail::ApplyChangeVisitor ACV{ Reader };
+    revng_check(callByPath(ACV, Path, Root), "Diff does not match the tree");
+  }
+  revng_check(Reader.atEnd(), "Trailing data after binary diff");
+}
+
+} // namespace tupletreediff::binary
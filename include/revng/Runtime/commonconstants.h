@@ -20,3 +20,15 @@ typedef enum {
   /// Execution has reached the return address of a noreturn function call
   ReturnFromNoReturn
 } Reason;
+
+/// \brief Magic bytes at the beginning of a compact execution trace
+///
+/// Such traces are recorded at run-time if REVNG_COMPACT_TRACE_PATH is set.
+/// A compact trace, after the magic, is a sequence of records, one for each
+/// executed instruction that did not immediately follow the previous one. Each
+/// record is the difference between its PC and the PC of the previous record
+/// (0 for the first one), zigzag-encoded and then LEB128-encoded. If
+/// REVNG_TRACE_SAMPLING_PERIOD is N at run-time, only one out of N of such
+/// instructions is recorded.
+#define REVNG_COMPACT_TRACE_MAGIC "revngtr1"
+#define REVNG_COMPACT_TRACE_MAGIC_SIZE 8
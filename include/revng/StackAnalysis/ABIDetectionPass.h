@@ -10,6 +10,15 @@
 
 namespace StackAnalysis {
 
+/// \brief Run the stack analysis with ABI analysis and store its results in
+///        the IR
+///
+/// \note Results are recomputed from scratch for the whole module at each run.
+///       Reusing the results of a previous run for unchanged functions is not
+///       sound as things stand: the outcome for a function depends on the
+///       fake/noreturn classification of its callees, which in turn depends
+///       on the order in which the whole module is analyzed (see
+///       StackAnalysis::runOnModule), not only on the callee summaries.
 class ABIDetectionPass : public llvm::ModulePass {
 public:
   static char ID;
@@ -6,9 +6,13 @@
 
 // This file is NOT automatically generated.
 
+#include <algorithm>
 #include <deque>
+#include <functional>
 #include <map>
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "revng/Support/Debug.h"
 
@@ -666,6 +670,106 @@ inline V getOrDefault(const std::map<K, V> &Map, K Key) {
     return It->second;
 }
 
+/// \brief Map from CSVs to \p V, stored as a vector sorted by key
+///
+/// The summaries contain an entry for each register of each function and call
+/// site: a std::map would cost an allocation per entry and scatter them across
+/// the memory. Entries are iterated in the same order as in a std::map.
+template<typename V>
+class CSVMap {
+public:
+  using value_type = std::pair<llvm::GlobalVariable *, V>;
+  using container = std::vector<value_type>;
+  using iterator = typename container::iterator;
+  using const_iterator = typename container::const_iterator;
+
+private:
+  container Entries;
+
+public:
+  iterator begin() { return Entries.begin(); }
+  iterator end() { return Entries.end(); }
+  const_iterator begin() const { return Entries.begin(); }
+  const_iterator end() const { return Entries.end(); }
+
+  size_t size() const { return Entries.size(); }
+  bool empty() const { return Entries.empty(); }
+
+  iterator find(llvm::GlobalVariable *Key) {
+    auto It = lowerBound(Entries, Key);
+    return (It != Entries.end() and It->first == Key) ? It : Entries.end();
+  }
+
+  const_iterator find(llvm::GlobalVariable *Key) const {
+    auto It = lowerBound(Entries, Key);
+    return (It != Entries.end() and It->first == Key) ? It : Entries.end();
+  }
+
+  size_t count(llvm::GlobalVariable *Key) const {
+    return find(Key) != end() ? 1 : 0;
+  }
+
+  V &operator[](llvm::GlobalVariable *Key) {
+    auto It = lowerBound(Entries, Key);
+    if (It == Entries.end() or It->first != Key)
+      It = Entries.emplace(It, Key, V());
+    return It->second;
+  }
+
+private:
+  template<typename C>
+  static auto lowerBound(C &Entries, llvm::GlobalVariable *Key) {
+    auto Compare = [](const value_type &Entry, llvm::GlobalVariable *Key) {
+      return std::less<llvm::GlobalVariable *>()(Entry.first, Key);
+    };
+    return std::lower_bound(Entries.begin(), Entries.end(), Key, Compare);
+  }
+};
+
+template<typename V>
+inline V getOrDefault(const CSVMap<V> &Map, llvm::GlobalVariable *Key) {
+  auto It = Map.find(Key);
+  if (It == Map.end())
+    return V();
+  else
+    return It->second;
+}
+
+/// \brief Set of CSVs, stored as a vector sorted in the same order as a
+///        std::set
+class CSVSet {
+public:
+  using container = std::vector<llvm::GlobalVariable *>;
+  using const_iterator = container::const_iterator;
+
+private:
+  container Entries;
+
+public:
+  const_iterator begin() const { return Entries.begin(); }
+  const_iterator end() const { return Entries.end(); }
+
+  size_t size() const { return Entries.size(); }
+  bool empty() const { return Entries.empty(); }
+
+  size_t count(llvm::GlobalVariable *Key) const {
+    auto It = lowerBound(Key);
+    return (It != Entries.end() and *It == Key) ? 1 : 0;
+  }
+
+  void insert(llvm::GlobalVariable *Key) {
+    auto It = lowerBound(Key);
+    if (It == Entries.end() or *It != Key)
+      Entries.insert(It, Key);
+  }
+
+private:
+  container::const_iterator lowerBound(llvm::GlobalVariable *Key) const {
+    using Less = std::less<llvm::GlobalVariable *>;
+    return std::lower_bound(Entries.begin(), Entries.end(), Key, Less());
+  }
+};
+
 /// \brief Class containg the final results about all the analyzed functions
 class FunctionsSummary {
 public:
@@ -686,8 +790,6 @@ public:
 
   struct FunctionDescription;
 
-  // TODO: this is finalized stuff, should we use vectors/SmalMaps instead of
-  //       maps?
   struct CallSiteDescription {
     CallSiteDescription(llvm::Instruction *Call, llvm::Value *Callee) :
       Call(Call), Callee(Callee) {}
@@ -695,12 +797,7 @@ public:
     llvm::Instruction *Call;
     llvm::Value *Callee;
 
-    using GlobalVariable = llvm::GlobalVariable;
-
-    template<typename K, typename V>
-    using map = std::map<K, V>;
-
-    map<GlobalVariable *, FunctionCallRegisterDescription> RegisterSlots;
+    CSVMap<FunctionCallRegisterDescription> RegisterSlots;
 
     llvm::GlobalVariable *
     isCompatibleWith(const FunctionDescription &Function) const;
@@ -712,10 +809,9 @@ public:
     llvm::Value *Function;
     FunctionType::Values Type;
     std::map<llvm::BasicBlock *, BranchType::Values> BasicBlocks;
-    // TODO: this should be a vector
-    std::map<llvm::GlobalVariable *, FunctionRegisterDescription> RegisterSlots;
+    CSVMap<FunctionRegisterDescription> RegisterSlots;
     std::deque<CallSiteDescription> CallSites;
-    std::set<llvm::GlobalVariable *> ClobberedRegisters;
+    CSVSet ClobberedRegisters;
   };
 
 public:
@@ -14,7 +14,7 @@
 
 namespace StackAnalysis {
 
-extern const std::set<llvm::GlobalVariable *> EmptyCSVSet;
+extern const CSVSet EmptyCSVSet;
 
 template<bool AnalyzeABI>
 class StackAnalysis : public llvm::ModulePass {
@@ -33,8 +33,7 @@ public:
 
   bool runOnModule(llvm::Module &M) override;
 
-  const std::set<llvm::GlobalVariable *> &
-  getClobbered(llvm::BasicBlock *Function) const {
+  const CSVSet &getClobbered(llvm::BasicBlock *Function) const {
     auto It = GrandResult.Functions.find(Function);
     if (It == GrandResult.Functions.end())
       return EmptyCSVSet;
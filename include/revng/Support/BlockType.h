@@ -96,23 +96,36 @@ inline Values fromName(llvm::StringRef ReasonName) {
     revng_abort();
 }
 
+/// \brief Decode a block type metadata node, as produced by setBlockType
+///
+/// The first operand is the integer value of the block type, the second one is
+/// its name and it's there only for readability.
+inline Values fromMetadata(const llvm::MDNode *MD) {
+  using namespace llvm;
+  auto *Operand = cast<ConstantAsMetadata>(MD->getOperand(0));
+  auto Result = cast<ConstantInt>(Operand->getValue())->getZExtValue();
+  revng_assert(Result <= EntryPoint);
+  return static_cast<Values>(Result);
+}
+
 } // namespace BlockType
 
 inline void setBlockType(llvm::Instruction *T, BlockType::Values Value) {
   revng_assert(T->isTerminator());
   QuickMetadata QMD(getContext(T));
-  T->setMetadata(BlockTypeMDName, QMD.tuple(BlockType::getName(Value)));
+  auto *MD = QMD.tuple({ QMD.get(static_cast<uint32_t>(Value)),
+                         QMD.get(BlockType::getName(Value)) });
+  T->setMetadata(BlockTypeMDName, MD);
 }
 
 inline llvm::BasicBlock *
 findByBlockType(llvm::Function *F, BlockType::Values Value) {
   using namespace llvm;
-  QuickMetadata QMD(getContext(F));
+  unsigned BlockTypeMDKind = getContext(F).getMDKindID(BlockTypeMDName);
   for (BasicBlock &BB : *F) {
     if (auto *T = BB.getTerminator()) {
-      auto *MD = T->getMetadata(BlockTypeMDName);
-      if (auto *Node = cast_or_null<MDTuple>(MD))
-        if (BlockType::fromName(QMD.extract<StringRef>(Node, 0)) == Value)
+      if (auto *MD = T->getMetadata(BlockTypeMDKind))
+        if (BlockType::fromMetadata(MD) == Value)
           return &BB;
     }
   }
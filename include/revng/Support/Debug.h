@@ -86,6 +86,20 @@ private:
   bool Enabled;
 };
 
+/// \brief Whether VerboseLogger instances are compiled in
+///
+/// Configure with -DREVNG_DISABLE_VERBOSE_LOGS=ON to compile them down to
+/// nothing: isEnabled() becomes constant false, so the code guarded by it and
+/// the expressions in revng_log are eliminated.
+#ifdef REVNG_DISABLE_VERBOSE_LOGS
+constexpr bool VerboseLogsEnabled = false;
+#else
+constexpr bool VerboseLogsEnabled = true;
+#endif
+
+/// \brief Logger for hot paths, such as the translation and harvesting loops
+using VerboseLogger = Logger<VerboseLogsEnabled>;
+
 /// \brief Indent all loggers within the scope of this object
 template<bool StaticEnabled = true>
 class LoggerIndent {
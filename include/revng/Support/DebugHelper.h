@@ -64,12 +64,26 @@ public:
   emitInstructionAnnot(const llvm::Instruction *TheInstruction,
                        llvm::formatted_raw_ostream &Output) override;
 
+private:
+  /// \brief Write the \p MDKind metadata of \p I, unless it's the same as the
+  ///        last one emitted in the current basic block
+  void writeMetadataIfNew(const llvm::Instruction *I,
+                          unsigned MDKind,
+                          llvm::StringRef &Last,
+                          llvm::formatted_raw_ostream &Output);
+
 private:
   llvm::LLVMContext &Context;
   unsigned OriginalInstrMDKind;
   unsigned PTCInstrMDKind;
   unsigned DbgMDKind;
   bool DebugInfo;
+
+  // Instructions are annotated in order: keep track of the last non-empty
+  // metadata of the current basic block, instead of looking backwards for it
+  const llvm::BasicBlock *CurrentBlock = nullptr;
+  llvm::StringRef LastOriginalInstr;
+  llvm::StringRef LastPTCInstr;
 };
 
 /// \brief Handle printing the IR in textual form, possibly with debug
@@ -4,9 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <set>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
@@ -184,3 +186,50 @@ auto exitless_scc_range(NodeTy Entry) {
 
   return make_filter_range(Range, Filter);
 }
+
+/// \brief Group the SCCs reachable from \p Entry in levels, such that each SCC
+///        only depends on SCCs in lower levels
+///
+/// An SCC depends on the SCCs reachable through its outgoing edges, therefore
+/// level 0 contains the SCCs with no successors (e.g., the leaves of a call
+/// graph) and each subsequent level only depends on the previous ones. All the
+/// SCCs within a level are independent from each other and can be processed
+/// in any order, or concurrently by analyses that support it. For a top-down
+/// schedule, visit the levels in reverse order.
+///
+/// \return a vector of levels, each one being a list of SCCs.
+template<typename NodeTy>
+std::vector<std::vector<std::vector<NodeTy>>> sccLevels(NodeTy Entry) {
+  using namespace llvm;
+  using GT = GraphTraits<NodeTy>;
+
+  std::vector<std::vector<std::vector<NodeTy>>> Result;
+
+  // scc_iterator emits each SCC after all the SCCs reachable from it, so the
+  // level of all the successors is known by the time we get to an SCC
+  DenseMap<NodeTy, unsigned> LevelOf;
+  for (auto It = scc_begin(Entry), End = scc_end(Entry); It != End; ++It) {
+    const std::vector<NodeTy> &SCC = *It;
+
+    // We haven't recorded the level of the nodes of this SCC yet, so edges
+    // within the SCC are ignored
+    unsigned Level = 0;
+    for (NodeTy Node : SCC) {
+      for (NodeTy Successor : make_range(GT::child_begin(Node),
+                                         GT::child_end(Node))) {
+        auto SuccessorIt = LevelOf.find(Successor);
+        if (SuccessorIt != LevelOf.end())
+          Level = std::max(Level, SuccessorIt->second + 1);
+      }
+    }
+
+    for (NodeTy Node : SCC)
+      LevelOf[Node] = Level;
+
+    if (Level >= Result.size())
+      Result.resize(Level + 1);
+    Result[Level].push_back(SCC);
+  }
+
+  return Result;
+}
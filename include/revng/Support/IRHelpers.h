@@ -7,7 +7,9 @@
 #include <queue>
 #include <set>
 #include <sstream>
+#include <vector>
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/ConstantFolding.h"
@@ -244,6 +246,11 @@ struct IteratorDirection<false> {
   }
 };
 
+/// \brief CRTP base class for BFS visits of the basic blocks starting from an
+///        instruction
+///
+/// The visited set and the work list are kept across calls to run(), so
+/// reusing the same visitor for multiple visits avoids allocations.
 template<bool Forward, typename Derived, typename SuccessorsRange>
 struct BFSVisitorBase {
 public:
@@ -257,44 +264,49 @@ public:
                                              backward_iterator>;
   using instruction_range = llvm::iterator_range<instruction_iterator>;
 
+private:
+  using ID = IteratorDirection<Forward>;
+
+  struct WorkItem {
+    WorkItem(BasicBlock *BB, instruction_iterator Start) :
+      BB(BB), Range(make_range(Start, ID::end(BB))) {}
+
+    WorkItem(BasicBlock *BB) :
+      BB(BB), Range(make_range(ID::begin(BB), ID::end(BB))) {}
+
+    BasicBlock *BB;
+    instruction_range Range;
+  };
+
+  llvm::SmallPtrSet<BasicBlock *, 16> Visited;
+  std::vector<WorkItem> Queue;
+
+public:
   void run(llvm::Instruction *I) {
     auto &ThisDerived = *static_cast<Derived *>(this);
-    std::set<BasicBlock *> Visited;
+    Visited.clear();
+    Queue.clear();
 
-    using ID = IteratorDirection<Forward>;
     instruction_iterator It = ID::iterator(I);
 
     if (not Forward)
       It--;
 
-    struct WorkItem {
-      WorkItem(BasicBlock *BB, instruction_iterator Start) :
-        BB(BB), Range(make_range(Start, ID::end(BB))) {}
-
-      WorkItem(BasicBlock *BB) :
-        BB(BB), Range(make_range(ID::begin(BB), ID::end(BB))) {}
-
-      BasicBlock *BB;
-      instruction_range Range;
-    };
-
-    std::queue<WorkItem> Queue;
-    Queue.push(WorkItem(I->getParent(), It));
+    Queue.push_back(WorkItem(I->getParent(), It));
 
     bool ExhaustOnly = false;
 
-    while (not Queue.empty()) {
-      WorkItem Item = Queue.front();
-      Queue.pop();
+    // Queue is consumed from the front, but popped elements are dropped only
+    // at the end of the visit, to reuse the storage
+    for (size_t Head = 0; Head < Queue.size(); ++Head) {
+      WorkItem Item = Queue[Head];
 
       switch (ThisDerived.visit(Item.Range)) {
       case Continue:
         if (not ExhaustOnly) {
           for (auto *Successor : ThisDerived.successors(Item.BB)) {
-            if (Visited.count(Successor) == 0) {
-              Visited.insert(Successor);
-              Queue.push(WorkItem(Successor));
-            }
+            if (Visited.insert(Successor).second)
+              Queue.push_back(WorkItem(Successor));
           }
         }
         break;
@@ -1044,6 +1056,7 @@ static llvm::StringRef MarkerFunctionNames[] = { "newpc",
                                                  "nodce",
                                                  "exception_warning",
                                                  "raise_exception_helper",
+                                                 "unwind_to_root_helper",
                                                  "function_dispatcher" };
 
 /// \brief Checks if \p I is a marker
@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/Triple.h"
 
 #include "revng/Support/Debug.h"
@@ -402,6 +406,7 @@ inline bool isDefaultCode(Values Type) {
 /// \note Generic addresses have no alignment constraints.
 class MetaAddress {
   friend class ProgramCounterHandler;
+  friend struct llvm::DenseMapInfo<MetaAddress>;
 
 private:
   uint32_t Epoch;
@@ -541,20 +546,24 @@ public:
 public:
   /// @{
   bool operator==(const MetaAddress &Other) const {
-    return tie() == Other.tie();
+    return packed() == Other.packed();
   }
 
   bool operator!=(const MetaAddress &Other) const {
     return not(*this == Other);
   }
 
-  bool operator<(const MetaAddress &Other) const { return tie() < Other.tie(); }
+  bool operator<(const MetaAddress &Other) const {
+    return packed() < Other.packed();
+  }
   bool operator<=(const MetaAddress &Other) const {
-    return tie() <= Other.tie();
+    return packed() <= Other.packed();
+  }
+  bool operator>(const MetaAddress &Other) const {
+    return packed() > Other.packed();
   }
-  bool operator>(const MetaAddress &Other) const { return tie() > Other.tie(); }
   bool operator>=(const MetaAddress &Other) const {
-    return tie() >= Other.tie();
+    return packed() >= Other.packed();
   }
 
   /// @}
@@ -829,17 +838,72 @@ private:
   }
 
 public:
+  /// Longest textual form: address, the longest type name, epoch and address
+  /// space, separated by colons
+  static constexpr size_t MaxStringSize = 2 + 16 + 1 + 14 + 1 + 10 + 1 + 5;
+  using StringBuffer = std::array<char, MaxStringSize>;
+
   std::string toString() const;
+
+  /// \brief Write the textual form of this address in \p Buffer
+  ///
+  /// Same as toString, without allocating memory.
+  ///
+  /// \return the textual form, pointing into \p Buffer
+  llvm::StringRef toString(StringBuffer &Buffer) const;
+
   static MetaAddress fromString(llvm::StringRef Text);
 
 private:
-  using Tied = std::tuple<uint32_t, uint16_t, uint16_t, uint64_t>;
-  Tied tie() const { return std::tie(Epoch, AddressSpace, Type, Address); }
+  /// Epoch, address space and type packed in a single integer, in order of
+  /// significance
+  uint64_t packedMetadata() const {
+    return (static_cast<uint64_t>(Epoch) << 32)
+           | (static_cast<uint64_t>(AddressSpace) << 16)
+           | static_cast<uint64_t>(Type);
+  }
+
+  /// The whole MetaAddress as a single 128-bit integer
+  ///
+  /// Comparing two of them orders MetaAddresses by epoch, address space, type
+  /// and address, without branches.
+  using Packed = unsigned __int128;
+  Packed packed() const {
+    return (static_cast<Packed>(packedMetadata()) << 64) | Address;
+  }
 };
 
 static_assert(sizeof(MetaAddress) <= 128 / 8,
               "MetaAddress is larger than 128 bits");
 
+/// Enable MetaAddress as a key of DenseMap and DenseSet
+///
+/// The empty and tombstone keys are invalid MetaAddresses with a non-zero
+/// address, which can never be built, since invalid MetaAddresses are always
+/// reset to all zeros.
+template<>
+struct llvm::DenseMapInfo<MetaAddress> {
+  static MetaAddress getEmptyKey() {
+    MetaAddress Result;
+    Result.Address = ~static_cast<uint64_t>(0);
+    return Result;
+  }
+
+  static MetaAddress getTombstoneKey() {
+    MetaAddress Result;
+    Result.Address = ~static_cast<uint64_t>(0) - 1;
+    return Result;
+  }
+
+  static unsigned getHashValue(const MetaAddress &Value) {
+    return llvm::hash_combine(Value.packedMetadata(), Value.Address);
+  }
+
+  static bool isEqual(const MetaAddress &LHS, const MetaAddress &RHS) {
+    return LHS == RHS;
+  }
+};
+
 template<typename T>
 struct compareAddress {};
 
@@ -15,7 +15,8 @@ struct llvm::yaml::ScalarTraits<MetaAddress> {
 
   static void
   output(const MetaAddress &Value, void *, llvm::raw_ostream &Output) {
-    Output << Value.toString();
+    MetaAddress::StringBuffer Buffer;
+    Output << Value.toString(Buffer);
   }
 
   static StringRef input(llvm::StringRef Scalar, void *, MetaAddress &Value) {
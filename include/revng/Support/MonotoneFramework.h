@@ -4,11 +4,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+#include <cstdint>
 #include <map>
 #include <set>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallVector.h"
@@ -66,29 +71,23 @@ class MonotoneFrameworkWorkList<Iterated,
                                 Visit,
                                 typename enable_if_post_order<Visit>::type> {
 private:
-  /// \brief Class for an entry in the work list
+  /// List of all basic blocks in the appropriate order
   ///
   /// All the basic blocks are always in the list in (reverse) post order. When
   /// an entry is popped it is simply disabled.
-  class PostOrderEntry {
-  private:
-    Iterated Entry;
-    bool Enabled;
-
-  public:
-    PostOrderEntry(Iterated Entry) : Entry(Entry), Enabled(true) {}
-    void enable() { Enabled = true; }
-    void disable() { Enabled = false; }
-    bool isEnabled() const { return Enabled; }
-    Iterated entry() const { return Entry; }
-  };
+  std::vector<Iterated> PostOrderList;
 
-private:
-  /// List of all basic blocks in the appropriate order
-  std::vector<PostOrderEntry> PostOrderList;
+  /// Bit I is set if and only if PostOrderList[I] is in the work list
+  llvm::BitVector Enabled;
 
   /// Map to quickly find the index of an entry in PostOrderList
-  std::map<Iterated, size_t> PostOrderListIndex;
+  ///
+  /// Pointer labels, the common case, are hashed. Any other label only needs to
+  /// be ordered, as in the rest of the framework.
+  using IndexMap = std::conditional_t<std::is_pointer_v<Iterated>,
+                                      llvm::DenseMap<Iterated, size_t>,
+                                      std::map<Iterated, size_t>>;
+  IndexMap PostOrderListIndex;
 
   /// The next index to consume. This should always point to the lowest enabled
   /// entry in PostOrderList
@@ -98,17 +97,13 @@ private:
   const static size_t InvalidIndex = std::numeric_limits<size_t>::max();
 
 public:
-  MonotoneFrameworkWorkList(const std::vector<Iterated> &RPOT) {
-    for (Iterated Entry : RPOT)
-      PostOrderList.push_back(PostOrderEntry(Entry));
-
+  MonotoneFrameworkWorkList(const std::vector<Iterated> &RPOT) :
+    PostOrderList(RPOT.begin(), RPOT.end()) {
     initialize();
   }
 
-  MonotoneFrameworkWorkList(const llvm::SmallVectorImpl<Iterated> &RPOT) {
-    for (Iterated Entry : RPOT)
-      PostOrderList.push_back(PostOrderEntry(Entry));
-
+  MonotoneFrameworkWorkList(const llvm::SmallVectorImpl<Iterated> &RPOT) :
+    PostOrderList(RPOT.begin(), RPOT.end()) {
     initialize();
   }
 
@@ -117,21 +112,11 @@ public:
 
   size_t size() const {
     revng_assert(verify());
-
-    if (empty())
-      return 0;
-
-    size_t Result = 0;
-    for (size_t I = Next; I < PostOrderList.size(); I++)
-      if (PostOrderList[I].isEnabled())
-        Result++;
-
-    return Result;
+    return Enabled.count();
   }
 
   void clear() {
-    for (PostOrderEntry &Entry : PostOrderList)
-      Entry.disable();
+    Enabled.reset();
     Next = InvalidIndex;
   }
 
@@ -141,7 +126,7 @@ public:
     revng_assert(It != PostOrderListIndex.end());
 
     // Enable it
-    PostOrderList[It->second].enable();
+    Enabled.set(It->second);
 
     // Reset next to the lowest enabled index, if necessary
     Next = std::min(Next, It->second);
@@ -151,28 +136,23 @@ public:
 
   Iterated head() const {
     revng_assert(Next != InvalidIndex);
-    return PostOrderList[Next].entry();
+    return PostOrderList[Next];
   }
 
   Iterated pop() {
     revng_assert(not empty());
     revng_assert(verify());
 
-    // Start from the next element and look for an enabled element
-    size_t I = Next + 1;
-    for (; I < PostOrderList.size(); I++)
-      if (PostOrderList[I].isEnabled())
-        break;
-
-    // Update Next
+    // Consume the current next
     size_t OldNext = Next;
-    Next = (I >= PostOrderList.size()) ? InvalidIndex : I;
+    Enabled.reset(OldNext);
 
-    // Consume the previous next
-    PostOrderList[OldNext].disable();
+    // Look for the next enabled element
+    int I = Enabled.find_next(OldNext);
+    Next = (I == -1) ? InvalidIndex : static_cast<size_t>(I);
 
     // Return the consumed entry
-    return PostOrderList[OldNext].entry();
+    return PostOrderList[OldNext];
   }
 
 private:
@@ -191,9 +171,14 @@ private:
     if (Visit == PostOrder)
       std::reverse(PostOrderList.begin(), PostOrderList.end());
 
+    // Initially, all the entries are enabled
+    Enabled.resize(PostOrderList.size(), true);
+
     // Populate the index, used for faster lookups
+    if constexpr (std::is_pointer_v<Iterated>)
+      PostOrderListIndex.reserve(PostOrderList.size());
     for (unsigned I = 0; I < PostOrderList.size(); I++)
-      PostOrderListIndex[PostOrderList[I].entry()] = I;
+      PostOrderListIndex[PostOrderList[I]] = I;
 
     // Initialize the next index
     Next = (PostOrderList.size() > 0) ? 0 : InvalidIndex;
@@ -203,22 +188,144 @@ private:
     if (PostOrderList.size() == 0 and not empty())
       return false;
 
-    if (empty()) {
-      // If the worklist is empty, no elements should be enabled
-      for (const PostOrderEntry &Entry : PostOrderList)
-        if (Entry.isEnabled())
-          return false;
-    } else {
-      // Otherwise, all the elements up to next should be disabled
-      for (size_t I = 0; I != Next; I++)
-        if (PostOrderList[I].isEnabled())
-          return false;
+    // Next must be the lowest enabled entry, if any
+    int First = Enabled.find_first();
+    if (empty())
+      return First == -1;
+    else
+      return First != -1 and static_cast<size_t>(First) == Next;
+  }
+};
+
+/// \brief Opt-in profile of the convergence of a MonotoneFramework
+///
+/// Register it with MonotoneFramework::setProfile before running the analysis
+/// to record, for each label, the number of visits, the time spent in the
+/// transfer function and how many times its initial state grew (i.e., it has
+/// been combined with a larger element coming from a predecessor), along with
+/// the size of the work list after each visit.
+///
+/// The profile accumulates across runs, so that re-analyses (e.g., starting
+/// from a new initial state) are accounted for too.
+template<typename Label>
+class MonotoneFrameworkProfile {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct LabelProfile {
+    /// Number of times the transfer function has been run on this label
+    uint64_t Visits = 0;
+
+    /// Number of times the initial state of this label grew
+    uint64_t Growths = 0;
 
-      if (not PostOrderList[Next].isEnabled())
-        return false;
+    /// Time spent in the transfer function
+    Clock::duration TransferTime = Clock::duration::zero();
+  };
+
+  /// \brief The metric determining the color of the nodes in dumpDot
+  enum HeatMetric { Visits, Growths, TransferTime };
+
+private:
+  std::map<Label, LabelProfile> Labels;
+
+  /// Number of growths caused by each edge that has been followed
+  std::map<std::pair<Label, Label>, uint64_t> Edges;
+
+  /// Size of the work list after each visit
+  std::vector<size_t> WorkListSizes;
+
+public:
+  void recordVisit(Label L, Clock::duration Time) {
+    LabelProfile &Profile = Labels[L];
+    Profile.Visits++;
+    Profile.TransferTime += Time;
+  }
+
+  void recordEdge(Label Source, Label Destination) {
+    Edges.insert({ { Source, Destination }, 0 });
+  }
+
+  void recordGrowth(Label Source, Label Destination) {
+    Labels[Destination].Growths++;
+    Edges[{ Source, Destination }]++;
+  }
+
+  void recordWorkListSize(size_t Size) { WorkListSizes.push_back(Size); }
+
+  const std::map<Label, LabelProfile> &labels() const { return Labels; }
+
+  /// \brief Dump the CFG in DOT format as a heat map
+  ///
+  /// The darker the node, the higher its \p Heat metric. Edges along which the
+  /// initial state of the destination grew are red and labeled with the
+  /// number of growths: these are the ones to look at when an analysis takes
+  /// long to converge.
+  ///
+  /// \param GetName a function returning the name of a label, as std::string.
+  template<typename O, typename F>
+  void dumpDot(O &Output, F GetName, HeatMetric Heat = Visits) const {
+    using namespace std::chrono;
+
+    uint64_t Max = 0;
+    for (auto &P : Labels)
+      Max = std::max(Max, metric(P.second, Heat));
+
+    Output << "digraph MonotoneFramework {\n";
+    Output << "  node [shape=box,style=filled,colorscheme=reds9];\n";
+
+    for (auto &P : Labels) {
+      const LabelProfile &Profile = P.second;
+      std::string Name = GetName(P.first);
+      uint64_t Microseconds = duration_cast<microseconds>(Profile.TransferTime)
+                                .count();
+
+      // Map the metric on the 9 colors of the scheme
+      uint64_t Color = 1;
+      if (Max != 0)
+        Color += (metric(Profile, Heat) * 8) / Max;
+
+      Output << "  \"" << Name << "\" [label=\"" << Name;
+      Output << "\\nvisits: " << Profile.Visits;
+      Output << "\\ngrowths: " << Profile.Growths;
+      Output << "\\ntime: " << Microseconds << " us\"";
+      Output << ",fillcolor=" << Color;
+      if (Color > 6)
+        Output << ",fontcolor=white";
+      Output << "];\n";
+    }
+
+    for (auto &P : Edges) {
+      Output << "  \"" << GetName(P.first.first) << "\" -> \""
+             << GetName(P.first.second) << "\"";
+      if (P.second != 0)
+        Output << " [color=red,label=" << P.second << "]";
+      Output << ";\n";
     }
 
-    return true;
+    Output << "}\n";
+  }
+
+  /// \brief Dump the size of the work list after each visit, as CSV
+  template<typename O>
+  void dumpWorkListSizes(O &Output) const {
+    Output << "visit,size\n";
+    for (size_t I = 0; I < WorkListSizes.size(); I++)
+      Output << I << "," << WorkListSizes[I] << "\n";
+  }
+
+private:
+  static uint64_t metric(const LabelProfile &Profile, HeatMetric Heat) {
+    switch (Heat) {
+    case Visits:
+      return Profile.Visits;
+    case Growths:
+      return Profile.Growths;
+    case TransferTime:
+      return Profile.TransferTime.count();
+    }
+
+    revng_abort();
   }
 };
 
@@ -347,6 +454,15 @@ struct InterruptCreator<D, LatticeElement, DefaultInterrupt<LatticeElement>> {
 /// \tparam D the derived class.
 /// \tparam SuccessorsRange the return type of D::successors.
 /// \tparam Visit type of visit to perform.
+///
+/// \note The framework is dense: each time a label is visited its whole
+///       LatticeElement is recomputed and propagated. A sparse mode (i.e.,
+///       propagating only the changed facts along per-slot dependencies) would
+///       require lattice elements to expose per-slot transfer functions, which
+///       none of the current analyses do. In particular, in the ABI analysis
+///       function calls (direct and indirect) affect all the registers at
+///       once, so the per-slot dependency graph would degenerate to the CFG
+///       at every call site.
 // TODO: static_assert features of these classes (Interrupt in particular)
 template<typename D,
          typename Label,
@@ -401,6 +517,9 @@ protected:
   /// \note Unused if DynamicGraph == false
   std::map<Label, llvm::SmallVector<Label, 2>> SuccessorsMap;
 
+  /// Convergence profile to populate, if any
+  MonotoneFrameworkProfile<Label> *Profile = nullptr;
+
 public:
   using InterruptType = Interrupt;
 
@@ -530,6 +649,13 @@ public:
   /// \brief Register a new extremal label
   void registerExtremal(Label L) { Extremals.insert(L); }
 
+  /// \brief Record the convergence profile of the next runs in \p NewProfile
+  ///
+  /// \note Pass nullptr to stop profiling.
+  void setProfile(MonotoneFrameworkProfile<Label> *NewProfile) {
+    Profile = NewProfile;
+  }
+
   /// \brief Resolve the data flow analysis problem using the MFP solution
   Interrupt run() {
     using namespace llvm;
@@ -543,8 +669,16 @@ public:
       ToVisit.erase(ToAnalyze);
 
       // Run the transfer function
+      using Clock = typename MonotoneFrameworkProfile<Label>::Clock;
+      typename Clock::time_point Begin;
+      if (Profile != nullptr)
+        Begin = Clock::now();
+
       Interrupt Result = transfer(ToAnalyze);
 
+      if (Profile != nullptr)
+        Profile->recordVisit(ToAnalyze, Clock::now() - Begin);
+
       // Check if we should continue or if we should yield control to the
       // caller, i.e., the interprocedural part of the analysis, if present.
       if (Result.requiresInterproceduralHandling())
@@ -602,6 +736,9 @@ public:
         if (DynamicGraph)
           NewSuccessors.push_back(Successor);
 
+        if (Profile != nullptr)
+          Profile->recordEdge(ToAnalyze, Successor);
+
         auto It = State.find(Successor);
         if (It == State.end()) {
           // We have never seen this Label, register it in the analysis state
@@ -626,11 +763,17 @@ public:
           // Assert we're now actually lower than or equal
           assertLowerThanOrEqual(ActualElement, It->second);
 
+          if (Profile != nullptr)
+            Profile->recordGrowth(ToAnalyze, Successor);
+
           // Re-enqueue
           WorkList.insert(Successor);
         }
       }
 
+      if (Profile != nullptr)
+        Profile->recordWorkListSize(WorkList.size());
+
       // In case of dynamic graph, register successors of this label
       if (DynamicGraph) {
         // The successors must match, unless the current label has become a
@@ -5,12 +5,16 @@
 //
 
 #include <map>
+#include <string>
+#include <utility>
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 
 #include "revng/Support/Assert.h"
 
@@ -76,3 +80,71 @@ public:
     return get(Key, FunctionType::get(ReturnType, Arguments, false), Name);
   }
 };
+
+/// \brief Module-wide cache of opaque functions keyed by name and type
+///
+/// Unlike OpaqueFunctionsPool, which is owned by a single pass, a registry is
+/// meant to live as long as the pipeline and to be shared by all the passes
+/// that need the same opaque functions, so that they are created once instead
+/// of once per run. Functions are never erased individually: purge() erases in
+/// bulk all the functions that are no longer used.
+///
+/// \note An empty name identifies an anonymous function, which is only ever
+///       reachable through the registry.
+class OpaqueFunctionsRegistry {
+private:
+  using Key = std::pair<std::string, llvm::FunctionType *>;
+
+private:
+  llvm::Module *M;
+  std::map<Key, llvm::Function *> Functions;
+
+public:
+  OpaqueFunctionsRegistry(llvm::Module *M) : M(M) {}
+
+  OpaqueFunctionsRegistry(const OpaqueFunctionsRegistry &) = delete;
+  OpaqueFunctionsRegistry &operator=(const OpaqueFunctionsRegistry &) = delete;
+
+public:
+  /// \brief Get the function \p Name of type \p FT, creating it if necessary
+  ///
+  /// \param Attributes function attributes to add if the function is created.
+  llvm::Function *get(llvm::StringRef Name,
+                      llvm::FunctionType *FT,
+                      llvm::ArrayRef<llvm::Attribute::AttrKind> Attributes = {}) {
+    using namespace llvm;
+
+    auto It = Functions.find({ Name.str(), FT });
+    if (It != Functions.end())
+      return It->second;
+
+    Function *F = nullptr;
+    if (not Name.empty())
+      F = M->getFunction(Name);
+
+    if (F == nullptr) {
+      F = Function::Create(FT, GlobalValue::ExternalLinkage, Name, M);
+      for (Attribute::AttrKind Kind : Attributes)
+        F->addFnAttr(Kind);
+    }
+
+    // Ensure the function we're returning is as expected
+    revng_assert(F->getFunctionType() == FT);
+
+    Functions.insert(It, { { Name.str(), FT }, F });
+    return F;
+  }
+
+  /// \brief Erase all the functions of the registry that have no uses
+  void purge() {
+    for (auto It = Functions.begin(); It != Functions.end();) {
+      llvm::Function *F = It->second;
+      if (F->use_empty()) {
+        F->eraseFromParent();
+        It = Functions.erase(It);
+      } else {
+        ++It;
+      }
+    }
+  }
+};
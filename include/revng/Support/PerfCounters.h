@@ -0,0 +1,55 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <cstdint>
+
+namespace PerfCounter {
+
+/// \brief Hardware events sampled around ScopedTimer regions
+enum Values {
+  Cycles,
+  Instructions,
+  CacheMisses,
+  BranchMisses,
+  Count
+};
+
+inline const char *getName(Values V) {
+  switch (V) {
+  case Cycles:
+    return "cycles";
+  case Instructions:
+    return "instructions";
+  case CacheMisses:
+    return "cache-misses";
+  case BranchMisses:
+    return "branch-misses";
+  case Count:
+    break;
+  }
+
+  return nullptr;
+}
+
+} // namespace PerfCounter
+
+/// \brief Process-wide hardware performance counters
+///
+/// The counters are opened through perf_event_open, as a single group, on
+/// first use and only if -perf-counters has been specified. They count user
+/// space events of the current thread.
+class PerfCounters {
+public:
+  using Sample = std::array<uint64_t, PerfCounter::Count>;
+
+public:
+  /// \brief Read the current value of all the counters
+  ///
+  /// \return false if the counters are disabled or not available, in which
+  ///         case \p Result is left untouched.
+  static bool read(Sample &Result);
+};
@@ -4,8 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueHandle.h"
 
 #include "revng/Support/BlockType.h"
 #include "revng/Support/IRHelpers.h"
@@ -51,18 +55,51 @@ protected:
   llvm::GlobalVariable *AddressSpaceCSV;
   llvm::GlobalVariable *TypeCSV;
 
+  /// \brief If valid, the epoch, address space and type shared by all the PCs
+  ///
+  /// In this case the PC is represented by AddressCSV alone: the other
+  /// variables are constants, they are never stored and the dispatcher only
+  /// switches on the address.
+  MetaAddress SingleWordBase;
+
   std::set<llvm::Value *> CSVsAffectingPC;
 
+private:
+  /// \brief A memoized result of getUniqueJumpTarget
+  struct CachedJumpTarget {
+    NextJumpTarget::Values Result;
+    MetaAddress Target;
+
+    /// The blocks visited to compute the result, if any of them is erased the
+    /// result is no longer valid
+    std::vector<llvm::WeakVH> Visited;
+
+    /// The non-constant store to a PC CSV which lead to the result, if any,
+    /// and its stored value: if the latter changes, the result might too
+    bool HasNonConstantStore = false;
+    llvm::WeakVH NonConstantStore;
+    llvm::WeakVH StoredValue;
+  };
+
+  std::map<llvm::BasicBlock *, CachedJumpTarget> JumpTargetsCache;
+
+  /// For each block, the blocks whose cached result depends on it
+  std::map<llvm::BasicBlock *, std::vector<llvm::BasicBlock *>>
+    JumpTargetsCacheUsers;
+
 public:
   using DispatcherTarget = std::pair<MetaAddress, llvm::BasicBlock *>;
   using DispatcherTargets = std::vector<DispatcherTarget>;
+  /// Provides the expected execution count of a dispatcher target
+  using DispatcherWeights = llvm::function_ref<uint64_t(const MetaAddress &)>;
 
 protected:
   ProgramCounterHandler() :
     AddressCSV(nullptr),
     EpochCSV(nullptr),
     AddressSpaceCSV(nullptr),
-    TypeCSV(nullptr) {}
+    TypeCSV(nullptr),
+    SingleWordBase(MetaAddress::invalid()) {}
 
 public:
   virtual ~ProgramCounterHandler() {}
@@ -99,9 +136,18 @@ public:
     initializePCInternal(Builder, NewPC);
   }
 
+  /// \brief Is the PC represented by the address CSV alone?
+  bool isSingleWord() const { return SingleWordBase.isValid(); }
+
   void setPC(llvm::IRBuilder<> &Builder, MetaAddress NewPC) const {
     revng_assert(NewPC.isValid() and NewPC.isCode());
     store(Builder, AddressCSV, NewPC.address());
+
+    if (isSingleWord()) {
+      revng_assert(matchesSingleWordBase(NewPC));
+      return;
+    }
+
     store(Builder, EpochCSV, NewPC.epoch());
     store(Builder, AddressSpaceCSV, NewPC.addressSpace());
     store(Builder, TypeCSV, NewPC.type());
@@ -138,9 +184,17 @@ public:
   ///         an invalid MetaAddress in case there isn't a single next PC, or,
   ///         finally, a valid MetaAddress representing the only possible next
   ///         PC
+  ///
+  /// \note Results are memoized: if the instructions or the predecessors of a
+  ///       block change, other than for erasing blocks or replacing the value
+  ///       stored in the PC, call forgetUniqueJumpTarget on it.
   std::pair<NextJumpTarget::Values, MetaAddress>
   getUniqueJumpTarget(llvm::BasicBlock *BB);
 
+  /// \brief Forget the memoized results of getUniqueJumpTarget depending on
+  ///        \p BB
+  void forgetUniqueJumpTarget(llvm::BasicBlock *BB);
+
   void deserializePC(llvm::IRBuilder<> &Builder) const {
     using namespace llvm;
 
@@ -170,9 +224,9 @@ public:
   llvm::Instruction *composeIntegerPC(llvm::IRBuilder<> &B) const {
     return MetaAddress::composeIntegerPC(B,
                                          B.CreateLoad(AddressCSV),
-                                         B.CreateLoad(EpochCSV),
-                                         B.CreateLoad(AddressSpaceCSV),
-                                         B.CreateLoad(TypeCSV));
+                                         loadComponent(B, EpochCSV),
+                                         loadComponent(B, AddressSpaceCSV),
+                                         loadComponent(B, TypeCSV));
   }
 
   bool isPCSizedType(llvm::Type *T) const {
@@ -182,21 +236,27 @@ public:
 public:
   /// \param Targets the targets to materialize for the dispatcher. Will be
   ///        sorted.
+  /// \param Weights if provided, used to attach branch weights to all the
+  ///        switches of the dispatcher.
   llvm::SwitchInst *
   buildDispatcher(DispatcherTargets &Targets,
                   llvm::IRBuilder<> &Builder,
                   llvm::BasicBlock *Default,
-                  llvm::Optional<BlockType::Values> SetBlockType) const;
+                  llvm::Optional<BlockType::Values> SetBlockType,
+                  DispatcherWeights Weights = nullptr) const;
 
   llvm::SwitchInst *
   buildDispatcher(DispatcherTargets &Targets,
                   llvm::BasicBlock *CreateIn,
                   llvm::BasicBlock *Default,
-                  llvm::Optional<BlockType::Values> SetBlockType) const {
+                  llvm::Optional<BlockType::Values> SetBlockType,
+                  DispatcherWeights Weights = nullptr) const {
     llvm::IRBuilder<> Builder(CreateIn);
-    return buildDispatcher(Targets, Builder, Default, SetBlockType);
+    return buildDispatcher(Targets, Builder, Default, SetBlockType, Weights);
   }
 
+  /// \param NewTarget the target to add, its MetaAddress must not be already
+  ///        handled by the dispatcher.
   void
   addCaseToDispatcher(llvm::SwitchInst *Root,
                       const DispatcherTarget &NewTarget,
@@ -204,11 +264,33 @@ public:
 
   void destroyDispatcher(llvm::SwitchInst *Root) const;
 
+  /// \brief Jump to \p CandidateTarget if the PC matches it, to \p Default
+  ///        otherwise
+  ///
+  /// \note The candidate is fixed at lift time. A runtime inline cache, where
+  ///       each site remembers the last block it jumped to, would require an
+  ///       indirectbr listing as possible successors every jump target,
+  ///       turning each site into a copy of the dispatcher for the CFG
+  ///       analyses and hiding the recovered control flow.
   void buildHotPath(llvm::IRBuilder<> &Builder,
                     const DispatcherTarget &CandidateTarget,
                     llvm::BasicBlock *Default) const;
 
 protected:
+  bool matchesSingleWordBase(const MetaAddress &MA) const {
+    return (MA.epoch() == SingleWordBase.epoch()
+            and MA.addressSpace() == SingleWordBase.addressSpace()
+            and MA.type() == SingleWordBase.type());
+  }
+
+  /// \brief Load the value of \p CSV, or get it, if it's a constant
+  llvm::Value *
+  loadComponent(llvm::IRBuilder<> &B, llvm::GlobalVariable *CSV) const {
+    if (CSV->isConstant())
+      return CSV->getInitializer();
+    return B.CreateLoad(CSV);
+  }
+
   void createMissingVariables(llvm::Module *M) {
     if (AddressCSV == nullptr)
       AddressCSV = createAddress(M);
@@ -229,38 +311,91 @@ public:
 
     revng_assert(AddressCSV != nullptr and EpochCSV != nullptr
                  and AddressSpaceCSV != nullptr and TypeCSV != nullptr);
+
+    // Constant components mean the PC is a single word, recover them
+    if (EpochCSV->isConstant()) {
+      revng_assert(AddressSpaceCSV->isConstant() and TypeCSV->isConstant());
+      auto GetValue = [](llvm::GlobalVariable *CSV) {
+        using namespace llvm;
+        return getLimitedValue(cast<ConstantInt>(CSV->getInitializer()));
+      };
+      auto Type = static_cast<MetaAddressType::Values>(GetValue(TypeCSV));
+      SingleWordBase = MetaAddress(0,
+                                   Type,
+                                   GetValue(EpochCSV),
+                                   GetValue(AddressSpaceCSV));
+    } else {
+      revng_assert(not AddressSpaceCSV->isConstant()
+                   and not TypeCSV->isConstant());
+    }
   }
 
 private:
   bool isPCAffectingHelper(llvm::Instruction *I) const;
 
+  static bool isValid(const CachedJumpTarget &Entry);
+
+  /// \brief The actual implementation of getUniqueJumpTarget
+  ///
+  /// \param Entry the cache entry to record the non-constant store in.
+  /// \param AllVisited the set to collect all the visited blocks in.
+  std::pair<NextJumpTarget::Values, MetaAddress>
+  computeUniqueJumpTarget(llvm::BasicBlock *BB,
+                          CachedJumpTarget &Entry,
+                          std::set<llvm::BasicBlock *> &AllVisited);
+
   static llvm::GlobalVariable *createAddress(llvm::Module *M) {
     return createVariable(M, AddressName, sizeof(MetaAddress::Address));
   }
 
-  static llvm::GlobalVariable *createEpoch(llvm::Module *M) {
-    return createVariable(M, EpochName, sizeof(MetaAddress::Epoch));
+  llvm::GlobalVariable *createEpoch(llvm::Module *M) const {
+    constexpr size_t Size = sizeof(MetaAddress::Epoch);
+    if (isSingleWord())
+      return createConstant(M, EpochName, Size, SingleWordBase.epoch());
+    return createVariable(M, EpochName, Size);
   }
 
-  static llvm::GlobalVariable *createAddressSpace(llvm::Module *M) {
-    return createVariable(M,
-                          AddressSpaceName,
-                          sizeof(MetaAddress::AddressSpace));
+  llvm::GlobalVariable *createAddressSpace(llvm::Module *M) const {
+    constexpr size_t Size = sizeof(MetaAddress::AddressSpace);
+    if (isSingleWord())
+      return createConstant(M,
+                            AddressSpaceName,
+                            Size,
+                            SingleWordBase.addressSpace());
+    return createVariable(M, AddressSpaceName, Size);
   }
 
-  static llvm::GlobalVariable *createType(llvm::Module *M) {
-    return createVariable(M, TypeName, sizeof(MetaAddress::Type));
+  llvm::GlobalVariable *createType(llvm::Module *M) const {
+    constexpr size_t Size = sizeof(MetaAddress::Type);
+    if (isSingleWord())
+      return createConstant(M, TypeName, Size, SingleWordBase.type());
+    return createVariable(M, TypeName, Size);
   }
 
   static llvm::GlobalVariable *
   createVariable(llvm::Module *M, llvm::StringRef Name, size_t Size) {
+    return createGlobal(M, Name, Size, 0, false);
+  }
+
+  static llvm::GlobalVariable *createConstant(llvm::Module *M,
+                                              llvm::StringRef Name,
+                                              size_t Size,
+                                              uint64_t Value) {
+    return createGlobal(M, Name, Size, Value, true);
+  }
+
+  static llvm::GlobalVariable *createGlobal(llvm::Module *M,
+                                            llvm::StringRef Name,
+                                            size_t Size,
+                                            uint64_t InitialValue,
+                                            bool IsConstant) {
     using namespace llvm;
     auto *T = Type::getIntNTy(M->getContext(), Size * 8);
     return new GlobalVariable(*M,
                               T,
-                              false,
+                              IsConstant,
                               GlobalValue::ExternalLinkage,
-                              ConstantInt::get(T, 0),
+                              ConstantInt::get(T, InitialValue),
                               Name);
   }
 
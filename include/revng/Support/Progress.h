@@ -0,0 +1,97 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// \brief Periodic, machine-readable progress report of long running tools
+///
+/// Enabled with `-progress-output=PATH` (`-` for stderr). Every
+/// `-progress-interval` seconds, and every time the phase changes, a JSON
+/// object is emitted on a line of its own:
+///
+///     {"elapsed":12.5,"phase":"lift","counters":{"harvest-round":3,
+///      "translated-blocks":1200},"rates":{"translated-blocks":96.1}}
+///
+/// `rates` reports, for the counters updated with advance, the increase per
+/// second since the previous line. finish emits a last line with
+/// `"done":true`.
+///
+/// Call tick in the main loops: it only reads the clock, so it's cheap enough
+/// to be called once per iteration.
+class ProgressReporter {
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Counter {
+    uint64_t Value = 0;
+    uint64_t LastReported = 0;
+    bool IsThroughput = false;
+  };
+
+public:
+  ProgressReporter();
+
+  bool enabled() const { return Output != nullptr; }
+
+  /// \brief Enter phase \p Name, reporting immediately
+  void setPhase(llvm::StringRef Name) {
+    if (not enabled() or Phase == Name)
+      return;
+
+    Phase = Name.str();
+    emit(false);
+  }
+
+  /// \brief Set the value of the counter \p Name
+  void set(llvm::StringRef Name, uint64_t Value) {
+    if (enabled())
+      Counters[Name.str()].Value = Value;
+  }
+
+  /// \brief Increase the counter \p Name, whose throughput will be reported
+  void advance(llvm::StringRef Name, uint64_t Delta = 1) {
+    if (not enabled())
+      return;
+
+    Counter &C = Counters[Name.str()];
+    C.Value += Delta;
+    C.IsThroughput = true;
+  }
+
+  /// \brief Report, if at least -progress-interval seconds have elapsed
+  void tick() {
+    if (enabled() and Clock::now() >= NextReport)
+      emit(false);
+  }
+
+  /// \brief Emit the final report
+  void finish() {
+    if (enabled())
+      emit(true);
+  }
+
+private:
+  void emit(bool Done);
+
+private:
+  std::unique_ptr<llvm::raw_fd_ostream> OwnedOutput;
+  llvm::raw_ostream *Output = nullptr;
+  std::string Phase;
+  std::map<std::string, Counter> Counters;
+  Clock::time_point Start;
+  Clock::time_point LastReport;
+  Clock::time_point NextReport;
+};
+
+extern llvm::ManagedStatic<ProgressReporter> Progress;
@@ -4,22 +4,49 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <csignal>
 #include <cstdlib>
+#include <ctime>
+#include <limits>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/ManagedStatic.h"
 
 #include "revng/Support/Debug.h"
+#include "revng/Support/PerfCounters.h"
 
 const size_t MaxCounterMapDump = 32;
 
+/// \brief Whether statistics are collected at all
+///
+/// Configure with -DREVNG_DISABLE_STATISTICS=ON to turn all the methods
+/// recording data (CounterMap::push, RunningStatistics::push and ScopedTimer)
+/// into no-ops.
+///
+/// \note None of the statistics classes is thread-safe: they are meant to be
+///       used from passes, which all run on the same thread.
+#ifdef REVNG_DISABLE_STATISTICS
+constexpr bool StatisticsEnabled = false;
+#else
+constexpr bool StatisticsEnabled = true;
+#endif
+
 class OnQuitInteraface {
 public:
   virtual void onQuit() = 0;
+
+  /// \brief Emit the collected data as an attribute of the current object
+  virtual void toJSON(llvm::json::OStream &Output) = 0;
   virtual ~OnQuitInteraface();
 };
 
@@ -46,13 +73,30 @@ public:
   CounterMap(const llvm::Twine &Name) : Name(Name.str()) { init(); }
   virtual ~CounterMap() {}
 
-  void push(K Key) { Map[Key]++; }
-  void push(K Key, T Value) { Map[Key] += Value; }
+  void push(K Key) {
+    if constexpr (StatisticsEnabled)
+      Map[Key]++;
+  }
+
+  void push(K Key, T Value) {
+    if constexpr (StatisticsEnabled)
+      Map[Key] += Value;
+  }
   void clear(K Key) { Map.erase(Key); }
   void clear() { Map.clear(); }
 
   virtual void onQuit() { dump(); }
 
+  virtual void toJSON(llvm::json::OStream &Output) {
+    if (Name.empty())
+      return;
+
+    Output.attributeObject(Name, [this, &Output]() {
+      for (auto &[Key, Value] : Map)
+        Output.attribute(Key, static_cast<int64_t>(Value));
+    });
+  }
+
   template<typename O>
   void dump(size_t Max, O &Output) {
     if (not Name.empty())
@@ -92,6 +136,94 @@ private:
   void init();
 };
 
+/// \brief Log-linear histogram of non-negative values, in the style of HDR
+///        histograms
+///
+/// Each power of two is split in 2^SubBucketBits buckets of the same size, so
+/// that percentiles are reported with a relative error below 2^-SubBucketBits,
+/// whatever the magnitude of the values. Only non-empty buckets are stored.
+class Histogram {
+public:
+  static constexpr unsigned SubBucketBits = 5;
+
+public:
+  void push(double X) {
+    N++;
+    Max = (N == 1) ? X : std::max(Max, X);
+    Buckets[bucketOf(X)]++;
+  }
+
+  void clear() {
+    N = 0;
+    Max = 0.0;
+    Buckets.clear();
+  }
+
+  uint64_t size() const { return N; }
+
+  double max() const { return Max; }
+
+  /// \return an upper bound of the values below which \p Percentile percent of
+  ///         the samples fall
+  double percentile(double Percentile) const {
+    if (N == 0)
+      return 0.0;
+
+    auto Rank = static_cast<uint64_t>(std::ceil(Percentile / 100.0 * N));
+    Rank = std::max<uint64_t>(Rank, 1);
+
+    uint64_t Seen = 0;
+    for (auto &[Bucket, Count] : Buckets) {
+      Seen += Count;
+      if (Seen >= Rank)
+        return std::min(upperBound(Bucket), Max);
+    }
+
+    return Max;
+  }
+
+private:
+  static constexpr int SubBuckets = 1 << SubBucketBits;
+
+  /// \note Non-positive values all go in the first bucket
+  static int bucketOf(double X) {
+    if (not(X > 0.0))
+      return std::numeric_limits<int>::min();
+
+    // X = Mantissa * 2^Exponent, with Mantissa in [0.5, 1)
+    int Exponent = 0;
+    double Mantissa = std::frexp(X, &Exponent);
+    int SubBucket = static_cast<int>((Mantissa * 2.0 - 1.0) * SubBuckets);
+    return Exponent * SubBuckets + std::min(SubBucket, SubBuckets - 1);
+  }
+
+  static double upperBound(int Bucket) {
+    if (Bucket == std::numeric_limits<int>::min())
+      return 0.0;
+
+    // Round towards negative infinity
+    int Exponent = Bucket / SubBuckets;
+    if (Bucket % SubBuckets < 0)
+      Exponent--;
+    int SubBucket = Bucket - Exponent * SubBuckets;
+
+    double Mantissa = 1.0 + static_cast<double>(SubBucket + 1) / SubBuckets;
+    return std::ldexp(Mantissa, Exponent - 1);
+  }
+
+private:
+  uint64_t N = 0;
+  double Max = 0.0;
+  std::map<int, uint64_t> Buckets;
+};
+
+/// \brief Tag requesting a RunningStatistics to also record the distribution
+///        of the values
+struct RecordDistribution {
+  /// Number of largest values to keep track of, along with their label
+  unsigned Worst = 5;
+};
+
 /// \brief Collect mean and variance about a certain event.
 ///
 /// To use this class, simply create a global variable, call push with the value
@@ -100,7 +232,19 @@ private:
 ///
 /// If a name is provided, the results will be registered for printing at
 /// program termination.
+///
+/// If constructed with RecordDistribution, the values are also collected in a
+/// Histogram, and percentiles and maximum are reported too. This is meant for
+/// durations, whose tail matters more than their mean: in this case, provide a
+/// label to push (e.g., the name of the analyzed function), so that the
+/// largest values can be traced back to their origin.
 class RunningStatistics : public OnQuitInteraface {
+public:
+  struct Sample {
+    double Value;
+    std::string Label;
+  };
+
 public:
   RunningStatistics() : RunningStatistics(llvm::Twine(), false) {}
 
@@ -116,13 +260,26 @@ public:
       init();
   }
 
+  RunningStatistics(const llvm::Twine &Name, RecordDistribution Options) :
+    RunningStatistics(Name, true) {
+    HasDistribution = true;
+    MaxWorst = Options.Worst;
+  }
+
   virtual ~RunningStatistics() {}
 
-  void clear() { N = 0; }
+  void clear() {
+    N = 0;
+    Distribution.clear();
+    Worst.clear();
+  }
 
   // TODO: make a template
   /// \brief Record a new value
   void push(double X) {
+    if constexpr (not StatisticsEnabled)
+      return;
+
     N++;
     Sum += X;
 
@@ -138,6 +295,33 @@ public:
       OldM = NewM;
       OldS = NewS;
     }
+
+    if (HasDistribution)
+      Distribution.push(X);
+  }
+
+  /// \brief Record a new value, labeled by \p Label if it's among the largest
+  ///
+  /// \p Label is invoked only if the value is kept.
+  void push(double X, llvm::function_ref<std::string()> Label) {
+    if constexpr (not StatisticsEnabled)
+      return;
+
+    push(X);
+
+    if (MaxWorst == 0)
+      return;
+
+    if (Worst.size() == MaxWorst) {
+      if (X <= Worst.back().Value)
+        return;
+      Worst.pop_back();
+    }
+
+    // Keep Worst sorted by decreasing value
+    auto IsLarger = [](const Sample &S, double X) { return S.Value >= X; };
+    auto It = std::lower_bound(Worst.begin(), Worst.end(), X, IsLarger);
+    Worst.insert(It, { X, Label() });
   }
 
   /// \return the total number of recorded values.
@@ -151,6 +335,12 @@ public:
 
   double sum() const { return Sum; }
 
+  /// \note Available only if constructed with RecordDistribution
+  const Histogram &distribution() const { return Distribution; }
+
+  /// \return the largest values pushed with a label, largest first
+  const std::vector<Sample> &worst() const { return Worst; }
+
   template<typename T>
   void dump(T &Output) {
     if (not Name.empty())
@@ -158,21 +348,77 @@ public:
     Output << "{ s: " << sum() << " "
            << "n: " << size() << " "
            << "u: " << mean() << " "
-           << "o: " << variance() << " }";
+           << "o: " << variance();
+
+    if (HasDistribution) {
+      for (auto &[Percentile, Name] : ReportedPercentiles)
+        Output << " " << Name << ": " << Distribution.percentile(Percentile);
+      Output << " max: " << Distribution.max();
+    }
+
+    Output << " }";
+
+    for (const Sample &S : Worst)
+      Output << "\n  " << S.Label << ": " << S.Value;
   }
 
   void dump() { dump(dbg); }
 
   virtual void onQuit();
 
+  virtual void toJSON(llvm::json::OStream &Output) {
+    if (Name.empty())
+      return;
+
+    Output.attributeObject(Name, [this, &Output]() {
+      Output.attribute("sum", sum());
+      Output.attribute("count", size());
+      Output.attribute("mean", mean());
+      Output.attribute("variance", variance());
+
+      if (HasDistribution) {
+        Output.attributeObject("percentiles", [this, &Output]() {
+          for (auto &[Percentile, Name] : ReportedPercentiles)
+            Output.attribute(Name, Distribution.percentile(Percentile));
+        });
+        Output.attribute("max", Distribution.max());
+      }
+
+      if (not Worst.empty()) {
+        Output.attributeArray("worst", [this, &Output]() {
+          for (const Sample &S : Worst) {
+            Output.object([&S, &Output]() {
+              Output.attribute("label", S.Label);
+              Output.attribute("value", S.Value);
+            });
+          }
+        });
+      }
+    });
+  }
+
 private:
   void init();
 
+private:
+  struct ReportedPercentile {
+    double Percentile;
+    const char *Name;
+  };
+
+  static constexpr ReportedPercentile ReportedPercentiles[] = {
+    { 50, "p50" }, { 90, "p90" }, { 99, "p99" }, { 99.9, "p99.9" }
+  };
+
 private:
   std::string Name;
   int N;
   double OldM, NewM, OldS, NewS;
   double Sum;
+  bool HasDistribution = false;
+  Histogram Distribution;
+  unsigned MaxWorst = 0;
+  std::vector<Sample> Worst;
 };
 
 // TODO: this is duplicated
@@ -194,6 +440,15 @@ public:
       S->onQuit();
   }
 
+  /// \brief Write all the registered statistics as a JSON object
+  void toJSON(llvm::raw_ostream &Output) {
+    llvm::json::OStream JSON(Output, 2);
+    JSON.object([this, &JSON]() {
+      for (OnQuitInteraface *S : Register)
+        S->toJSON(JSON);
+    });
+  }
+
 private:
   std::vector<OnQuitInteraface *> Register;
 };
@@ -209,4 +464,236 @@ inline void CounterMap<K, T>::init() {
   OnQuitStatistics->add(this);
 }
 
+/// \brief Hierarchical collection of wall time, CPU time and call counts
+///
+/// Phases are measured through ScopedTimer. Each phase is recorded as a child
+/// of the innermost phase active when it starts, so that the same phase
+/// reached from different parents is accounted separately.
+///
+/// The report is printed, as a tree, upon program termination. If
+/// -perf-counters is specified, it also includes hardware events.
+class PhaseTimers : public OnQuitInteraface {
+public:
+  struct Phase {
+    std::string Name;
+    Phase *Parent = nullptr;
+    uint64_t Calls = 0;
+    std::chrono::steady_clock::duration Wall{};
+    std::clock_t CPU = 0;
+
+    /// Resident set size, in bytes, at the end of the last run
+    uint64_t RSS = 0;
+
+    /// Peak resident set size of the process, in bytes, at the end of the
+    /// latest run
+    uint64_t PeakRSS = 0;
+
+    /// Hardware events, valid only if HasCounters, see PerfCounters
+    PerfCounters::Sample Counters{};
+    bool HasCounters = false;
+
+    std::vector<std::unique_ptr<Phase>> Children;
+
+    Phase *getChild(llvm::StringRef ChildName) {
+      for (std::unique_ptr<Phase> &Child : Children)
+        if (Child->Name == ChildName)
+          return Child.get();
+
+      Children.push_back(std::make_unique<Phase>());
+      Phase *Result = Children.back().get();
+      Result->Name = ChildName.str();
+      Result->Parent = this;
+      return Result;
+    }
+  };
+
+public:
+  PhaseTimers() { init(); }
+  virtual ~PhaseTimers() {}
+
+  /// \brief Make the \p Name child of the current phase the current one
+  Phase *enter(llvm::StringRef Name) {
+    Current = Current->getChild(Name);
+    return Current;
+  }
+
+  /// \brief Go back to the parent of \p P, which must be the current phase
+  void exit(Phase *P) {
+    revng_assert(P == Current and P->Parent != nullptr);
+    Current = P->Parent;
+  }
+
+  virtual void onQuit() { dump(dbg); }
+
+  virtual void toJSON(llvm::json::OStream &Output);
+
+  void dump(std::ostream &Output) const;
+
+  /// \brief Record the current memory usage in \p P
+  static void sampleMemory(Phase *P);
+
+private:
+  void init();
+
+private:
+  Phase Root;
+  Phase *Current = &Root;
+};
+
+extern llvm::ManagedStatic<PhaseTimers> Timers;
+
+/// \brief Approximate memory footprint of the main data structures
+///
+/// Subsystems (e.g., StackAnalysis, AVI or the JumpTargetManager) report how
+/// many bytes their long-lived data structures take through a MemoryGauge.
+/// They do so after updating them in bulk, rather than on each allocation, so
+/// that the gauges are cheap enough to be always on.
+///
+/// The gauges are sampled at the end of each phase measured by ScopedTimer:
+/// the report shows the value of each gauge when the resident set size was at
+/// its highest, along with the highest value of the gauge itself.
+class MemoryGaugeRegistry : public OnQuitInteraface {
+public:
+  struct Gauge {
+    std::string Name;
+    uint64_t Current = 0;
+    uint64_t Peak = 0;
+
+    /// Value at the time of the highest resident set size sampled so far
+    uint64_t AtPeakRSS = 0;
+  };
+
+public:
+  MemoryGaugeRegistry() { init(); }
+  virtual ~MemoryGaugeRegistry() {}
+
+  Gauge *get(llvm::StringRef Name) {
+    for (std::unique_ptr<Gauge> &G : Gauges)
+      if (G->Name == Name)
+        return G.get();
+
+    Gauges.push_back(std::make_unique<Gauge>());
+    Gauges.back()->Name = Name.str();
+    return Gauges.back().get();
+  }
+
+  /// \brief Record the gauges if \p RSS is the highest seen so far
+  void sample(uint64_t RSS) {
+    if (RSS < PeakRSS)
+      return;
+
+    PeakRSS = RSS;
+    for (std::unique_ptr<Gauge> &G : Gauges)
+      G->AtPeakRSS = G->Current;
+  }
+
+  virtual void onQuit() { dump(dbg); }
+
+  virtual void toJSON(llvm::json::OStream &Output);
+
+  void dump(std::ostream &Output) const;
+
+private:
+  void init();
+
+private:
+  std::vector<std::unique_ptr<Gauge>> Gauges;
+  uint64_t PeakRSS = 0;
+};
+
+extern llvm::ManagedStatic<MemoryGaugeRegistry> MemoryGauges;
+
+/// \brief Number of bytes taken by the data structures of a subsystem
+///
+/// Usage:
+///
+///     static MemoryGauge JTMMemory("JumpTargetManager");
+///     ...
+///     JTMMemory.set(nodeFootprint(JumpTargets));
+///
+/// Multiple objects of the same subsystem can share a gauge using add.
+class MemoryGauge {
+public:
+  MemoryGauge(llvm::StringRef Name) : G(MemoryGauges->get(Name)) {}
+
+  void set(uint64_t Bytes) {
+    if constexpr (StatisticsEnabled) {
+      G->Current = Bytes;
+      G->Peak = std::max(G->Peak, Bytes);
+    }
+  }
+
+  void add(int64_t Bytes) { set(G->Current + Bytes); }
+
+private:
+  MemoryGaugeRegistry::Gauge *G;
+};
+
+/// \brief Approximate number of bytes taken by a node-based container
+///
+/// Each element of a std::map or std::set is allocated along with three
+/// pointers and the color of the node.
+template<typename T>
+inline uint64_t nodeFootprint(const T &Container) {
+  using value_type = typename T::value_type;
+  return Container.size() * (sizeof(value_type) + 4 * sizeof(void *));
+}
+
+/// \brief RAII object measuring the time spent in a phase of the pipeline
+///
+/// Usage:
+///
+///     ScopedTimer Timer("StackAnalysis");
+///
+/// \note The name is only used to look up the phase, it's not retained.
+class ScopedTimer {
+public:
+  ScopedTimer(llvm::StringRef Name) {
+    if constexpr (StatisticsEnabled) {
+      P = Timers->enter(Name);
+      WallStart = std::chrono::steady_clock::now();
+      CPUStart = std::clock();
+      HasCounters = PerfCounters::read(CountersStart);
+    }
+  }
+
+  ~ScopedTimer() {
+    if constexpr (StatisticsEnabled) {
+      P->Calls++;
+      P->Wall += std::chrono::steady_clock::now() - WallStart;
+      P->CPU += std::clock() - CPUStart;
+
+      PerfCounters::Sample CountersEnd;
+      if (HasCounters and PerfCounters::read(CountersEnd)) {
+        P->HasCounters = true;
+        for (unsigned I = 0; I < PerfCounter::Count; ++I)
+          P->Counters[I] += CountersEnd[I] - CountersStart[I];
+      }
+
+      PhaseTimers::sampleMemory(P);
+      if (MemoryGauges.isConstructed())
+        MemoryGauges->sample(P->RSS);
+      Timers->exit(P);
+    }
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+  PhaseTimers::Phase *P = nullptr;
+  std::chrono::steady_clock::time_point WallStart;
+  std::clock_t CPUStart = 0;
+  PerfCounters::Sample CountersStart;
+  bool HasCounters = false;
+};
+
+inline void PhaseTimers::init() {
+  OnQuitStatistics->add(this);
+}
+
+inline void MemoryGaugeRegistry::init() {
+  OnQuitStatistics->add(this);
+}
+
 extern void installStatistics();
@@ -81,7 +81,10 @@ enum Values {
   FunctionSymbol = 1024,
   /// Immediate value in the IR, usually a return address
   SimpleLiteral = 2048,
-  LastReason = SimpleLiteral
+  /// Basic block or function entry of a previous analysis of the program (see
+  /// -seed-model and -seed-cfg)
+  Seeded = 4096,
+  LastReason = Seeded
 };
 
 inline const char *getName(Values Reason) {
@@ -110,6 +113,8 @@ inline const char *getName(Values Reason) {
     return "FunctionSymbol";
   case SimpleLiteral:
     return "SimpleLiteral";
+  case Seeded:
+    return "Seeded";
   }
 
   revng_abort();
@@ -140,6 +145,8 @@ inline Values fromName(llvm::StringRef ReasonName) {
     return FunctionSymbol;
   else if (ReasonName == "SimpleLiteral")
     return SimpleLiteral;
+  else if (ReasonName == "Seeded")
+    return Seeded;
   else
     revng_abort();
 }
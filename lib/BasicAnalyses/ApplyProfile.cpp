@@ -0,0 +1,240 @@
+/// \file ApplyProfile.cpp
+/// \brief Annotate the module with an execution profile and lay it out.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ProfileSummary.h"
+
+#include "revng/BasicAnalyses/ApplyProfile.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+static Logger<> ApplyProfileLog("apply-profile");
+
+static cl::opt<std::string> ProfilePath("apply-profile-path",
+                                        cl::desc("coverage CSV to apply with "
+                                                 "-apply-profile"),
+                                        cl::value_desc("path"),
+                                        cl::cat(MainCategory));
+
+char ApplyProfile::ID = 0;
+using Register = RegisterPass<ApplyProfile>;
+static Register X("apply-profile",
+                  "Annotate the module with an execution profile and lay it "
+                  "out",
+                  false,
+                  false);
+
+ApplyProfile::ApplyProfile() : llvm::ModulePass(ID), Path(ProfilePath) {
+}
+
+/// \brief Number of executions of each jump target, by PC representation
+///
+/// As in the coverage CSV, a PC with the LSB set is Thumb code.
+using HitsMap = std::map<uint64_t, uint64_t>;
+
+static HitsMap readCoverage(const std::string &Path) {
+  std::ifstream Input(Path);
+  revng_check(Input.is_open(), "Cannot open the profile");
+
+  std::string Line;
+  revng_check(std::getline(Input, Line) and StringRef(Line).trim() == "pc,hits",
+              "The profile is not a coverage CSV");
+
+  HitsMap Result;
+  while (std::getline(Input, Line)) {
+    StringRef PCString, HitsString;
+    std::tie(PCString, HitsString) = StringRef(Line).split(',');
+
+    uint64_t PC = 0;
+    uint64_t Hits = 0;
+    bool Invalid = PCString.trim().getAsInteger(0, PC)
+                   or HitsString.trim().getAsInteger(10, Hits);
+    revng_check(not Invalid, "Invalid line in the profile");
+    Result[PC] += Hits;
+  }
+
+  return Result;
+}
+
+/// \brief Compute the detailed summary as ProfileSummaryBuilder does
+static SummaryEntryVector
+computeDetailedSummary(std::vector<uint64_t> Counts, uint64_t Total) {
+  static const uint32_t Cutoffs[] = { 10000,  100000, 200000, 300000,
+                                      400000, 500000, 600000, 700000,
+                                      800000, 900000, 950000, 990000,
+                                      999000, 999900, 999990, 999999 };
+  const uint64_t Scale = ProfileSummary::Scale;
+
+  std::sort(Counts.begin(), Counts.end(), std::greater<uint64_t>());
+
+  SummaryEntryVector Result;
+  size_t Index = 0;
+  uint64_t Sum = 0;
+  for (uint32_t Cutoff : Cutoffs) {
+    double Desired = static_cast<double>(Total) * Cutoff / Scale;
+    while (Index < Counts.size() and Sum < Desired)
+      Sum += Counts[Index++];
+
+    uint64_t MinCount = Index == 0 ? 0 : Counts[Index - 1];
+    Result.emplace_back(Cutoff, MinCount, Index);
+  }
+
+  return Result;
+}
+
+namespace {
+
+class ProfileApplier {
+public:
+  ProfileApplier(Module &M, HitsMap Hits) : M(M), Hits(std::move(Hits)) {}
+
+  void run();
+
+private:
+  /// \brief Count of \p BB, looking through blocks with a single successor
+  Optional<uint64_t> getCount(BasicBlock *BB) const;
+
+  void setBranchWeights(Instruction *Terminator) const;
+
+private:
+  Module &M;
+  HitsMap Hits;
+};
+
+} // namespace
+
+Optional<uint64_t> ProfileApplier::getCount(BasicBlock *BB) const {
+  for (unsigned I = 0; I < 8 and BB != nullptr; ++I) {
+    MetaAddress PC = getBasicBlockPC(BB);
+    if (PC.isValid()) {
+      auto It = Hits.find(PC.asPC());
+      if (It == Hits.end())
+        return {};
+      return It->second;
+    }
+
+    BB = BB->getSingleSuccessor();
+  }
+
+  return {};
+}
+
+void ProfileApplier::setBranchWeights(Instruction *Terminator) const {
+  unsigned Successors = Terminator->getNumSuccessors();
+  if (Successors < 2
+      or not(isa<BranchInst>(Terminator) or isa<SwitchInst>(Terminator)))
+    return;
+
+  // Branch weights are 32-bit
+  std::vector<uint64_t> Counts;
+  uint64_t Max = 0;
+  for (BasicBlock *Successor : successors(Terminator)) {
+    Optional<uint64_t> Count = getCount(Successor);
+    if (not Count)
+      return;
+    Counts.push_back(*Count);
+    Max = std::max(Max, *Count);
+  }
+
+  if (Max == 0)
+    return;
+
+  uint64_t Scale = Max / std::numeric_limits<uint32_t>::max() + 1;
+  SmallVector<uint32_t, 4> Weights;
+  for (uint64_t Count : Counts)
+    Weights.push_back(Count / Scale);
+
+  MDBuilder Builder(M.getContext());
+  Terminator->setMetadata(LLVMContext::MD_prof,
+                          Builder.createBranchWeights(Weights));
+}
+
+void ProfileApplier::run() {
+  std::vector<uint64_t> BlockCounts;
+  std::vector<std::pair<Function *, uint64_t>> Functions;
+  uint64_t Total = 0;
+  uint64_t MaxCount = 0;
+  uint64_t MaxFunctionCount = 0;
+
+  for (Function &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    Optional<uint64_t> EntryCount = getCount(&F.getEntryBlock());
+    if (not EntryCount)
+      continue;
+
+    F.setEntryCount(*EntryCount);
+    Functions.emplace_back(&F, *EntryCount);
+    MaxFunctionCount = std::max(MaxFunctionCount, *EntryCount);
+
+    for (BasicBlock &BB : F) {
+      MetaAddress PC = getBasicBlockPC(&BB);
+      if (PC.isValid()) {
+        auto It = Hits.find(PC.asPC());
+        if (It != Hits.end()) {
+          BlockCounts.push_back(It->second);
+          Total += It->second;
+          MaxCount = std::max(MaxCount, It->second);
+        }
+      }
+
+      setBranchWeights(BB.getTerminator());
+    }
+  }
+
+  if (Functions.empty())
+    return;
+
+  // Let the profile summary analysis tell hot and cold code apart
+  ProfileSummary Summary(ProfileSummary::PSK_Instr,
+                         computeDetailedSummary(BlockCounts, Total),
+                         Total,
+                         MaxCount,
+                         MaxCount,
+                         MaxFunctionCount,
+                         BlockCounts.size(),
+                         Functions.size());
+  M.setProfileSummary(Summary.getMD(M.getContext()), ProfileSummary::PSK_Instr);
+
+  // Emit the hottest functions first, the others keep their relative order
+  std::stable_sort(Functions.begin(),
+                   Functions.end(),
+                   [](const auto &A, const auto &B) {
+                     return A.second > B.second;
+                   });
+  for (auto It = Functions.rbegin(); It != Functions.rend(); ++It) {
+    Function *F = It->first;
+    F->removeFromParent();
+    M.getFunctionList().push_front(F);
+  }
+
+  revng_log(ApplyProfileLog,
+            "Applied the profile to " << Functions.size() << " functions");
+}
+
+bool ApplyProfile::runOnModule(Module &M) {
+  if (Path.empty())
+    return false;
+
+  ProfileApplier Applier(M, readCoverage(Path));
+  Applier.run();
+
+  return true;
+}
@@ -0,0 +1,136 @@
+/// \file CSVAliasScopes.cpp
+/// \brief Separate CSVs, guest memory and helper calls through alias scopes.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/BasicAnalyses/CSVAliasScopes.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+using GCBI = GeneratedCodeBasicInfo;
+
+char CSVAliasScopes::ID = 0;
+using Register = RegisterPass<CSVAliasScopes>;
+static Register X("csv-alias-scopes",
+                  "Attach alias scopes to CSV and guest memory accesses",
+                  false,
+                  false);
+
+void CSVAliasScopes::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesCFG();
+  AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+}
+
+bool CSVAliasScopes::runOnModule(Module &M) {
+  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  ArrayRef<GlobalVariable *> CSVs = GCBI.csvs();
+  if (CSVs.empty())
+    return false;
+
+  LLVMContext &Context = M.getContext();
+  MDBuilder Builder(Context);
+
+  // Create the scopes separating CSVs from guest memory
+  MDNode *MemoryDomain = Builder.createAliasScopeDomain("revng.memory");
+  MDNode *CSVsScope = Builder.createAliasScope("csvs", MemoryDomain);
+  MDNode *GuestScope = Builder.createAliasScope("guest", MemoryDomain);
+  MDNode *CSVsList = MDNode::get(Context, CSVsScope);
+  MDNode *GuestList = MDNode::get(Context, GuestScope);
+
+  // Create a scope for each CSV
+  MDNode *CSVDomain = Builder.createAliasScopeDomain("revng.csvs");
+  DenseMap<const Value *, MDNode *> ScopeLists;
+  std::vector<Metadata *> Scopes;
+  Scopes.reserve(CSVs.size());
+  for (GlobalVariable *CSV : CSVs) {
+    MDNode *Scope = Builder.createAliasScope(CSV->getName(), CSVDomain);
+    Scopes.push_back(Scope);
+    ScopeLists[CSV] = MDNode::get(Context, { Scope, CSVsScope });
+  }
+
+  const auto LoadMDKind = M.getMDKindID("revng.csvaccess.offsets.load");
+  const auto StoreMDKind = M.getMDKindID("revng.csvaccess.offsets.store");
+  const auto GuestMemoryMDKind = M.getMDKindID("revng.guestmemory");
+
+  auto Tag = [](Instruction &I, unsigned Kind, MDNode *List) {
+    I.setMetadata(Kind, MDNode::concatenate(I.getMetadata(Kind), List));
+  };
+
+  // Call sites sharing the same summary share the same list of scopes too
+  DenseMap<const GCBI::HelperCallCSVUsage *, MDNode *> NoAliasLists;
+  auto GetNoAliasList = [&](Instruction *Call) -> MDNode * {
+    const GCBI::HelperCallCSVUsage &Usage = GCBI.getCSVUsage(Call);
+    auto It = NoAliasLists.find(&Usage);
+    if (It != NoAliasLists.end())
+      return It->second;
+
+    SmallVector<Metadata *, 16> Untouched;
+    for (unsigned I = 0; I < CSVs.size(); ++I)
+      if (not Usage.ReadSet[I] and not Usage.WrittenSet[I])
+        Untouched.push_back(Scopes[I]);
+
+    MDNode *Result = nullptr;
+    if (not Untouched.empty())
+      Result = MDNode::get(Context, Untouched);
+    NoAliasLists[&Usage] = Result;
+    return Result;
+  };
+
+  bool Changed = false;
+  for (Function &F : M) {
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        Value *Pointer = nullptr;
+        if (auto *Load = dyn_cast<LoadInst>(&I))
+          Pointer = Load->getPointerOperand();
+        else if (auto *Store = dyn_cast<StoreInst>(&I))
+          Pointer = Store->getPointerOperand();
+
+        if (Pointer != nullptr) {
+          if (I.getMetadata(GuestMemoryMDKind) != nullptr) {
+            Tag(I, LLVMContext::MD_alias_scope, GuestList);
+            Tag(I, LLVMContext::MD_noalias, CSVsList);
+            Changed = true;
+            continue;
+          }
+
+          // Accesses to a part of a CSV belong to its scope too
+          Pointer = Pointer->stripInBoundsConstantOffsets();
+          auto It = ScopeLists.find(Pointer);
+          if (It == ScopeLists.end())
+            continue;
+
+          Tag(I, LLVMContext::MD_alias_scope, It->second);
+          Tag(I, LLVMContext::MD_noalias, GuestList);
+          Changed = true;
+        } else if (isCallToHelper(&I)) {
+          // Helpers without a summary might touch any CSV
+          if (I.getMetadata(LoadMDKind) == nullptr
+              and I.getMetadata(StoreMDKind) == nullptr)
+            continue;
+
+          MDNode *NoAlias = GetNoAliasList(&I);
+          if (NoAlias == nullptr)
+            continue;
+
+          Tag(I, LLVMContext::MD_noalias, NoAlias);
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  return Changed;
+}
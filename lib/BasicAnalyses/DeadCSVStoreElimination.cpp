@@ -0,0 +1,231 @@
+/// \file DeadCSVStoreElimination.cpp
+/// \brief Erase the stores to CSVs that are never read.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+#include "revng/BasicAnalyses/DeadCSVStoreElimination.h"
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/Support/Statistics.h"
+
+using namespace llvm;
+
+static Logger<> DeadCSVStoresLog("dead-csv-stores");
+
+char DeadCSVStoreElimination::ID = 0;
+using Register = RegisterPass<DeadCSVStoreElimination>;
+static Register X("dead-csv-stores",
+                  "Erase the stores to CSVs that are never read",
+                  false,
+                  false);
+
+void DeadCSVStoreElimination::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesCFG();
+  AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+}
+
+namespace {
+
+/// \brief Backward liveness of the CSVs in a function
+class CSVLiveness {
+public:
+  CSVLiveness(GeneratedCodeBasicInfo &GCBI, Module &M) :
+    GCBI(GCBI),
+    DL(M.getDataLayout()),
+    LoadMDKind(M.getMDKindID("revng.csvaccess.offsets.load")),
+    StoreMDKind(M.getMDKindID("revng.csvaccess.offsets.store")),
+    GuestMemoryMDKind(M.getMDKindID("revng.guestmemory")) {
+    ArrayRef<GlobalVariable *> CSVs = GCBI.csvs();
+    for (unsigned I = 0; I < CSVs.size(); ++I)
+      Indices[CSVs[I]] = I;
+  }
+
+  /// \return the number of erased stores.
+  unsigned run(Function &F);
+
+private:
+  /// \brief Effect of an instruction on the liveness, scanning backward
+  struct Effect {
+    /// The instruction might read any CSV
+    bool All = false;
+
+    /// Index of the CSV fully overwritten by the instruction, if any
+    int Killed = -1;
+
+    /// Index of the CSV read by the instruction, if any
+    int Read = -1;
+
+    /// CSVs read by the instruction, for helper calls
+    const BitVector *ReadSet = nullptr;
+  };
+
+  Effect getEffect(Instruction &I) const;
+
+  int getCSVIndex(Value *Pointer) const {
+    auto It = Indices.find(Pointer->stripInBoundsConstantOffsets());
+    return It == Indices.end() ? -1 : It->second;
+  }
+
+  void apply(const Effect &E, BitVector &Live) const {
+    if (E.All) {
+      Live.set();
+      return;
+    }
+
+    if (E.Killed != -1)
+      Live.reset(E.Killed);
+    if (E.Read != -1)
+      Live.set(E.Read);
+    if (E.ReadSet != nullptr)
+      Live |= *E.ReadSet;
+  }
+
+private:
+  GeneratedCodeBasicInfo &GCBI;
+  const DataLayout &DL;
+  const unsigned LoadMDKind;
+  const unsigned StoreMDKind;
+  const unsigned GuestMemoryMDKind;
+  DenseMap<const Value *, unsigned> Indices;
+};
+
+} // namespace
+
+CSVLiveness::Effect CSVLiveness::getEffect(Instruction &I) const {
+  Effect Result;
+
+  if (auto *Load = dyn_cast<LoadInst>(&I)) {
+    Result.Read = getCSVIndex(Load->getPointerOperand());
+
+    // Local variables and guest memory are not CSVs
+    Value *Pointer = Load->getPointerOperand()->stripPointerCasts();
+    if (Result.Read == -1 and not isa<AllocaInst>(Pointer)
+        and I.getMetadata(GuestMemoryMDKind) == nullptr)
+      Result.All = true;
+
+  } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+    // Only a store covering the whole CSV kills it
+    Value *Pointer = Store->getPointerOperand();
+    auto *CSV = dyn_cast<GlobalVariable>(Pointer->stripPointerCasts());
+    int Index = getCSVIndex(Pointer);
+    if (Index != -1 and CSV != nullptr and Store->isSimple()) {
+      Type *StoredType = Store->getValueOperand()->getType();
+      if (DL.getTypeStoreSize(StoredType)
+          == DL.getTypeStoreSize(CSV->getValueType()))
+        Result.Killed = Index;
+    }
+
+  } else if (auto *Call = dyn_cast<CallInst>(&I)) {
+    Function *Callee = getCallee(Call);
+
+    if (isCallToHelper(Call)
+        and (Call->getMetadata(LoadMDKind) != nullptr
+             or Call->getMetadata(StoreMDKind) != nullptr)) {
+      // Helpers with a summary read only the CSVs listed there
+      Result.ReadSet = &GCBI.getCSVUsage(Call).ReadSet;
+    } else if (Callee != nullptr and Callee->isIntrinsic()
+               and (Call->doesNotAccessMemory()
+                    or isa<DbgInfoIntrinsic>(Call))) {
+      // Nothing to do
+    } else if (isCallTo(Call, "newpc") or isCallTo(Call, "function_call")) {
+      // Markers not reading the CPU state
+    } else {
+      Result.All = true;
+    }
+
+  } else if (I.mayReadFromMemory() or isa<ReturnInst>(&I)
+             or isa<UnreachableInst>(&I) or isa<ResumeInst>(&I)) {
+    // Leaving the function or reading memory in unexpected ways
+    Result.All = true;
+  }
+
+  return Result;
+}
+
+unsigned CSVLiveness::run(Function &F) {
+  const unsigned Size = Indices.size();
+
+  // Compute the live-in CSVs of each basic block
+  DenseMap<BasicBlock *, BitVector> LiveIn;
+  auto ComputeLiveOut = [&LiveIn, Size](BasicBlock *BB) {
+    BitVector Result(Size);
+    for (BasicBlock *Successor : successors(BB)) {
+      auto It = LiveIn.find(Successor);
+      if (It != LiveIn.end())
+        Result |= It->second;
+    }
+    return Result;
+  };
+
+  SmallSetVector<BasicBlock *, 16> WorkList;
+  for (BasicBlock *BB : post_order(&F))
+    WorkList.insert(BB);
+
+  // Unreachable blocks have no effect on the liveness of the other blocks
+  while (not WorkList.empty()) {
+    BasicBlock *BB = WorkList.pop_back_val();
+
+    BitVector Live = ComputeLiveOut(BB);
+    for (Instruction &I : make_range(BB->rbegin(), BB->rend()))
+      apply(getEffect(I), Live);
+
+    auto It = LiveIn.find(BB);
+    if (It != LiveIn.end() and It->second == Live)
+      continue;
+    LiveIn[BB] = std::move(Live);
+
+    for (BasicBlock *Predecessor : predecessors(BB))
+      WorkList.insert(Predecessor);
+  }
+
+  // Collect the stores to dead CSVs
+  std::vector<StoreInst *> DeadStores;
+  for (auto &P : LiveIn) {
+    BasicBlock *BB = P.first;
+    BitVector Live = ComputeLiveOut(BB);
+    for (Instruction &I : make_range(BB->rbegin(), BB->rend())) {
+      Effect E = getEffect(I);
+      if (E.Killed != -1 and not Live[E.Killed])
+        DeadStores.push_back(cast<StoreInst>(&I));
+      apply(E, Live);
+    }
+  }
+
+  for (StoreInst *Store : DeadStores) {
+    Value *Stored = Store->getValueOperand();
+    Store->eraseFromParent();
+    RecursivelyDeleteTriviallyDeadInstructions(Stored);
+  }
+
+  return DeadStores.size();
+}
+
+bool DeadCSVStoreElimination::runOnModule(Module &M) {
+  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  if (GCBI.csvs().empty())
+    return false;
+
+  CSVLiveness Liveness(GCBI, M);
+  unsigned Erased = 0;
+  for (Function &F : M)
+    if (not F.isDeclaration())
+      Erased += Liveness.run(F);
+
+  revng_log(DeadCSVStoresLog, "Erased " << Erased << " stores to CSVs");
+
+  return Erased != 0;
+}
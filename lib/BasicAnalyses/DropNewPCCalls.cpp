@@ -0,0 +1,36 @@
+/// \file DropNewPCCalls.cpp
+/// \brief A simple pass to erase all the calls to the `newpc` function.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/BasicAnalyses/DropNewPCCalls.h"
+
+using namespace llvm;
+
+char DropNewPCCalls::ID = 0;
+using Register = RegisterPass<DropNewPCCalls>;
+static Register
+  X("drop-newpc-calls", "Erase all the calls to newpc", true, false);
+
+bool DropNewPCCalls::runOnModule(llvm::Module &M) {
+  Function *NewPCFunction = M.getFunction("newpc");
+  if (NewPCFunction == nullptr)
+    return false;
+
+  SmallVector<CallInst *, 16> ToErase;
+  for (User *U : NewPCFunction->users())
+    if (auto *Call = dyn_cast<CallInst>(U))
+      if (Call->getCalledFunction() == NewPCFunction)
+        ToErase.push_back(Call);
+
+  for (CallInst *Call : ToErase)
+    Call->eraseFromParent();
+
+  return not ToErase.empty();
+}
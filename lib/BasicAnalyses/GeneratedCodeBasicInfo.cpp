@@ -12,6 +12,9 @@
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MD5.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/Support/Debug.h"
@@ -28,6 +31,7 @@ void GeneratedCodeBasicInfo::run(Module &M) {
   revng_log(PassesLog, "Starting GeneratedCodeBasicInfo");
 
   RootFunction = &F;
+  invalidateBlockIndices();
 
   const char *MDName = "revng.input.architecture";
   NamedMDNode *InputArchMD = M.getOrInsertNamedMetadata(MDName);
@@ -51,12 +55,37 @@ void GeneratedCodeBasicInfo::run(Module &M) {
       ABIRegisters.push_back(CSV);
       ABIRegistersSet.insert(CSV);
     }
+
+    // Modules lifted by older versions don't record the syscall helper
+    SyscallHelper = nullptr;
+    SyscallNumberRegister = nullptr;
+    if (Index + 1 < Tuple->getNumOperands()) {
+      SyscallHelper = M.getFunction(QMD.extract<StringRef>(Tuple, Index++));
+      StringRef Name = QMD.extract<StringRef>(Tuple, Index++);
+      SyscallNumberRegister = M.getGlobalVariable(Name, true);
+    }
   }
 
   Type *PCType = PC->getType()->getPointerElementType();
   PCRegSize = M.getDataLayout().getTypeAllocSize(PCType);
 
-  for (BasicBlock &BB : F) {
+  if (not loadBlocks(M))
+    scanBlocks();
+
+  if (auto *NamedMD = M.getNamedMetadata("revng.csv")) {
+    auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
+    for (const MDOperand &Operand : Tuple->operands()) {
+      auto *CSV = cast<GlobalVariable>(QMD.extract<Constant *>(Operand.get()));
+      CSVIndices[CSV] = CSVs.size();
+      CSVs.push_back(CSV);
+    }
+  }
+
+  revng_log(PassesLog, "Ending GeneratedCodeBasicInfo");
+}
+
+void GeneratedCodeBasicInfo::scanBlocks() {
+  for (BasicBlock &BB : *RootFunction) {
     if (!BB.empty()) {
       switch (getType(&BB)) {
       case BlockType::RootDispatcherBlock:
@@ -95,16 +124,121 @@ void GeneratedCodeBasicInfo::run(Module &M) {
       }
     }
   }
+}
 
-  if (auto *NamedMD = M.getNamedMetadata("revng.csv")) {
-    auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
-    for (const MDOperand &Operand : Tuple->operands()) {
-      auto *CSV = cast<GlobalVariable>(QMD.extract<Constant *>(Operand.get()));
-      CSVs.push_back(CSV);
+/// \brief Digest of the names of the basic blocks of \p Root, in order
+///
+/// Adding, removing, renaming or reordering blocks changes the digest, without
+/// having to inspect their instructions.
+static std::string rootDigest(Function &Root) {
+  MD5 Hash;
+  for (BasicBlock &BB : Root) {
+    StringRef Name = BB.getName();
+    support::ulittle64_t Size(Name.size());
+    Hash.update({ reinterpret_cast<const uint8_t *>(&Size), sizeof(Size) });
+    Hash.update(Name);
+  }
+
+  MD5::MD5Result Digest;
+  Hash.final(Digest);
+  return Digest.digest().str().str();
+}
+
+void GeneratedCodeBasicInfo::persist(Module &M) const {
+  QuickMetadata QMD(M.getContext());
+
+  auto GetName = [&QMD](BasicBlock *BB) -> Metadata * {
+    if (BB == nullptr or not BB->hasName())
+      return nullptr;
+    return QMD.get(BB->getName());
+  };
+
+  // Walk the root function instead of JumpTargets, so that the output is
+  // deterministic
+  std::vector<Metadata *> JumpTargetNames;
+  JumpTargetNames.reserve(JumpTargets.size());
+  for (BasicBlock &BB : *RootFunction) {
+    if (BB.empty() or getType(&BB) != BlockType::JumpTargetBlock)
+      continue;
+
+    Metadata *Name = GetName(&BB);
+    if (Name == nullptr)
+      return;
+    JumpTargetNames.push_back(Name);
+  }
+
+  SmallVector<Metadata *, 6> Operands;
+  Operands.push_back(QMD.get(rootDigest(*RootFunction)));
+  for (BasicBlock *BB : { Dispatcher, DispatcherFail, AnyPC, UnexpectedPC }) {
+    Metadata *Name = GetName(BB);
+    if (Name == nullptr)
+      return;
+    Operands.push_back(Name);
+  }
+  Operands.push_back(QMD.tuple(JumpTargetNames));
+
+  NamedMDNode *NamedMD = M.getOrInsertNamedMetadata(GCBIMDName);
+  NamedMD->clearOperands();
+  NamedMD->addOperand(QMD.tuple(Operands));
+}
+
+bool GeneratedCodeBasicInfo::loadBlocks(Module &M) {
+  NamedMDNode *NamedMD = M.getNamedMetadata(GCBIMDName);
+  if (NamedMD == nullptr or NamedMD->getNumOperands() != 1)
+    return false;
+
+  // If the basic blocks changed, the root function has been transformed since
+  // the table has been written. The types of the blocks in the table are
+  // checked below.
+  QuickMetadata QMD(M.getContext());
+  auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
+  auto *Digest = dyn_cast<MDString>(Tuple->getOperand(0).get());
+  if (Digest == nullptr or Digest->getString() != rootDigest(*RootFunction))
+    return false;
+
+  ValueSymbolTable *Symbols = RootFunction->getValueSymbolTable();
+  auto Lookup = [&](unsigned Index, BlockType::Values Type) -> BasicBlock * {
+    Value *V = Symbols->lookup(QMD.extract<StringRef>(Tuple, Index));
+    auto *BB = dyn_cast_or_null<BasicBlock>(V);
+    if (BB == nullptr or BB->empty() or getType(BB) != Type)
+      return nullptr;
+    return BB;
+  };
+
+  Dispatcher = Lookup(1, BlockType::RootDispatcherBlock);
+  DispatcherFail = Lookup(2, BlockType::DispatcherFailureBlock);
+  AnyPC = Lookup(3, BlockType::AnyPCBlock);
+  UnexpectedPC = Lookup(4, BlockType::UnexpectedPCBlock);
+
+  bool Valid = (Dispatcher != nullptr and DispatcherFail != nullptr
+                and AnyPC != nullptr and UnexpectedPC != nullptr);
+
+  if (Valid) {
+    auto *Names = QMD.extract<MDTuple *>(Tuple, 5);
+    JumpTargets.reserve(Names->getNumOperands());
+    for (const MDOperand &Operand : Names->operands()) {
+      Value *V = Symbols->lookup(QMD.extract<StringRef>(Operand.get()));
+      auto *BB = dyn_cast_or_null<BasicBlock>(V);
+      if (BB == nullptr or BB->empty() or not isJumpTarget(BB)) {
+        Valid = false;
+        break;
+      }
+
+      auto *Call = cast<CallInst>(&*BB->begin());
+      JumpTargets[MetaAddress::fromConstant(Call->getArgOperand(0))] = BB;
     }
   }
 
-  revng_log(PassesLog, "Ending GeneratedCodeBasicInfo");
+  if (not Valid) {
+    revng_log(PassesLog, "The persisted GCBI tables are stale");
+    Dispatcher = nullptr;
+    DispatcherFail = nullptr;
+    AnyPC = nullptr;
+    UnexpectedPC = nullptr;
+    JumpTargets.clear();
+  }
+
+  return Valid;
 }
 
 GeneratedCodeBasicInfo::Successors
@@ -136,6 +270,42 @@ GeneratedCodeBasicInfo::getSuccessors(BasicBlock *BB) const {
   return Result;
 }
 
+const GeneratedCodeBasicInfo::HelperCallCSVUsage &
+GeneratedCodeBasicInfo::getCSVUsage(Instruction *Call) const {
+  revng_assert(isCallToHelper(Call));
+
+  const Module *M = getModule(Call);
+  const auto LoadMDKind = M->getMDKindID("revng.csvaccess.offsets.load");
+  const auto StoreMDKind = M->getMDKindID("revng.csvaccess.offsets.store");
+  CSVUsageKey Key = { Call->getMetadata(LoadMDKind),
+                      Call->getMetadata(StoreMDKind) };
+  revng_assert(Key.first != nullptr or Key.second != nullptr);
+
+  auto It = CSVUsageIndices.find(Key);
+  if (It != CSVUsageIndices.end())
+    return CSVUsages[It->second];
+
+  HelperCallCSVUsage &Result = CSVUsages.emplace_back();
+  CSVUsageIndices[Key] = CSVUsages.size() - 1;
+
+  Result.Used = getCSVUsedByHelperCall(Call);
+
+  // CSVs not listed in revng.csv have no bit
+  auto ToBitVector = [this](const std::vector<GlobalVariable *> &List) {
+    BitVector Set(CSVs.size());
+    for (GlobalVariable *CSV : List) {
+      auto It = CSVIndices.find(CSV);
+      if (It != CSVIndices.end())
+        Set.set(It->second);
+    }
+    return Set;
+  };
+  Result.ReadSet = ToBitVector(Result.Used.Read);
+  Result.WrittenSet = ToBitVector(Result.Used.Written);
+
+  return Result;
+}
+
 AnalysisKey GeneratedCodeBasicInfoAnalysis::Key;
 GeneratedCodeBasicInfo
 GeneratedCodeBasicInfoAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
@@ -0,0 +1,351 @@
+/// \file GuestMemoryIdioms.cpp
+/// \brief Turn the loops filling or copying guest memory into memset/memmove.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include "revng/BasicAnalyses/GuestMemoryIdioms.h"
+#include "revng/Support/Debug.h"
+
+using namespace llvm;
+
+static Logger<> GuestMemoryIdiomsLog("guest-memory-idioms");
+
+char GuestMemoryIdioms::ID = 0;
+using Register = RegisterPass<GuestMemoryIdioms>;
+static Register X("guest-memory-idioms",
+                  "Turn the loops filling or copying guest memory into "
+                  "memset/memmove",
+                  false,
+                  false);
+
+void GuestMemoryIdioms::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<LoopInfoWrapperPass>();
+  AU.addRequired<ScalarEvolutionWrapperPass>();
+}
+
+/// \brief Return the integer address of a guest memory access, if any
+static Value *getGuestAddress(Value *Pointer) {
+  Pointer = Pointer->stripPointerCasts();
+  if (auto *Cast = dyn_cast<IntToPtrInst>(Pointer))
+    return Cast->getOperand(0);
+  if (auto *Expression = dyn_cast<ConstantExpr>(Pointer))
+    if (Expression->getOpcode() == Instruction::IntToPtr)
+      return Expression->getOperand(0);
+  return nullptr;
+}
+
+/// \brief Is \p Pointer a CSV (or another scalar global variable)?
+static bool isCSV(Value *Pointer) {
+  auto *GV = dyn_cast<GlobalVariable>(Pointer->stripInBoundsConstantOffsets());
+  if (GV == nullptr)
+    return false;
+
+  Type *ValueType = GV->getValueType();
+  return ValueType->isIntegerTy() or ValueType->isPointerTy();
+}
+
+namespace {
+
+/// \brief An address advancing of the access size at each iteration
+struct StridedAccess {
+  /// Address accessed by the first iteration
+  const SCEV *First = nullptr;
+
+  /// Lowest address accessed by the loop
+  const SCEV *Lowest = nullptr;
+
+  /// Number of accessed bytes
+  const SCEV *Length = nullptr;
+
+  bool Forward = true;
+};
+
+class IdiomRecognizer {
+public:
+  IdiomRecognizer(Function &F, ScalarEvolution &SE) :
+    F(F), SE(SE), DL(F.getParent()->getDataLayout()) {}
+
+  bool run(Loop *L);
+
+private:
+  Optional<StridedAccess>
+  getStridedAccess(Loop *L, Value *Address, uint64_t Size);
+
+  bool lowerFill(Loop *L, StoreInst *Store, const StridedAccess &Access);
+  bool lowerCopy(Loop *L,
+                 StoreInst *Store,
+                 LoadInst *Load,
+                 const StridedAccess &Destination,
+                 const StridedAccess &Source);
+
+private:
+  Function &F;
+  ScalarEvolution &SE;
+  const DataLayout &DL;
+};
+
+} // namespace
+
+Optional<StridedAccess>
+IdiomRecognizer::getStridedAccess(Loop *L, Value *Address, uint64_t Size) {
+  auto *AddRec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Address));
+  if (AddRec == nullptr or AddRec->getLoop() != L or not AddRec->isAffine())
+    return {};
+
+  auto *Step = dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(SE));
+  if (Step == nullptr)
+    return {};
+
+  const APInt &StepValue = Step->getAPInt();
+  if (StepValue != Size and -StepValue != Size)
+    return {};
+
+  const SCEV *BackedgeTakenCount = SE.getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BackedgeTakenCount))
+    return {};
+
+  Type *AddressType = Address->getType();
+  const SCEV *Iterations = SE.getAddExpr(SE.getTruncateOrZeroExtend(
+                                           BackedgeTakenCount,
+                                           AddressType),
+                                         SE.getOne(AddressType));
+
+  StridedAccess Result;
+  Result.First = AddRec->getStart();
+  Result.Forward = StepValue.isStrictlyPositive();
+  Result.Length = SE.getMulExpr(Iterations, SE.getConstant(AddressType, Size));
+  if (Result.Forward) {
+    Result.Lowest = Result.First;
+  } else {
+    const SCEV *Last = SE.getMinusSCEV(Iterations, SE.getOne(AddressType));
+    Result.Lowest = SE.getAddExpr(Result.First, SE.getMulExpr(Last, Step));
+  }
+
+  if (not isSafeToExpand(Result.Lowest, SE)
+      or not isSafeToExpand(Result.Length, SE))
+    return {};
+
+  return Result;
+}
+
+bool IdiomRecognizer::lowerFill(Loop *L,
+                                StoreInst *Store,
+                                const StridedAccess &Access) {
+  Value *Stored = Store->getValueOperand();
+  Value *Byte = isBytewiseValue(Stored, DL);
+  if (Byte == nullptr or not L->isLoopInvariant(Stored))
+    return false;
+
+  Instruction *InsertPoint = L->getLoopPreheader()->getTerminator();
+  Type *AddressType = getGuestAddress(Store->getPointerOperand())->getType();
+  SCEVExpander Expander(SE, DL, "guest_memset");
+  Value *Lowest = Expander.expandCodeFor(Access.Lowest,
+                                         AddressType,
+                                         InsertPoint);
+  Value *Length = Expander.expandCodeFor(Access.Length,
+                                         AddressType,
+                                         InsertPoint);
+
+  IRBuilder<> Builder(InsertPoint);
+  Value *Pointer = Builder.CreateIntToPtr(Lowest, Builder.getInt8PtrTy());
+  Builder.CreateMemSet(Pointer, Byte, Length, MaybeAlign(1));
+
+  Store->eraseFromParent();
+  return true;
+}
+
+bool IdiomRecognizer::lowerCopy(Loop *L,
+                                StoreInst *Store,
+                                LoadInst *Load,
+                                const StridedAccess &Destination,
+                                const StridedAccess &Source) {
+  if (Destination.Forward != Source.Forward)
+    return false;
+
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Exit = L->getExitBlock();
+  auto *Entry = dyn_cast<BranchInst>(Preheader->getTerminator());
+  if (Exit == nullptr or Entry == nullptr or Entry->isConditional())
+    return false;
+
+  // We'll clone the loop, make sure that only phis in the exit block use its
+  // values
+  for (Instruction &I : *Header) {
+    for (User *U : I.users()) {
+      auto *UserInstruction = cast<Instruction>(U);
+      BasicBlock *UserBlock = UserInstruction->getParent();
+      if (UserBlock != Header
+          and not(UserBlock == Exit and isa<PHINode>(UserInstruction)))
+        return false;
+    }
+  }
+
+  // The copy is a memmove, unless the destination is strictly inside the source
+  // range, ahead of the copy
+  Type *AddressType = getGuestAddress(Load->getPointerOperand())->getType();
+  SCEVExpander Expander(SE, DL, "guest_memmove");
+  auto Expand = [&Expander, AddressType, Entry](const SCEV *S) {
+    return Expander.expandCodeFor(S, AddressType, Entry);
+  };
+  Value *DestinationFirst = Expand(Destination.First);
+  Value *SourceFirst = Expand(Source.First);
+  Value *DestinationLowest = Expand(Destination.Lowest);
+  Value *SourceLowest = Expand(Source.Lowest);
+  Value *Length = Expand(Destination.Length);
+
+  IRBuilder<> Builder(Entry);
+  Value *Distance = nullptr;
+  if (Destination.Forward)
+    Distance = Builder.CreateSub(DestinationFirst, SourceFirst);
+  else
+    Distance = Builder.CreateSub(SourceFirst, DestinationFirst);
+  Value *Zero = ConstantInt::get(AddressType, 0);
+  Value *Overlapping = Builder.CreateAnd(Builder.CreateICmpNE(Distance, Zero),
+                                         Builder.CreateICmpULT(Distance,
+                                                              Length));
+
+  // Clone the loop: the clone keeps the side effects on the CSVs, but doesn't
+  // touch guest memory
+  ValueToValueMapTy VMap;
+  BasicBlock *Clone = CloneBasicBlock(Header, VMap, ".memmove", &F);
+  VMap[Header] = Clone;
+  auto Flags = RF_NoModuleLevelChanges | RF_IgnoreMissingLocals;
+  for (Instruction &I : *Clone)
+    RemapInstruction(&I, VMap, Flags);
+
+  for (PHINode &Phi : Exit->phis()) {
+    Value *Incoming = Phi.getIncomingValueForBlock(Header);
+    Value *Mapped = VMap.lookup(Incoming);
+    Phi.addIncoming(Mapped != nullptr ? Mapped : Incoming, Clone);
+  }
+
+  // Perform the copy and then enter the clone
+  LLVMContext &Context = F.getContext();
+  auto *Copy = BasicBlock::Create(Context, "guest_memmove", &F, Clone);
+  Builder.SetInsertPoint(Copy);
+  Builder.CreateMemMove(Builder.CreateIntToPtr(DestinationLowest,
+                                               Builder.getInt8PtrTy()),
+                        MaybeAlign(1),
+                        Builder.CreateIntToPtr(SourceLowest,
+                                               Builder.getInt8PtrTy()),
+                        MaybeAlign(1),
+                        Length);
+  Builder.CreateBr(Clone);
+
+  for (PHINode &Phi : Clone->phis())
+    for (unsigned I = 0; I < Phi.getNumIncomingValues(); ++I)
+      if (Phi.getIncomingBlock(I) == Preheader)
+        Phi.setIncomingBlock(I, Copy);
+
+  BranchInst::Create(Header, Copy, Overlapping, Entry);
+  Entry->eraseFromParent();
+
+  auto *ClonedStore = cast<StoreInst>(VMap[Store]);
+  auto *ClonedLoad = cast<LoadInst>(VMap[Load]);
+  ClonedStore->eraseFromParent();
+  ClonedLoad->eraseFromParent();
+
+  return true;
+}
+
+bool IdiomRecognizer::run(Loop *L) {
+  BasicBlock *Header = L->getHeader();
+  if (L->getNumBlocks() != 1 or L->getLoopPreheader() == nullptr
+      or L->getExitBlock() == nullptr)
+    return false;
+
+  // Look for a single guest memory store and, at most, the load feeding it
+  StoreInst *GuestStore = nullptr;
+  LoadInst *GuestLoad = nullptr;
+  for (Instruction &I : *Header) {
+    if (not I.mayReadOrWriteMemory())
+      continue;
+
+    if (auto *Load = dyn_cast<LoadInst>(&I)) {
+      if (isCSV(Load->getPointerOperand()))
+        continue;
+      if (GuestLoad != nullptr or not Load->isSimple()
+          or getGuestAddress(Load->getPointerOperand()) == nullptr)
+        return false;
+      GuestLoad = Load;
+    } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+      if (isCSV(Store->getPointerOperand()))
+        continue;
+      if (GuestStore != nullptr or not Store->isSimple()
+          or getGuestAddress(Store->getPointerOperand()) == nullptr)
+        return false;
+      GuestStore = Store;
+    } else {
+      return false;
+    }
+  }
+
+  if (GuestStore == nullptr)
+    return false;
+
+  Value *Stored = GuestStore->getValueOperand();
+  uint64_t Size = DL.getTypeStoreSize(Stored->getType());
+  Value *StoreAddress = getGuestAddress(GuestStore->getPointerOperand());
+  auto Destination = getStridedAccess(L, StoreAddress, Size);
+  if (not Destination)
+    return false;
+
+  if (GuestLoad == nullptr)
+    return lowerFill(L, GuestStore, *Destination);
+
+  if (Stored != GuestLoad or not GuestLoad->hasOneUse())
+    return false;
+
+  Value *LoadAddress = getGuestAddress(GuestLoad->getPointerOperand());
+  if (LoadAddress->getType() != StoreAddress->getType())
+    return false;
+
+  auto Source = getStridedAccess(L, LoadAddress, Size);
+  if (not Source)
+    return false;
+
+  return lowerCopy(L, GuestStore, GuestLoad, *Destination, *Source);
+}
+
+bool GuestMemoryIdioms::runOnFunction(Function &F) {
+  auto &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  auto &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+
+  // Collect the loops first, we change the CFG
+  std::vector<Loop *> Loops;
+  for (Loop *L : LI.getLoopsInPreorder())
+    if (L->getSubLoops().empty())
+      Loops.push_back(L);
+
+  IdiomRecognizer Recognizer(F, SE);
+  unsigned Lowered = 0;
+  for (Loop *L : Loops) {
+    if (Recognizer.run(L)) {
+      SE.forgetLoop(L);
+      Lowered++;
+    }
+  }
+
+  if (Lowered != 0)
+    revng_log(GuestMemoryIdiomsLog,
+              "Lowered " << Lowered << " loops in " << F.getName().data());
+
+  return Lowered != 0;
+}
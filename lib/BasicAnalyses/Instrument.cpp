@@ -0,0 +1,170 @@
+/// \file Instrument.cpp
+/// \brief Insert in the lifted code the callbacks of instrumentation plugins.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ManagedStatic.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/BasicAnalyses/Instrument.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+static Logger<> InstrumentLog("instrument");
+
+char Instrument::ID = 0;
+using Register = RegisterPass<Instrument>;
+static Register X("instrument",
+                  "Insert the callbacks of the loaded instrumentation plugins",
+                  false,
+                  false);
+
+using PluginsList = std::vector<std::unique_ptr<InstrumentationPlugin>>;
+static ManagedStatic<PluginsList> Plugins;
+
+void registerInstrumentationPlugin(std::unique_ptr<InstrumentationPlugin> P) {
+  Plugins->push_back(std::move(P));
+}
+
+void Instrument::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+}
+
+using CalleesList = std::vector<FunctionCallee>;
+
+static CalleesList
+declare(Module &M, const std::vector<std::string> &Names, FunctionType *Type) {
+  CalleesList Result;
+  for (const std::string &Name : Names)
+    Result.push_back(M.getOrInsertFunction(Name, Type));
+  return Result;
+}
+
+static uint64_t toInteger(MetaAddress PC) {
+  return PC.isValid() ? PC.address() : 0;
+}
+
+bool Instrument::runOnModule(Module &M) {
+  InstrumentationCallbacks Callbacks;
+  for (std::unique_ptr<InstrumentationPlugin> &Plugin : *Plugins)
+    Plugin->registerCallbacks(Callbacks);
+
+  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+
+  // Modules lifted by older versions, or from binaries that never perform a
+  // syscall, have no syscall helper
+  Function *SyscallHelper = GCBI.syscallHelper();
+  GlobalVariable *SyscallNumber = GCBI.syscallNumberRegister();
+  if (SyscallHelper == nullptr or SyscallNumber == nullptr) {
+    if (not Callbacks.Syscall.empty())
+      dbg << "Warning: the module doesn't tell how syscalls are performed, "
+             "syscalls won't be instrumented\n";
+    Callbacks.Syscall.clear();
+  }
+
+  if (Callbacks.BlockEntry.empty() and Callbacks.NewPC.empty()
+      and Callbacks.HelperCall.empty() and Callbacks.Syscall.empty())
+    return false;
+
+  LLVMContext &Context = getContext(&M);
+  Type *Void = Type::getVoidTy(Context);
+  IntegerType *Int64 = Type::getInt64Ty(Context);
+
+  auto *PCType = FunctionType::get(Void, { Int64 }, false);
+  auto *PCAndIntType = FunctionType::get(Void, { Int64, Int64 }, false);
+
+  auto BlockEntry = declare(M, Callbacks.BlockEntry, PCType);
+  auto NewPC = declare(M, Callbacks.NewPC, PCAndIntType);
+  auto Syscall = declare(M, Callbacks.Syscall, PCAndIntType);
+
+  std::vector<std::pair<StringRef, FunctionCallee>> HelperCall;
+  for (auto &[Prefix, Name] : Callbacks.HelperCall)
+    HelperCall.emplace_back(Prefix, M.getOrInsertFunction(Name, PCType));
+
+  // Collect the instrumentation points first, the callbacks are calls too
+  std::vector<CallInst *> NewPCCalls;
+  std::vector<std::pair<CallInst *, FunctionCallee>> HelperCalls;
+  std::vector<CallInst *> SyscallCalls;
+  std::vector<BasicBlock *> JumpTargets;
+  for (BasicBlock &BB : *GCBI.root()) {
+    if (not BlockEntry.empty() and GCBI.isJumpTarget(&BB))
+      JumpTargets.push_back(&BB);
+
+    for (Instruction &I : BB) {
+      Function *Callee = getCallee(&I);
+      if (Callee == nullptr)
+        continue;
+
+      auto *Call = cast<CallInst>(&I);
+      if (Callee->getName() == "newpc") {
+        if (not NewPC.empty())
+          NewPCCalls.push_back(Call);
+        continue;
+      }
+
+      if (Callee == SyscallHelper and not Syscall.empty())
+        SyscallCalls.push_back(Call);
+
+      for (auto &[Prefix, Callback] : HelperCall)
+        if (Callee->getName().startswith(Prefix))
+          HelperCalls.emplace_back(Call, Callback);
+    }
+  }
+
+  IRBuilder<> Builder(Context);
+
+  // Instrument each jump target right after its newpc call
+  for (BasicBlock *BB : JumpTargets) {
+    auto It = BB->begin();
+    if (isCallTo(&*It, "newpc"))
+      ++It;
+    Builder.SetInsertPoint(BB, It);
+
+    Value *PC = Builder.getInt64(toInteger(getBasicBlockPC(BB)));
+    for (FunctionCallee &Callback : BlockEntry)
+      Builder.CreateCall(Callback, { PC });
+  }
+
+  // Instrument each instruction right after its newpc call, so that the
+  // callbacks precede the code of the instruction
+  for (CallInst *Call : NewPCCalls) {
+    Builder.SetInsertPoint(Call->getNextNode());
+    auto Address = MetaAddress::fromConstant(Call->getArgOperand(0));
+    Value *PC = Builder.getInt64(toInteger(Address));
+    Value *Size = Call->getArgOperand(1);
+    for (FunctionCallee &Callback : NewPC)
+      Builder.CreateCall(Callback, { PC, Size });
+  }
+
+  // Instrument helpers and syscalls right before the call
+  for (auto &[Call, Callback] : HelperCalls) {
+    Builder.SetInsertPoint(Call);
+    Value *PC = Builder.getInt64(toInteger(getPC(Call).first));
+    Builder.CreateCall(Callback, { PC });
+  }
+
+  for (CallInst *Call : SyscallCalls) {
+    Builder.SetInsertPoint(Call);
+    Value *PC = Builder.getInt64(toInteger(getPC(Call).first));
+    Value *Number = Builder.CreateZExtOrTrunc(Builder.CreateLoad(SyscallNumber),
+                                              Int64);
+    for (FunctionCallee &Callback : Syscall)
+      Builder.CreateCall(Callback, { PC, Number });
+  }
+
+  revng_log(InstrumentLog,
+            "Instrumented " << JumpTargets.size() << " jump targets, "
+                            << NewPCCalls.size() << " instructions, "
+                            << HelperCalls.size() << " helper calls and "
+                            << SyscallCalls.size() << " syscalls");
+
+  return true;
+}
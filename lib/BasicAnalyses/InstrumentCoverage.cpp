@@ -0,0 +1,84 @@
+/// \file InstrumentCoverage.cpp
+/// \brief Add to each jump target a counter of how many times it's executed.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/BasicAnalyses/InstrumentCoverage.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+char InstrumentCoverage::ID = 0;
+using Register = RegisterPass<InstrumentCoverage>;
+static Register X("instrument-coverage",
+                  "Count the executions of each jump target",
+                  false,
+                  false);
+
+void InstrumentCoverage::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+}
+
+bool InstrumentCoverage::runOnModule(Module &M) {
+  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  LLVMContext &Context = getContext(&M);
+  IntegerType *Int64 = Type::getInt64Ty(Context);
+
+  // Collect the jump targets. Their PCs are recorded in the PC representation,
+  // so that ARM and Thumb code at the same address are kept apart.
+  std::vector<BasicBlock *> JumpTargets;
+  std::vector<Constant *> PCs;
+  for (BasicBlock &BB : *GCBI.root()) {
+    if (GCBI.isJumpTarget(&BB)) {
+      JumpTargets.push_back(&BB);
+      MetaAddress PC = getBasicBlockPC(&BB);
+      PCs.push_back(ConstantInt::get(Int64, PC.asPC()));
+    }
+  }
+
+  auto *CountersType = ArrayType::get(Int64, JumpTargets.size());
+  auto *Counters = new GlobalVariable(M,
+                                      CountersType,
+                                      false,
+                                      GlobalValue::ExternalLinkage,
+                                      ConstantAggregateZero::get(CountersType),
+                                      "revng_coverage_counters");
+  new GlobalVariable(M,
+                     CountersType,
+                     true,
+                     GlobalValue::ExternalLinkage,
+                     ConstantArray::get(CountersType, PCs),
+                     "revng_coverage_pcs");
+  new GlobalVariable(M,
+                     Int64,
+                     true,
+                     GlobalValue::ExternalLinkage,
+                     ConstantInt::get(Int64, JumpTargets.size()),
+                     "revng_coverage_count");
+
+  // Increment the counter right after the newpc call opening each jump target
+  IRBuilder<> Builder(Context);
+  for (size_t I = 0; I < JumpTargets.size(); ++I) {
+    BasicBlock *BB = JumpTargets[I];
+    auto It = BB->begin();
+    if (isCallTo(&*It, "newpc"))
+      ++It;
+    Builder.SetInsertPoint(BB, It);
+
+    Value *Counter = Builder.CreateConstInBoundsGEP2_64(Counters, 0, I);
+    Value *Incremented = Builder.CreateAdd(Builder.CreateLoad(Counter),
+                                           Builder.getInt64(1));
+    Builder.CreateStore(Incremented, Counter);
+  }
+
+  return true;
+}
@@ -0,0 +1,25 @@
+/// \file ShrinkToDemandedBits.cpp
+/// \brief Compute each instruction on the bits actually demanded by its users.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Analysis/DemandedBits.h"
+
+#include "revng/BasicAnalyses/ShrinkInstructionOperandsPass.h"
+
+using namespace llvm;
+
+char ShrinkToDemandedBitsPass::ID = 0;
+using Register = RegisterPass<ShrinkToDemandedBitsPass>;
+static Register X("shrink-to-demanded-bits",
+                  "Compute each instruction on the demanded bits",
+                  false,
+                  false);
+
+bool ShrinkToDemandedBitsPass::runOnFunction(Function &F) {
+  auto &DB = getAnalysis<DemandedBitsWrapperPass>().getDemandedBits();
+  shrinkWholeFunction(F, DB);
+  return true;
+}
@@ -5,8 +5,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstring>
+
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_os_ostream.h"
 
 #include "revng/ADT/Queue.h"
 #include "revng/Dump/CollectCFG.h"
@@ -26,17 +30,167 @@ static opt<std::string> OutputPath("collect-cfg-output",
                                    value_desc("path"),
                                    cat(MainCategory));
 
+static auto Formats = values(clEnumValN(CFGFormat::CSV,
+                                        "csv",
+                                        "source,destination pairs of names"),
+                             clEnumValN(CFGFormat::Binary,
+                                        "binary",
+                                        "compact varint-encoded addresses"));
+static opt<CFGFormat::Values> Format("collect-cfg-format",
+                                     desc("format of the Collect CFG Pass "
+                                          "output"),
+                                     Formats,
+                                     cat(MainCategory),
+                                     init(CFGFormat::CSV));
+
+static const char BinaryMagic[] = "rcfg";
+static const uint64_t BinaryVersion = 1;
+
+static uint64_t tag(const MetaAddress &Address) {
+  return (static_cast<uint64_t>(Address.type())
+          | (static_cast<uint64_t>(Address.addressSpace()) << 16)
+          | (static_cast<uint64_t>(Address.epoch()) << 32));
+}
+
+static MetaAddress fromTag(uint64_t Address, uint64_t Tag) {
+  using Type = MetaAddressType::Values;
+  return MetaAddress(Address,
+                     static_cast<Type>(Tag & 0xFFFF),
+                     static_cast<uint32_t>(Tag >> 32),
+                     static_cast<uint16_t>((Tag >> 16) & 0xFFFF));
+}
+
+std::vector<BasicBlock *> CollectCFG::sources() {
+  std::vector<BasicBlock *> Result;
+  for (BasicBlock &BB : *Root)
+    if (isNewInstruction(&BB))
+      Result.push_back(&BB);
+  return Result;
+}
+
+void CollectCFG::collectDestinations(BasicBlock *Source,
+                                     SmallVectorImpl<BasicBlock *> &Result) {
+  Result.clear();
+
+  OnceQueue<BasicBlock *> Queue;
+  Queue.insert(Source);
+  while (!Queue.empty()) {
+    BasicBlock *ToExplore = Queue.pop();
+    for (BasicBlock *Successor : successors(ToExplore)) {
+
+      // If it's a new instruction register it, otherwise enqueue the basic
+      // block for further processing
+      if (isNewInstruction(Successor)) {
+        Result.push_back(Successor);
+      } else if (BlackList.count(Successor) == 0) {
+        Queue.insert(Successor);
+      }
+    }
+  }
+
+  std::sort(Result.begin(), Result.end(), CompareByName<BasicBlock>());
+}
+
 void CollectCFG::serialize(std::ostream &Output) {
+  std::vector<BasicBlock *> Sources = sources();
+  std::sort(Sources.begin(), Sources.end(), CompareByName<BasicBlock>());
+
   Output << "source,destination\n";
-  for (auto &P : Result) {
-    BasicBlock *Source = P.first;
-    std::sort(P.second.begin(), P.second.end(), CompareByName<BasicBlock>());
-    for (BasicBlock *Destination : P.second)
+  SmallVector<BasicBlock *, 2> Destinations;
+  for (BasicBlock *Source : Sources) {
+    collectDestinations(Source, Destinations);
+    for (BasicBlock *Destination : Destinations)
       Output << Source->getName().data() << "," << Destination->getName().data()
              << "\n";
   }
 }
 
+void CollectCFG::serializeBinary(raw_ostream &Output) {
+  // Sort by address first, so that the deltas between sources are positive
+  // and small
+  using Entry = std::pair<MetaAddress, BasicBlock *>;
+  std::vector<Entry> Sources;
+  for (BasicBlock *Source : sources())
+    Sources.emplace_back(getBasicBlockPC(Source), Source);
+  auto Compare = [](const Entry &LHS, const Entry &RHS) {
+    auto Key = [](const MetaAddress &MA) {
+      return std::make_pair(MA.address(), tag(MA));
+    };
+    return Key(LHS.first) < Key(RHS.first);
+  };
+  std::sort(Sources.begin(), Sources.end(), Compare);
+
+  Output << BinaryMagic;
+  encodeULEB128(BinaryVersion, Output);
+
+  uint64_t LastAddress = 0;
+  SmallVector<BasicBlock *, 2> Destinations;
+  for (auto &[Address, Source] : Sources) {
+    collectDestinations(Source, Destinations);
+    if (Destinations.empty())
+      continue;
+
+    uint64_t SourceAddress = Address.address();
+    encodeULEB128(SourceAddress - LastAddress, Output);
+    encodeULEB128(tag(Address), Output);
+    encodeULEB128(Destinations.size(), Output);
+    LastAddress = SourceAddress;
+
+    for (BasicBlock *Destination : Destinations) {
+      MetaAddress DestinationAddress = getBasicBlockPC(Destination);
+      int64_t Delta = DestinationAddress.address() - SourceAddress;
+      encodeSLEB128(Delta, Output);
+      encodeULEB128(tag(DestinationAddress), Output);
+    }
+  }
+}
+
+bool CollectCFG::readBinary(StringRef Buffer, EdgeCallback OnEdge) {
+  if (not Buffer.startswith(BinaryMagic))
+    return false;
+
+  auto *Current = Buffer.bytes_begin() + strlen(BinaryMagic);
+  auto *End = Buffer.bytes_end();
+  const char *Error = nullptr;
+
+  auto ReadULEB = [&]() -> uint64_t {
+    unsigned Size = 0;
+    uint64_t Result = decodeULEB128(Current, &Size, End, &Error);
+    Current += Size;
+    return Result;
+  };
+
+  auto ReadSLEB = [&]() -> int64_t {
+    unsigned Size = 0;
+    int64_t Result = decodeSLEB128(Current, &Size, End, &Error);
+    Current += Size;
+    return Result;
+  };
+
+  if (ReadULEB() != BinaryVersion or Error != nullptr)
+    return false;
+
+  uint64_t LastAddress = 0;
+  while (Current != End) {
+    uint64_t SourceAddress = LastAddress + ReadULEB();
+    MetaAddress Source = fromTag(SourceAddress, ReadULEB());
+    uint64_t Count = ReadULEB();
+    if (Error != nullptr)
+      return false;
+    LastAddress = SourceAddress;
+
+    for (uint64_t I = 0; I < Count; ++I) {
+      uint64_t DestinationAddress = SourceAddress + ReadSLEB();
+      MetaAddress Destination = fromTag(DestinationAddress, ReadULEB());
+      if (Error != nullptr)
+        return false;
+      OnEdge(Source, Destination);
+    }
+  }
+
+  return true;
+}
+
 bool CollectCFG::isNewInstruction(BasicBlock *BB) {
   if (BB->empty())
     return false;
@@ -50,41 +204,25 @@ bool CollectCFG::isNewInstruction(BasicBlock *BB) {
 }
 
 bool CollectCFG::runOnModule(Module &M) {
-  Function &F = *M.getFunction("root");
-  Result.clear();
+  Root = M.getFunction("root");
+  BlackList.clear();
 
-  for (BasicBlock &BB : F) {
+  for (BasicBlock &BB : *Root) {
     if (!isNewInstruction(&BB))
       BlackList.insert(&BB);
     else
       break;
   }
 
-  // For each basic block
-  for (BasicBlock &BB : F) {
-    if (!isNewInstruction(&BB))
-      continue;
-
-    OnceQueue<BasicBlock *> Queue;
-    Queue.insert(&BB);
-    while (!Queue.empty()) {
-      BasicBlock *ToExplore = Queue.pop();
-      for (BasicBlock *Successor : successors(ToExplore)) {
-
-        // If it's a new instruction register it, otherwise enqueue the basic
-        // block for further processing
-        if (isNewInstruction(Successor)) {
-          Result[&BB].push_back(Successor);
-        } else if (BlackList.count(Successor) == 0) {
-          Queue.insert(Successor);
-        }
-      }
-    }
-  }
-
   if (OutputPath.getNumOccurrences() == 1) {
     std::ofstream Output;
-    serialize(pathToStream(OutputPath, Output));
+    std::ostream &Stream = pathToStream(OutputPath, Output);
+    if (Format == CFGFormat::Binary) {
+      raw_os_ostream RawStream(Stream);
+      serializeBinary(RawStream);
+    } else {
+      serialize(Stream);
+    }
   }
 
   return false;
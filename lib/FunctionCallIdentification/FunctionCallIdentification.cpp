@@ -6,6 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+#include <vector>
+
 #include "revng/FunctionCallIdentification/FunctionCallIdentification.h"
 #include "revng/Support/Debug.h"
 
@@ -27,6 +30,8 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
   FallthroughAddresses.clear();
+  NewFallthroughAddresses.clear();
+  FoundMarkedCalls = false;
 
   // Create function call marker
   // TODO: we could factor this out
@@ -50,6 +55,169 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
     revng_assert(FunctionCall->user_begin() == FunctionCall->user_end());
   }
 
+  // To be a function call we need to find:
+  //
+  // * a call to "newpc"
+  // * a store of the next PC
+  // * a store to the PC
+  struct Visitor
+    : public BFSVisitorBase<false, Visitor, SmallVector<BasicBlock *, 4>> {
+  public:
+    using SuccessorsType = SmallVector<BasicBlock *, 4>;
+
+  public:
+    BasicBlock *BB;
+    const GeneratedCodeBasicInfo &GCBI;
+    bool SaveRAFound;
+    bool StorePCFound;
+    Constant *LinkRegister;
+    MetaAddress ReturnPC;
+    MetaAddress LastPC;
+
+    // We can meet calls up to newpc up to (1 + "size of the delay slot")
+    // times
+    uint64_t NewPCLeft;
+    PointerType *PCPtrTy;
+
+  public:
+    Visitor(const GeneratedCodeBasicInfo &GCBI, PointerType *PCPtrTy) :
+      BB(nullptr),
+      GCBI(GCBI),
+      SaveRAFound(false),
+      StorePCFound(false),
+      LinkRegister(nullptr),
+      NewPCLeft(1),
+      PCPtrTy(PCPtrTy) {}
+
+    /// \brief Prepare for the visit of the terminator of \p NewBB
+    ///
+    /// The same visitor is reused for all the basic blocks, so that the work
+    /// list of the BFS is allocated only once.
+    void reset(BasicBlock *NewBB, MetaAddress NewReturnPC) {
+      BB = NewBB;
+      SaveRAFound = false;
+      StorePCFound = false;
+      LinkRegister = nullptr;
+      ReturnPC = NewReturnPC;
+      LastPC = NewReturnPC;
+      NewPCLeft = 1;
+    }
+
+  public:
+    VisitAction visit(instruction_range Range) {
+      for (Instruction &I : Range) {
+        if (auto *Store = dyn_cast<StoreInst>(&I)) {
+          Value *V = Store->getValueOperand();
+          Value *Pointer = skipCasts(Store->getPointerOperand());
+          auto *TargetCSV = dyn_cast<GlobalVariable>(Pointer);
+
+          if (GCBI.isPCReg(TargetCSV)) {
+            if (TargetCSV != nullptr)
+              StorePCFound = true;
+          } else if (TargetCSV != nullptr
+                     and not GCBI.isABIRegister(TargetCSV)) {
+            // Ignore writes to non-ABI registers
+          } else if (auto *Constant = dyn_cast<ConstantInt>(V)) {
+            revng_assert(LastPC.isValid());
+
+            // Note that we willingly ignore stores to the PC here
+            uint64_t StoredValue = Constant->getLimitedValue();
+            auto StoredMA = MetaAddress::fromPC(LastPC, StoredValue);
+            if (StoredMA == ReturnPC) {
+              if (SaveRAFound) {
+                SaveRAFound = false;
+                return StopNow;
+              }
+              SaveRAFound = true;
+
+              // Find where the return address is being stored
+              revng_assert(LinkRegister == nullptr);
+              if (TargetCSV != nullptr) {
+                // The return address is being written to a register
+                LinkRegister = TargetCSV;
+              } else {
+                // The return address is likely being written on the stack, we
+                // have to check the last value on the stack and check if
+                // we're writing there. This should cover basically all the
+                // cases, and, if not, expanding this should be
+                // straightforward
+
+                // Reference example:
+                //
+                // %1 = load i64, i64* @rsp
+                // %2 = sub i64 %1, 8
+                // %3 = inttoptr i64 %2 to i64*
+                // store i64 4194694, i64* %3
+                // store i64 %2, i64* @rsp
+                // store i64 4194704, i64* @pc
+
+                // Find the last write to the stack pointer
+                Value *LastStackPointer = nullptr;
+                for (Instruction &I : make_range(BB->rbegin(), BB->rend())) {
+                  if (auto *S = dyn_cast<StoreInst>(&I)) {
+                    Value *Pointer = skipCasts(S->getPointerOperand());
+                    auto *P = dyn_cast<GlobalVariable>(Pointer);
+                    if (P != nullptr && GCBI.isSPReg(P)) {
+                      LastStackPointer = Store->getPointerOperand();
+                      break;
+                    }
+                  }
+                }
+                revng_assert(LastStackPointer != nullptr);
+                revng_assert(skipCasts(LastStackPointer) == Pointer);
+
+                // If LinkRegister is nullptr it means the return address is
+                // being pushed on the top of the stack
+                LinkRegister = ConstantPointerNull::get(PCPtrTy);
+              }
+            }
+          }
+        } else if (auto *Call = dyn_cast<CallInst>(&I)) {
+          auto *Callee = Call->getCalledFunction();
+          if (Callee != nullptr && Callee->getName() == "newpc") {
+            revng_assert(NewPCLeft > 0);
+
+            Value *PCOperand = Call->getOperand(0);
+            auto ProgramCounter = MetaAddress::fromConstant(PCOperand);
+            uint64_t InstructionSize = getLimitedValue(Call->getOperand(1));
+
+            // Check that, w.r.t. to the last newpc, we're looking at the
+            // immediately preceeding instruction, if not fail.
+            if (ProgramCounter + InstructionSize != LastPC)
+              return StopNow;
+
+            // Update the last seen PC
+            LastPC = ProgramCounter;
+
+            NewPCLeft--;
+            if (NewPCLeft == 0)
+              return StopNow;
+          }
+        }
+      }
+
+      return Continue;
+    }
+
+    SuccessorsType successors(BasicBlock *BB) {
+      SuccessorsType Successors;
+      for (BasicBlock *Successor : make_range(pred_begin(BB), pred_end(BB)))
+        if (not BB->empty() and GCBI.isTranslated(Successor))
+          Successors.push_back(Successor);
+      return Successors;
+    }
+  };
+
+  Visitor V(GCBI, PCPtrTy);
+
+  // Calls to function_call to inject, in order to avoid altering the IR while
+  // we scan it
+  struct FunctionCallSite {
+    Instruction *InsertionPoint;
+    std::array<Value *, 5> Arguments;
+  };
+  std::vector<FunctionCallSite> NewCalls;
+
   // Collect function calls
   for (BasicBlock &BB : F) {
 
@@ -64,6 +232,7 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
       if (CallInst *Call = getFunctionCall(Terminator)) {
         auto Address = MetaAddress::fromConstant(Call->getOperand(2));
         FallthroughAddresses.insert(Address);
+        FoundMarkedCalls = true;
         continue;
       }
     }
@@ -71,152 +240,8 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
     if (not GCBI.isJump(Terminator))
       continue;
 
-    // To be a function call we need to find:
-    //
-    // * a call to "newpc"
-    // * a store of the next PC
-    // * a store to the PC
-    struct Visitor
-      : public BFSVisitorBase<false, Visitor, SmallVector<BasicBlock *, 4>> {
-    public:
-      using SuccessorsType = SmallVector<BasicBlock *, 4>;
-
-    public:
-      BasicBlock *BB;
-      const GeneratedCodeBasicInfo &GCBI;
-      bool SaveRAFound;
-      bool StorePCFound;
-      Constant *LinkRegister;
-      const MetaAddress ReturnPC;
-      MetaAddress LastPC;
-
-      // We can meet calls up to newpc up to (1 + "size of the delay slot")
-      // times
-      uint64_t NewPCLeft;
-      PointerType *PCPtrTy;
-
-    public:
-      Visitor(BasicBlock *BB,
-              const GeneratedCodeBasicInfo &GCBI,
-              MetaAddress ReturnPC,
-              PointerType *PCPtrTy) :
-        BB(BB),
-        GCBI(GCBI),
-        SaveRAFound(false),
-        StorePCFound(false),
-        LinkRegister(nullptr),
-        ReturnPC(ReturnPC),
-        LastPC(ReturnPC),
-        NewPCLeft(1),
-        PCPtrTy(PCPtrTy) {}
-
-    public:
-      VisitAction visit(instruction_range Range) {
-        for (Instruction &I : Range) {
-          if (auto *Store = dyn_cast<StoreInst>(&I)) {
-            Value *V = Store->getValueOperand();
-            Value *Pointer = skipCasts(Store->getPointerOperand());
-            auto *TargetCSV = dyn_cast<GlobalVariable>(Pointer);
-
-            if (GCBI.isPCReg(TargetCSV)) {
-              if (TargetCSV != nullptr)
-                StorePCFound = true;
-            } else if (TargetCSV != nullptr
-                       and not GCBI.isABIRegister(TargetCSV)) {
-              // Ignore writes to non-ABI registers
-            } else if (auto *Constant = dyn_cast<ConstantInt>(V)) {
-              revng_assert(LastPC.isValid());
-
-              // Note that we willingly ignore stores to the PC here
-              uint64_t StoredValue = Constant->getLimitedValue();
-              auto StoredMA = MetaAddress::fromPC(LastPC, StoredValue);
-              if (StoredMA == ReturnPC) {
-                if (SaveRAFound) {
-                  SaveRAFound = false;
-                  return StopNow;
-                }
-                SaveRAFound = true;
-
-                // Find where the return address is being stored
-                revng_assert(LinkRegister == nullptr);
-                if (TargetCSV != nullptr) {
-                  // The return address is being written to a register
-                  LinkRegister = TargetCSV;
-                } else {
-                  // The return address is likely being written on the stack, we
-                  // have to check the last value on the stack and check if
-                  // we're writing there. This should cover basically all the
-                  // cases, and, if not, expanding this should be
-                  // straightforward
-
-                  // Reference example:
-                  //
-                  // %1 = load i64, i64* @rsp
-                  // %2 = sub i64 %1, 8
-                  // %3 = inttoptr i64 %2 to i64*
-                  // store i64 4194694, i64* %3
-                  // store i64 %2, i64* @rsp
-                  // store i64 4194704, i64* @pc
-
-                  // Find the last write to the stack pointer
-                  Value *LastStackPointer = nullptr;
-                  for (Instruction &I : make_range(BB->rbegin(), BB->rend())) {
-                    if (auto *S = dyn_cast<StoreInst>(&I)) {
-                      Value *Pointer = skipCasts(S->getPointerOperand());
-                      auto *P = dyn_cast<GlobalVariable>(Pointer);
-                      if (P != nullptr && GCBI.isSPReg(P)) {
-                        LastStackPointer = Store->getPointerOperand();
-                        break;
-                      }
-                    }
-                  }
-                  revng_assert(LastStackPointer != nullptr);
-                  revng_assert(skipCasts(LastStackPointer) == Pointer);
-
-                  // If LinkRegister is nullptr it means the return address is
-                  // being pushed on the top of the stack
-                  LinkRegister = ConstantPointerNull::get(PCPtrTy);
-                }
-              }
-            }
-          } else if (auto *Call = dyn_cast<CallInst>(&I)) {
-            auto *Callee = Call->getCalledFunction();
-            if (Callee != nullptr && Callee->getName() == "newpc") {
-              revng_assert(NewPCLeft > 0);
-
-              Value *PCOperand = Call->getOperand(0);
-              auto ProgramCounter = MetaAddress::fromConstant(PCOperand);
-              uint64_t InstructionSize = getLimitedValue(Call->getOperand(1));
-
-              // Check that, w.r.t. to the last newpc, we're looking at the
-              // immediately preceeding instruction, if not fail.
-              if (ProgramCounter + InstructionSize != LastPC)
-                return StopNow;
-
-              // Update the last seen PC
-              LastPC = ProgramCounter;
-
-              NewPCLeft--;
-              if (NewPCLeft == 0)
-                return StopNow;
-            }
-          }
-        }
-
-        return Continue;
-      }
-
-      SuccessorsType successors(BasicBlock *BB) {
-        SuccessorsType Successors;
-        for (BasicBlock *Successor : make_range(pred_begin(BB), pred_end(BB)))
-          if (not BB->empty() and GCBI.isTranslated(Successor))
-            Successors.push_back(Successor);
-        return Successors;
-      }
-    };
-
     MetaAddress ReturnPC = GCBI.getNextPC(Terminator);
-    Visitor V(&BB, GCBI, ReturnPC, PCPtrTy);
+    V.reset(&BB, ReturnPC);
     V.run(Terminator);
 
     BasicBlock *ReturnBB = GCBI.getBlockAt(ReturnPC);
@@ -261,13 +286,14 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
         Callee = Int8NullPtr;
       }
 
-      const std::initializer_list<Value *> Args{ Callee,
-                                                 BlockAddress::get(ReturnBB),
-                                                 GCBI.toConstant(ReturnPC),
-                                                 V.LinkRegister,
-                                                 Int8NullPtr };
+      std::array<Value *, 5> Args{ Callee,
+                                   BlockAddress::get(ReturnBB),
+                                   GCBI.toConstant(ReturnPC),
+                                   V.LinkRegister,
+                                   Int8NullPtr };
 
       FallthroughAddresses.insert(ReturnPC);
+      NewFallthroughAddresses.push_back(ReturnPC);
 
       // If the instruction before the terminator is a call to exitTB, inject
       // the call to function_call before it, so it doesn't get purged
@@ -279,10 +305,14 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
           It = PrevIt;
       }
 
-      CallInst::Create(FunctionCall, Args, "", &*It);
+      NewCalls.push_back({ &*It, Args });
     }
   }
 
+  // Emit all the calls to function_call at once
+  for (FunctionCallSite &Site : NewCalls)
+    CallInst::Create(FunctionCall, Site.Arguments, "", Site.InsertionPoint);
+
   buildFilteredCFG(F);
 
   revng_log(PassesLog, "Ending FunctionCallIdentification");
@@ -293,6 +323,10 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
 void FunctionCallIdentification::buildFilteredCFG(llvm::Function &F) {
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
+  // Reuse the storage of the previous run
+  FilteredCFG.clear();
+  FilteredCFG.reserve(F.size());
+
   // We have to create a view on the CFG where:
   //
   // * We only have translate basic blocks
@@ -302,14 +336,14 @@ void FunctionCallIdentification::buildFilteredCFG(llvm::Function &F) {
     if (BB.empty() or not GCBI.isTranslated(&BB))
       continue;
 
-    CustomCFGNode *Node = FilteredCFG.getNode(&BB);
+    FilteredCFG.getNode(&BB);
 
     // Is this a function call?
     if (CallInst *Call = getFunctionCall(&BB)) {
 
       Value *SecondArgument = Call->getArgOperand(1);
       auto *Fallthrough = cast<BlockAddress>(SecondArgument)->getBasicBlock();
-      Node->addSuccessor(FilteredCFG.getNode(Fallthrough));
+      FilteredCFG.addEdge(&BB, Fallthrough);
 
     } else {
 
@@ -334,13 +368,13 @@ void FunctionCallIdentification::buildFilteredCFG(llvm::Function &F) {
           if (Successor->empty() or not GCBI.isTranslated(Successor))
             continue;
 
-          Node->addSuccessor(FilteredCFG.getNode(Successor));
+          FilteredCFG.addEdge(&BB, Successor);
         }
       }
     }
   }
 
-  FilteredCFG.buildBackLinks();
+  FilteredCFG.buildLinks();
 
   if (FilteredCFGLog.isEnabled())
     FilteredCFG.dump(FilteredCFGLog);
@@ -5,6 +5,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <vector>
+
+#include "llvm/IR/CFG.h"
+
 // Local libraries includes
 #include "revng/FunctionCallIdentification/PruneRetSuccessors.h"
 #include "revng/Support/Debug.h"
@@ -15,11 +20,52 @@ char PruneRetSuccessors::ID = 0;
 using Register = RegisterPass<PruneRetSuccessors>;
 static Register X("prs", "Prune Ret Successors", true, true);
 
+/// \brief Collect the basic blocks whose successors, as computed by
+///        GeneratedCodeBasicInfo::getSuccessors, might include \p Addresses
+///
+/// These are the predecessors of the basic blocks at \p Addresses and,
+/// recursively, the predecessors of those that are not at an instruction
+/// boundary, since getSuccessors looks through them.
+template<typename T>
+static std::vector<BasicBlock *>
+reachingBlocks(const GeneratedCodeBasicInfo &GCBI, const T &Addresses) {
+  std::vector<BasicBlock *> Result;
+  std::set<BasicBlock *> Visited;
+  SmallVector<BasicBlock *, 16> WorkList;
+
+  for (const MetaAddress &Address : Addresses)
+    if (BasicBlock *BB = GCBI.getBlockAt(Address))
+      WorkList.append(pred_begin(BB), pred_end(BB));
+
+  while (not WorkList.empty()) {
+    BasicBlock *BB = WorkList.pop_back_val();
+    if (not Visited.insert(BB).second)
+      continue;
+
+    Result.push_back(BB);
+    if (GCBI.isTranslated(BB) and getBasicBlockPC(BB).isInvalid())
+      WorkList.append(pred_begin(BB), pred_end(BB));
+  }
+
+  return Result;
+}
+
 bool PruneRetSuccessors::runOnModule(llvm::Module &M) {
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
   auto &FCI = getAnalysis<FunctionCallIdentification>();
 
-  for (BasicBlock &BB : *GCBI.root()) {
+  // Only the jumps towards return addresses are pruned. If the last run of
+  // FCI marked all the calls, the jumps towards the return addresses of
+  // calls marked in previous runs have already been handled, consider only
+  // the new ones. Otherwise, we can't tell.
+  std::vector<BasicBlock *> Candidates;
+  if (FCI.foundMarkedCalls())
+    Candidates = reachingBlocks(GCBI, FCI.fallthroughAddresses());
+  else
+    Candidates = reachingBlocks(GCBI, FCI.newFallthroughAddresses());
+
+  for (BasicBlock *Candidate : Candidates) {
+    BasicBlock &BB = *Candidate;
     if (BB.getTerminator()->getNumSuccessors() < 2)
       continue;
 
@@ -20,6 +20,7 @@
 #include "revng/StackAnalysis/FunctionsSummary.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/OpaqueFunctionsPool.h"
+#include "revng/Support/Statistics.h"
 
 using namespace llvm;
 
@@ -47,6 +48,17 @@ static cl::opt<bool> DisableSafetyChecks("disable-enforce-abi-safety-checks",
                                          cl::cat(MainCategory),
                                          cl::init(false));
 
+static cl::opt<bool> ElideSafetyChecks("elide-enforce-abi-safety-checks",
+                                       cl::desc("Omit the unexpectedpc "
+                                                "fallback of indirect calls "
+                                                "where the ABI analysis is "
+                                                "certain about the call site"),
+                                       cl::cat(MainCategory),
+                                       cl::init(false));
+
+/// \brief Number of indirect calls with and without the unexpectedpc fallback
+static CounterMap<std::string> SafetyChecks("EnforceABISafetyChecks");
+
 static bool shouldEmit(FunctionRegisterArgument V) {
   switch (V.value()) {
   case FunctionRegisterArgument::Yes:
@@ -86,6 +98,62 @@ static bool shouldEmit(FunctionCallReturnValue V) {
   }
 }
 
+/// \brief Check if the ABI analysis is certain about \p Slot
+///
+/// A certain argument is either Yes, Dead or No, a certain return value is
+/// either Yes, Dead or No. The Maybe and the "or" cases, as well as
+/// contradictions, depend on the actual callee.
+static bool isCertain(const FunctionCallRegisterDescription &Slot) {
+  switch (Slot.Argument.value()) {
+  case FunctionCallRegisterArgument::No:
+  case FunctionCallRegisterArgument::Dead:
+  case FunctionCallRegisterArgument::Yes:
+    break;
+  default:
+    return false;
+  }
+
+  switch (Slot.ReturnValue.value()) {
+  case FunctionCallReturnValue::No:
+  case FunctionCallReturnValue::Dead:
+  case FunctionCallReturnValue::Yes:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// \brief Check if the safety checks of an indirect call can be elided
+///
+/// An indirect call is a switch on the PC dispatching to each function
+/// compatible with \p CallSite, falling back to unexpectedpc. If the ABI
+/// analysis is certain about all the registers passed and returned by
+/// \p CallSite, the dispatch trusts it: it covers every function, without
+/// filtering them by compatibility, and has no fallback.
+static bool isCheckRedundant(const CallSiteDescription &CallSite) {
+  for (auto &P : CallSite.RegisterSlots)
+    if (not isCertain(P.second))
+      return false;
+  return true;
+}
+
+/// \brief Check if \p CSV is saved and restored by \p Function
+///
+/// A register that is neither an argument nor a return value and that
+/// survives the function is only ever in the function to be saved on the
+/// stack and restored before returning.
+static bool isCalleeSaved(const FunctionDescription &Function,
+                          GlobalVariable *CSV) {
+  auto It = Function.RegisterSlots.find(CSV);
+  if (It == Function.RegisterSlots.end())
+    return false;
+
+  const FunctionRegisterDescription &Slot = It->second;
+  return (Slot.Argument.value() == FunctionRegisterArgument::No
+          and Slot.ReturnValue.value() == FunctionReturnValue::No
+          and Function.ClobberedRegisters.count(CSV) == 0);
+}
+
 class HelperCallSite {
 public:
   using CSVToIndexMap = std::map<GlobalVariable *, unsigned>;
@@ -148,7 +216,8 @@ private:
   void handleHelperFunctionCall(CallInst *Call);
   void generateCall(IRBuilder<> &Builder,
                     Function *Callee,
-                    FunctionsSummary::CallSiteDescription &CallSite);
+                    FunctionsSummary::CallSiteDescription &CallSite,
+                    bool CheckCompatibility = true);
   void replaceCSVsWithAlloca();
   void handleRoot();
 
@@ -166,6 +235,7 @@ private:
 };
 
 bool EnforceABI::runOnModule(Module &M) {
+  ScopedTimer Timer("EnforceABI");
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
   EnforceABIImpl Impl(M, GCBI);
@@ -173,6 +243,31 @@ bool EnforceABI::runOnModule(Module &M) {
   return false;
 }
 
+/// \brief Check if the value of \p CSV after \p I is certainly not used
+///
+/// This is a conservative, block-local check: \p CSV is dead if it's
+/// overwritten before any other use of it, call or terminator is met. Only
+/// stores of the whole CSV count: a store through a cast pointer might write
+/// only part of it, leaving the rest live.
+static bool isCSVDeadAfter(Instruction *I, GlobalVariable *CSV) {
+  auto Range = make_range(++I->getIterator(), I->getParent()->end());
+  for (Instruction &Next : Range) {
+    if (auto *Store = dyn_cast<StoreInst>(&Next))
+      if (Store->getPointerOperand() == CSV
+          and Store->getValueOperand()->getType() == CSV->getValueType())
+        return true;
+
+    if (isa<CallInst>(&Next) or Next.isTerminator())
+      return false;
+
+    for (Value *Operand : Next.operands())
+      if (skipCasts(Operand) == CSV)
+        return false;
+  }
+
+  return false;
+}
+
 // TODO: assign alias information
 static Function *
 createHelperWrapper(Function *Helper,
@@ -385,6 +480,12 @@ void EnforceABIImpl::run() {
     FunctionDispatcher->deleteBody();
     ReturnInst::Create(Context,
                        BasicBlock::Create(Context, "", FunctionDispatcher));
+
+    // The lookup table of the dispatcher refers to the old functions
+    for (const char *Name :
+         { "function_dispatcher_pcs", "function_dispatcher_targets" })
+      if (GlobalVariable *Table = M.getGlobalVariable(Name, true))
+        Table->eraseFromParent();
   }
 
   // Drop all the old functions
@@ -475,6 +576,12 @@ EnforceABIImpl::handleFunction(Function &F) {
   SmallVector<Type *, 8> ReturnTypes;
   SmallVector<GlobalVariable *, 8> ReturnCSVs;
 
+  auto *ClobberedTuple = QMD.extract<MDTuple *>(Tuple, 3);
+  for (const MDOperand &Operand : ClobberedTuple->operands()) {
+    auto *CSV = QMD.extract<Constant *>(Operand.get());
+    Description.ClobberedRegisters.insert(cast<GlobalVariable>(CSV));
+  }
+
   auto OperandsRange = QMD.extract<MDTuple *>(Tuple, 4)->operands();
   for (const MDOperand &Operand : OperandsRange) {
     auto *SlotTuple = cast<MDTuple>(Operand.get());
@@ -578,9 +685,16 @@ void EnforceABIImpl::handleHelperFunctionCall(CallInst *Call) {
   using namespace StackAnalysis;
   Function *Helper = cast<Function>(skipCasts(Call->getCalledValue()));
 
-  auto UsedCSVs = GeneratedCodeBasicInfo::getCSVUsedByHelperCall(Call);
+  auto UsedCSVs = GCBI.getCSVUsage(Call).Used;
   UsedCSVs.sort();
 
+  // Do not bring back the CSVs written by the helper that are overwritten
+  // before being used: this specializes the wrapper on the registers that are
+  // actually live at this call site, sparing a load in the wrapper and a store
+  // after the call
+  erase_if(UsedCSVs.Written,
+           [Call](GlobalVariable *CSV) { return isCSVDeadAfter(Call, CSV); });
+
   auto *PointeeTy = Helper->getType()->getPointerElementType();
   auto *HelperType = cast<llvm::FunctionType>(PointeeTy);
 
@@ -683,6 +797,15 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
     };
   }
 
+  bool Elide = false;
+  if (not IsDirect and not DisableSafetyChecks and ElideSafetyChecks) {
+    Elide = isCheckRedundant(CallSite);
+    SafetyChecks.push(Elide ? "Elided" : "Emitted");
+    revng_log(EnforceABILog,
+              "Safety checks of " << getName(Call)
+                                  << (Elide ? " elided" : " emitted"));
+  }
+
   if (DisableSafetyChecks or IsDirect) {
     // The callee is a well-known callee, generate a direct call
     IRBuilder<> Builder(Call);
@@ -701,7 +824,8 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
 
   } else {
     // If it's an indirect call, enumerate all the compatible callees and
-    // generate a call for each of them
+    // generate a call for each of them. If the checks are elided, enumerate
+    // all the functions and never reach unexpectedpc.
 
     EnforceABILog << getName(Call) << " is an indirect call compatible with:\n";
 
@@ -712,10 +836,19 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
     IRBuilder<> Builder(BeforeSplit);
     Value *PCCSV = GCBI.pcReg();
     Value *PC = Builder.CreateLoad(PCCSV);
-    BasicBlock *UnexpectedPC = findByBlockType(AfterSplit->getParent(),
-                                               BlockType::UnexpectedPCBlock);
-    revng_assert(UnexpectedPC != nullptr);
-    SwitchInst *Switch = Builder.CreateSwitch(PC, UnexpectedPC);
+    BasicBlock *Default = nullptr;
+    if (Elide) {
+      Default = BasicBlock::Create(Context,
+                                   "",
+                                   BeforeSplit->getParent(),
+                                   AfterSplit);
+      new UnreachableInst(Context, Default);
+    } else {
+      Default = findByBlockType(AfterSplit->getParent(),
+                                BlockType::UnexpectedPCBlock);
+      revng_assert(Default != nullptr);
+    }
+    SwitchInst *Switch = Builder.CreateSwitch(PC, Default);
 
     unsigned I = 0;
     unsigned Count = 0;
@@ -724,10 +857,11 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
       FunctionDescription &Description = P.second;
 
       EnforceABILog << "  " << F->getName().data() << " ";
-      if (GlobalVariable *CSV = CallSite.isCompatibleWith(Description)) {
+      GlobalVariable *CSV = CallSite.isCompatibleWith(Description);
+      if (CSV != nullptr and not Elide) {
         EnforceABILog << "[No: " << CSV->getName().data() << "]";
       } else {
-        EnforceABILog << "[Yes]";
+        EnforceABILog << (CSV == nullptr ? "[Yes]" : "[Trusted]");
         Count++;
 
         auto *Tuple = cast<MDTuple>(F->getMetadata("revng.func.entry"));
@@ -742,7 +876,7 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
         Switch->addCase(ConstantInt::get(Ty, PC.asPC()), Case);
 
         Builder.SetInsertPoint(Case);
-        generateCall(Builder, F, CallSite);
+        generateCall(Builder, F, CallSite, not Elide);
         Builder.CreateBr(AfterSplit);
       }
       EnforceABILog << DoLog;
@@ -758,7 +892,8 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
 
 void EnforceABIImpl::generateCall(IRBuilder<> &Builder,
                                   Function *Callee,
-                                  CallSiteDescription &CallSite) {
+                                  CallSiteDescription &CallSite,
+                                  bool CheckCompatibility) {
   revng_assert(Callee != nullptr);
 
   llvm::SmallVector<Type *, 8> ArgumentsTypes;
@@ -811,7 +946,10 @@ void EnforceABIImpl::generateCall(IRBuilder<> &Builder,
     FunctionDescription &Function = FunctionsMap.at(Callee);
     revng_assert(Function.Function != nullptr
                  and Function.Function->getName().startswith("bb."));
-    if (GlobalVariable *CSV = CallSite.isCompatibleWith(Function)) {
+    GlobalVariable *CSV = nullptr;
+    if (CheckCompatibility)
+      CSV = CallSite.isCompatibleWith(Function);
+    if (CSV != nullptr) {
       dbg << (CallSite.Call == nullptr ? "nullptr" :
                                          getName(CallSite.Call).data())
           << " -> "
@@ -853,18 +991,29 @@ void EnforceABIImpl::replaceCSVsWithAlloca() {
   CSVInitializers.addFnAttribute(Attribute::ReadOnly);
   CSVInitializers.addFnAttribute(Attribute::NoUnwind);
 
-  // Each CSV has a map. The key of the map is a Funciton, and the mapped value
-  // is an AllocaInst used to locally represent that CSV.
-  using MapsVector = std::vector<ValueMap<Function *, Value *>>;
-  MapsVector CSVMaps(GCBI.csvs().size(), {});
-
-  // Map CSV GlobalVariable * to a position in CSVMaps
-  ValueMap<llvm::GlobalVariable *, MapsVector::size_type> CSVPosition;
+  // Map each CSV GlobalVariable * to a dense index
+  DenseMap<GlobalVariable *, unsigned> CSVPosition;
   for (auto &Group : llvm::enumerate(GCBI.csvs()))
     CSVPosition[Group.value()] = Group.index();
 
+  // The alloca representing each CSV in the current function, indexed by CSV
+  // position
+  std::vector<AllocaInst *> LocalCSVs(CSVPosition.size(), nullptr);
+  auto GetLocalCSV = [&CSVPosition, &LocalCSVs](Value *V) -> AllocaInst * {
+    auto *CSV = dyn_cast<GlobalVariable>(V);
+    if (CSV == nullptr)
+      return nullptr;
+
+    auto It = CSVPosition.find(CSV);
+    if (It == CSVPosition.end())
+      return nullptr;
+
+    return LocalCSVs[It->second];
+  };
+
   for (auto &P : FunctionsMap) {
     Function &F = *P.first;
+    std::fill(LocalCSVs.begin(), LocalCSVs.end(), nullptr);
 
     // Identifies the GlobalVariables representing CSVs used in F.
     std::set<GlobalVariable *> CSVs;
@@ -904,34 +1053,57 @@ void EnforceABIImpl::replaceCSVsWithAlloca() {
                                                 nullptr,
                                                 CSV->getName());
 
-      // Initialize all allocas with opaque, CSV-specific values
-      auto *Initializer = CSVInitializers.get(CSV->getName(),
-                                              CSVType,
-                                              {},
-                                              Twine("init_") + CSV->getName());
-      {
-        auto &B = InitializersBuilder;
-        B.CreateStore(B.CreateCall(Initializer), Alloca);
+      // Initialize all allocas with opaque, CSV-specific values, except for
+      // the callee-saved registers: their incoming value is only spilled to
+      // the stack and restored into a register no one reads after the
+      // return. Starting from undef lets the optimizer drop both, while the
+      // caller keeps its own value in SSA across the call.
+      Value *InitialValue = nullptr;
+      if (isCalleeSaved(P.second, CSV)) {
+        InitialValue = UndefValue::get(CSVType);
+      } else {
+        auto *Initializer = CSVInitializers.get(CSV->getName(),
+                                                CSVType,
+                                                {},
+                                                Twine("init_")
+                                                  + CSV->getName());
+        InitialValue = InitializersBuilder.CreateCall(Initializer);
       }
+      InitializersBuilder.CreateStore(InitialValue, Alloca);
 
       // Ignore it if it's not a CSV
       auto CSVPosIt = CSVPosition.find(CSV);
       if (CSVPosIt == CSVPosition.end())
         continue;
 
-      auto CSVPos = CSVPosIt->second;
-      CSVMaps[CSVPos][&F] = Alloca;
+      LocalCSVs[CSVPosIt->second] = Alloca;
     }
 
     Separator->eraseFromParent();
-  }
-  // Substitute the uses of the GlobalVariables representing the CSVs with the
-  // dedicate AllocaInst that were created in each Function.
-  for (GlobalVariable *CSV : GCBI.csvs()) {
-    auto CSVPosIt = CSVPosition.find(CSV);
-    auto CSVPos = CSVPosIt->second;
-    const auto &FunctionAllocas = CSVMaps.at(CSVPos);
-    if (not FunctionAllocas.empty())
-      replaceAllUsesInFunctionsWith(CSV, FunctionAllocas);
+
+    // Substitute the uses of the GlobalVariables representing the CSVs with
+    // the dedicated AllocaInst in a single pass over F. Walking the use lists
+    // of each CSV instead would visit the uses in all the other functions too,
+    // for every function.
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        for (Use &U : I.operands()) {
+          if (AllocaInst *Alloca = GetLocalCSV(U.get())) {
+            U.set(Alloca);
+          } else if (auto *CE = dyn_cast<ConstantExpr>(U.get())) {
+            if (not CE->isCast())
+              continue;
+
+            Value *CSV = CE->getOperand(0);
+            if (AllocaInst *Alloca = GetLocalCSV(CSV)) {
+              auto *Cast = CE->getAsInstruction();
+              Cast->replaceUsesOfWith(CSV, Alloca);
+              Cast->insertBefore(&I);
+              U.set(Cast);
+            }
+          }
+        }
+      }
+    }
   }
 }
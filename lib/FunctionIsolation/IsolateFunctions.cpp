@@ -6,19 +6,24 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Local.h"
 
+#include "revng/ADT/Queue.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/FunctionIsolation/IsolateFunctions.h"
 #include "revng/Runtime/commonconstants.h"
 #include "revng/StackAnalysis/FunctionsSummary.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/Statistics.h"
 
 using namespace llvm;
 
@@ -35,26 +40,72 @@ using IFI = IsolateFunctionsImpl;
 char IF::ID = 0;
 static RegisterPass<IF> X("isolate", "Isolate Functions Pass", true, true);
 
+static cl::list<std::string> IsolateOnly("isolate-only",
+                                         cl::desc("isolate only the functions "
+                                                  "starting at the specified "
+                                                  "addresses (MetaAddress "
+                                                  "syntax)"),
+                                         cl::value_desc("address"),
+                                         cl::CommaSeparated,
+                                         cl::cat(MainCategory));
+
+static cl::opt<bool> IsolateCallees("isolate-callees",
+                                    cl::desc("with -isolate-only, also "
+                                             "isolate all the functions "
+                                             "transitively called"),
+                                    cl::cat(MainCategory),
+                                    cl::init(false));
+
+static cl::opt<bool> LongjmpUnwind("isolate-longjmp-unwind",
+                                   cl::desc("get back to the root dispatcher "
+                                            "from isolated functions through "
+                                            "longjmp instead of C++ "
+                                            "exceptions, so that the root "
+                                            "function has no invoke and no "
+                                            "landing pad"),
+                                   cl::cat(MainCategory),
+                                   cl::init(false));
+
 class IsolateFunctionsImpl {
 private:
+  /// \brief Per-function isolation state
+  ///
+  /// Only `PC` and `IsolatedFunction` are needed once the function has been
+  /// populated, all the other members are cloning bookkeeping and are released
+  /// through `releaseCloningState` as soon as the function is done, so that
+  /// peak memory is proportional to the largest function.
   struct IsolatedFunctionDescriptor {
     MetaAddress PC;
     Function *IsolatedFunction;
     ValueToValueMap ValueMap;
-    std::map<BasicBlock *, BasicBlock *> Trampolines;
+    DenseMap<BasicBlock *, BasicBlock *> IsolatedToRootBB;
+    DenseMap<BasicBlock *, BasicBlock *> Trampolines;
     using BranchTypesMap = std::map<BasicBlock *,
                                     StackAnalysis::BranchType::Values>;
     BranchTypesMap Members;
-    std::map<BasicBlock *, BasicBlock *> FakeReturnPaths;
+    DenseMap<BasicBlock *, BasicBlock *> FakeReturnPaths;
+
+    void releaseCloningState() {
+      freeContainer(ValueMap);
+      freeContainer(IsolatedToRootBB);
+      freeContainer(Trampolines);
+      freeContainer(Members);
+      freeContainer(FakeReturnPaths);
+    }
   };
 
 public:
-  IsolateFunctionsImpl(Function *RootFunction, GeneratedCodeBasicInfo &GCBI) :
+  IsolateFunctionsImpl(Function *RootFunction,
+                       GeneratedCodeBasicInfo &GCBI,
+                       const std::set<MetaAddress> &RequestedEntries,
+                       bool WithCallees) :
     RootFunction(RootFunction),
     TheModule(RootFunction->getParent()),
     GCBI(GCBI),
     Context(getContext(TheModule)),
-    PCBitSize(8 * GCBI.pcRegSize()) {}
+    PCBitSize(8 * GCBI.pcRegSize()),
+    RequestedEntries(RequestedEntries),
+    WithCallees(WithCallees) {}
 
   void run();
 
@@ -77,6 +128,10 @@ private:
   ///        instruction
   BasicBlock *createCatchBlock(Function *Root, BasicBlock *UnexpectedPC);
 
+  /// \brief Make the entry of \p Root call setjmp on `unwind_buffer` and go
+  ///        to \p UnexpectedPC when an isolated function longjmps back
+  void createUnwindSetjmp(Function *Root, BasicBlock *UnexpectedPC);
+
   // TODO: Make a class CloneHelper holding RootToIsolated as a member
   /// \brief Replace the calls marked by `func.call` with the actual call
   void replaceFunctionCall(StackAnalysis::BranchType::Values BranchType,
@@ -96,6 +151,16 @@ private:
                         Instruction *OldInstruction,
                         IsolatedFunctionDescriptor &Descriptor);
 
+  /// \brief Compute the set of functions to isolate out of RequestedEntries
+  ///
+  /// If no entry has been requested, all the functions are isolated.
+  void selectFunctions();
+
+  /// \brief Check if the function named \p FunctionNameMD has to be isolated
+  bool isSelected(MDString *FunctionNameMD) const {
+    return RequestedEntries.empty() or Selected.count(FunctionNameMD) != 0;
+  }
+
   /// \brief Extract the string representing a function name starting from the
   ///        MDNode
   /// \return StringRef representing the function name
@@ -109,9 +174,11 @@ private:
   Function *RaiseException;
   Function *FunctionDispatcher;
   std::map<MDString *, IsolatedFunctionDescriptor> Functions;
-  std::map<BasicBlock *, BasicBlock *> IsolatedToRootBB;
   GlobalVariable *PC;
   const unsigned PCBitSize;
+  const std::set<MetaAddress> &RequestedEntries;
+  const bool WithCallees;
+  std::set<MDString *> Selected;
 };
 
 void IFI::throwException(Reason Code,
@@ -188,32 +255,114 @@ void IFI::populateFunctionDispatcher() {
                  MetaAddress::invalid());
   setBlockType(UnexpectedPC->getTerminator(), BlockType::UnexpectedPCBlock);
 
-  // Create a builder object for the DispatcherBB basic block
-  IRBuilder<> Builder(Context);
-  Builder.SetInsertPoint(DispatcherBB);
-
-  LoadInst *ProgramCounter = Builder.CreateLoad(PC, "");
-
-  SwitchInst *Switch = Builder.CreateSwitch(ProgramCounter, UnexpectedPC);
-
+  // Instead of a switch, which is expensive to compile and to run when there
+  // are many functions, emit a table of entry addresses, sorted, along with
+  // the corresponding functions and look it up with a binary search
+  std::vector<std::pair<uint64_t, Function *>> Entries;
+  Entries.reserve(Functions.size());
   for (auto &Pair : Functions) {
     IsolatedFunctionDescriptor &Descriptor = Pair.second;
-    Function *Function = Descriptor.IsolatedFunction;
-    StringRef Name = Function->getName();
+    Entries.emplace_back(Descriptor.PC.asPC(), Descriptor.IsolatedFunction);
+  }
+  llvm::sort(Entries);
+
+  IRBuilder<> Builder(Context);
+  auto *PCType = IntegerType::get(Context, PCBitSize);
+  auto *FunctionTy = FunctionType::get(Type::getVoidTy(Context), false);
+  PointerType *FunctionPointerType = FunctionTy->getPointerTo();
+  std::vector<Constant *> Addresses;
+  std::vector<Constant *> Targets;
+  for (auto &[Address, IsolatedFunction] : Entries) {
+    revng_assert(Addresses.empty() or Entries[Addresses.size() - 1].first
+                                        != Address);
+    Addresses.push_back(ConstantInt::get(PCType, Address));
+    Targets.push_back(ConstantExpr::getPointerCast(IsolatedFunction,
+                                                   FunctionPointerType));
+  }
 
-    // Creation of a basic block correspondent to the trampoline for each
-    // function
-    BasicBlock *TrampolineBB = BasicBlock::Create(Context,
-                                                  Name + "_trampoline",
-                                                  FunctionDispatcher,
-                                                  nullptr);
+  auto CreateTable = [this](Type *ElementType,
+                            ArrayRef<Constant *> Elements,
+                            const Twine &Name) {
+    auto *TableType = ArrayType::get(ElementType, Elements.size());
+    return new GlobalVariable(*TheModule,
+                              TableType,
+                              true,
+                              GlobalValue::InternalLinkage,
+                              ConstantArray::get(TableType, Elements),
+                              Name);
+  };
+  GlobalVariable *AddressesTable = CreateTable(PCType,
+                                               Addresses,
+                                               "function_dispatcher_pcs");
+  GlobalVariable *TargetsTable = CreateTable(FunctionPointerType,
+                                             Targets,
+                                             "function_dispatcher_targets");
+
+  auto *IndexType = Builder.getInt64Ty();
+  auto *Zero = ConstantInt::get(IndexType, 0);
+  auto *One = ConstantInt::get(IndexType, 1);
+  auto *Size = ConstantInt::get(IndexType, Entries.size());
+  auto LoadEntry = [&Builder, Zero](GlobalVariable *Table, Value *Index) {
+    Type *TableType = Table->getValueType();
+    Value *Indices[] = { Zero, Index };
+    Value *Address = Builder.CreateInBoundsGEP(TableType, Table, Indices);
+    return Builder.CreateLoad(TableType->getArrayElementType(), Address);
+  };
 
-    CallInst::Create(Function, "", TrampolineBB);
-    ReturnInst::Create(Context, TrampolineBB);
+  BasicBlock *Header = BasicBlock::Create(Context,
+                                          "lookup_header",
+                                          FunctionDispatcher);
+  BasicBlock *Body = BasicBlock::Create(Context,
+                                        "lookup_body",
+                                        FunctionDispatcher);
+  BasicBlock *Check = BasicBlock::Create(Context,
+                                         "lookup_check",
+                                         FunctionDispatcher);
+  BasicBlock *Found = BasicBlock::Create(Context,
+                                         "lookup_found",
+                                         FunctionDispatcher);
+  BasicBlock *Call = BasicBlock::Create(Context,
+                                        "trampoline",
+                                        FunctionDispatcher);
 
-    auto *Label = Builder.getIntN(PCBitSize, Descriptor.PC.asPC());
-    Switch->addCase(Label, TrampolineBB);
-  }
+  Builder.SetInsertPoint(DispatcherBB);
+  LoadInst *ProgramCounter = Builder.CreateLoad(PC, "");
+  Builder.CreateBr(Header);
+
+  // Look for the first entry not lower than the program counter
+  Builder.SetInsertPoint(Header);
+  PHINode *Low = Builder.CreatePHI(IndexType, 2, "low");
+  PHINode *High = Builder.CreatePHI(IndexType, 2, "high");
+  Low->addIncoming(Zero, DispatcherBB);
+  High->addIncoming(Size, DispatcherBB);
+  Builder.CreateCondBr(Builder.CreateICmpULT(Low, High), Body, Check);
+
+  Builder.SetInsertPoint(Body);
+  Value *HalfSize = Builder.CreateLShr(Builder.CreateSub(High, Low), One);
+  Value *Middle = Builder.CreateAdd(Low, HalfSize);
+  Value *MiddleAddress = LoadEntry(AddressesTable, Middle);
+  Value *IsLower = Builder.CreateICmpULT(MiddleAddress, ProgramCounter);
+  Low->addIncoming(Builder.CreateSelect(IsLower,
+                                        Builder.CreateAdd(Middle, One),
+                                        Low),
+                   Body);
+  High->addIncoming(Builder.CreateSelect(IsLower, High, Middle), Body);
+  Builder.CreateBr(Header);
+
+  // Check we actually found the program counter
+  Builder.SetInsertPoint(Check);
+  Builder.CreateCondBr(Builder.CreateICmpULT(Low, Size), Found, UnexpectedPC);
+
+  Builder.SetInsertPoint(Found);
+  Value *FoundAddress = LoadEntry(AddressesTable, Low);
+  Builder.CreateCondBr(Builder.CreateICmpEQ(FoundAddress, ProgramCounter),
+                       Call,
+                       UnexpectedPC);
+
+  Builder.SetInsertPoint(Call);
+  Value *Target = LoadEntry(TargetsTable, Low);
+  Builder.CreateCall(FunctionTy, Target);
+  Builder.CreateRetVoid();
 }
 
 BasicBlock *
@@ -262,6 +411,31 @@ BasicBlock *IFI::createCatchBlock(Function *Root, BasicBlock *UnexpectedPC) {
   return CatchBB;
 }
 
+void IFI::createUnwindSetjmp(Function *Root, BasicBlock *UnexpectedPC) {
+  Function *Setjmp = TheModule->getFunction("setjmp");
+  GlobalVariable *UnwindBuffer = TheModule->getGlobalVariable("unwind_buffer");
+  revng_assert(Setjmp != nullptr and UnwindBuffer != nullptr);
+
+  // Move everything but the allocas out of the entry block, so that setjmp is
+  // called exactly once, before anything else
+  BasicBlock *Entry = &Root->getEntryBlock();
+  auto It = Entry->begin();
+  while (isa<AllocaInst>(&*It))
+    ++It;
+  BasicBlock *Body = Entry->splitBasicBlock(It, "unwind_setjmp_return");
+  Entry->getTerminator()->eraseFromParent();
+
+  IRBuilder<> Builder(Entry);
+  FunctionType *SetjmpTy = Setjmp->getFunctionType();
+  auto *Buffer = ConstantExpr::getPointerCast(UnwindBuffer,
+                                              SetjmpTy->getParamType(0));
+  Value *Result = Builder.CreateCall(Setjmp, { Buffer });
+
+  // setjmp returns a non-zero value when we get here from longjmp
+  auto *Zero = ConstantInt::get(SetjmpTy->getReturnType(), 0);
+  Builder.CreateCondBr(Builder.CreateICmpNE(Result, Zero), UnexpectedPC, Body);
+}
+
 void IFI::replaceFunctionCall(StackAnalysis::BranchType::Values BranchType,
                               BasicBlock *NewBB,
                               Instruction *Call,
@@ -324,7 +498,22 @@ void IFI::replaceFunctionCall(StackAnalysis::BranchType::Values BranchType,
     Instruction *Terminator = Callee->getTerminator();
     auto *Node = cast<MDTuple>(Terminator->getMetadata("revng.func.entry"));
     auto *NameMD = cast<MDString>(&*Node->getOperand(0));
-    IsolatedFunctionDescriptor &TargetDescriptor = Functions.at(NameMD);
+
+    auto TargetIt = Functions.find(NameMD);
+    if (TargetIt == Functions.end()) {
+      // The callee has not been isolated, it's still in the root function:
+      // store its address in PC and leave the current function
+      IRBuilder<> Builder(Context);
+      Builder.SetInsertPoint(NewBB);
+      Type *PCType = PC->getType()->getPointerElementType();
+      MetaAddress CalleePC = getBasicBlockPC(Callee);
+      Builder.CreateStore(ConstantInt::get(PCType, CalleePC.asPC()), PC);
+      throwException(StandardNonTranslatedBlock,
+                     NewBB,
+                     MetaAddress::invalid());
+      return;
+    }
+    IsolatedFunctionDescriptor &TargetDescriptor = TargetIt->second;
 
     // Callee's llvm::Function
     TargetFunction = TargetDescriptor.IsolatedFunction;
@@ -479,9 +668,12 @@ bool IFI::cloneInstruction(BasicBlock *NewBB,
       Builder.CreateRetVoid();
       return false;
 
-    case StackAnalysis::BranchType::FakeFunctionReturn:
-      Builder.CreateBr(Descriptor.FakeReturnPaths.at(NewBB));
+    case StackAnalysis::BranchType::FakeFunctionReturn: {
+      BasicBlock *FakeFallthrough = Descriptor.FakeReturnPaths.lookup(NewBB);
+      revng_assert(FakeFallthrough != nullptr);
+      Builder.CreateBr(FakeFallthrough);
       return false;
+    }
 
     case StackAnalysis::BranchType::FakeFunction:
     case StackAnalysis::BranchType::RegularFunction:
@@ -674,6 +866,64 @@ bool IFI::cloneInstruction(BasicBlock *NewBB,
   return false;
 }
 
+void IFI::selectFunctions() {
+  if (RequestedEntries.empty())
+    return;
+
+  // Collect the blocks belonging to each function, we'll need them to find the
+  // callees, and enqueue the requested functions
+  QuickMetadata QMD(Context);
+  std::map<MDString *, std::vector<BasicBlock *>> MembersOf;
+  OnceQueue<MDString *> Queue;
+  std::set<MetaAddress> Found;
+  for (BasicBlock &BB : *RootFunction) {
+    Instruction *Terminator = BB.getTerminator();
+
+    if (MDNode *Node = Terminator->getMetadata("revng.func.entry")) {
+      MetaAddress Entry = getBasicBlockPC(&BB);
+      if (RequestedEntries.count(Entry) != 0) {
+        Queue.insert(cast<MDString>(&*Node->getOperand(0)));
+        Found.insert(Entry);
+      }
+    }
+
+    if (not WithCallees)
+      continue;
+
+    if (MDNode *Node = Terminator->getMetadata("revng.func.member.of")) {
+      for (const MDOperand &Op : cast<MDTuple>(Node)->operands()) {
+        auto *FunctionMD = cast<MDTuple>(Op);
+        auto *FirstOperand = QMD.extract<MDTuple *>(FunctionMD, 0);
+        MembersOf[QMD.extract<MDString *>(FirstOperand, 0)].push_back(&BB);
+      }
+    }
+  }
+
+  // Isolate what we can, but let the user know about the rest
+  for (const MetaAddress &Entry : RequestedEntries)
+    if (Found.count(Entry) == 0)
+      dbg << "Warning: no function starts at " << Entry.toString()
+          << ", it won't be isolated\n";
+
+  while (not Queue.empty()) {
+    MDString *FunctionNameMD = Queue.pop();
+    Selected.insert(FunctionNameMD);
+
+    if (not WithCallees)
+      continue;
+
+    for (BasicBlock *BB : MembersOf[FunctionNameMD]) {
+      BasicBlock *Callee = getFunctionCallCallee(BB);
+      if (Callee == nullptr)
+        continue;
+
+      MDNode *Node = Callee->getTerminator()->getMetadata("revng.func.entry");
+      if (Node != nullptr)
+        Queue.insert(cast<MDString>(&*Node->getOperand(0)));
+    }
+  }
+}
+
 StringRef IFI::getFunctionNameString(MDNode *Node) {
   auto *Tuple = cast<MDTuple>(Node);
   QuickMetadata QMD(Context);
@@ -726,9 +976,13 @@ void IFI::run() {
                                              ArgsType,
                                              false);
 
+  // With -isolate-longjmp-unwind the helper longjmps back to the root
+  // function instead of raising an exception
+  const char *RaiseExceptionName = LongjmpUnwind ? "unwind_to_root_helper" :
+                                                   "raise_exception_helper";
   RaiseException = Function::Create(RaiseExceptionFT,
                                     Function::ExternalLinkage,
-                                    "raise_exception_helper",
+                                    RaiseExceptionName,
                                     TheModule);
 
   // Instantiate the dispatcher function, that is called in occurence of an
@@ -747,7 +1001,7 @@ void IFI::run() {
   //    structure in order to copy them at the beginning of the function where
   //    they are used. The alloca initially are all placed in the entry block of
   //    the root function.
-  std::map<BasicBlock *, std::vector<Instruction *>> UsedAllocas;
+  DenseMap<BasicBlock *, std::vector<Instruction *>> UsedAllocas;
   for (Instruction &I : RootFunction->getEntryBlock()) {
 
     // If we encounter an alloca copy it in the data structure that contains
@@ -775,7 +1029,7 @@ void IFI::run() {
   // 4. Search for all the users of @function_call and populate the
   //    AdditionalSucc structure in order to be able to identify all the
   //    successors of a basic block
-  std::map<BasicBlock *, BasicBlock *> AdditionalSucc;
+  DenseMap<BasicBlock *, BasicBlock *> AdditionalSucc;
   for (User *U : CallMarker->users()) {
     if (CallInst *Call = dyn_cast<CallInst>(U)) {
       BlockAddress *Fallthrough = cast<BlockAddress>(Call->getOperand(1));
@@ -787,6 +1041,7 @@ void IFI::run() {
 
   // 5. Creation of the new LLVM functions on the basis of what recovered by
   //    the function boundaries analysis.
+  selectFunctions();
 
   for (BasicBlock &BB : *RootFunction) {
     revng_assert(!BB.empty());
@@ -795,6 +1050,10 @@ void IFI::run() {
     if (MDNode *Node = Terminator->getMetadata("revng.func.entry")) {
       auto *FunctionNameMD = cast<MDString>(&*Node->getOperand(0));
 
+      // Skip the functions that have not been requested
+      if (not isSelected(FunctionNameMD))
+        continue;
+
       StringRef FunctionNameString = getFunctionNameString(Node);
 
       // We obtain a FunctionType of a function that has no arguments
@@ -836,7 +1095,12 @@ void IFI::run() {
         auto *FunctionMD = cast<MDTuple>(Op);
         auto *FirstOperand = QMD.extract<MDTuple *>(FunctionMD, 0);
         auto *FunctionNameMD = QMD.extract<MDString *>(FirstOperand, 0);
-        IsolatedFunctionDescriptor &Descriptor = Functions.at(FunctionNameMD);
+
+        // The block belongs to a function that is not being isolated
+        auto FunctionIt = Functions.find(FunctionNameMD);
+        if (FunctionIt == Functions.end())
+          continue;
+        IsolatedFunctionDescriptor &Descriptor = FunctionIt->second;
         Function *ParentFunction = Descriptor.IsolatedFunction;
 
         // We assert if we can't find the parent function of the basic block
@@ -867,7 +1131,7 @@ void IFI::run() {
 
         // Update the map that we will use later for filling the basic blocks
         // with instructions
-        IsolatedToRootBB[NewBB] = &BB;
+        Descriptor.IsolatedToRootBB[NewBB] = &BB;
 
         auto MemberType = fromName(QMD.extract<StringRef>(FunctionMD, 1));
         Descriptor.Members[NewBB] = MemberType;
@@ -876,6 +1140,16 @@ void IFI::run() {
   }
 
   // 7. Analyze all the created functions and populate them
+  //
+  //    Note: this loop is intentionally serial. Even though each isolated
+  //    function only reads from the root function, cloning is not read-only
+  //    at the IR level: every cloned instruction adds uses to constants,
+  //    globals and helper functions shared across the whole module, and
+  //    creating types, constants and metadata goes through the uniquing
+  //    tables of the single LLVMContext. None of these are thread-safe.
+  //    Parallelizing would require cloning into per-thread contexts, which in
+  //    turn would mean a full module link step at the end, likely more
+  //    expensive than the cloning itself.
   for (auto &Pair : Functions) {
 
     IsolatedFunctionDescriptor &Descriptor = Pair.second;
@@ -898,11 +1172,11 @@ void IFI::run() {
 
     BasicBlock *RootUnexepctedPC = GCBI.unexpectedPC();
     RootToIsolated[RootUnexepctedPC] = UnexpectedPC;
-    IsolatedToRootBB[UnexpectedPC] = RootUnexepctedPC;
+    Descriptor.IsolatedToRootBB[UnexpectedPC] = RootUnexepctedPC;
 
     BasicBlock *RootAnyPC = GCBI.anyPC();
     RootToIsolated[RootAnyPC] = AnyPC;
-    IsolatedToRootBB[AnyPC] = RootAnyPC;
+    Descriptor.IsolatedToRootBB[AnyPC] = RootAnyPC;
 
     for (BasicBlock &NewBB : *AnalyzedFunction) {
 
@@ -918,7 +1192,7 @@ void IFI::run() {
         continue;
       }
 
-      BasicBlock *BB = IsolatedToRootBB[&NewBB];
+      BasicBlock *BB = Descriptor.IsolatedToRootBB.lookup(&NewBB);
       revng_assert(BB != nullptr);
       Instruction *Terminator = BB->getTerminator();
 
@@ -956,7 +1230,7 @@ void IFI::run() {
 
       // Add also the basic block that is executed after a function
       // call, identified before (the fall through block)
-      if (BasicBlock *Successor = AdditionalSucc[BB]) {
+      if (BasicBlock *Successor = AdditionalSucc.lookup(BB)) {
         auto SuccessorIt = RootToIsolated.find(Successor);
 
         // In some occasions we have that the fallthrough block a function_call
@@ -995,47 +1269,55 @@ void IFI::run() {
     // TODO: we do not support fake function calls sharing a fake return and,
     //       consequently, we do not support calling the same fake function
     //       multiple times
-    for (auto &P : Descriptor.Members) {
+    class FakeCallFinder : public BackwardBFSVisitor<FakeCallFinder> {
+    public:
+      FakeCallFinder(const IsolatedFunctionDescriptor &Descriptor) :
+        Descriptor(Descriptor), FakeCall(nullptr) {}
+
+      VisitAction visit(instruction_range Range) {
+        revng_assert(Range.begin() != Range.end());
+        Instruction *Term = &*Range.begin();
+        using namespace StackAnalysis::BranchType;
+        if (Descriptor.Members.at(Term->getParent()) == FakeFunctionCall) {
+          revng_assert(FakeCall == nullptr or FakeCall == Term->getParent(),
+                       "Multiple fake function call sharing a fake return");
+          FakeCall = Term->getParent();
+          return NoSuccessors;
+        }
 
-      // Consider fake returns only
-      if (P.second != StackAnalysis::BranchType::FakeFunctionReturn)
-        continue;
+        return Continue;
+      }
 
-      class FakeCallFinder : public BackwardBFSVisitor<FakeCallFinder> {
-      public:
-        FakeCallFinder(const IsolatedFunctionDescriptor &Descriptor) :
-          Descriptor(Descriptor), FakeCall(nullptr) {}
+      BasicBlock *find(Instruction *FakeReturn) {
+        FakeCall = nullptr;
+        run(FakeReturn);
+        return FakeCall;
+      }
 
-        VisitAction visit(instruction_range Range) {
-          revng_assert(Range.begin() != Range.end());
-          Instruction *Term = &*Range.begin();
-          using namespace StackAnalysis::BranchType;
-          if (Descriptor.Members.at(Term->getParent()) == FakeFunctionCall) {
-            revng_assert(FakeCall == nullptr or FakeCall == Term->getParent(),
-                         "Multiple fake function call sharing a fake return");
-            FakeCall = Term->getParent();
-            return NoSuccessors;
-          }
+    private:
+      const IsolatedFunctionDescriptor &Descriptor;
+      BasicBlock *FakeCall;
+    };
 
-          return Continue;
-        }
+    // The finder is shared by all the searches, so they don't have to
+    // allocate their visited set and work list each time
+    FakeCallFinder FCF(Descriptor);
 
-        BasicBlock *fakeCall() const { return FakeCall; }
+    for (auto &P : Descriptor.Members) {
 
-      private:
-        const IsolatedFunctionDescriptor &Descriptor;
-        BasicBlock *FakeCall;
-      };
+      // Consider fake returns only
+      if (P.second != StackAnalysis::BranchType::FakeFunctionReturn)
+        continue;
 
       // Find the only corresponding fake function call
-      FakeCallFinder FCF(Descriptor);
-      FCF.run(P.first->getTerminator());
-      BasicBlock *FakeCall = FCF.fakeCall();
+      BasicBlock *FakeCall = FCF.find(P.first->getTerminator());
       revng_assert(FakeCall != nullptr);
 
       // Get the fallthrough successor
-      FakeCall = IsolatedToRootBB.at(FakeCall);
-      Value *RootFallthrough = AdditionalSucc.at(FakeCall);
+      FakeCall = Descriptor.IsolatedToRootBB.lookup(FakeCall);
+      revng_assert(FakeCall != nullptr);
+      Value *RootFallthrough = AdditionalSucc.lookup(FakeCall);
+      revng_assert(RootFallthrough != nullptr);
       auto *FakeFallthrough = cast<BasicBlock>(RootToIsolated[RootFallthrough]);
 
       // Replace unreachable with single-successor dummy switch
@@ -1082,10 +1364,12 @@ void IFI::run() {
 
     // 12. We copy the allocas at the beginning of the function where they will
     //     be used
-    std::set<Instruction *> AllocasToClone;
-    for (BasicBlock &BB : *AnalyzedFunction)
-      for (Instruction *OldAlloca : UsedAllocas[IsolatedToRootBB[&BB]])
-        AllocasToClone.insert(OldAlloca);
+    SmallSetVector<Instruction *, 16> AllocasToClone;
+    for (BasicBlock &BB : *AnalyzedFunction) {
+      auto It = UsedAllocas.find(Descriptor.IsolatedToRootBB.lookup(&BB));
+      if (It != UsedAllocas.end())
+        AllocasToClone.insert(It->second.begin(), It->second.end());
+    }
 
     for (Instruction *OldAlloca : AllocasToClone) {
       Instruction *NewAlloca = OldAlloca->clone();
@@ -1115,7 +1399,7 @@ void IFI::run() {
       // Do not try to populate unexpectedpc and anypc, since they have already
       // been populated in an ad-hoc manner.
       if (NewBB != UnexpectedPC && NewBB != AnyPC) {
-        BasicBlock *OldBB = IsolatedToRootBB.at(NewBB);
+        BasicBlock *OldBB = Descriptor.IsolatedToRootBB.lookup(NewBB);
         revng_assert(OldBB != nullptr);
 
         // Actual copy of the instructions
@@ -1145,7 +1429,7 @@ void IFI::run() {
       revng_assert(Terminators == 1);
     }
 
-    freeContainer(RootToIsolated);
+    Descriptor.releaseCloningState();
   }
 
   // 14. Create the functions and basic blocks needed for the correct execution
@@ -1163,26 +1447,35 @@ void IFI::run() {
   revng_assert(UnexpectedPC != nullptr);
   revng_assert(Dispatcher != nullptr);
 
-  // Instantiate the basic block structure that handles the control flow after
-  // an invoke
-  BasicBlock *InvokeReturnBlock = createInvokeReturnBlock(Root, Dispatcher);
-
-  // Instantiate the basic block structure that represents the catch of the
-  // invoke, please remember that this is not used at the moment (exceptions
-  // are handled in a customary way from the standard exit control flow path)
-  BasicBlock *CatchBB = createCatchBlock(Root, UnexpectedPC);
-
-  // Declaration of an ad-hoc personality function that is implemented in the
-  // support.c source file
-  auto *PersonalityFT = FunctionType::get(Type::getInt32Ty(Context), true);
-
-  Function *PersonalityFunction = Function::Create(PersonalityFT,
-                                                   Function::ExternalLinkage,
-                                                   "__gxx_personality_v0",
-                                                   TheModule);
-
-  // Add the personality to the root function
-  Root->setPersonalityFn(PersonalityFunction);
+  BasicBlock *InvokeReturnBlock = nullptr;
+  BasicBlock *CatchBB = nullptr;
+  if (LongjmpUnwind) {
+    // Isolated functions longjmp back to the entry of the root function,
+    // which then proceeds to unexpectedpc. The functions are called with
+    // plain calls, no landing pad is emitted.
+    createUnwindSetjmp(Root, UnexpectedPC);
+  } else {
+    // Instantiate the basic block structure that handles the control flow after
+    // an invoke
+    InvokeReturnBlock = createInvokeReturnBlock(Root, Dispatcher);
+
+    // Instantiate the basic block structure that represents the catch of the
+    // invoke, please remember that this is not used at the moment (exceptions
+    // are handled in a customary way from the standard exit control flow path)
+    CatchBB = createCatchBlock(Root, UnexpectedPC);
+
+    // Declaration of an ad-hoc personality function that is implemented in the
+    // support.c source file
+    auto *PersonalityFT = FunctionType::get(Type::getInt32Ty(Context), true);
+
+    Function *PersonalityFunction = Function::Create(PersonalityFT,
+                                                     Function::ExternalLinkage,
+                                                     "__gxx_personality_v0",
+                                                     TheModule);
+
+    // Add the personality to the root function
+    Root->setPersonalityFn(PersonalityFunction);
+  }
 
   // Emit at the beginning of the basic blocks identified as function entries
   // by revng a call to the newly created corresponding LLVM function
@@ -1191,6 +1484,10 @@ void IFI::run() {
 
     Instruction *Terminator = BB.getTerminator();
     if (MDNode *Node = Terminator->getMetadata("revng.func.entry")) {
+      // Functions that have not been isolated stay in the root function
+      if (Functions.count(cast<MDString>(&*Node->getOperand(0))) == 0)
+        continue;
+
       StringRef FunctionNameString = getFunctionNameString(Node);
       Function *TargetFunc = TheModule->getFunction(FunctionNameString);
 
@@ -1200,6 +1497,13 @@ void IFI::run() {
       BB.replaceAllUsesWith(NewBB);
       NewBB->takeName(&BB);
 
+      if (LongjmpUnwind) {
+        // Call the function and go back to the dispatcher
+        CallInst::Create(TargetFunc, "", NewBB);
+        BranchInst::Create(Dispatcher, NewBB);
+        continue;
+      }
+
       // Emit the invoke instruction
       InvokeInst *Invoke = InvokeInst::Create(TargetFunc,
                                               InvokeReturnBlock,
@@ -1241,12 +1545,33 @@ void IFI::run() {
 }
 
 bool IF::runOnModule(Module &TheModule) {
+  ScopedTimer Timer("IsolateFunctions");
 
   // Retrieve analysis of the GeneratedCodeBasicInfo pass
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
+  // Use the command line options, unless a set of functions to isolate has
+  // been explicitly requested
+  if (Entries.empty()) {
+    for (const std::string &Address : IsolateOnly) {
+      MetaAddress Entry = MetaAddress::fromString(Address);
+      if (Entry.isValid())
+        Entries.insert(Entry);
+      else
+        dbg << "Warning: ignoring invalid address " << Address
+            << " in -isolate-only\n";
+    }
+    WithCallees = IsolateCallees;
+
+    // An empty set would mean isolating everything
+    if (IsolateOnly.size() != 0 and Entries.empty()) {
+      dbg << "Warning: no valid address in -isolate-only, nothing to isolate\n";
+      return false;
+    }
+  }
+
   // Create an object of type IsolateFunctionsImpl and run the pass
-  IFI Impl(TheModule.getFunction("root"), GCBI);
+  IFI Impl(TheModule.getFunction("root"), GCBI, Entries, WithCallees);
   Impl.run();
 
   return false;
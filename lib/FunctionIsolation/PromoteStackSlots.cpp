@@ -0,0 +1,531 @@
+/// \file PromoteStackSlots.cpp
+/// \brief Promote the private stack slots of isolated functions to allocas.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/FunctionIsolation/PromoteStackSlots.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+static Logger<> PromoteStackSlotsLog("promote-stack-slots");
+
+char PromoteStackSlots::ID = 0;
+using Register = RegisterPass<PromoteStackSlots>;
+static Register X("promote-stack-slots",
+                  "Promote the private stack slots of isolated functions to "
+                  "allocas",
+                  false,
+                  false);
+
+void PromoteStackSlots::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesCFG();
+  AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+}
+
+namespace {
+
+/// \brief How a value relates to the stack pointer at the function entry
+struct StackOffset {
+  enum KindType {
+    /// The value is not derived from the stack pointer
+    Unrelated,
+    /// The value is the entry stack pointer plus Offset
+    Known,
+    /// The value is derived from the stack pointer in an unknown way
+    Unknown
+  };
+
+  KindType Kind = Unrelated;
+  int64_t Offset = 0;
+
+  static StackOffset known(int64_t Offset) { return { Known, Offset }; }
+  static StackOffset unknown() { return { Unknown, 0 }; }
+
+  bool isRelated() const { return Kind != Unrelated; }
+
+  bool operator==(const StackOffset &Other) const {
+    return Kind == Other.Kind and Offset == Other.Offset;
+  }
+
+  bool operator!=(const StackOffset &Other) const {
+    return not(*this == Other);
+  }
+
+  StackOffset merge(const StackOffset &Other) const {
+    return *this == Other ? *this : unknown();
+  }
+};
+
+/// \brief The CSVs and the local variables related to the stack pointer
+using SlotsState = std::map<Value *, StackOffset>;
+
+/// \brief A contiguous portion of the stack frame backed by an alloca
+struct FrameRegion {
+  int64_t Start;
+  int64_t End;
+  AllocaInst *Slot = nullptr;
+};
+
+/// \brief Analyze and promote the stack frame of a single function
+class StackFrame {
+public:
+  StackFrame(Function &F,
+             GeneratedCodeBasicInfo &GCBI,
+             const DenseMap<const Value *, unsigned> &Indices) :
+    F(F),
+    M(*F.getParent()),
+    GCBI(GCBI),
+    Indices(Indices),
+    SP(GCBI.spReg()),
+    LoadMDKind(M.getMDKindID("revng.csvaccess.offsets.load")),
+    StoreMDKind(M.getMDKindID("revng.csvaccess.offsets.store")),
+    GuestMemoryMDKind(M.getMDKindID("revng.guestmemory")) {}
+
+  /// \return true if the frame can be promoted.
+  bool analyze();
+
+  /// \brief Redirect the accesses to the frame to allocas
+  ///
+  /// \return the number of promoted accesses.
+  unsigned promote();
+
+private:
+  bool transfer(Instruction &I, SlotsState &State);
+  bool handleAccess(Instruction &I, StackOffset Address, Type *AccessType);
+  void setValue(Instruction &I, StackOffset Result);
+
+  StackOffset get(Value *V) const {
+    auto It = Values.find(V);
+    return It == Values.end() ? StackOffset() : It->second;
+  }
+
+  static StackOffset get(const SlotsState &State, Value *Slot) {
+    auto It = State.find(Slot);
+    return It == State.end() ? StackOffset() : It->second;
+  }
+
+  static void set(SlotsState &State, Value *Slot, StackOffset Offset) {
+    if (Offset.isRelated())
+      State[Slot] = Offset;
+    else
+      State.erase(Slot);
+  }
+
+  static SlotsState merge(const SlotsState &A, const SlotsState &B) {
+    SlotsState Result;
+    for (auto &P : A)
+      Result[P.first] = P.second.merge(get(B, P.first));
+    for (auto &P : B)
+      if (A.count(P.first) == 0)
+        Result[P.first] = P.second.merge(StackOffset());
+    return Result;
+  }
+
+  /// \brief Is \p Pointer a CSV or a local variable we track as a whole?
+  bool isSlot(Value *Pointer) const {
+    return Indices.count(Pointer) != 0 or TrackedAllocas.count(Pointer) != 0;
+  }
+
+  void collectTrackedAllocas();
+
+private:
+  Function &F;
+  Module &M;
+  GeneratedCodeBasicInfo &GCBI;
+  const DenseMap<const Value *, unsigned> &Indices;
+  GlobalVariable *SP;
+  const unsigned LoadMDKind;
+  const unsigned StoreMDKind;
+  const unsigned GuestMemoryMDKind;
+
+  std::set<Value *> TrackedAllocas;
+  DenseMap<Value *, StackOffset> Values;
+  std::map<BasicBlock *, SlotsState> OutStates;
+  bool Changed = false;
+
+  /// Accesses to the frame, with their offset from the entry stack pointer
+  std::vector<std::pair<Instruction *, int64_t>> Accesses;
+
+  /// Returns and exception helper calls, before which the frame is spilled
+  std::vector<Instruction *> ExitPoints;
+};
+
+} // namespace
+
+void StackFrame::collectTrackedAllocas() {
+  // Local variables which are only loaded and stored as a whole
+  for (Instruction &I : F.getEntryBlock()) {
+    auto *Alloca = dyn_cast<AllocaInst>(&I);
+    if (Alloca == nullptr)
+      continue;
+
+    auto IsWholeAccess = [Alloca](User *U) {
+      if (auto *Load = dyn_cast<LoadInst>(U))
+        return Load->isSimple();
+      if (auto *Store = dyn_cast<StoreInst>(U))
+        return Store->isSimple() and Store->getPointerOperand() == Alloca;
+      return false;
+    };
+
+    if (all_of(Alloca->users(), IsWholeAccess))
+      TrackedAllocas.insert(Alloca);
+  }
+}
+
+void StackFrame::setValue(Instruction &I, StackOffset Result) {
+  auto It = Values.find(&I);
+  if (It == Values.end()) {
+    Values[&I] = Result;
+    Changed = true;
+  } else if (It->second != Result) {
+    It->second = Result;
+    Changed = true;
+  }
+}
+
+bool StackFrame::handleAccess(Instruction &I,
+                              StackOffset Address,
+                              Type *AccessType) {
+  if (Address.Kind == StackOffset::Unknown)
+    return false;
+
+  // Accesses to the frame of the caller (e.g., stack arguments) are left
+  // untouched
+  int64_t Size = M.getDataLayout().getTypeStoreSize(AccessType);
+  if (Address.Offset >= 0)
+    return true;
+
+  // Straddling the entry stack pointer
+  if (Address.Offset + Size > 0)
+    return false;
+
+  auto *Load = dyn_cast<LoadInst>(&I);
+  auto *Store = dyn_cast<StoreInst>(&I);
+  if ((Load != nullptr and not Load->isSimple())
+      or (Store != nullptr and not Store->isSimple()))
+    return false;
+
+  Accesses.emplace_back(&I, Address.Offset);
+  return true;
+}
+
+bool StackFrame::transfer(Instruction &I, SlotsState &State) {
+  StackOffset Result;
+
+  if (auto *Load = dyn_cast<LoadInst>(&I)) {
+    Value *Pointer = Load->getPointerOperand();
+    StackOffset Address = get(Pointer);
+    if (Address.isRelated()) {
+      if (not handleAccess(I, Address, Load->getType()))
+        return false;
+    } else if (isSlot(Pointer)) {
+      Result = get(State, Pointer);
+    } else {
+      // Reading part of a CSV holding a stack address
+      Value *Base = Pointer->stripInBoundsConstantOffsets();
+      if (Indices.count(Base) != 0 and get(State, Base).isRelated())
+        Result = StackOffset::unknown();
+    }
+
+  } else if (auto *Store = dyn_cast<StoreInst>(&I)) {
+    Value *Pointer = Store->getPointerOperand();
+    StackOffset Address = get(Pointer);
+    StackOffset Stored = get(Store->getValueOperand());
+    if (Address.isRelated()) {
+      // Stack addresses saved in memory escape our tracking
+      if (Stored.isRelated())
+        return false;
+      Type *StoredType = Store->getValueOperand()->getType();
+      if (not handleAccess(I, Address, StoredType))
+        return false;
+    } else if (isSlot(Pointer)) {
+      set(State, Pointer, Stored);
+    } else {
+      Value *Base = Pointer->stripInBoundsConstantOffsets();
+      if (Stored.isRelated())
+        return false;
+      if (Indices.count(Base) != 0 and get(State, Base).isRelated())
+        set(State, Base, StackOffset::unknown());
+    }
+
+  } else if (auto *Call = dyn_cast<CallInst>(&I)) {
+    for (Value *Argument : Call->args())
+      if (get(Argument).isRelated())
+        return false;
+
+    Function *Callee = getCallee(Call);
+    if (isCallToHelper(Call)
+        and (Call->getMetadata(LoadMDKind) != nullptr
+             or Call->getMetadata(StoreMDKind) != nullptr)) {
+      // Helpers reading a stack address might dereference it
+      const auto &Usage = GCBI.getCSVUsage(Call);
+      ArrayRef<GlobalVariable *> CSVs = GCBI.csvs();
+      for (unsigned Index : Usage.ReadSet.set_bits())
+        if (get(State, CSVs[Index]).isRelated())
+          return false;
+      for (unsigned Index : Usage.WrittenSet.set_bits())
+        if (get(State, CSVs[Index]).isRelated())
+          set(State, CSVs[Index], StackOffset::unknown());
+    } else if (Callee != nullptr and Callee->isIntrinsic()
+               and (Call->doesNotAccessMemory()
+                    or isa<DbgInfoIntrinsic>(Call))) {
+      // Nothing to do
+    } else if (isCallTo(Call, "newpc") or isCallTo(Call, "function_call")) {
+      // Markers
+    } else if (isCallTo(Call, "raise_exception_helper")
+               or isCallTo(Call, "unwind_to_root_helper")) {
+      ExitPoints.push_back(Call);
+    } else {
+      // Calls to other functions might access the frame
+      return false;
+    }
+
+  } else if (isa<ReturnInst>(&I)) {
+    ExitPoints.push_back(&I);
+
+  } else if (auto *Phi = dyn_cast<PHINode>(&I)) {
+    Optional<StackOffset> Merged;
+    for (Value *Incoming : Phi->incoming_values()) {
+      // Ignore the incoming values we didn't reach yet
+      if (isa<Instruction>(Incoming) and Values.count(Incoming) == 0)
+        continue;
+
+      StackOffset Offset = get(Incoming);
+      Merged = Merged.hasValue() ? Merged->merge(Offset) : Offset;
+    }
+
+    if (Merged.hasValue())
+      Result = *Merged;
+
+  } else if (auto *Select = dyn_cast<SelectInst>(&I)) {
+    Result = get(Select->getTrueValue()).merge(get(Select->getFalseValue()));
+
+  } else if (auto *Binary = dyn_cast<BinaryOperator>(&I)) {
+    StackOffset LHS = get(Binary->getOperand(0));
+    StackOffset RHS = get(Binary->getOperand(1));
+    auto *LHSConstant = dyn_cast<ConstantInt>(Binary->getOperand(0));
+    auto *RHSConstant = dyn_cast<ConstantInt>(Binary->getOperand(1));
+    unsigned Opcode = Binary->getOpcode();
+
+    if (not LHS.isRelated() and not RHS.isRelated()) {
+      // Nothing to do
+    } else if (Opcode == Instruction::Add and LHS.Kind == StackOffset::Known
+               and RHSConstant != nullptr) {
+      Result = StackOffset::known(LHS.Offset + RHSConstant->getSExtValue());
+    } else if (Opcode == Instruction::Add and RHS.Kind == StackOffset::Known
+               and LHSConstant != nullptr) {
+      Result = StackOffset::known(RHS.Offset + LHSConstant->getSExtValue());
+    } else if (Opcode == Instruction::Sub and LHS.Kind == StackOffset::Known
+               and RHSConstant != nullptr) {
+      Result = StackOffset::known(LHS.Offset - RHSConstant->getSExtValue());
+    } else {
+      Result = StackOffset::unknown();
+    }
+
+  } else if (isa<IntToPtrInst>(&I) or isa<PtrToIntInst>(&I)
+             or isa<BitCastInst>(&I)) {
+    Result = get(I.getOperand(0));
+
+  } else if (isa<CmpInst>(&I)) {
+    // Comparing stack addresses is fine
+
+  } else if (isa<InvokeInst>(&I) or isa<CallBrInst>(&I)) {
+    return false;
+
+  } else {
+    for (Value *Operand : I.operands())
+      if (get(Operand).isRelated())
+        Result = StackOffset::unknown();
+  }
+
+  if (not I.getType()->isVoidTy())
+    setValue(I, Result);
+
+  return true;
+}
+
+bool StackFrame::analyze() {
+  if (SP == nullptr)
+    return false;
+
+  collectTrackedAllocas();
+
+  // Propagate the offsets until a fixed point: offsets can only become
+  // unknown, so this terminates
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  do {
+    Changed = false;
+    Accesses.clear();
+    ExitPoints.clear();
+
+    for (BasicBlock *BB : RPOT) {
+      SlotsState State;
+      if (BB == &F.getEntryBlock()) {
+        State[SP] = StackOffset::known(0);
+      } else {
+        bool First = true;
+        for (BasicBlock *Predecessor : predecessors(BB)) {
+          auto It = OutStates.find(Predecessor);
+          if (It == OutStates.end())
+            continue;
+          State = First ? It->second : merge(State, It->second);
+          First = false;
+        }
+      }
+
+      for (Instruction &I : *BB)
+        if (not transfer(I, State))
+          return false;
+
+      auto It = OutStates.find(BB);
+      if (It == OutStates.end() or It->second != State) {
+        OutStates[BB] = std::move(State);
+        Changed = true;
+      }
+    }
+  } while (Changed);
+
+  return not Accesses.empty();
+}
+
+unsigned StackFrame::promote() {
+  LLVMContext &Context = M.getContext();
+  Type *Int8 = Type::getInt8Ty(Context);
+  auto *SPType = cast<IntegerType>(SP->getValueType());
+
+  // Group the overlapping accesses in regions
+  std::vector<std::pair<int64_t, int64_t>> Ranges;
+  for (auto &P : Accesses) {
+    Instruction *I = P.first;
+    Type *AccessType = isa<LoadInst>(I) ? I->getType() :
+                                          I->getOperand(0)->getType();
+    int64_t Size = M.getDataLayout().getTypeStoreSize(AccessType);
+    Ranges.emplace_back(P.second, P.second + Size);
+  }
+  std::sort(Ranges.begin(), Ranges.end());
+
+  std::vector<FrameRegion> Regions;
+  for (auto &Range : Ranges) {
+    if (not Regions.empty() and Range.first < Regions.back().End)
+      Regions.back().End = std::max(Regions.back().End, Range.second);
+    else
+      Regions.push_back({ Range.first, Range.second });
+  }
+
+  auto FindRegion = [&Regions](int64_t Offset) -> FrameRegion & {
+    auto It = llvm::upper_bound(Regions, Offset, [](int64_t Offset,
+                                                    const FrameRegion &R) {
+      return Offset < R.Start;
+    });
+    revng_assert(It != Regions.begin());
+    return *std::prev(It);
+  };
+
+  // Allocate the regions and fill them from guest memory at the entry
+  BasicBlock &Entry = F.getEntryBlock();
+  IRBuilder<> Builder(&Entry, Entry.getFirstInsertionPt());
+  for (FrameRegion &Region : Regions) {
+    auto *RegionType = ArrayType::get(Int8, Region.End - Region.Start);
+    Region.Slot = Builder.CreateAlloca(RegionType, nullptr, "stack_frame");
+  }
+
+  Value *EntrySP = Builder.CreateLoad(SPType, SP, "entry_sp");
+  auto GuestAddress = [&](IRBuilder<> &Builder, int64_t Offset) {
+    Value *Address = Builder.CreateAdd(EntrySP,
+                                       ConstantInt::get(SPType, Offset, true));
+    return Builder.CreateIntToPtr(Address, Builder.getInt8PtrTy());
+  };
+
+  for (FrameRegion &Region : Regions)
+    Builder.CreateMemCpy(Region.Slot,
+                         MaybeAlign(1),
+                         GuestAddress(Builder, Region.Start),
+                         MaybeAlign(1),
+                         Region.End - Region.Start);
+
+  // Redirect the accesses
+  for (auto &P : Accesses) {
+    Instruction *I = P.first;
+    FrameRegion &Region = FindRegion(P.second);
+    unsigned PointerIndex = isa<LoadInst>(I) ? 0 : 1;
+    Value *OldPointer = I->getOperand(PointerIndex);
+
+    Builder.SetInsertPoint(I);
+    Value *Indices[] = { Builder.getInt32(0),
+                         Builder.getInt64(P.second - Region.Start) };
+    Value *Pointer = Builder.CreateInBoundsGEP(Region.Slot->getAllocatedType(),
+                                               Region.Slot,
+                                               Indices);
+    Pointer = Builder.CreateBitCast(Pointer, OldPointer->getType());
+    I->setOperand(PointerIndex, Pointer);
+
+    // The alloca is not guest memory and it has no alignment guarantees
+    I->setMetadata(GuestMemoryMDKind, nullptr);
+    if (auto *Load = dyn_cast<LoadInst>(I))
+      Load->setAlignment(Align(1));
+    else
+      cast<StoreInst>(I)->setAlignment(Align(1));
+  }
+
+  // Spill the regions back before leaving the function
+  for (Instruction *Exit : ExitPoints) {
+    Builder.SetInsertPoint(Exit);
+    for (FrameRegion &Region : Regions)
+      Builder.CreateMemCpy(GuestAddress(Builder, Region.Start),
+                           MaybeAlign(1),
+                           Region.Slot,
+                           MaybeAlign(1),
+                           Region.End - Region.Start);
+  }
+
+  return Accesses.size();
+}
+
+bool PromoteStackSlots::runOnModule(Module &M) {
+  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  if (GCBI.spReg() == nullptr)
+    return false;
+
+  DenseMap<const Value *, unsigned> Indices;
+  ArrayRef<GlobalVariable *> CSVs = GCBI.csvs();
+  for (unsigned I = 0; I < CSVs.size(); ++I)
+    Indices[CSVs[I]] = I;
+
+  unsigned Functions = 0;
+  unsigned Promoted = 0;
+  for (Function &F : M) {
+    // Only isolated functions
+    if (F.isDeclaration() or F.getMetadata("revng.func.entry") == nullptr)
+      continue;
+
+    StackFrame Frame(F, GCBI, Indices);
+    if (not Frame.analyze())
+      continue;
+
+    Promoted += Frame.promote();
+    Functions++;
+  }
+
+  revng_log(PromoteStackSlotsLog,
+            "Promoted " << Promoted << " stack accesses in " << Functions
+                        << " functions");
+
+  return Promoted != 0;
+}
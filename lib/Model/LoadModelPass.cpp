@@ -13,6 +13,10 @@
 
 // Local libraries includes
 #include "revng/Model/LoadModelPass.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/Model/TupleTreeDiff.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Statistics.h"
 
 using namespace llvm;
 
@@ -23,32 +27,127 @@ using RP = RegisterPass<T>;
 
 static RP<LoadModelPass> X("load-model", "Deserialize the model", true, true);
 
+cl::opt<unsigned> MaxModelDiffs("model-max-diffs",
+                                cl::desc("when the model changes, store in "
+                                         "the IR only what changed, until "
+                                         "there are this many diffs, then "
+                                         "store the full model again"),
+                                cl::cat(MainCategory),
+                                cl::init(0));
+
+static MemoryGauge ModelMemory("model");
+
+/// \brief Approximate number of bytes taken by \p Binary
+static uint64_t footprint(const model::Binary &Binary) {
+  uint64_t Result = sizeof(model::Binary);
+  for (const model::Function &Function : Binary.Functions) {
+    Result += sizeof(model::Function) + Function.Name.capacity();
+    for (const model::BasicBlock &Block : Function.CFG) {
+      Result += sizeof(model::BasicBlock);
+      Result += Block.Successors.size() * sizeof(model::FunctionEdge);
+    }
+  }
+  return Result;
+}
+
+static StringRef getString(const MDNode *Tuple) {
+  revng_check(Tuple->getNumOperands());
+  return cast<MDString>(Tuple->getOperand(0).get())->getString();
+}
+
+static StringRef getSerializedString(const llvm::Module &M) {
+  NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
+  revng_check(NamedMD and NamedMD->getNumOperands());
+  return getString(NamedMD->getOperand(0));
+}
+
 model::Binary LoadModelPass::getModel(const llvm::Module &M) {
 
   model::Binary Result;
 
   NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
-  revng_check(NamedMD and NamedMD->getNumOperands());
+  StringRef Serialized = getSerializedString(M);
 
-  auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
-  revng_check(Tuple->getNumOperands());
+  // The encoding is detected from the content, there's no need to tell which
+  // one has been used by -serialize-model
+  if (tupletree::binary::isBinary(Serialized)) {
+    tupletree::binary::deserialize(Serialized, Result);
+  } else {
+    yaml::Input YAMLInput(Serialized);
+    YAMLInput >> Result;
+  }
 
-  Metadata *MD = Tuple->getOperand(0).get();
-  StringRef YAMLString = cast<MDString>(MD)->getString();
+  // Apply the diffs
+  for (unsigned I = 1; I < NamedMD->getNumOperands(); ++I)
+    tupletreediff::binary::apply(getString(NamedMD->getOperand(I)), Result);
 
-  yaml::Input YAMLInput(YAMLString);
-  YAMLInput >> Result;
+  return Result;
+}
+
+Optional<model::Function>
+LoadModelPass::getFunction(const llvm::Module &M, const MetaAddress &Entry) {
+  StringRef Serialized = getSerializedString(M);
+
+  // Without the binary encoding, or in presence of diffs, we have to parse
+  // everything
+  NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
+  if (not tupletree::binary::isBinary(Serialized)
+      or NamedMD->getNumOperands() > 1) {
+    model::Binary Model = getModel(M);
+    auto It = Model.Functions.find(Entry);
+    if (It == Model.Functions.end())
+      return {};
+    return std::move(*It);
+  }
+
+  static auto Matcher = PathMatcher::create<model::Binary>("/Functions/*");
+  model::Function Result(Entry);
+  using namespace tupletree::binary;
+  if (not getByPath<model::Binary>(Serialized, Matcher->apply(Entry), Result))
+    return {};
 
   return Result;
 }
 
+void LoadModelPass::forEachFunction(const Module &M,
+                                    function_ref<void(const model::Function &)>
+                                      Callback) {
+  StringRef Serialized = getSerializedString(M);
+
+  NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
+  if (not tupletree::binary::isBinary(Serialized)
+      or NamedMD->getNumOperands() > 1) {
+    for (const model::Function &F : getModel(M).Functions)
+      Callback(F);
+    return;
+  }
+
+  static auto Path = stringAsPath<model::Binary>("/Functions");
+  using namespace tupletree::binary;
+  bool Found = forEachByPath<model::Binary, model::Function>(Serialized,
+                                                             *Path,
+                                                             Callback);
+  revng_assert(Found);
+}
+
 bool LoadModelPass::doInitialization(Module &M) {
 
   TheBinary = getModel(M);
 
+  // Keep track of what we loaded, -serialize-model might only need to append
+  // a diff to it
+  NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
+  for (MDNode *Operand : NamedMD->operands())
+    Serialized.push_back(Operand);
+
+  if (MaxModelDiffs != 0)
+    Original = TheBinary;
+
+  uint64_t Footprint = footprint(TheBinary);
+  ModelMemory.set(Original ? 2 * Footprint : Footprint);
+
   // Erase the named metadata in order to make sure no one is tempted to
   // deserialize it on its own
-  NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
   NamedMD->eraseFromParent();
 
   return false;
@@ -58,6 +157,9 @@ bool LoadModelPass::doFinalization(Module &M) {
   if (not Modified)
     return false;
 
+  uint64_t Footprint = footprint(TheBinary);
+  ModelMemory.set(Original ? Footprint + footprint(*Original) : Footprint);
+
   // Check if the named metadata has reappeared. If not, the changes we made in
   // this pipeline would go lost
   NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
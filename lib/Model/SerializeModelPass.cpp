@@ -10,9 +10,13 @@
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/PassSupport.h"
+#include "llvm/Support/CommandLine.h"
 
 // Local libraries includes
 #include "revng/Model/SerializeModelPass.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/Model/TupleTreeDiff.h"
+#include "revng/Support/CommandLine.h"
 
 using namespace llvm;
 
@@ -24,16 +28,34 @@ using RP = RegisterPass<T>;
 static RP<SerializeModelPass>
   X("serialize-model", "Serialize the model", true, true);
 
+static auto Encodings = cl::values(clEnumValN(ModelEncoding::YAML,
+                                              "yaml",
+                                              "human readable YAML"),
+                                   clEnumValN(ModelEncoding::Binary,
+                                              "binary",
+                                              "compact binary encoding, "
+                                              "faster to load"));
+static cl::opt<ModelEncoding::Values> Encoding("model-encoding",
+                                               cl::desc("encoding of the "
+                                                        "serialized model"),
+                                               Encodings,
+                                               cl::cat(MainCategory),
+                                               cl::init(ModelEncoding::YAML));
+
 void SerializeModelPass::writeModel(model::Binary &Model, llvm::Module &M) {
 
   NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
-  revng_check(not NamedMD, "The model has alread been serialized");
+  revng_check(not NamedMD, "The model has already been serialized");
 
   std::string Buffer;
   {
     llvm::raw_string_ostream Stream(Buffer);
-    yaml::Output YAMLOutput(Stream);
-    YAMLOutput << Model;
+    if (Encoding == ModelEncoding::Binary) {
+      tupletree::binary::serialize(Stream, Model);
+    } else {
+      yaml::Output YAMLOutput(Stream);
+      YAMLOutput << Model;
+    }
   }
 
   LLVMContext &Context = M.getContext();
@@ -44,8 +66,39 @@ void SerializeModelPass::writeModel(model::Binary &Model, llvm::Module &M) {
 }
 
 bool SerializeModelPass::runOnModule(Module &M) {
+  auto &LMP = getAnalysis<LoadModelPass>();
+  model::Binary &Model = LMP.getWriteableModel();
+  const model::Binary *Original = LMP.getOriginalModel();
+  ArrayRef<MDNode *> Serialized = LMP.getSerializedModel();
+
+  // Rewrite the full model if diffs are disabled or too many have piled up
+  if (Original == nullptr or Serialized.empty()
+      or Serialized.size() > MaxModelDiffs) {
+    writeModel(Model, M);
+    return false;
+  }
+
+  revng_check(not M.getNamedMetadata(ModelMetadataName),
+              "The model has already been serialized");
+
+  // Keep what we loaded and append what changed since then
+  NamedMDNode *NamedMD = M.getOrInsertNamedMetadata(ModelMetadataName);
+  for (MDNode *Operand : Serialized)
+    NamedMD->addOperand(Operand);
+
+  auto Diff = diff(const_cast<model::Binary &>(*Original), Model);
+  if (Diff.Changes.empty())
+    return false;
+
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream Stream(Buffer);
+    tupletreediff::binary::serialize(Stream, Diff);
+  }
 
-  writeModel(getAnalysis<LoadModelPass>().getWriteableModel(), M);
+  LLVMContext &Context = M.getContext();
+  auto Tuple = MDTuple::get(Context, { MDString::get(Context, Buffer) });
+  NamedMD->addOperand(Tuple);
 
   return false;
 }
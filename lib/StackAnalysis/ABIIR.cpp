@@ -15,18 +15,18 @@ namespace StackAnalysis {
 void ABIFunction::finalize() {
   revng_assert(Calls.empty());
 
-  for (auto &P : BBMap) {
+  for (ABIIRBasicBlock *BB : BBs) {
     // Build backward links
-    for (ABIIRBasicBlock *Successor : P.second.Successors)
-      Successor->Predecessors.push_back(&P.second);
+    for (ABIIRBasicBlock *Successor : BB->Successors)
+      Successor->Predecessors.push_back(BB);
 
-    if (P.second.successor_size() == 0)
-      FinalBBs.push_back(&P.second);
+    if (BB->successor_size() == 0)
+      FinalBBs.push_back(BB);
 
     // Find all the function calls
-    for (ABIIRInstruction &I : P.second)
+    for (ABIIRInstruction &I : *BB)
       if (I.isCall())
-        Calls.emplace_back(&P.second, &I);
+        Calls.emplace_back(BB, &I);
   }
 
   // The entry point should not have predecessors
@@ -50,24 +50,23 @@ void ABIFunction::finalize() {
     }
 
     std::set<ABIIRBasicBlock *> Visited = ToVisit.visited();
-    {
-      auto IsUnreachable = [&Visited](ABIIRBasicBlock *Block) {
-        return Visited.count(Block) == 0;
-      };
-      std::erase_if(FinalBBs, IsUnreachable);
-    }
-    {
-      auto IsUnreachable = [&Visited](decltype(BBMap)::value_type &Block) {
-        return Visited.count(&Block.second) == 0;
-      };
-      std::erase_if(BBMap, IsUnreachable);
-    }
+    auto IsUnreachable = [&Visited](ABIIRBasicBlock *Block) {
+      return Visited.count(Block) == 0;
+    };
+    std::erase_if(FinalBBs, IsUnreachable);
+
+    // Unreachable blocks are simply forgotten, their storage is released
+    // together with the rest of the arena
+    for (ABIIRBasicBlock *Block : BBs)
+      if (IsUnreachable(Block))
+        BBMap.erase(Block->basicBlock());
+    std::erase_if(BBs, IsUnreachable);
   }
 }
 
 bool ABIFunction::verify() const {
-  for (auto &P : BBMap) {
-    const ABIIRBasicBlock &BB = P.second;
+  for (const ABIIRBasicBlock *Block : BBs) {
+    const ABIIRBasicBlock &BB = *Block;
 
     for (auto &Successor : BB.successors()) {
       auto SuccessorPredecessors = Successor->predecessors();
@@ -92,22 +91,38 @@ bool ABIFunction::verify() const {
   return true;
 }
 
-std::set<int32_t> ABIFunction::writtenRegisters() const {
-  std::set<int32_t> WrittenRegisters;
+LazySmallBitVector ABIFunction::writtenRegisters() const {
+  LazySmallBitVector WrittenRegisters;
 
-  for (const auto &P : BBMap)
-    for (const ABIIRInstruction &I : P.second)
-      if (I.isStore() and I.target().addressSpace() == ASID::cpuID())
-        WrittenRegisters.insert(I.target().offset());
+  for (const ABIIRBasicBlock *BB : BBs) {
+    for (const ABIIRInstruction &I : *BB) {
+      if (I.isStore() and I.target().addressSpace() == ASID::cpuID()) {
+        revng_assert(I.target().offset() >= 0);
+        WrittenRegisters.set(I.target().offset());
+      }
+    }
+  }
 
   return WrittenRegisters;
 }
 
 std::set<FunctionCall> ABIFunction::incoherentCalls() {
   std::vector<ABIIRBasicBlock *> Extremals;
-  for (auto &P : BBMap)
-    if (P.second.successor_size() == 0)
-      Extremals.push_back(&P.second);
+  bool HasStackArguments = false;
+  for (ABIIRBasicBlock *BB : BBs) {
+    if (BB->successor_size() == 0)
+      Extremals.push_back(BB);
+
+    for (const ABIIRInstruction &I : *BB)
+      if (I.opcode() == ABIIRInstruction::DirectCall
+          and I.stackArguments().size() != 0)
+        HasStackArguments = true;
+  }
+
+  // Only calls with stack arguments can be incoherent, most functions have
+  // none: don't bother running the analysis
+  if (not HasStackArguments)
+    return {};
 
   return computeIncoherentCalls(entry(), Extremals);
 }
@@ -123,8 +138,8 @@ void ABIFunction::dumpDot() const {
 
   dbg << "digraph ABIFunction {\n";
 
-  for (auto &P : BBMap) {
-    const ABIIRBasicBlock &BB = P.second;
+  for (const ABIIRBasicBlock *Block : BBs) {
+    const ABIIRBasicBlock &BB = *Block;
     dbg << "\"" << getName(BB.basicBlock()) << "\" [";
     dbg << "label=\"" << getName(BB.basicBlock()) << " ";
 
@@ -6,8 +6,10 @@
 
 #include <stack>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 
 #include "revng/ADT/Queue.h"
 
@@ -316,10 +318,16 @@ public:
   using returns_const_range = llvm::iterator_range<returns_const_iterator>;
 
 private:
-  /// Storage for ABI IR basic blocks, associated to their original counterpart
+  /// Arena for the ABI IR basic blocks, released all at once
   ///
   /// \note Don't move after Entry
-  std::map<llvm::BasicBlock *, ABIIRBasicBlock> BBMap;
+  llvm::SpecificBumpPtrAllocator<ABIIRBasicBlock> Allocator;
+
+  /// All the (reachable) ABI IR basic blocks, in creation order
+  std::vector<ABIIRBasicBlock *> BBs;
+
+  /// Map from the original basic blocks to their ABI IR counterpart
+  llvm::DenseMap<llvm::BasicBlock *, ABIIRBasicBlock *> BBMap;
 
   /// Pointer to the entry basic block of this function
   llvm::BasicBlock *Entry;
@@ -332,20 +340,20 @@ private:
   returns_container FinalBBs;
 
 public:
-  ABIFunction(llvm::BasicBlock *Entry) :
-    Entry(Entry),
-    IREntry(&BBMap.emplace(Entry, ABIIRBasicBlock(Entry)).first->second) {}
+  ABIFunction(llvm::BasicBlock *Entry) : Entry(Entry), IREntry(&get(Entry)) {}
 
   ABIIRBasicBlock *entry() const { return IREntry; }
 
-  size_t size() const { return BBMap.size(); }
+  size_t size() const { return BBs.size(); }
 
   /// \brief Purge all the data in this IR
   void reset() {
     BBMap.clear();
+    BBs.clear();
+    Allocator.DestroyAll();
     Calls.clear();
     FinalBBs.clear();
-    IREntry = &BBMap.emplace(Entry, ABIIRBasicBlock(Entry)).first->second;
+    IREntry = &get(Entry);
   }
 
   /// \brief Finalize the IR after initially populating it
@@ -358,20 +366,22 @@ public:
   /// \brief Identify calls leading to contradition
   std::set<FunctionCall> incoherentCalls();
 
-  std::set<int32_t> writtenRegisters() const;
+  LazySmallBitVector writtenRegisters() const;
 
   ABIIRBasicBlock &get(llvm::BasicBlock *BB) {
-    auto It = BBMap.find(BB);
-    if (It != BBMap.end())
-      return It->second;
+    ABIIRBasicBlock *&Result = BBMap[BB];
+    if (Result == nullptr) {
+      Result = new (Allocator.Allocate()) ABIIRBasicBlock(BB);
+      BBs.push_back(Result);
+    }
 
-    return BBMap.emplace(BB, ABIIRBasicBlock(BB)).first->second;
+    return *Result;
   }
 
   const ABIIRBasicBlock &get(llvm::BasicBlock *BB) const {
     auto It = BBMap.find(BB);
     revng_assert(It != BBMap.end());
-    return It->second;
+    return *It->second;
   }
 
   calls_const_range calls() const {
@@ -398,9 +408,9 @@ public:
     std::set<const ABIIRBasicBlock *> Visited;
     std::set<const ABIIRBasicBlock *> Entries;
 
-    for (auto &P : BBMap)
-      if (P.second.predecessor_size() == 0)
-        Entries.insert(&P.second);
+    for (const ABIIRBasicBlock *BB : BBs)
+      if (BB->predecessor_size() == 0)
+        Entries.insert(BB);
 
     for (const ABIIRBasicBlock *BB : Entries) {
       if (Visited.count(BB) != 0)
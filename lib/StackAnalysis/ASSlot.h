@@ -4,8 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <limits>
 
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Module.h"
 
@@ -116,6 +119,8 @@ public:
 
 /// \brief Class representing the address of an address space slot
 class ASSlot {
+  friend struct llvm::DenseMapInfo<ASSlot>;
+
 private:
   ASID AS;
   int32_t Offset;
@@ -139,17 +144,21 @@ public:
 
   size_t hash() const;
 
-  bool operator==(const ASSlot &Other) const {
-    return std::tie(AS, Offset) == std::tie(Other.AS, Other.Offset);
+  /// \brief Pack this slot in a single word
+  ///
+  /// The address space goes in the upper half and the offset, biased to be
+  /// unsigned, in the lower half, so that keys sort as (address space, offset)
+  /// pairs.
+  uint64_t key() const {
+    uint32_t BiasedOffset = static_cast<uint32_t>(Offset) ^ (1U << 31);
+    return (static_cast<uint64_t>(AS.id()) << 32) | BiasedOffset;
   }
 
+  bool operator==(const ASSlot &Other) const { return key() == Other.key(); }
+
   bool operator!=(const ASSlot &Other) const { return not(*this == Other); }
 
-  bool operator<(const ASSlot &Other) const {
-    auto ThisTuple = std::make_pair(AS.id(), Offset);
-    auto OtherTuple = std::make_pair(Other.AS.id(), Other.Offset);
-    return ThisTuple < OtherTuple;
-  }
+  bool operator<(const ASSlot &Other) const { return key() < Other.key(); }
 
   int32_t offset() const { return Offset; }
   ASID addressSpace() const { return AS; }
@@ -221,8 +230,76 @@ private:
   }
 };
 
+/// \brief Set of ASSlot, stored as a sorted vector
+///
+/// Slots are usually collected walking address spaces in order, in which case
+/// insertion simply appends.
+class ASSlotSet {
+public:
+  using container = llvm::SmallVector<ASSlot, 8>;
+  using const_iterator = container::const_iterator;
+
+private:
+  container Entries;
+
+public:
+  const_iterator begin() const { return Entries.begin(); }
+  const_iterator end() const { return Entries.end(); }
+
+  size_t size() const { return Entries.size(); }
+  bool empty() const { return Entries.empty(); }
+
+  size_t count(ASSlot Key) const {
+    auto It = std::lower_bound(Entries.begin(), Entries.end(), Key);
+    return (It != Entries.end() and *It == Key) ? 1 : 0;
+  }
+
+  void insert(ASSlot Key) {
+    if (Entries.empty() or Entries.back() < Key) {
+      Entries.push_back(Key);
+      return;
+    }
+
+    auto It = std::lower_bound(Entries.begin(), Entries.end(), Key);
+    if (*It != Key)
+      Entries.insert(It, Key);
+  }
+
+  bool operator==(const ASSlotSet &Other) const {
+    return Entries == Other.Entries;
+  }
+
+  bool operator!=(const ASSlotSet &Other) const { return not(*this == Other); }
+};
+
 } // namespace StackAnalysis
 
+namespace llvm {
+
+template<>
+struct DenseMapInfo<StackAnalysis::ASSlot> {
+  using ASSlot = StackAnalysis::ASSlot;
+  using ASID = StackAnalysis::ASID;
+
+  static ASSlot getEmptyKey() {
+    return ASSlot(ASID::invalidID(), std::numeric_limits<int32_t>::max());
+  }
+
+  static ASSlot getTombstoneKey() {
+    return ASSlot(ASID::invalidID(), std::numeric_limits<int32_t>::min());
+  }
+
+  static unsigned getHashValue(const ASSlot &Slot) {
+    return DenseMapInfo<uint64_t>::getHashValue(Slot.key());
+  }
+
+  static bool isEqual(const ASSlot &LHS, const ASSlot &RHS) {
+    return LHS == RHS;
+  }
+};
+
+} // namespace llvm
+
 namespace std {
 
 template<>
@@ -31,6 +31,8 @@ using llvm::User;
 static Logger<> SaPreprocess("sa-preprocess");
 Logger<> SaLog("sa");
 
+static MemoryGauge SAMemory("StackAnalysis");
+
 namespace StackAnalysis {
 
 /// \brief Check it two loads are equivalent (load from same CSV, no stores in
@@ -307,28 +309,26 @@ void Cache::assignCPUIndices(Function *F, GeneratedCodeBasicInfo *GCBI) {
   IndexToCSVMap.clear();
 
   // Skip 0, keep it as "invalid value"
-  int32_t I = 1;
+  IndexToCSVMap.push_back(nullptr);
 
-  IndexToCSVMap[I++] = GCBI->pcReg();
+  IndexToCSVMap.push_back(GCBI->pcReg());
 
   // Go through global variables first
   for (llvm::GlobalVariable *GV : GCBI->abiRegisters())
-    IndexToCSVMap[I++] = GV;
+    IndexToCSVMap.push_back(GV);
 
-  CSVCount = I;
+  CSVCount = IndexToCSVMap.size();
 
   // Look for AllocaInst at the beginning of the root function
   llvm::BasicBlock *Entry = &*F->begin();
   auto It = Entry->begin();
   while (It != Entry->end() and isa<AllocaInst>(&*It)) {
-    IndexToCSVMap[I] = &*It;
-
-    I++;
+    IndexToCSVMap.push_back(&*It);
     It++;
   }
 
-  for (auto &P : IndexToCSVMap)
-    CSVToIndexMap[P.second] = P.first;
+  for (int32_t I = 1; I < static_cast<int32_t>(IndexToCSVMap.size()); I++)
+    CSVToIndexMap[IndexToCSVMap[I]] = I;
 }
 
 Cache::Cache(Function *F, GeneratedCodeBasicInfo *GCBI) :
@@ -363,6 +363,10 @@ Cache::get(BasicBlock *Function) const {
   return Optional<const IntraproceduralFunctionSummary *>();
 }
 
+Cache::~Cache() {
+  SAMemory.add(-static_cast<int64_t>(Accounted));
+}
+
 bool Cache::update(BasicBlock *Function,
                    const IntraproceduralFunctionSummary &Result) {
 
@@ -372,9 +376,13 @@ bool Cache::update(BasicBlock *Function,
     SaLog << DoLog;
   }
 
+  uint64_t NewFootprint = Result.FinalState.footprint();
+
   auto It = Results.find(Function);
   if (It == Results.end()) {
     Results.emplace(std::make_pair(Function, Result.copy()));
+    Accounted += NewFootprint;
+    SAMemory.add(NewFootprint);
     return false;
   } else {
     auto &Summary = It->second;
@@ -389,6 +397,10 @@ bool Cache::update(BasicBlock *Function,
     // temporary top entry, which will be overwritten later on.
     revng_assert(New.lowerThanOrEqual(Old));
 
+    int64_t Delta = NewFootprint - Old.footprint();
+    Accounted += Delta;
+    SAMemory.add(Delta);
+
     It->second = Result.copy();
 
     return not Old.lowerThanOrEqual(New);
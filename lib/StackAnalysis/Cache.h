@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+
 #include "Element.h"
 #include "IntraproceduralFunctionSummary.h"
 
@@ -18,6 +22,14 @@ namespace StackAnalysis {
 /// * the result of the analysis of a function.
 /// * the set of "fake", "noreturn" and "indirect tail call" functions.
 /// * the association between each function and its return register.
+///
+/// \note The cache lives only as long as the analysis. Summaries cannot be
+///       persisted across runs as they are: they are keyed by (and refer to)
+///       `llvm::BasicBlock`s and `llvm::Instruction`s of the current module,
+///       and their slots use CPU indices assigned by assignCPUIndices, which
+///       depend on the order of the CSVs in the module. Moreover, the body of
+///       a function is only discovered while analyzing it, so there is no
+///       stable "lifted IR of the function" to hash upfront.
 class Cache {
 private:
   /// \brief For each function, the result of the intraprocedural analysis
@@ -34,28 +46,57 @@ private:
   std::set<llvm::BasicBlock *> NoReturnFunctions;
   std::set<llvm::BasicBlock *> IndirectTailCallFunctions;
 
+  /// \brief Functions whose analysis exhausted its visits budget
+  std::set<llvm::BasicBlock *> GivenUpFunctions;
+
   std::set<const llvm::LoadInst *> IdentityLoads;
   std::set<const llvm::StoreInst *> IdentityStores;
 
-  std::map<const llvm::User *, int32_t> CSVToIndexMap;
-  std::map<int32_t, llvm::User *> IndexToCSVMap;
+  llvm::DenseMap<const llvm::User *, int32_t> CSVToIndexMap;
+  /// \brief CSVs and allocas indexed by CPU index (index 0 is invalid)
+  std::vector<llvm::User *> IndexToCSVMap;
   int32_t CSVCount;
 
+  /// \brief Footprint of the final states in Results, as reported to the
+  ///        memory gauge
+  uint64_t Accounted = 0;
+
 public:
   /// \brief Identify default storage for link register, identity loads
   Cache(llvm::Function *F, GeneratedCodeBasicInfo *GCBI);
+  ~Cache();
 
-  int32_t getCPUIndex(const llvm::User *U) const { return CSVToIndexMap.at(U); }
-  bool isCPU(const llvm::User *U) const { return CSVToIndexMap.count(U) != 0; }
-  bool isCSV(const llvm::User *U) const {
-    return CSVToIndexMap.count(U) != 0 and CSVToIndexMap.at(U) < CSVCount;
+  Cache(const Cache &) = delete;
+  Cache &operator=(const Cache &) = delete;
+
+  /// \brief Return the CPU index of \p U, if \p U is part of the CPU state
+  llvm::Optional<int32_t> findCPUIndex(const llvm::User *U) const {
+    auto It = CSVToIndexMap.find(U);
+    if (It == CSVToIndexMap.end())
+      return llvm::Optional<int32_t>();
+    return It->second;
   }
-  llvm::GlobalVariable *getCSVByIndex(int32_t I) const {
-    return llvm::cast<llvm::GlobalVariable>(IndexToCSVMap.at(I));
+
+  /// \brief Return the CPU index of \p U, if \p U is a CSV
+  llvm::Optional<int32_t> findCSVIndex(const llvm::User *U) const {
+    llvm::Optional<int32_t> Result = findCPUIndex(U);
+    if (Result and *Result >= CSVCount)
+      return llvm::Optional<int32_t>();
+    return Result;
   }
-  bool isCSVIndex(int32_t I) const {
-    return IndexToCSVMap.count(I) != 0 and I < CSVCount;
+
+  int32_t getCPUIndex(const llvm::User *U) const {
+    llvm::Optional<int32_t> Result = findCPUIndex(U);
+    revng_assert(Result);
+    return *Result;
+  }
+  bool isCPU(const llvm::User *U) const { return CSVToIndexMap.count(U) != 0; }
+  bool isCSV(const llvm::User *U) const { return findCSVIndex(U).hasValue(); }
+  llvm::GlobalVariable *getCSVByIndex(int32_t I) const {
+    revng_assert(I > 0 and static_cast<size_t>(I) < IndexToCSVMap.size());
+    return llvm::cast<llvm::GlobalVariable>(IndexToCSVMap[I]);
   }
+  bool isCSVIndex(int32_t I) const { return I > 0 and I < CSVCount; }
 
   bool isFakeFunction(llvm::BasicBlock *Function) const {
     return FakeFunctions.count(Function) != 0;
@@ -73,6 +114,16 @@ public:
     NoReturnFunctions.insert(Function);
   }
 
+  /// \brief Nothing is known about a given up function: calls to it are
+  ///        handled as indirect function calls
+  bool isGivenUpFunction(llvm::BasicBlock *Function) const {
+    return GivenUpFunctions.count(Function) != 0;
+  }
+
+  void markAsGivenUp(llvm::BasicBlock *Function) {
+    GivenUpFunctions.insert(Function);
+  }
+
   /// \brief Query the cache for the result of the analysis for a specific
   ///        function
   ///
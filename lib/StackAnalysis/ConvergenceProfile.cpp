@@ -0,0 +1,71 @@
+/// \file ConvergenceProfile.cpp
+/// \brief Options controlling the convergence profiles of the stack analysis
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/Twine.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/IRHelpers.h"
+
+#include "ConvergenceProfile.h"
+
+namespace cl = llvm::cl;
+
+static cl::list<std::string> ProfiledFunctions("sa-profile",
+                                               cl::desc("profile the "
+                                                        "convergence of the "
+                                                        "stack and ABI "
+                                                        "analyses of the "
+                                                        "functions with these "
+                                                        "entry blocks"),
+                                               cl::value_desc("bb.0x..."),
+                                               cl::CommaSeparated,
+                                               cl::cat(MainCategory));
+
+static cl::opt<std::string> ProfilePrefix("sa-profile-prefix",
+                                          cl::desc("prefix of the files "
+                                                   "where the profiles "
+                                                   "requested with "
+                                                   "-sa-profile are written"),
+                                          cl::value_desc("prefix"),
+                                          cl::init("sa-profile"),
+                                          cl::cat(MainCategory));
+
+namespace StackAnalysis {
+
+bool shouldProfileConvergence(const llvm::BasicBlock *Entry) {
+  if (ProfiledFunctions.empty())
+    return false;
+
+  std::string Name = getName(Entry);
+  for (const std::string &Function : ProfiledFunctions)
+    if (Function == Name)
+      return true;
+
+  return false;
+}
+
+std::unique_ptr<llvm::raw_ostream>
+openConvergenceProfile(const llvm::BasicBlock *Entry,
+                       llvm::StringRef Analysis,
+                       llvm::StringRef Extension) {
+  std::string Path = (llvm::Twine(ProfilePrefix) + "-" + getName(Entry) + "-"
+                      + Analysis + Extension)
+                       .str();
+
+  std::error_code EC;
+  auto Result = std::make_unique<llvm::raw_fd_ostream>(Path,
+                                                       EC,
+                                                       llvm::sys::fs::OF_Text);
+  revng_check(not EC, "Cannot open the convergence profile file");
+  return Result;
+}
+
+} // namespace StackAnalysis
@@ -0,0 +1,46 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/MonotoneFramework.h"
+
+namespace llvm {
+class BasicBlock;
+}
+
+namespace StackAnalysis {
+
+/// \brief Should the analyses of the function starting at \p Entry be
+///        profiled?
+///
+/// \see -sa-profile
+bool shouldProfileConvergence(const llvm::BasicBlock *Entry);
+
+/// \brief Open the file where the profile of \p Analysis on the function
+///        starting at \p Entry is written, ending with \p Extension
+std::unique_ptr<llvm::raw_ostream>
+openConvergenceProfile(const llvm::BasicBlock *Entry,
+                       llvm::StringRef Analysis,
+                       llvm::StringRef Extension);
+
+/// \brief Write \p Profile of \p Analysis on the function starting at
+///        \p Entry as a DOT heat map, along with the work list sizes
+template<typename Label, typename F>
+inline void
+writeConvergenceProfile(const MonotoneFrameworkProfile<Label> &Profile,
+                        const llvm::BasicBlock *Entry,
+                        llvm::StringRef Analysis,
+                        F GetName) {
+  Profile.dumpDot(*openConvergenceProfile(Entry, Analysis, ".dot"), GetName);
+  auto WorkList = openConvergenceProfile(Entry, Analysis, "-worklist.csv");
+  Profile.dumpWorkListSizes(*WorkList);
+}
+
+} // namespace StackAnalysis
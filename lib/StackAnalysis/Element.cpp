@@ -49,7 +49,7 @@ unsigned ASSlot::cmp(const ASSlot &Other, const Module *M) const {
 }
 
 size_t ASSlot::hash() const {
-  return combineHash(std::hash<ASID>()(AS), std::hash<int32_t>()(Offset));
+  return std::hash<uint64_t>()(key());
 }
 
 namespace Intraprocedural {
@@ -114,11 +114,15 @@ unsigned AddressSpace::cmp(const AddressSpace &Other, const Module *M) const {
   LoggerIndent<> Y(SaDiffLog);
   unsigned Result = 0;
 
-  for (auto &P : ASOContent) {
-    auto It = Other.ASOContent.find(P.first);
+  // Shared content is trivially equal
+  if (sharesContentWith(Other))
+    return Result;
+
+  for (auto &P : content()) {
+    auto It = Other.content().find(P.first);
 
     // Check if Other has it
-    if (It != Other.ASOContent.end()) {
+    if (It != Other.content().end()) {
       // Check the actual value
       ROA((P.second.cmp<Diff, EarlyExit>(It->second, M)), {
         slot(P.first).dump(M, SaDiffLog);
@@ -127,10 +131,10 @@ unsigned AddressSpace::cmp(const AddressSpace &Other, const Module *M) const {
     }
   }
 
-  for (auto &P : Other.ASOContent) {
-    auto It = ASOContent.find(P.first);
+  for (auto &P : Other.content()) {
+    auto It = content().find(P.first);
     // TODO: assert this matters in the PruneLog
-    ROA(It == ASOContent.end() && P.second.hasDirectContent(), {
+    ROA(It == content().end() && P.second.hasDirectContent(), {
       slot(P.first).dump(M, SaDiffLog);
       SaDiffLog << " is absent in the LHS and has direct content on the";
       revng_log(SaDiffLog, " RHS");
@@ -143,7 +147,7 @@ unsigned AddressSpace::cmp(const AddressSpace &Other, const Module *M) const {
 size_t AddressSpace::hash() const {
   size_t Result = 0;
 
-  for (auto &P : ASOContent) {
+  for (auto &P : content()) {
     Result = combineHash(Result, P.first);
     Result = combineHash(Result, std::hash<Value>()(P.second));
   }
@@ -151,12 +155,12 @@ size_t AddressSpace::hash() const {
   return Result;
 }
 
-std::set<ASSlot> Element::collectSlots(int32_t CSVCount) const {
+ASSlotSet Element::collectSlots(int32_t CSVCount) const {
   ASID CPU = ASID::cpuID();
-  std::set<ASSlot> SlotsPool;
+  ASSlotSet SlotsPool;
 
   if (State.size() > CPU.id())
-    for (auto &P : State[CPU.id()].ASOContent)
+    for (auto &P : State[CPU.id()].content())
       if (P.first < CSVCount)
         SlotsPool.insert(ASSlot::create(CPU, P.first));
 
@@ -218,14 +222,21 @@ Element &Element::combine(const Element &Other) {
 
 void Element::cleanup() {
   for (AddressSpace &AS : State) {
-    for (auto It = AS.ASOContent.begin(); It != AS.ASOContent.end(); /**/) {
-      if (const ASSlot *TheTag = It->second.tag()) {
-        if (*TheTag == ASSlot::create(AS.ID, It->first)) {
-          It = AS.ASOContent.erase(It);
-          continue;
-        }
-      }
-      It++;
+    auto IsInitialValue = [&AS](const std::pair<const int32_t, Value> &P) {
+      const ASSlot *TheTag = P.second.tag();
+      return TheTag != nullptr and *TheTag == ASSlot::create(AS.ID, P.first);
+    };
+
+    // Avoid unsharing the content if there's nothing to remove
+    if (llvm::none_of(AS.content(), IsInitialValue))
+      continue;
+
+    AddressSpace::Container &Content = AS.mutableContent();
+    for (auto It = Content.begin(); It != Content.end(); /**/) {
+      if (IsInitialValue(*It))
+        It = Content.erase(It);
+      else
+        It++;
     }
   }
 }
@@ -235,19 +246,19 @@ void Element::apply(const Element &Other) {
 
   ASID CPU = ASID::cpuID();
   const AddressSpace &OtherCPU = Other.State[CPU.id()];
-  for (auto &P : OtherCPU.ASOContent)
+  for (auto &P : OtherCPU.content())
     store(Value::fromSlot(CPU, P.first), P.second);
 }
 
-std::set<ASSlot> Element::computeCalleeSavedSlots() const {
-  std::set<ASSlot> Result;
+ASSlotSet Element::computeCalleeSavedSlots() const {
+  ASSlotSet Result;
 
   // Look in the stack leftovers
   uint32_t CPUID = ASID::cpuID().id();
   uint32_t StackID = ASID::stackID().id();
   if (State.size() > StackID and State.size() > CPUID) {
-    std::set<ASSlot> StackLeftovers;
-    for (auto &P : State[StackID].ASOContent) {
+    ASSlotSet StackLeftovers;
+    for (auto &P : State[StackID].content()) {
       // Do we have direct content with a name?
       if (const ASSlot *T = P.second.tag()) {
         // Is the tag referreing to a CSV?
@@ -256,7 +267,7 @@ std::set<ASSlot> Element::computeCalleeSavedSlots() const {
       }
     }
 
-    for (auto &P : State[CPUID].ASOContent) {
+    for (auto &P : State[CPUID].content()) {
       // Do we have direct content with a name?
       if (const ASSlot *T = P.second.tag()) {
         // Is the name the same as the current slot?
@@ -277,11 +288,18 @@ void Element::mergeASState(AddressSpace &ThisState,
   // pair of <ASO, *> pairs. In particular, instead of a std::map we could use
   // a sorted std::vector of pairs.
 
+  // Merging an address space with itself is a no-op
+  if (ThisState.sharesContentWith(OtherState))
+    return;
+
+  AddressSpace::Container &ThisMap = ThisState.mutableContent();
+  const AddressSpace::Container &OtherMap = OtherState.content();
+
   // Iterate in parallel
-  auto ThisIt = ThisState.ASOContent.begin();
-  auto ThisEndIt = ThisState.ASOContent.end();
-  auto OtherIt = OtherState.ASOContent.begin();
-  auto OtherEndIt = OtherState.ASOContent.end();
+  auto ThisIt = ThisMap.begin();
+  auto ThisEndIt = ThisMap.end();
+  auto OtherIt = OtherMap.begin();
+  auto OtherEndIt = OtherMap.end();
   std::vector<std::pair<int32_t, Value>> NewEntries;
 
   bool ThisDone = ThisIt == ThisEndIt;
@@ -331,7 +349,7 @@ void Element::mergeASState(AddressSpace &ThisState,
   }
 
   for (std::pair<int32_t, Value> &P : NewEntries)
-    ThisState.ASOContent[P.first] = P.second;
+    ThisMap[P.first] = P.second;
 }
 
 } // namespace Intraprocedural
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <memory>
 #include <set>
 
 #include "revng/ADT/LazySmallBitVector.h"
@@ -139,6 +141,10 @@ public:
 ///
 /// An address space is composed by a set of <Offset, Value> pairs recording
 /// what are the possible values of the slot at the given offset.
+///
+/// The content is copy-on-write: copies of an AddressSpace share the same
+/// container until one of them is modified. This makes copying an Element
+/// cheap and lets comparisons between unchanged address spaces short-circuit.
 class AddressSpace {
   friend class Element;
 
@@ -149,26 +155,30 @@ private:
   /// Address space identifier
   ASID ID;
   /// Map associating an offset within the address space with a Value
-  Container ASOContent;
+  std::shared_ptr<Container> ASOContent;
 
 public:
-  AddressSpace(ASID ID) : ID(ID) {}
+  AddressSpace(ASID ID) : ID(ID), ASOContent(std::make_shared<Container>()) {}
 
   AddressSpace(const AddressSpace &) = default;
   AddressSpace &operator=(const AddressSpace &) = default;
   AddressSpace(AddressSpace &&) = default;
   AddressSpace &operator=(AddressSpace &&) = default;
 
-  ~AddressSpace() { AddressSpaceSizeStats.push(ASOContent.size()); }
+  ~AddressSpace() {
+    if (ASOContent)
+      AddressSpaceSizeStats.push(ASOContent->size());
+  }
 
   using ASOContentIt = Container::iterator;
   ASOContentIt eraseASO(ASOContentIt It) {
     revng_assert(!It->second.hasDirectContent());
-    return ASOContent.erase(It);
+    revng_assert(ASOContent.use_count() == 1);
+    return ASOContent->erase(It);
   }
 
   bool operator==(const AddressSpace &Other) const {
-    return ASOContent == Other.ASOContent;
+    return sharesContentWith(Other) or *ASOContent == *Other.ASOContent;
   }
 
   bool operator!=(const AddressSpace &Other) const { return !(*this == Other); }
@@ -181,15 +191,17 @@ public:
 
   size_t hash() const;
 
-  bool contains(int32_t Offset) const { return ASOContent.count(Offset) != 0; }
+  bool contains(int32_t Offset) const {
+    return ASOContent->count(Offset) != 0;
+  }
 
-  void set(int32_t Offset, Value V) { ASOContent[Offset] = V; }
+  void set(int32_t Offset, Value V) { mutableContent()[Offset] = V; }
 
   ASID id() const { return ID; }
   ASSlot slot(int32_t Offset) const { return ASSlot::create(ID, Offset); }
 
-  Container::const_iterator begin() const { return ASOContent.begin(); }
-  Container::const_iterator end() const { return ASOContent.end(); }
+  Container::const_iterator begin() const { return ASOContent->begin(); }
+  Container::const_iterator end() const { return ASOContent->end(); }
 
   /// \brief Handle loading from a specific slot
   Value load(ASSlot Address) const {
@@ -207,7 +219,7 @@ public:
   }
 
   /// \brief Return the number of slots available in this state
-  size_t size() const { return ASOContent.size(); }
+  size_t size() const { return ASOContent->size(); }
 
   bool verify(ASID StateID) const { return StateID == ID; }
 
@@ -218,7 +230,7 @@ public:
     ID.dump(Output);
     Output << ":";
 
-    for (auto &P : ASOContent) {
+    for (auto &P : *ASOContent) {
       Output << "\n    ";
       ASSlot::dumpOffset(M, ID, P.first, Output);
       Output << ": ";
@@ -228,12 +240,32 @@ public:
 
 private:
   const Value *get(int32_t Offset) const {
-    auto It = ASOContent.find(Offset);
-    if (It == ASOContent.end())
+    auto It = ASOContent->find(Offset);
+    if (It == ASOContent->end())
       return nullptr;
     else
       return &It->second;
   }
+
+  const Container &content() const { return *ASOContent; }
+
+  /// \brief Obtain the content for writing, unsharing it if necessary
+  Container &mutableContent() {
+    if (ASOContent.use_count() > 1)
+      ASOContent = std::make_shared<Container>(*ASOContent);
+    return *ASOContent;
+  }
+
+  bool sharesContentWith(const AddressSpace &Other) const {
+    return ASOContent == Other.ASOContent;
+  }
+
+  /// \brief If the content of \p Other is equal to ours, share it
+  void deduplicateWith(const AddressSpace &Other) {
+    if (ID == Other.ID and not sharesContentWith(Other)
+        and *ASOContent == *Other.ASOContent)
+      ASOContent = Other.ASOContent;
+  }
 };
 
 /// \brief Represents an element of the lattice of the stack analysis
@@ -256,6 +288,18 @@ public:
   /// \brief Create a bottom element, which tracks nothing
   static Element bottom() { return Element(); }
 
+  /// \brief Approximate number of bytes taken by this element
+  ///
+  /// \note The address spaces shared with other elements are accounted in
+  ///       full.
+  uint64_t footprint() const {
+    uint64_t Result = sizeof(Element) + nodeFootprint(FrameSizeAtCallSite);
+    for (const AddressSpace &AS : State)
+      if (AS.ASOContent)
+        Result += nodeFootprint(*AS.ASOContent);
+    return Result;
+  }
+
   /// \brief Create a regular element, which tracks the CPU and stack state
   static Element initial() {
     Element Result;
@@ -283,6 +327,17 @@ public:
     return Result;
   }
 
+  /// \brief Share the content of each address space with the corresponding
+  ///        one in \p Other, if they are equal
+  ///
+  /// Use this on elements to be kept around for a long time, so that only one
+  /// copy of the identical parts is kept in memory.
+  void deduplicateWith(const Element &Other) {
+    size_t Count = std::min(State.size(), Other.State.size());
+    for (size_t I = 0; I < Count; I++)
+      State[I].deduplicateWith(Other.State[I]);
+  }
+
   bool operator==(const Element &Other) const {
     // TODO: we're ignoring FrameSizeAtCallSite
     return State == Other.State;
@@ -315,7 +370,7 @@ public:
   void cleanup();
 
   bool addressSpaceContainsTag(ASID AddressSpace, const ASSlot *TheTag) const {
-    for (auto &P : State[AddressSpace.id()].ASOContent)
+    for (auto &P : State[AddressSpace.id()].content())
       if (P.second.hasTag() && *P.second.tag() == *TheTag)
         return true;
 
@@ -328,7 +383,7 @@ public:
   std::set<int32_t> stackArguments(int32_t CallerStackSize) const {
     std::set<int32_t> Result;
     if (State.size() > 0)
-      for (auto &P : State[ASID::stackID().id()].ASOContent)
+      for (auto &P : State[ASID::stackID().id()].content())
         if (P.first >= 0)
           Result.insert(P.first - CallerStackSize);
 
@@ -388,10 +443,10 @@ public:
   }
 
   /// \brief Collect all the slots about which we have information
-  std::set<ASSlot> collectSlots(int32_t CSVCount) const;
+  ASSlotSet collectSlots(int32_t CSVCount) const;
 
   /// \brief Identify the explicitly callee saved slots
-  std::set<ASSlot> computeCalleeSavedSlots() const;
+  ASSlotSet computeCalleeSavedSlots() const;
 
 private:
   /// \brief Implement the combine for AddressSpace
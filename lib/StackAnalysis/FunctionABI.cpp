@@ -16,6 +16,7 @@
 #include "FunctionABI.h"
 
 #include "ABIIR.h"
+#include "ConvergenceProfile.h"
 
 using std::conditional;
 using std::tuple;
@@ -1194,6 +1195,9 @@ std::set<NodeTy> findMaximalSimplePathTerminatorsOfExitlessSCCs(NodeTy Entry) {
 void FunctionABI::analyze(const ABIFunction &TheFunction) {
   using namespace ABIAnalysis;
   ABIIRBasicBlock *E = TheFunction.entry();
+  const llvm::BasicBlock *EntryBB = E->basicBlock();
+  bool Profile = shouldProfileConvergence(EntryBB);
+  auto GetName = [](ABIIRBasicBlock *BB) { return BB->getName().str(); };
 
   auto InfiniteLoopsExits = findMaximalSimplePathTerminatorsOfExitlessSCCs(E);
 
@@ -1205,6 +1209,12 @@ void FunctionABI::analyze(const ABIFunction &TheFunction) {
     SaABI << DoLog;
   }
 
+  // Note: the forward and backward analyses are independent, but they are run
+  //       one after the other: the loggers, the statistics and the LLVM
+  //       objects they inspect (e.g., value names) are not thread-safe, and
+  //       a thread per function would not be bounded anyway.
+  //       Results are combined forward first, then backward.
+
   {
     revng_log(SaABI, "Running forward function analyses");
 
@@ -1222,6 +1232,10 @@ void FunctionABI::analyze(const ABIFunction &TheFunction) {
 
     Analysis<true, ForwardList> ForwardFunctionAnalyses(E, &InfiniteLoopsExits);
 
+    MonotoneFrameworkProfile<ABIIRBasicBlock *> ForwardProfile;
+    if (Profile)
+      ForwardFunctionAnalyses.setProfile(&ForwardProfile);
+
     ForwardFunctionAnalyses.registerExtremal(E);
 
     ForwardFunctionAnalyses.initialize();
@@ -1234,6 +1248,9 @@ void FunctionABI::analyze(const ABIFunction &TheFunction) {
                 << " on " << TheFunction.size() << " blocks ("
                 << "average: " << Average << ").");
 
+    if (Profile)
+      writeConvergenceProfile(ForwardProfile, EntryBB, "abi-forward", GetName);
+
     this->combine(Result.extractResult());
   }
 
@@ -1249,6 +1266,10 @@ void FunctionABI::analyze(const ABIFunction &TheFunction) {
     using BackwardList = AnalysesList<FunctionWise, FunctionCallWise>;
     Analysis<false, BackwardList> BackwardFunctionAnalyses(E, nullptr);
 
+    MonotoneFrameworkProfile<ABIIRBasicBlock *> BackwardProfile;
+    if (Profile)
+      BackwardFunctionAnalyses.setProfile(&BackwardProfile);
+
     for (ABIIRBasicBlock *FinalBB : TheFunction.finals())
       BackwardFunctionAnalyses.registerExtremal(FinalBB);
 
@@ -1257,6 +1278,13 @@ void FunctionABI::analyze(const ABIFunction &TheFunction) {
 
     BackwardFunctionAnalyses.initialize();
     Interrupt<BackwardList> Result = BackwardFunctionAnalyses.run();
+
+    if (Profile)
+      writeConvergenceProfile(BackwardProfile,
+                              EntryBB,
+                              "abi-backward",
+                              GetName);
+
     this->combine(Result.extractResult());
   }
 }
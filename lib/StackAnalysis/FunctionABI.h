@@ -6,6 +6,7 @@
 
 #include <sstream>
 
+#include "revng/ADT/LazySmallBitVector.h"
 #include "revng/ADT/SmallMap.h"
 #include "revng/ADT/ZipMapIterator.h"
 #include "revng/StackAnalysis/FunctionsSummary.h"
@@ -490,6 +491,11 @@ inline const RegisterArgumentsOfFunctionCall &RegisterState::getByType() const {
   return RAOFC;
 }
 
+// Register states are stored for each register and copied at each ABI
+// transfer, keep them compact
+static_assert(sizeof(CallSiteRegisterState) <= 4, "Unexpectedly large state");
+static_assert(sizeof(RegisterState) <= 8, "Unexpectedly large state");
+
 /// \brief Class to track the ABI, i.e., the status of a register as an
 ///        argument/return value
 class FunctionABI {
@@ -579,19 +585,21 @@ public:
   }
 
   /// \brief Collect all the slots involved in this instance
-  void collectLocalSlots(std::set<ASSlot> &SlotsPool) const {
+  void collectLocalSlots(ASSlotSet &SlotsPool) const {
     for (auto &P : RegisterAnalyses)
       SlotsPool.insert(ASSlot::create(ASID::cpuID(), P.first));
   }
 
-  std::pair<std::set<int32_t>, std::set<int32_t>> collectYesRegisters() const {
-    std::set<int32_t> Arguments;
-    std::set<int32_t> ReturnValues;
+  using RegisterSetPair = std::pair<LazySmallBitVector, LazySmallBitVector>;
+  RegisterSetPair collectYesRegisters() const {
+    LazySmallBitVector Arguments;
+    LazySmallBitVector ReturnValues;
     for (auto &P : RegisterAnalyses) {
+      revng_assert(P.first >= 0);
       if (P.second.isArgument())
-        Arguments.insert(P.first);
+        Arguments.set(P.first);
       if (P.second.isReturnValue())
-        ReturnValues.insert(P.first);
+        ReturnValues.set(P.first);
     }
 
     return { Arguments, ReturnValues };
@@ -31,6 +31,17 @@ static StringIntCounter FunctionAnalysisTime("FunctionAnalysisTime");
 /// \brief Logger for counting how many times a function is analyzed
 static StringIntCounter FunctionAnalysisCount("FunctionAnalysisCount");
 
+/// \brief Logger for counting how many basic blocks are visited in a function
+static StringIntCounter FunctionVisitsCount("FunctionVisitsCount");
+
+/// \brief Logger for the functions that exhausted their visits budget
+static StringIntCounter GivenUpFunctions("GivenUpFunctions");
+
+/// \brief Distribution of the duration, in seconds, of each run of the
+///        intraprocedural analysis
+static RunningStatistics IntraproceduralDuration("IntraproceduralDuration",
+                                                 RecordDistribution());
+
 template<typename T>
 static uint64_t nanoseconds(T Span) {
   return std::chrono::duration_cast<std::chrono::nanoseconds>(Span).count();
@@ -85,13 +96,23 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
     SaInterpLog.indent();
 
     time_point Begin = std::chrono::steady_clock::now();
+    unsigned VisitsBegin = Current.visitsCount();
 
     // Run/continue the intraprocedural analysis
-    Result = Current.run();
+    {
+      ScopedTimer Timer("Intraprocedural::Analysis");
+      Result = Current.run();
+    }
 
     time_point End = std::chrono::steady_clock::now();
+    std::chrono::duration<double> Duration = End - Begin;
+    IntraproceduralDuration.push(Duration.count(), [&Current]() {
+      return Current.entry()->getName().str();
+    });
     FunctionAnalysisTime.push(Current.entry()->getName().str(),
                               nanoseconds(End - Begin));
+    FunctionVisitsCount.push(Current.entry()->getName().str(),
+                             Current.visitsCount() - VisitsBegin);
 
     revng_assert(Result.requiresInterproceduralHandling());
 
@@ -160,6 +181,13 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
 
       revng_log(SaInterpLog, "We have a summary for " << Current.entry());
 
+      // Callers of a function we gave up on must not rely on its summary
+      BasicBlock *Function = Current.entry();
+      if (Current.gaveUp() and not TheCache.isGivenUpFunction(Function)) {
+        TheCache.markAsGivenUp(Function);
+        GivenUpFunctions.push(Function->getName().str());
+      }
+
       bool MustReanalyze = false;
 
       // Are there function calls that lead to a contradiction?
@@ -506,7 +534,8 @@ struct ClobberedRegistersAnalysis {
             // Add all the locally written registers
             auto It = This.LocallyWrittenRegisters.find(Function);
             if (It != This.LocallyWrittenRegisters.end())
-              CurrentClobbered.insert(It->second.begin(), It->second.end());
+              for (unsigned Index : It->second)
+                CurrentClobbered.insert(Index);
           }
 
           // Increase the counter associated to each written register
@@ -607,7 +636,7 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
   //
   struct FunctionCallSites {
     /// \brief Collect all the slots used by the function/its callers
-    std::set<ASSlot> Slots;
+    ASSlotSet Slots;
     /// \brief The callers
     std::map<CallSite, CallSiteDescription *> CallSites;
   };
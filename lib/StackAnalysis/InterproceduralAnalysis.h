@@ -72,7 +72,7 @@ private:
   /// \brief Classification of each function
   map<BasicBlock *, FunctionType::Values> FunctionTypes;
 
-  map<BasicBlock *, std::set<int32_t>> LocallyWrittenRegisters;
+  map<BasicBlock *, LazySmallBitVector> LocallyWrittenRegisters;
   map<BasicBlock *, std::set<int32_t>> ExplicitlyCalleeSavedRegisters;
   map<BasicBlock *, std::vector<FunctionCall>> FunctionCalls;
 
@@ -188,6 +188,14 @@ public:
 };
 
 /// \brief Interprocedural part of the stack analysis
+///
+/// \note The call graph is not known upfront: which branches are function
+///       calls, and which functions are fake, is an outcome of the
+///       intraprocedural analysis itself. Therefore callees are discovered,
+///       and analyzed, on demand. Recursion is detected dynamically and the
+///       fixed point is computed only from the recursion root downward
+///       (see popUntil), which is equivalent to iterating within the SCC
+///       discovered so far, while callees outside of it hit the cache.
 class InterproceduralAnalysis {
 private:
   using Analysis = Intraprocedural::Analysis;
@@ -5,8 +5,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
 #include <iomanip>
 
+#include "llvm/Support/CommandLine.h"
+
+#include "revng/Support/CommandLine.h"
+
 #include "Intraprocedural.h"
 
 #include "Cache.h"
@@ -49,9 +54,23 @@ static Logger<> SaBBLog("sa-bb");
 RunningStatistics ABIRegistersCountStats("ABIRegistersCount");
 static RunningStatistics CacheHitRate("CacheHitRate");
 
+/// \brief Distribution of the duration, in seconds, of FunctionABI::analyze
+static RunningStatistics ABIAnalysisDuration("ABIAnalysisDuration",
+                                             RecordDistribution());
+
 /// \brief Per-function cache hit rate
 static std::map<BasicBlock *, RunningStatistics> FunctionCacheHitRate;
 
+static llvm::cl::opt<unsigned> MaxVisits("stack-analysis-max-visits",
+                                         llvm::cl::desc("give up on functions "
+                                                        "requiring more than "
+                                                        "this many basic block "
+                                                        "visits, 0 means no "
+                                                        "limit"),
+                                         llvm::cl::value_desc("visits"),
+                                         llvm::cl::cat(MainCategory),
+                                         llvm::cl::init(0));
+
 /// \brief Round \p Value to \p Digits
 template<typename F>
 static std::string round(F Value, int Digits) {
@@ -155,8 +174,8 @@ public:
 
     } else if (auto *CSV = dyn_cast<GlobalVariable>(V)) {
 
-      if (TheCache->isCPU(CSV))
-        return Value::fromSlot(ASID::cpuID(), TheCache->getCPUIndex(CSV));
+      if (llvm::Optional<int32_t> Index = TheCache->findCPUIndex(CSV))
+        return Value::fromSlot(ASID::cpuID(), *Index);
       else
         return Value();
 
@@ -294,6 +313,19 @@ static llvm::Value *getModifyAndReassign(Instruction *I) {
 Interrupt Analysis::transfer(BasicBlock *BB) {
   auto SP0 = ASID::stackID();
 
+  // If the budget is exhausted, drain the work list without visiting anything,
+  // createSummary will then summarize this function as unknown
+  ++VisitsCount;
+  if (MaxVisits != 0 and VisitsCount > MaxVisits) {
+    if (not GaveUp)
+      revng_log(SaInterpLog,
+                "Giving up on " << Entry << " after " << (VisitsCount - 1)
+                                << " visits");
+    GaveUp = true;
+    ToVisit.clear();
+    return AI::create(Element::bottom(), BranchType::Unreachable);
+  }
+
   // Create a copy of the initial state associated to this basic block
   auto It = State.find(BB);
   revng_assert(It != State.end());
@@ -452,15 +484,19 @@ Interrupt Analysis::transfer(BasicBlock *BB) {
 
         // Create in the ABIIR a load for each read register and a store for
         // each written register
-        auto UsedCSVs = GeneratedCodeBasicInfo::getCSVUsedByHelperCall(Call);
+        const auto &UsedCSVs = GCBI->getCSVUsage(Call).Used;
 
         for (GlobalVariable *CSV : UsedCSVs.Read)
-          if (TheCache->isCSV(CSV))
-            ABIBB.append(ABIIRInstruction::createLoad(slotFromCSV(CSV)));
+          if (llvm::Optional<int32_t> Index = TheCache->findCSVIndex(CSV)) {
+            ASSlot Slot = ASSlot::create(ASID::cpuID(), *Index);
+            ABIBB.append(ABIIRInstruction::createLoad(Slot));
+          }
 
         for (GlobalVariable *CSV : UsedCSVs.Written)
-          if (TheCache->isCSV(CSV))
-            ABIBB.append(ABIIRInstruction::createStore(slotFromCSV(CSV)));
+          if (llvm::Optional<int32_t> Index = TheCache->findCSVIndex(CSV)) {
+            ASSlot Slot = ASSlot::create(ASID::cpuID(), *Index);
+            ABIBB.append(ABIIRInstruction::createStore(Slot));
+          }
       }
 
     } break;
@@ -694,7 +730,7 @@ Interrupt Analysis::handleTerminator(Instruction *T,
   // Are we returning to the return address?
   if (IsReturn) {
     // This looks like an actual return
-    insert_or_assign(ReturnCandidates, T->getParent(), Result.copy());
+    registerReturnCandidate(T->getParent(), Result);
     return AI::create(std::move(Result), BT::Return);
   }
 
@@ -750,6 +786,15 @@ Interrupt Analysis::handleTerminator(Instruction *T,
                                   Successors);
 }
 
+void Analysis::registerReturnCandidate(BasicBlock *BB, const Element &Result) {
+  Element Candidate = Result.copy();
+  for (const auto &P : ReturnCandidates)
+    if (P.first != BB)
+      Candidate.deduplicateWith(P.second);
+
+  insert_or_assign(ReturnCandidates, BB, std::move(Candidate));
+}
+
 std::pair<FunctionType::Values, Element> Analysis::finalize() {
   MetaAddress EntryPC = getPC(Entry->getTerminator()).first;
 
@@ -863,6 +908,7 @@ Interrupt Analysis::handleCall(Instruction *Caller,
   const bool IsRecursive = InProgressFunctions.count(Callee) != 0;
   const bool IsIndirect = (Callee == nullptr);
   const bool IsIndirectTailCall = IsIndirect and (ReturnFromCall == nullptr);
+  const bool IsGivenUp = not IsIndirect and TheCache->isGivenUpFunction(Callee);
   bool IsKiller = false;
   bool ABIOnly = false;
 
@@ -974,7 +1020,7 @@ Interrupt Analysis::handleCall(Instruction *Caller,
     Result.apply(CallSummary->FinalState);
   }
 
-  if (IsRecursive or IsIndirect) {
+  if (IsRecursive or IsIndirect or IsGivenUp) {
     ABIBB.append(ABIIRInstruction::createIndirectCall(TheFunctionCall));
   } else {
     std::set<int32_t> StackArguments;
@@ -1007,7 +1053,7 @@ Interrupt Analysis::handleCall(Instruction *Caller,
   revng_assert(not(IsIndirectTailCall and IsKiller));
   if (IsIndirectTailCall) {
     // We consider indirect tail calls as returns
-    insert_or_assign(ReturnCandidates, Caller->getParent(), Result.copy());
+    registerReturnCandidate(Caller->getParent(), Result);
     return AI::create(std::move(Result), BT::IndirectTailCall);
   } else if (IsKiller) {
     return AI::create(std::move(Result), BT::Killer);
@@ -1023,6 +1069,29 @@ ASSlot Analysis::slotFromCSV(llvm::User *U) const {
 }
 
 IFS Analysis::createSummary() {
+  if (OwnedProfile) {
+    auto GetName = [](BasicBlock *BB) { return getName(BB); };
+    writeConvergenceProfile(*OwnedProfile, Entry, "stack", GetName);
+  }
+
+  // We gave up on this function: the results collected so far are partial,
+  // summarize it as top (it can write any register with an unknown value) and
+  // let the callers handle it as an indirect function call
+  if (GaveUp) {
+    Element Top = Element::initial();
+    LazySmallBitVector WrittenRegisters;
+    for (int32_t I = 1; TheCache->isCSVIndex(I); I++) {
+      Top.store(Value::fromSlot(ASID::cpuID(), I), Value::empty());
+      WrittenRegisters.set(I);
+    }
+
+    return IFS::createRegular(std::move(Top),
+                              FunctionABI(),
+                              {},
+                              {},
+                              std::move(WrittenRegisters));
+  }
+
   auto P = finalize();
   FunctionType::Values Type = P.first;
   Element GrandResult = std::move(P.second);
@@ -1047,13 +1116,18 @@ IFS Analysis::createSummary() {
     revng_assert(TheABIIR.verify(), "The ABI IR is invalid");
 
     // Run the almighty ABI analyses
+    auto Begin = std::chrono::steady_clock::now();
     ABI.analyze(TheABIIR);
+    std::chrono::duration<double> Duration = std::chrono::steady_clock::now()
+                                             - Begin;
+    ABIAnalysisDuration.push(Duration.count(),
+                             [this]() { return Entry->getName().str(); });
   }
 
   // Find all the function calls that lead to results incoherent with the
   // callees and register them
 
-  std::set<int32_t> WrittenRegisters = TheABIIR.writtenRegisters();
+  LazySmallBitVector WrittenRegisters = TheABIIR.writtenRegisters();
 
   IFS Summary;
   if (Type == FunctionType::Regular) {
@@ -1101,7 +1175,7 @@ void Analysis::findIncoherentFunctions(const IFS &ABISummary) {
 
     // TODO: this is an hack, functions marked as fake should somehow be
     //       purged from CallsContext
-    if (TheCache->isFakeFunction(Callee))
+    if (TheCache->isFakeFunction(Callee) or TheCache->isGivenUpFunction(Callee))
       continue;
 
     // We might not have an entry, e.g., if they callee is noreturn
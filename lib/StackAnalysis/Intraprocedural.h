@@ -19,6 +19,7 @@
 
 #include "ABIIR.h"
 #include "Cache.h"
+#include "ConvergenceProfile.h"
 #include "Element.h"
 #include "FunctionABI.h"
 #include "IntraproceduralFunctionSummary.h"
@@ -287,6 +288,17 @@ public:
 };
 
 /// \brief Intraprocedural part of the stack analysis
+///
+/// \note There's no separate fast path for leaf or straight-line functions:
+///       the extent of a function, and whether its branches are calls,
+///       returns or local jumps, is exactly what this analysis determines.
+///       Even on an acyclic CFG the breadth-first work list can visit a
+///       basic block more than once: a join block is enqueued again each
+///       time the state of one of its predecessors grows. A reverse
+///       post-order visit would avoid that, but it needs the CFG of the
+///       function upfront, while here it's discovered as the analysis
+///       proceeds (the successors of a block depend on how its terminator is
+///       classified).
 class Analysis : public MonotoneFramework<Analysis,
                                           llvm::BasicBlock *,
                                           Element,
@@ -345,8 +357,27 @@ private:
 
   bool AnalyzeABI;
 
+  /// \brief State at the end of each block that looks like a return
+  ///
+  /// \note Elements are deduplicated upon insertion, see
+  ///       registerReturnCandidate.
   std::map<llvm::BasicBlock *, Element> ReturnCandidates;
 
+  /// \brief Number of basic blocks visited so far
+  ///
+  /// \note This is not reset by initialize, so that the budget also bounds
+  ///       re-analyses due to recursion.
+  unsigned VisitsCount;
+
+  /// \brief Set when VisitsCount exceeds the budget of this function
+  bool GaveUp;
+
+  /// \brief Convergence profile, if requested with -sa-profile
+  ///
+  /// \note This is on the heap since the base class keeps a pointer to it and
+  ///       the analysis is moved around.
+  std::unique_ptr<MonotoneFrameworkProfile<llvm::BasicBlock *>> OwnedProfile;
+
 public:
   Analysis(llvm::BasicBlock *Entry,
            const Cache &TheCache,
@@ -362,7 +393,15 @@ public:
     InitialState(Element::bottom()),
     TheABIIR(Entry),
     InProgressFunctions(InProgressFunctions),
-    AnalyzeABI(AnalyzeABI) {
+    AnalyzeABI(AnalyzeABI),
+    VisitsCount(0),
+    GaveUp(false) {
+
+    if (shouldProfileConvergence(Entry)) {
+      using Profile = MonotoneFrameworkProfile<llvm::BasicBlock *>;
+      OwnedProfile = std::make_unique<Profile>();
+      setProfile(OwnedProfile.get());
+    }
 
     registerExtremal(Entry);
     initialize();
@@ -389,6 +428,12 @@ public:
 
   bool cacheMustHit() const { return CacheMustHit; }
 
+  unsigned visitsCount() const { return VisitsCount; }
+
+  /// \brief True if the analysis exceeded the visits budget and the function
+  ///        has been summarized as unknown
+  bool gaveUp() const { return GaveUp; }
+
   /// \brief Reset the analysis with a new intial state
   void initialize();
 
@@ -486,6 +531,13 @@ public:
 private:
   std::pair<FunctionType::Values, Element> finalize();
 
+  /// \brief Record \p Result as the state at the end of the return-like block
+  ///        \p BB
+  ///
+  /// Functions with many exit paths have many very similar candidates: the
+  /// address spaces equal to the ones of another candidate share its content.
+  void registerReturnCandidate(llvm::BasicBlock *BB, const Element &Result);
+
   /// \brief Creates a summary for the current analysis ready to be wrapped in
   ///        an Interrupt
   IntraproceduralFunctionSummary createSummary();
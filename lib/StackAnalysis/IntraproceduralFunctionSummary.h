@@ -54,7 +54,7 @@ public:
   LocalSlotVector LocalSlots;
   CallSiteStackSizeMap FrameSizeAtCallSite;
   BranchesTypeMap BranchesType;
-  std::set<int32_t> WrittenRegisters;
+  LazySmallBitVector WrittenRegisters;
 
 public:
   IntraproceduralFunctionSummary() :
@@ -70,7 +70,7 @@ private:
                                  FunctionABI ABI,
                                  CallSiteStackSizeMap FrameSizes,
                                  BranchesTypeMap BranchesType,
-                                 std::set<int32_t> WrittenRegisters) :
+                                 LazySmallBitVector WrittenRegisters) :
     Type(Type),
     FinalState(std::move(FinalState)),
     ABI(std::move(ABI)),
@@ -90,7 +90,7 @@ public:
   createNoReturn(FunctionABI ABI,
                  CallSiteStackSizeMap FrameSizes,
                  BranchesTypeMap BranchesType,
-                 std::set<int32_t> WrittenRegisters) {
+                 LazySmallBitVector WrittenRegisters) {
     return IntraproceduralFunctionSummary(FunctionType::NoReturn,
                                           Intraprocedural::Element::bottom(),
                                           std::move(ABI),
@@ -104,7 +104,7 @@ public:
                 FunctionABI ABI,
                 CallSiteStackSizeMap FrameSizes,
                 BranchesTypeMap BranchesType,
-                std::set<int32_t> WrittenRegisters) {
+                LazySmallBitVector WrittenRegisters) {
     return IntraproceduralFunctionSummary(FunctionType::Regular,
                                           std::move(FinalState),
                                           std::move(ABI),
@@ -160,7 +160,6 @@ public:
 private:
   void process() {
     using namespace Intraprocedural;
-    using std::set;
 
     auto CPU = ASID::cpuID();
     auto SP0 = ASID::stackID();
@@ -178,9 +177,9 @@ private:
 
     // Collect slots in the summary and those obtained by computing the ECS
     // slots
-    set<ASSlot> SlotsPool = FinalState.collectSlots(CSVCount);
+    ASSlotSet SlotsPool = FinalState.collectSlots(CSVCount);
     ABI.collectLocalSlots(SlotsPool);
-    set<ASSlot> CalleeSaved = FinalState.computeCalleeSavedSlots();
+    ASSlotSet CalleeSaved = FinalState.computeCalleeSavedSlots();
 
     revng_assert(std::all_of(SlotsPool.begin(), SlotsPool.end(), IsValid));
 
@@ -188,11 +187,11 @@ private:
       SlotsPool.insert(Slot);
     revng_assert(std::all_of(SlotsPool.begin(), SlotsPool.end(), IsValid));
 
-    set<ASSlot> ForwardedArguments;
-    set<ASSlot> ForwardedReturnValues;
+    ASSlotSet ForwardedArguments;
+    ASSlotSet ForwardedReturnValues;
 
-    set<int32_t> Arguments;
-    set<int32_t> ReturnValues;
+    LazySmallBitVector Arguments;
+    LazySmallBitVector ReturnValues;
     std::tie(Arguments, ReturnValues) = ABI.collectYesRegisters();
 
     // Loop over return values to identify forwarded arguments (push rax; pop
@@ -206,7 +205,7 @@ private:
       Value Content = FinalState.load(Value::fromSlot(RegisterSlot));
       if (const ASSlot *TheTag = Content.tag()) {
         if (TheTag->addressSpace() == CPU and Register != TheTag->offset()
-            and Arguments.count(TheTag->offset()) != 0) {
+            and TheTag->offset() >= 0 and Arguments[TheTag->offset()]) {
           // We have a return value containing the initial value of (another)
           // argument
 
@@ -12,12 +12,16 @@
 #include <sstream>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 
 #include "revng/StackAnalysis/StackAnalysis.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/Progress.h"
+#include "revng/Support/Statistics.h"
 
 #include "Cache.h"
 #include "InterproceduralAnalysis.h"
@@ -36,7 +40,7 @@ using namespace llvm::cl;
 
 namespace StackAnalysis {
 
-const std::set<llvm::GlobalVariable *> EmptyCSVSet;
+const CSVSet EmptyCSVSet;
 
 template<>
 char StackAnalysis<true>::ID = 0;
@@ -67,6 +71,7 @@ static opt<std::string> ABIAnalysisOutputPath("abi-analysis-output",
 
 template<bool AnalyzeABI>
 bool StackAnalysis<AnalyzeABI>::runOnModule(Module &M) {
+  ScopedTimer Timer("StackAnalysis");
   Function &F = *M.getFunction("root");
 
   revng_log(PassesLog, "Starting StackAnalysis");
@@ -128,13 +133,26 @@ bool StackAnalysis<AnalyzeABI>::runOnModule(Module &M) {
   // Pool where the final results will be collected
   ResultsPool Results;
 
+  // Note: functions are analyzed one after the other on purpose. Analyzing
+  // independent SCCs of the call graph concurrently is not an option: the
+  // interprocedural analysis marks callees as fake or noreturn in TheCache
+  // while it proceeds, and later analyses (including the choice of the
+  // non-forced candidates below) depend on the order in which this happens.
+  // On top of this, the analysis inspects the IR through APIs (e.g., use
+  // lists) that are not safe to access concurrently.
+
+  llvm::StringRef Phase = AnalyzeABI ? "abi-analysis" : "stack-analysis";
+  Progress->setPhase(Phase);
+  Progress->set("function-candidates", Functions.size());
+
   // First analyze all the `Force`d functions (i.e., with an explicit direct
   // call)
   for (CFEP &Function : Functions) {
     if (Function.Force) {
-      auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
       InterproceduralAnalysis SA(TheCache, GCBI, AnalyzeABI);
       SA.run(Function.Entry, Results);
+      Progress->advance("analyzed-functions");
+      Progress->tick();
     }
   }
 
@@ -143,9 +161,10 @@ bool StackAnalysis<AnalyzeABI>::runOnModule(Module &M) {
   std::set<BasicBlock *> Visited = Results.visitedBlocks();
   for (CFEP &Function : Functions) {
     if (not Function.Force and Visited.count(Function.Entry) == 0) {
-      auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
       InterproceduralAnalysis SA(TheCache, GCBI, AnalyzeABI);
       SA.run(Function.Entry, Results);
+      Progress->advance("analyzed-functions");
+      Progress->tick();
     }
   }
 
@@ -177,6 +196,8 @@ bool StackAnalysis<AnalyzeABI>::runOnModule(Module &M) {
     }
   }
 
+  Progress->setPhase((Phase + "-finalize").str());
+
   std::stringstream Output;
   GrandResult = Results.finalize(&M, &TheCache);
   GrandResult.dump(&M, Output);
@@ -217,11 +238,32 @@ void StackAnalysis<AnalyzeABI>::serializeMetadata(Function &F) {
   QuickMetadata QMD(Context);
 
   // Temporary data structure so we can set all the `revng.func.member.of` in a
-  // single shot at the end
-  std::map<Instruction *, std::vector<Metadata *>> MemberOf;
+  // single shot at the end. The order in which the metadata is attached is
+  // irrelevant, and most basic blocks belong to a single function.
+  //
+  // Note: this loop is serial since all the metadata is created in the
+  //       LLVMContext, which is not thread-safe.
+  DenseMap<Instruction *, SmallVector<Metadata *, 1>> MemberOf;
 
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
+  // Most functions and call sites share the same triples of CSV, argument and
+  // return value: create the metadata for each of them only once. The
+  // valueName strings are static, therefore they can be compared by address.
+  using SlotKey = std::pair<GlobalVariable *,
+                            std::pair<const char *, const char *>>;
+  DenseMap<SlotKey, Metadata *> SlotMDs;
+  auto GetSlotMD = [&SlotMDs, &QMD](GlobalVariable *CSV,
+                                    const char *Argument,
+                                    const char *ReturnValue) {
+    Metadata *&Result = SlotMDs[{ CSV, { Argument, ReturnValue } }];
+    if (Result == nullptr)
+      Result = QMD.tuple({ QMD.get(CSV),
+                           QMD.get(Argument),
+                           QMD.get(ReturnValue) });
+    return Result;
+  };
+
   // Loop over all the detected functions
   for (const auto &P : Summary.Functions) {
     BasicBlock *Entry = P.first;
@@ -252,16 +294,16 @@ void StackAnalysis<AnalyzeABI>::serializeMetadata(Function &F) {
     }
 
     // Register slots metadata
-    std::vector<Metadata *> SlotMDs;
+    std::vector<Metadata *> FunctionSlotMDs;
     if (AnalyzeABI) {
+      FunctionSlotMDs.reserve(Function.RegisterSlots.size());
       for (auto &P : Function.RegisterSlots) {
         if (GCBI.isServiceRegister(P.first))
           continue;
 
-        auto *CSV = QMD.get(P.first);
-        auto *Argument = QMD.get(P.second.Argument.valueName());
-        auto *ReturnValue = QMD.get(P.second.ReturnValue.valueName());
-        SlotMDs.push_back(QMD.tuple({ CSV, Argument, ReturnValue }));
+        FunctionSlotMDs.push_back(GetSlotMD(P.first,
+                                            P.second.Argument.valueName(),
+                                            P.second.ReturnValue.valueName()));
       }
     }
 
@@ -270,7 +312,7 @@ void StackAnalysis<AnalyzeABI>::serializeMetadata(Function &F) {
                                       QMD.get(GCBI.toConstant(EntryPC)),
                                       TypeMD,
                                       QMD.tuple(ClobberedMDs),
-                                      QMD.tuple(SlotMDs) });
+                                      QMD.tuple(FunctionSlotMDs) });
     Entry->getTerminator()->setMetadata("revng.func.entry", FunctionMD);
 
     if (AnalyzeABI) {
@@ -282,18 +324,18 @@ void StackAnalysis<AnalyzeABI>::serializeMetadata(Function &F) {
         Instruction *Call = CallSite.Call;
 
         // Register slots metadata
-        std::vector<Metadata *> SlotMDs;
+        std::vector<Metadata *> CallSlotMDs;
+        CallSlotMDs.reserve(CallSite.RegisterSlots.size());
         for (auto &P : CallSite.RegisterSlots) {
           if (GCBI.isServiceRegister(P.first))
             continue;
 
-          auto *CSV = QMD.get(P.first);
-          auto *Argument = QMD.get(P.second.Argument.valueName());
-          auto *ReturnValue = QMD.get(P.second.ReturnValue.valueName());
-          SlotMDs.push_back(QMD.tuple({ CSV, Argument, ReturnValue }));
+          CallSlotMDs.push_back(GetSlotMD(P.first,
+                                          P.second.Argument.valueName(),
+                                          P.second.ReturnValue.valueName()));
         }
 
-        Call->setMetadata("func.call", QMD.tuple(QMD.tuple(SlotMDs)));
+        Call->setMetadata("func.call", QMD.tuple(QMD.tuple(CallSlotMDs)));
       }
     }
 
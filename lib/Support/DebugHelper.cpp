@@ -45,6 +45,10 @@ static StringRef getText(const Instruction *Instruction, unsigned Kind) {
   if (auto *String = dyn_cast<MDString>(MDOperand)) {
     return String->getString();
   } else if (auto *CAM = dyn_cast<ConstantAsMetadata>(MDOperand)) {
+    // An index in the original instructions table, the text is not in the IR
+    if (isa<ConstantInt>(CAM->getValue()))
+      return StringRef();
+
     auto *Cast = cast<ConstantExpr>(CAM->getValue());
     auto *GV = cast<GlobalVariable>(Cast->getOperand(0));
     auto *Initializer = GV->getInitializer();
@@ -54,47 +58,6 @@ static StringRef getText(const Instruction *Instruction, unsigned Kind) {
   }
 }
 
-static void
-replaceAll(std::string &Input, const std::string &From, const std::string &To) {
-  if (From.empty())
-    return;
-
-  size_t Start = 0;
-  while ((Start = Input.find(From, Start)) != std::string::npos) {
-    Input.replace(Start, From.length(), To);
-    Start += To.length();
-  }
-}
-
-/// Writes the text contained in the metadata with the specified kind ID to the
-/// output stream, unless that metadata is exactly the same as in the previous
-/// instruction.
-static void writeMetadataIfNew(const Instruction *TheInstruction,
-                               unsigned MDKind,
-                               formatted_raw_ostream &Output,
-                               StringRef Prefix) {
-  auto BeginIt = TheInstruction->getParent()->begin();
-  StringRef Text = getText(TheInstruction, MDKind);
-  if (Text.size()) {
-    StringRef LastText;
-
-    do {
-      if (TheInstruction->getIterator() == BeginIt) {
-        TheInstruction = nullptr;
-      } else {
-        TheInstruction = TheInstruction->getPrevNode();
-        LastText = getText(TheInstruction, MDKind);
-      }
-    } while (TheInstruction != nullptr && LastText.size() == 0);
-
-    if (TheInstruction == nullptr or LastText != Text) {
-      std::string TextToSerialize = Text.str();
-      replaceAll(TextToSerialize, "\n", " ");
-      Output << Prefix << TextToSerialize << "\n";
-    }
-  }
-}
-
 /// Add a module flag, if not already present, using name and value provided.
 /// Used for creating the Dwarf compliant debug info.
 static void addModuleFlag(Module *TheModule, StringRef Flag, uint32_t Value) {
@@ -105,6 +68,30 @@ static void addModuleFlag(Module *TheModule, StringRef Flag, uint32_t Value) {
 
 using DAW = DebugAnnotationWriter;
 
+/// Writes the text contained in the metadata with the specified kind ID to the
+/// output stream, unless that metadata is exactly the same as in the previous
+/// instruction (with such metadata) of the same basic block.
+void DAW::writeMetadataIfNew(const Instruction *I,
+                             unsigned MDKind,
+                             StringRef &Last,
+                             formatted_raw_ostream &Output) {
+  StringRef Text = getText(I, MDKind);
+  if (Text.empty() or Text == Last)
+    return;
+
+  Last = Text;
+
+  // Write the text on a single line, without copying it
+  Output << "\n  ; ";
+  size_t Start = 0;
+  size_t NewLine = 0;
+  while ((NewLine = Text.find('\n', Start)) != StringRef::npos) {
+    Output << Text.slice(Start, NewLine) << " ";
+    Start = NewLine + 1;
+  }
+  Output << Text.drop_front(Start) << "\n";
+}
+
 DAW::DebugAnnotationWriter(LLVMContext &Context, bool DebugInfo) :
   Context(Context), DebugInfo(DebugInfo) {
   OriginalInstrMDKind = Context.getMDKindID("oi");
@@ -122,8 +109,14 @@ void DAW::emitInstructionAnnot(const Instruction *Instr,
       or not(FunctionName == "root" or FunctionName.startswith("bb.")))
     return;
 
-  writeMetadataIfNew(Instr, OriginalInstrMDKind, Output, "\n  ; ");
-  writeMetadataIfNew(Instr, PTCInstrMDKind, Output, "\n  ; ");
+  if (Instr->getParent() != CurrentBlock) {
+    CurrentBlock = Instr->getParent();
+    LastOriginalInstr = StringRef();
+    LastPTCInstr = StringRef();
+  }
+
+  writeMetadataIfNew(Instr, OriginalInstrMDKind, LastOriginalInstr, Output);
+  writeMetadataIfNew(Instr, PTCInstrMDKind, LastPTCInstr, Output);
 
   if (DebugInfo) {
     // If DebugInfo is activated the generated LLVM IR textual representation
@@ -5,6 +5,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <limits>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
@@ -113,21 +118,92 @@ MetaAddress MetaAddress::decomposeIntegerPC(ConstantInt *Value) {
 #define SEP ":"
 
 std::string MetaAddress::toString() const {
-  if (isInvalid())
-    return SEP "Invalid";
-
-  std::string Result;
-  {
-    raw_string_ostream Stream(Result);
-    Stream << "0x" << Twine::utohexstr(Address) << SEP
-           << MetaAddressType::toString(Type);
+  StringBuffer Buffer;
+  return toString(Buffer).str();
+}
+
+StringRef MetaAddress::toString(StringBuffer &Buffer) const {
+  char *Out = Buffer.data();
+
+  auto Append = [&Out](StringRef String) {
+    std::copy(String.begin(), String.end(), Out);
+    Out += String.size();
+  };
+
+  auto AppendDecimal = [&Out](uint64_t Value) {
+    char Digits[20];
+    unsigned Count = 0;
+    do {
+      Digits[Count++] = '0' + Value % 10;
+      Value /= 10;
+    } while (Value != 0);
+
+    while (Count != 0)
+      *Out++ = Digits[--Count];
+  };
+
+  if (isInvalid()) {
+    Append(SEP "Invalid");
+    return StringRef(Buffer.data(), Out - Buffer.data());
+  }
+
+  Append("0x");
+  unsigned Shift = 60;
+  while (Shift != 0 and (Address >> Shift) == 0)
+    Shift -= 4;
+  for (int I = Shift; I >= 0; I -= 4)
+    *Out++ = "0123456789abcdef"[(Address >> I) & 0xF];
+
+  Append(SEP);
+  Append(MetaAddressType::toString(Type));
+
+  // The address space is the fourth part, leave the epoch empty if necessary
+  if (not isDefaultEpoch() or not isDefaultAddressSpace()) {
+    Append(SEP);
     if (not isDefaultEpoch())
-      Stream << SEP << Epoch;
-    if (not isDefaultAddressSpace())
-      Stream << SEP << AddressSpace;
+      AppendDecimal(Epoch);
   }
 
-  return Result;
+  if (not isDefaultAddressSpace()) {
+    Append(SEP);
+    AppendDecimal(AddressSpace);
+  }
+
+  revng_assert(Out <= Buffer.data() + Buffer.size());
+  return StringRef(Buffer.data(), Out - Buffer.data());
+}
+
+/// \brief Parse an integer as StringRef::getAsInteger with radix 0
+///
+/// Hexadecimal and decimal numbers, i.e., what toString emits, are parsed
+/// inline, the rest is left to getAsInteger.
+///
+/// \return true in case of error
+template<typename T>
+static bool parseInteger(StringRef Text, T &Result) {
+  auto IsHexDigit = [](char C) { return llvm::isHexDigit(C); };
+  auto IsDigit = [](char C) { return llvm::isDigit(C); };
+
+  uint64_t Value = 0;
+  if (Text.size() > 2 and Text.size() <= 2 + 16
+      and (Text.startswith("0x") or Text.startswith("0X"))
+      and llvm::all_of(Text.drop_front(2), IsHexDigit)) {
+    for (char C : Text.drop_front(2))
+      Value = (Value << 4) | llvm::hexDigitValue(C);
+  } else if (Text.size() > 0 and Text.size() < 20
+             and (Text[0] != '0' or Text.size() == 1)
+             and llvm::all_of(Text, IsDigit)) {
+    for (char C : Text)
+      Value = Value * 10 + (C - '0');
+  } else {
+    return Text.getAsInteger(0, Result);
+  }
+
+  if (Value > std::numeric_limits<T>::max())
+    return true;
+
+  Result = Value;
+  return false;
 }
 
 MetaAddress MetaAddress::fromString(StringRef Text) {
@@ -136,16 +212,26 @@ MetaAddress MetaAddress::fromString(StringRef Text) {
 
   MetaAddress Result;
 
-  SmallVector<StringRef, 4> Parts;
-  Text.split(Parts, SEP);
+  // Split in at most four parts, without allocating
+  std::array<StringRef, 4> Parts;
+  size_t Count = 0;
+  while (true) {
+    if (Count == Parts.size())
+      return MetaAddress::invalid();
+
+    size_t Position = Text.find(SEP);
+    Parts[Count++] = Text.substr(0, Position);
+    if (Position == StringRef::npos)
+      break;
+    Text = Text.substr(Position + 1);
+  }
 
-  if (Parts.size() < 2 or Parts.size() > 4)
+  if (Count < 2)
     return MetaAddress::invalid();
 
   bool Error;
-  uint64_t Value;
 
-  Error = Parts[0].getAsInteger(0, Result.Address);
+  Error = parseInteger(Parts[0], Result.Address);
   if (Error)
     return MetaAddress::invalid();
 
@@ -154,15 +240,15 @@ MetaAddress MetaAddress::fromString(StringRef Text) {
     return MetaAddress::invalid();
 
   Result.Epoch = 0;
-  if (Parts.size() >= 3 and Parts[2].size() > 0) {
-    Error = Parts[2].getAsInteger(0, Result.Epoch);
+  if (Count >= 3 and Parts[2].size() > 0) {
+    Error = parseInteger(Parts[2], Result.Epoch);
     if (Error)
       return MetaAddress::invalid();
   }
 
   Result.AddressSpace = 0;
-  if (Parts.size() == 4 and Parts[3].size() > 0) {
-    Error = Parts[3].getAsInteger(0, Result.AddressSpace);
+  if (Count == 4 and Parts[3].size() > 0) {
+    Error = parseInteger(Parts[3], Result.AddressSpace);
     if (Error)
       return MetaAddress::invalid();
   }
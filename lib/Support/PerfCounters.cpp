@@ -0,0 +1,125 @@
+/// \file PerfCounters.cpp
+/// \brief Access to hardware performance counters through perf_event_open
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/PerfCounters.h"
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cl = llvm::cl;
+
+static cl::opt<bool> EnablePerfCounters("perf-counters",
+                                        cl::desc("record hardware counters "
+                                                 "(cycles, instructions, "
+                                                 "cache and branch misses) "
+                                                 "in the phase timers"),
+                                        cl::cat(MainCategory));
+
+static Logger<> Log("perf-counters");
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+
+namespace {
+
+class CountersGroup {
+private:
+  std::array<int, PerfCounter::Count> Descriptors;
+  bool Available = false;
+
+public:
+  CountersGroup() {
+    Descriptors.fill(-1);
+
+    using namespace PerfCounter;
+    const std::array<uint64_t, Count> Events = { PERF_COUNT_HW_CPU_CYCLES,
+                                                 PERF_COUNT_HW_INSTRUCTIONS,
+                                                 PERF_COUNT_HW_CACHE_MISSES,
+                                                 PERF_COUNT_HW_BRANCH_MISSES };
+
+    for (unsigned I = 0; I < Count; ++I) {
+      struct perf_event_attr Attributes;
+      memset(&Attributes, 0, sizeof(Attributes));
+      Attributes.type = PERF_TYPE_HARDWARE;
+      Attributes.size = sizeof(Attributes);
+      Attributes.config = Events[I];
+      Attributes.read_format = PERF_FORMAT_GROUP;
+      Attributes.exclude_kernel = 1;
+      Attributes.exclude_hv = 1;
+      Attributes.disabled = (I == 0);
+
+      int Leader = Descriptors[0];
+      long FD = syscall(SYS_perf_event_open, &Attributes, 0, -1, Leader, 0);
+      if (FD < 0) {
+        revng_log(Log,
+                  "Cannot open the " << getName(static_cast<Values>(I))
+                                     << " counter: " << strerror(errno));
+        close();
+        return;
+      }
+      Descriptors[I] = FD;
+    }
+
+    ioctl(Descriptors[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(Descriptors[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    Available = true;
+  }
+
+  ~CountersGroup() { close(); }
+
+  bool read(PerfCounters::Sample &Result) {
+    if (not Available)
+      return false;
+
+    // With PERF_FORMAT_GROUP the leader returns the number of counters
+    // followed by their values
+    uint64_t Buffer[1 + PerfCounter::Count];
+    ssize_t Size = ::read(Descriptors[0], Buffer, sizeof(Buffer));
+    if (Size != sizeof(Buffer) or Buffer[0] != PerfCounter::Count)
+      return false;
+
+    std::copy(Buffer + 1, Buffer + 1 + PerfCounter::Count, Result.begin());
+    return true;
+  }
+
+private:
+  void close() {
+    for (int &FD : Descriptors) {
+      if (FD >= 0)
+        ::close(FD);
+      FD = -1;
+    }
+    Available = false;
+  }
+};
+
+} // namespace
+
+bool PerfCounters::read(Sample &Result) {
+  if (not EnablePerfCounters)
+    return false;
+
+  static CountersGroup Group;
+  return Group.read(Result);
+}
+
+#else
+
+bool PerfCounters::read(Sample &) {
+  return false;
+}
+
+#endif
@@ -6,6 +6,7 @@
 //
 
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/IR/MDBuilder.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/Support/ProgramCounterHandler.h"
@@ -16,9 +17,13 @@ using PCH = ProgramCounterHandler;
 class PCOnlyProgramCounterHandler : public ProgramCounterHandler {
 public:
   static std::unique_ptr<ProgramCounterHandler>
-  create(Module *M, const CSVFactory &Factory) {
+  create(Triple::ArchType Architecture, Module *M, const CSVFactory &Factory) {
     auto Result = std::make_unique<PCOnlyProgramCounterHandler>();
 
+    // We only lift code of the default type of the architecture, in the
+    // default epoch and address space: represent the PC with its address alone
+    Result->SingleWordBase = MetaAddress::fromPC(Architecture, 0);
+
     // Create and register the pc CSV
     Result->AddressCSV = Factory(PCAffectingCSV::PC, AddressName);
     Result->CSVsAffectingPC.insert(Result->AddressCSV);
@@ -198,7 +203,28 @@ static ConstantInt *caseConstant(SwitchInst *Switch, uint64_t Value) {
 }
 
 static void addCase(SwitchInst *Switch, uint64_t Value, BasicBlock *BB) {
-  Switch->addCase(caseConstant(Switch, Value), BB);
+  // Keep the branch weights, if any, consistent with the new case
+  SwitchInstProfUpdateWrapper(*Switch).addCase(caseConstant(Switch, Value),
+                                               BB,
+                                               None);
+}
+
+/// \brief Attach \p Weights to \p Switch, scaling them down to 32 bits
+static void setBranchWeights(SwitchInst *Switch, ArrayRef<uint64_t> Weights) {
+  revng_assert(Weights.size() == Switch->getNumSuccessors());
+
+  uint64_t Max = *std::max_element(Weights.begin(), Weights.end());
+  unsigned Shift = 0;
+  while ((Max >> Shift) > std::numeric_limits<uint32_t>::max())
+    ++Shift;
+
+  SmallVector<uint32_t, 4> Scaled;
+  Scaled.reserve(Weights.size());
+  for (uint64_t Weight : Weights)
+    Scaled.push_back(Weight >> Shift);
+
+  MDBuilder MDB(getContext(Switch));
+  Switch->setMetadata(LLVMContext::MD_prof, MDB.createBranchWeights(Scaled));
 }
 
 class PartialMetaAddress {
@@ -310,8 +336,67 @@ bool PCH::isPCAffectingHelper(Instruction *I) const {
   return false;
 }
 
+bool PCH::isValid(const CachedJumpTarget &Entry) {
+  for (const WeakVH &BB : Entry.Visited)
+    if (BB == nullptr)
+      return false;
+
+  if (Entry.HasNonConstantStore) {
+    auto *Store = cast_or_null<StoreInst>(&*Entry.NonConstantStore);
+    return (Store != nullptr and Entry.StoredValue != nullptr
+            and Store->getValueOperand() == Entry.StoredValue);
+  }
+
+  return true;
+}
+
+void PCH::forgetUniqueJumpTarget(BasicBlock *BB) {
+  auto It = JumpTargetsCacheUsers.find(BB);
+  if (It == JumpTargetsCacheUsers.end())
+    return;
+
+  for (BasicBlock *User : It->second)
+    JumpTargetsCache.erase(User);
+  JumpTargetsCacheUsers.erase(It);
+}
+
 std::pair<NextJumpTarget::Values, MetaAddress>
 PCH::getUniqueJumpTarget(BasicBlock *BB) {
+  auto CacheIt = JumpTargetsCache.find(BB);
+  if (CacheIt != JumpTargetsCache.end()) {
+    const CachedJumpTarget &Entry = CacheIt->second;
+    if (isValid(Entry))
+      return { Entry.Result, Entry.Target };
+    JumpTargetsCache.erase(CacheIt);
+  }
+
+  CachedJumpTarget Entry;
+  std::set<BasicBlock *> AllVisited;
+  auto Result = computeUniqueJumpTarget(BB, Entry, AllVisited);
+
+  Entry.Result = Result.first;
+  Entry.Target = Result.second;
+
+  // The queried block goes first, so its erasure is detected even if a new
+  // block is later allocated at the same address
+  Entry.Visited.emplace_back(BB);
+  JumpTargetsCacheUsers[BB].push_back(BB);
+  for (BasicBlock *Visited : AllVisited) {
+    if (Visited == BB)
+      continue;
+    Entry.Visited.emplace_back(Visited);
+    JumpTargetsCacheUsers[Visited].push_back(BB);
+  }
+
+  JumpTargetsCache.insert_or_assign(BB, std::move(Entry));
+
+  return Result;
+}
+
+std::pair<NextJumpTarget::Values, MetaAddress>
+PCH::computeUniqueJumpTarget(BasicBlock *BB,
+                             CachedJumpTarget &Entry,
+                             std::set<BasicBlock *> &AllVisited) {
   std::vector<StackEntry> Stack;
 
   enum ProcessResult { Proceed, DontProceed, BailOut };
@@ -320,9 +405,11 @@ PCH::getUniqueJumpTarget(BasicBlock *BB) {
 
   bool ChangedByHelper = false;
 
-  auto Process = [&AgreedMA,
-                  this,
-                  &ChangedByHelper](State &S, BasicBlock *BB) -> ProcessResult {
+  auto Process = [&AgreedMA, this, &ChangedByHelper, &Entry, &AllVisited](
+                   State &S,
+                   BasicBlock *BB) -> ProcessResult {
+    AllVisited.insert(BB);
+
     // Do not follow backedges
     if (S.visit(BB))
       return DontProceed;
@@ -356,6 +443,9 @@ PCH::getUniqueJumpTarget(BasicBlock *BB) {
 
         } else {
           // Non-constant store to PC CSV, bail out
+          Entry.HasNonConstantStore = true;
+          Entry.NonConstantStore = Store;
+          Entry.StoredValue = V;
           AgreedMA = MetaAddress::invalid();
           return BailOut;
         }
@@ -529,8 +619,9 @@ public:
     eraseIfNoUse(AddressVH);
   }
 
-  SwitchInst *createSwitch(Value *V, IRBuilder<> &Builder) {
-    return Builder.CreateSwitch(V, Default, 0);
+  SwitchInst *
+  createSwitch(Value *V, IRBuilder<> &Builder, unsigned NumCases = 0) {
+    return Builder.CreateSwitch(V, Default, NumCases);
   }
 
   SwitchInst *getOrCreateAddressSpaceSwitch(SwitchInst *EpochSwitch,
@@ -576,12 +667,16 @@ public:
                            CurrentType);
   }
 
-  SwitchInst *registerTypeCase(SwitchInst *Switch, const MetaAddress &MA) {
+  /// \param NumCases the expected number of cases of the new address switch
+  SwitchInst *registerTypeCase(SwitchInst *Switch,
+                               const MetaAddress &MA,
+                               unsigned NumCases = 0) {
     const char *TypeName = MetaAddressType::toString(MA.type());
     return registerNewCase(Switch,
                            MA.type(),
                            "type_" + Twine(TypeName),
-                           CurrentAddress);
+                           CurrentAddress,
+                           NumCases);
   }
 
 private:
@@ -598,7 +693,8 @@ private:
   SwitchInst *registerNewCase(SwitchInst *Switch,
                               uint64_t NewCaseValue,
                               const Twine &NewSuffix,
-                              Value *SwitchOn) {
+                              Value *SwitchOn,
+                              unsigned NumCases = 0) {
     using BB = BasicBlock;
     auto *NewSwitchBB = BB::Create(Context,
                                    (Switch->getParent()->getName() + "_"
@@ -606,7 +702,7 @@ private:
                                    F);
     ::addCase(Switch, NewCaseValue, NewSwitchBB);
     IRBuilder<> Builder(NewSwitchBB);
-    SwitchInst *Result = createSwitch(SwitchOn, Builder);
+    SwitchInst *Result = createSwitch(SwitchOn, Builder, NumCases);
     if (SetBlockType)
       setBlockType(Result, *SetBlockType);
     return Result;
@@ -618,6 +714,19 @@ void PCH::addCaseToDispatcher(SwitchInst *Root,
                               Optional<BlockType::Values> SetBlockType) const {
   auto &[MA, BB] = NewTarget;
 
+  // Looking up a case is linear in the number of cases: callers are in charge
+  // of never adding an address twice (see JumpTargetManager::DispatcherCases),
+  // here we only verify it in debug builds
+  if (isSingleWord()) {
+    revng_assert(matchesSingleWordBase(MA));
+#ifndef NDEBUG
+    auto *C = caseConstant(Root, MA.address());
+    revng_assert(Root->findCaseValue(C) == Root->case_default());
+#endif
+    ::addCase(Root, MA.address(), BB);
+    return;
+  }
+
   SwitchManager SM(Root, SetBlockType);
 
   SwitchInst *EpochSwitch = Root;
@@ -630,25 +739,57 @@ void PCH::addCaseToDispatcher(SwitchInst *Root,
   TypeSwitch = SM.getOrCreateTypeSwitch(AddressSpaceSwitch, MA);
   AddressSwitch = SM.getOrCreateAddressSwitch(TypeSwitch, MA);
 
-  // We are the switch of the addresses, add a case targeting BB, if required
+  // We are the switch of the addresses
+#ifndef NDEBUG
   auto *C = caseConstant(AddressSwitch, MA.address());
-  auto CaseIt = AddressSwitch->findCaseValue(C);
-  if (CaseIt == AddressSwitch->case_default()) {
-    ::addCase(AddressSwitch, MA.address(), BB);
-  } else {
-    revng_assert(CaseIt->getCaseSuccessor() == BB);
-  }
+  revng_assert(AddressSwitch->findCaseValue(C) == AddressSwitch->case_default());
+#endif
+
+  ::addCase(AddressSwitch, MA.address(), BB);
 }
 
 void PCH::destroyDispatcher(SwitchInst *Root) const {
+  if (isSingleWord()) {
+    WeakVH AddressVH(Root->getCondition());
+    Root->eraseFromParent();
+    eraseIfNoUse(AddressVH);
+    return;
+  }
+
   SwitchManager(Root, {}).destroy(Root);
 }
 
+/// \brief Build a dispatcher made of a single switch on the address
+static SwitchInst *
+buildSingleWordDispatcher(const PCH::DispatcherTargets &Targets,
+                          IRBuilder<> &Builder,
+                          Value *CurrentAddress,
+                          BasicBlock *Default,
+                          PCH::DispatcherWeights Weights) {
+  auto *Switch = Builder.CreateSwitch(CurrentAddress, Default, Targets.size());
+
+  SmallVector<uint64_t, 4> SwitchWeights;
+  if (Weights)
+    SwitchWeights.push_back(0);
+
+  for (const auto &[MA, BB] : Targets) {
+    ::addCase(Switch, MA.address(), BB);
+    if (Weights)
+      SwitchWeights.push_back(Weights(MA));
+  }
+
+  if (Weights)
+    setBranchWeights(Switch, SwitchWeights);
+
+  return Switch;
+}
+
 SwitchInst *
 PCH::buildDispatcher(DispatcherTargets &Targets,
                      IRBuilder<> &Builder,
                      BasicBlock *Default,
-                     Optional<BlockType::Values> SetBlockType) const {
+                     Optional<BlockType::Values> SetBlockType,
+                     DispatcherWeights Weights) const {
   revng_assert(Targets.size() != 0);
 
   LLVMContext &Context = getContext(Default);
@@ -660,6 +801,17 @@ PCH::buildDispatcher(DispatcherTargets &Targets,
               return std::less<MetaAddress>()(LHS.first, RHS.first);
             });
 
+  if (isSingleWord()) {
+    for (const DispatcherTarget &Target : Targets)
+      revng_assert(matchesSingleWordBase(Target.first));
+
+    return buildSingleWordDispatcher(Targets,
+                                     Builder,
+                                     Builder.CreateLoad(AddressCSV),
+                                     Default,
+                                     Weights);
+  }
+
   // First of all, create code to load the components of the MetaAddress
   Value *CurrentEpoch = Builder.CreateLoad(EpochCSV);
   Value *CurrentAddressSpace = Builder.CreateLoad(AddressSpaceCSV);
@@ -682,8 +834,33 @@ PCH::buildDispatcher(DispatcherTargets &Targets,
   // Initially, we need to create a switch at each level
   bool ForceNewSwitch = true;
 
+  // Branch weights of each switch, in successor order (the default is first).
+  // The switches of the current MetaAddress are always the last one for each
+  // level, so we only track their index.
+  using WeightsVector = SmallVector<uint64_t, 4>;
+  std::vector<std::pair<SwitchInst *, WeightsVector>> SwitchesWeights;
+  std::array<size_t, 4> CurrentSwitches = {};
+  auto RegisterSwitch = [&SwitchesWeights, &CurrentSwitches](unsigned Level,
+                                                             SwitchInst *S) {
+    if (Level != 0)
+      SwitchesWeights[CurrentSwitches[Level - 1]].second.push_back(0);
+    CurrentSwitches[Level] = SwitchesWeights.size();
+    SwitchesWeights.push_back({ S, { 0 } });
+  };
+
+  if (Weights)
+    RegisterSwitch(0, EpochSwitch);
+
+  auto SameAddressSwitch = [](const MetaAddress &LHS, const MetaAddress &RHS) {
+    return (LHS.epoch() == RHS.epoch()
+            and LHS.addressSpace() == RHS.addressSpace()
+            and LHS.type() == RHS.type());
+  };
+
   MetaAddress Last = MetaAddress::invalid();
-  for (const auto &[MA, BB] : Targets) {
+  for (auto It = Targets.begin(), End = Targets.end(); It != End; ++It) {
+    const auto &[MA, BB] = *It;
+
     // Extract raw values for the current MetaAddress
     uint64_t Epoch = MA.epoch();
     uint64_t AddressSpace = MA.addressSpace();
@@ -696,26 +873,49 @@ PCH::buildDispatcher(DispatcherTargets &Targets,
 
     if (ForceNewSwitch or Epoch != Last.epoch()) {
       AddressSpaceSwitch = SM.registerEpochCase(EpochSwitch, MA);
+      if (Weights)
+        RegisterSwitch(1, AddressSpaceSwitch);
       ForceNewSwitch = true;
     }
 
     if (ForceNewSwitch or AddressSpace != Last.addressSpace()) {
       TypeSwitch = SM.registerAddressSpaceCase(AddressSpaceSwitch, MA);
+      if (Weights)
+        RegisterSwitch(2, TypeSwitch);
       ForceNewSwitch = true;
     }
 
     if (ForceNewSwitch or Type != Last.type()) {
-      const char *TypeName = MetaAddressType::toString(MA.type());
-      AddressSwitch = SM.registerTypeCase(TypeSwitch, MA);
+      // Targets are sorted: all the ones ending up in this switch are next
+      const MetaAddress &First = It->first;
+      auto IsInGroup = [&](const DispatcherTarget &T) {
+        return SameAddressSwitch(T.first, First);
+      };
+      auto GroupEnd = std::find_if_not(It, End, IsInGroup);
+      unsigned NumCases = std::distance(It, GroupEnd);
+      AddressSwitch = SM.registerTypeCase(TypeSwitch, MA, NumCases);
+      if (Weights)
+        RegisterSwitch(3, AddressSwitch);
       ForceNewSwitch = true;
     }
 
     ::addCase(AddressSwitch, Address, BB);
 
+    if (Weights) {
+      // Account the weight of this target in the switches leading to it
+      uint64_t Weight = Weights(MA);
+      SwitchesWeights[CurrentSwitches[3]].second.push_back(Weight);
+      for (unsigned Level = 0; Level < 3; ++Level)
+        SwitchesWeights[CurrentSwitches[Level]].second.back() += Weight;
+    }
+
     Last = MA;
     ForceNewSwitch = false;
   }
 
+  for (const auto &[Switch, SwitchWeights] : SwitchesWeights)
+    setBranchWeights(Switch, SwitchWeights);
+
   return EpochSwitch;
 }
 
@@ -733,7 +933,7 @@ PCH::create(Triple::ArchType Architecture,
   case Triple::aarch64:
   case Triple::systemz:
   case Triple::x86:
-    return PCOnlyProgramCounterHandler::create(M, Factory);
+    return PCOnlyProgramCounterHandler::create(Architecture, M, Factory);
 
   default:
     revng_abort("Unsupported architecture");
@@ -768,6 +968,14 @@ void PCH::buildHotPath(IRBuilder<> &B,
                        BasicBlock *Default) const {
   auto &[Address, BB] = CandidateTarget;
 
+  if (isSingleWord()) {
+    revng_assert(matchesSingleWordBase(Address));
+    Instruction *Load = B.CreateLoad(AddressCSV);
+    auto *Expected = ConstantInt::get(Load->getType(), Address.address());
+    B.CreateCondBr(B.CreateICmpEQ(Load, Expected), BB, Default);
+    return;
+  }
+
   auto CreateCmp = [&B](GlobalVariable *CSV, uint64_t Value) {
     Instruction *Load = B.CreateLoad(CSV);
     Type *LoadType = Load->getType();
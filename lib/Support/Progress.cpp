@@ -0,0 +1,93 @@
+/// \file Progress.cpp
+/// \brief Implementation of the periodic progress report
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Progress.h"
+
+namespace cl = llvm::cl;
+
+static cl::opt<std::string> ProgressOutput("progress-output",
+                                           cl::desc("periodically write the "
+                                                    "progress as JSON lines to "
+                                                    "this file (- for "
+                                                    "stderr)"),
+                                           cl::value_desc("path"),
+                                           cl::cat(MainCategory));
+
+static cl::opt<unsigned> ProgressInterval("progress-interval",
+                                          cl::desc("seconds between two "
+                                                   "progress reports"),
+                                          cl::value_desc("seconds"),
+                                          cl::init(10),
+                                          cl::cat(MainCategory));
+
+llvm::ManagedStatic<ProgressReporter> Progress;
+
+ProgressReporter::ProgressReporter() {
+  Start = Clock::now();
+  LastReport = Start;
+  NextReport = Start + std::chrono::seconds(ProgressInterval);
+
+  if (ProgressOutput.empty())
+    return;
+
+  if (ProgressOutput == "-") {
+    Output = &llvm::errs();
+    return;
+  }
+
+  std::error_code EC;
+  OwnedOutput = std::make_unique<llvm::raw_fd_ostream>(ProgressOutput,
+                                                       EC,
+                                                       llvm::sys::fs::OF_Text);
+  revng_check(not EC, "Cannot open the progress output file");
+  Output = OwnedOutput.get();
+}
+
+void ProgressReporter::emit(bool Done) {
+  using namespace std::chrono;
+
+  Clock::time_point Now = Clock::now();
+  double Elapsed = duration<double>(Now - Start).count();
+  double SinceLast = duration<double>(Now - LastReport).count();
+
+  {
+    llvm::json::OStream JSON(*Output);
+    JSON.object([&]() {
+      JSON.attribute("elapsed", Elapsed);
+      JSON.attribute("phase", Phase);
+      if (Done)
+        JSON.attribute("done", true);
+
+      JSON.attributeObject("counters", [&]() {
+        for (auto &[Name, C] : Counters)
+          JSON.attribute(Name, static_cast<int64_t>(C.Value));
+      });
+
+      JSON.attributeObject("rates", [&]() {
+        for (auto &[Name, C] : Counters) {
+          if (not C.IsThroughput)
+            continue;
+
+          double Delta = C.Value - C.LastReported;
+          JSON.attribute(Name, SinceLast > 0 ? Delta / SinceLast : 0.0);
+          C.LastReported = C.Value;
+        }
+      });
+    });
+  }
+
+  *Output << "\n";
+  Output->flush();
+
+  LastReport = Now;
+  NextReport = Now + seconds(ProgressInterval);
+}
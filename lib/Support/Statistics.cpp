@@ -5,6 +5,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <fstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Statistics.h"
 
@@ -22,6 +30,13 @@ static cl::alias A1("T",
                     cl::aliasopt(Statistics),
                     cl::cat(MainCategory));
 
+static cl::opt<std::string> StatisticsOutput("statistics-output",
+                                             cl::desc("write the statistics "
+                                                      "as JSON to this file "
+                                                      "upon exit or SIGINT"),
+                                             cl::value_desc("path"),
+                                             cl::cat(MainCategory));
+
 struct Handler {
   int Signal;
   bool Restore;
@@ -36,15 +51,26 @@ static std::array<Handler, 3> Handlers = { { { SIGINT, true, {}, {} },
                                              { SIGUSR1, false, {}, {} } } };
 
 llvm::ManagedStatic<OnQuitRegistry> OnQuitStatistics;
+llvm::ManagedStatic<PhaseTimers> Timers;
+llvm::ManagedStatic<MemoryGaugeRegistry> MemoryGauges;
 
 void installStatistics() {
-  if (Statistics)
+  if (Statistics or StatisticsOutput.getNumOccurrences() > 0)
     OnQuitStatistics->install();
 }
 
 static void onQuit() {
-  dbg << "\n";
-  OnQuitStatistics->dump();
+  if (Statistics) {
+    dbg << "\n";
+    OnQuitStatistics->dump();
+  }
+
+  if (StatisticsOutput.getNumOccurrences() > 0) {
+    std::error_code EC;
+    llvm::raw_fd_ostream Output(StatisticsOutput, EC, llvm::sys::fs::OF_Text);
+    revng_check(not EC, "Couldn't open the statistics output file");
+    OnQuitStatistics->toJSON(Output);
+  }
 }
 
 static void onQuitSignalHandler(int Signal) {
@@ -87,3 +113,108 @@ void RunningStatistics::onQuit() {
 
 OnQuitInteraface::~OnQuitInteraface() {
 }
+
+static void dumpPhase(std::ostream &Output,
+                      const PhaseTimers::Phase &P,
+                      unsigned Depth) {
+  using namespace std::chrono;
+  double Wall = duration_cast<duration<double>>(P.Wall).count();
+  double CPU = static_cast<double>(P.CPU) / CLOCKS_PER_SEC;
+
+  Output << std::string(2 * Depth, ' ') << P.Name << ": ";
+  Output << "{ wall: " << Wall << " s "
+         << "cpu: " << CPU << " s "
+         << "calls: " << P.Calls;
+  if (P.HasCounters) {
+    for (unsigned I = 0; I < PerfCounter::Count; ++I) {
+      auto Counter = static_cast<PerfCounter::Values>(I);
+      Output << " " << PerfCounter::getName(Counter) << ": " << P.Counters[I];
+    }
+  }
+  Output << " }\n";
+
+  for (const std::unique_ptr<PhaseTimers::Phase> &Child : P.Children)
+    dumpPhase(Output, *Child, Depth + 1);
+}
+
+void PhaseTimers::dump(std::ostream &Output) const {
+  if (Root.Children.empty())
+    return;
+
+  Output << "Timers:\n";
+  for (const std::unique_ptr<Phase> &Child : Root.Children)
+    dumpPhase(Output, *Child, 1);
+}
+
+static void phaseToJSON(llvm::json::OStream &Output,
+                        const PhaseTimers::Phase &P) {
+  using namespace std::chrono;
+  Output.object([&]() {
+    Output.attribute("name", P.Name);
+    Output.attribute("wall", duration_cast<duration<double>>(P.Wall).count());
+    Output.attribute("cpu", static_cast<double>(P.CPU) / CLOCKS_PER_SEC);
+    Output.attribute("calls", static_cast<int64_t>(P.Calls));
+    Output.attribute("rss", static_cast<int64_t>(P.RSS));
+    Output.attribute("peak-rss", static_cast<int64_t>(P.PeakRSS));
+    if (P.HasCounters) {
+      for (unsigned I = 0; I < PerfCounter::Count; ++I) {
+        auto Counter = static_cast<PerfCounter::Values>(I);
+        Output.attribute(PerfCounter::getName(Counter),
+                         static_cast<int64_t>(P.Counters[I]));
+      }
+    }
+    if (not P.Children.empty()) {
+      Output.attributeArray("children", [&]() {
+        for (const std::unique_ptr<PhaseTimers::Phase> &Child : P.Children)
+          phaseToJSON(Output, *Child);
+      });
+    }
+  });
+}
+
+void PhaseTimers::toJSON(llvm::json::OStream &Output) {
+  Output.attributeArray("timers", [this, &Output]() {
+    for (const std::unique_ptr<Phase> &Child : Root.Children)
+      phaseToJSON(Output, *Child);
+  });
+}
+
+void PhaseTimers::sampleMemory(Phase *P) {
+  // ru_maxrss is in kilobytes
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) == 0)
+    P->PeakRSS = static_cast<uint64_t>(Usage.ru_maxrss) * 1024;
+
+  // The second field of statm is the number of resident pages
+  std::ifstream StatM("/proc/self/statm");
+  uint64_t Size = 0;
+  uint64_t Resident = 0;
+  if (StatM >> Size >> Resident)
+    P->RSS = Resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+void MemoryGaugeRegistry::dump(std::ostream &Output) const {
+  if (Gauges.empty())
+    return;
+
+  const uint64_t KiB = 1024;
+  Output << "Memory gauges (KiB):\n";
+  for (const std::unique_ptr<Gauge> &G : Gauges) {
+    Output << "  " << G->Name << ": "
+           << "{ at peak RSS: " << G->AtPeakRSS / KiB << " "
+           << "peak: " << G->Peak / KiB << " "
+           << "current: " << G->Current / KiB << " }\n";
+  }
+}
+
+void MemoryGaugeRegistry::toJSON(llvm::json::OStream &Output) {
+  Output.attributeObject("memory-gauges", [this, &Output]() {
+    for (const std::unique_ptr<Gauge> &G : Gauges) {
+      Output.attributeObject(G->Name, [&G, &Output]() {
+        Output.attribute("at-peak-rss", static_cast<int64_t>(G->AtPeakRSS));
+        Output.attribute("peak", static_cast<int64_t>(G->Peak));
+        Output.attribute("current", static_cast<int64_t>(G->Current));
+      });
+    }
+  });
+}
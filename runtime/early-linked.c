@@ -10,5 +10,6 @@
 // symbols that are needed by revng
 intptr_t ignore(void) {
   return (intptr_t) &saved_registers + (intptr_t) &setjmp
-         + (intptr_t) &jmp_buffer + (intptr_t) &is_executable;
+         + (intptr_t) &jmp_buffer + (intptr_t) &unwind_buffer
+         + (intptr_t) &is_executable;
 }
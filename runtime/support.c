@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <elf.h>
 #include <endian.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <stdbool.h>
@@ -14,8 +15,10 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/ucontext.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <unwind.h>
 
@@ -53,6 +56,7 @@ static const unsigned align = sizeof(target_reg);
 
 // Define some variables declared in support.h
 jmp_buf jmp_buffer;
+jmp_buf unwind_buffer;
 target_reg *saved_registers;
 
 // Default SIGSEGV handler
@@ -206,13 +210,34 @@ static void *prepare_stack(void *stack, int argc, char **argv) {
 // Helper functions we need
 void target_set_brk(target_reg new_brk);
 void syscall_init(void);
-
-// Variables and functions required by helpers
+target_reg do_syscall(void *cpu_env,
+                      int num,
+                      target_reg arg1,
+                      target_reg arg2,
+                      target_reg arg3,
+                      target_reg arg4,
+                      target_reg arg5,
+                      target_reg arg6,
+                      target_reg arg7,
+                      target_reg arg8);
+
+// Variables and functions required by helpers, the page size is set by
+// init_page_size
 uintptr_t qemu_real_host_page_size = 1 << 12;
 uintptr_t qemu_real_host_page_mask = ~((1 << 12) - 1);
 uintptr_t qemu_host_page_size = 1 << 12;
 uintptr_t qemu_host_page_mask = ~((1 << 12) - 1);
 
+static void init_page_size(void) {
+  long page_size = sysconf(_SC_PAGESIZE);
+  assert(page_size > 0 && (page_size & (page_size - 1)) == 0);
+
+  qemu_real_host_page_size = page_size;
+  qemu_real_host_page_mask = ~(qemu_real_host_page_size - 1);
+  qemu_host_page_size = qemu_real_host_page_size;
+  qemu_host_page_mask = qemu_real_host_page_mask;
+}
+
 void page_set_flags(target_reg start, target_reg end, int flags) {
 }
 
@@ -223,26 +248,167 @@ const char *path(const char *name) {
   return name;
 }
 
-void *g_realloc(void *mem, size_t size) {
-  return realloc(mem, size);
+// glib allocation functions used by the helpers. Small blocks are recycled
+// through thread-local free lists, one for each power-of-two size class, so
+// that helpers allocating and releasing memory in a loop do not stress malloc.
+// Each block is preceded by a header recording its size class, therefore
+// g_free and g_realloc only accept memory obtained from these functions.
+
+// The smallest size class holds 16 bytes, the largest 2 KiB
+#define G_ALLOC_MIN_SHIFT 4
+#define G_ALLOC_CLASSES 8
+
+// Blocks larger than the largest size class go straight to malloc
+#define G_ALLOC_LARGE G_ALLOC_CLASSES
+
+// Maximum number of blocks of each class kept by a thread
+#define G_ALLOC_MAX_CACHED 256
+
+typedef struct g_header {
+  _Alignas(16) size_t size_class;
+  // Size of the block, excluding the header
+  size_t size;
+} g_header;
+
+typedef struct g_free_block {
+  struct g_free_block *next;
+} g_free_block;
+
+static __thread g_free_block *g_free_lists[G_ALLOC_CLASSES];
+static __thread unsigned g_free_lists_length[G_ALLOC_CLASSES];
+
+// Set REVNG_ALLOC_STATS to print on exit how many allocations have been served
+// from the free lists
+static bool g_alloc_stats = false;
+static uint64_t g_alloc_hits = 0;
+static uint64_t g_alloc_misses = 0;
+static uint64_t g_alloc_large = 0;
+
+static void count_allocation(uint64_t *counter) {
+  if (g_alloc_stats)
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
 }
 
-void *g_malloc0_n(size_t n, size_t size) {
-  return calloc(n, size);
+static void dump_alloc_stats(void) {
+  fprintf(stderr,
+          "g_malloc: %" PRIu64 " from the free lists, %" PRIu64
+          " small and %" PRIu64 " large from malloc\n",
+          g_alloc_hits,
+          g_alloc_misses,
+          g_alloc_large);
 }
 
-void *g_malloc(size_t n_bytes) {
-  if (n_bytes == 0)
-    return NULL;
-  else
-    return malloc(n_bytes);
+static void init_alloc_stats(void) {
+  char *enabled = getenv("REVNG_ALLOC_STATS");
+  if (enabled == NULL || strlen(enabled) == 0)
+    return;
+
+  g_alloc_stats = true;
+  int result = atexit(dump_alloc_stats);
+  assert(result == 0);
+}
+
+static size_t g_size_class(size_t size) {
+  size_t size_class = 0;
+  while (size_class < G_ALLOC_CLASSES
+         && size > ((size_t) 1 << (size_class + G_ALLOC_MIN_SHIFT)))
+    size_class++;
+  return size_class;
+}
+
+static g_header *g_header_of(void *memory) {
+  return ((g_header *) memory) - 1;
+}
+
+static void *g_allocate(size_t size) {
+  size_t size_class = g_size_class(size);
+  g_header *header = NULL;
+
+  if (size_class == G_ALLOC_LARGE) {
+    count_allocation(&g_alloc_large);
+    header = malloc(sizeof(g_header) + size);
+    if (header == NULL)
+      return NULL;
+    header->size = size;
+  } else if (g_free_lists[size_class] != NULL) {
+    count_allocation(&g_alloc_hits);
+    g_free_block *block = g_free_lists[size_class];
+    g_free_lists[size_class] = block->next;
+    g_free_lists_length[size_class]--;
+    header = g_header_of(block);
+  } else {
+    count_allocation(&g_alloc_misses);
+    size_t capacity = (size_t) 1 << (size_class + G_ALLOC_MIN_SHIFT);
+    header = malloc(sizeof(g_header) + capacity);
+    if (header == NULL)
+      return NULL;
+    header->size = capacity;
+  }
+
+  header->size_class = size_class;
+  return header + 1;
 }
 
 void g_free(void *memory) {
   if (memory == NULL)
     return;
+
+  g_header *header = g_header_of(memory);
+  size_t size_class = header->size_class;
+  if (size_class == G_ALLOC_LARGE
+      || g_free_lists_length[size_class] == G_ALLOC_MAX_CACHED) {
+    free(header);
+    return;
+  }
+
+  // Blocks freed by another thread end up in the free lists of this one
+  g_free_block *block = memory;
+  block->next = g_free_lists[size_class];
+  g_free_lists[size_class] = block;
+  g_free_lists_length[size_class]++;
+}
+
+void *g_realloc(void *mem, size_t size) {
+  if (mem == NULL)
+    return size == 0 ? NULL : g_allocate(size);
+
+  if (size == 0) {
+    g_free(mem);
+    return NULL;
+  }
+
+  // Keep the block if it's large enough
+  g_header *header = g_header_of(mem);
+  if (header->size_class != G_ALLOC_LARGE && size <= header->size)
+    return mem;
+
+  void *result = g_allocate(size);
+  if (result == NULL)
+    return NULL;
+
+  memcpy(result, mem, size < header->size ? size : header->size);
+  g_free(mem);
+  return result;
+}
+
+void *g_malloc0_n(size_t n, size_t size) {
+  if (n == 0 || size == 0)
+    return NULL;
+
+  if (size > SIZE_MAX / n)
+    return NULL;
+
+  void *result = g_allocate(n * size);
+  if (result != NULL)
+    memset(result, 0, n * size);
+  return result;
+}
+
+void *g_malloc(size_t n_bytes) {
+  if (n_bytes == 0)
+    return NULL;
   else
-    return free(memory);
+    return g_allocate(n_bytes);
 }
 
 void unknownPC() {
@@ -257,42 +423,134 @@ void unknownPC() {
   abort();
 }
 
+// Coverage support, the following symbols are emitted by the
+// instrument-coverage pass, if it has been run
+extern uint64_t revng_coverage_counters[] __attribute__((weak));
+extern const uint64_t revng_coverage_pcs[] __attribute__((weak));
+extern const uint64_t revng_coverage_count __attribute__((weak));
+
+static const char *coverage_path = NULL;
+
+static void dump_coverage(void) {
+  if (coverage_path == NULL)
+    return;
+
+  FILE *output = fopen(coverage_path, "w");
+  assert(output != NULL);
+
+  // Dump the hit count of each jump target
+  fprintf(output, "pc,hits\n");
+  for (uint64_t i = 0; i < revng_coverage_count; i++)
+    fprintf(output,
+            "0x%" PRIx64 ",%" PRIu64 "\n",
+            revng_coverage_pcs[i],
+            revng_coverage_counters[i]);
+
+  fclose(output);
+
+  // Dump only once
+  coverage_path = NULL;
+}
+
+void init_coverage(void) {
+  // If REVNG_COVERAGE_PATH contains a path and the program has been
+  // instrumented, dump the coverage upon exit
+  char *path = getenv("REVNG_COVERAGE_PATH");
+  if (path == NULL || strlen(path) == 0 || &revng_coverage_count == NULL)
+    return;
+
+  coverage_path = path;
+  int result = atexit(dump_coverage);
+  assert(result == 0);
+}
+
 #ifdef TRACE
 
-// Execution tracing support
+// Execution tracing support. With REVNG_TRACE_PATH, the trace is the program
+// counter of each executed instruction, as a native uint64_t. With
+// REVNG_COMPACT_TRACE_PATH, see REVNG_COMPACT_TRACE_MAGIC for the format.
 static int trace_fd = -1;
-static size_t trace_buffer_size = 1024 * 1024;
+static bool trace_compact = false;
+static size_t trace_buffer_size = 1024 * 1024 * sizeof(uint64_t);
 static size_t trace_buffer_index = 0;
-static uint64_t *trace_buffer;
+static uint8_t *trace_buffer;
+
+// PC of the last record
+static uint64_t trace_last_pc = 0;
+
+// PC of the next instruction, if execution proceeds sequentially
+static uint64_t trace_next_pc = 0;
+
+// Record only one out of trace_sampling_period control-flow entries
+static uint64_t trace_sampling_period = 1;
+static uint64_t trace_sampling_counter = 0;
+
+// A 64-bit value takes at most 10 bytes in LEB128
+#define TRACE_MAX_RECORD_SIZE 10
 
 static void flush_trace_buffer(void);
 
 void flush_trace_buffer(void);
 void flush_trace_buffer_signal_handler(int signal);
 
+static uint64_t parse_trace_variable(const char *name, uint64_t fallback) {
+  char *string = getenv(name);
+  if (string == NULL || strlen(string) == 0)
+    return fallback;
+
+  char *first_invalid = NULL;
+  uint64_t result = strtoull(string, &first_invalid, 0);
+  assert(*first_invalid == '\0');
+  return result;
+}
+
 void init_tracing(void) {
-  // If REVNG_TRACE_PATH contains a path, enable tracing
-  char *trace_path = getenv("REVNG_TRACE_PATH");
+  // If REVNG_COMPACT_TRACE_PATH or REVNG_TRACE_PATH contains a path, enable
+  // tracing
+  char *trace_path = getenv("REVNG_COMPACT_TRACE_PATH");
+  trace_compact = trace_path != NULL && strlen(trace_path) > 0;
+  if (!trace_compact)
+    trace_path = getenv("REVNG_TRACE_PATH");
+
   if (trace_path != NULL && strlen(trace_path) > 0) {
     trace_fd = open(trace_path,
                     O_WRONLY | O_CREAT | O_TRUNC,
                     S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
     assert(trace_fd != -1);
 
-    // Set REVNG_TRACE_BUFFER_SIZE to customimze buffer size, default is 1024
-    // * 1024 instructions
-    char *trace_buffer_size_string = getenv("REVNG_TRACE_BUFFER_SIZE");
-    if (trace_buffer_size_string != NULL
-        && strlen(trace_buffer_size_string) > 0) {
-      char **first_invalid = NULL;
-      trace_buffer_size = strtoll(trace_buffer_size_string, first_invalid, 0);
-      assert(**first_invalid == '\0');
+    if (trace_compact) {
+      // Set REVNG_COMPACT_TRACE_BUFFER_SIZE to customize the buffer size in
+      // bytes, default is 8 MiB
+      const char *size_name = "REVNG_COMPACT_TRACE_BUFFER_SIZE";
+      trace_buffer_size = parse_trace_variable(size_name, trace_buffer_size);
+      assert(trace_buffer_size >= TRACE_MAX_RECORD_SIZE);
+
+      // Set REVNG_TRACE_SAMPLING_PERIOD to N to record only one out of N
+      // control-flow entries, default is 1 (record all of them)
+      const char *period_name = "REVNG_TRACE_SAMPLING_PERIOD";
+      trace_sampling_period = parse_trace_variable(period_name, 1);
+      assert(trace_sampling_period != 0);
+    } else {
+      // Set REVNG_TRACE_BUFFER_SIZE to customimze buffer size, default is 1024
+      // * 1024 instructions
+      uint64_t instructions = parse_trace_variable("REVNG_TRACE_BUFFER_SIZE",
+                                                   1024 * 1024);
+      assert(instructions != 0);
+      trace_buffer_size = instructions * sizeof(uint64_t);
     }
 
     // Allocate buffer to hold program counters
-    trace_buffer = malloc(trace_buffer_size * sizeof(uint64_t));
+    trace_buffer = malloc(trace_buffer_size);
     assert(trace_buffer != NULL);
 
+    // Emit the header of the compact format
+    if (trace_compact) {
+      ssize_t written = write(trace_fd,
+                              REVNG_COMPACT_TRACE_MAGIC,
+                              REVNG_COMPACT_TRACE_MAGIC_SIZE);
+      assert(written == REVNG_COMPACT_TRACE_MAGIC_SIZE);
+    }
+
     // In case of a crash, flush the buffer
     static const int signals[] = { SIGINT, SIGABRT, SIGTERM, SIGSEGV };
     for (unsigned c = 0; c < sizeof(signals) / sizeof(int); c++) {
@@ -316,7 +574,7 @@ static void flush_trace_buffer(void) {
     return;
 
   // Write the all buffer out and reset the counter
-  write(trace_fd, trace_buffer, sizeof(uint64_t) * trace_buffer_index);
+  write(trace_fd, trace_buffer, trace_buffer_index);
   trace_buffer_index = 0;
 }
 
@@ -327,6 +585,7 @@ void flush_trace_buffer_signal_handler(int signal) {
 // This function is called by the syscall helpers in case of exit/exit_group
 void on_exit_syscall(void) {
   flush_trace_buffer();
+  dump_coverage();
 }
 
 void newpc(uint64_t pc,
@@ -338,12 +597,44 @@ void newpc(uint64_t pc,
   if (trace_fd == -1)
     return;
 
-  // Record the program counter
-  trace_buffer[trace_buffer_index++] = pc;
+  if (!trace_compact) {
+    // Record the program counter
+    memcpy(trace_buffer + trace_buffer_index, &pc, sizeof(pc));
+    trace_buffer_index += sizeof(pc);
+
+    // If the buffer is full, flush it out
+    if (trace_buffer_index + sizeof(pc) > trace_buffer_size)
+      flush_trace_buffer();
+    return;
+  }
+
+  // Sequential execution can be reconstructed, record only control flow
+  bool is_sequential = pc == trace_next_pc;
+  trace_next_pc = pc + instruction_size;
+  if (is_sequential)
+    return;
 
-  // If the buffer is full, flush it out
-  if (trace_buffer_index >= trace_buffer_size)
+  // Skip the entries not selected by sampling
+  if (++trace_sampling_counter < trace_sampling_period)
+    return;
+  trace_sampling_counter = 0;
+
+  // Make sure there's room for the record
+  if (trace_buffer_index + TRACE_MAX_RECORD_SIZE > trace_buffer_size)
     flush_trace_buffer();
+
+  // Record the zigzag-encoded delta from the previous record in LEB128
+  uint64_t delta = pc - trace_last_pc;
+  uint64_t value = (delta << 1) ^ (uint64_t) ((int64_t) delta >> 63);
+  trace_last_pc = pc;
+
+  do {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    if (value != 0)
+      byte |= 0x80;
+    trace_buffer[trace_buffer_index++] = byte;
+  } while (value != 0);
 }
 
 #else
@@ -352,6 +643,7 @@ void init_tracing(void) {
 }
 
 void on_exit_syscall(void) {
+  dump_coverage();
 }
 
 void newpc(uint64_t pc,
@@ -368,12 +660,20 @@ void newpc(uint64_t pc,
 bool is_executable(uint64_t pc) {
   assert(segments_count != 0);
 
-  // Check if the pc is inside one of the executable segments
-  for (int i = 0; i < segments_count; i++)
-    if (pc >= segment_boundaries[2 * i] && pc < segment_boundaries[2 * i + 1])
-      return true;
+  // Look for the last segment starting at or before pc, the segments are
+  // sorted and disjoint
+  uint64_t low = 0;
+  uint64_t high = segments_count;
+  while (low < high) {
+    uint64_t middle = low + (high - low) / 2;
+    if (segment_boundaries[2 * middle] <= pc)
+      low = middle + 1;
+    else
+      high = middle;
+  }
 
-  return false;
+  // Check if the pc is inside such segment
+  return low != 0 && pc < segment_boundaries[2 * (low - 1) + 1];
 }
 
 void handle_sigsegv(int signo, siginfo_t *info, void *opaque_context) {
@@ -401,40 +701,276 @@ void install_sigsegv_handler(void) {
   assert(result == 0);
 }
 
+// File descriptors used by the fuzzer to talk to the fork server (AFL)
+#define FORK_SERVER_CONTROL_FD 198
+#define FORK_SERVER_STATUS_FD (FORK_SERVER_CONTROL_FD + 1)
+
+// If REVNG_FORK_SERVER is set, fork a new child each time the fuzzer asks for
+// it. Only the children return from this function.
+static void fork_server(void) {
+  char *enabled = getenv("REVNG_FORK_SERVER");
+  if (enabled == NULL || strlen(enabled) == 0)
+    return;
+
+  // Tell the fuzzer we're ready, if nobody is listening run normally
+  uint32_t message = 0;
+  if (write(FORK_SERVER_STATUS_FD, &message, sizeof(message))
+      != sizeof(message))
+    return;
+
+  while (true) {
+    // Wait for the fuzzer to request a new run
+    if (read(FORK_SERVER_CONTROL_FD, &message, sizeof(message))
+        != sizeof(message))
+      _exit(EXIT_FAILURE);
+
+    pid_t child = fork();
+    if (child < 0)
+      _exit(EXIT_FAILURE);
+
+    if (child == 0) {
+      close(FORK_SERVER_CONTROL_FD);
+      close(FORK_SERVER_STATUS_FD);
+      return;
+    }
+
+    // Report the PID of the child, then its exit status
+    int status = child;
+    if (write(FORK_SERVER_STATUS_FD, &status, sizeof(status)) != sizeof(status))
+      _exit(EXIT_FAILURE);
+
+    if (waitpid(child, &status, 0) < 0)
+      _exit(EXIT_FAILURE);
+
+    if (write(FORK_SERVER_STATUS_FD, &status, sizeof(status)) != sizeof(status))
+      _exit(EXIT_FAILURE);
+  }
+}
+
+// Syscalls issued directly to the host when the guest architecture matches the
+// host one (see revng-lift -syscall-passthrough)
+#define SYSCALL_PASSTHROUGH_MAX 1024
+static uint8_t syscall_passthrough[SYSCALL_PASSTHROUGH_MAX / 8];
+
+#if (defined(TARGET_x86_64) && defined(__x86_64__))    \
+  || (defined(TARGET_i386) && defined(__i386__))       \
+  || (defined(TARGET_aarch64) && defined(__aarch64__)) \
+  || (defined(TARGET_arm) && defined(__arm__))
+#define GUEST_IS_HOST
+#endif
+
+// Parse the comma-separated list of syscall numbers in
+// REVNG_SYSCALL_PASSTHROUGH
+static void init_syscall_passthrough(void) {
+#ifdef GUEST_IS_HOST
+  char *list = getenv("REVNG_SYSCALL_PASSTHROUGH");
+  if (list == NULL)
+    return;
+
+  while (*list != '\0') {
+    char *end = NULL;
+    unsigned long num = strtoul(list, &end, 0);
+    if (end == list) {
+      fprintf(stderr, "Invalid REVNG_SYSCALL_PASSTHROUGH entry: %s\n", list);
+      exit(EXIT_FAILURE);
+    }
+
+    // exit and exit_group have to go through on_exit_syscall
+    if (num < SYSCALL_PASSTHROUGH_MAX && num != SYS_exit
+        && num != SYS_exit_group)
+      syscall_passthrough[num / 8] |= 1 << (num % 8);
+
+    list = *end == ',' ? end + 1 : end;
+  }
+#endif
+}
+
+// Size of the guest stack
+#define GUEST_STACK_SIZE (16 * 0x100000)
+
+// Huge pages backing the guest memory, selected by REVNG_HUGE_PAGES
+enum huge_pages_mode {
+  NO_HUGE_PAGES,
+  TRANSPARENT_HUGE_PAGES,
+  EXPLICIT_HUGE_PAGES
+};
+static enum huge_pages_mode huge_pages = NO_HUGE_PAGES;
+static uintptr_t huge_page_size = 2 * 0x100000;
+
+// End of the part of the brk area already advised to use huge pages
+static uintptr_t huge_pages_brk = 0;
+
+static void init_huge_pages(void) {
+  char *mode = getenv("REVNG_HUGE_PAGES");
+  if (mode == NULL || strlen(mode) == 0)
+    return;
+
+  if (strcmp(mode, "transparent") == 0) {
+    huge_pages = TRANSPARENT_HUGE_PAGES;
+  } else if (strcmp(mode, "explicit") == 0) {
+    huge_pages = EXPLICIT_HUGE_PAGES;
+  } else {
+    fprintf(stderr, "Invalid REVNG_HUGE_PAGES value: %s\n", mode);
+    exit(EXIT_FAILURE);
+  }
+
+  // Use the size of the huge pages the kernel actually uses, if available
+  const char *path = "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size";
+  FILE *input = fopen(path, "r");
+  if (input != NULL) {
+    unsigned long size = 0;
+    if (fscanf(input, "%lu", &size) == 1 && size > qemu_real_host_page_size
+        && (size & (size - 1)) == 0)
+      huge_page_size = size;
+    fclose(input);
+  }
+}
+
+// Ask the kernel to back with transparent huge pages the huge pages fully
+// contained in [start, end)
+static void advise_huge_pages(uintptr_t start, uintptr_t end) {
+  if (huge_pages == NO_HUGE_PAGES)
+    return;
+
+  start = (start + huge_page_size - 1) & ~(huge_page_size - 1);
+  end = end & ~(huge_page_size - 1);
+  if (start < end)
+    madvise((void *) start, end - start, MADV_HUGEPAGE);
+}
+
+// Map anonymous guest memory, using huge pages if requested
+static void *map_guest_memory(size_t size) {
+  const int flags = MAP_ANONYMOUS | MAP_32BIT | MAP_PRIVATE;
+  const int prot = PROT_READ | PROT_WRITE;
+
+  if (huge_pages == EXPLICIT_HUGE_PAGES && size % huge_page_size == 0) {
+    void *result = mmap(NULL, size, prot, flags | MAP_HUGETLB, -1, 0);
+    if (result != MAP_FAILED)
+      return result;
+
+    // No huge pages have been reserved, try with transparent huge pages
+    fprintf(stderr, "Cannot map %zu bytes with huge pages\n", size);
+  }
+
+  void *result = mmap(NULL, size, prot, flags, -1, 0);
+  assert(result != MAP_FAILED);
+  advise_huge_pages((uintptr_t) result, (uintptr_t) result + size);
+  return result;
+}
+
+// Advise the kernel to use huge pages for the anonymous memory mapped by the
+// guest with passed through mmap and brk syscalls
+static void advise_guest_mapping(int num,
+                                 target_reg result,
+                                 target_reg length,
+                                 target_reg flags) {
+#ifdef GUEST_IS_HOST
+  // Errors are reported as -errno
+  if (huge_pages == NO_HUGE_PAGES || result > (target_reg) -4096)
+    return;
+
+  switch (num) {
+#ifdef SYS_mmap
+  case SYS_mmap:
+#endif
+#ifdef SYS_mmap2
+  case SYS_mmap2:
+#endif
+    if ((flags & MAP_ANONYMOUS) != 0 && length >= huge_page_size)
+      advise_huge_pages(result, result + length);
+    break;
+
+  case SYS_brk:
+    if (result > huge_pages_brk) {
+      advise_huge_pages(huge_pages_brk, result);
+      huge_pages_brk = result & ~(huge_page_size - 1);
+    }
+    break;
+
+  default:
+    break;
+  }
+#else
+  (void) num;
+  (void) result;
+  (void) length;
+  (void) flags;
+#endif
+}
+
+// The translated program calls this function in place of QEMU's do_syscall.
+// The syscalls selected in REVNG_SYSCALL_PASSTHROUGH are forwarded to the host
+// as they are: guest and host share the syscall ABI and the address space.
+target_reg revng_do_syscall(void *cpu_env,
+                            int num,
+                            target_reg arg1,
+                            target_reg arg2,
+                            target_reg arg3,
+                            target_reg arg4,
+                            target_reg arg5,
+                            target_reg arg6,
+                            target_reg arg7,
+                            target_reg arg8) {
+  if (num >= 0 && num < SYSCALL_PASSTHROUGH_MAX
+      && (syscall_passthrough[num / 8] & (1 << (num % 8))) != 0) {
+    long result = syscall(num, arg1, arg2, arg3, arg4, arg5, arg6);
+
+    // Like do_syscall, report errors as -errno
+    if (result == -1)
+      return (target_reg) -errno;
+    return (target_reg) result;
+  }
+
+  target_reg result = do_syscall(cpu_env,
+                                 num,
+                                 arg1,
+                                 arg2,
+                                 arg3,
+                                 arg4,
+                                 arg5,
+                                 arg6,
+                                 arg7,
+                                 arg8);
+  advise_guest_mapping(num, result, arg2, arg4);
+  return result;
+}
+
 int main(int argc, char *argv[]) {
   // Save the program arguments for error reporting purposes
   saved_argc = argc;
   saved_argv = argv;
 
+  init_page_size();
+  init_huge_pages();
+  init_alloc_stats();
+
   // Initialize the tracing system
   init_tracing();
+  init_coverage();
 
   // Allocate and initialize the stack
-  void *stack = mmap((void *) NULL,
-                     16 * 0x100000,
-                     PROT_READ | PROT_WRITE,
-                     MAP_ANONYMOUS | MAP_32BIT | MAP_PRIVATE,
-                     -1,
-                     0)
-                + 16 * 0x100000 - 0x1000;
-  assert(stack != NULL);
+  void *stack = map_guest_memory(GUEST_STACK_SIZE) + GUEST_STACK_SIZE
+                - qemu_host_page_size;
   stack = prepare_stack(stack, argc, argv);
 
-  // Allocate the brk page
+  // Allocate the brk page. The brk area is grown by QEMU, it can only be
+  // backed by transparent huge pages, see advise_guest_mapping.
   void *brk = mmap((void *) NULL,
-                   0x1000,
+                   qemu_host_page_size,
                    PROT_READ | PROT_WRITE,
                    MAP_ANONYMOUS | MAP_32BIT | MAP_PRIVATE,
                    -1,
                    0);
-  assert(brk != NULL);
-  brk += 0x1000;
+  assert(brk != MAP_FAILED);
+  brk += qemu_host_page_size;
+  huge_pages_brk = (uintptr_t) brk;
 
   SAFE_CAST(brk);
   target_set_brk((target_reg) brk);
 
   // Initialize the syscall system
   syscall_init();
+  init_syscall_passthrough();
 
   // Implant custom SIGSEGV handler
   install_sigsegv_handler();
@@ -446,6 +982,9 @@ int main(int argc, char *argv[]) {
   set_register(REGISTER_FS, fs_value);
 #endif
 
+  // Everything is initialized, from now on each fork server child is a run
+  fork_server();
+
   // Run the translated program
   SAFE_CAST(stack);
   root((target_reg) stack);
@@ -512,3 +1051,13 @@ noreturn void raise_exception_helper(Reason Code,
 
   abort();
 }
+
+// Helper function used to get back to the root function, alternative to
+// raise_exception_helper
+noreturn void unwind_to_root_helper(Reason Code,
+                                    target_reg Source,
+                                    target_reg Target,
+                                    target_reg ExpectedDestination) {
+  exception_warning(Code, Source, Target, ExpectedDestination);
+  longjmp(unwind_buffer, 1);
+}
@@ -93,6 +93,7 @@ typedef uint64_t target_reg;
 // Register values before the signal was triggered
 extern target_reg *saved_registers;
 
+// Start and end address of each executable segment, sorted and disjoint
 extern uint64_t *segment_boundaries;
 extern uint64_t segments_count;
 
@@ -104,5 +105,9 @@ extern target_reg e_phnum;
 // Setjmp/longjmp buffer
 extern jmp_buf jmp_buffer;
 
+// Setjmp/longjmp buffer used to get back to the root function from isolated
+// functions (see -isolate-longjmp-unwind)
+extern jmp_buf unwind_buffer;
+
 bool is_executable(uint64_t pc);
 void set_register(uint32_t register_id, uint64_t value);
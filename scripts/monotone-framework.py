@@ -199,7 +199,172 @@ def check_transfer_functions(tf_graph, reachability, transfer_functions):
 
   return result
 
-def process_graph(path, call_arcs):
+def emit_switches(name,
+                  lattice,
+                  reachability,
+                  result,
+                  tf_names,
+                  transfer_functions):
+  out = ""
+
+  # Emit the combine operator
+  out += ("""  void combine(const {} &Other) {{
+""".format(name))
+
+  first = True
+  for output, pairs in sorted(result.items(), key=lambda x: x[0]):
+    if first:
+      out += ("""    if (""")
+    else:
+      out += (""" else if (""")
+    conditions = []
+    for this, other in sorted(pairs, key=lambda x: (x[0].name, x[1].name)):
+      condition = "(Value == {} && Other.Value == {})"
+      condition = condition.format(this.name, other.name)
+      conditions.append(condition)
+    conditions[0] = conditions[0].lstrip()
+    conditions_string = ("\n        || "
+                         if first
+                         else "\n               || ")
+    out += conditions_string.join(conditions)
+    out += (""") {{
+      Value = {};
+    }}""".format(output.name))
+    first = False
+
+  out += ("""
+  }
+
+""")
+
+  # Emit the comparison operator of the lattice
+  out += ("""  bool lowerThanOrEqual(const {} &Other) const {{
+    return Value == Other.Value
+      || """.format(name, name))
+
+  conditions = []
+  for v1 in sorted(lattice.nodes_iter(), key=lambda x: x.name):
+    for v2 in sorted(lattice.nodes_iter(), key=lambda x: x.name):
+      if v1 != v2:
+        i1 = int(v1.attr["index"])
+        i2 = int(v2.attr["index"])
+        if reachability[i1][i2] != 0:
+          condition = """(Value == {} && Other.Value == {})"""
+          condition = condition.format(v1.name, v2.name)
+          conditions.append(condition)
+
+  out += ("\n      || ".join(conditions))
+  out += (""";
+  }
+
+""")
+
+  # Emit the transfer function implementation
+  out += ("""  void transfer(TransferFunction T) {{
+    switch(T) {{
+""".format(name))
+  for tf in tf_names:
+    out += ("""    case {}:
+      switch(Value) {{
+""".format(tf))
+    for edge in transfer_functions[tf]:
+      source, destination = edge
+      out += ("""      case {}:
+        Value = {};
+        break;
+""".format(source, destination))
+    out += ("""      default:
+        break;
+      }
+      break;
+
+""")
+
+  out += ("""    }
+  }
+
+""")
+
+  return out
+
+def emit_tables(name,
+                values,
+                lattice,
+                reachability,
+                result,
+                tf_names,
+                transfer_functions):
+  # Same semantics as emit_switches, but combine, lowerThanOrEqual and transfer
+  # become a lookup in a constant table indexed by the lattice values, which
+  # are numbered according to their position in values
+  out = ""
+
+  by_name = dict((v.name, v) for v in lattice.nodes_iter())
+
+  join = {}
+  for output, pairs in result.items():
+    for this, other in pairs:
+      join[(this.name, other.name)] = output.name
+
+  def row(cells):
+    return "{ " + ", ".join(cells) + " }"
+
+  out += ("""  /// \\brief Tables implementing the lattice operations and the transfer
+  ///        functions, indexed by Values (and by TransferFunction)
+  ///
+  /// They can be used to process many packed Values at once.
+  /// @{{
+  static constexpr Values CombineTable[{}][{}] = {{
+""".format(len(values), len(values)))
+  for v1 in values:
+    out += ("    " + row([join.get((v1, v2), v1) for v2 in values]) + ",\n")
+  out += ("""  };
+
+""")
+
+  out += ("""  static constexpr bool LowerThanOrEqualTable[{}][{}] = {{
+""".format(len(values), len(values)))
+  for v1 in values:
+    i1 = int(by_name[v1].attr["index"])
+    cells = []
+    for v2 in values:
+      i2 = int(by_name[v2].attr["index"])
+      cells.append("true" if reachability[i1][i2] != 0 else "false")
+    out += ("    " + row(cells) + ",\n")
+  out += ("""  };
+
+""")
+
+  out += ("""  static constexpr Values TransferTable[{}][{}] = {{
+""".format(len(tf_names), len(values)))
+  for tf in tf_names:
+    mapping = dict((str(source), str(destination))
+                   for source, destination
+                   in transfer_functions[tf])
+    out += ("    " + row([mapping.get(v, v) for v in values]) + ",\n")
+  out += ("""  };
+  /// @}
+
+""")
+
+  out += ("""  void combine(const {} &Other) {{
+    Value = CombineTable[Value][Other.Value];
+  }}
+
+  bool lowerThanOrEqual(const {} &Other) const {{
+    return LowerThanOrEqualTable[Value][Other.Value];
+  }}
+
+  void transfer(TransferFunction T) {{
+    revng_assert(T < {});
+    Value = TransferTable[T][Value];
+  }}
+
+""".format(name, name, len(tf_names)))
+
+  return out
+
+def process_graph(path, call_arcs, tables):
   out = ""
   input_graph = AGraph(path)
 
@@ -228,8 +393,10 @@ def process_graph(path, call_arcs):
 public:
 """.format(name))
 
-  # Print the enumeration of all the possible lattice values
-  out += ("""  enum Values {
+  # Print the enumeration of all the possible lattice values. Use the smallest
+  # possible underlying type: these values are stored for each register and
+  # copied around all the time by the ABI analysis.
+  out += ("""  enum Values : uint8_t {
 """)
 
   # Get the default lattice element (has the "peripheries" property)
@@ -270,14 +437,11 @@ public:
 
 """.format(name, bottom.name, name, default))
 
-  # Emit the combine operator
-  out += ("""  void combine(const {} &Other) {{
-""".format(name))
-
   node_by_index = lambda index: get_unique([x
                                             for x in lattice.nodes_iter()
                                             if x.attr["index"] == str(index)])
 
+  # Compute the result of combining each pair of distinct lattice values
   result = defaultdict(lambda: [])
   for v1 in lattice.nodes_iter():
     for v2 in lattice.nodes_iter():
@@ -295,90 +459,40 @@ public:
         result[output].append((v1, v2))
         assert output in result
 
-  first = True
-  for output, pairs in sorted(result.items(), key=lambda x: x[0]):
-    if first:
-      out += ("""    if (""")
-    else:
-      out += (""" else if (""")
-    conditions = []
-    for this, other in sorted(pairs, key=lambda x: (x[0].name, x[1].name)):
-      condition = "(Value == {} && Other.Value == {})"
-      condition = condition.format(this.name, other.name)
-      conditions.append(condition)
-    conditions[0] = conditions[0].lstrip()
-    conditions_string = ("\n        || "
-                         if first
-                         else "\n               || ")
-    out += conditions_string.join(conditions)
-    out += (""") {{
-      Value = {};
-    }}""".format(output.name))
-    first = False
-
-  out += ("""
-  }
-
-""")
-
-  # Emit the comparison operator of the lattice
-  out += ("""  bool lowerThanOrEqual(const {} &Other) const {{
-    return Value == Other.Value
-      || """.format(name, name))
-
-  result = []
-  for v1 in sorted(lattice.nodes_iter(), key=lambda x: x.name):
-    for v2 in sorted(lattice.nodes_iter(), key=lambda x: x.name):
-      if v1 != v2:
-        i1 = int(v1.attr["index"])
-        i2 = int(v2.attr["index"])
-        if reachability[i1][i2] != 0:
-          condition = """(Value == {} && Other.Value == {})"""
-          condition = condition.format(v1.name, v2.name)
-          result.append(condition)
-
-  out += ("\n      || ".join(result))
-  out += (""";
-  }
-
-""")
-
   tf_names = sorted([e.attr["label"] for e in tf_graph.edges_iter()])
 
+  if tables:
+    out += emit_tables(name,
+                       values,
+                       lattice,
+                       reachability,
+                       result,
+                       tf_names,
+                       transfer_functions)
+  else:
+    out += emit_switches(name,
+                         lattice,
+                         reachability,
+                         result,
+                         tf_names,
+                         transfer_functions)
+
   # Emit the transfer function implementation
-  out += ("""  void transfer(TransferFunction T) {{
+  out += ("""  void transfer(GeneralTransferFunction T) {{
     switch(T) {{
 """.format(name))
   for tf in tf_names:
-    out += ("""    case {}:
-      switch(Value) {{
+    out += ("""    case GeneralTransferFunction::{}:
 """.format(tf))
-    for edge in transfer_functions[tf]:
-      source, destination = edge
-      out += ("""      case {}:
-        Value = {};
-        break;
-""".format(source, destination))
-    out += ("""      default:
-        break;
-      }
+    if tables:
+      out += ("""      transfer({});
       break;
 
-""")
-
-  out += ("""    }
-  }
+""".format(tf))
+      continue
 
+    out += ("""      switch(Value) {
 """)
-
-  # Emit the transfer function implementation
-  out += ("""  void transfer(GeneralTransferFunction T) {{
-    switch(T) {{
-""".format(name))
-  for tf in tf_names:
-    out += ("""    case GeneralTransferFunction::{}:
-      switch(Value) {{
-""".format(tf))
     for edge in transfer_functions[tf]:
       source, destination = edge
       out += ("""      case {}:
@@ -470,6 +584,10 @@ def main():
   parser.add_argument("--call-arcs",
                       action="store_true",
                       help="Add call arcs.")
+  parser.add_argument("--tables",
+                      action="store_true",
+                      help="Implement the lattice operations and the transfer "
+                      + "functions through lookup tables.")
   parser.add_argument("header",
                       metavar="HEADER",
                       help="C++ file header.")
@@ -487,7 +605,9 @@ def main():
   result = ""
   all_transfer_functions = set()
   for path in args.inputs:
-    transfer_functions, output = process_graph(path, args.call_arcs)
+    transfer_functions, output = process_graph(path,
+                                                 args.call_arcs,
+                                                 args.tables)
     result += output
     all_transfer_functions |= set(transfer_functions)
 
@@ -19,6 +19,27 @@ set(ANALYSIS_DIFF_stack_analysis "${CMAKE_SOURCE_DIR}/scripts/compare-json.py --
 
 set(USED_REFERENCE_FILES "")
 
+#
+# Benchmarks
+#
+
+# Configure with -DBENCHMARK_BASELINE=path to measure the time and the peak
+# memory usage of each phase of the pipeline on the test binaries and on the
+# binaries listed in BENCHMARK_BINARIES (e.g., large real-world programs), and
+# compare them against the baseline. The tests are labeled "benchmark", record
+# the baseline with `revng benchmark --update --baseline path binary`.
+set(BENCHMARK_BINARIES "" CACHE STRING "List of additional binaries to benchmark")
+
+if(DEFINED BENCHMARK_BASELINE)
+  foreach(BINARY ${BENCHMARK_BINARIES})
+    get_filename_component(BINARY_NAME "${BINARY}" NAME)
+    set(TEST_NAME benchmark-${BINARY_NAME})
+    add_test(NAME ${TEST_NAME}
+      COMMAND ./bin/revng benchmark --baseline "${BENCHMARK_BASELINE}" "${BINARY}")
+    set_tests_properties(${TEST_NAME} PROPERTIES LABELS "benchmark" RUN_SERIAL TRUE)
+  endforeach()
+endif()
+
 #
 # Broken tests
 #
@@ -60,6 +81,13 @@ macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
 
     endforeach()
 
+    if(DEFINED BENCHMARK_BASELINE)
+      set(TEST_NAME benchmark-${CATEGORY}-${TARGET_NAME})
+      add_test(NAME ${TEST_NAME}
+        COMMAND ./bin/revng benchmark --name "${CATEGORY}-${TARGET_NAME}" --baseline "${BENCHMARK_BASELINE}" "${INPUT_FILE}")
+      set_tests_properties(${TEST_NAME} PROPERTIES LABELS "benchmark;${CATEGORY};${CONFIGURATION}" RUN_SERIAL TRUE)
+    endif()
+
   endif()
 endmacro()
 register_derived_artifact("compiled" "lifted" ".ll" "FILE")
@@ -2,6 +2,19 @@
 # This file is distributed under the MIT License. See LICENSE.md for details.
 #
 
+#
+# Runtime benchmarks
+#
+
+# Configure with -DRUNTIME_BENCHMARK_OUTPUT=directory to time the test
+# programs, translated at each optimization level, against the original ones
+# (run under qemu-user, if they don't target the host). Each test, labeled
+# "runtime-benchmark", writes its results in the directory: summarize them with
+# `revng runtime-benchmark --summarize directory/*.json`. Also set
+# RUNTIME_BENCHMARK_BASELINE to make the tests fail if the slowdowns get worse
+# than the ones recorded through `revng runtime-benchmark --update`.
+set(RUNTIME_BENCHMARK_REPEAT "5" CACHE STRING "Number of timed runs of each program in the runtime benchmarks")
+
 macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
   set(INPUT_FILE "${INPUT_FILE}")
   list(GET INPUT_FILE 0 COMPILED_INPUT)
@@ -22,12 +35,62 @@ macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
         set_tests_properties(${TEST_NAME} PROPERTIES LABELS "runtime;${CATEGORY};${CONFIGURATION}")
 
       endforeach()
+
+      if(DEFINED RUNTIME_BENCHMARK_OUTPUT)
+        set(BENCHMARK_RUNS "")
+        foreach(RUN IN LISTS ARTIFACT_RUNS_${ARTIFACT_CATEGORY}__${ARTIFACT})
+          list(APPEND BENCHMARK_RUNS --run "${RUN}=${ARTIFACT_RUNS_${ARTIFACT_CATEGORY}__${ARTIFACT}__${RUN}}")
+        endforeach()
+
+        set(BENCHMARK_BASELINE_ARGS "")
+        if(DEFINED RUNTIME_BENCHMARK_BASELINE)
+          set(BENCHMARK_BASELINE_ARGS --baseline "${RUNTIME_BENCHMARK_BASELINE}")
+        endif()
+
+        set(BENCHMARK_NAME "${CATEGORY}-${TARGET_NAME}")
+        set(TEST_NAME runtime-benchmark-${BENCHMARK_NAME})
+        add_test(NAME ${TEST_NAME}
+          COMMAND ./bin/revng runtime-benchmark
+            --name "${BENCHMARK_NAME}"
+            --architecture "${CONFIGURATION}"
+            --repeat "${RUNTIME_BENCHMARK_REPEAT}"
+            ${BENCHMARK_RUNS}
+            ${BENCHMARK_BASELINE_ARGS}
+            -o "${RUNTIME_BENCHMARK_OUTPUT}/${BENCHMARK_NAME}.json"
+            "${COMPILED_INPUT}")
+        set_tests_properties(${TEST_NAME} PROPERTIES LABELS "runtime-benchmark;${CATEGORY};${CONFIGURATION}" RUN_SERIAL TRUE)
+      endif()
     endif()
 
   endif()
 endmacro()
 register_derived_artifact("compiled;compiled-run" "translated" "" "FILE")
 
+# Run a program whose isolated functions have their ABI enforced, eliding the
+# safety checks of the indirect calls the ABI analysis is certain about
+macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
+  set(INPUT_FILE "${INPUT_FILE}")
+  list(GET INPUT_FILE 0 COMPILED_INPUT)
+  list(GET INPUT_FILE 1 COMPILED_RUN_INPUT)
+
+  if("${CATEGORY}" STREQUAL "tests_runtime" AND NOT "${CONFIGURATION}" STREQUAL "static_native" AND "${TARGET_NAME}" MATCHES "calc")
+    set(COMMAND_TO_RUN "./bin/revng" --verbose translate -i --enforce-abi --elide-abi-checks ${COMPILED_INPUT} -o "${OUTPUT}")
+    set(DEPEND_ON revng-all-binaries)
+
+    if(NOT "${CONFIGURATION}" STREQUAL "aarch64")
+      foreach(RUN IN LISTS ARTIFACT_RUNS_${ARTIFACT_CATEGORY}__${ARTIFACT})
+        set(OUTPUT_RUN "${OUTPUT}-${RUN}.stdout")
+        set(TEST_NAME test-translated-abi-elided-${CATEGORY}-${TARGET_NAME}-${RUN})
+        add_test(NAME ${TEST_NAME}
+          COMMAND sh -c "${OUTPUT} ${ARTIFACT_RUNS_${ARTIFACT_CATEGORY}__${ARTIFACT}__${RUN}} > ${OUTPUT_RUN} \
+          && diff -u ${COMPILED_RUN_INPUT}/${RUN}.stdout ${OUTPUT_RUN}")
+        set_tests_properties(${TEST_NAME} PROPERTIES LABELS "runtime;${CATEGORY};${CONFIGURATION}")
+      endforeach()
+    endif()
+  endif()
+endmacro()
+register_derived_artifact("compiled;compiled-run" "translated-abi-elided" "" "FILE")
+
 macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
   set(INPUT_FILE "${INPUT_FILE}")
   list(GET INPUT_FILE 0 COMPILED_INPUT)
@@ -45,6 +108,29 @@ macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
 endmacro()
 register_derived_artifact("compiled;compiled-run" "lifted" ".ll" "FILE")
 
+# Lift with the binary PTC dump and check it can be decoded
+macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
+  set(INPUT_FILE "${INPUT_FILE}")
+  list(GET INPUT_FILE 0 COMPILED_INPUT)
+
+  if("${CATEGORY}" STREQUAL "tests_runtime" AND NOT "${CONFIGURATION}" STREQUAL "static_native")
+    set(COMMAND_TO_RUN
+      "./bin/revng"
+      lift
+      -ptc-dump "${OUTPUT}"
+      ${COMPILED_INPUT}
+      "${OUTPUT}.bc")
+    set(DEPEND_ON revng-all-binaries)
+
+    set(TEST_NAME test-ptc-dump-${CATEGORY}-${TARGET_NAME})
+    add_test(NAME ${TEST_NAME}
+      COMMAND sh -c "./bin/revng-decode-ptc-dump ${OUTPUT} > ${OUTPUT}.txt \
+      && grep -q '^Translation of 0x' ${OUTPUT}.txt")
+    set_tests_properties(${TEST_NAME} PROPERTIES LABELS "runtime;${CATEGORY};${CONFIGURATION}")
+  endif()
+endmacro()
+register_derived_artifact("compiled;compiled-run" "ptc-dump" ".ptc" "FILE")
+
 macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
   if("${CATEGORY}" STREQUAL "tests_runtime" AND NOT "${CONFIGURATION}" STREQUAL "static_native")
     set(COMMAND_TO_RUN
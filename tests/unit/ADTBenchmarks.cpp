@@ -0,0 +1,385 @@
+/// \file ADTBenchmarks.cpp
+/// \brief Microbenchmarks for the revng ADT containers
+///
+/// Each benchmark is run on a few realistic sizes and reports the best time
+/// per element over a number of repetitions. Where it makes sense, the same
+/// operation is measured on std::map, llvm::DenseMap or llvm::BitVector as a
+/// reference. Use --quick to run each benchmark once on small sizes (this is
+/// what the test does, to ensure the benchmarks keep working).
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/ADT/CompactGraph.h"
+#include "revng/ADT/ConstantRangeSet.h"
+#include "revng/ADT/GenericGraph.h"
+#include "revng/ADT/LazySmallBitVector.h"
+#include "revng/ADT/MutableSet.h"
+#include "revng/ADT/SmallMap.h"
+#include "revng/ADT/SortedVector.h"
+#include "revng/ADT/ZipMapIterator.h"
+#include "revng/Support/Assert.h"
+
+using namespace llvm;
+
+static bool Quick = false;
+
+/// \brief Accumulates results, so that the compiler can't drop the work
+static uint64_t Sink = 0;
+
+/// \brief Run \p Body, which processes \p Size elements, and print the best
+///        time per element
+template<typename F>
+static void measure(const char *Name, size_t Size, F &&Body) {
+  using namespace std::chrono;
+  unsigned Repetitions = Quick ? 1 : 20;
+
+  double Best = 0;
+  for (unsigned I = 0; I < Repetitions; ++I) {
+    auto Begin = steady_clock::now();
+    Body();
+    auto End = steady_clock::now();
+    double Nanoseconds = duration<double, std::nano>(End - Begin).count();
+    if (I == 0 or Nanoseconds < Best)
+      Best = Nanoseconds;
+  }
+
+  outs() << format("%-44s %8zu %10.2f ns/element\n",
+                   Name,
+                   Size,
+                   Best / std::max<size_t>(Size, 1));
+}
+
+static std::vector<uint64_t> randomKeys(size_t Size, uint64_t Seed) {
+  std::mt19937_64 Generator(Seed);
+  std::vector<uint64_t> Result(Size);
+  for (uint64_t &Key : Result)
+    Key = Generator() % (Size * 4);
+  return Result;
+}
+
+//
+// SmallMap
+//
+
+template<typename MapT>
+static void benchmarkMap(const char *Name, size_t Size) {
+  std::vector<uint64_t> Keys = randomKeys(Size, Size);
+  std::string Prefix = Name;
+
+  measure((Prefix + " insert").c_str(), Size, [&]() {
+    MapT Map;
+    for (uint64_t Key : Keys)
+      Map[Key] = Key;
+    Sink += Map.size();
+  });
+
+  MapT Map;
+  for (uint64_t Key : Keys)
+    Map[Key] = Key;
+
+  measure((Prefix + " lookup").c_str(), Size, [&]() {
+    for (uint64_t Key : Keys)
+      Sink += Map.count(Key);
+  });
+
+  measure((Prefix + " iterate").c_str(), Size, [&]() {
+    for (auto &P : Map)
+      Sink += P.second;
+  });
+}
+
+static void benchmarkMaps() {
+  for (size_t Size : { 4, 16, 128 }) {
+    benchmarkMap<SmallMap<uint64_t, uint64_t, 16>>("SmallMap<16>", Size);
+    benchmarkMap<std::map<uint64_t, uint64_t>>("std::map", Size);
+    benchmarkMap<DenseMap<uint64_t, uint64_t>>("DenseMap", Size);
+  }
+}
+
+//
+// LazySmallBitVector
+//
+
+template<typename BitVectorT>
+static void benchmarkBitVector(const char *Name, size_t Size) {
+  std::vector<uint64_t> Keys = randomKeys(Size / 4, Size);
+  std::vector<uint64_t> OtherKeys = randomKeys(Size / 4, Size + 1);
+  std::string Prefix = Name;
+
+  auto Build = [](const std::vector<uint64_t> &Indices, size_t Size) {
+    BitVectorT Result;
+    if constexpr (std::is_same_v<BitVectorT, BitVector>)
+      Result.resize(Size * 4);
+    for (uint64_t Index : Indices)
+      Result.set(Index);
+    return Result;
+  };
+
+  measure((Prefix + " set").c_str(), Keys.size(), [&]() {
+    Sink += Build(Keys, Size)[0];
+  });
+
+  BitVectorT A = Build(Keys, Size);
+  BitVectorT B = Build(OtherKeys, Size);
+
+  measure((Prefix + " test").c_str(), OtherKeys.size(), [&]() {
+    for (uint64_t Index : OtherKeys)
+      Sink += A[Index];
+  });
+
+  measure((Prefix + " or").c_str(), Size, [&]() {
+    BitVectorT Result = A;
+    Result |= B;
+    Sink += Result[0];
+  });
+
+  measure((Prefix + " and").c_str(), Size, [&]() {
+    BitVectorT Result = A;
+    Result &= B;
+    Sink += Result[0];
+  });
+
+  measure((Prefix + " iterate").c_str(), Keys.size(), [&]() {
+    if constexpr (std::is_same_v<BitVectorT, BitVector>) {
+      for (unsigned Index : A.set_bits())
+        Sink += Index;
+    } else {
+      for (unsigned Index : A)
+        Sink += Index;
+    }
+  });
+}
+
+static void benchmarkBitVectors() {
+  // The first size fits in the inline storage of LazySmallBitVector
+  for (size_t Size : { 15, 256, 4096 }) {
+    benchmarkBitVector<LazySmallBitVector>("LazySmallBitVector", Size);
+    benchmarkBitVector<BitVector>("BitVector", Size);
+  }
+}
+
+//
+// ConstantRangeSet
+//
+
+static ConstantRangeSet randomRangeSet(size_t Ranges, uint64_t Seed) {
+  std::vector<uint64_t> Bounds = randomKeys(2 * Ranges, Seed);
+  std::sort(Bounds.begin(), Bounds.end());
+
+  ConstantRangeSet Result(64, false);
+  for (size_t I = 0; I + 1 < Bounds.size(); I += 2) {
+    if (Bounds[I] == Bounds[I + 1])
+      continue;
+    ConstantRange Range(APInt(64, Bounds[I]), APInt(64, Bounds[I + 1]));
+    Result = Result.unionWith(Range);
+  }
+
+  return Result;
+}
+
+static void benchmarkConstantRangeSets() {
+  for (size_t Size : { 2, 16, 128 }) {
+    ConstantRangeSet A = randomRangeSet(Size, Size);
+    ConstantRangeSet B = randomRangeSet(Size, Size + 1);
+
+    measure("ConstantRangeSet union", Size, [&]() {
+      Sink += A.unionWith(B).isFullSet();
+    });
+
+    measure("ConstantRangeSet intersect", Size, [&]() {
+      Sink += A.intersectWith(B).isFullSet();
+    });
+
+    measure("ConstantRangeSet contains", Size, [&]() {
+      Sink += A.contains(B);
+    });
+  }
+}
+
+//
+// Keyed objects containers
+//
+
+template<typename SetT>
+static void benchmarkKeyedSet(const char *Name, size_t Size) {
+  std::vector<uint64_t> Keys = randomKeys(Size, Size);
+  std::string Prefix = Name;
+
+  measure((Prefix + " insert").c_str(), Size, [&]() {
+    SetT Set;
+    for (uint64_t Key : Keys)
+      Set.insert(Key);
+    Sink += Set.size();
+  });
+
+  if constexpr (std::is_same_v<SetT, SortedVector<uint64_t>>) {
+    measure((Prefix + " batch_insert").c_str(), Size, [&]() {
+      SetT Set;
+      {
+        auto Inserter = Set.batch_insert();
+        for (uint64_t Key : Keys)
+          Inserter.insert(Key);
+      }
+      Sink += Set.size();
+    });
+  }
+
+  SetT Set;
+  for (uint64_t Key : Keys)
+    Set.insert(Key);
+
+  measure((Prefix + " lookup").c_str(), Size, [&]() {
+    for (uint64_t Key : Keys)
+      Sink += Set.count(Key);
+  });
+
+  measure((Prefix + " iterate").c_str(), Size, [&]() {
+    for (uint64_t Key : Set)
+      Sink += Key;
+  });
+}
+
+static void benchmarkKeyedSets() {
+  for (size_t Size : { 16, 1024, 16384 }) {
+    benchmarkKeyedSet<SortedVector<uint64_t>>("SortedVector", Size);
+    benchmarkKeyedSet<MutableSet<uint64_t>>("MutableSet", Size);
+  }
+}
+
+//
+// ZipMapIterator
+//
+
+static void benchmarkZipMaps() {
+  using Map = std::map<uint64_t, uint64_t>;
+  using Vector = SortedVector<uint64_t>;
+
+  for (size_t Size : { 16, 1024, 16384 }) {
+    Map LeftMap, RightMap;
+    Vector LeftVector, RightVector;
+    for (uint64_t Key : randomKeys(Size, Size)) {
+      LeftMap[Key] = Key;
+      LeftVector.insert(Key);
+    }
+    for (uint64_t Key : randomKeys(Size, Size + 1)) {
+      RightMap[Key] = Key;
+      RightVector.insert(Key);
+    }
+
+    measure("zipmap_range std::map", Size, [&]() {
+      for (auto [Left, Right] : zipmap_range(LeftMap, RightMap))
+        Sink += (Left != nullptr) + (Right != nullptr);
+    });
+
+    measure("zipmap_for_each std::map", Size, [&]() {
+      zipmap_for_each(LeftMap, RightMap, [](auto *Left, auto *Right) {
+        Sink += (Left != nullptr) + (Right != nullptr);
+      });
+    });
+
+    measure("zipmap_range SortedVector", Size, [&]() {
+      for (auto [Left, Right] : zipmap_range(LeftVector, RightVector))
+        Sink += (Left != nullptr) + (Right != nullptr);
+    });
+
+    measure("zipmap_for_each SortedVector", Size, [&]() {
+      zipmap_for_each(LeftVector, RightVector, [](auto *Left, auto *Right) {
+        Sink += (Left != nullptr) + (Right != nullptr);
+      });
+    });
+  }
+}
+
+//
+// GenericGraph
+//
+
+struct BenchmarkNodeData {
+  BenchmarkNodeData(unsigned Index) : Index(Index) {}
+  unsigned Index;
+};
+
+using BenchmarkNode = BidirectionalNode<BenchmarkNodeData>;
+using BenchmarkGraph = GenericGraph<BenchmarkNode>;
+
+/// \brief Build a CFG-like graph: a chain with a few forward and back edges
+static void buildGraph(BenchmarkGraph &Graph, size_t Size) {
+  std::mt19937_64 Generator(Size);
+  std::vector<BenchmarkNode *> Nodes;
+  for (unsigned I = 0; I < Size; ++I)
+    Nodes.push_back(Graph.addNode(I));
+  Graph.setEntryNode(Nodes[0]);
+
+  for (unsigned I = 0; I + 1 < Size; ++I) {
+    Nodes[I]->addSuccessor(Nodes[I + 1]);
+    if (Generator() % 4 == 0)
+      Nodes[I]->addSuccessor(Nodes[Generator() % Size]);
+  }
+}
+
+static void benchmarkGraphs() {
+  for (size_t Size : { 16, 1024, 16384 }) {
+    measure("GenericGraph build", Size, [&]() {
+      BenchmarkGraph Graph;
+      buildGraph(Graph, Size);
+      Sink += Graph.size();
+    });
+
+    BenchmarkGraph Graph;
+    buildGraph(Graph, Size);
+
+    measure("GenericGraph depth_first", Size, [&]() {
+      for (BenchmarkNode *Node : depth_first(&Graph))
+        Sink += Node->Index;
+    });
+
+    measure("CompactGraph build", Size, [&]() {
+      CompactGraph Compact(Graph);
+      Sink += Compact.size();
+    });
+
+    CompactGraph Compact(Graph);
+    measure("CompactGraph depth_first", Size, [&]() {
+      for (auto *Node : depth_first(&Compact))
+        Sink += Node->getIndex();
+    });
+  }
+}
+
+int main(int argc, const char *argv[]) {
+  for (int I = 1; I < argc; ++I) {
+    if (std::strcmp(argv[I], "--quick") == 0) {
+      Quick = true;
+    } else {
+      errs() << "Usage: " << argv[0] << " [--quick]\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  benchmarkMaps();
+  benchmarkBitVectors();
+  benchmarkConstantRangeSets();
+  benchmarkKeyedSets();
+  benchmarkZipMaps();
+  benchmarkGraphs();
+
+  // Print the sink, so that it can't be optimized away
+  outs() << "Checksum: " << Sink << "\n";
+
+  return EXIT_SUCCESS;
+}
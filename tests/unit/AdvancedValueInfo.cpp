@@ -40,6 +40,13 @@ public:
         return { "symbol", APInt(BitWidth, 0) };
     return { APInt(BitWidth, 42) };
   }
+
+  MaterializedValues loadAll(ArrayRef<Constant *> Addresses) {
+    MaterializedValues Result;
+    for (Constant *Address : Addresses)
+      Result.push_back(load(Address));
+    return Result;
+  }
 };
 
 class TestAdvancedValueInfoPass : public ModulePass {
@@ -50,9 +57,10 @@ public:
   static char ID;
 
 public:
-  TestAdvancedValueInfoPass() : ModulePass(ID), Results(nullptr) {}
-  TestAdvancedValueInfoPass(ResultsMap &Results) :
-    ModulePass(ID), Results(&Results) {}
+  TestAdvancedValueInfoPass() :
+    ModulePass(ID), Results(nullptr), MaxValues(MaxMaterializedValues) {}
+  TestAdvancedValueInfoPass(ResultsMap &Results, range_size_t MaxValues) :
+    ModulePass(ID), Results(&Results), MaxValues(MaxValues) {}
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
@@ -65,6 +73,7 @@ public:
 
 private:
   ResultsMap *Results;
+  range_size_t MaxValues;
 };
 
 char TestAdvancedValueInfoPass::ID = 0;
@@ -85,7 +94,7 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
   auto &SCEV = getAnalysis<ScalarEvolutionWrapperPass>(Root).getSE();
 
   MockupMemoryOracle MO(M.getDataLayout());
-  AdvancedValueInfo<MockupMemoryOracle> AVI(LVI, SCEV, DT, MO);
+  AdvancedValueInfo<MockupMemoryOracle> AVI(LVI, SCEV, DT, MO, 0, MaxValues);
 
   for (User *U : M.getGlobalVariable("pc", true)->users()) {
     if (auto *Store = dyn_cast<StoreInst>(U)) {
@@ -99,7 +108,10 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
 
 using CheckMap = std::map<const char *, MaterializedValues>;
 
-static void checkAdvancedValueInfo(const char *Body, const CheckMap &Map) {
+static void
+checkAdvancedValueInfo(const char *Body,
+                       const CheckMap &Map,
+                       range_size_t MaxValues = MaxMaterializedValues) {
   auto &Registry = *PassRegistry::getPassRegistry();
   initializeDominatorTreeWrapperPassPass(Registry);
   initializeLazyValueInfoWrapperPassPass(Registry);
@@ -115,7 +127,7 @@ static void checkAdvancedValueInfo(const char *Body, const CheckMap &Map) {
   legacy::PassManager PM;
   PM.add(createLazyValueInfoPass());
   PM.add(new ScalarEvolutionWrapperPass);
-  PM.add(new TestAdvancedValueInfoPass(Results));
+  PM.add(new TestAdvancedValueInfoPass(Results, MaxValues));
   PM.run(*M);
 
   TestAdvancedValueInfoPass::ResultsMap Reference;
@@ -190,6 +202,62 @@ end:
                                AI64(8) } } });
 }
 
+BOOST_AUTO_TEST_CASE(TestMaxValues) {
+  const char *Body = R"LLVM(
+  %to_store = load i64, i64 *@pc
+  %cmp = icmp ult i64 %to_store, 5
+  br i1 %cmp, label %smaller, label %end
+
+smaller:
+  store i64 %to_store, i64* @pc
+  br label %end
+
+end:
+  unreachable
+
+)LLVM";
+
+  checkAdvancedValueInfo(Body,
+                         { { "to_store",
+                             { AI64(0),
+                               AI64(1),
+                               AI64(2),
+                               AI64(3),
+                               AI64(4) } } },
+                         6);
+
+  checkAdvancedValueInfo(Body, { { "to_store", {} } }, 5);
+
+  // Each incoming value is within the limit, but the phi is not
+  checkAdvancedValueInfo(R"LLVM(
+  %original = load i64, i64 *@pc
+  %cmp = icmp ult i64 %original, 3
+  br i1 %cmp, label %smaller, label %end
+
+smaller:
+  %other = add i64 %original, 10
+  %select = icmp eq i64 %original, 0
+  br i1 %select, label %left, label %right
+
+left:
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %phi = phi i64 [ %original, %left ], [ %other, %right ]
+  store i64 %phi, i64* @pc
+  br label %end
+
+end:
+  unreachable
+
+)LLVM",
+                         { { "phi", {} } },
+                         4);
+}
+
 BOOST_AUTO_TEST_CASE(TestPhi) {
   checkAdvancedValueInfo(R"LLVM(
   br label %start
@@ -0,0 +1,142 @@
+/// \file CollectCFG.cpp
+/// \brief Tests for the binary format of CollectCFG
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE CollectCFG
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include <sstream>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Dump/CollectCFG.h"
+#include "revng/Support/Debug.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+// bb.0x1000 reaches bb.0x2000, in another epoch, through a block that isn't
+// a new instruction, and bb.0x1010 jumps backward. bb.0x2000 has no
+// successors, it's therefore not a source.
+static const char *ModuleText = R"LLVM(
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%MetaAddress = type { i64, i32, i16, i16 }
+
+declare void @newpc(%MetaAddress, i64, i32, i8*, ...)
+
+define void @root(i1 %condition) {
+entry:
+  br label %bb.0x1000
+
+bb.0x1000:
+  call void (%MetaAddress, i64, i32, i8*, ...) @newpc(%MetaAddress { i64 4096, i32 0, i16 0, i16 4 }, i64 16, i32 1, i8* null)
+  br i1 %condition, label %bb.0x1010, label %bb.0x1000.1
+
+bb.0x1000.1:
+  br label %bb.0x2000
+
+bb.0x1010:
+  call void (%MetaAddress, i64, i32, i8*, ...) @newpc(%MetaAddress { i64 4112, i32 0, i16 0, i16 4 }, i64 2, i32 1, i8* null)
+  br label %bb.0x1000
+
+bb.0x2000:
+  call void (%MetaAddress, i64, i32, i8*, ...) @newpc(%MetaAddress { i64 8192, i32 1, i16 0, i16 4 }, i64 1, i32 1, i8* null)
+  ret void
+}
+)LLVM";
+
+using Edge = std::pair<MetaAddress, MetaAddress>;
+
+static std::unique_ptr<Module> load(LLVMContext &Context) {
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(StringRef(ModuleText));
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  if (M.get() == nullptr) {
+    Diagnostic.print("revng", dbgs());
+    revng_abort();
+  }
+
+  return M;
+}
+
+static std::string serializeBinary(Module &M) {
+  CollectCFG Pass;
+  Pass.runOnModule(M);
+
+  std::string Result;
+  raw_string_ostream Stream(Result);
+  Pass.serializeBinary(Stream);
+  Stream.flush();
+  return Result;
+}
+
+static MetaAddress code(uint64_t Address, uint32_t Epoch = 0) {
+  return MetaAddress(Address, MetaAddressType::Code_x86_64, Epoch, 0);
+}
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+  LLVMContext Context;
+  auto M = load(Context);
+  std::string Buffer = serializeBinary(*M);
+
+  std::vector<Edge> Edges;
+  auto OnEdge = [&Edges](MetaAddress Source, MetaAddress Destination) {
+    Edges.emplace_back(Source, Destination);
+  };
+  revng_check(CollectCFG::readBinary(Buffer, OnEdge));
+
+  std::vector<Edge> Expected = { { code(0x1000), code(0x1010) },
+                                 { code(0x1000), code(0x2000, 1) },
+                                 { code(0x1010), code(0x1000) } };
+  revng_check(Edges == Expected);
+}
+
+BOOST_AUTO_TEST_CASE(SameEdgesAsCSV) {
+  LLVMContext Context;
+  auto M = load(Context);
+  std::string Buffer = serializeBinary(*M);
+
+  CollectCFG Pass;
+  Pass.runOnModule(*M);
+  std::stringstream CSV;
+  Pass.serialize(CSV);
+
+  std::stringstream FromBinary;
+  FromBinary << "source,destination\n";
+  auto OnEdge = [&FromBinary](MetaAddress Source, MetaAddress Destination) {
+    FromBinary << "bb.0x" << std::hex << Source.address() << ",bb.0x"
+               << Destination.address() << "\n";
+  };
+  revng_check(CollectCFG::readBinary(Buffer, OnEdge));
+
+  revng_check(CSV.str() == FromBinary.str());
+}
+
+BOOST_AUTO_TEST_CASE(Malformed) {
+  LLVMContext Context;
+  auto M = load(Context);
+  std::string Buffer = serializeBinary(*M);
+
+  auto OnEdge = [](MetaAddress, MetaAddress) {};
+
+  // Wrong magic
+  std::string WrongMagic = Buffer;
+  WrongMagic[0] = 'x';
+  revng_check(not CollectCFG::readBinary(WrongMagic, OnEdge));
+
+  // Truncated in the middle of a record
+  StringRef Truncated = StringRef(Buffer).drop_back(1);
+  revng_check(not CollectCFG::readBinary(Truncated, OnEdge));
+}
@@ -62,3 +62,30 @@ BOOST_AUTO_TEST_CASE(TestEnumerate) {
     dbg << "\n";
   }
 }
+
+BOOST_AUTO_TEST_CASE(TestTrivialOperands) {
+  using CRS = ConstantRangeSet;
+
+  CRS Empty(8, false);
+  CRS Full(8, true);
+  CRS Some({ { 8, 10 }, { 8, 20 } });
+
+  revng_check(Some.unionWith(Empty) == Some);
+  revng_check(Empty.unionWith(Some) == Some);
+  revng_check(Some.unionWith(Full) == Full);
+  revng_check(Full.unionWith(Some) == Full);
+
+  revng_check(Some.intersectWith(Empty) == Empty);
+  revng_check(Empty.intersectWith(Some) == Empty);
+  revng_check(Some.intersectWith(Full) == Some);
+  revng_check(Full.intersectWith(Some) == Some);
+
+  revng_check(Full.contains(Some));
+  revng_check(Some.contains(Empty));
+  revng_check(not Empty.contains(Some));
+  revng_check(not Some.contains(Full));
+
+  // The result takes the bit width of the non-empty operand
+  revng_check(CRS().unionWith(Some).size() == Some.size());
+  revng_check(Some.intersectWith(CRS()).size() == Empty.size());
+}
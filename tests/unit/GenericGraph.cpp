@@ -17,9 +17,11 @@ bool init_unit_test();
 #include "llvm/Support/GraphWriter.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "revng/ADT/CompactGraph.h"
 #include "revng/ADT/FilteredGraphTraits.h"
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/SerializableGraph.h"
+#include "revng/Support/GraphAlgorithms.h"
 
 using namespace llvm;
 
@@ -245,6 +247,76 @@ BOOST_AUTO_TEST_CASE(TestSCC) {
   revng_check(SCCCount == 4);
 }
 
+BOOST_AUTO_TEST_CASE(TestCompactGraph) {
+  DiamondGraph DG = createGraph();
+  CompactGraph Compact(DG.Graph);
+  using CompactNode = CompactGraph<TestNode>::Node;
+
+  revng_check(Compact.size() == 4);
+  CompactNode *Root = Compact.getEntryNode();
+  CompactNode *Final = Compact.getNode(DG.Final);
+  revng_check(Root->getOriginal() == DG.Root);
+  revng_check(Root->successors().size() == 2);
+  revng_check(Final->predecessors().size() == 2);
+  revng_check(Compact.getNodeAt(Root->getIndex()) == Root);
+
+  std::vector<TestNode *> Visited;
+  for (CompactNode *Node : depth_first(&Compact))
+    Visited.push_back(Node->getOriginal());
+  revng_check(Visited.size() == 4);
+  revng_check(Visited[0] == DG.Root);
+
+  Visited.clear();
+  for (CompactNode *Node : inverse_depth_first(Final))
+    Visited.push_back(Node->getOriginal());
+  revng_check(Visited.size() == 4);
+
+  unsigned SCCCount = 0;
+  for (const std::vector<CompactNode *> &SCC :
+       make_range(scc_begin(&Compact), scc_end(&Compact))) {
+    revng_check(SCC.size() == 1);
+    ++SCCCount;
+  }
+  revng_check(SCCCount == 4);
+
+  CompactNode *Then = Compact.getNode(DG.Then);
+  CompactNode *Else = Compact.getNode(DG.Else);
+
+  DominatorTreeBase<CompactNode, false> DT;
+  DT.recalculate(Compact);
+  revng_check(DT.dominates(DT.getNode(Root), DT.getNode(Then)));
+  revng_check(DT.dominates(DT.getNode(Root), DT.getNode(Final)));
+  revng_check(not DT.dominates(DT.getNode(Else), DT.getNode(Final)));
+
+  DominatorTreeBase<CompactNode, true> PDT;
+  PDT.recalculate(Compact);
+  revng_check(PDT.dominates(PDT.getNode(Final), PDT.getNode(Root)));
+  revng_check(not PDT.dominates(PDT.getNode(Then), PDT.getNode(Root)));
+}
+
+BOOST_AUTO_TEST_CASE(TestSCCLevels) {
+  DiamondGraph DG = createGraph();
+
+  // Add a loop on Then, it has to be in a single SCC
+  TestNode *Loop = DG.Graph.addNode(4);
+  DG.Then->addSuccessor(Loop, { 1 });
+  Loop->addSuccessor(DG.Then, { 1 });
+
+  auto Levels = sccLevels(DG.Root);
+  revng_check(Levels.size() == 3);
+
+  using SCC = std::vector<TestNode *>;
+  revng_check(Levels[0] == std::vector<SCC>({ { DG.Final } }));
+  revng_check(Levels[1].size() == 2);
+  for (const SCC &Component : Levels[1]) {
+    if (Component.size() == 1)
+      revng_check(Component[0] == DG.Else);
+    else
+      revng_check(Component.size() == 2);
+  }
+  revng_check(Levels[2] == std::vector<SCC>({ { DG.Root } }));
+}
+
 BOOST_AUTO_TEST_CASE(TestFilterGraphTraits) {
   DiamondGraph DG = createGraph();
   TestNode *Root = DG.Root;
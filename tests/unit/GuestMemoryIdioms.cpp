@@ -0,0 +1,142 @@
+/// \file GuestMemoryIdioms.cpp
+/// \brief Tests for the guest memory idioms pass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE GuestMemoryIdioms
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include <string>
+
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/BasicAnalyses/GuestMemoryIdioms.h"
+#include "revng/Support/Debug.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+static const char *ModuleBegin = R"LLVM(
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+define void @copy() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+)LLVM";
+
+static const char *ModuleEnd = R"LLVM(
+  %source = inttoptr i64 %source_address to i8*
+  %destination = inttoptr i64 %destination_address to i8*
+  %value = load i8, i8* %source
+  store i8 %value, i8* %destination
+  %next = add i64 %i, 1
+  %done = icmp eq i64 %next, 16
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+)LLVM";
+
+static uint64_t address(Value *Pointer) {
+  auto *Cast = cast<ConstantExpr>(Pointer);
+  revng_check(Cast->getOpcode() == Instruction::IntToPtr);
+  return cast<ConstantInt>(Cast->getOperand(0))->getZExtValue();
+}
+
+/// \brief Lower a loop copying 16 bytes, one at a time, forward or backward
+///
+/// The addresses are constant, so that the check for the overlap is folded.
+///
+/// \return true if the original loop is still executed, false if memmove is.
+static bool keepsLoop(uint64_t Destination, uint64_t Source, bool Forward) {
+  const char *Opcode = Forward ? "add" : "sub";
+  std::string ModuleText = ModuleBegin;
+  ModuleText += "  %source_address = " + std::string(Opcode) + " i64 "
+                + std::to_string(Source) + ", %i\n";
+  ModuleText += "  %destination_address = " + std::string(Opcode) + " i64 "
+                + std::to_string(Destination) + ", %i\n";
+  ModuleText += ModuleEnd;
+
+  LLVMContext Context;
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(StringRef(ModuleText));
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  if (M.get() == nullptr) {
+    Diagnostic.print("revng", dbgs());
+    revng_abort();
+  }
+
+  legacy::PassManager PM;
+  PM.add(new GuestMemoryIdioms);
+  PM.run(*M);
+
+  revng_check(not verifyModule(*M, &dbgs()));
+
+  Function *F = M->getFunction("copy");
+  BasicBlock *Loop = nullptr;
+  MemMoveInst *MemMove = nullptr;
+  for (BasicBlock &BB : *F) {
+    if (BB.getName() == "loop")
+      Loop = &BB;
+    for (Instruction &I : BB)
+      if (auto *Call = dyn_cast<MemMoveInst>(&I))
+        MemMove = Call;
+  }
+
+  // The copy of the whole range starts from its lowest address
+  revng_check(Loop != nullptr and MemMove != nullptr);
+  auto *Length = cast<ConstantInt>(MemMove->getLength());
+  revng_check(Length->getZExtValue() == 16);
+  uint64_t Lowest = Forward ? 0 : 15;
+  revng_check(address(MemMove->getRawDest()) == Destination - Lowest);
+  revng_check(address(MemMove->getRawSource()) == Source - Lowest);
+
+  // The entry block picks either the original loop or memmove
+  auto *Branch = cast<BranchInst>(F->getEntryBlock().getTerminator());
+  revng_check(Branch->isConditional());
+  revng_check(Branch->getSuccessor(0) == Loop);
+  revng_check(Branch->getSuccessor(1) == MemMove->getParent());
+
+  return cast<ConstantInt>(Branch->getCondition())->isOne();
+}
+
+BOOST_AUTO_TEST_CASE(Disjoint) {
+  revng_check(not keepsLoop(0x2000, 0x1000, true));
+  revng_check(not keepsLoop(0x2000, 0x1000, false));
+}
+
+BOOST_AUTO_TEST_CASE(SameAddress) {
+  revng_check(not keepsLoop(0x1000, 0x1000, true));
+}
+
+BOOST_AUTO_TEST_CASE(DestinationBehind) {
+  // Each byte is read before being overwritten, as with memmove
+  revng_check(not keepsLoop(0x0fff, 0x1000, true));
+  revng_check(not keepsLoop(0x1001, 0x1000, false));
+}
+
+BOOST_AUTO_TEST_CASE(DestinationAhead) {
+  // The loop reads the bytes it has just written, memmove would not
+  revng_check(keepsLoop(0x1001, 0x1000, true));
+  revng_check(keepsLoop(0x100f, 0x1000, true));
+  revng_check(keepsLoop(0x0fff, 0x1000, false));
+}
+
+BOOST_AUTO_TEST_CASE(DestinationAheadOutOfRange) {
+  revng_check(not keepsLoop(0x1010, 0x1000, true));
+  revng_check(not keepsLoop(0x0ff0, 0x1000, false));
+}
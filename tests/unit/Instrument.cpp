@@ -0,0 +1,145 @@
+/// \file Instrument.cpp
+/// \brief Tests for the instrument pass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE Instrument
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/BasicAnalyses/Instrument.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+class TestPlugin : public InstrumentationPlugin {
+public:
+  void registerCallbacks(InstrumentationCallbacks &C) override {
+    C.onBlockEntry("on_block_entry");
+    C.onNewPC("on_newpc");
+    C.onHelperCall("helper_other", "on_helper_other");
+    C.onSyscall("on_syscall");
+  }
+};
+
+static RegisterInstrumentation<TestPlugin> X;
+
+static const char *ModuleBegin = R"LLVM(
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+%MetaAddress = type { i64, i32, i16, i16 }
+
+@pc = internal global i64 0
+@rsp = internal global i64 0
+@rax = internal global i64 0
+
+declare void @newpc(%MetaAddress, i64, i32, i8*, ...)
+declare void @helper_other()
+declare void @helper_syscall()
+
+define void @root() {
+entry:
+  br label %bb.0x1000
+
+bb.0x1000:
+  call void (%MetaAddress, i64, i32, i8*, ...) @newpc(%MetaAddress { i64 4096, i32 0, i16 0, i16 4 }, i64 2, i32 1, i8* null)
+  call void @helper_other()
+  call void (%MetaAddress, i64, i32, i8*, ...) @newpc(%MetaAddress { i64 4098, i32 0, i16 0, i16 4 }, i64 2, i32 0, i8* null)
+  call void @helper_syscall()
+  ret void
+}
+
+)LLVM";
+
+static std::unique_ptr<Module>
+instrument(LLVMContext &Context, const char *Architecture) {
+  std::string ModuleText = std::string(ModuleBegin) + Architecture;
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(StringRef(ModuleText));
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  if (M.get() == nullptr) {
+    Diagnostic.print("revng", dbgs());
+    revng_abort();
+  }
+
+  legacy::PassManager PM;
+  PM.add(new Instrument);
+  PM.run(*M);
+
+  revng_check(not verifyModule(*M, &dbgs()));
+
+  return M;
+}
+
+/// \brief Collect, in order, the calls to \p Name
+static std::vector<CallInst *> callsTo(Module &M, StringRef Name) {
+  std::vector<CallInst *> Result;
+  for (BasicBlock &BB : *M.getFunction("root"))
+    for (Instruction &I : BB)
+      if (CallInst *Call = getCallTo(&I, Name))
+        Result.push_back(Call);
+  return Result;
+}
+
+static uint64_t argument(CallInst *Call, unsigned Index) {
+  return getLimitedValue(Call->getArgOperand(Index));
+}
+
+BOOST_AUTO_TEST_CASE(AllCallbacks) {
+  LLVMContext Context;
+  auto M = instrument(Context, R"LLVM(
+!revng.input.architecture = !{!0}
+!0 = !{!"x86_64", i32 1, i32 0, !"pc", !"rsp", !{!"rax"}, !"helper_syscall", !"rax"}
+)LLVM");
+
+  auto BlockEntry = callsTo(*M, "on_block_entry");
+  revng_check(BlockEntry.size() == 1);
+  revng_check(argument(BlockEntry[0], 0) == 0x1000);
+
+  // The callback follows its newpc call
+  auto NewPC = callsTo(*M, "on_newpc");
+  revng_check(NewPC.size() == 2);
+  for (unsigned I = 0; I < NewPC.size(); ++I) {
+    revng_check(argument(NewPC[I], 0) == 0x1000 + 2 * I);
+    revng_check(argument(NewPC[I], 1) == 2);
+    revng_check(isCallTo(NewPC[I]->getPrevNode(), "newpc"));
+  }
+
+  // The callbacks precede the helper call
+  auto HelperCall = callsTo(*M, "on_helper_other");
+  revng_check(HelperCall.size() == 1);
+  revng_check(argument(HelperCall[0], 0) == 0x1000);
+  revng_check(isCallTo(HelperCall[0]->getNextNode(), "helper_other"));
+
+  auto Syscall = callsTo(*M, "on_syscall");
+  revng_check(Syscall.size() == 1);
+  revng_check(argument(Syscall[0], 0) == 0x1002);
+  revng_check(isCallTo(Syscall[0]->getNextNode(), "helper_syscall"));
+}
+
+BOOST_AUTO_TEST_CASE(NoSyscallHelper) {
+  // Older modules don't record how syscalls are performed: the syscalls are
+  // not instrumented, but everything else is
+  LLVMContext Context;
+  auto M = instrument(Context, R"LLVM(
+!revng.input.architecture = !{!0}
+!0 = !{!"x86_64", i32 1, i32 0, !"pc", !"rsp", !{!"rax"}}
+)LLVM");
+
+  revng_check(callsTo(*M, "on_syscall").empty());
+  revng_check(callsTo(*M, "on_block_entry").size() == 1);
+  revng_check(callsTo(*M, "on_newpc").size() == 2);
+  revng_check(callsTo(*M, "on_helper_other").size() == 1);
+}
@@ -131,6 +131,17 @@ void testSet() {
   revng_check(Set[0x1000].value() == 0x2222);
   revng_check(Set[0x900].value() == 0x1111);
 
+  // Test batch_insert of elements in order, after reserving room
+  {
+    auto Inserter = Set.batch_insert();
+    Inserter.reserve(Set.size() + 3);
+    Inserter.insert({ 0x4000, 0x3333 });
+    Inserter.insert({ 0x5000, 0x4444 });
+    Inserter.insert({ 0x5000, 0x5555 });
+  }
+  revng_check(Set[0x4000].value() == 0x3333);
+  revng_check(Set[0x5000].value() == 0x4444);
+
   // Test clear
   Set.clear();
 
@@ -146,6 +157,53 @@ BOOST_AUTO_TEST_CASE(TestSortedVector) {
   testSet<SortedVector<Element>>();
 }
 
+struct Edge {
+  uint64_t From;
+  uint64_t To;
+
+  bool operator==(const Edge &Other) const = default;
+};
+
+template<>
+struct KeyedObjectTraits<Edge> {
+  static std::pair<uint64_t, uint64_t> key(const Edge &E) {
+    return { E.From, E.To };
+  }
+
+  static Edge fromKey(std::pair<uint64_t, uint64_t> Key) {
+    return { Key.first, Key.second };
+  }
+};
+
+template<typename T>
+void testPrefixLookup() {
+  T Edges{ { 1, 2 }, { 1, 3 }, { 2, 1 }, { 4, 1 } };
+  using Prefix = std::tuple<uint64_t>;
+
+  std::vector<uint64_t> Destinations;
+  for (const Edge &E : Edges.prefix_range(Prefix(1)))
+    Destinations.push_back(E.To);
+  revng_check(Destinations == std::vector<uint64_t>({ 2, 3 }));
+
+  auto Missing = Edges.prefix_range(Prefix(3));
+  revng_check(Missing.begin() == Missing.end());
+  revng_check(Edges.find(Prefix(3)) == Edges.end());
+  revng_check(Edges.lower_bound(Prefix(3))->From == 4);
+  revng_check(Edges.upper_bound(Prefix(4)) == Edges.end());
+
+  using FullKey = std::tuple<uint64_t, uint64_t>;
+  revng_check(Edges.find(FullKey(2, 1)) == Edges.find({ 2, 1 }));
+  revng_check(Edges.find(FullKey(2, 2)) == Edges.end());
+
+  auto All = Edges.prefix_range(std::tuple<>());
+  revng_check(std::distance(All.begin(), All.end()) == 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestPrefixLookup) {
+  testPrefixLookup<MutableSet<Edge>>();
+  testPrefixLookup<SortedVector<Edge>>();
+}
+
 template<typename T>
 bool isSerializationStable(T &&Original) {
   std::string Buffer;
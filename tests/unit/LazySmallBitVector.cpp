@@ -219,3 +219,45 @@ BOOST_AUTO_TEST_CASE(TestIterator) {
   std::copy(A.begin(), A.end(), std::back_inserter(Results));
   BOOST_REQUIRE_EQUAL(Results, (std::vector<unsigned>{ 0, 16, 1000 }));
 }
+
+BOOST_AUTO_TEST_CASE(TestUnionAndCheckChanged) {
+  // Small implementation
+  LazySmallBitVector A;
+  LazySmallBitVector B;
+  A.set(1);
+  B.set(1);
+  BOOST_TEST(not A.unionAndCheckChanged(B));
+  B.set(2);
+  BOOST_TEST(A.unionAndCheckChanged(B));
+  BOOST_TEST(A == B);
+
+  // Large implementation, growing this
+  B.set(FirstLargeBit * 4);
+  BOOST_TEST(A.unionAndCheckChanged(B));
+  BOOST_TEST(A == B);
+  BOOST_TEST(not A.unionAndCheckChanged(B));
+
+  // Large this, small other
+  LazySmallBitVector C;
+  C.set(1);
+  BOOST_TEST(not A.unionAndCheckChanged(C));
+  C.set(3);
+  BOOST_TEST(A.unionAndCheckChanged(C));
+  BOOST_TEST(A[3]);
+}
+
+BOOST_AUTO_TEST_CASE(TestSize) {
+  LazySmallBitVector A;
+  BOOST_TEST(A.size() == 0U);
+
+  A.set(0);
+  A.set(5);
+  BOOST_TEST(A.size() == 2U);
+
+  A.set(FirstLargeBit * 3);
+  A.set(FirstLargeBit * 3 + 1);
+  BOOST_TEST(A.size() == 4U);
+
+  A.unset(0);
+  BOOST_TEST(A.size() == 3U);
+}
@@ -178,3 +178,32 @@ BOOST_AUTO_TEST_CASE(Map) {
 
   BOOST_TEST(Map.size() == size_t(5));
 }
+
+BOOST_AUTO_TEST_CASE(Text) {
+  auto RoundTrip = [](const MetaAddress &Address) {
+    MetaAddress::StringBuffer Buffer;
+    StringRef Text = Address.toString(Buffer);
+    BOOST_TEST((Text == Address.toString()));
+    return MetaAddress::fromString(Text) == Address;
+  };
+
+  BOOST_TEST(generic64(0x1234).toString() == "0x1234:Generic64");
+  BOOST_TEST(generic64(0).toString() == "0x0:Generic64");
+  BOOST_TEST(MetaAddress::invalid().toString() == ":Invalid");
+  BOOST_TEST(RoundTrip(MetaAddress::invalid()));
+  BOOST_TEST(RoundTrip(generic64(0xFFFFFFFFFFFFFFFF)));
+  BOOST_TEST(RoundTrip(MetaAddress(0x1000, MetaAddressType::Code_arm, 3, 0)));
+  BOOST_TEST(RoundTrip(MetaAddress(0x1000, MetaAddressType::Code_arm, 0, 2)));
+  BOOST_TEST(RoundTrip(MetaAddress(0x1000, MetaAddressType::Code_arm, 3, 2)));
+
+  // Inputs not emitted by toString
+  BOOST_TEST(MetaAddress::fromString("4096:Generic64") == generic64(0x1000));
+  BOOST_TEST(MetaAddress::fromString("0X1000:Generic64") == generic64(0x1000));
+  BOOST_TEST(MetaAddress::fromString("0x1000").isInvalid());
+  BOOST_TEST(MetaAddress::fromString("0x1000:Generic64:0:0:0").isInvalid());
+  BOOST_TEST(MetaAddress::fromString("0x1000:Invalid").isInvalid());
+  BOOST_TEST(MetaAddress::fromString("0x10000000000000000:Generic64")
+               .isInvalid());
+  BOOST_TEST(MetaAddress::fromString("0x1000:Generic64:99999999999")
+               .isInvalid());
+}
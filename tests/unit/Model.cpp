@@ -10,6 +10,8 @@ bool init_unit_test();
 #include "boost/test/unit_test.hpp"
 
 #include "revng/Model/Binary.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/Model/TupleTreeDiff.h"
 #include "revng/Support/MetaAddress/KeyTraits.h"
 
 using namespace model;
@@ -135,3 +137,152 @@ BOOST_AUTO_TEST_CASE(TestPathMatcher) {
     }
   }
 }
+
+BOOST_AUTO_TEST_CASE(TestCompiledPath) {
+  auto ARM1000 = MetaAddress::fromString("0x1000:Code_arm");
+  auto ARM2000 = MetaAddress::fromString("0x2000:Code_arm");
+
+  Binary TheBinary;
+  TheBinary.Functions[ARM1000].Name = "First";
+  TheBinary.Functions[ARM2000].Name = "Second";
+
+  using Path = CompiledPath<Binary>;
+  auto FirstName = Path::compile("/Functions/0x1000:Code_arm/Name").value();
+  auto SecondName = Path::compile("/Functions/0x2000:Code_arm/Name").value();
+  auto Functions = Path::compile("/Functions").value();
+  using FunctionsType = decltype(TheBinary.Functions);
+  revng_check(FirstName.targets<std::string>());
+  revng_check(Functions.targets<FunctionsType>());
+  revng_check(*FirstName.lookup<std::string>(TheBinary) == "First");
+  auto *FunctionsField = Functions.lookup<FunctionsType>(TheBinary);
+  revng_check(FunctionsField == &TheBinary.Functions);
+
+  // Invalid paths and missing keys
+  revng_check(not Path::compile("/Function"));
+  revng_check(not Path::compile(KeyIntVector{ 1 }));
+  auto Missing = Path::compile("/Functions/0x3000:Code_arm/Name").value();
+  revng_check(Missing.lookup<std::string>(TheBinary) == nullptr);
+
+  // Resolve a sorted batch, sharing the common prefixes
+  std::vector<Path> Batch{ SecondName, Missing, FirstName, Functions };
+  std::sort(Batch.begin(), Batch.end());
+  revng_check(Batch.front() == Functions);
+
+  CompiledPathSweep<Binary> Sweep(TheBinary);
+  revng_check(Sweep.lookup<FunctionsType>(Batch[0]) == &TheBinary.Functions);
+  revng_check(*Sweep.lookup<std::string>(Batch[1]) == "First");
+  revng_check(*Sweep.lookup<std::string>(Batch[2]) == "Second");
+  revng_check(Sweep.lookup<std::string>(Batch[3]) == nullptr);
+  revng_check(*Sweep.lookup<std::string>(FirstName) == "First");
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryEncoding) {
+  using namespace llvm;
+
+  auto ARM1000 = MetaAddress::fromString("0x1000:Code_arm");
+  auto ARM2000 = MetaAddress::fromString("0x2000:Code_arm");
+  auto ARM3000 = MetaAddress::fromString("0x3000:Code_arm");
+
+  Binary TheBinary;
+  Function &F = TheBinary.Functions[ARM1000];
+  F.Name = "FunctionName";
+  F.Type = FunctionType::Regular;
+  BasicBlock &Block = F.CFG[{ ARM1000, ARM2000 }];
+  Block.Successors.insert({ ARM3000, FunctionEdgeType::FunctionCall });
+  Block.Successors.insert({ ARM2000, FunctionEdgeType::DirectBranch });
+  TheBinary.Functions[ARM3000].Type = FunctionType::NoReturn;
+
+  auto ToYAML = [](Binary &Model) {
+    std::string Buffer;
+    {
+      raw_string_ostream Stream(Buffer);
+      yaml::Output YAMLOutput(Stream);
+      YAMLOutput << Model;
+    }
+    return Buffer;
+  };
+
+  std::string Encoded;
+  {
+    raw_string_ostream Stream(Encoded);
+    tupletree::binary::serialize(Stream, TheBinary);
+  }
+  revng_check(tupletree::binary::isBinary(Encoded));
+  revng_check(not tupletree::binary::isBinary(ToYAML(TheBinary)));
+
+  Binary Decoded;
+  tupletree::binary::deserialize(Encoded, Decoded);
+  revng_check(ToYAML(Decoded) == ToYAML(TheBinary));
+
+  // Lazily decode a single function
+  auto Matcher = PathMatcher::create<Binary>("/Functions/*").value();
+  Function Lazy(ARM1000);
+  using tupletree::binary::getByPath;
+  revng_check(getByPath<Binary>(Encoded, Matcher.apply(ARM1000), Lazy));
+  revng_check(Lazy.Name == "FunctionName");
+  revng_check(Lazy.CFG.at({ ARM1000, ARM2000 }).Successors.size() == 2);
+
+  // Lazily decode a field of another function
+  auto TypePath = stringAsPath<Binary>("/Functions/0x3000:Code_arm/Type");
+  FunctionType::Values Type = FunctionType::Invalid;
+  revng_check(getByPath<Binary>(Encoded, TypePath.value(), Type));
+  revng_check(Type == FunctionType::NoReturn);
+
+  // Look up a function that does not exist
+  Function Missing(ARM2000);
+  revng_check(not getByPath<Binary>(Encoded, Matcher.apply(ARM2000), Missing));
+
+  // Stream out all the functions, one at a time
+  std::vector<MetaAddress> Streamed;
+  auto FunctionsPath = stringAsPath<Binary>("/Functions").value();
+  using tupletree::binary::forEachByPath;
+  auto Collect = [&Streamed](const Function &F) {
+    Streamed.push_back(F.Entry);
+  };
+  bool Found = forEachByPath<Binary, Function>(Encoded, FunctionsPath, Collect);
+  revng_check(Found);
+  revng_check(Streamed == std::vector<MetaAddress>({ ARM1000, ARM3000 }));
+
+  // The path does not lead to a container of functions
+  Found = forEachByPath<Binary, Function>(Encoded, TypePath.value(), Collect);
+  revng_check(not Found);
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryDiff) {
+  using namespace llvm;
+
+  auto ARM1000 = MetaAddress::fromString("0x1000:Code_arm");
+  auto ARM2000 = MetaAddress::fromString("0x2000:Code_arm");
+  auto ARM3000 = MetaAddress::fromString("0x3000:Code_arm");
+
+  Binary Old;
+  Old.Functions[ARM1000].Name = "Renamed";
+  Old.Functions[ARM1000].Type = FunctionType::Regular;
+  Old.Functions[ARM2000].Type = FunctionType::Regular;
+
+  // Encode the diff and destroy the new model, the diff must be
+  // self-contained
+  std::string Encoded;
+  {
+    Binary New;
+    New.Functions[ARM1000].Name = "FunctionName";
+    New.Functions[ARM1000].Type = FunctionType::Regular;
+    BasicBlock &Block = New.Functions[ARM1000].CFG[{ ARM1000, ARM2000 }];
+    Block.Successors.insert({ ARM3000, FunctionEdgeType::Return });
+    New.Functions[ARM3000].Type = FunctionType::NoReturn;
+
+    raw_string_ostream Stream(Encoded);
+    tupletreediff::binary::serialize(Stream, diff(Old, New));
+  }
+  revng_check(tupletreediff::binary::isBinaryDiff(Encoded));
+
+  Binary Patched = Old;
+  tupletreediff::binary::apply(Encoded, Patched);
+
+  revng_check(Patched.Functions.count(ARM2000) == 0);
+  revng_check(Patched.Functions.at(ARM1000).Name == "FunctionName");
+  auto &PatchedBlock = Patched.Functions.at(ARM1000).CFG.at({ ARM1000,
+                                                              ARM2000 });
+  revng_check(PatchedBlock.Successors.size() == 1);
+  revng_check(Patched.Functions.at(ARM3000).Type == FunctionType::NoReturn);
+}
@@ -0,0 +1,177 @@
+/// \file PromoteStackSlots.cpp
+/// \brief Tests for the promote stack slots pass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE PromoteStackSlots
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/FunctionIsolation/PromoteStackSlots.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+// @function keeps a value in the 8 bytes right below the entry stack pointer
+// and either leaves through EXIT_HELPER or returns. The name of the exit
+// helper replaces EXIT_HELPER.
+static const char *ModuleText = R"LLVM(
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+@pc = internal global i64 0
+@rsp = internal global i64 0
+@rax = internal global i64 0
+
+declare void @EXIT_HELPER(i32, i64, i64, i64)
+
+define void @root() {
+entry:
+  ret void
+}
+
+define void @function() !revng.func.entry !2 {
+entry:
+  %sp = load i64, i64* @rsp
+  %slot_address = add i64 %sp, -8
+  %slot = inttoptr i64 %slot_address to i64*
+  store i64 42, i64* %slot
+  %new_sp = add i64 %sp, -16
+  store i64 %new_sp, i64* @rsp
+  %rax = load i64, i64* @rax
+  %leave = icmp eq i64 %rax, 0
+  br i1 %leave, label %exit_helper, label %return
+
+exit_helper:
+  call void @EXIT_HELPER(i32 0, i64 0, i64 0, i64 0)
+  unreachable
+
+return:
+  %value = load i64, i64* %slot
+  store i64 %value, i64* @rax
+  %restored_sp = add i64 %new_sp, 16
+  store i64 %restored_sp, i64* @rsp
+  ret void
+}
+
+!revng.input.architecture = !{!0}
+!revng.csv = !{!1}
+
+!0 = !{!"x86_64", i32 1, i32 0, !"pc", !"rsp", !{!"rax"}}
+!1 = !{i64* @pc, i64* @rsp, i64* @rax}
+!2 = !{!"function"}
+)LLVM";
+
+static std::unique_ptr<Module>
+promote(LLVMContext &Context, StringRef ExitHelper) {
+  std::string Text = ModuleText;
+  StringRef Placeholder = "EXIT_HELPER";
+  for (size_t Position = Text.find(Placeholder.data());
+       Position != std::string::npos;
+       Position = Text.find(Placeholder.data()))
+    Text.replace(Position, Placeholder.size(), ExitHelper.str());
+
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(StringRef(Text));
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  if (M.get() == nullptr) {
+    Diagnostic.print("revng", dbgs());
+    revng_abort();
+  }
+
+  legacy::PassManager PM;
+  PM.add(new PromoteStackSlots);
+  PM.run(*M);
+
+  revng_check(not verifyModule(*M, &dbgs()));
+
+  return M;
+}
+
+/// \brief Is \p I a copy of \p Frame back to guest memory?
+static bool isSpill(Instruction *I, AllocaInst *Frame) {
+  auto *Copy = dyn_cast_or_null<MemCpyInst>(I);
+  return Copy != nullptr and Copy->getSource()->stripPointerCasts() == Frame
+         and Copy->getLength() != nullptr
+         and getLimitedValue(Copy->getLength()) == 8;
+}
+
+static AllocaInst *frameOf(Function *F) {
+  AllocaInst *Result = nullptr;
+  for (Instruction &I : F->getEntryBlock()) {
+    if (auto *Alloca = dyn_cast<AllocaInst>(&I)) {
+      revng_check(Result == nullptr);
+      Result = Alloca;
+    }
+  }
+
+  revng_check(Result != nullptr);
+  return Result;
+}
+
+static void checkSpills(StringRef ExitHelper) {
+  LLVMContext Context;
+  auto M = promote(Context, ExitHelper);
+  Function *F = M->getFunction("function");
+
+  // A single region covers the slot and it's filled at the entry
+  AllocaInst *Frame = frameOf(F);
+  const DataLayout &DL = M->getDataLayout();
+  revng_check(DL.getTypeAllocSize(Frame->getAllocatedType()) == 8);
+
+  bool Filled = false;
+  for (Instruction &I : F->getEntryBlock())
+    if (auto *Copy = dyn_cast<MemCpyInst>(&I))
+      Filled = Filled or Copy->getDest()->stripPointerCasts() == Frame;
+  revng_check(Filled);
+
+  // The accesses to the slot go to the alloca
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB) {
+      Value *Pointer = nullptr;
+      if (auto *Load = dyn_cast<LoadInst>(&I))
+        Pointer = Load->getPointerOperand();
+      else if (auto *Store = dyn_cast<StoreInst>(&I))
+        Pointer = Store->getPointerOperand();
+
+      if (Pointer != nullptr and not isa<GlobalVariable>(Pointer))
+        revng_check(Pointer->stripInBoundsOffsets() == Frame);
+    }
+  }
+
+  // The frame is spilled right before the exit helper and the return
+  CallInst *Exit = nullptr;
+  ReturnInst *Return = nullptr;
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB) {
+      if (CallInst *Call = getCallTo(&I, ExitHelper))
+        Exit = Call;
+      else if (auto *Ret = dyn_cast<ReturnInst>(&I))
+        Return = Ret;
+    }
+  }
+
+  revng_check(Exit != nullptr and Return != nullptr);
+  revng_check(isSpill(Exit->getPrevNode(), Frame));
+  revng_check(isSpill(Return->getPrevNode(), Frame));
+}
+
+BOOST_AUTO_TEST_CASE(SpillBeforeRaiseException) {
+  checkSpills("raise_exception_helper");
+}
+
+BOOST_AUTO_TEST_CASE(SpillBeforeUnwindToRoot) {
+  checkSpills("unwind_to_root_helper");
+}
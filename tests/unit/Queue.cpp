@@ -0,0 +1,85 @@
+/// \file Queue.cpp
+/// \brief Tests for the work lists in Queue.h and UniquedStack.h
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstddef>
+#include <vector>
+
+#define BOOST_TEST_MODULE Queue
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/ADT/EpochSet.h"
+#include "revng/ADT/Queue.h"
+#include "revng/ADT/UniquedStack.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+struct Identity {
+  size_t operator()(unsigned Value) const { return Value; }
+};
+
+template<typename T>
+static std::vector<unsigned> drain(T &Queue) {
+  std::vector<unsigned> Result;
+  while (not Queue.empty())
+    Result.push_back(Queue.pop());
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(TestDenseUniquedQueue) {
+  DenseUniquedQueue<unsigned, Identity> Queue;
+  Queue.insert(3);
+  Queue.insert(1);
+  Queue.insert(3);
+  Queue.insert(100);
+  revng_check(Queue.size() == 3);
+  revng_check(drain(Queue) == std::vector<unsigned>({ 3, 1, 100 }));
+
+  // Once popped, an element can be inserted again
+  Queue.insert(3);
+  revng_check(drain(Queue) == std::vector<unsigned>({ 3 }));
+}
+
+BOOST_AUTO_TEST_CASE(TestDenseOnceQueue) {
+  DenseOnceQueue<unsigned, Identity> Queue(4);
+  Queue.insert(2);
+  revng_check(drain(Queue) == std::vector<unsigned>({ 2 }));
+
+  // An element can be inserted only once
+  Queue.insert(2);
+  revng_check(Queue.empty());
+  revng_check(Queue.visited(2));
+  revng_check(not Queue.visited(1));
+  revng_check(not Queue.visited(1000));
+}
+
+BOOST_AUTO_TEST_CASE(TestDenseUniquedStack) {
+  DenseUniquedStack<unsigned, Identity> Stack;
+  Stack.insert(1);
+  Stack.insert(2);
+  Stack.insert(1);
+  Stack.insert(3);
+  revng_check(Stack.size() == 3);
+  revng_check(drain(Stack) == std::vector<unsigned>({ 3, 2, 1 }));
+}
+
+BOOST_AUTO_TEST_CASE(TestEpochSet) {
+  EpochSet<unsigned, Identity> Set;
+  revng_check(Set.insert(5));
+  revng_check(not Set.insert(5));
+  revng_check(Set.count(5) == 1);
+  revng_check(Set.count(4) == 0);
+  revng_check(Set.count(1000) == 0);
+
+  Set.erase(5);
+  revng_check(Set.count(5) == 0);
+
+  // After clear, everything can be inserted again
+  revng_check(Set.insert(5));
+  Set.clear();
+  revng_check(Set.count(5) == 0);
+  revng_check(Set.insert(5));
+}
@@ -11,6 +11,7 @@ bool init_unit_test();
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IR/Verifier.h"
 #include "llvm/Passes/PassBuilder.h"
 
 #include "revng/BasicAnalyses/ShrinkInstructionOperandsPass.h"
@@ -20,11 +21,12 @@ bool init_unit_test();
 
 using namespace llvm;
 
-static Function *run(Module *M, const char *Body) {
+static Function *
+run(Module *M, const char *Body, bool WholeFunction = false) {
   Function *F = M->getFunction("main");
 
   FunctionPassManager FPM;
-  FPM.addPass(ShrinkInstructionOperandsPass());
+  FPM.addPass(ShrinkInstructionOperandsPass(WholeFunction));
 
   FunctionAnalysisManager FAM;
 
@@ -81,3 +83,62 @@ BOOST_AUTO_TEST_CASE(DontCareBinary) {
   revng_check(getSize(Add->getOperand(0)) == 32);
   revng_check(getSize(Add->getOperand(1)) == 32);
 }
+
+BOOST_AUTO_TEST_CASE(WholeFunction) {
+  const char *Body = R"LLVM(
+  %op = add i32 0, 0
+  %opx = zext i32 %op to i64
+  br label %loop
+
+loop:
+  %acc = phi i64 [ 0, %initial_block ], [ %next, %loop ]
+  %next = add i64 %acc, %opx
+  %low = and i64 %next, 4294967295
+  %done = icmp eq i64 %low, 0
+  br i1 %done, label %end, label %loop
+
+end:
+  store i64 %low, i64* @rax
+  ret void
+)LLVM";
+
+  LLVMContext TestContext;
+  std::unique_ptr<Module> M = loadModule(TestContext, Body);
+  Function *F = run(M.get(), Body, true);
+  revng_check(not verifyModule(*M, &dbgs()));
+
+  auto *Accumulator = instructionByName(F, "acc");
+  auto *Next = instructionByName(F, "next");
+
+  revng_check(getSize(Accumulator) == 32);
+  revng_check(getSize(Next) == 32);
+  revng_check(Next->getOperand(0) == Accumulator);
+  revng_check(cast<PHINode>(Accumulator)->getIncomingValue(1) == Next);
+}
+
+BOOST_AUTO_TEST_CASE(WholeFunctionDuplicatePredecessor) {
+  const char *Body = R"LLVM(
+  %op = add i32 0, 0
+  %opx = zext i32 %op to i64
+  switch i32 %op, label %end [ i32 1, label %merge
+                               i32 2, label %merge ]
+
+merge:
+  %merged = phi i64 [ %opx, %initial_block ], [ %opx, %initial_block ]
+  %low = and i64 %merged, 255
+  store i64 %low, i64* @rax
+  br label %end
+
+end:
+  ret void
+)LLVM";
+
+  LLVMContext TestContext;
+  std::unique_ptr<Module> M = loadModule(TestContext, Body);
+  Function *F = run(M.get(), Body, true);
+  revng_check(not verifyModule(*M, &dbgs()));
+
+  auto *Merged = cast<PHINode>(instructionByName(F, "merged"));
+  revng_check(getSize(Merged) == 8);
+  revng_check(Merged->getIncomingValue(0) == Merged->getIncomingValue(1));
+}
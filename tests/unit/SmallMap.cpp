@@ -102,3 +102,28 @@ BOOST_AUTO_TEST_CASE(CustomCompare) {
   revng_check(MIt != Map.end());
   revng_check(RIt->second == MIt->second);
 }
+
+BOOST_AUTO_TEST_CASE(SortedFind) {
+  SmallMap<int, int, 32> Map;
+
+  // Insert enough elements for find to use a binary search, in reverse order
+  // so that the inline container has to be sorted first
+  for (int I = 30; I >= 0; I -= 2)
+    Map[I] = I * 10;
+  Map.sort();
+
+  for (int I = 0; I <= 30; I++) {
+    auto It = Map.find(I);
+    if (I % 2 == 0) {
+      revng_check(It != Map.end());
+      revng_check(It->second == I * 10);
+    } else {
+      revng_check(It == Map.end());
+    }
+  }
+
+  // Appending in order keeps the inline container sorted
+  Map[40] = 400;
+  revng_check(Map.count(40) == 1);
+  revng_check(Map.count(41) == 0);
+}
@@ -147,6 +147,79 @@ target_link_libraries(test_shrinkinstructionoperands
 add_test(NAME test_shrinkinstructionoperands COMMAND ./bin/test_shrinkinstructionoperands)
 set_tests_properties(test_shrinkinstructionoperands PROPERTIES LABELS "unit")
 
+#
+# test_instrument
+#
+
+revng_add_private_executable(test_instrument "${SRC}/Instrument.cpp")
+target_compile_definitions(test_instrument
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_instrument
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_instrument
+  revngBasicAnalyses
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_instrument COMMAND ./bin/test_instrument)
+set_tests_properties(test_instrument PROPERTIES LABELS "unit")
+
+#
+# test_collectcfg
+#
+
+revng_add_private_executable(test_collectcfg "${SRC}/CollectCFG.cpp")
+target_compile_definitions(test_collectcfg
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_collectcfg
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_collectcfg
+  revngDump
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_collectcfg COMMAND ./bin/test_collectcfg)
+set_tests_properties(test_collectcfg PROPERTIES LABELS "unit")
+
+#
+# test_promotestackslots
+#
+
+revng_add_private_executable(test_promotestackslots "${SRC}/PromoteStackSlots.cpp")
+target_compile_definitions(test_promotestackslots
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_promotestackslots
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_promotestackslots
+  revngFunctionIsolation
+  revngBasicAnalyses
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_promotestackslots COMMAND ./bin/test_promotestackslots)
+set_tests_properties(test_promotestackslots PROPERTIES LABELS "unit")
+
+#
+# test_guestmemoryidioms
+#
+
+revng_add_private_executable(test_guestmemoryidioms "${SRC}/GuestMemoryIdioms.cpp")
+target_compile_definitions(test_guestmemoryidioms
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_guestmemoryidioms
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_guestmemoryidioms
+  revngBasicAnalyses
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_guestmemoryidioms COMMAND ./bin/test_guestmemoryidioms)
+set_tests_properties(test_guestmemoryidioms PROPERTIES LABELS "unit")
+
 #
 # test_metaaddress
 #
@@ -199,6 +272,23 @@ target_link_libraries(test_smallmap
 add_test(NAME test_smallmap COMMAND ./bin/test_smallmap)
 set_tests_properties(test_smallmap PROPERTIES LABELS "unit")
 
+#
+# test_queue
+#
+
+revng_add_private_executable(test_queue "${SRC}/Queue.cpp")
+target_compile_definitions(test_queue
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_queue
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_queue
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_queue COMMAND ./bin/test_queue)
+set_tests_properties(test_queue PROPERTIES LABELS "unit")
+
 #
 # test_genericgraph
 #
@@ -273,3 +363,16 @@ target_compile_definitions(test_recursive_coroutines_fallback PRIVATE DISABLE_RE
 
 add_recursive_coroutine_test(test_recursive_coroutines_iterative)
 target_compile_definitions(test_recursive_coroutines_iterative PRIVATE ITERATIVE)
+
+#
+# benchmark_adt
+#
+
+revng_add_private_executable(benchmark_adt "${SRC}/ADTBenchmarks.cpp")
+target_include_directories(benchmark_adt
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(benchmark_adt
+  revngSupport
+  ${LLVM_LIBRARIES})
+add_test(NAME benchmark_adt COMMAND ./bin/benchmark_adt --quick)
+set_tests_properties(benchmark_adt PROPERTIES LABELS "unit")
@@ -117,6 +117,13 @@ compare(LeftType &Left,
     std::pair<left_pointer, right_pointer> X{ FindLeft(I), FindRight(I) };
     revng_check(Result[I] == X);
   }
+
+  // zipmap_for_each has to produce the same pairs
+  std::vector<std::pair<left_pointer, right_pointer>> ForEachResult;
+  zipmap_for_each(Left, Right, [&ForEachResult](auto *L, auto *R) {
+    ForEachResult.emplace_back(L, R);
+  });
+  revng_check(ForEachResult == Result);
 }
 
 template<typename LeftMap, typename RightMap>
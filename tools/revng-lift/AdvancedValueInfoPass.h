@@ -4,6 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <vector>
+
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
@@ -12,11 +17,24 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/KnownBits.h"
 
+#include "llvm/Support/CommandLine.h"
+
 #include "revng/BasicAnalyses/AdvancedValueInfo.h"
+#include "revng/Support/OpaqueFunctionsPool.h"
+#include "revng/Support/Statistics.h"
 
 #include "JumpTargetManager.h"
 
-inline Logger<> AVIPassLogger("avipass");
+inline VerboseLogger AVIPassLogger("avipass");
+
+extern llvm::cl::opt<unsigned> AVIPhiBudget;
+extern llvm::cl::opt<unsigned> AVIMaxValues;
+
+/// Queries that exceeded the AVI phi budget, by basic block
+extern CounterMap<std::string> AVIBudgetExceeded;
+
+/// Distribution of the duration of the AVI queries, in seconds
+extern RunningStatistics AVIQueryDuration;
 
 class StaticDataMemoryOracle {
 private:
@@ -39,8 +57,102 @@ public:
   MaterializedValue load(llvm::Constant *Address) {
     return JTM.readFromPointer(Address, E);
   }
+
+  /// \brief Load all of \p Addresses, reading them as a table if possible
+  ///
+  /// The addresses are described as Base + Index * Stride, where Base is the
+  /// lowest address and Stride the greatest common divisor of the distances
+  /// from it, so that JumpTargetManager can read them all at once.
+  MaterializedValues loadAll(llvm::ArrayRef<llvm::Constant *> Addresses) {
+    using namespace llvm;
+
+    auto LoadAll = [this, &Addresses]() {
+      MaterializedValues Result;
+      Result.reserve(Addresses.size());
+      for (Constant *Address : Addresses)
+        Result.push_back(load(Address));
+      return Result;
+    };
+
+    if (Addresses.size() < 2)
+      return LoadAll();
+
+    Type *LoadedType = Addresses[0]->getType()->getPointerElementType();
+    unsigned LoadSize = DL.getTypeSizeInBits(LoadedType) / 8;
+
+    std::vector<uint64_t> RawAddresses;
+    RawAddresses.reserve(Addresses.size());
+    for (Constant *Address : Addresses) {
+      revng_assert(Address->getType()->getPointerElementType() == LoadedType);
+      Value *RealPointer = skipCasts(Address);
+      uint64_t RawAddress = 0;
+      if (not isa<ConstantPointerNull>(RealPointer))
+        RawAddress = getZExtValue(cast<ConstantInt>(RealPointer), DL);
+      RawAddresses.push_back(RawAddress);
+    }
+
+    uint64_t Base = *std::min_element(RawAddresses.begin(),
+                                      RawAddresses.end());
+    uint64_t Stride = 0;
+    for (uint64_t RawAddress : RawAddresses)
+      Stride = std::gcd(Stride, RawAddress - Base);
+    if (Stride == 0)
+      Stride = LoadSize;
+
+    std::vector<uint64_t> Indices;
+    Indices.reserve(RawAddresses.size());
+    for (uint64_t RawAddress : RawAddresses)
+      Indices.push_back((RawAddress - Base) / Stride);
+    std::sort(Indices.begin(), Indices.end());
+    Indices.erase(std::unique(Indices.begin(), Indices.end()), Indices.end());
+
+    // Build the set of indices out of the runs of consecutive indices. If
+    // there are too many of them, this doesn't look like a table.
+    const unsigned MaxRuns = 16;
+    unsigned Runs = 0;
+    ConstantRangeSet IndicesSet(64, false);
+    for (auto It = Indices.begin(); It != Indices.end();) {
+      auto RunEnd = std::next(It);
+      while (RunEnd != Indices.end() and *RunEnd == *std::prev(RunEnd) + 1)
+        ++RunEnd;
+
+      if (++Runs > MaxRuns)
+        return LoadAll();
+
+      ConstantRange Run(APInt(64, *It), APInt(64, *std::prev(RunEnd) + 1));
+      IndicesSet = IndicesSet.unionWith(Run);
+      It = RunEnd;
+    }
+
+    MaterializedValues Table = JTM.readTable(JTM.fromAbsolute(Base),
+                                             Stride,
+                                             LoadSize,
+                                             IndicesSet,
+                                             E);
+    revng_assert(Table.size() == Indices.size());
+
+    // Map the entries of the table back to the addresses
+    MaterializedValues Result;
+    Result.reserve(Addresses.size());
+    for (uint64_t RawAddress : RawAddresses) {
+      uint64_t Index = (RawAddress - Base) / Stride;
+      auto It = std::lower_bound(Indices.begin(), Indices.end(), Index);
+      Result.push_back(Table[It - Indices.begin()]);
+    }
+
+    return Result;
+  }
 };
 
+/// \brief Resolve the values tracked by revng_avi marker calls
+///
+/// Each marker call in the function is resolved through AdvancedValueInfo and
+/// the possible values are attached to it as revng.avi metadata.
+///
+/// \note Markers are resolved one at a time. The queries are not independent:
+///       LazyValueInfo and ScalarEvolution fill their caches while answering
+///       and AdvancedValueInfo::explore temporarily adds a use to the tracked
+///       value, and neither the analyses nor the IR use lists are thread-safe.
 class AdvancedValueInfoPass
   : public llvm::PassInfoMixin<AdvancedValueInfoPass> {
 private:
@@ -53,15 +165,12 @@ public:
   llvm::PreservedAnalyses
   run(llvm::Function &F, llvm::FunctionAnalysisManager &);
 
-  static llvm::Function *createMarker(llvm::Module *M) {
+  static llvm::Function *
+  createMarker(llvm::LLVMContext &C, OpaqueFunctionsRegistry &Registry) {
     using namespace llvm;
     using FT = FunctionType;
-    LLVMContext &C = getContext(M);
     FT *Type = FT::get(FT::getVoidTy(C), {}, true);
-    FunctionCallee Callee = M->getOrInsertFunction(MarkerName, Type);
-    auto *Marker = cast<Function>(Callee.getCallee());
-    Marker->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
-    return Marker;
+    return Registry.get(MarkerName, Type, { Attribute::InaccessibleMemOnly });
   }
 };
 
@@ -69,6 +178,7 @@ inline llvm::PreservedAnalyses
 AdvancedValueInfoPass::run(llvm::Function &F,
                            llvm::FunctionAnalysisManager &FAM) {
   using namespace llvm;
+  ScopedTimer Timer("AdvancedValueInfo");
 
   std::set<Instruction *> ToReplace;
   for (BasicBlock &BB : F) {
@@ -104,12 +214,17 @@ AdvancedValueInfoPass::run(llvm::Function &F,
   // The StaticDataMemoryOracle provide the contents of memory areas that are
   // mapped statically (i.e., in segments). This is critical to capture, e.g.,
   // virtual tables
-  StaticDataMemoryOracle MO(F.getParent()->getDataLayout(), *JTM);
+  StaticDataMemoryOracle StaticMO(F.getParent()->getDataLayout(), *JTM);
+
+  // Avoid reading the same tables over and over across the queries
+  using MemoryOracle = CachingMemoryOracle<StaticDataMemoryOracle>;
+  MemoryOracle MO(StaticMO);
 
   auto &LVI = FAM.getResult<LazyValueAnalysis>(F);
   auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
   auto &SCEV = FAM.getResult<ScalarEvolutionAnalysis>(F);
-  AdvancedValueInfo<StaticDataMemoryOracle> AVI(LVI, SCEV, DT, MO);
+  using AVIType = AdvancedValueInfo<MemoryOracle>;
+  AVIType AVI(LVI, SCEV, DT, MO, AVIPhiBudget, AVIMaxValues);
 
 #ifndef NDEBUG
   // Ensure that no instruction has itself as operand, except for phis
@@ -131,7 +246,17 @@ AdvancedValueInfoPass::run(llvm::Function &F,
     AVIPassLogger << "Tracking " << ToTrack << ":";
 
     // Let AVI provide a series of possible values
+    auto Begin = std::chrono::steady_clock::now();
     MaterializedValues Values = AVI.explore(Call->getParent(), ToTrack);
+    std::chrono::duration<double> Duration = std::chrono::steady_clock::now()
+                                             - Begin;
+    AVIQueryDuration.push(Duration.count(), [Call]() {
+      return Call->getParent()->getName().str();
+    });
+    if (AVI.exceededBudget()) {
+      AVIPassLogger << " budget exceeded";
+      AVIBudgetExceeded.push(Call->getParent()->getName().str());
+    }
 
     //
     // Create a revng.avi metadata containing the type of instruction and
@@ -5,6 +5,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -26,6 +27,7 @@
 
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
+#include "revng/Support/Statistics.h"
 
 #include "BinaryFile.h"
 
@@ -34,10 +36,9 @@ using namespace llvm;
 
 using std::make_pair;
 
-using LabelList = BinaryFile::LabelList;
-
 static Logger<> EhFrameLog("ehframe");
 static Logger<> LabelsLog("labels");
+static MemoryGauge LabelsMemory("BinaryFile labels");
 
 const unsigned char R_MIPS_IMPLICIT_RELATIVE = 255;
 
@@ -713,7 +714,8 @@ public:
           TheSize = Size;
         }
 
-        return { ArrayRef<uint8_t>(Segment.Data.data() + Offset, TheSize) };
+        // Note: this asserts if the requested range is not in the file
+        return Segment.Data.slice(Offset, TheSize);
       }
     }
 
@@ -809,6 +811,7 @@ void BinaryFile::parseCOFF(object::ObjectFile *TheBinary, uint64_t) {
     revng_assert(contains(RawDataRef, Segment.Data));
 
     Segments.push_back(Segment);
+    invalidateSegmentsIndex();
   }
 }
 
@@ -834,6 +837,7 @@ void BinaryFile::parseMachOSegment(ArrayRef<uint8_t> RawDataRef,
   revng_assert(contains(RawDataRef, Segment.Data));
 
   Segments.push_back(Segment);
+  invalidateSegmentsIndex();
 }
 
 template<typename T, bool HasAddend>
@@ -995,6 +999,7 @@ void BinaryFile::parseELF(object::ObjectFile *TheBinary,
       }
 
       Segments.push_back(Segment);
+      invalidateSegmentsIndex();
 
       // Check if it's the segment containing the program headers
       auto ProgramHeaderStart = ProgramHeader.p_offset;
@@ -1162,7 +1167,8 @@ void BinaryFile::parseELF(object::ObjectFile *TheBinary,
       using Elf_Sym = llvm::object::Elf_Sym_Impl<T>;
       DynsymPortion.setSize(*SymbolsCount * sizeof(Elf_Sym));
       ArrayRef<Elf_Sym> Symbols = DynsymPortion.extractAs<Elf_Sym>(Segments);
-      for (Elf_Sym Symbol : Symbols) {
+      Labels.reserve(Labels.size() + Symbols.size());
+      for (const Elf_Sym &Symbol : Symbols) {
         auto Name = Symbol.getName(Dynstr);
         if (not Name) {
           logAllUnhandledErrors(std::move(Name.takeError()), errs(), "");
@@ -1271,6 +1277,47 @@ uint64_t BinaryFile::symbolsCount(const FilePortion &Relocations) {
   return SymbolsCount;
 }
 
+/// \brief Decode the integer of \p Size bytes at \p Offset in \p Segment
+static uint64_t decodeRawValue(const SegmentInfo &Segment,
+                               uint64_t Offset,
+                               unsigned Size,
+                               bool IsLittleEndian) {
+  // Handle the [p_filesz, p_memsz] portion of the segment
+  if (Offset > Segment.Data.size())
+    return 0;
+
+  const unsigned char *Start = Segment.Data.data() + Offset;
+
+  char Buffer[8] = { 0 };
+  memcpy(&Buffer,
+         Start,
+         std::min(static_cast<size_t>(Size), Segment.Data.size() - Offset));
+
+  using support::endianness;
+  using support::endian::read;
+  switch (Size) {
+  case 1:
+    return read<uint8_t, endianness::little, 1>(&Buffer);
+  case 2:
+    if (IsLittleEndian)
+      return read<uint16_t, endianness::little, 1>(&Buffer);
+    else
+      return read<uint16_t, endianness::big, 1>(&Buffer);
+  case 4:
+    if (IsLittleEndian)
+      return read<uint32_t, endianness::little, 1>(&Buffer);
+    else
+      return read<uint32_t, endianness::big, 1>(&Buffer);
+  case 8:
+    if (IsLittleEndian)
+      return read<uint64_t, endianness::little, 1>(&Buffer);
+    else
+      return read<uint64_t, endianness::big, 1>(&Buffer);
+  default:
+    revng_abort("Unexpected read size");
+  }
+}
+
 Optional<uint64_t> BinaryFile::readRawValue(MetaAddress Address,
                                             unsigned Size,
                                             Endianess E) const {
@@ -1278,49 +1325,63 @@ Optional<uint64_t> BinaryFile::readRawValue(MetaAddress Address,
                            architecture().isLittleEndian() :
                            E == LittleEndian);
 
-  for (auto &Segment : segments()) {
-    // Note: we also consider writeable memory areas because, despite being
-    // modifiable, can contain useful information
-    if (Segment.contains(Address, Size) && Segment.IsReadable) {
-      uint64_t Offset = Address - Segment.StartVirtualAddress;
-      // Handle the [p_filesz, p_memsz] portion of the segment
-      if (Offset > Segment.Data.size())
-        return 0;
-
-      const unsigned char *Start = Segment.Data.data() + Offset;
-
-      char Buffer[8] = { 0 };
-      memcpy(&Buffer,
-             Start,
-             std::min(static_cast<size_t>(Size), Segment.Data.size() - Offset));
-
-      using support::endianness;
-      using support::endian::read;
-      switch (Size) {
-      case 1:
-        return read<uint8_t, endianness::little, 1>(&Buffer);
-      case 2:
-        if (IsLittleEndian)
-          return read<uint16_t, endianness::little, 1>(&Buffer);
-        else
-          return read<uint16_t, endianness::big, 1>(&Buffer);
-      case 4:
-        if (IsLittleEndian)
-          return read<uint32_t, endianness::little, 1>(&Buffer);
-        else
-          return read<uint32_t, endianness::big, 1>(&Buffer);
-      case 8:
-        if (IsLittleEndian)
-          return read<uint64_t, endianness::little, 1>(&Buffer);
-        else
-          return read<uint64_t, endianness::big, 1>(&Buffer);
-      default:
-        revng_abort("Unexpected read size");
-      }
+  // Note: we also consider writeable memory areas because, despite being
+  //       modifiable, can contain useful information
+  auto CanRead = [Address, Size](const SegmentInfo &Segment) {
+    return Segment.contains(Address, Size) && Segment.IsReadable;
+  };
+
+  // Fast path: the first segment containing Address is usually the one
+  const SegmentInfo *Found = findSegment(Address);
+  if (Found == nullptr)
+    return Optional<uint64_t>();
+
+  if (not CanRead(*Found)) {
+    // Consider all the other segments containing Address too
+    auto It = llvm::find_if(Segments, CanRead);
+    if (It == Segments.end())
+      return Optional<uint64_t>();
+    Found = &*It;
+  }
+
+  uint64_t Offset = Address - Found->StartVirtualAddress;
+  return decodeRawValue(*Found, Offset, Size, IsLittleEndian);
+}
+
+std::vector<Optional<uint64_t>>
+BinaryFile::readRawValues(MetaAddress Base,
+                          uint64_t Stride,
+                          unsigned Size,
+                          ArrayRef<uint64_t> Indices,
+                          Endianess E) const {
+  std::vector<Optional<uint64_t>> Result;
+  if (Indices.empty())
+    return Result;
+
+  revng_assert(llvm::is_sorted(Indices));
+  Result.reserve(Indices.size());
+
+  bool IsLittleEndian = ((E == OriginalEndianess) ?
+                           architecture().isLittleEndian() :
+                           E == LittleEndian);
+
+  // Look up the segment once, if the whole table is in it
+  MetaAddress First = Base + Indices.front() * Stride;
+  MetaAddress Last = Base + Indices.back() * Stride;
+  const SegmentInfo *Segment = findSegment(First);
+  if (Segment != nullptr and Segment->IsReadable
+      and Segment->contains(Last, Size)) {
+    uint64_t FirstOffset = First - Segment->StartVirtualAddress;
+    for (uint64_t Index : Indices) {
+      uint64_t Offset = FirstOffset + (Index - Indices.front()) * Stride;
+      Result.push_back(decodeRawValue(*Segment, Offset, Size, IsLittleEndian));
     }
+  } else {
+    for (uint64_t Index : Indices)
+      Result.push_back(readRawValue(Base + Index * Stride, Size, E));
   }
 
-  return Optional<uint64_t>();
+  return Result;
 }
 
 Label BinaryFile::parseRelocation(unsigned char RelocationType,
@@ -1400,10 +1461,18 @@ void BinaryFile::registerRelocations(Elf_Rel_Array<T, HasAddend> Relocations,
   using Elf_Rel = llvm::object::Elf_Rel_Impl<T, HasAddend>;
   using Elf_Sym = llvm::object::Elf_Sym_Impl<T>;
 
+  // Locate the symbol and string tables once, not for each relocation
   ArrayRef<Elf_Sym> Symbols;
   if (Dynsym.isAvailable())
     Symbols = Dynsym.extractAs<Elf_Sym>(Segments);
 
+  StringRef Strings;
+  bool HasSymbols = Dynsym.isAvailable() and Dynstr.isAvailable();
+  if (HasSymbols)
+    Strings = Dynstr.extractString(Segments);
+
+  Labels.reserve(Labels.size() + Relocations.size());
+
   for (Elf_Rel Relocation : Relocations) {
     auto Type = static_cast<unsigned char>(Relocation.getType(false));
     uint64_t Addend = RelocationHelper<T, HasAddend>::getAddend(Relocation);
@@ -1412,11 +1481,11 @@ void BinaryFile::registerRelocations(Elf_Rel_Array<T, HasAddend> Relocations,
     StringRef SymbolName;
     uint64_t SymbolSize = 0;
     unsigned char SymbolType = llvm::ELF::STT_NOTYPE;
-    if (Dynsym.isAvailable() and Dynstr.isAvailable()) {
+    if (HasSymbols) {
       uint32_t SymbolIndex = Relocation.getSymbol(false);
       revng_check(SymbolIndex < Symbols.size());
       const Elf_Sym &Symbol = Symbols[SymbolIndex];
-      auto Result = Symbol.getName(Dynstr.extractString(Segments));
+      auto Result = Symbol.getName(Strings);
       if (Result)
         SymbolName = *Result;
       SymbolSize = Symbol.st_size;
@@ -1432,17 +1501,147 @@ void BinaryFile::registerRelocations(Elf_Rel_Array<T, HasAddend> Relocations,
   }
 }
 
-static LabelList &operator+=(LabelList &This, const LabelList &Other) {
-  This.insert(std::end(This), std::begin(Other), std::end(Other));
-  return This;
+void BinaryFile::updateSegmentsIndex() const {
+  if (SegmentsIndexValid)
+    return;
+
+  SegmentsIndexValid = true;
+  LastSegmentHit = 0;
+
+  SortedSegments.resize(Segments.size());
+  for (size_t I = 0; I < Segments.size(); I++)
+    SortedSegments[I] = I;
+
+  auto Compare = [this](size_t This, size_t Other) {
+    return (Segments[This].StartVirtualAddress.address()
+            < Segments[Other].StartVirtualAddress.address());
+  };
+  std::stable_sort(SortedSegments.begin(), SortedSegments.end(), Compare);
+
+  // In case of overlapping segments, drop the index: we need to preserve the
+  // semantics of returning the first matching segment
+  for (size_t I = 1; I < SortedSegments.size(); I++) {
+    const SegmentInfo &Previous = Segments[SortedSegments[I - 1]];
+    const SegmentInfo &Current = Segments[SortedSegments[I]];
+    if (Current.StartVirtualAddress.address()
+        < Previous.EndVirtualAddress.address()) {
+      SortedSegments.clear();
+      break;
+    }
+  }
+}
+
+const SegmentInfo *BinaryFile::findSegment(MetaAddress Address) const {
+  updateSegmentsIndex();
+
+  // Overlapping segments, fall back to a linear scan
+  if (SortedSegments.empty()) {
+    for (const SegmentInfo &Segment : Segments)
+      if (Segment.contains(Address))
+        return &Segment;
+    return nullptr;
+  }
+
+  // Fast path: check the last segment we found
+  const SegmentInfo &Last = Segments[LastSegmentHit];
+  if (Last.contains(Address))
+    return &Last;
+
+  // Look for the last segment starting at or before Address
+  auto Compare = [this](uint64_t Value, size_t Index) {
+    return Value < Segments[Index].StartVirtualAddress.address();
+  };
+  auto It = std::upper_bound(SortedSegments.begin(),
+                             SortedSegments.end(),
+                             Address.address(),
+                             Compare);
+  if (It == SortedSegments.begin())
+    return nullptr;
+
+  --It;
+  const SegmentInfo &Segment = Segments[*It];
+  if (not Segment.contains(Address))
+    return nullptr;
+
+  LastSegmentHit = *It;
+  return &Segment;
 }
 
-void BinaryFile::rebuildLabelsMap() {
-  using Interval = boost::icl::interval<MetaAddress, compareAddress>;
+void BinaryFile::LabelIntervalMap::rebuild(std::vector<Label> &Labels) {
+  clear();
+
+  // Each label contributes an event where it starts and one where it ends.
+  // Labels are identified by their index, which preserves their order.
+  struct Event {
+    MetaAddress Address;
+    unsigned Index;
+    bool IsStart;
+  };
+
+  std::vector<Event> Events;
+  Events.reserve(2 * Labels.size());
+  for (unsigned I = 0; I < Labels.size(); ++I) {
+    MetaAddress Start = Labels[I].address();
+    MetaAddress End = Start + Labels[I].size();
+
+    // Empty labels do not cover anything
+    if (not Start.addressLowerThan(End))
+      continue;
+
+    Events.push_back({ Start, I, true });
+    Events.push_back({ End, I, false });
+  }
 
-  // Clear the map
-  LabelsMap.clear();
+  auto Compare = [](const Event &This, const Event &Other) {
+    return This.Address.addressLowerThan(Other.Address);
+  };
+  llvm::sort(Events, Compare);
+
+  // Sweep the events, emitting a segment between each pair of consecutive
+  // boundaries covered by at least a label
+  std::vector<unsigned> Active;
+  std::vector<size_t> Offsets;
+  MetaAddress Last = MetaAddress::invalid();
+  auto It = Events.begin();
+  while (It != Events.end()) {
+    MetaAddress Address = It->Address;
+
+    if (not Active.empty() and Last.addressLowerThan(Address)) {
+      Segment &NewSegment = Segments.emplace_back();
+      NewSegment.Start = Last;
+      NewSegment.End = Address;
+      Offsets.push_back(SegmentsLabels.size());
+      for (unsigned Index : Active)
+        SegmentsLabels.push_back(&Labels[Index]);
+    }
+
+    // Apply all the events at this address
+    for (; It != Events.end() and It->Address.addressLowerThanOrEqual(Address);
+         ++It) {
+      auto Position = llvm::lower_bound(Active, It->Index);
+      if (It->IsStart) {
+        Active.insert(Position, It->Index);
+      } else {
+        revng_assert(Position != Active.end() and *Position == It->Index);
+        Active.erase(Position);
+      }
+    }
+
+    Last = Address;
+  }
+
+  revng_assert(Active.empty());
 
+  // SegmentsLabels will no longer grow, point the segments to their labels
+  Offsets.push_back(SegmentsLabels.size());
+  ArrayRef<Label *> AllLabels = SegmentsLabels;
+  for (unsigned I = 0; I < Segments.size(); ++I) {
+    size_t Count = Offsets[I + 1] - Offsets[I];
+    Segments[I].Labels = AllLabels.slice(Offsets[I], Count);
+  }
+}
+
+void BinaryFile::rebuildLabelsMap() {
   // Identify all the 0-sized labels
   std::vector<Label *> ZeroSizedLabels;
   for (Label &L : Labels)
@@ -1493,22 +1692,19 @@ void BinaryFile::rebuildLabelsMap() {
     ZeroSizedLabels[I]->setVirtualSize(End - Start);
   }
 
-  // Insert all the other labels in the map
-  for (Label &L : Labels) {
-    MetaAddress Start = L.address();
-    MetaAddress End = L.address() + L.size();
-    LabelsMap += make_pair(Interval::right_open(Start, End), LabelList{ &L });
-  }
+  // Build the map out of all the labels
+  LabelsMap.rebuild(Labels);
+  LabelsMemory.set(Labels.capacity() * sizeof(Label) + LabelsMap.footprint());
 
   // Dump the map out
   if (LabelsLog.isEnabled()) {
-    for (auto &P : LabelsMap) {
+    for (const LabelIntervalMap::Segment &S : LabelsMap) {
       dbg << "[";
-      P.first.lower().dump(dbg);
+      S.Start.dump(dbg);
       dbg << ",";
-      P.first.upper().dump(dbg);
+      S.End.dump(dbg);
       dbg << "]\n";
-      for (const Label *L : P.second) {
+      for (const Label *L : S.Labels) {
         dbg << "  ";
         L->dump(dbg);
         dbg << "\n";
@@ -1761,6 +1957,9 @@ void BinaryFile::parseEHFrame(MetaAddress EHFrameAddress,
   DenseMap<uint64_t, DecodedCIE> CachedCIEs;
   unsigned FDEIndex = 0;
 
+  if (FDEsCount)
+    LandingPads.reserve(LandingPads.size() + *FDEsCount);
+
   while (!EHFrameReader.eof()
          && ((FDEsCount && FDEIndex < *FDEsCount)
              || (EHFrameSize && EHFrameReader.offset() < *EHFrameSize))) {
@@ -1843,7 +2042,7 @@ void BinaryFile::parseEHFrame(MetaAddress EHFrameAddress,
             logAddress(EhFrameLog, "Personality function: ", PersonalityPtr);
 
             // TODO: technically this is not a landing pad
-            LandingPads.insert(PersonalityPtr);
+            LandingPads.push_back(PersonalityPtr);
             break;
           }
           case 'R':
@@ -1900,6 +2099,11 @@ void BinaryFile::parseEHFrame(MetaAddress EHFrameAddress,
     // Skip all the remaining parts
     EHFrameReader.moveTo(EndOffset);
   }
+
+  // Deduplicate the landing pads at once
+  llvm::sort(LandingPads);
+  LandingPads.erase(std::unique(LandingPads.begin(), LandingPads.end()),
+                    LandingPads.end());
 }
 
 template<typename T>
@@ -1947,10 +2151,8 @@ void BinaryFile::parseLSDA(MetaAddress FDEStart, MetaAddress LSDAAddress) {
     LSDAReader.readULEB128();
 
     if (LandingPad.isValid()) {
-      if (LandingPads.count(LandingPad) == 0)
-        logAddress(EhFrameLog, "New landing pad found: ", LandingPad);
-
-      LandingPads.insert(LandingPad);
+      logAddress(EhFrameLog, "Landing pad found: ", LandingPad);
+      LandingPads.push_back(LandingPad);
     }
   }
 }
@@ -1973,13 +2175,12 @@ static bool isBetterThan(const Label *NewCandidate, const Label *OldCandidate) {
 
 std::string
 BinaryFile::nameForAddress(MetaAddress Address, uint64_t Size) const {
-  using interval = boost::icl::interval<MetaAddress, compareAddress>;
   std::stringstream Result;
   const auto &SymbolMap = labels();
 
   auto End = Address.toGeneric() + Size;
   revng_assert(Address.isValid() and End.isValid());
-  auto It = SymbolMap.find(interval::right_open(Address, End));
+  auto It = SymbolMap.find(Address, End);
   if (It != SymbolMap.end()) {
     // We have to look for (in order):
     //
@@ -1990,7 +2191,7 @@ BinaryFile::nameForAddress(MetaAddress Address, uint64_t Size) const {
     const Label *ContainedNonZeroSized = nullptr;
     const Label *ContainedZeroSized = nullptr;
 
-    for (const Label *L : It->second) {
+    for (const Label *L : It->Labels) {
       // Consider symbols only
       if (not L->isSymbol())
         continue;
@@ -4,13 +4,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 
-#include "boost/icl/interval_map.hpp"
-
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Object/Binary.h"
 #include "llvm/Object/ELFTypes.h"
 
@@ -38,6 +39,12 @@ struct SegmentInfo {
   bool IsExecutable;
   bool IsReadable;
   std::vector<std::pair<MetaAddress, MetaAddress>> ExecutableSections;
+
+  /// \brief View on the content of the segment available in the input file
+  ///
+  /// This points directly into the (memory-mapped) input file, no copy is
+  /// performed. It might be shorter than size(): the rest of the segment is
+  /// zero-filled (e.g., .bss).
   llvm::ArrayRef<uint8_t> Data;
 
   SegmentInfo() :
@@ -51,7 +58,7 @@ struct SegmentInfo {
     IsReadable(false) {}
 
   /// Produce a name for this segment suitable for human understanding
-  std::string generateName();
+  std::string generateName() const;
 
   bool contains(MetaAddress Address) const {
     return (StartVirtualAddress.addressLowerThanOrEqual(Address)
@@ -64,6 +71,18 @@ struct SegmentInfo {
 
   uint64_t size() const { return EndVirtualAddress - StartVirtualAddress; }
 
+  /// \brief Return the content of the segment from \p Address onward
+  ///
+  /// \note Only the part available in the input file is returned, which might
+  ///       be empty.
+  llvm::ArrayRef<uint8_t> dataFrom(MetaAddress Address) const {
+    revng_assert(contains(Address));
+    uint64_t Offset = Address - StartVirtualAddress;
+    if (Offset >= Data.size())
+      return {};
+    return Data.drop_front(Offset);
+  }
+
   template<class C>
   void insertExecutableRanges(std::back_insert_iterator<C> Inserter) const {
     if (!IsExecutable)
@@ -95,7 +114,7 @@ struct SegmentInfo {
 
 namespace LabelType {
 
-enum Values {
+enum Values : uint8_t {
   Invalid,
   AbsoluteValue,
   BaseRelativeValue,
@@ -124,7 +143,7 @@ inline const char *getName(Values V) {
 
 namespace SymbolType {
 
-enum Values { Unknown, Code, Data, Section, File };
+enum Values : uint8_t { Unknown, Code, Data, Section, File };
 
 inline const char *getName(Values V) {
   switch (V) {
@@ -170,7 +189,12 @@ inline SymbolType::Values fromELF(unsigned char ELFSymbolType) {
 
 namespace LabelOrigin {
 
-enum Values { Unknown, StaticSymbol, DynamicSymbol, DynamicRelocation };
+enum Values : uint8_t {
+  Unknown,
+  StaticSymbol,
+  DynamicSymbol,
+  DynamicRelocation
+};
 
 inline const char *getName(Values V) {
 
@@ -190,30 +214,33 @@ inline const char *getName(Values V) {
 
 } // namespace LabelOrigin
 
+/// \note Binaries can have millions of labels: the fields are laid out so that
+///       the small ones share a single word at the end
 class Label {
 private:
-  LabelType::Values Type;
   MetaAddress Address;
   uint64_t Size;
 
-  /// Name of the symbol, if any
-  llvm::StringRef SymbolName;
-  SymbolType::Values SymbolType;
-
   /// Label value. It has different meanings depending on the label type
   uint64_t Value;
 
+  /// Name of the symbol, if any. It points into the string table of the
+  /// binary, so names are never copied.
+  llvm::StringRef SymbolName;
+
+  LabelType::Values Type;
+  SymbolType::Values SymbolType;
   LabelOrigin::Values Origin;
   bool SizeIsVirtual;
 
 private:
   Label(LabelOrigin::Values Origin, MetaAddress Address, uint64_t Size) :
-    Type(LabelType::Invalid),
     Address(Address),
     Size(Size),
+    Value(0),
     SymbolName(),
+    Type(LabelType::Invalid),
     SymbolType(SymbolType::Unknown),
-    Value(0),
     Origin(Origin),
     SizeIsVirtual(false) {}
 
@@ -439,18 +466,73 @@ private:
 
 class FilePortion;
 
-using boost::icl::partial_absorber;
-
-template<typename A, typename B, ICL_COMPARE C>
-using interval_map = boost::icl::interval_map<A, B, partial_absorber, C>;
-
 /// \brief BinaryFile describes an input image file in a semi-architecture
 ///        independent way
 class BinaryFile {
 public:
-  using LabelList = llvm::SmallVector<Label *, 6u>;
+  using LabelList = llvm::ArrayRef<Label *>;
+
+  /// \brief Sorted, non-overlapping segments of the address space, each
+  ///        associated to the labels covering it
+  ///
+  /// The segments are computed in a single sweep over the boundaries of all
+  /// the labels, and looked up through binary search. Within a segment, labels
+  /// preserve the order in which they have been registered. Addresses not
+  /// covered by any label have no segment.
+  ///
+  /// The labels of all the segments are stored contiguously in a single array,
+  /// each segment referencing its own slice.
+  class LabelIntervalMap {
+  public:
+    struct Segment {
+      MetaAddress Start;
+      MetaAddress End;
+      LabelList Labels;
+    };
+
+    using const_iterator = std::vector<Segment>::const_iterator;
+
+  private:
+    std::vector<Segment> Segments;
+    std::vector<Label *> SegmentsLabels;
+
+  public:
+    /// \brief Recompute the segments from scratch out of \p Labels
+    void rebuild(std::vector<Label> &Labels);
+
+    void clear() {
+      Segments.clear();
+      SegmentsLabels.clear();
+    }
+    bool empty() const { return Segments.empty(); }
+    size_t size() const { return Segments.size(); }
+
+    /// \brief Number of bytes taken by the segments
+    uint64_t footprint() const {
+      return (Segments.capacity() * sizeof(Segment)
+              + SegmentsLabels.capacity() * sizeof(Label *));
+    }
+
+    const_iterator begin() const { return Segments.begin(); }
+    const_iterator end() const { return Segments.end(); }
 
-  using LabelIntervalMap = interval_map<MetaAddress, LabelList, compareAddress>;
+    /// \brief Find the first segment overlapping [\p Start, \p End)
+    const_iterator find(MetaAddress Start, MetaAddress End) const {
+      auto It = llvm::partition_point(Segments, [Start](const Segment &S) {
+        return S.End.addressLowerThanOrEqual(Start);
+      });
+
+      if (It == Segments.end() or not It->Start.addressLowerThan(End))
+        return Segments.end();
+
+      return It;
+    }
+
+    /// \brief Find the segment containing \p Address
+    const_iterator find(MetaAddress Address) const {
+      return find(Address, Address + 1);
+    }
+  };
 
   enum Endianess { OriginalEndianess, BigEndian, LittleEndian };
 
@@ -467,9 +549,7 @@ public:
   getAddressData(MetaAddress Address) const {
     const SegmentInfo *Segment = findSegment(Address);
     if (Segment != nullptr) {
-      uint64_t Offset = Address - Segment->StartVirtualAddress;
-      uint64_t Size = Segment->size() - Offset;
-      return { llvm::ArrayRef<uint8_t>(Segment->Data.data() + Offset, Size) };
+      return { Segment->dataFrom(Address) };
     } else {
       return llvm::Optional<llvm::ArrayRef<uint8_t>>();
     }
@@ -477,7 +557,7 @@ public:
 
   MetaAddress virtualAddressFromOffset(uint64_t Offset) const {
     for (const SegmentInfo &Segment : Segments)
-      if (Segment.StartFileOffset <= Offset and Segment.EndFileOffset < Offset)
+      if (Segment.StartFileOffset <= Offset and Offset < Segment.EndFileOffset)
         return Segment.StartVirtualAddress + (Offset - Segment.StartFileOffset);
     return MetaAddress::invalid();
   }
@@ -487,10 +567,12 @@ public:
   //
 
   const Architecture &architecture() const { return TheArchitecture; }
+  /// \note The index of the segments is built on their boundaries, which must
+  ///       not be changed through this accessor
   std::vector<SegmentInfo> &segments() { return Segments; }
   const std::vector<SegmentInfo> &segments() const { return Segments; }
   const LabelIntervalMap &labels() const { return LabelsMap; }
-  const std::set<MetaAddress> &landingPads() const { return LandingPads; }
+  const std::vector<MetaAddress> &landingPads() const { return LandingPads; }
   const std::set<MetaAddress> &codePointers() const { return CodePointers; }
   MetaAddress entryPoint() const { return EntryPoint; }
 
@@ -519,6 +601,8 @@ public:
     auto R = getAddressData(Ptr.value());
     revng_assert(R, "Pointer not available in any segment");
     llvm::ArrayRef<uint8_t> Pointer = *R;
+    revng_assert(Pointer.size() >= sizeof(typename T::uint),
+                 "Pointer not available in the input file");
 
     return fromGeneric(::readPointer<T>(Pointer.data()));
   }
@@ -533,6 +617,22 @@ public:
                                         unsigned Size,
                                         Endianess E = OriginalEndianess) const;
 
+  /// \brief Read the entries \p Indices of a table of \p Size bytes values
+  ///
+  /// The entry with index I is read at Base + I * Stride. If the table
+  /// is entirely contained in a readable segment, the segment is looked up only
+  /// once.
+  ///
+  /// \param Indices the indices of the entries to read, in ascending order.
+  ///
+  /// \return the value of each entry, in the same order as \p Indices.
+  std::vector<llvm::Optional<uint64_t>>
+  readRawValues(MetaAddress Base,
+                uint64_t Stride,
+                unsigned Size,
+                llvm::ArrayRef<uint64_t> Indices,
+                Endianess E = OriginalEndianess) const;
+
   MetaAddress relocate(MetaAddress Address) const {
     if (BaseAddress) {
       return Address + *BaseAddress;
@@ -596,6 +696,8 @@ private:
   /// \param EHFrameSize the size of the .eh_frame section
   ///
   /// \note Either \p FDEsCount or \p EHFrameSize have to be specified
+  /// \note Landing pads are appended as they are met and sorted only once all
+  ///       the FDEs have been parsed
   template<typename T>
   void parseEHFrame(MetaAddress EHFrameAddress,
                     llvm::Optional<uint64_t> FDEsCount,
@@ -647,26 +749,37 @@ private:
   void rebuildLabelsMap();
 
   SegmentInfo *findSegment(MetaAddress Address) {
-    for (SegmentInfo &Segment : Segments)
-      if (Segment.contains(Address))
-        return &Segment;
-    return nullptr;
+    const auto *This = this;
+    return const_cast<SegmentInfo *>(This->findSegment(Address));
   }
 
-  const SegmentInfo *findSegment(MetaAddress Address) const {
-    for (const SegmentInfo &Segment : Segments)
-      if (Segment.contains(Address))
-        return &Segment;
-    return nullptr;
-  }
+  /// \brief Find the segment containing \p Address
+  ///
+  /// Lookups are performed through an index of the segments sorted by start
+  /// address, which is (re)built lazily after the segments change. The last
+  /// hit is also cached, in order to speed up sequential reads.
+  const SegmentInfo *findSegment(MetaAddress Address) const;
+
+  void updateSegmentsIndex() const;
+
+  void invalidateSegmentsIndex() { SegmentsIndexValid = false; }
 
 private:
   llvm::object::OwningBinary<llvm::object::Binary> BinaryHandle;
   Architecture TheArchitecture;
   std::vector<SegmentInfo> Segments;
+
+  /// Indexes of the elements of Segments, sorted by start address. Empty if
+  /// the segments are overlapping.
+  mutable std::vector<size_t> SortedSegments;
+  /// Whether SortedSegments reflects the current content of Segments
+  mutable bool SegmentsIndexValid = false;
+  /// Index of the segment returned by the last successful lookup
+  mutable size_t LastSegmentHit = 0;
+
   std::vector<std::string> NeededLibraryNames;
-  /// The set of the landing pad addresses collected from .eh_frame
-  std::set<MetaAddress> LandingPads;
+  /// The landing pad addresses collected from .eh_frame, sorted and unique
+  std::vector<MetaAddress> LandingPads;
   /// These are taken from dynamic symbols/relocations
   std::set<MetaAddress> CodePointers;
   std::map<llvm::StringRef, uint64_t> CanonicalValues;
@@ -938,7 +938,7 @@ template<class T>
 class CRTPOffsetFolder {
 
 protected:
-  using offset_iterator = std::set<int64_t>::const_iterator;
+  using offset_iterator = CSVOffsets::const_iterator;
   using offset_iterator_range = llvm::iterator_range<offset_iterator>;
   using OffsetPair = std::pair<const CSVOffsets *, const CSVOffsets *>;
 
@@ -1128,9 +1128,12 @@ public:
           CartesianSize *= OffsetSize;
         }
 
+        // Fold all the combinations first, and then merge them in OffsetMap
+        // at once
+        CSVOffsets::OffsetSet Folded;
+        Folded.reserve(CartesianSize);
         do {
-          CSVOffsets ResOffset = foldOffsets(ResKind, NumSrcs, I, OffsetsIt);
-          insertOrCombine(V, C, std::move(ResOffset), OffsetMap);
+          Folded.push_back(foldOffsets(NumSrcs, I, OffsetsIt));
           // Advance the iterators
           {
             WorkItem::size_type SI = 0;
@@ -1150,16 +1153,17 @@ public:
             revng_log(CSVAccessLog, "incremented");
           }
         } while (--CartesianSize);
+        CSVOffsets ResOffsets(ResKind, std::move(Folded));
+        insertOrCombine(V, C, std::move(ResOffsets), OffsetMap);
       }
     }
   }
 
 private:
-  CSVOffsets foldOffsets(CSVOffsets::Kind ResKind,
-                         WorkItem::size_type NumSrcs,
-                         Instruction *I,
-                         const SmallVector<offset_iterator, 4> &OffsetsIt) {
-    return static_cast<T *>(this)->foldOffsets(ResKind, NumSrcs, I, OffsetsIt);
+  int64_t foldOffsets(WorkItem::size_type NumSrcs,
+                      Instruction *I,
+                      const SmallVector<offset_iterator, 4> &OffsetsIt) {
+    return static_cast<T *>(this)->foldOffsets(NumSrcs, I, OffsetsIt);
   }
 };
 
@@ -1211,10 +1215,9 @@ private:
     revng_abort();
   }
 
-  CSVOffsets foldOffsets(CSVOffsets::Kind ResultKind,
-                         WorkItem::size_type NumSrcs,
-                         Instruction *I,
-                         const SmallVector<offset_iterator, 4> &OffsetsIt) {
+  int64_t foldOffsets(WorkItem::size_type NumSrcs,
+                      Instruction *I,
+                      const SmallVector<offset_iterator, 4> &OffsetsIt) {
     auto OpCode = I->getOpcode();
     revng_assert(OpCode == Instruction::Add or OpCode == Instruction::Sub);
     SmallVector<Constant *, 4> Operands(NumSrcs, nullptr);
@@ -1227,8 +1230,7 @@ private:
     ArrayRef<Constant *> TmpOp(Operands);
     Constant *Res = ConstantFoldInstOperands(I, TmpOp, DL);
     ConstantInt *R = cast<ConstantInt>(Res);
-    const int64_t ResO = R->getSExtValue();
-    return CSVOffsets(ResultKind, ResO);
+    return R->getSExtValue();
   }
 };
 
@@ -1362,10 +1364,9 @@ private:
     return { true, GEPOp0Kind };
   }
 
-  CSVOffsets foldOffsets(CSVOffsets::Kind ResultKind,
-                         WorkItem::size_type NumSrcs,
-                         Instruction *I,
-                         const SmallVector<offset_iterator, 4> &OffsetsIt) {
+  int64_t foldOffsets(WorkItem::size_type NumSrcs,
+                      Instruction *I,
+                      const SmallVector<offset_iterator, 4> &OffsetsIt) {
     const auto *GEP = cast<const GetElementPtrInst>(I);
     const auto PtrOpTy = GEP->getPointerOperand()->getType();
     SmallVector<Constant *, 4> Operands(NumSrcs, nullptr);
@@ -1380,8 +1381,7 @@ private:
     ArrayRef<Constant *> TmpOp(Operands);
     Constant *Res = ConstantFoldInstOperands(I, TmpOp, DL);
     ConstantInt *R = getConstValue(Res, DL);
-    const int64_t ResO = getSExtValue(R, DL);
-    return CSVOffsets(ResultKind, ResO);
+    return getSExtValue(R, DL);
   }
 };
 
@@ -1417,10 +1417,9 @@ private:
     }
   }
 
-  CSVOffsets foldOffsets(CSVOffsets::Kind ResultKind,
-                         WorkItem::size_type NumSrcs,
-                         Instruction *I,
-                         const SmallVector<offset_iterator, 4> &OffsetsIt) {
+  int64_t foldOffsets(WorkItem::size_type NumSrcs,
+                      Instruction *I,
+                      const SmallVector<offset_iterator, 4> &OffsetsIt) {
 
     auto OpCode = I->getOpcode();
     revng_assert(OpCode == Instruction::Shl or OpCode == Instruction::AShr
@@ -1438,8 +1437,7 @@ private:
     ArrayRef<Constant *> TmpOp(Operands);
     Constant *Res = ConstantFoldInstOperands(I, TmpOp, DL);
     ConstantInt *R = cast<ConstantInt>(Res);
-    const int64_t ResO = R->getSExtValue();
-    return CSVOffsets(ResultKind, ResO);
+    return R->getSExtValue();
   }
 };
 
@@ -2468,7 +2466,14 @@ private:
   template<bool IsLoad>
   void fixAccess(const Pair &IOff);
 
+  /// \brief Get the block aborting on unexpected in-env offsets in \p F
+  ///
+  /// The block is created once per function and shared by all the accesses
+  /// fixed in it, instead of emitting an identical one for each of them.
+  BasicBlock *getDefaultInAccess(Function *F);
+
 private:
+  std::map<Function *, BasicBlock *> DefaultInAccessBlocks;
   const DataLayout &DL;
   int64_t EnvStructSize;
   IRBuilder<> Builder;
@@ -2948,14 +2953,8 @@ void CPUStateAccessFixer::fixAccess(const Pair &IOff) {
       }
     }
 
-    // Create the default BB for the switch, calling revng_abort()
-    BasicBlock *Default = BasicBlock::Create(Context, "DefaultInAccess", F);
-    Builder.SetInsertPoint(Default);
-    CallInst *CallAbort = Builder.CreateCall(M.getFunction("abort"));
-    auto UnexpectedInMDKind = Context.getMDKindID("revng.csaa.unexpected.in."
-                                                  "access");
-    CallAbort->setMetadata(UnexpectedInMDKind, QMD.tuple((uint32_t) 0));
-    Builder.CreateUnreachable();
+    // Get the default BB for the switch, calling revng_abort()
+    BasicBlock *Default = getDefaultInAccess(F);
 
     // Create the offset value to use as a variable for the switch if
     // necessary
@@ -3031,6 +3030,23 @@ void CPUStateAccessFixer::fixAccess(const Pair &IOff) {
   InstructionsToRemove.push_back(Instr);
 }
 
+BasicBlock *CPUStateAccessFixer::getDefaultInAccess(Function *F) {
+  BasicBlock *&Default = DefaultInAccessBlocks[F];
+  if (Default != nullptr)
+    return Default;
+
+  LLVMContext &Context = M.getContext();
+  QuickMetadata QMD(Context);
+  Default = BasicBlock::Create(Context, "DefaultInAccess", F);
+  IRBuilder<> DefaultBuilder(Default);
+  CallInst *CallAbort = DefaultBuilder.CreateCall(M.getFunction("abort"));
+  auto UnexpectedInMDKind = Context.getMDKindID("revng.csaa.unexpected.in."
+                                                "access");
+  CallAbort->setMetadata(UnexpectedInMDKind, QMD.tuple((uint32_t) 0));
+  DefaultBuilder.CreateUnreachable();
+  return Default;
+}
+
 bool CPUStateAccessFixer::run() {
   if (CPUStatePtr == nullptr)
     return false;
@@ -21,6 +21,16 @@ class Instruction;
 class VariableManager;
 
 /// \brief LLVM pass to analyze the access patterns to the CPU State Variable
+///
+/// \note The results are not cached across runs on a per-helper basis on
+///       purpose. The offsets the analysis computes are not a property of the
+///       helpers alone: they are obtained propagating the constant arguments
+///       of each call site in `root` through the helpers, and they end up as
+///       metadata on those call sites (and, in non-lazy mode, drive the
+///       rewriting of the accesses to the CPU state). A per-helper summary
+///       keyed on the helpers module would not capture this. Within a single
+///       run, the lazy mode already memoizes the results: call sites carrying
+///       the load/store metadata are skipped by the following invocations.
 class CPUStateAccessAnalysisPass : public llvm::ModulePass {
 public:
   using AccessOffsetMap = std::map<llvm::Instruction *, CSVOffsets>;
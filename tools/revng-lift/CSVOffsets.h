@@ -4,8 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <iterator>
 #include <set>
 
+#include "llvm/ADT/SmallVector.h"
+
 template<bool StaticallyEnabled>
 class Logger;
 
@@ -13,8 +17,12 @@ class Logger;
 ///        set of possible offsets.
 class CSVOffsets {
 
-private:
-  using OffsetSet = std::set<int64_t>;
+public:
+  /// \brief Sorted vector of unique offsets
+  ///
+  /// Offsets are looked up and merged much more often than they are inserted
+  /// one by one, a flat sorted vector avoids allocating a node per offset.
+  using OffsetSet = llvm::SmallVector<int64_t, 4>;
 
 public:
   using iterator = OffsetSet::iterator;
@@ -64,10 +72,17 @@ public:
     // Useful for debug revng_assert(not isUnknown(K) and not
     // isUnknownInPtr(K));
   }
-  CSVOffsets(Kind K, std::set<int64_t> O) : OffsetKind(K), Offsets(O) {
+  CSVOffsets(Kind K, const std::set<int64_t> &O) :
+    OffsetKind(K), Offsets(O.begin(), O.end()) {
     // Useful for debug revng_assert(not isUnknown(K) and not
     // isUnknownInPtr(K));
   }
+  /// \brief Build from an unordered collection of offsets, possibly with
+  ///        duplicates
+  CSVOffsets(Kind K, OffsetSet &&O) : OffsetKind(K), Offsets(std::move(O)) {
+    std::sort(Offsets.begin(), Offsets.end());
+    Offsets.erase(std::unique(Offsets.begin(), Offsets.end()), Offsets.end());
+  }
 
 public:
   friend void writeToLog(Logger<true> &L, const CSVOffsets &O, int /*Ignore*/);
@@ -79,8 +94,8 @@ public:
   iterator begin() { return Offsets.begin(); }
   iterator end() { return Offsets.end(); }
 
-  const_iterator begin() const { return Offsets.cbegin(); }
-  const_iterator end() const { return Offsets.cend(); }
+  const_iterator begin() const { return Offsets.begin(); }
+  const_iterator end() const { return Offsets.end(); }
 
   size_type size() const { return Offsets.size(); }
   size_type empty() const { return Offsets.empty(); }
@@ -137,13 +152,39 @@ public:
     return K;
   }
 
-  void insert(int64_t O) { Offsets.insert(O); }
+  void insert(int64_t O) {
+    auto It = std::lower_bound(Offsets.begin(), Offsets.end(), O);
+    if (It == Offsets.end() or *It != O)
+      Offsets.insert(It, O);
+  }
+
+private:
+  void mergeOffsets(const OffsetSet &Other) {
+    if (Other.empty())
+      return;
+
+    if (Offsets.empty()) {
+      Offsets = Other;
+      return;
+    }
+
+    OffsetSet Result;
+    Result.reserve(Offsets.size() + Other.size());
+    std::set_union(Offsets.begin(),
+                   Offsets.end(),
+                   Other.begin(),
+                   Other.end(),
+                   std::back_inserter(Result));
+    Offsets = std::move(Result);
+  }
+
+public:
   void combine(const CSVOffsets &other) {
     Kind K0 = OffsetKind;
     Kind K1 = other.OffsetKind;
     // For equal kinds just merge the offsets
     if (K0 == K1) {
-      Offsets.insert(other.Offsets.begin(), other.Offsets.end());
+      mergeOffsets(other.Offsets);
       return;
     }
 
@@ -175,7 +216,7 @@ public:
         Offsets = {};
       } else {
         OffsetKind = Kind::OutAndKnownInPtr;
-        Offsets.insert(other.Offsets.begin(), other.Offsets.end());
+        mergeOffsets(other.Offsets);
       }
       return;
     }
@@ -17,7 +17,9 @@
 #include <vector>
 
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/DiagnosticPrinter.h"
@@ -29,6 +31,11 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
@@ -37,13 +44,18 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Dump/CollectCFG.h"
 #include "revng/FunctionCallIdentification/FunctionCallIdentification.h"
 #include "revng/FunctionCallIdentification/PruneRetSuccessors.h"
+#include "revng/Model/LoadModelPass.h"
 #include "revng/Model/SerializeModelPass.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/DebugHelper.h"
 #include "revng/Support/ProgramCounterHandler.h"
+#include "revng/Support/Progress.h"
+#include "revng/Support/Statistics.h"
 #include "revng/Support/revng.h"
 
 #include "CodeGenerator.h"
@@ -51,7 +63,9 @@
 #include "ExternalJumpsHandler.h"
 #include "InstructionTranslator.h"
 #include "JumpTargetManager.h"
+#include "OriginalInstructionsTable.h"
 #include "PTCInterface.h"
+#include "TranslationPipeline.h"
 #include "VariableManager.h"
 
 using namespace llvm;
@@ -96,6 +110,15 @@ static cl::alias A3("b",
                     cl::aliasopt(BBSummaryPath),
                     cl::cat(MainCategory));
 
+#define DESCRIPTION                                                          \
+  cl::desc("destination path for the CSV containing the disassembly of the " \
+           "original instructions, which won't be stored in the IR")
+static cl::opt<string> OriginalInstructionsPath("original-instructions",
+                                                DESCRIPTION,
+                                                cl::value_desc("path"),
+                                                cl::cat(MainCategory));
+#undef DESCRIPTION
+
 // Enable Debug Options to be specified on the command line
 namespace DIT = DebugInfoType;
 static auto X = cl::values(clEnumValN(DIT::None,
@@ -119,7 +142,7 @@ static cl::opt<DIT::Values> DebugInfo("debug-info",
                                       cl::desc("emit debug information"),
                                       X,
                                       cl::cat(MainCategory),
-                                      cl::init(DIT::LLVMIR));
+                                      cl::init(DIT::None));
 
 static cl::alias A6("g",
                     cl::desc("Alias for -debug-info"),
@@ -133,11 +156,82 @@ static cl::opt<string> DebugPath("debug-path",
                                  cl::value_desc("path"),
                                  cl::cat(MainCategory));
 
-static Logger<> PTCLog("ptc");
+static cl::opt<bool> EmitLL("emit-ll",
+                            cl::desc("write the output as textual LLVM IR "
+                                     "instead of bitcode (slow, for "
+                                     "debugging purposes)"),
+                            cl::cat(MainCategory));
+
+static cl::opt<string> HelpersCachePath("helpers-cache",
+                                        cl::desc("directory where to cache "
+                                                 "the preprocessed helpers "
+                                                 "module, to speed up the "
+                                                 "following runs"),
+                                        cl::value_desc("path"),
+                                        cl::cat(MainCategory));
+
+static cl::opt<string> PreviousLiftPath("previous-lift",
+                                        cl::desc("path of the module produced "
+                                                 "by lifting a previous "
+                                                 "version of the input: jump "
+                                                 "targets in unchanged code "
+                                                 "will be reused"),
+                                        cl::value_desc("path"),
+                                        cl::cat(MainCategory));
+
+static cl::opt<string> SeedModelPath("seed-model",
+                                     cl::desc("path of a module carrying the "
+                                              "model of a previous analysis "
+                                              "of the input: its functions "
+                                              "and basic blocks will be "
+                                              "translated right away"),
+                                     cl::value_desc("path"),
+                                     cl::cat(MainCategory));
 
-template<typename T, typename... Args>
-inline std::array<T, sizeof...(Args)> make_array(Args &&... args) {
-  return { { std::forward<Args>(args)... } };
+static cl::opt<string> SeedCFGPath("seed-cfg",
+                                   cl::desc("path of a CFG of the input "
+                                            "collected with "
+                                            "-collect-cfg-format=binary: its "
+                                            "basic blocks will be translated "
+                                            "right away"),
+                                   cl::value_desc("path"),
+                                   cl::cat(MainCategory));
+
+static cl::opt<string> PTCDumpPath("ptc-dump",
+                                   cl::desc("write the PTC of each translated "
+                                            "block to this file, in a compact "
+                                            "binary format to be decoded with "
+                                            "revng-decode-ptc-dump"),
+                                   cl::value_desc("path"),
+                                   cl::cat(MainCategory));
+
+static cl::opt<bool> SyscallPassthrough("syscall-passthrough",
+                                        cl::desc("let the runtime issue the "
+                                                 "syscalls listed in "
+                                                 "REVNG_SYSCALL_PASSTHROUGH "
+                                                 "directly to the host"),
+                                        cl::cat(MainCategory));
+
+static cl::opt<bool> MemoryReport("memory-report",
+                                  cl::desc("print the resident set size each "
+                                           "time a data structure that is no "
+                                           "longer needed is released"),
+                                  cl::cat(MainCategory));
+
+static VerboseLogger PTCLog("ptc");
+static Logger<> PreviousLiftLog("previous-lift");
+static Logger<> SeedLog("seed");
+
+/// \brief Report, if requested, that \p What has just been released
+static void reportRelease(const char *What) {
+  if (not MemoryReport)
+    return;
+
+  PhaseTimers::Phase Sample;
+  PhaseTimers::sampleMemory(&Sample);
+  const uint64_t MiB = 1024 * 1024;
+  dbg << "Released " << What << ": RSS " << Sample.RSS / MiB << " MiB, peak "
+      << Sample.PeakRSS / MiB << " MiB\n";
 }
 
 /// Wrap a value around a temporary opaque function
@@ -194,6 +288,48 @@ public:
   }
 };
 
+/// \brief Path of the cached copy of the preprocessed \p Helpers module
+///
+/// The name of the file depends on the original module (path, size and
+/// modification time) and on all the other inputs of prepareHelpersModule.
+/// Bump HelpersCacheVersion whenever prepareHelpersModule changes.
+static std::string helpersCacheFile(StringRef Helpers) {
+  using namespace llvm::sys;
+  const unsigned HelpersCacheVersion = 4;
+
+  if (HelpersCachePath.empty())
+    return "";
+
+  fs::file_status Status;
+  if (fs::status(Helpers, Status))
+    return "";
+
+  // hash_combine is not stable across executions, use MD5
+  MD5 Hash;
+  auto Update = [&Hash](uint64_t Value) {
+    support::ulittle64_t LittleEndian(Value);
+    Hash.update({ reinterpret_cast<const uint8_t *>(&LittleEndian),
+                  sizeof(LittleEndian) });
+  };
+
+  auto ModificationTime = Status.getLastModificationTime().time_since_epoch();
+  Update(HelpersCacheVersion);
+  Hash.update(Helpers);
+  Update(Helpers.size());
+  Update(Status.getSize());
+  Update(ModificationTime.count());
+  Update(ptc.exception_index);
+
+  MD5::MD5Result Digest;
+  Hash.final(Digest);
+
+  SmallString<128> Result(HelpersCachePath);
+  std::string Name = (path::stem(Helpers) + "-" + Digest.digest() + ".bc")
+                       .str();
+  path::append(Result, Name);
+  return Result.str().str();
+}
+
 // Outline the destructor for the sake of privacy in the header
 CodeGenerator::~CodeGenerator() = default;
 
@@ -226,21 +362,20 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
   OriginalInstrMDKind = Context.getMDKindID("oi");
   PTCInstrMDKind = Context.getMDKindID("pi");
 
-  HelpersModule = parseIR(Helpers, Context);
+  revng_check(OriginalInstructionsPath.empty()
+                or DebugInfo != DebugInfoType::OriginalAssembly,
+              "-g asm requires the original instructions in the IR");
+
+  HelpersCacheFile = helpersCacheFile(Helpers);
+  if (not HelpersCacheFile.empty() and sys::fs::exists(HelpersCacheFile)) {
+    HelpersModule = parseIR(HelpersCacheFile, Context);
+    HelpersPrepared = true;
+  } else {
+    HelpersModule = parseIR(Helpers, Context);
+  }
 
   TheModule->setDataLayout(HelpersModule->getDataLayout());
 
-  for (auto &F : HelpersModule->functions()) {
-    // Remove 'optnone' Function attribute from QEMU helpers.
-    // QEMU helpers are compiled with -O0 in libtinycode because the LLVM IR
-    // generated in this way it much more readable, but we need to optimize
-    // them when we link them with the decompiled code.
-    // In particular we desperately need SROA to get rid of allocas, to
-    // enable the CPUStateAccessAnalysisPass.
-    // If we don't remove this attribute future optimizations are blocked.
-    F.removeFnAttr(Attribute::OptimizeNone);
-    F.setDSOLocal(false);
-  }
   EarlyLinkedModule = parseIR(EarlyLinked, Context);
 
   if (CoveragePath.size() == 0)
@@ -302,7 +437,7 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
 
       bool Found = false;
       MetaAddress End = Segment.pagesRange().second;
-      for (SegmentInfo &Segment : Binary.segments()) {
+      for (const SegmentInfo &Segment : Binary.segments()) {
         if (Segment.IsExecutable and Segment.containsInPages(End)) {
           Found = true;
           break;
@@ -370,7 +505,7 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
     NeededLibsStream << Library << "\n";
 }
 
-std::string SegmentInfo::generateName() {
+std::string SegmentInfo::generateName() const {
   // Create name from start and size
   std::stringstream NameStream;
   NameStream << "o_" << (IsReadable ? "r" : "") << (IsWriteable ? "w" : "")
@@ -580,6 +715,75 @@ static ReturnInst *createRet(Instruction *Position) {
   return nullptr;
 }
 
+/// \brief Named metadata listing the functions that can reach cpu_loop_exit
+static const char *CpuLoopExitingMDName = "revng.cpu-loop-exiting";
+
+/// \brief Collect the functions calling, directly or not, \p CpuLoopExit
+///
+/// This is a single visit of the reverse call graph, looking through casts.
+static std::vector<Function *> cpuLoopExitingFunctions(Function *CpuLoopExit) {
+  std::vector<Function *> Result;
+  std::set<Function *> Visited;
+  std::queue<Value *> WorkList;
+  WorkList.push(CpuLoopExit);
+
+  while (not WorkList.empty()) {
+    Value *F = WorkList.front();
+    WorkList.pop();
+
+    for (User *U : F->users()) {
+      auto *Call = dyn_cast<CallInst>(U);
+      if (Call == nullptr) {
+        auto *Cast = dyn_cast<ConstantExpr>(U);
+        revng_assert(Cast != nullptr, "Unexpected user");
+        revng_assert(Cast->getOperand(0) == F && Cast->isCast());
+        WorkList.push(Cast);
+        continue;
+      }
+
+      Function *Caller = Call->getParent()->getParent();
+      if (Visited.insert(Caller).second) {
+        Result.push_back(Caller);
+        WorkList.push(Caller);
+      }
+    }
+  }
+
+  return Result;
+}
+
+/// \brief Record in \p M the result of cpuLoopExitingFunctions
+static void recordCpuLoopExitingFunctions(Module &M) {
+  Function *CpuLoopExit = M.getFunction("cpu_loop_exit");
+  if (CpuLoopExit == nullptr)
+    return;
+
+  QuickMetadata QMD(M.getContext());
+  std::vector<Metadata *> Functions;
+  for (Function *F : cpuLoopExitingFunctions(CpuLoopExit))
+    Functions.push_back(QMD.get(F));
+
+  NamedMDNode *MD = M.getOrInsertNamedMetadata(CpuLoopExitingMDName);
+  MD->addOperand(QMD.tuple(Functions));
+}
+
+/// \brief Return and drop the list recorded by recordCpuLoopExitingFunctions,
+///        or compute it if it's not available
+static std::vector<Function *> takeCpuLoopExitingFunctions(Module &M) {
+  NamedMDNode *MD = M.getNamedMetadata(CpuLoopExitingMDName);
+  if (MD == nullptr or MD->getNumOperands() != 1)
+    return cpuLoopExitingFunctions(M.getFunction("cpu_loop_exit"));
+
+  QuickMetadata QMD(M.getContext());
+  std::vector<Function *> Result;
+  for (const MDOperand &Operand : cast<MDTuple>(MD->getOperand(0))->operands())
+    if (Operand.get() != nullptr)
+      Result.push_back(cast<Function>(QMD.extract<Constant *>(Operand.get())));
+
+  MD->eraseFromParent();
+  return Result;
+}
+
 /// Find all calls to cpu_loop_exit and replace them with:
 ///
 /// * call cpu_loop
@@ -591,6 +795,10 @@ static ReturnInst *createRet(Instruction *Position) {
 /// or not.
 /// Then when we reach the root function, set cpu_loop_exiting to false after
 /// the call.
+///
+/// The functions reaching cpu_loop_exit are computed once, when preparing the
+/// helpers module, and cached along with it. All the call sites to rewrite are
+/// collected before any change, then rewritten in a single batch.
 bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
   LLVMContext &Context = M.getContext();
   Function *CpuLoopExit = M.getFunction("cpu_loop_exit");
@@ -605,7 +813,6 @@ bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
 
   Function *CpuLoop = M.getFunction("cpu_loop");
   IntegerType *BoolType = Type::getInt1Ty(Context);
-  std::set<Function *> FixedCallers;
   Constant *CpuLoopExitingVariable = nullptr;
   CpuLoopExitingVariable = new GlobalVariable(M,
                                               BoolType,
@@ -616,13 +823,44 @@ bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
 
   revng_assert(CpuLoop != nullptr);
 
-  std::queue<User *> CpuLoopExitUsers;
+  // Collect all the calls to rewrite before introducing new ones (to cpu_loop)
+  std::vector<CallInst *> ExitCalls;
   for (User *TheUser : CpuLoopExit->users())
-    CpuLoopExitUsers.push(TheUser);
+    ExitCalls.push_back(cast<CallInst>(TheUser));
+
+  // With -syscall-passthrough, the callers of do_syscall call the runtime's
+  // revng_do_syscall, which in turn calls do_syscall: it can reach
+  // cpu_loop_exit as much as do_syscall does
+  std::vector<Function *> ExitingFunctions = takeCpuLoopExitingFunctions(M);
+  Function *DoSyscall = M.getFunction("do_syscall");
+  Function *Passthrough = M.getFunction("revng_do_syscall");
+  if (Passthrough != nullptr and is_contained(ExitingFunctions, DoSyscall)
+      and not is_contained(ExitingFunctions, Passthrough))
+    ExitingFunctions.push_back(Passthrough);
+
+  std::vector<CallInst *> ExitingCalls;
+  for (Function *F : ExitingFunctions) {
+    std::queue<Value *> WorkList;
+    WorkList.push(F);
+
+    while (!WorkList.empty()) {
+      Value *V = WorkList.front();
+      WorkList.pop();
+
+      for (User *RecUser : V->users()) {
+        if (auto *RecCall = dyn_cast<CallInst>(RecUser)) {
+          ExitingCalls.push_back(RecCall);
+        } else {
+          auto *Cast = dyn_cast<ConstantExpr>(RecUser);
+          revng_assert(Cast != nullptr, "Unexpected user");
+          revng_assert(Cast->getOperand(0) == V && Cast->isCast());
+          WorkList.push(Cast);
+        }
+      }
+    }
+  }
 
-  while (!CpuLoopExitUsers.empty()) {
-    auto *Call = cast<CallInst>(CpuLoopExitUsers.front());
-    CpuLoopExitUsers.pop();
+  for (CallInst *Call : ExitCalls) {
     revng_assert(Call->getCalledFunction() == CpuLoopExit);
 
     // Call cpu_loop
@@ -644,103 +882,332 @@ bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
     auto *Unreach = cast<UnreachableInst>(&*++Call->getIterator());
     Unreach->eraseFromParent();
 
-    Function *Caller = Call->getParent()->getParent();
-
     // Remove the call to cpu_loop_exit
     Call->eraseFromParent();
+  }
 
-    if (FixedCallers.find(Caller) == FixedCallers.end()) {
-      FixedCallers.insert(Caller);
-
-      std::queue<Value *> WorkList;
-      WorkList.push(Caller);
-
-      while (!WorkList.empty()) {
-        Value *F = WorkList.front();
-        WorkList.pop();
-
-        for (User *RecUser : F->users()) {
-          auto *RecCall = dyn_cast<CallInst>(RecUser);
-          if (RecCall == nullptr) {
-            auto *Cast = dyn_cast<ConstantExpr>(RecUser);
-            revng_assert(Cast != nullptr, "Unexpected user");
-            revng_assert(Cast->getOperand(0) == F && Cast->isCast());
-            WorkList.push(Cast);
-            continue;
-          }
-
-          Function *RecCaller = RecCall->getParent()->getParent();
-
-          // TODO: make this more reliable than using function name
-          // If the caller is a QEMU helper function make it check
-          // cpu_loop_exiting and if it's true, make it return
-
-          // Split BB
-          BasicBlock *OldBB = RecCall->getParent();
-          BasicBlock::iterator SplitPoint = ++RecCall->getIterator();
-          revng_assert(SplitPoint != OldBB->end());
-          BasicBlock *NewBB = OldBB->splitBasicBlock(SplitPoint);
-
-          // Add a BB with a ret
-          BasicBlock *QuitBB = BasicBlock::Create(Context,
-                                                  "cpu_loop_exit_return",
-                                                  RecCaller,
-                                                  NewBB);
-          UnreachableInst *Temp = new UnreachableInst(Context, QuitBB);
-          createRet(Temp);
-          Temp->eraseFromParent();
-
-          // Check value of cpu_loop_exiting
-          auto *Branch = cast<BranchInst>(&*++(RecCall->getIterator()));
-          auto *Compare = new ICmpInst(Branch,
-                                       CmpInst::ICMP_EQ,
-                                       new LoadInst(CpuLoopExitingVariable,
-                                                    "",
-                                                    Branch),
-                                       ConstantInt::getTrue(BoolType));
-
-          BranchInst::Create(QuitBB, NewBB, Compare, Branch);
-          Branch->eraseFromParent();
-
-          // Add to the work list only if it hasn't been fixed already
-          if (FixedCallers.find(RecCaller) == FixedCallers.end()) {
-            FixedCallers.insert(RecCaller);
-            WorkList.push(RecCaller);
-          }
-        }
-      }
-    }
+  for (CallInst *RecCall : ExitingCalls) {
+    Function *RecCaller = RecCall->getParent()->getParent();
+
+    // TODO: make this more reliable than using function name
+    // If the caller is a QEMU helper function make it check
+    // cpu_loop_exiting and if it's true, make it return
+
+    // Split BB
+    BasicBlock *OldBB = RecCall->getParent();
+    BasicBlock::iterator SplitPoint = ++RecCall->getIterator();
+    revng_assert(SplitPoint != OldBB->end());
+    BasicBlock *NewBB = OldBB->splitBasicBlock(SplitPoint);
+
+    // Add a BB with a ret
+    BasicBlock *QuitBB = BasicBlock::Create(Context,
+                                            "cpu_loop_exit_return",
+                                            RecCaller,
+                                            NewBB);
+    UnreachableInst *Temp = new UnreachableInst(Context, QuitBB);
+    createRet(Temp);
+    Temp->eraseFromParent();
+
+    // Check value of cpu_loop_exiting
+    auto *Branch = cast<BranchInst>(&*++(RecCall->getIterator()));
+    auto *Compare = new ICmpInst(Branch,
+                                 CmpInst::ICMP_EQ,
+                                 new LoadInst(CpuLoopExitingVariable,
+                                              "",
+                                              Branch),
+                                 ConstantInt::getTrue(BoolType));
+
+    BranchInst::Create(QuitBB, NewBB, Compare, Branch);
+    Branch->eraseFromParent();
   }
 
   return true;
 }
 
 /// Removes all the basic blocks without predecessors from F
-// TODO: this is not efficient, but it shouldn't be critical
+///
+/// The function is scanned once, then only the successors of the removed
+/// blocks are considered, since they are the only ones that can lose their
+/// last predecessor.
 static void purgeDeadBlocks(Function *F) {
+  BasicBlock *Entry = &F->getEntryBlock();
+
   std::vector<BasicBlock *> Kill;
-  do {
-    for (BasicBlock *Dead : Kill)
-      DeleteDeadBlock(Dead);
-    Kill.clear();
+  for (BasicBlock &BB : make_range(++F->begin(), F->end()))
+    if (pred_empty(&BB))
+      Kill.push_back(&BB);
+
+  while (not Kill.empty()) {
+    BasicBlock *Dead = Kill.back();
+    Kill.pop_back();
+
+    SmallSetVector<BasicBlock *, 2> Successors;
+    for (BasicBlock *Successor : successors(Dead))
+      if (Successor != Entry)
+        Successors.insert(Successor);
 
-    // Skip the first basic block
-    for (BasicBlock &BB : make_range(++F->begin(), F->end()))
-      if (pred_empty(&BB))
-        Kill.push_back(&BB);
+    DeleteDeadBlock(Dead);
 
-  } while (!Kill.empty());
+    for (BasicBlock *Successor : Successors)
+      if (pred_empty(Successor))
+        Kill.push_back(Successor);
+  }
 }
 
-void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
-  using FT = FunctionType;
+/// \brief The outcome of running libtinycode on a single jump target
+///
+/// Decoding only depends on the input code, while the emission of LLVM IR
+/// mutates the root function and has to happen strictly in order. Keeping the
+/// two phases separate makes it possible to reason about (and reuse) the
+/// decoding results independently from the IR we emit.
+///
+/// \note libtinycode keeps its state in process-wide globals, therefore
+///       decoding cannot run concurrently.
+struct DecodedJumpTarget {
+  PTCInstructionListPtr InstructionList;
+  size_t ConsumedSize = 0;
+
+  /// If valid, the address of the first unmapped page the translation ran
+  /// into
+  MetaAddress AbortAt = MetaAddress::invalid();
+};
 
-  MetaAddress::createStructVariable(TheModule.get());
+/// \brief Register the jump targets of a previous lift in unchanged code
+///
+/// The executable segments of the input are compared, chunk by chunk, with the
+/// corresponding segments of \p PreviousModule. A jump target of the previous
+/// lift is registered again, with the same reasons, if its instructions lie in
+/// unchanged chunks and so do the sources of all the edges reaching it from
+/// translated code. Jump targets reached only through the dispatcher are left
+/// to harvesting, since we can't tell where they come from. This way, most of
+/// the code is discovered without going through the expensive harvesting
+/// rounds.
+static void reuseJumpTargets(Module &PreviousModule,
+                             const BinaryFile &Binary,
+                             JumpTargetManager &JumpTargets) {
+  // Use a fixed size, so that what we reuse doesn't depend on the host
+  constexpr uint64_t ChunkSize = 4096;
+
+  // Collect the (indices of the) chunks whose content is identical in the two
+  // versions. A chunk shared among multiple segments is unchanged only if none
+  // of its parts changed.
+  std::set<uint64_t> UnchangedChunks;
+  std::set<uint64_t> ChangedChunks;
+  for (const SegmentInfo &Segment : Binary.segments()) {
+    if (not Segment.IsExecutable)
+      continue;
+
+    StringRef Old;
+    auto *Previous = PreviousModule.getGlobalVariable(Segment.generateName());
+    if (Previous != nullptr and Previous->hasInitializer())
+      if (auto *Data = dyn_cast<ConstantDataArray>(Previous->getInitializer()))
+        Old = Data->getRawDataValues();
+
+    StringRef New(reinterpret_cast<const char *>(Segment.Data.data()),
+                  Segment.Data.size());
+
+    uint64_t Offset = 0;
+    while (Offset < New.size()) {
+      // Proceed up to the end of the current chunk
+      uint64_t Address = (Segment.StartVirtualAddress + Offset).address();
+      uint64_t ChunkLeft = ChunkSize - Address % ChunkSize;
+      uint64_t Size = std::min<uint64_t>(ChunkLeft, New.size() - Offset);
+
+      bool Unchanged = (Offset + Size <= Old.size()
+                        and Old.substr(Offset, Size) == New.substr(Offset, Size));
+      if (Unchanged)
+        UnchangedChunks.insert(Address / ChunkSize);
+      else
+        ChangedChunks.insert(Address / ChunkSize);
+
+      Offset += Size;
+    }
+  }
 
-  // Declare the abort function
-  auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
-  FunctionCallee AbortFunction = TheModule->getOrInsertFunction("abort",
-                                                                AbortTy);
+  for (uint64_t Chunk : ChangedChunks)
+    UnchangedChunks.erase(Chunk);
+
+  auto IsUnchanged = [&UnchangedChunks](MetaAddress Start, uint64_t Size) {
+    if (Start.isInvalid())
+      return false;
+
+    uint64_t Last = Start.address() + std::max<uint64_t>(Size, 1) - 1;
+    for (uint64_t Chunk = Start.address() / ChunkSize;
+         Chunk <= Last / ChunkSize;
+         ++Chunk)
+      if (UnchangedChunks.count(Chunk) == 0)
+        return false;
+    return true;
+  };
+
+  Function *PreviousRoot = PreviousModule.getFunction("root");
+  if (PreviousRoot == nullptr)
+    return;
+
+  using GCBI = GeneratedCodeBasicInfo;
+  unsigned Reused = 0;
+  for (BasicBlock &BB : *PreviousRoot) {
+    Instruction *Terminator = BB.getTerminator();
+    if (Terminator == nullptr)
+      continue;
+
+    auto *Reasons = Terminator->getMetadata(JTReasonMDName);
+    MetaAddress PC = getBasicBlockPC(&BB);
+    if (Reasons == nullptr or PC.isInvalid())
+      continue;
+
+    // All the instructions of the block, not just the first one, have to be
+    // unchanged
+    bool Unchanged = true;
+    for (Instruction &I : BB) {
+      if (CallInst *Call = getCallTo(&I, "newpc")) {
+        auto Address = MetaAddress::fromConstant(Call->getArgOperand(0));
+        uint64_t Size = getLimitedValue(Call->getArgOperand(1));
+        if (not IsUnchanged(Address, Size)) {
+          Unchanged = false;
+          break;
+        }
+      }
+    }
+
+    if (not Unchanged)
+      continue;
+
+    // The reasons have been collected along the edges reaching the jump
+    // target: they still hold only if all those edges start in unchanged code
+    bool HasEdges = false;
+    for (BasicBlock *Predecessor : predecessors(&BB)) {
+      BlockType::Values Type = GCBI::getType(Predecessor);
+      if (Type != BlockType::TranslatedBlock
+          and Type != BlockType::JumpTargetBlock)
+        continue;
+
+      HasEdges = true;
+      auto Source = getPC(Predecessor->getTerminator());
+      if (not IsUnchanged(Source.first, Source.second)) {
+        Unchanged = false;
+        break;
+      }
+    }
+
+    if (not HasEdges or not Unchanged)
+      continue;
+
+    for (const MDOperand &Operand : cast<MDTuple>(Reasons)->operands()) {
+      StringRef ReasonName = cast<MDString>(Operand.get())->getString();
+      JumpTargets.registerJT(PC, JTReason::fromName(ReasonName));
+    }
+
+    Reused++;
+  }
+
+  revng_log(PreviousLiftLog,
+            Reused << " jump targets reused from "
+                   << PreviousLiftPath.getValue());
+}
+
+/// \brief Register as jump targets the functions and the basic blocks of
+///        a previous analysis of the input
+///
+/// Unlike reuseJumpTargets, the addresses are not checked against the content
+/// of the input: the model and the CFG are assumed to describe this very
+/// program, e.g., when lifting it again with a different version of rev.ng or
+/// with different options. Harvesting will then (mostly) confirm them.
+static void seedJumpTargets(LLVMContext &Context,
+                            JumpTargetManager &JumpTargets) {
+  unsigned Seeded = 0;
+  auto Seed = [&JumpTargets, &Seeded](MetaAddress PC) {
+    if (PC.isInvalid())
+      return;
+
+    bool New = not JumpTargets.hasJT(PC);
+    if (JumpTargets.registerJT(PC, JTReason::Seeded) != nullptr and New)
+      Seeded++;
+  };
+
+  if (not SeedModelPath.empty()) {
+    // Load the module lazily: we're only interested in the model
+    SMDiagnostic Error;
+    std::unique_ptr<Module> M = getLazyIRFileModule(SeedModelPath,
+                                                    Error,
+                                                    Context);
+    revng_check(M, "Cannot load the module of -seed-model");
+    revng_check(M->getNamedMetadata(ModelMetadataName) != nullptr,
+                "The module of -seed-model has no model");
+
+    LoadModelPass::forEachFunction(*M, [&Seed](const model::Function &F) {
+      Seed(F.Entry);
+      for (const model::BasicBlock &Block : F.CFG)
+        Seed(Block.Start);
+    });
+  }
+
+  if (not SeedCFGPath.empty()) {
+    auto Buffer = MemoryBuffer::getFile(SeedCFGPath);
+    revng_check(Buffer, "Cannot read the CFG of -seed-cfg");
+
+    auto OnEdge = [&Seed](MetaAddress Source, MetaAddress Destination) {
+      Seed(Source);
+      Seed(Destination);
+    };
+    revng_check(CollectCFG::readBinary((*Buffer)->getBuffer(), OnEdge),
+                "The CFG of -seed-cfg is not in the binary format");
+  }
+
+  revng_log(SeedLog, Seeded << " jump targets seeded");
+}
+
+static DecodedJumpTarget
+decode(MetaAddress VirtualAddress,
+       const std::set<MetaAddress> &NoMoreCodeBoundaries) {
+  DecodedJumpTarget Result;
+
+  // TODO: rename this type
+  Result.InstructionList.reset(new PTCInstructionList);
+
+  PTCCodeType Type = PTC_CODE_REGULAR;
+
+  switch (VirtualAddress.type()) {
+  case MetaAddressType::Invalid:
+    revng_abort();
+
+  case MetaAddressType::Code_arm_thumb:
+    Type = PTC_CODE_ARM_THUMB;
+    break;
+
+  default:
+    Type = PTC_CODE_REGULAR;
+    break;
+  }
+
+  Result.ConsumedSize = ptc.translate(VirtualAddress.address(),
+                                      Type,
+                                      Result.InstructionList.get());
+
+  // Check whether we ended up in an unmapped page
+  MetaAddress LastByte = VirtualAddress.toGeneric()
+                         + (Result.ConsumedSize - 1);
+  if (VirtualAddress.pageStart() != LastByte.pageStart()) {
+    MetaAddress NextPage = VirtualAddress.nextPageStart();
+    if (NoMoreCodeBoundaries.count(NextPage) != 0)
+      Result.AbortAt = NextPage;
+  }
+
+  return Result;
+}
+
+void CodeGenerator::prepareHelpersModule() {
+  for (auto &F : HelpersModule->functions()) {
+    // Remove 'optnone' Function attribute from QEMU helpers.
+    // QEMU helpers are compiled with -O0 in libtinycode because the LLVM IR
+    // generated in this way it much more readable, but we need to optimize
+    // them when we link them with the decompiled code.
+    // In particular we desperately need SROA to get rid of allocas, to
+    // enable the CPUStateAccessAnalysisPass.
+    // If we don't remove this attribute future optimizations are blocked.
+    F.removeFnAttr(Attribute::OptimizeNone);
+    F.setDSOLocal(false);
+  }
 
   // Prepare the helper modules by transforming the cpu_loop function and
   // running SROA
@@ -753,14 +1220,6 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   // Drop the main
   HelpersModule->getFunction("main")->eraseFromParent();
 
-  // From syscall.c
-  new GlobalVariable(*TheModule,
-                     Type::getInt32Ty(Context),
-                     false,
-                     GlobalValue::CommonLinkage,
-                     ConstantInt::get(Type::getInt32Ty(Context), 0),
-                     StringRef("do_strace"));
-
   //
   // Handle some specific QEMU functions as no-ops or abort
   //
@@ -814,6 +1273,64 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   replaceFunctionWithRet(HelpersModule->getFunction("page_get_flags"),
                          0xffffffff);
 
+  recordCpuLoopExitingFunctions(*HelpersModule);
+
+  HelpersPrepared = true;
+}
+
+void CodeGenerator::saveHelpersCache() {
+  using namespace llvm::sys;
+
+  // Write to a temporary file and then rename it, so that concurrent
+  // instances never see a partially written cache
+  StringRef Directory = path::parent_path(HelpersCacheFile);
+  if (fs::create_directories(Directory))
+    return;
+
+  int FD = -1;
+  SmallString<128> TemporaryPath;
+  std::string Model = HelpersCacheFile + "-%%%%%%";
+  if (fs::createUniqueFile(Model, FD, TemporaryPath))
+    return;
+
+  {
+    raw_fd_ostream Output(FD, true);
+    WriteBitcodeToFile(*HelpersModule, Output);
+  }
+
+  if (fs::rename(TemporaryPath, HelpersCacheFile))
+    fs::remove(TemporaryPath);
+}
+
+void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
+  using FT = FunctionType;
+  ScopedTimer Timer("translate");
+
+  std::unique_ptr<BinaryPTCDumper> PTCDumper;
+  if (not PTCDumpPath.empty())
+    PTCDumper = std::make_unique<BinaryPTCDumper>(PTCDumpPath);
+
+  MetaAddress::createStructVariable(TheModule.get());
+
+  // Declare the abort function
+  auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
+  FunctionCallee AbortFunction = TheModule->getOrInsertFunction("abort",
+                                                                AbortTy);
+
+  if (not HelpersPrepared) {
+    prepareHelpersModule();
+    if (not HelpersCacheFile.empty())
+      saveHelpersCache();
+  }
+
+  // From syscall.c
+  new GlobalVariable(*TheModule,
+                     Type::getInt32Ty(Context),
+                     false,
+                     GlobalValue::CommonLinkage,
+                     ConstantInt::get(Type::getInt32Ty(Context), 0),
+                     StringRef("do_strace"));
+
   //
   // Record globals for marking them as internal after linking
   //
@@ -822,10 +1339,13 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     if (GV.hasName())
       HelperGlobals.push_back(GV.getName().str());
 
+  // The runtime's revng_do_syscall calls do_syscall, keep it external even
+  // without -syscall-passthrough, otherwise linking support.ll would leave it
+  // unresolved
   std::vector<std::string> HelperFunctions;
   for (Function &F : HelpersModule->functions())
     if (F.hasName() and F.getName() != "target_set_brk"
-        and F.getName() != "syscall_init")
+        and F.getName() != "syscall_init" and F.getName() != "do_syscall")
       HelperFunctions.push_back(F.getName().str());
 
   //
@@ -834,6 +1354,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   Linker TheLinker(*TheModule);
   bool Result = TheLinker.linkInModule(std::move(HelpersModule));
   revng_assert(not Result, "Linking failed");
+  reportRelease("the helpers module");
 
   //
   // Mark as internal all the imported globals
@@ -849,6 +1370,17 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
       if (not F->isDeclaration() and not F->isIntrinsic())
         F->setLinkage(GlobalValue::InternalLinkage);
 
+  // Let the runtime intercept the syscalls, it will call do_syscall for the
+  // ones it doesn't forward to the host
+  if (SyscallPassthrough) {
+    Function *DoSyscall = TheModule->getFunction("do_syscall");
+    revng_check(DoSyscall != nullptr, "do_syscall not found");
+    FunctionType *SyscallType = DoSyscall->getFunctionType();
+    auto Passthrough = TheModule->getOrInsertFunction("revng_do_syscall",
+                                                      SyscallType);
+    DoSyscall->replaceAllUsesWith(Passthrough.getCallee());
+  }
+
   //
   // Create the VariableManager
   //
@@ -951,7 +1483,9 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   //   DelaySlotSize,
   //   PCRegisterName,
   //   SPRegisterName,
-  //   ABIRegisters
+  //   ABIRegisters,
+  //   SyscallHelperName,
+  //   SyscallNumberRegisterName
   // }
 
   const SmallVector<ABIRegister, 20> &ABIRegisters = Arch.abiRegisters();
@@ -967,6 +1501,8 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
                                QMD.get("pc"),
                                QMD.get(Arch.stackPointerRegister()),
                                QMD.tuple(ArrayRef<Metadata *>(ABIRegMetadata)),
+                               QMD.get(Arch.syscallHelper()),
+                               QMD.get(Arch.syscallNumberRegister()),
                              });
   MDName = "revng.input.architecture";
   NamedMDNode *InputArchMD = TheModule->getOrInsertNamedMetadata(MDName);
@@ -994,6 +1530,21 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     PCH->initializePC(Builder, VirtualAddress);
   }
 
+  if (not PreviousLiftPath.empty()) {
+    // The previous lift is only a hint: if it can't be loaded, lift everything
+    SMDiagnostic Errors;
+    auto PreviousModule = parseIRFile(PreviousLiftPath, Errors, Context);
+    if (PreviousModule) {
+      reuseJumpTargets(*PreviousModule, Binary, JumpTargets);
+    } else {
+      dbg << "Warning: cannot load the previous lift, performing a full lift\n";
+      Errors.print("revng", dbgs());
+    }
+  }
+
+  if (not SeedModelPath.empty() or not SeedCFGPath.empty())
+    seedJumpTargets(Context, JumpTargets);
+
   OpaqueIdentity OI(TheModule.get());
 
   // Fake jumps to the dispatcher-related basic blocks. This way all the blocks
@@ -1005,58 +1556,39 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
   JumpTargets.setCFGForm(CFGForm::SemanticPreserving);
 
+  Progress->setPhase("lift");
   std::tie(VirtualAddress, Entry) = JumpTargets.peek();
 
   std::vector<BasicBlock *> Blocks;
 
+  std::unique_ptr<OriginalInstructionsTable> OriginalInstructions;
+  if (not OriginalInstructionsPath.empty())
+    OriginalInstructions = std::make_unique<OriginalInstructionsTable>();
+
   InstructionTranslator Translator(Builder,
                                    Variables,
                                    JumpTargets,
                                    Blocks,
                                    Binary.architecture(),
                                    TargetArchitecture,
-                                   PCH.get());
+                                   PCH.get(),
+                                   OriginalInstructions.get());
 
   while (Entry != nullptr) {
+    ScopedTimer IterationTimer("translate-jump-target");
+    Progress->advance("translated-blocks");
+    Progress->tick();
     Builder.SetInsertPoint(Entry);
 
     // TODO: what if create a new instance of an InstructionTranslator here?
     Translator.reset();
 
-    // TODO: rename this type
-    PTCInstructionListPtr InstructionList(new PTCInstructionList);
-    size_t ConsumedSize = 0;
+    DecodedJumpTarget Decoded = decode(VirtualAddress, NoMoreCodeBoundaries);
+    PTCInstructionListPtr &InstructionList = Decoded.InstructionList;
+    size_t ConsumedSize = Decoded.ConsumedSize;
+    MetaAddress AbortAt = Decoded.AbortAt;
 
-    PTCCodeType Type = PTC_CODE_REGULAR;
-
-    switch (VirtualAddress.type()) {
-    case MetaAddressType::Invalid:
-      revng_abort();
-
-    case MetaAddressType::Code_arm_thumb:
-      Type = PTC_CODE_ARM_THUMB;
-      break;
-
-    default:
-      Type = PTC_CODE_REGULAR;
-      break;
-    }
-
-    ConsumedSize = ptc.translate(VirtualAddress.address(),
-                                 Type,
-                                 InstructionList.get());
-
-    // Check whether we ended up in an unmapped page
-    MetaAddress AbortAt = MetaAddress::invalid();
-    MetaAddress LastByte = VirtualAddress.toGeneric() + (ConsumedSize - 1);
-    if (VirtualAddress.pageStart() != LastByte.pageStart()) {
-      MetaAddress NextPage = VirtualAddress.nextPageStart();
-      if (NoMoreCodeBoundaries.count(NextPage) != 0)
-        AbortAt = NextPage;
-    }
-
-    SmallSet<unsigned, 1> ToIgnore;
-    ToIgnore = Translator.preprocess(InstructionList.get());
+    auto Boundaries = Translator.preprocess(InstructionList.get());
 
     if (PTCLog.isEnabled()) {
       std::stringstream Stream;
@@ -1064,6 +1596,14 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
       PTCLog << Stream.str() << DoLog;
     }
 
+    if (PTCDumper) {
+      auto *Instructions = InstructionList.get();
+      if (PTCDumper->dumpTranslation(VirtualAddress, Instructions)
+          != EXIT_SUCCESS)
+        dbg << "Warning: the PTC dump of " << VirtualAddress.toString()
+            << " is incomplete\n";
+    }
+
     Variables.newFunction(Delimiter, InstructionList.get());
     unsigned j = 0;
     MDNode *MDOriginalInstr = nullptr;
@@ -1077,17 +1617,17 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     using IT = InstructionTranslator;
     IT::TranslationResult Result;
 
+    // Find the next PTC_INSTRUCTION_op_debug_insn_start, if there is one
+    auto GetNextInstruction = [&](unsigned Index) -> PTCInstruction * {
+      unsigned NextIndex = Boundaries.nextStart(Index);
+      if (NextIndex == InstructionCount)
+        return nullptr;
+      return &InstructionList->instructions[NextIndex];
+    };
+
     // Handle the first PTC_INSTRUCTION_op_debug_insn_start
     {
-      PTCInstruction *NextInstruction = nullptr;
-      for (unsigned k = 1; k < InstructionCount; k++) {
-        PTCInstruction *I = &InstructionList->instructions[k];
-        if (I->opc == PTC_INSTRUCTION_op_debug_insn_start
-            && ToIgnore.count(k) == 0) {
-          NextInstruction = I;
-          break;
-        }
-      }
+      PTCInstruction *NextInstruction = GetNextInstruction(j);
       PTCInstruction *Instruction = &InstructionList->instructions[j];
       std::tie(Result,
                MDOriginalInstr,
@@ -1103,7 +1643,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
     // TODO: shall we move this whole loop in InstructionTranslator?
     for (; j < InstructionCount && !StopTranslation; j++) {
-      if (ToIgnore.count(j) != 0)
+      if (Boundaries.isIgnored(j))
         continue;
 
       PTCInstruction Instruction = InstructionList->instructions[j];
@@ -1117,16 +1657,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
         // Instructions we don't even consider
         break;
       case PTC_INSTRUCTION_op_debug_insn_start: {
-        // Find next instruction, if there is one
-        PTCInstruction *NextInstruction = nullptr;
-        for (unsigned k = j + 1; k < InstructionCount; k++) {
-          PTCInstruction *I = &InstructionList->instructions[k];
-          if (I->opc == PTC_INSTRUCTION_op_debug_insn_start
-              && ToIgnore.count(k) == 0) {
-            NextInstruction = I;
-            break;
-          }
-        }
+        PTCInstruction *NextInstruction = GetNextInstruction(j);
 
         std::tie(Result,
                  MDOriginalInstr,
@@ -1206,6 +1737,11 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     std::tie(VirtualAddress, Entry) = JumpTargets.peek();
   } // End translations loop
 
+  Progress->setPhase("lift-finalize");
+
+  PTCDumper.reset();
+  reportRelease("the PTC instruction lists");
+
   OI.drop();
 
   // Reorder basic blocks in RPOT
@@ -1283,15 +1819,31 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
   Translator.finalizeNewPCMarkers(CoveragePath);
 
-  // SROA must run before InstCombine because in this way InstCombine has many
-  // more elementary operations to combine
-  legacy::PassManager PreInstCombinePM;
+  if (OriginalInstructions) {
+    std::ofstream Output(OriginalInstructionsPath);
+    OriginalInstructions->serialize(Output);
+    OriginalInstructions.reset();
+    reportRelease("the original instructions table");
+  }
+
+  // Run SROA on all the other functions (i.e., the helpers)
+  legacy::FunctionPassManager PreInstCombinePM(&*TheModule);
   PreInstCombinePM.add(createSROAPass());
-  PreInstCombinePM.run(*TheModule);
+  PreInstCombinePM.doInitialization();
+  for (Function &F : *TheModule)
+    if (not F.isDeclaration() and &F != MainFunction)
+      PreInstCombinePM.run(F);
+  PreInstCombinePM.doFinalization();
 
+  // SROA must run before InstCombine because in this way InstCombine has many
+  // more elementary operations to combine.
   // InstCombine must run before CPUStateAccessAnalysis (CSAA) because, if it
   // runs after it, it removes all the useful metadata attached by CSAA.
+  // Schedule them in the same pass manager, so that the analyses SROA
+  // preserves (e.g., the dominator tree) are not recomputed on root, which is
+  // by far the largest function.
   legacy::FunctionPassManager InstCombinePM(&*TheModule);
+  InstCombinePM.add(createSROAPass());
   InstCombinePM.add(createInstructionCombiningPass());
   InstCombinePM.doInitialization();
   InstCombinePM.run(*MainFunction);
@@ -1309,10 +1861,13 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   SerializeModelPass::writeModel(Model, *TheModule);
 
   JumpTargets.finalizeJumpTargets();
+  reportRelease("the AVI whitelist");
 
   purgeDeadBlocks(MainFunction);
 
   JumpTargets.createJTReasonMD();
+  JumpTargets.releaseJumpTargets();
+  reportRelease("the jump targets");
 
   // Link early-linked.c
   // TODO: moving this too earlier seems to break things
@@ -1321,6 +1876,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     bool Result = TheLinker.linkInModule(std::move(EarlyLinkedModule),
                                          Linker::None);
     revng_assert(!Result, "Linking failed");
+    reportRelease("the early-linked module");
   }
 
   ExternalJumpsHandler JumpOutHandler(Binary,
@@ -1331,10 +1887,28 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
   Variables.finalize();
 
+  // Save the following opt invocations from scanning the whole root function
+  {
+    GeneratedCodeBasicInfo GCBI;
+    GCBI.run(*TheModule);
+    GCBI.persist(*TheModule);
+  }
+
   Debug->generateDebugInfo();
 }
 
 void CodeGenerator::serialize() {
+  // Debug information referring to the LLVM IR requires the output to be that
+  // very IR, unless it has been written somewhere else (see -debug-path)
+  bool IsDebugSource = (DebugInfo == DIT::LLVMIR
+                        and (DebugPath.empty() or DebugPath == OutputPath));
+
+  if (not EmitLL and not IsDebugSource) {
+    revng_check(writeBitcode(*TheModule, OutputPath),
+                "Cannot write the output");
+    return;
+  }
+
   // Ask the debug handler if it already has a good copy of the IR, if not dump
   // it
   if (!Debug->copySource()) {
@@ -58,11 +58,24 @@ public:
   /// create in this phase.
   ///
   /// \param VirtualAddress the address from where the translation should start.
+  ///
+  /// \note All the translated code ends up in a single function, `root`, with
+  ///       a single dispatcher. This is a requirement of the lifting process:
+  ///       JumpTargetManager keeps discovering new jump targets, splitting
+  ///       already translated basic blocks and patching the dispatcher until
+  ///       a fixed point is reached, which wouldn't be possible if the code
+  ///       was spread over multiple functions. Partitioning the program in
+  ///       bounded-size functions is the job of the function isolation pass
+  ///       (`revng opt ... -isolate`), which works on the detected function
+  ///       boundaries once lifting is over.
   void translate(llvm::Optional<uint64_t> RawVirtualAddress);
 
   /// Serialize the generated LLVM IR to the specified output path.
   void serialize();
 
+  /// \brief The module containing the generated LLVM IR
+  llvm::Module &module() { return *TheModule; }
+
 private:
   /// \brief Parse the ELF headers.
   ///
@@ -77,12 +90,20 @@ private:
   template<typename T>
   void parseELF(llvm::object::ObjectFile *TheBinary, bool UseSections);
 
+  /// \brief Adapt the QEMU helpers module for linking it in the output
+  void prepareHelpersModule();
+
+  /// \brief Store the prepared helpers module for the following runs
+  void saveHelpersCache();
+
 private:
   Architecture TargetArchitecture;
   llvm::LLVMContext &Context;
   std::unique_ptr<llvm::Module> TheModule;
   std::unique_ptr<llvm::Module> HelpersModule;
   std::unique_ptr<llvm::Module> EarlyLinkedModule;
+  std::string HelpersCacheFile;
+  bool HelpersPrepared = false;
   std::string OutputPath;
   std::unique_ptr<DebugHelper> Debug;
   BinaryFile &Binary;
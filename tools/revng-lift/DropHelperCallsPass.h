@@ -6,20 +6,28 @@
 
 #include <map>
 
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 
+#include "revng/Support/OpaqueFunctionsPool.h"
+
 using CSVToAllocaMap = std::map<llvm::GlobalVariable *, llvm::AllocaInst *>;
 
 /// \brief Helper class to generate calls that summarize pieces of codes
 ///        accessing CSVs
+///
+/// The opaque functions returning random values are obtained from an
+/// OpaqueFunctionsRegistry, so that they are reused across runs.
 class SummaryCallsBuilder {
 private:
   const CSVToAllocaMap &CSVMap;
-  std::map<llvm::Type *, llvm::Function *> TemporaryFunctions;
+  OpaqueFunctionsRegistry &Registry;
 
 public:
-  SummaryCallsBuilder(const CSVToAllocaMap &CSVMap) : CSVMap(CSVMap) {}
+  SummaryCallsBuilder(const CSVToAllocaMap &CSVMap,
+                      OpaqueFunctionsRegistry &Registry) :
+    CSVMap(CSVMap), Registry(Registry) {}
 
 public:
   llvm::CallInst *
@@ -28,9 +36,20 @@ public:
             llvm::ArrayRef<llvm::Value *> BaseArguments,
             llvm::ArrayRef<llvm::GlobalVariable *> ReadCSVs,
             llvm::ArrayRef<llvm::GlobalVariable *> WrittenCSVs) {
-    using namespace llvm;
+    llvm::CallInst *Result = buildCall(Builder,
+                                       ReturnType,
+                                       BaseArguments,
+                                       ReadCSVs);
+    clobber(Builder, WrittenCSVs);
+    return Result;
+  }
 
-    Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  /// \brief Emit a call reading \p ReadCSVs, without clobbering any CSV
+  llvm::CallInst *buildCall(llvm::IRBuilder<> &Builder,
+                            llvm::Type *ReturnType,
+                            llvm::ArrayRef<llvm::Value *> BaseArguments,
+                            llvm::ArrayRef<llvm::GlobalVariable *> ReadCSVs) {
+    using namespace llvm;
 
     std::vector<Value *> Arguments;
     std::copy(BaseArguments.begin(),
@@ -40,23 +59,19 @@ public:
     for (GlobalVariable *CSV : ReadCSVs)
       Arguments.push_back(Builder.CreateLoad(csvToAlloca(CSV)));
 
-    CallInst *Result = Builder.CreateCall(getRandom(M, ReturnType), Arguments);
+    return Builder.CreateCall(getRandom(ReturnType), Arguments);
+  }
+
+  /// \brief Put a `store getRandom()` targeting each CSV in \p WrittenCSVs
+  void clobber(llvm::IRBuilder<> &Builder,
+               llvm::ArrayRef<llvm::GlobalVariable *> WrittenCSVs) {
+    using namespace llvm;
 
-    // Put a `store getRandom()` targeting each written CSV
     for (GlobalVariable *Written : WrittenCSVs) {
       Type *PointeeTy = Written->getType()->getPointerElementType();
-      Value *Random = Builder.CreateCall(getRandom(M, PointeeTy));
+      Value *Random = Builder.CreateCall(getRandom(PointeeTy));
       Builder.CreateStore(Random, csvToAlloca(Written));
     }
-
-    return Result;
-  }
-
-  void cleanup() {
-    for (auto &P : TemporaryFunctions)
-      P.second->eraseFromParent();
-
-    TemporaryFunctions.clear();
   }
 
 private:
@@ -68,21 +83,10 @@ private:
       return CSV;
   }
 
-  llvm::Function *getRandom(llvm::Module *M, llvm::Type *ReturnType) {
+  llvm::Function *getRandom(llvm::Type *ReturnType) {
     using namespace llvm;
-
-    QuickMetadata QMD(M->getContext());
-
-    auto It = TemporaryFunctions.find(ReturnType);
-    if (It != TemporaryFunctions.end())
-      return It->second;
-
     auto *Type = FunctionType::get(ReturnType, true);
-    auto *F = Function::Create(Type, GlobalValue::ExternalLinkage, "", M);
-    F->setOnlyAccessesInaccessibleMemory();
-    TemporaryFunctions[ReturnType] = F;
-
-    return F;
+    return Registry.get("", Type, { Attribute::InaccessibleMemOnly });
   }
 };
 
@@ -99,6 +103,11 @@ private:
 /// After the replacement call, each CSV written by the helper (according to
 /// CSAA) is clobbered with the result of a call to an opaque function.
 ///
+/// Consecutive helper calls, i.e., separated only by instructions not accessing
+/// memory, are summarized as a batch: the CSVs written by any of them are
+/// clobbered once, after the last one, and a call doesn't read the CSVs written
+/// by the previous ones, since their value is unknown anyway.
+///
 /// This pass also marks the syscall ID argument of syscall helper functions
 /// with `revng.syscallid`.
 class DropHelperCallsPass : public llvm::PassInfoMixin<DropHelperCallsPass> {
@@ -130,11 +139,25 @@ DropHelperCallsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &) {
 
   // TODO: iterating over users of helper functions would probably be faster
   for (BasicBlock &BB : F) {
+    // The CSVs written by the current batch of consecutive helper calls
+    SetVector<GlobalVariable *> Clobbered;
+    auto EndBatch = [&Builder, &Clobbered, this](Instruction *InsertionPoint) {
+      if (Clobbered.empty())
+        return;
+      Builder.SetInsertPoint(InsertionPoint);
+      SCB.clobber(Builder, Clobbered.getArrayRef());
+      Clobbered.clear();
+    };
+
     for (Instruction &I : BB) {
 
       if (auto *Call = getCallToHelper(&I)) {
         auto *Callee = cast<Function>(skipCasts(Call->getCalledValue()));
 
+        // The syscall helper always reads the syscall ID CSV, see below
+        if (Callee == SyscallHelper)
+          EndBatch(Call);
+
         Builder.SetInsertPoint(Call);
 
         // Collect CSAA data
@@ -145,31 +168,40 @@ DropHelperCallsPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &) {
         //
         // * A reference to the called function
         // * The original arguments
-        // * All the registers read
+        // * All the registers read, except for those clobbered in the batch
         std::vector<Value *> BaseArguments = { Callee };
         auto CallArguments = make_range(Call->arg_begin(), Call->arg_end());
         for (Value *Argument : CallArguments)
           BaseArguments.push_back(Argument);
 
         Optional<uint32_t> SyscallIDArgumentIndex;
-        for (GlobalVariable *CSV : CSVs.Read)
+        std::vector<GlobalVariable *> Read;
+        for (GlobalVariable *CSV : CSVs.Read) {
           if (Callee == SyscallHelper and CSV == SyscallIDCSV)
             SyscallIDArgumentIndex = BaseArguments.size();
+          if (Clobbered.count(CSV) == 0)
+            Read.push_back(CSV);
+        }
 
         CallInst *NewCall = SCB.buildCall(Builder,
                                           I.getType(),
                                           BaseArguments,
-                                          CSVs.Read,
-                                          CSVs.Written);
+                                          Read);
 
         if (SyscallIDArgumentIndex) {
           NewCall->setMetadata("revng.syscallid",
                                QMD.tuple(*SyscallIDArgumentIndex));
         }
 
+        for (GlobalVariable *CSV : CSVs.Written)
+          Clobbered.insert(CSV);
+
         // Drop the old function call
         I.replaceAllUsesWith(NewCall);
         ToDelete.push_back(Call);
+
+      } else if (I.mayReadOrWriteMemory() or I.isTerminator()) {
+        EndBatch(&I);
       }
     }
   }
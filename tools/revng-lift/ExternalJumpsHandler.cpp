@@ -6,7 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/BasicBlock.h"
@@ -189,13 +191,26 @@ llvm::BasicBlock *ExternalJumpsHandler::createSetjmp(BasicBlock *FirstReturn,
 void ExternalJumpsHandler::buildExecutableSegmentsList() {
   IRBuilder<> Builder(Context);
   IntegerType *Int64 = Builder.getInt64Ty();
-  SmallVector<Constant *, 10> ExecutableSegments;
   auto Int = [Int64](uint64_t V) { return ConstantInt::get(Int64, V); };
-  for (auto &Segment : TheBinary.segments()) {
-    if (Segment.IsExecutable) {
-      ExecutableSegments.push_back(Int(Segment.StartVirtualAddress.address()));
-      ExecutableSegments.push_back(Int(Segment.EndVirtualAddress.address()));
-    }
+
+  // Collect the executable ranges, sorted and merged, so that is_executable
+  // can look them up with a binary search
+  std::vector<std::pair<uint64_t, uint64_t>> Ranges;
+  for (const SegmentInfo &Segment : TheBinary.segments())
+    if (Segment.IsExecutable)
+      Ranges.emplace_back(Segment.StartVirtualAddress.address(),
+                          Segment.EndVirtualAddress.address());
+  std::sort(Ranges.begin(), Ranges.end());
+
+  SmallVector<Constant *, 10> ExecutableSegments;
+  for (size_t I = 0; I < Ranges.size();) {
+    uint64_t Start = Ranges[I].first;
+    uint64_t End = Ranges[I].second;
+    for (++I; I < Ranges.size() and Ranges[I].first <= End; ++I)
+      End = std::max(End, Ranges[I].second);
+
+    ExecutableSegments.push_back(Int(Start));
+    ExecutableSegments.push_back(Int(End));
   }
 
   auto *SegmentsType = ArrayType::get(Int64, ExecutableSegments.size());
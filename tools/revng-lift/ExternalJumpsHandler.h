@@ -31,6 +31,12 @@ class ProgramCounterHandler;
 /// If this is the case, we perform a longjmp to get back into the proper
 /// context, we restore the relevant registers from the data structures provided
 /// by the signal handler and then jump to the dispatcher to resume execution.
+///
+/// \note All the ABI registers are serialized and deserialized on each jump
+///       out, since this code is emitted while lifting, that is, before the ABI
+///       analysis has been run and without knowing the call sites of external
+///       functions. Also, the cost of this path is dominated by the delivery of
+///       the signal on the comeback, not by the register copies.
 class ExternalJumpsHandler {
 private:
   llvm::LLVMContext &Context;
@@ -18,13 +18,16 @@
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/RandomAccessIterator.h"
 #include "revng/Support/Range.h"
 
 #include "InstructionTranslator.h"
+#include "OriginalInstructionsTable.h"
 
 #include "PTCInterface.h"
 #include "VariableManager.h"
@@ -33,6 +36,21 @@ using namespace llvm;
 
 using IT = InstructionTranslator;
 
+static cl::opt<bool> NativeFP("native-fp",
+                              cl::desc("lower the basic floating point "
+                                       "helpers to native LLVM instructions, "
+                                       "assuming the default rounding mode "
+                                       "and ignoring the exception flags"),
+                              cl::cat(MainCategory),
+                              cl::init(false));
+
+static cl::opt<bool> NativeSIMD("native-simd",
+                                cl::desc("lower the basic SSE and MMX integer "
+                                         "helpers to LLVM vector "
+                                         "instructions"),
+                                cl::cat(MainCategory),
+                                cl::init(false));
+
 namespace PTC {
 
 template<bool C>
@@ -291,6 +309,110 @@ static Instruction::BinaryOps opcodeToBinaryOp(PTCOpcode Opcode) {
   }
 }
 
+/// \brief Floating point helpers that can be lowered to a native instruction
+struct NativeFPHelper {
+  /// Name of the helper, without the `helper_` prefix and the suffix
+  /// identifying the type (`s` for float, `d` for double)
+  const char *Name;
+
+  Instruction::BinaryOps Opcode;
+
+  /// Index of the first operand, the second one follows
+  unsigned FirstOperand;
+};
+
+static const NativeFPHelper NativeFPHelpers[] = {
+  // ARM and AArch64: vfp_adds(a, b, fpst)
+  { "vfp_add", Instruction::FAdd, 0 },
+  { "vfp_sub", Instruction::FSub, 0 },
+  { "vfp_mul", Instruction::FMul, 0 },
+  { "vfp_div", Instruction::FDiv, 0 },
+  // MIPS: float_add_s(env, a, b)
+  { "float_add_", Instruction::FAdd, 1 },
+  { "float_sub_", Instruction::FSub, 1 },
+  { "float_mul_", Instruction::FMul, 1 },
+  { "float_div_", Instruction::FDiv, 1 },
+};
+
+/// \brief Emit a native instruction in place of a call to a floating point
+///        helper
+///
+/// \return the result, as an integer of type \p ResultType, or nullptr if
+///         \p HelperName is not a known floating point helper.
+static Value *lowerFPHelper(IRBuilder<> &Builder,
+                            StringRef HelperName,
+                            ArrayRef<Value *> Arguments,
+                            Type *ResultType) {
+  if (HelperName.empty())
+    return nullptr;
+
+  Type *FPType = nullptr;
+  char Suffix = HelperName.back();
+  if (Suffix == 's')
+    FPType = Builder.getFloatTy();
+  else if (Suffix == 'd')
+    FPType = Builder.getDoubleTy();
+  else
+    return nullptr;
+
+  StringRef Base = HelperName.drop_back();
+  for (const NativeFPHelper &Helper : NativeFPHelpers) {
+    if (Base != Helper.Name)
+      continue;
+
+    // The operands and the result must be integers as large as the type
+    unsigned Size = FPType->getPrimitiveSizeInBits();
+    if (Arguments.size() < Helper.FirstOperand + 2
+        or not ResultType->isIntegerTy(Size))
+      return nullptr;
+
+    Value *First = Arguments[Helper.FirstOperand];
+    Value *Second = Arguments[Helper.FirstOperand + 1];
+    if (First->getType() != ResultType or Second->getType() != ResultType)
+      return nullptr;
+
+    Value *Result = Builder.CreateBinOp(Helper.Opcode,
+                                        Builder.CreateBitCast(First, FPType),
+                                        Builder.CreateBitCast(Second, FPType));
+    return Builder.CreateBitCast(Result, ResultType);
+  }
+
+  return nullptr;
+}
+
+/// \brief SIMD helpers (`helper_<Name>_xmm` and `helper_<Name>_mmx`) that can
+///        be lowered to a native vector instruction
+///
+/// All of them have the form `helper(env, Destination, Source)` and compute,
+/// lane by lane, `Destination = Destination <Opcode> Source`.
+struct NativeSIMDHelper {
+  const char *Name;
+
+  Instruction::BinaryOps Opcode;
+
+  /// Size of each lane, in bits
+  unsigned LaneSize;
+
+  /// Complement the destination before performing the operation (pandn)
+  bool ComplementDestination;
+};
+
+static const NativeSIMDHelper NativeSIMDHelpers[] = {
+  { "paddb", Instruction::Add, 8, false },
+  { "paddw", Instruction::Add, 16, false },
+  { "paddl", Instruction::Add, 32, false },
+  { "paddq", Instruction::Add, 64, false },
+  { "psubb", Instruction::Sub, 8, false },
+  { "psubw", Instruction::Sub, 16, false },
+  { "psubl", Instruction::Sub, 32, false },
+  { "psubq", Instruction::Sub, 64, false },
+  { "pmullw", Instruction::Mul, 16, false },
+  { "pand", Instruction::And, 64, false },
+  { "pandn", Instruction::And, 64, true },
+  { "por", Instruction::Or, 64, false },
+  { "pxor", Instruction::Xor, 64, false },
+};
+
 /// Returns the maximum value which can be represented with the specified number
 /// of bits.
 static uint64_t getMaxValue(unsigned Bits) {
@@ -461,7 +583,8 @@ IT::InstructionTranslator(IRBuilder<> &Builder,
                           std::vector<BasicBlock *> Blocks,
                           const Architecture &SourceArchitecture,
                           const Architecture &TargetArchitecture,
-                          ProgramCounterHandler *PCH) :
+                          ProgramCounterHandler *PCH,
+                          OriginalInstructionsTable *OriginalInstructions) :
   Builder(Builder),
   Variables(Variables),
   JumpTargets(JumpTargets),
@@ -473,7 +596,8 @@ IT::InstructionTranslator(IRBuilder<> &Builder,
   NewPCMarker(nullptr),
   LastPC(MetaAddress::invalid()),
   MetaAddressStruct(MetaAddress::getStruct(&TheModule)),
-  PCH(PCH) {
+  PCH(PCH),
+  OriginalInstructions(OriginalInstructions) {
 
   auto &Context = TheModule.getContext();
   using FT = FunctionType;
@@ -534,10 +658,12 @@ void IT::finalizeNewPCMarkers(std::string &CoveragePath) {
   Output << std::dec;
 }
 
-SmallSet<unsigned, 1> IT::preprocess(PTCInstructionList *InstructionList) {
-  SmallSet<unsigned, 1> Result;
+IT::InstructionBoundaries
+IT::preprocess(PTCInstructionList *InstructionList) {
+  const unsigned InstructionCount = InstructionList->instruction_count;
+  InstructionBoundaries Result(InstructionCount);
 
-  for (unsigned I = 0; I < InstructionList->instruction_count; I++) {
+  for (unsigned I = 0; I < InstructionCount; I++) {
     PTCInstruction &Instruction = InstructionList->instructions[I];
     switch (Instruction.opc) {
     case PTC_INSTRUCTION_op_movi_i32:
@@ -559,15 +685,26 @@ SmallSet<unsigned, 1> IT::preprocess(PTCInstructionList *InstructionList) {
     if (0 != strcmp("btarget", Temporary->name))
       continue;
 
-    for (unsigned J = I + 1; J < InstructionList->instruction_count; J++) {
+    for (unsigned J = I + 1; J < InstructionCount; J++) {
       unsigned Opcode = InstructionList->instructions[J].opc;
       if (Opcode == PTC_INSTRUCTION_op_debug_insn_start)
-        Result.insert(J);
+        Result.ToIgnore.set(J);
     }
 
     break;
   }
 
+  // Proceed backward recording the last instruction start we met
+  unsigned Next = InstructionCount;
+  Result.NextStart[InstructionCount] = Next;
+  for (unsigned I = InstructionCount; I > 0; I--) {
+    Result.NextStart[I - 1] = Next;
+    unsigned Opcode = InstructionList->instructions[I - 1].opc;
+    if (Opcode == PTC_INSTRUCTION_op_debug_insn_start
+        and not Result.ToIgnore[I - 1])
+      Next = I - 1;
+  }
+
   return Result;
 }
 
@@ -601,16 +738,28 @@ IT::newInstruction(PTCInstruction *Instr,
   disassemble(OriginalStringStream, PC, NextPC - PC);
   std::string OriginalString = OriginalStringStream.str();
 
-  // We don't deduplicate this string since performing a lookup each time is
-  // increasingly expensive and we should have relatively few collisions
-  std::string AddressName = JumpTargets.nameForAddress(PC);
-  Constant *String = buildStringPtr(&TheModule,
-                                    OriginalString,
-                                    Twine("disam_") + AddressName);
-
-  auto *MDOriginalString = ConstantAsMetadata::get(String);
-  auto *MDPC = ConstantAsMetadata::get(PC.toConstant(MetaAddressStruct));
-  MDNode *MDOriginalInstr = MDNode::get(Context, { MDOriginalString, MDPC });
+  Constant *String = nullptr;
+  MDNode *MDOriginalInstr = nullptr;
+  if (OriginalInstructions != nullptr) {
+    // Keep the disassembly out of the module, just reference the table entry
+    uint32_t Index = OriginalInstructions->record(PC,
+                                                  NextPC - PC,
+                                                  std::move(OriginalString));
+    String = ConstantPointerNull::get(Type::getInt8PtrTy(Context));
+    QuickMetadata QMD(Context);
+    MDOriginalInstr = QMD.tuple(Index);
+  } else {
+    // We don't deduplicate this string since performing a lookup each time is
+    // increasingly expensive and we should have relatively few collisions
+    std::string AddressName = JumpTargets.nameForAddress(PC);
+    String = buildStringPtr(&TheModule,
+                            OriginalString,
+                            Twine("disam_") + AddressName);
+
+    auto *MDOriginalString = ConstantAsMetadata::get(String);
+    auto *MDPC = ConstantAsMetadata::get(PC.toConstant(MetaAddressStruct));
+    MDOriginalInstr = MDNode::get(Context, { MDOriginalString, MDPC });
+  }
 
   if (!IsFirst) {
     // Check if this PC already has a block and use it
@@ -657,12 +806,93 @@ IT::newInstruction(PTCInstruction *Instr,
   return R{ Success, MDOriginalInstr, PC, NextPC };
 }
 
+bool IT::lowerSIMDHelper(StringRef HelperName, ArrayRef<Value *> Arguments) {
+  // Each register is made of one (MMX) or two (SSE) 64-bit CSVs
+  unsigned Parts = 0;
+  if (HelperName.consume_back("_xmm"))
+    Parts = 2;
+  else if (HelperName.consume_back("_mmx"))
+    Parts = 1;
+  else
+    return false;
+
+  auto IsHelper = [HelperName](const NativeSIMDHelper &Helper) {
+    return HelperName == Helper.Name;
+  };
+  auto *Helper = llvm::find_if(NativeSIMDHelpers, IsHelper);
+  if (Helper == std::end(NativeSIMDHelpers) or Arguments.size() != 3)
+    return false;
+
+  // The registers are passed as pointers computed as env plus a constant
+  // offset, find the corresponding CSVs
+  using CSVList = SmallVector<GlobalVariable *, 2>;
+  auto GetCSVs = [this, Parts](Value *Pointer, CSVList &Result) {
+    auto *Add = dyn_cast<BinaryOperator>(Pointer);
+    if (Add == nullptr or Add->getOpcode() != Instruction::Add
+        or not Variables.isEnv(Add->getOperand(0)))
+      return false;
+
+    auto *Offset = dyn_cast<ConstantInt>(Add->getOperand(1));
+    if (Offset == nullptr)
+      return false;
+
+    for (unsigned I = 0; I < Parts; ++I) {
+      intptr_t PartOffset = Offset->getSExtValue() + 8 * I;
+      auto [CSV, Remaining] = Variables.getByEnvOffset(PartOffset);
+      if (CSV == nullptr or Remaining != 0
+          or not CSV->getValueType()->isIntegerTy(64))
+        return false;
+      Result.push_back(CSV);
+    }
+
+    return true;
+  };
+
+  CSVList Destination;
+  CSVList Source;
+  if (not GetCSVs(Arguments[1], Destination)
+      or not GetCSVs(Arguments[2], Source))
+    return false;
+
+  // Load the registers as vectors of lanes, the first CSV holds the lowest
+  // lanes
+  Type *PartsType = VectorType::get(Builder.getInt64Ty(), Parts);
+  unsigned Lanes = Parts * 64 / Helper->LaneSize;
+  Type *LanesType = VectorType::get(Builder.getIntNTy(Helper->LaneSize), Lanes);
+  auto Load = [this, PartsType, LanesType](const CSVList &CSVs) {
+    Value *Result = UndefValue::get(PartsType);
+    for (unsigned I = 0; I < CSVs.size(); ++I)
+      Result = Builder.CreateInsertElement(Result,
+                                           Builder.CreateLoad(CSVs[I]),
+                                           I);
+    return Builder.CreateBitCast(Result, LanesType);
+  };
+
+  Value *First = Load(Destination);
+  Value *Second = Load(Source);
+  if (Helper->ComplementDestination)
+    First = Builder.CreateNot(First);
+
+  Value *Result = Builder.CreateBinOp(Helper->Opcode, First, Second);
+  Result = Builder.CreateBitCast(Result, PartsType);
+  for (unsigned I = 0; I < Parts; ++I)
+    Builder.CreateStore(Builder.CreateExtractElement(Result, I),
+                        Destination[I]);
+
+  return true;
+}
+
 IT::TranslationResult IT::translateCall(PTCInstruction *Instr) {
   const PTC::CallInstruction TheCall(Instr);
 
   std::vector<Value *> InArgs;
 
   for (uint64_t TemporaryId : TheCall.InArguments) {
+    if (Value *Known = Variables.getKnownValue(TemporaryId)) {
+      InArgs.push_back(Known);
+      continue;
+    }
+
     auto *Temporary = Variables.getOrCreate(TemporaryId, true);
     if (Temporary == nullptr)
       return Abort;
@@ -693,13 +923,25 @@ IT::TranslationResult IT::translateCall(PTCInstruction *Instr) {
                                        ArrayRef<Type *>(InArgsType),
                                        false);
 
-  std::string HelperName = "helper_" + TheCall.helperName();
-  FunctionCallee FDecl = TheModule.getOrInsertFunction(HelperName, CalleeType);
+  if (NativeSIMD and TheCall.OutArguments.size() == 0
+      and lowerSIMDHelper(TheCall.helperName(), InArgs))
+    return Success;
+
+  Value *Result = nullptr;
+  if (NativeFP)
+    Result = lowerFPHelper(Builder, TheCall.helperName(), InArgs, ResultType);
 
-  CallInst *Result = Builder.CreateCall(FDecl, InArgs);
+  if (Result == nullptr) {
+    std::string HelperName = "helper_" + TheCall.helperName();
+    FunctionCallee FDecl = TheModule.getOrInsertFunction(HelperName,
+                                                         CalleeType);
+    Result = Builder.CreateCall(FDecl, InArgs);
+  }
 
-  if (TheCall.OutArguments.size() != 0)
+  if (TheCall.OutArguments.size() != 0) {
     Builder.CreateStore(Result, ResultDestination);
+    Variables.recordStore(TheCall.OutArguments[0], Result);
+  }
 
   return Success;
 }
@@ -710,6 +952,13 @@ IT::translate(PTCInstruction *Instr, MetaAddress PC, MetaAddress NextPC) {
 
   std::vector<Value *> InArgs;
   for (uint64_t TemporaryId : TheInstruction.InArguments) {
+    // Forward the values stored earlier in the same basic block, the
+    // IRBuilder will then constant fold the operations on them
+    if (Value *Known = Variables.getKnownValue(TemporaryId)) {
+      InArgs.push_back(Known);
+      continue;
+    }
+
     auto *Temporary = Variables.getOrCreate(TemporaryId, true);
     if (Temporary == nullptr)
       return Abort;
@@ -738,6 +987,7 @@ IT::translate(PTCInstruction *Instr, MetaAddress PC, MetaAddress NextPC) {
       return Abort;
 
     auto *Store = Builder.CreateStore(Result.get()[I], Destination);
+    Variables.recordStore(TheInstruction.OutArguments[I], Result.get()[I]);
 
     if (PCH->affectsPC(Store)) {
       // This is a PC-related store
@@ -869,6 +1119,7 @@ IT::translateOpcode(PTCOpcode Opcode,
       Pointer = Builder.CreateIntToPtr(InArguments[0],
                                        MemoryType->getPointerTo());
       auto *Load = Builder.CreateAlignedLoad(Pointer, Alignment);
+      Load->setMetadata("revng.guestmemory", MDNode::get(Context, {}));
       Value *Loaded = Load;
 
       if (BSwapFunction != nullptr)
@@ -889,7 +1140,8 @@ IT::translateOpcode(PTCOpcode Opcode,
       if (BSwapFunction != nullptr)
         Value = Builder.CreateCall(BSwapFunction, Value);
 
-      Builder.CreateAlignedStore(Value, Pointer, Alignment);
+      auto *Store = Builder.CreateAlignedStore(Value, Pointer, Alignment);
+      Store->setMetadata("revng.guestmemory", MDNode::get(Context, {}));
 
       return v{};
     } else {
@@ -8,7 +8,7 @@
 #include <map>
 #include <vector>
 
-#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/ErrorOr.h"
@@ -29,6 +29,7 @@ class Module;
 } // namespace llvm
 
 class JumpTargetManager;
+class OriginalInstructionsTable;
 class VariableManager;
 
 /// \brief Expands a PTC instruction to LLVM IR
@@ -45,13 +46,17 @@ public:
   ///        further processing.
   /// \param SourceArchitecture the input architecture.
   /// \param TargetArchitecture the output architecture.
+  /// \param OriginalInstructions if not `nullptr`, the table where to record
+  ///        the disassembly of the original instructions, instead of
+  ///        attaching it to the IR.
   InstructionTranslator(llvm::IRBuilder<> &Builder,
                         VariableManager &Variables,
                         JumpTargetManager &JumpTargets,
                         std::vector<llvm::BasicBlock *> Blocks,
                         const Architecture &SourceArchitecture,
                         const Architecture &TargetArchitecture,
-                        ProgramCounterHandler *PCH);
+                        ProgramCounterHandler *PCH,
+                        OriginalInstructionsTable *OriginalInstructions);
 
   /// \brief Result status of the translation of a PTC opcode
   enum TranslationResult {
@@ -74,7 +79,8 @@ public:
   ///
   /// \return a tuple with 4 entries: the
   ///         InstructionTranslator::TranslationResult, an `MDNode` containing
-  ///         the disassembled instruction and the value of the PC and two
+  ///         the disassembled instruction and the value of the PC (or the
+  ///         index of the entry in OriginalInstructionsTable) and two
   ///         `MetaAddress` representing the current and next PC.
   // TODO: rename to newPC
   // TODO: the signature of this function is ugly
@@ -111,15 +117,49 @@ public:
   /// \brief Notifies InstructionTranslator about a new PTC translation
   void reset() { LabeledBasicBlocks.clear(); }
 
+  /// \brief Information about the instruction boundaries of a translation
+  class InstructionBoundaries {
+  public:
+    InstructionBoundaries(unsigned InstructionCount) :
+      ToIgnore(InstructionCount), NextStart(InstructionCount + 1) {}
+
+  public:
+    /// \brief Should the instruction at \p Index be ignored?
+    bool isIgnored(unsigned Index) const { return ToIgnore[Index]; }
+
+    /// \brief Index of the first PTC_INSTRUCTION_op_debug_insn_start after
+    ///        \p Index that is not ignored
+    ///
+    /// \return the index of the instruction or the instruction count, if
+    ///         there's no such instruction.
+    unsigned nextStart(unsigned Index) const { return NextStart[Index]; }
+
+  private:
+    friend class InstructionTranslator;
+
+    llvm::BitVector ToIgnore;
+    std::vector<unsigned> NextStart;
+  };
+
   /// \brief Preprocess the translated instructions
   ///
-  /// Check if the translated code contains a delay slot and return a blacklist
-  /// of the PTC_INSTRUCTION_op_debug_insn_start instructions that have to be
-  /// ignored to merge the delay slot into the branch instruction.
-  llvm::SmallSet<unsigned, 1> preprocess(PTCInstructionList *Instructions);
+  /// Check if the translated code contains a delay slot and blacklist the
+  /// PTC_INSTRUCTION_op_debug_insn_start instructions that have to be ignored
+  /// to merge the delay slot into the branch instruction. Then, for each
+  /// instruction, record the index of the next instruction start, so that it
+  /// can be found in constant time during translation.
+  InstructionBoundaries preprocess(PTCInstructionList *Instructions);
 
   void registerDirectJumps();
 
+  /// \brief Emit native vector instructions in place of a call to a SIMD
+  ///        helper operating on two registers
+  ///
+  /// \return true if the helper has been lowered, false if the call still has
+  ///         to be emitted.
+  bool lowerSIMDHelper(llvm::StringRef HelperName,
+                       llvm::ArrayRef<llvm::Value *> Arguments);
+
 private:
   llvm::ErrorOr<std::vector<llvm::Value *>>
   translateOpcode(PTCOpcode Opcode,
@@ -145,5 +185,6 @@ private:
   llvm::Type *MetaAddressStruct;
 
   ProgramCounterHandler *PCH;
+  OriginalInstructionsTable *OriginalInstructions;
   llvm::SmallVector<llvm::BasicBlock *, 4> ExitBlocks;
 };
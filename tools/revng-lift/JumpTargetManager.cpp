@@ -17,6 +17,7 @@
 #include "boost/type_traits/is_same.hpp"
 
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/ScopedNoAliasAA.h"
 #include "llvm/CodeGen/UnreachableBlockElim.h"
 #include "llvm/IR/IRBuilder.h"
@@ -37,11 +38,13 @@
 #include "revng/BasicAnalyses/AdvancedValueInfo.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/BasicAnalyses/ShrinkInstructionOperandsPass.h"
+#include "revng/Runtime/commonconstants.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/MetaAddress.h"
+#include "revng/Support/Progress.h"
 #include "revng/Support/Statistics.h"
 #include "revng/Support/revng.h"
 
@@ -54,14 +57,49 @@
 
 using namespace llvm;
 
+cl::opt<unsigned> AVIPhiBudget("avi-phi-budget",
+                               cl::desc("maximum number of phis a single AVI "
+                                        "query can explore, 0 for no limit"),
+                               cl::init(0),
+                               cl::cat(MainCategory));
+
+cl::opt<unsigned> AVIMaxValues("avi-max-values",
+                               cl::desc("maximum number of values a single AVI "
+                                        "query can produce before giving up"),
+                               cl::init(MaxMaterializedValues),
+                               cl::cat(MainCategory));
+
+cl::opt<bool> ShrinkWholeFunctions("shrink-whole-functions",
+                                   cl::desc("narrow instructions to the "
+                                            "demanded bits across the whole "
+                                            "function before running AVI "
+                                            "and, with -object -O2, before "
+                                            "optimizing"),
+                                   cl::init(false),
+                                   cl::cat(MainCategory));
+
+CounterMap<std::string> AVIBudgetExceeded("avi-budget-exceeded");
+RunningStatistics AVIQueryDuration("avi-query-duration", RecordDistribution());
+
+static cl::opt<std::string> DispatcherProfilePath("dispatcher-profile",
+                                                  cl::desc("execution trace "
+                                                           "(REVNG_TRACE_PATH) "
+                                                           "or coverage CSV "
+                                                           "used to weight "
+                                                           "the dispatcher"),
+                                                  cl::value_desc("path"),
+                                                  cl::cat(MainCategory));
+
 namespace {
 
-Logger<> JTCountLog("jtcount");
-Logger<> NewEdgesLog("new-edges");
-Logger<> RegisterJTLog("registerjt");
+VerboseLogger JTCountLog("jtcount");
+VerboseLogger NewEdgesLog("new-edges");
+VerboseLogger RegisterJTLog("registerjt");
 
 CounterMap<std::string> HarvestingStats("harvesting");
+MemoryGauge JTMMemory("JumpTargetManager");
 RunningStatistics BlocksAnalyzedByAVI("blocks-analyzed-by-avi");
+RunningStatistics BlocksTrackedByAVI("blocks-tracked-by-avi");
 
 RegisterPass<TranslateDirectBranchesPass> X("translate-db",
                                             "Translate Direct Branches"
@@ -147,6 +185,8 @@ void TDBP::pinExitTB(CallInst *ExitTBCall, DispatcherTargets &Destinations) {
   if (auto *Dispatcher = dyn_cast<SwitchInst>(BB->getTerminator()))
     PCH->destroyDispatcher(Dispatcher);
 
+  PCH->forgetUniqueJumpTarget(BB);
+
   // Kill everything is after the call to exitTB
   exitTBCleanup(ExitTBCall);
 
@@ -232,14 +272,19 @@ void TDBP::pinConstantStoreInternal(MetaAddress Address, CallInst *ExitTBCall) {
   if (++CallIt != BlockEnd)
     purgeBranch(CallIt);
 
+  // The block is changing, and so are the predecessors of its new successor
+  PCH->forgetUniqueJumpTarget(ExitTBCall->getParent());
+
   if (TargetBlock != nullptr) {
     // A target was found, jump there
+    PCH->forgetUniqueJumpTarget(TargetBlock);
     BranchInst::Create(TargetBlock, ExitTBCall);
     JTM->recordNewBranches();
   } else {
     // We're jumping to an unknown or invalid location,
     // jump back to the dispatcher
     // TODO: emit a warning
+    PCH->forgetUniqueJumpTarget(JTM->dispatcher());
     BranchInst::Create(JTM->dispatcher(), ExitTBCall);
   }
 
@@ -354,7 +399,6 @@ JumpTargetManager::readFromPointer(Constant *Pointer, BinaryFile::Endianess E) {
   Type *LoadedType = Pointer->getType()->getPointerElementType();
   const DataLayout &DL = TheModule.getDataLayout();
   unsigned LoadSize = DL.getTypeSizeInBits(LoadedType) / 8;
-  auto NewAPInt = [LoadSize](uint64_t V) { return APInt(LoadSize * 8, V); };
 
   Value *RealPointer = skipCasts(Pointer);
   uint64_t RawLoadAddress = 0;
@@ -366,18 +410,88 @@ JumpTargetManager::readFromPointer(Constant *Pointer, BinaryFile::Endianess E) {
   UnusedCodePointers.erase(LoadAddress);
   registerReadRange(LoadAddress, LoadSize);
 
+  return readValue(LoadAddress, LoadSize, E);
+}
+
+MaterializedValues
+JumpTargetManager::readTable(MetaAddress Base,
+                             uint64_t Stride,
+                             unsigned Size,
+                             const ConstantRangeSet &Indices,
+                             BinaryFile::Endianess E) {
+  using std::numeric_limits;
+  auto NewAPInt = [Size](uint64_t V) { return APInt(Size * 8, V); };
+
+  std::vector<uint64_t> Expanded;
+  for (const APInt &Index : Indices)
+    Expanded.push_back(Index.getLimitedValue());
+
+  MaterializedValues Result;
+  if (Expanded.size() == 0)
+    return Result;
+  Result.reserve(Expanded.size());
+
+  // Compute the boundaries of the table, if they do not overflow
+  uint64_t Available = numeric_limits<uint64_t>::max() - Size;
+  bool Overflows = Stride == 0 or Expanded.back() > Available / Stride;
+  MetaAddress Start = MetaAddress::invalid();
+  MetaAddress End = MetaAddress::invalid();
+  if (not Overflows) {
+    Start = Base + Expanded.front() * Stride;
+    End = Base + Expanded.back() * Stride + Size;
+    Overflows = End.isInvalid() or End.addressLowerThanOrEqual(Start);
+  }
+
+  if (Overflows) {
+    for (uint64_t Index : Expanded) {
+      MetaAddress Address = Base + Index * Stride;
+      UnusedCodePointers.erase(Address);
+      registerReadRange(Address, Size);
+      Result.push_back(readValue(Address, Size, E));
+    }
+    return Result;
+  }
+
+  registerReadRange(Start, End - Start);
+
+  // Labels are rare, if the table contains none read it straight from the
+  // segment data
+  const auto &Labels = binary().labels();
+  bool HasLabels = Labels.find(Start, End) != Labels.end();
+  std::vector<Optional<uint64_t>> RawValues;
+  if (not HasLabels)
+    RawValues = Binary.readRawValues(Base, Stride, Size, Expanded, E);
+
+  for (unsigned I = 0; I < Expanded.size(); ++I) {
+    MetaAddress Address = Base + Expanded[I] * Stride;
+    UnusedCodePointers.erase(Address);
+
+    if (HasLabels)
+      Result.push_back(readValue(Address, Size, E));
+    else if (RawValues[I])
+      Result.push_back({ NewAPInt(*RawValues[I]) });
+    else
+      Result.push_back(MaterializedValue::invalid());
+  }
+
+  return Result;
+}
+
+MaterializedValue JumpTargetManager::readValue(MetaAddress LoadAddress,
+                                               unsigned LoadSize,
+                                               BinaryFile::Endianess E) {
+  auto NewAPInt = [LoadSize](uint64_t V) { return APInt(LoadSize * 8, V); };
+
   // Prevent overflow when computing the label interval
   if ((LoadAddress + LoadSize).addressLowerThan(LoadAddress)) {
     return MaterializedValue::invalid();
   }
 
   const auto &Labels = binary().labels();
-  using interval = boost::icl::interval<MetaAddress, compareAddress>;
-  auto Interval = interval::right_open(LoadAddress, LoadAddress + LoadSize);
-  auto It = Labels.find(Interval);
+  auto It = Labels.find(LoadAddress, LoadAddress + LoadSize);
   if (It != Labels.end()) {
     const Label *Match = nullptr;
-    for (const Label *Candidate : It->second) {
+    for (const Label *Candidate : It->Labels) {
       if (Candidate->size() == LoadSize
           and (Candidate->isAbsoluteValue() or Candidate->isBaseRelativeValue()
                or Candidate->isSymbolRelativeValue())) {
@@ -440,6 +554,7 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
   CurrentCFGForm(CFGForm::UnknownForm),
   createCSAA(createCSAA),
   PCH(PCH),
+  OpaqueFunctions(&TheModule),
   JumpTargetsWhitelist(nullptr) {
 
   FunctionType *ExitTBTy = FunctionType::get(Type::getVoidTy(Context),
@@ -453,6 +568,9 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
   for (auto &Segment : Binary.segments())
     Segment.insertExecutableRanges(std::back_inserter(ExecutableRanges));
 
+  if (not DispatcherProfilePath.empty())
+    loadDispatcherProfile(DispatcherProfilePath);
+
   // Configure GlobalValueNumbering
   StringMap<cl::Option *> &Options(cl::getRegisteredOptions());
   getOption<bool>(Options, "enable-load-pre")->setInitialValue(false);
@@ -463,8 +581,8 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
 
 void JumpTargetManager::harvestGlobalData() {
   // Register symbols
-  for (auto &P : Binary.labels())
-    for (const Label *L : P.second)
+  for (const auto &Segment : Binary.labels())
+    for (const Label *L : Segment.Labels)
       if (L->isSymbol() and L->isCode())
         registerJT(L->address(), JTReason::FunctionSymbol);
 
@@ -476,7 +594,26 @@ void JumpTargetManager::harvestGlobalData() {
   for (MetaAddress CodePointer : Binary.codePointers())
     registerJT(CodePointer, JTReason::GlobalData);
 
+  // Collect the executable ranges as sorted, merged raw address ranges, so
+  // that we can discard most of the words without building a MetaAddress
+  RawRangesVector RawRanges;
+  for (const std::pair<MetaAddress, MetaAddress> &Range : ExecutableRanges)
+    RawRanges.emplace_back(Range.first.address(), Range.second.address());
+  llvm::sort(RawRanges);
+
+  RawRangesVector MergedRanges;
+  for (const std::pair<uint64_t, uint64_t> &Range : RawRanges) {
+    if (not MergedRanges.empty() and Range.first <= MergedRanges.back().second)
+      MergedRanges.back().second = std::max(MergedRanges.back().second,
+                                            Range.second);
+    else
+      MergedRanges.push_back(Range);
+  }
+
   for (auto &Segment : Binary.segments()) {
+    if (MergedRanges.empty())
+      break;
+
     const Constant *Initializer = Segment.Variable->getInitializer();
     if (isa<ConstantAggregateZero>(Initializer))
       continue;
@@ -491,20 +628,24 @@ void JumpTargetManager::harvestGlobalData() {
       if (Binary.architecture().isLittleEndian())
         findCodePointers<uint64_t, endianness::little>(StartVirtualAddress,
                                                        DataStart,
-                                                       DataEnd);
+                                                       DataEnd,
+                                                       MergedRanges);
       else
         findCodePointers<uint64_t, endianness::big>(StartVirtualAddress,
                                                     DataStart,
-                                                    DataEnd);
+                                                    DataEnd,
+                                                    MergedRanges);
     } else if (Binary.architecture().pointerSize() == 32) {
       if (Binary.architecture().isLittleEndian())
         findCodePointers<uint32_t, endianness::little>(StartVirtualAddress,
                                                        DataStart,
-                                                       DataEnd);
+                                                       DataEnd,
+                                                       MergedRanges);
       else
         findCodePointers<uint32_t, endianness::big>(StartVirtualAddress,
                                                     DataStart,
-                                                    DataEnd);
+                                                    DataEnd,
+                                                    MergedRanges);
     }
   }
 
@@ -516,12 +657,45 @@ void JumpTargetManager::harvestGlobalData() {
 template<typename value_type, unsigned endian>
 void JumpTargetManager::findCodePointers(MetaAddress StartVirtualAddress,
                                          const unsigned char *Start,
-                                         const unsigned char *End) {
+                                         const unsigned char *End,
+                                         const RawRangesVector &Ranges) {
   using support::endianness;
   using support::endian::read;
-  for (auto Pos = Start; Pos < End - sizeof(value_type); Pos++) {
-    auto Read = read<value_type, static_cast<endianness>(endian), 1>;
+
+  revng_assert(not Ranges.empty());
+  const uint64_t Lowest = Ranges.front().first;
+  const uint64_t Highest = Ranges.back().second;
+
+  auto IsInRanges = [&Ranges](uint64_t Address) {
+    auto Compare = [](uint64_t Value, const std::pair<uint64_t, uint64_t> &R) {
+      return Value < R.first;
+    };
+    auto It = std::upper_bound(Ranges.begin(), Ranges.end(), Address, Compare);
+    if (It == Ranges.begin())
+      return false;
+    --It;
+    return Address < It->second;
+  };
+
+  // Too small to contain a pointer
+  if (End - Start < static_cast<ptrdiff_t>(sizeof(value_type)))
+    return;
+
+  // A candidate starts at each byte offset, so candidates overlap and are read
+  // in place, one unaligned load each (unlike the strided entries of a table,
+  // see BinaryFile::readRawValues)
+  auto Read = read<value_type, static_cast<endianness>(endian), 1>;
+  const unsigned char *Last = End - sizeof(value_type);
+  for (auto Pos = Start; Pos <= Last; Pos++) {
     uint64_t RawValue = Read(Pos);
+
+    // Cheap rejection of the (vast majority of) values that cannot point into
+    // an executable range. Note that a code pointer might have the lowest bit
+    // set (e.g., Thumb).
+    uint64_t Address = RawValue & ~static_cast<uint64_t>(1);
+    if (Address < Lowest or Address >= Highest or not IsInRanges(Address))
+      continue;
+
     MetaAddress Value = fromPC(RawValue);
     if (Value.isInvalid())
       continue;
@@ -599,15 +773,20 @@ void JumpTargetManager::registerInstruction(MetaAddress PC,
   revng_assert(PC.isValid());
 
   // Never save twice a PC
-  revng_assert(!OriginalInstructionAddresses.count(PC));
-  OriginalInstructionAddresses[PC] = Instruction;
+  bool New = OriginalInstructionAddresses.emplace(PC, Instruction).second;
+  revng_assert(New);
 }
 
 // TODO: this is a candidate for BFSVisit
 std::pair<MetaAddress, uint64_t>
 JumpTargetManager::getPC(Instruction *TheInstruction) const {
+  // Look up newpc once, so that we can compare callees by pointer
+  Function *NewPCFunction = TheModule.getFunction("newpc");
+  if (NewPCFunction == nullptr)
+    return { MetaAddress::invalid(), 0 };
+
   CallInst *NewPCCall = nullptr;
-  std::set<BasicBlock *> Visited;
+  SmallPtrSet<BasicBlock *, 8> Visited;
   std::queue<BasicBlock::reverse_iterator> WorkList;
   if (TheInstruction->getIterator() == TheInstruction->getParent()->begin())
     WorkList.push(--TheInstruction->getParent()->rend());
@@ -623,9 +802,7 @@ JumpTargetManager::getPC(Instruction *TheInstruction) const {
     // Go through the instructions looking for calls to newpc
     for (; I != End; I++) {
       if (auto Marker = dyn_cast<CallInst>(&*I)) {
-        // TODO: comparing strings is not very elegant
-        auto *Callee = Marker->getCalledFunction();
-        if (Callee != nullptr && Callee->getName() == "newpc") {
+        if (Marker->getCalledFunction() == NewPCFunction) {
 
           // We found two distinct newpc leading to the requested instruction
           if (NewPCCall != nullptr)
@@ -651,11 +828,8 @@ JumpTargetManager::getPC(Instruction *TheInstruction) const {
 
       for (BasicBlock *Predecessor : predecessors(BB)) {
         // Ignore already visited or empty BBs
-        if (!Predecessor->empty()
-            && Visited.find(Predecessor) == Visited.end()) {
+        if (!Predecessor->empty() && Visited.insert(Predecessor).second)
           WorkList.push(Predecessor->rbegin());
-          Visited.insert(Predecessor);
-        }
       }
     }
   }
@@ -747,6 +921,7 @@ void JumpTargetManager::fixPostHelperPC() {
         if (std::find_if(Written.begin(), End, WritesPC) != End) {
           IRBuilder<> Builder(Call->getParent(), ++Call->getIterator());
           PCH->deserializePC(Builder);
+          PCH->forgetUniqueJumpTarget(Call->getParent());
         }
       }
     }
@@ -792,6 +967,9 @@ JumpTargetManager::BlockWithAddress JumpTargetManager::peek() {
     purgeTranslation(BB);
   ToPurge.clear();
 
+  Progress->set("jump-targets", JumpTargets.size());
+  Progress->set("pending-jump-targets", Unexplored.size());
+
   if (Unexplored.empty())
     return NoMoreTargets;
   else {
@@ -842,6 +1020,7 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
   SubGraph<BasicBlock *> TranslatedBBs(Start, Visited);
   for (auto *Node : post_order(TranslatedBBs)) {
     BasicBlock *BB = Node->get();
+    PCH->forgetUniqueJumpTarget(BB);
     while (!BB->empty()) {
       Instruction *I = &*(--BB->end());
 
@@ -908,6 +1087,7 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
     } else {
       revng_assert(I != nullptr && I->getIterator() != ContainingBlock->end());
       NewBlock = ContainingBlock->splitBasicBlock(I);
+      PCH->forgetUniqueJumpTarget(ContainingBlock);
     }
 
     // Register the basic block and all of its descendants to be purged so that
@@ -929,8 +1109,10 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
   NewBlock->setName(Name.str());
 
   // Create a case for the address associated to the new block, if the
-  // dispatcher has alredy been emitted
-  if (DispatcherSwitch != nullptr) {
+  // dispatcher has alredy been emitted and doesn't handle it yet.
+  // DispatcherCases tracks all the cases of the dispatcher, which ensures
+  // addCaseToDispatcher is never asked to add a duplicate.
+  if (DispatcherSwitch != nullptr and DispatcherCases.insert(PC).second) {
     PCH->addCaseToDispatcher(DispatcherSwitch,
                              { PC, NewBlock },
                              BlockType::RootDispatcherHelperBlock);
@@ -983,11 +1165,20 @@ static void purge(BasicBlock *BB) {
   revng_assert(BB->empty());
 }
 
+/// \brief Record in \p Visited all the blocks reachable from \p Entry
+static void visitReachable(BasicBlock *Entry,
+                           df_iterator_default_set<BasicBlock *> &Visited) {
+  auto It = df_ext_begin(Entry, Visited);
+  auto End = df_ext_end(Entry, Visited);
+  while (It != End)
+    ++It;
+}
+
 std::set<BasicBlock *> JumpTargetManager::computeUnreachable() const {
-  ReversePostOrderTraversal<BasicBlock *> RPOT(&TheFunction->getEntryBlock());
-  std::set<BasicBlock *> Reachable;
-  for (BasicBlock *BB : RPOT)
-    Reachable.insert(BB);
+  // A plain depth-first visit is enough, the order doesn't matter
+  df_iterator_default_set<BasicBlock *> Reachable;
+  BasicBlock *Entry = &TheFunction->getEntryBlock();
+  visitReachable(Entry, Reachable);
 
   // TODO: why is isTranslatedBB(&BB) necessary?
   std::set<BasicBlock *> Unreachable;
@@ -1012,6 +1203,12 @@ void JumpTargetManager::setCFGForm(CFGForm::Values NewForm) {
   CFGForm::Values OldForm = CurrentCFGForm;
   CurrentCFGForm = NewForm;
 
+  // AnyPC and UnexpectedPC will change, and so will the predecessors of the
+  // dispatcher
+  PCH->forgetUniqueJumpTarget(AnyPC);
+  PCH->forgetUniqueJumpTarget(UnexpectedPC);
+  PCH->forgetUniqueJumpTarget(Dispatcher);
+
   //
   // Recreate AnyPC and UnexpectedPC
   //
@@ -1064,6 +1261,8 @@ void JumpTargetManager::setCFGForm(CFGForm::Values NewForm) {
         int OperandIndex = NewForm == CFGForm::NoFunctionCalls ? 1 : 0;
         Value *Op = Call->getArgOperand(OperandIndex);
         BasicBlock *NewSuccessor = cast<BlockAddress>(Op)->getBasicBlock();
+        PCH->forgetUniqueJumpTarget(Terminator->getSuccessor(0));
+        PCH->forgetUniqueJumpTarget(NewSuccessor);
         Terminator->setSuccessor(0, NewSuccessor);
       }
     }
@@ -1076,8 +1275,100 @@ void JumpTargetManager::setCFGForm(CFGForm::Values NewForm) {
   }
 }
 
+void JumpTargetManager::loadDispatcherProfile(StringRef Path) {
+  // Records are PCs, interpret them in the default epoch and address space
+  // (e.g., on ARM, the LSB selects Thumb)
+  auto Arch = Binary.architecture().type();
+  auto Record = [this, Arch](uint64_t PC, uint64_t Hits = 1) {
+    DispatcherProfile[MetaAddress::fromPC(Arch, PC)] += Hits;
+  };
+
+  std::ifstream Trace(Path.str(), std::ios::binary);
+  revng_check(Trace.is_open(), "Cannot open the dispatcher profile");
+
+  // Coverage CSV (see InstrumentCoverage). Unlike the traces, which only
+  // record the address, its PCs tell ARM and Thumb code apart.
+  std::string Line;
+  if (std::getline(Trace, Line) and StringRef(Line).trim() == "pc,hits") {
+    while (std::getline(Trace, Line)) {
+      StringRef PCString, HitsString;
+      std::tie(PCString, HitsString) = StringRef(Line).split(',');
+
+      uint64_t PC = 0;
+      uint64_t Hits = 0;
+      bool Invalid = PCString.trim().getAsInteger(0, PC)
+                     or HitsString.trim().getAsInteger(10, Hits);
+      revng_check(not Invalid, "Invalid line in the dispatcher profile");
+      Record(PC, Hits);
+    }
+    return;
+  }
+
+  Trace.clear();
+  Trace.seekg(0);
+  char Magic[REVNG_COMPACT_TRACE_MAGIC_SIZE];
+  bool IsCompact = Trace.read(Magic, sizeof(Magic))
+                   and StringRef(Magic, sizeof(Magic))
+                         == REVNG_COMPACT_TRACE_MAGIC;
+
+  if (not IsCompact) {
+    // Legacy format: a program counter in native endianess for each executed
+    // instruction
+    Trace.clear();
+    Trace.seekg(0);
+    uint64_t PC = 0;
+    while (Trace.read(reinterpret_cast<char *>(&PC), sizeof(PC)))
+      Record(PC);
+    return;
+  }
+
+  // Compact format: zigzag-encoded LEB128 deltas from the previous record
+  uint64_t PC = 0;
+  uint64_t Value = 0;
+  unsigned Shift = 0;
+  char Byte;
+  while (Trace.get(Byte)) {
+    Value |= static_cast<uint64_t>(Byte & 0x7F) << Shift;
+    Shift += 7;
+
+    if ((Byte & 0x80) == 0) {
+      uint64_t Delta = (Value >> 1) ^ -(Value & 1);
+      PC += Delta;
+      Record(PC);
+      Value = 0;
+      Shift = 0;
+    }
+  }
+
+  revng_check(Shift == 0, "Truncated dispatcher profile");
+}
+
 void JumpTargetManager::rebuildDispatcher() {
 
+  // In the SemanticPreserving form the dispatcher reaches all the jump
+  // targets. Since the dispatcher of any other form reaches a subset of them,
+  // going back to SemanticPreserving only requires adding the missing cases,
+  // instead of rebuilding the whole dispatcher.
+  //
+  // Note: this is not possible with a dispatcher profile, since the weights of
+  //       the switch would need to be recomputed.
+  bool Incremental = (CurrentCFGForm == CFGForm::SemanticPreserving
+                      and DispatcherSwitch != nullptr
+                      and JumpTargetsWhitelist == nullptr
+                      and DispatcherProfile.empty());
+  if (Incremental) {
+    revng_assert(DispatcherSwitch->getParent() == Dispatcher);
+    for (auto &[PC, JumpTarget] : JumpTargets) {
+      if (DispatcherCases.insert(PC).second) {
+        PCH->addCaseToDispatcher(DispatcherSwitch,
+                                 { PC, JumpTarget.head() },
+                                 BlockType::RootDispatcherHelperBlock);
+      }
+    }
+
+    return;
+  }
+
   if (DispatcherSwitch != nullptr) {
     revng_assert(DispatcherSwitch->getParent() == Dispatcher);
 
@@ -1101,22 +1392,17 @@ void JumpTargetManager::rebuildDispatcher() {
     }
   }
 
-  DispatcherSwitch = PCH->buildDispatcher(Targets,
-                                          Dispatcher,
-                                          DispatcherFail,
-                                          BlockType::RootDispatcherHelperBlock);
-
-  // The switch is the terminator of the dispatcher basic block
-  setBlockType(DispatcherSwitch, BlockType::RootDispatcherBlock);
-
   //
   // Make sure every generated basic block is reachable
   //
   if (CurrentCFGForm != CFGForm::SemanticPreserving) {
-    // Compute the set of reachable jump targets
+    // Compute the set of jump targets reachable from the dispatcher we're about
+    // to build. We do this before building it, so that we can emit it in a
+    // single shot, instead of adding cases one by one.
     OnceQueue<BasicBlock *> WorkList;
-    for (BasicBlock *Successor : successors(DispatcherSwitch))
-      WorkList.insert(Successor);
+    WorkList.insert(DispatcherFail);
+    for (const auto &Target : Targets)
+      WorkList.insert(Target.second);
 
     while (not WorkList.empty()) {
       BasicBlock *BB = WorkList.pop();
@@ -1136,12 +1422,33 @@ void JumpTargetManager::rebuildDispatcher() {
       // just direct jump
       if (Reachable.count(BB) == 0 and IsWhitelisted
           and not JT.isOnlyReason(JTReason::DirectJump)) {
-        PCH->addCaseToDispatcher(DispatcherSwitch,
-                                 { PC, BB },
-                                 BlockType::RootDispatcherHelperBlock);
+        Targets.emplace_back(PC, BB);
       }
     }
   }
+
+  // Weight each jump target with how many times the profile met it
+  auto ProfileWeight = [this](const MetaAddress &MA) -> uint64_t {
+    auto It = DispatcherProfile.find(MA);
+    return It == DispatcherProfile.end() ? 0 : It->second;
+  };
+
+  ProgramCounterHandler::DispatcherWeights Weights;
+  if (not DispatcherProfile.empty())
+    Weights = ProfileWeight;
+
+  DispatcherCases.clear();
+  for (const auto &Target : Targets)
+    DispatcherCases.insert(Target.first);
+
+  DispatcherSwitch = PCH->buildDispatcher(Targets,
+                                          Dispatcher,
+                                          DispatcherFail,
+                                          BlockType::RootDispatcherHelperBlock,
+                                          Weights);
+
+  // The switch is the terminator of the dispatcher basic block
+  setBlockType(DispatcherSwitch, BlockType::RootDispatcherBlock);
 }
 
 bool JumpTargetManager::hasPredecessors(BasicBlock *BB) const {
@@ -1350,8 +1657,10 @@ private:
   IRBuilder<> Builder;
 
 public:
-  AnalysisRegistry(Module *M) : QMD(getContext(M)), Builder(getContext(M)) {
-    AVIMarker = AdvancedValueInfoPass::createMarker(M);
+  AnalysisRegistry(Module *M, OpaqueFunctionsRegistry &OpaqueFunctions) :
+    QMD(getContext(M)), Builder(getContext(M)) {
+    AVIMarker = AdvancedValueInfoPass::createMarker(getContext(M),
+                                                    OpaqueFunctions);
   }
 
   llvm::Function *aviMarker() const { return AVIMarker; }
@@ -1396,7 +1705,7 @@ void JumpTargetManager::inflateAVIWhitelist() {
   // or a function call.
 
   // Prepare the backward visit
-  std::set<MetaAddress> ToPreserve;
+  MetaAddressSet ToPreserve;
   df_iterator_default_set<BasicBlock *> VisitSet;
 
   // Stop at the dispatcher
@@ -1472,6 +1781,9 @@ void JumpTargetManager::harvestWithAVI() {
   //
   Function *OptimizedFunction = nullptr;
   ValueToValueMapTy OldToNew;
+
+  // Jump targets registered since the last time we ran AVI
+  MetaAddressSet NewJumpTargets = AVIJumpTargetsWhitelist;
   {
     // Augment AVIJumpTargetsWhitelist
     inflateAVIWhitelist();
@@ -1488,10 +1800,6 @@ void JumpTargetManager::harvestWithAVI() {
     // Clone the function
     OptimizedFunction = CloneFunction(TheFunction, OldToNew);
 
-    // Record the size of OptimizedFunction
-    size_t BlocksCount = OptimizedFunction->getBasicBlockList().size();
-    BlocksAnalyzedByAVI.push(BlocksCount);
-
     // Reattach the unreachable basic blocks to the original root function
     for (BasicBlock *UnreachableBB : UnreachableBBs)
       UnreachableBB->insertInto(TheFunction);
@@ -1505,17 +1813,104 @@ void JumpTargetManager::harvestWithAVI() {
     AVIJumpTargetsWhitelist.clear();
   }
 
+  //
+  // Identify the basic blocks whose analysis results might have changed
+  //
+
+  // The values AVI computes only depend on what happens on the paths leading
+  // to them. Therefore, only the code reachable from the new jump targets can
+  // produce new results. The rest of the code is in OptimizedFunction only to
+  // provide context.
+  //
+  // As in inflateAVIWhitelist, we stop at the dispatcher: going through it
+  // would reach all the code.
+  Value *ClonedSwitch = OldToNew.lookup(DispatcherSwitch);
+  BasicBlock *ClonedDispatcher = cast<Instruction>(ClonedSwitch)->getParent();
+  OnceQueue<BasicBlock *> ToTrackQueue;
+  for (MetaAddress MA : NewJumpTargets) {
+    auto It = OldToNew.find(getBlockAt(MA));
+    if (It != OldToNew.end())
+      ToTrackQueue.insert(cast<BasicBlock>(&*It->second));
+  }
+
+  while (not ToTrackQueue.empty())
+    for (BasicBlock *Successor : successors(ToTrackQueue.pop()))
+      if (Successor != ClonedDispatcher)
+        ToTrackQueue.insert(Successor);
+
+  std::set<BasicBlock *> ToTrack = ToTrackQueue.visited();
+  BlocksTrackedByAVI.push(ToTrack.size());
+
+  // No new code, no new results
+  if (ToTrack.empty()) {
+    OptimizedFunction->eraseFromParent();
+    return;
+  }
+
+  //
+  // Drop the code that cannot lead to the basic blocks to track
+  //
+
+  // A basic block that cannot reach any block in ToTrack cannot affect the
+  // values computed there: its definitions cannot dominate them nor be an
+  // incoming value of their phis. We replace the body of such blocks with a
+  // return, so that they, and all the code reachable only through them, are
+  // not optimized. Note that using unreachable in place of the return would
+  // let the optimizations prune the paths leading to them, which are feasible.
+  //
+  // The dispatcher is kept, but we don't go past it. The entry block is kept
+  // too, since it's where the dispatcher is reached from.
+  OnceQueue<BasicBlock *> ContextQueue;
+  ContextQueue.insert(&OptimizedFunction->getEntryBlock());
+  for (BasicBlock *BB : ToTrack)
+    ContextQueue.insert(BB);
+
+  while (not ContextQueue.empty()) {
+    BasicBlock *BB = ContextQueue.pop();
+    if (BB == ClonedDispatcher)
+      continue;
+
+    for (BasicBlock *Predecessor : predecessors(BB))
+      ContextQueue.insert(Predecessor);
+  }
+
+  std::set<BasicBlock *> ContextBBs = ContextQueue.visited();
+
+  SmallVector<BasicBlock *, 16> OutOfContext;
+  for (BasicBlock &BB : *OptimizedFunction)
+    if (ContextBBs.count(&BB) == 0)
+      OutOfContext.push_back(&BB);
+
+  // Drop all the references first, since these blocks can use each other
+  for (BasicBlock *BB : OutOfContext)
+    BB->dropAllReferences();
+
+  for (BasicBlock *BB : OutOfContext) {
+    while (not BB->empty())
+      BB->back().eraseFromParent();
+    ReturnInst::Create(Context, BB);
+  }
+
+  removeUnreachableBlocks(*OptimizedFunction);
+
+  // Record the size of OptimizedFunction
+  size_t BlocksCount = OptimizedFunction->getBasicBlockList().size();
+  BlocksAnalyzedByAVI.push(BlocksCount);
+
   //
   // Register for analysis the value written in the PC before each exit_tb call
   //
-  AnalysisRegistry AR(M);
+  AnalysisRegistry AR(M, OpaqueFunctions);
   IRBuilder<> Builder(Context);
   for (User *U : ExitTB->users()) {
     if (auto *Call = dyn_cast<CallInst>(U)) {
       BasicBlock *BB = Call->getParent();
       if (BB->getParent() == TheFunction) {
+        // The clone might have been dropped along with the code out of context
         auto It = OldToNew.find(Call);
-        if (It == OldToNew.end())
+        if (It == OldToNew.end() or It->second == nullptr)
+          continue;
+        if (ToTrack.count(cast<CallInst>(&*It->second)->getParent()) == 0)
           continue;
         Builder.SetInsertPoint(cast<CallInst>(&*It->second));
         Instruction *ComposedIntegerPC = PCH->composeIntegerPC(Builder);
@@ -1531,6 +1926,9 @@ void JumpTargetManager::harvestWithAVI() {
   // Register load/store addresses and PC-sized stored value
   //
   for (BasicBlock &BB : *OptimizedFunction) {
+    if (ToTrack.count(&BB) == 0)
+      continue;
+
     for (Instruction &I : BB) {
       namespace TIT = TrackedInstructionType;
 
@@ -1656,7 +2054,7 @@ void JumpTargetManager::harvestWithAVI() {
   StringRef SyscallIDCSVName = Binary.architecture().syscallNumberRegister();
   GlobalVariable *SyscallIDCSV = M->getGlobalVariable(SyscallIDCSVName);
 
-  SummaryCallsBuilder SCB(CSVMap);
+  SummaryCallsBuilder SCB(CSVMap, OpaqueFunctions);
 
   {
     // Note: it is important to let the pass manager go out of scope ASAP:
@@ -1666,7 +2064,7 @@ void JumpTargetManager::harvestWithAVI() {
     FunctionPassManager FPM;
     FPM.addPass(DropMarkerCalls({ "exitTB" }));
     FPM.addPass(DropHelperCallsPass(SyscallHelper, SyscallIDCSV, SCB));
-    FPM.addPass(ShrinkInstructionOperandsPass());
+    FPM.addPass(ShrinkInstructionOperandsPass(ShrinkWholeFunctions));
     FPM.addPass(PromotePass());
     FPM.addPass(JumpThreadingPass());
     FPM.addPass(UnreachableBlockElimPass());
@@ -1805,9 +2203,6 @@ void JumpTargetManager::harvestWithAVI() {
   // Drop the optimized function
   //
   OptimizedFunction->eraseFromParent();
-
-  // Drop temporary functions
-  SCB.cleanup();
 }
 
 // Harvesting proceeds trying to avoid to run expensive analyses if not strictly
@@ -1818,6 +2213,7 @@ void JumpTargetManager::harvestWithAVI() {
 // translate we proceed as long as we are able to create new edges on the CFG
 // (not considering the dispatcher).
 void JumpTargetManager::harvest() {
+  ScopedTimer Timer("harvest");
 
   HarvestingStats.push("harvest 0");
 
@@ -1831,6 +2227,7 @@ void JumpTargetManager::harvest() {
 
   if (empty()) {
     HarvestingStats.push("harvest 2: SROA + InstCombine + TBDP");
+    Progress->set("harvest-round", ++HarvestRound);
 
     // Safely erase all unreachable blocks
     std::set<BasicBlock *> Unreachable = computeUnreachable();
@@ -1904,6 +2301,20 @@ void JumpTargetManager::harvest() {
   if (empty()) {
     revng_log(JTCountLog, "We're done looking for jump targets");
   }
+
+  updateMemoryGauge();
+}
+
+void JumpTargetManager::updateMemoryGauge() const {
+  uint64_t Bytes = nodeFootprint(JumpTargets)
+                   + nodeFootprint(OriginalInstructionAddresses)
+                   + nodeFootprint(UnusedCodePointers)
+                   + nodeFootprint(SimpleLiterals) + nodeFootprint(ToPurge)
+                   + nodeFootprint(DispatcherProfile)
+                   + DispatcherCases.getMemorySize()
+                   + AVIJumpTargetsWhitelist.getMemorySize()
+                   + Unexplored.capacity() * sizeof(BlockWithAddress);
+  JTMMemory.set(Bytes);
 }
 
 using BWA = JumpTargetManager::BlockWithAddress;
@@ -13,11 +13,16 @@
 #include "boost/icl/interval_set.hpp"
 #include "boost/type_traits/is_same.hpp"
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 
+#include "revng/ADT/ConstantRangeSet.h"
 #include "revng/BasicAnalyses/MaterializedValue.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/OpaqueFunctionsPool.h"
 #include "revng/Support/ProgramCounterHandler.h"
 #include "revng/Support/revng.h"
 
@@ -38,6 +43,8 @@ class Value;
 class JumpTargetManager;
 class ProgramCounterHandler;
 
+extern llvm::cl::opt<bool> ShrinkWholeFunctions;
+
 template<typename Map>
 typename Map::const_iterator
 containing(Map const &m, typename Map::key_type const &k) {
@@ -208,6 +215,7 @@ public:
 public:
   using BlockMap = std::map<MetaAddress, JumpTarget>;
   using RangesVector = std::vector<std::pair<MetaAddress, MetaAddress>>;
+  using RawRangesVector = std::vector<std::pair<uint64_t, uint64_t>>;
   using CSAAFactory = std::function<CPUStateAccessAnalysisPass *(void)>;
 
 public:
@@ -400,6 +408,20 @@ public:
   MaterializedValue
   readFromPointer(llvm::Constant *Pointer, BinaryFile::Endianess E);
 
+  /// \brief Read the entries \p Indices of a table of \p Size bytes values
+  ///
+  /// This is equivalent to calling readFromPointer on Base + I * Stride for
+  /// each index I in \p Indices, but the read range is registered once and,
+  /// unless the table contains labels, the values are read in a single pass
+  /// over the segment data.
+  ///
+  /// \return the value of each entry, in ascending order of index.
+  MaterializedValues readTable(MetaAddress Base,
+                               uint64_t Stride,
+                               unsigned Size,
+                               const ConstantRangeSet &Indices,
+                               BinaryFile::Endianess E);
+
   /// \brief Increment the counter of emitted branches since the last reset
   void recordNewBranches(size_t Count = 1) { NewBranches += Count; }
 
@@ -413,6 +435,9 @@ public:
   /// This function also fixes the "anypc" and "unexpectedpc" basic blocks to
   /// their proper behavior.
   void finalizeJumpTargets() {
+    // No more harvesting, drop the opaque functions used by the analyses
+    OpaqueFunctions.purge();
+
     fixPostHelperPC();
 
     translateIndirectJumps();
@@ -434,6 +459,8 @@ public:
 
     // We no longer need this information
     freeContainer(UnusedCodePointers);
+    freeContainer(AVIJumpTargetsWhitelist);
+    updateMemoryGauge();
   }
 
   MetaAddress fromPC(uint64_t PC) const { return Binary.fromPC(PC); }
@@ -477,6 +504,24 @@ public:
     }
   }
 
+  /// \brief Free the information about the jump targets
+  ///
+  /// Call this once the jump targets have been finalized and tagged with their
+  /// reasons: from now on, only the dispatcher-related basic blocks can be
+  /// queried.
+  void releaseJumpTargets() {
+    freeContainer(OriginalInstructionAddresses);
+    freeContainer(JumpTargets);
+    freeContainer(Unexplored);
+    freeContainer(DispatcherCases);
+    freeContainer(ExecutableRanges);
+    freeContainer(ReadIntervalSet);
+    freeContainer(DispatcherProfile);
+    freeContainer(ToPurge);
+    freeContainer(SimpleLiterals);
+    updateMemoryGauge();
+  }
+
   unsigned delaySlotSize() const {
     return Binary.architecture().delaySlotSize();
   }
@@ -510,6 +555,10 @@ public:
 private:
   void fixPostHelperPC();
 
+  /// \brief Read \p LoadSize bytes at \p LoadAddress, considering labels
+  MaterializedValue
+  readValue(MetaAddress LoadAddress, unsigned LoadSize, BinaryFile::Endianess E);
+
   std::set<llvm::BasicBlock *> computeUnreachable() const;
 
   void assertNoUnreachable() const;
@@ -544,6 +593,15 @@ private:
   }
 
   /// \brief Drop \p Start and all the descendants, stopping when a JT is met
+  ///
+  /// \note When a jump target lands in the middle of a translated block we
+  ///       retranslate from there instead of just splitting the existing IR
+  ///       at the corresponding newpc. The code translated in a single shot
+  ///       by the TCG can carry state from one instruction to the next in
+  ///       local temporaries (see VariableManager::newFunction) and in
+  ///       translator-private state (e.g., conditional execution blocks and
+  ///       delay slots), which would be undefined, or wrong, when entering
+  ///       from the dispatcher at the split point.
   void purgeTranslation(llvm::BasicBlock *Start);
 
   /// \brief Check if \p BB has at least a predecessor, excluding the dispatcher
@@ -553,14 +611,23 @@ private:
   ///
   /// Depending on the CFG form we're currently adopting the dispatcher might go
   /// to all the jump targets or only to those who have no other predecessor.
+  /// When going back to the SemanticPreserving form, the existing dispatcher
+  /// is extended with the missing jump targets instead.
   void rebuildDispatcher();
 
+  /// \brief Count the occurrences of each PC in the execution trace at \p Path
+  void loadDispatcherProfile(llvm::StringRef Path);
+
   void prepareDispatcher();
 
+  /// \brief Register as jump targets all the pointer-sized values in [\p
+  ///        Start, \p End) pointing into one of the (sorted, disjoint) \p
+  ///        Ranges
   template<typename value_type, unsigned endian>
   void findCodePointers(MetaAddress StartVirtualAddress,
                         const unsigned char *Start,
-                        const unsigned char *End);
+                        const unsigned char *End,
+                        const RawRangesVector &Ranges);
 
   void harvestWithAVI();
 
@@ -571,6 +638,9 @@ private:
 
   void inflateAVIWhitelist();
 
+  /// \brief Report the footprint of the data structures of this object
+  void updateMemoryGauge() const;
+
 private:
   using InstructionMap = std::map<MetaAddress, llvm::Instruction *>;
 
@@ -590,6 +660,8 @@ private:
 
   llvm::BasicBlock *Dispatcher;
   llvm::SwitchInst *DispatcherSwitch;
+  /// The jump targets reached by DispatcherSwitch
+  llvm::DenseSet<MetaAddress> DispatcherCases;
   llvm::BasicBlock *DispatcherFail;
   llvm::BasicBlock *AnyPC;
   llvm::BasicBlock *UnexpectedPC;
@@ -598,9 +670,15 @@ private:
 
   unsigned NewBranches = 0;
 
+  /// Number of full harvests (i.e., running the analyses on the whole IR)
+  unsigned HarvestRound = 0;
+
   std::set<MetaAddress> UnusedCodePointers;
   interval_set ReadIntervalSet;
 
+  /// Number of times each PC has been executed according to the profile
+  std::map<MetaAddress, uint64_t> DispatcherProfile;
+
   CFGForm::Values CurrentCFGForm;
   std::set<llvm::BasicBlock *> ToPurge;
   std::set<MetaAddress> SimpleLiterals;
@@ -608,7 +686,11 @@ private:
 
   ProgramCounterHandler *PCH;
 
-  using MetaAddressSet = std::set<MetaAddress>;
+  /// Opaque functions shared by all the harvesting rounds
+  OpaqueFunctionsRegistry OpaqueFunctions;
+
+  // Only used for membership tests and to seed order-insensitive visits
+  using MetaAddressSet = llvm::DenseSet<MetaAddress>;
   MetaAddressSet AVIJumpTargetsWhitelist;
   MetaAddressSet *JumpTargetsWhitelist;
 };
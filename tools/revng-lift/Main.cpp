@@ -6,16 +6,22 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/IR/LLVMContext.h"
@@ -25,13 +31,16 @@
 
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
+#include "revng/Support/Progress.h"
 #include "revng/Support/ResourceFinder.h"
 #include "revng/Support/Statistics.h"
 #include "revng/Support/revng.h"
 
 #include "BinaryFile.h"
 #include "CodeGenerator.h"
+#include "JumpTargetManager.h"
 #include "PTCInterface.h"
+#include "TranslationPipeline.h"
 
 PTCInterface ptc = {}; ///< The interface with the PTC library.
 
@@ -66,8 +75,84 @@ opt<unsigned long long> BaseAddress("base",
 alias A2("B", DESCRIPTION, aliasopt(BaseAddress), cat(MainCategory));
 #undef DESCRIPTION
 
-opt<string> InputPath(Positional, Required, desc("<input path>"));
-opt<string> OutputPath(Positional, Required, desc("<output path>"));
+opt<string> InputPath(Positional, desc("<input path>"));
+opt<string> OutputPath(Positional, desc("<output path>"));
+
+#define DESCRIPTION                                                         \
+  desc("lift all the binaries listed in the specified file, one line with " \
+       "\"<input path> <output path>\" each, loading libtinycode only once")
+opt<string> BatchPath("batch",
+                      DESCRIPTION,
+                      value_desc("path"),
+                      cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("with -batch, number of binaries lifted concurrently")
+opt<unsigned> Jobs("jobs",
+                   DESCRIPTION,
+                   value_desc("count"),
+                   cat(MainCategory),
+                   init(1));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                         \
+  desc("translate the lifted module in process and emit an object file to " \
+       "the specified path, instead of serializing the LLVM IR")
+opt<string> ObjectPath("object",
+                       DESCRIPTION,
+                       value_desc("path"),
+                       cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("with -object, the support module to link")
+opt<string> SupportPath("support",
+                        DESCRIPTION,
+                        value_desc("path"),
+                        cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                      \
+  desc("with -object, 0: do not optimize, 1: optimize only in the back " \
+       "end, 2: also run -O2 on the IR")
+opt<unsigned> OptimizationLevel("O",
+                                DESCRIPTION,
+                                Prefix,
+                                value_desc("level"),
+                                cat(MainCategory),
+                                init(0));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("with -object, perform function isolation")
+opt<bool> Isolate("isolate-functions", DESCRIPTION, cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                              \
+  desc("with -object, count the executions of each jump target")
+opt<bool> Coverage("coverage", DESCRIPTION, cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                           \
+  desc("with -object, the support module is the tracing one")
+opt<bool> Trace("trace", DESCRIPTION, cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                     \
+  desc("with -object, coverage CSV to use as execution profile to lay " \
+       "out the code")
+opt<string> Profile("profile",
+                    DESCRIPTION,
+                    value_desc("path"),
+                    cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                        \
+  desc("with -object, save the module as bitcode after each phase, using " \
+       "the specified prefix")
+opt<string> SaveTemps("save-temps",
+                      DESCRIPTION,
+                      value_desc("prefix"),
+                      cat(MainCategory));
+#undef DESCRIPTION
 
 } // namespace
 
@@ -148,6 +233,143 @@ static int loadPTCLibrary(LibraryPointer &PTCLibrary) {
   return EXIT_SUCCESS;
 }
 
+/// Lift \p TheBinary to \p Output, libtinycode has to be already loaded
+static int lift(BinaryFile &TheBinary, const std::string &Output) {
+  // Translate everything
+  Architecture TargetArchitecture;
+  llvm::LLVMContext Context;
+  CodeGenerator Generator(TheBinary,
+                          TargetArchitecture,
+                          Context,
+                          Output,
+                          LibHelpersPath,
+                          EarlyLinkedPath);
+
+  llvm::Optional<uint64_t> EntryPointAddressOptional;
+  if (EntryPointAddress.getNumOccurrences() != 0)
+    EntryPointAddressOptional = EntryPointAddress;
+  Generator.translate(EntryPointAddressOptional);
+
+  if (ObjectPath.empty()) {
+    Generator.serialize();
+    Progress->finish();
+    return EXIT_SUCCESS;
+  }
+
+  // Keep the module in memory up to the object file
+  revng_check(not SupportPath.empty(), "-object requires -support");
+  revng_check(OptimizationLevel <= 2, "Invalid optimization level");
+
+  TranslationOptions Options;
+  Options.SupportPath = SupportPath;
+  Options.ObjectPath = ObjectPath;
+  Options.SaveTempsPrefix = SaveTemps;
+  Options.OptimizationLevel = OptimizationLevel;
+  Options.Isolate = Isolate;
+  Options.Coverage = Coverage;
+  Options.Trace = Trace;
+  Options.ProfilePath = Profile;
+  Options.ShrinkWholeFunctions = ShrinkWholeFunctions;
+  if (not runTranslationPipeline(Generator.module(), Options))
+    return EXIT_FAILURE;
+
+  Progress->finish();
+  return EXIT_SUCCESS;
+}
+
+using BatchEntry = std::pair<std::string, std::string>;
+
+/// Parse the list of binaries to lift and where to store their output
+static bool readBatchFile(std::vector<BatchEntry> &Entries) {
+  std::ifstream BatchFile(BatchPath);
+  if (not BatchFile) {
+    fprintf(stderr, "Couldn't open %s\n", BatchPath.c_str());
+    return false;
+  }
+
+  std::string Line;
+  while (std::getline(BatchFile, Line)) {
+    std::istringstream Stream(Line);
+    BatchEntry Entry;
+
+    // Skip empty lines
+    if (not(Stream >> Entry.first))
+      continue;
+
+    if (not(Stream >> Entry.second)) {
+      fprintf(stderr, "No output path for %s\n", Entry.first.c_str());
+      return false;
+    }
+
+    Entries.push_back(std::move(Entry));
+  }
+
+  return true;
+}
+
+/// Lift each entry of the batch in a forked copy of this process
+///
+/// All the state of libtinycode is global and the guest address space it
+/// populates cannot be reset, therefore each binary needs a pristine copy of
+/// it. Forking after libtinycode has been loaded and initialized provides one
+/// without paying for it again, and lets up to -jobs binaries be lifted
+/// concurrently.
+static int liftBatch(const std::vector<BatchEntry> &Entries,
+                     llvm::StringRef ArchitectureName) {
+  std::map<pid_t, const BatchEntry *> Children;
+  unsigned Failures = 0;
+
+  auto WaitChild = [&Children, &Failures]() {
+    int Status = 0;
+    pid_t Child = wait(&Status);
+    revng_assert(Child != -1);
+
+    auto It = Children.find(Child);
+    revng_assert(It != Children.end());
+    if (not WIFEXITED(Status) or WEXITSTATUS(Status) != EXIT_SUCCESS) {
+      fprintf(stderr, "Couldn't lift %s\n", It->second->first.c_str());
+      Failures++;
+    }
+    Children.erase(It);
+  };
+
+  for (const BatchEntry &Entry : Entries) {
+    if (Children.size() >= std::max(Jobs.getValue(), 1U))
+      WaitChild();
+
+    // Do not let the children flush what's still buffered in the parent
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t Child = fork();
+    if (Child == -1) {
+      perror("Couldn't fork");
+      Failures++;
+      break;
+    }
+
+    if (Child == 0) {
+      BinaryFile TheBinary(Entry.first, BaseAddress);
+      if (TheBinary.architecture().name() != ArchitectureName) {
+        fprintf(stderr,
+                "%s is not a %s binary\n",
+                Entry.first.c_str(),
+                ArchitectureName.data());
+        exit(EXIT_FAILURE);
+      }
+
+      exit(lift(TheBinary, Entry.second));
+    }
+
+    Children[Child] = &Entry;
+  }
+
+  while (not Children.empty())
+    WaitChild();
+
+  return Failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, const char *argv[]) {
   // Enable LLVM stack trace
   llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
@@ -158,6 +380,36 @@ int main(int argc, const char *argv[]) {
 
   revng_check(BaseAddress % 4096 == 0, "Base address is not page aligned");
 
+  if (not BatchPath.empty()) {
+    revng_check(InputPath.empty() and OutputPath.empty(),
+                "-batch does not take input and output paths");
+    revng_check(ObjectPath.empty(), "-batch is incompatible with -object");
+
+    std::vector<BatchEntry> Entries;
+    if (not readBatchFile(Entries))
+      return EXIT_FAILURE;
+
+    if (Entries.empty())
+      return EXIT_SUCCESS;
+
+    // All the binaries of a batch share the libtinycode of the first one
+    std::string ArchitectureName;
+    {
+      BinaryFile FirstBinary(Entries[0].first, BaseAddress);
+      ArchitectureName = FirstBinary.architecture().name();
+    }
+    findFiles(ArchitectureName.c_str());
+
+    LibraryPointer PTCLibrary;
+    if (loadPTCLibrary(PTCLibrary) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+
+    return liftBatch(Entries, ArchitectureName);
+  }
+
+  revng_check(not InputPath.empty() and not OutputPath.empty(),
+              "An input and an output path are required");
+
   BinaryFile TheBinary(InputPath, BaseAddress);
 
   findFiles(TheBinary.architecture().name());
@@ -167,21 +419,5 @@ int main(int argc, const char *argv[]) {
   if (loadPTCLibrary(PTCLibrary) != EXIT_SUCCESS)
     return EXIT_FAILURE;
 
-  // Translate everything
-  Architecture TargetArchitecture;
-  llvm::LLVMContext Context;
-  CodeGenerator Generator(TheBinary,
-                          TargetArchitecture,
-                          Context,
-                          std::string(OutputPath),
-                          LibHelpersPath,
-                          EarlyLinkedPath);
-
-  llvm::Optional<uint64_t> EntryPointAddressOptional;
-  if (EntryPointAddress.getNumOccurrences() != 0)
-    EntryPointAddressOptional = EntryPointAddress;
-  Generator.translate(EntryPointAddressOptional);
-  Generator.serialize();
-
-  return EXIT_SUCCESS;
+  return lift(TheBinary, OutputPath);
 }
@@ -0,0 +1,53 @@
+/// \file OriginalInstructionsTable.cpp
+/// \brief Side table of the disassembly of the original instructions
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <limits>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Support/Assert.h"
+
+#include "OriginalInstructionsTable.h"
+
+uint32_t OriginalInstructionsTable::record(MetaAddress Address,
+                                           uint64_t Size,
+                                           std::string Disassembly) {
+  auto It = Indices.find(Address);
+  if (It != Indices.end())
+    return It->second;
+
+  revng_assert(Entries.size() < std::numeric_limits<uint32_t>::max());
+  uint32_t Index = Entries.size();
+  Entries.push_back({ Address, Size, std::move(Disassembly) });
+  Indices[Address] = Index;
+
+  return Index;
+}
+
+void OriginalInstructionsTable::serialize(std::ostream &Output) const {
+  Output << "index,address,size,disassembly\n";
+
+  MetaAddress::StringBuffer Buffer;
+  for (auto &[Address, Index] : Indices) {
+    const Entry &E = Entries[Index];
+    llvm::StringRef AddressString = Address.toString(Buffer);
+    Output << Index << ",";
+    Output.write(AddressString.data(), AddressString.size());
+    Output << "," << E.Size << ",\"";
+
+    // Quote the disassembly, it might contain commas and new lines
+    llvm::StringRef Disassembly(E.Disassembly);
+    Disassembly = Disassembly.rtrim('\n');
+    for (char C : Disassembly) {
+      if (C == '"')
+        Output << '"';
+      Output << C;
+    }
+
+    Output << "\"\n";
+  }
+}
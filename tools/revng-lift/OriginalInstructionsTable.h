@@ -0,0 +1,51 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "revng/Support/MetaAddress.h"
+
+/// \brief Side table of the original instructions
+///
+/// By default, each translated instruction carries an `oi` metadata node
+/// referencing a global string with the disassembly of the original
+/// instruction and its address, and the string is also passed to `newpc`. On
+/// large binaries this accounts for a large share of the module.
+///
+/// When this table is employed, the disassembly is recorded here, the `oi`
+/// metadata only contains the index of the entry (`!{i32 Index}`) and `newpc`
+/// receives a null pointer. The table is then serialized as a CSV with one
+/// line per original instruction, ordered by address.
+class OriginalInstructionsTable {
+public:
+  struct Entry {
+    MetaAddress Address;
+    uint64_t Size;
+    std::string Disassembly;
+  };
+
+public:
+  /// \brief Record an original instruction, unless already present
+  ///
+  /// \return the index of the entry associated to \p Address.
+  uint32_t record(MetaAddress Address, uint64_t Size, std::string Disassembly);
+
+  const Entry &get(uint32_t Index) const { return Entries.at(Index); }
+
+  size_t size() const { return Entries.size(); }
+
+  /// \brief Write the table as a CSV with the `index,address,size,disassembly`
+  ///        columns
+  void serialize(std::ostream &Output) const;
+
+private:
+  std::vector<Entry> Entries;
+  std::map<MetaAddress, uint32_t> Indices;
+};
@@ -11,37 +11,106 @@
 #include <cstring>
 #include <iostream>
 
+#include "llvm/Support/LEB128.h"
+
 #include "revng/Support/Assert.h"
 
 #include "PTCDump.h"
 
 #include "PTCInterface.h"
 
-static const int MAX_TEMP_NAME_LENGTH = 128;
+namespace {
+
+/// \brief Sink for dumpInstructionTo producing the textual dump
+class TextSink {
+private:
+  std::ostream &Result;
+
+public:
+  TextSink(std::ostream &Result) : Result(Result) {}
+
+public:
+  void string(const char *String) { Result << String; }
+  void hex() { Result << std::hex; }
+  void dec() { Result << std::dec; }
+  void number(uint64_t Value) { Result << Value; }
+  void local(unsigned Index) { Result << "loc" << std::to_string(Index); }
+  void temporary(unsigned Index) { Result << "tmp" << std::to_string(Index); }
+  void instructionStart(MetaAddress PC) { disassemble(Result, PC, 4096, 1); }
+  void endLine() { Result << std::endl; }
+};
+
+/// \brief Sink for dumpInstructionTo producing the binary dump
+///
+/// Strings are expected to be static (e.g., the names of opcodes and helpers),
+/// they are written once and then referenced by index.
+class BinarySink {
+private:
+  llvm::raw_ostream &Output;
+  llvm::DenseMap<const char *, unsigned> &Strings;
+  bool Hex = false;
+
+public:
+  BinarySink(llvm::raw_ostream &Output,
+             llvm::DenseMap<const char *, unsigned> &Strings) :
+    Output(Output), Strings(Strings) {}
+
+public:
+  void string(const char *String) {
+    auto [It, New] = Strings.try_emplace(String, Strings.size());
+    if (New) {
+      size_t Length = strlen(String);
+      Output << static_cast<char>(PTCDumpRecord::StringDefinition);
+      llvm::encodeULEB128(It->second, Output);
+      llvm::encodeULEB128(Length, Output);
+      Output.write(String, Length);
+    }
 
-static void getTemporaryName(char *Buffer,
-                             size_t BufferSize,
-                             PTCInstructionList *Instructions,
-                             unsigned TemporaryId) {
+    emit(PTCDumpRecord::String, It->second);
+  }
+
+  void hex() { Hex = true; }
+  void dec() { Hex = false; }
+
+  void number(uint64_t Value) {
+    emit(Hex ? PTCDumpRecord::Hex : PTCDumpRecord::Decimal, Value);
+  }
+
+  void local(unsigned Index) { emit(PTCDumpRecord::Local, Index); }
+  void temporary(unsigned Index) { emit(PTCDumpRecord::Temporary, Index); }
+
+  // Disassembling is too expensive for this mode
+  void instructionStart(MetaAddress PC) {}
+
+  void endLine() { Output << static_cast<char>(PTCDumpRecord::EndLine); }
+
+private:
+  void emit(PTCDumpRecord::Values Record, uint64_t Value) {
+    Output << static_cast<char>(Record);
+    llvm::encodeULEB128(Value, Output);
+  }
+};
+
+} // namespace
+
+template<typename Sink>
+static void dumpTemporary(Sink &Result,
+                          PTCInstructionList *Instructions,
+                          unsigned TemporaryId) {
   PTCTemp *Temporary = ptc_temp_get(Instructions, TemporaryId);
 
   if (ptc_temp_is_global(Instructions, TemporaryId))
-    strncpy(Buffer, Temporary->name, BufferSize);
+    Result.string(Temporary->name);
   else if (Temporary->temp_local)
-    snprintf(Buffer,
-             BufferSize,
-             "loc%u",
-             TemporaryId - Instructions->global_temps);
+    Result.local(TemporaryId - Instructions->global_temps);
   else
-    snprintf(Buffer,
-             BufferSize,
-             "tmp%u",
-             TemporaryId - Instructions->global_temps);
+    Result.temporary(TemporaryId - Instructions->global_temps);
 }
 
-int dumpInstruction(std::ostream &Result,
-                    PTCInstructionList *Instructions,
-                    unsigned Index) {
+template<typename Sink>
+static int dumpInstructionTo(Sink &Result,
+                             PTCInstructionList *Instructions,
+                             unsigned Index) {
   size_t i = 0;
   // TODO: this should stay in Architecture
   int is64 = 0;
@@ -49,7 +118,6 @@ int dumpInstruction(std::ostream &Result,
 
   PTCOpcode Opcode = Instruction.opc;
   PTCOpcodeDef *Definition = ptc_instruction_opcode_def(&ptc, &Instruction);
-  char TemporaryName[MAX_TEMP_NAME_LENGTH + 1] = { '\0' };
 
   if (Opcode == PTC_INSTRUCTION_op_debug_insn_start) {
     // TODO: create accessors for PTC_INSTRUCTION_op_debug_insn_start
@@ -58,7 +126,10 @@ int dumpInstruction(std::ostream &Result,
     if (is64)
       PC |= Instruction.args[1] << 32;
 
-    Result << " ---- 0x" << std::hex << PC << std::endl;
+    Result.string(" ---- 0x");
+    Result.hex();
+    Result.number(PC);
+    Result.endLine();
   } else if (Opcode == PTC_INSTRUCTION_op_call) {
     // TODO: replace PRIx64 with PTC_PRIxARG
     PTCInstructionArg FunctionPointer = 0;
@@ -76,16 +147,22 @@ int dumpInstruction(std::ostream &Result,
 
     // The output format is:
     // call name, flags, out_args_count, out_args [...], in_args [...]
-    Result << Definition->name << " " << HelperName << ","
-           << "$0x" << std::hex << Flags << "," << std::dec << OutArgsCount;
+    Result.string(Definition->name);
+    Result.string(" ");
+    Result.string(HelperName);
+    Result.string(",$0x");
+    Result.hex();
+    Result.number(Flags);
+    Result.string(",");
+    Result.dec();
+    Result.number(OutArgsCount);
 
     // Print out arguments
     for (i = 0; i < OutArgsCount; i++) {
-      getTemporaryName(TemporaryName,
-                       MAX_TEMP_NAME_LENGTH,
-                       Instructions,
-                       ptc_call_instruction_out_arg(&ptc, &Instruction, i));
-      Result << "," << TemporaryName;
+      Result.string(",");
+      dumpTemporary(Result,
+                    Instructions,
+                    ptc_call_instruction_out_arg(&ptc, &Instruction, i));
     }
 
     // Print in arguments
@@ -96,49 +173,43 @@ int dumpInstruction(std::ostream &Result,
                                                             i);
 
       if (InArg != PTC_CALL_DUMMY_ARG) {
-        getTemporaryName(TemporaryName,
-                         MAX_TEMP_NAME_LENGTH,
-                         Instructions,
-                         InArg);
-        Result << "," << TemporaryName;
+        Result.string(",");
+        dumpTemporary(Result, Instructions, InArg);
       } else {
-        Result << ",<dummy>";
+        Result.string(",<dummy>");
       }
     }
 
   } else {
     // TODO: fix commas
-    Result << Definition->name << " ";
+    Result.string(Definition->name);
+    Result.string(" ");
 
     // Print out arguments
     for (i = 0; i < ptc_instruction_out_arg_count(&ptc, &Instruction); i++) {
       if (i != 0)
-        Result << ",";
+        Result.string(",");
 
-      getTemporaryName(TemporaryName,
-                       MAX_TEMP_NAME_LENGTH,
-                       Instructions,
-                       ptc_instruction_out_arg(&ptc, &Instruction, i));
-      Result << TemporaryName;
+      dumpTemporary(Result,
+                    Instructions,
+                    ptc_instruction_out_arg(&ptc, &Instruction, i));
     }
 
     if (i != 0)
-      Result << ",";
+      Result.string(",");
 
     // Print in arguments
     for (i = 0; i < ptc_instruction_in_arg_count(&ptc, &Instruction); i++) {
       if (i != 0)
-        Result << ",";
+        Result.string(",");
 
-      getTemporaryName(TemporaryName,
-                       MAX_TEMP_NAME_LENGTH,
-                       Instructions,
-                       ptc_instruction_in_arg(&ptc, &Instruction, i));
-      Result << TemporaryName;
+      dumpTemporary(Result,
+                    Instructions,
+                    ptc_instruction_in_arg(&ptc, &Instruction, i));
     }
 
     if (i != 0)
-      Result << ",";
+      Result.string(",");
 
     /* Parse some special const arguments */
     i = 0;
@@ -155,11 +226,14 @@ int dumpInstruction(std::ostream &Result,
       PTCCondition ConditionId = static_cast<PTCCondition>(Arg);
       const char *ConditionName = ptc.get_condition_name(ConditionId);
 
-      if (ConditionName != nullptr)
-        Result << "," << ConditionName;
-      else
-        Result << ","
-               << "$0x" << std::hex << Arg;
+      if (ConditionName != nullptr) {
+        Result.string(",");
+        Result.string(ConditionName);
+      } else {
+        Result.string(",$0x");
+        Result.hex();
+        Result.number(Arg);
+      }
 
       /* Consume one argument */
       i++;
@@ -173,10 +247,11 @@ int dumpInstruction(std::ostream &Result,
       PTCLoadStoreArg LoadStoreArg = {};
       LoadStoreArg = ptc.parse_load_store_arg(Arg);
 
-      if (LoadStoreArg.access_type == PTC_MEMORY_ACCESS_UNKNOWN)
-        Result << ","
-               << "$0x" << std::hex << LoadStoreArg.raw_op;
-      else {
+      if (LoadStoreArg.access_type == PTC_MEMORY_ACCESS_UNKNOWN) {
+        Result.string(",$0x");
+        Result.hex();
+        Result.number(LoadStoreArg.raw_op);
+      } else {
         const char *Alignment = nullptr;
         const char *LoadStoreName = nullptr;
         LoadStoreName = ptc.get_load_store_name(LoadStoreArg.type);
@@ -198,10 +273,13 @@ int dumpInstruction(std::ostream &Result,
         if (LoadStoreName == nullptr)
           return EXIT_FAILURE;
 
-        Result << "," << Alignment << LoadStoreName;
+        Result.string(",");
+        Result.string(Alignment);
+        Result.string(LoadStoreName);
       }
 
-      Result << "," << LoadStoreArg.mmu_index;
+      Result.string(",");
+      Result.number(LoadStoreArg.mmu_index);
 
       /* Consume one argument */
       i++;
@@ -218,8 +296,8 @@ int dumpInstruction(std::ostream &Result,
     case PTC_INSTRUCTION_op_brcond_i64:
     case PTC_INSTRUCTION_op_brcond2_i32: {
       PTCInstructionArg Arg = ptc_instruction_const_arg(&ptc, &Instruction, i);
-      Result << ","
-             << "$L" << ptc.get_arg_label_id(Arg);
+      Result.string(",$L");
+      Result.number(ptc.get_arg_label_id(Arg));
 
       /* Consume one more argument */
       i++;
@@ -232,17 +310,25 @@ int dumpInstruction(std::ostream &Result,
     /* Print remaining const arguments */
     for (; i < ptc_instruction_const_arg_count(&ptc, &Instruction); i++) {
       if (i != 0) {
-        Result << ",";
+        Result.string(",");
       }
 
-      Result << "$0x" << std::hex
-             << ptc_instruction_const_arg(&ptc, &Instruction, i);
+      Result.string("$0x");
+      Result.hex();
+      Result.number(ptc_instruction_const_arg(&ptc, &Instruction, i));
     }
   }
 
   return EXIT_SUCCESS;
 }
 
+int dumpInstruction(std::ostream &Result,
+                    PTCInstructionList *Instructions,
+                    unsigned Index) {
+  TextSink Sink(Result);
+  return dumpInstructionTo(Sink, Instructions, Index);
+}
+
 void disassemble(std::ostream &Result,
                  MetaAddress PC,
                  uint32_t MaxBytes,
@@ -266,9 +352,10 @@ void disassemble(std::ostream &Result,
   free(BufferPtr);
 }
 
-int dumpTranslation(MetaAddress VirtualAddress,
-                    std::ostream &Result,
-                    PTCInstructionList *Instructions) {
+template<typename Sink>
+static int dumpTranslationTo(MetaAddress VirtualAddress,
+                             Sink &Result,
+                             PTCInstructionList *Instructions) {
   // TODO: this should stay in Architecture
   int is64 = 0;
 
@@ -282,16 +369,51 @@ int dumpTranslation(MetaAddress VirtualAddress,
       if (is64)
         PC |= Instruction.args[1] << 32;
 
-      disassemble(Result, VirtualAddress.replaceAddress(PC), 4096, 1);
+      Result.instructionStart(VirtualAddress.replaceAddress(PC));
     }
 
-    Result << std::dec << Index << ": ";
+    Result.dec();
+    Result.number(Index);
+    Result.string(": ");
 
-    if (dumpInstruction(Result, Instructions, Index) == EXIT_FAILURE)
+    if (dumpInstructionTo(Result, Instructions, Index) == EXIT_FAILURE)
       return EXIT_FAILURE;
 
-    Result << std::endl;
+    Result.endLine();
   }
 
   return EXIT_SUCCESS;
 }
+
+int dumpTranslation(MetaAddress VirtualAddress,
+                    std::ostream &Result,
+                    PTCInstructionList *Instructions) {
+  TextSink Sink(Result);
+  return dumpTranslationTo(VirtualAddress, Sink, Instructions);
+}
+
+BinaryPTCDumper::BinaryPTCDumper(llvm::StringRef Path) {
+  std::error_code EC;
+  Output = std::make_unique<llvm::raw_fd_ostream>(Path, EC);
+  revng_check(not EC, "Cannot open the PTC dump file");
+  Output->SetBufferSize(1 << 20);
+  Output->write(PTCDumpMagic, sizeof(PTCDumpMagic) - 1);
+}
+
+int BinaryPTCDumper::dumpTranslation(MetaAddress VirtualAddress,
+                                     PTCInstructionList *Instructions) {
+  *Output << static_cast<char>(PTCDumpRecord::Translation);
+  llvm::encodeULEB128(VirtualAddress.address(), *Output);
+  llvm::encodeULEB128(VirtualAddress.type(), *Output);
+  llvm::encodeULEB128(VirtualAddress.epoch(), *Output);
+  llvm::encodeULEB128(VirtualAddress.addressSpace(), *Output);
+
+  BinarySink Sink(*Output, Strings);
+  int Result = dumpTranslationTo(VirtualAddress, Sink, Instructions);
+
+  // Terminate the partial line, so that the rest of the dump stays readable
+  if (Result != EXIT_SUCCESS)
+    Sink.endLine();
+
+  return Result;
+}
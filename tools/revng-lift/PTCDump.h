@@ -6,6 +6,10 @@
 
 #include <cstdint>
 #include <iostream>
+#include <memory>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/MetaAddress.h"
 
@@ -44,3 +48,54 @@ void disassemble(std::ostream &Result,
                  MetaAddress PC,
                  uint32_t MaxBytes = 4096,
                  uint32_t InstructionCount = 4096);
+
+/// The first bytes of a binary PTC dump (including the format version)
+constexpr const char PTCDumpMagic[] = "REVNGPTC1";
+
+namespace PTCDumpRecord {
+
+/// \brief Kinds of records of a binary PTC dump
+///
+/// Each record is a byte identifying its kind followed by its operands, encoded
+/// as ULEB128. Concatenating the records of a translation gives its textual
+/// dump, as produced by dumpTranslation (without the disassembly).
+enum Values : uint8_t {
+  /// End of the current line
+  EndLine,
+  /// Define a string: index, length and the characters
+  StringDefinition,
+  /// A previously defined string: the index
+  String,
+  /// A local temporary: the index (printed as locN)
+  Local,
+  /// A temporary: the index (printed as tmpN)
+  Temporary,
+  /// A number to print in hexadecimal
+  Hex,
+  /// A number to print in decimal
+  Decimal,
+  /// Start of a translation: address, type, epoch and address space
+  Translation
+};
+
+} // namespace PTCDumpRecord
+
+/// \brief Writes the instruction lists in a compact binary format
+///
+/// This is much cheaper than producing the textual dump, since there's no
+/// formatting involved, and the output is buffered. The dump can be turned
+/// into text offline by revng-decode-ptc-dump.
+class BinaryPTCDumper {
+private:
+  std::unique_ptr<llvm::raw_fd_ostream> Output;
+  llvm::DenseMap<const char *, unsigned> Strings;
+
+public:
+  BinaryPTCDumper(llvm::StringRef Path);
+
+  /// \return EXIT_SUCCESS in case of success, EXIT_FAILURE otherwise. In the
+  ///         latter case, the dump of the translation stops at the instruction
+  ///         that couldn't be dumped.
+  int dumpTranslation(MetaAddress VirtualAddress,
+                      PTCInstructionList *Instructions);
+};
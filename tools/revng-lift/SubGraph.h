@@ -4,10 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include "llvm/ADT/GraphTraits.h"
-#include "llvm/ADT/SmallVector.h"
+#include <set>
+#include <vector>
 
-#include "revng/ADT/Queue.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/iterator.h"
 
 /// \brief Data structure implementing a subgraph of an object providing
 ///        GraphTraits
@@ -16,19 +19,19 @@
 /// GraphTraits, this class expose a portion of the graph (identified by a
 /// whitelist of nodes). The main benefit of such a class is to be able to run
 /// graph-oriented algorithms on portion of a graph.
+///
+/// The subgraph is a view: the successors of a node are the successors of the
+/// underlying node, filtered on the fly against the whitelist.
 template<typename InnerNodeType>
 class SubGraph {
 public:
   /// \brief A node of the subgraph
   ///
-  /// A node is simply a reference to the original node decorated with a vector
-  /// of successor. In theory we could avoid storing the vector and explore the
-  /// successors directly of the underlying node (filtering out all the
-  /// non-whitelisted ones), but this would require a reference to the graph
-  /// object, which is something we'd like to avoid.
+  /// A node is simply a reference to the original node decorated with a
+  /// reference to the subgraph, which is required to filter its successors.
   class Node {
   public:
-    Node(InnerNodeType Value) : Value(Value) {}
+    Node(InnerNodeType Value, SubGraph *Graph) : Value(Value), Graph(Graph) {}
 
     /// \brief Return the underlying node
     InnerNodeType get() const { return Value; }
@@ -37,15 +40,40 @@ public:
     friend class SubGraph;
     friend struct llvm::GraphTraits<SubGraph<InnerNodeType>>;
 
-    llvm::SmallVector<Node *, 2> Children;
     InnerNodeType Value;
+    SubGraph *Graph;
   };
   using NodeType = Node;
 
 private:
   using ParentGraphTraits = llvm::GraphTraits<InnerNodeType>;
-  using ChildIteratorType = typename llvm::SmallVector<Node *, 2>::iterator;
-  using nodes_iterator = typename std::set<Node>::iterator;
+
+  struct IsWhitelisted {
+    const SubGraph *Graph;
+    bool operator()(InnerNodeType Value) const {
+      return Graph->Indices.count(Value) != 0;
+    }
+  };
+
+  struct ToNode {
+    SubGraph *Graph;
+    Node *operator()(InnerNodeType Value) const {
+      return &Graph->Nodes[Graph->Indices.find(Value)->second];
+    }
+  };
+
+  static auto successors(Node *Parent) {
+    InnerNodeType Value = Parent->Value;
+    auto Successors = llvm::make_range(ParentGraphTraits::child_begin(Value),
+                                       ParentGraphTraits::child_end(Value));
+    auto Filtered = llvm::make_filter_range(Successors,
+                                            IsWhitelisted{ Parent->Graph });
+    return llvm::map_range(Filtered, ToNode{ Parent->Graph });
+  }
+
+  using ChildIteratorType = decltype(successors(nullptr).begin());
+  using nodes_iterator = llvm::pointer_iterator<
+    typename std::vector<Node>::iterator>;
 
   friend llvm::GraphTraits<SubGraph<InnerNodeType>>;
 
@@ -53,62 +81,34 @@ public:
   /// Construct a subgraph starting from the node \p Entry and considering only
   /// nodes in \p WhiteList.
   ///
-  /// Note: this method has a cost proportional to the size of the subgraph,
-  /// since it basically creates a copy of it.
-  SubGraph(InnerNodeType Entry, const std::set<InnerNodeType> WhiteList) {
-    // Create a node for the entry node, and take note of it
-    EntryNode = &findOrInsert(Entry);
-
-    // We want to rebuild the graph internally considering only the whitelisted
-    // nodes
-    OnceQueue<InnerNodeType> Queue;
-    Queue.insert(Entry);
-
-    while (!Queue.empty()) {
-      InnerNodeType Value = Queue.pop();
-
-      // Get (or create) the current node
-      Node &NewNode = findOrInsert(Value);
-
-      // Iterate over successors
-      auto Successors = make_range(ParentGraphTraits::child_begin(Value),
-                                   ParentGraphTraits::child_end(Value));
-      for (InnerNodeType Successor : Successors) {
-        // If it's whitelisted, register it as a child and enqueue it
-        if (WhiteList.count(Successor) != 0) {
-          NewNode.Children.push_back(&findOrInsert(Successor));
-          Queue.insert(Successor);
-        }
-      }
-    }
+  /// Note: this method has a cost proportional to the size of \p WhiteList,
+  ///       visiting the subgraph allocates no memory, but the nodes of the
+  ///       subgraph include all the whitelisted nodes, even the ones not
+  ///       reachable from \p Entry.
+  SubGraph(InnerNodeType Entry, const std::set<InnerNodeType> &WhiteList) {
+    Nodes.reserve(WhiteList.size() + 1);
+    Indices.reserve(WhiteList.size() + 1);
+
+    auto Insert = [this](InnerNodeType Value) {
+      if (Indices.try_emplace(Value, Nodes.size()).second)
+        Nodes.emplace_back(Value, this);
+    };
+
+    // The entry node is always part of the subgraph
+    Insert(Entry);
+    for (InnerNodeType Value : WhiteList)
+      Insert(Value);
+
+    EntryNode = &Nodes.front();
   }
 
-private:
-  struct CompareNodes {
-    bool operator()(const Node &A, const Node &B) const {
-      return A.get() < B.get();
-    }
-  };
-
-  /// \brief Get the node with value \p Value, of, if absent, insert it in the
-  ///        graph
-  Node &findOrInsert(InnerNodeType Value) {
-    // We can't use find, because it would use the equality comparison operator
-    // instead of our CompareNodes. Plus we have to cast away constness, because
-    // std::set entries are always const (since you might change the key), but
-    // we don't. Users of this function will never change the key, just
-    // increment the list of successors.
-    auto It = Nodes.lower_bound(Node(Value));
-    if (It != Nodes.end() && It->get() == Value)
-      return const_cast<Node &>(*It);
-    else
-      return const_cast<Node &>(*Nodes.emplace_hint(It, Value));
-  }
+  // Nodes point to the subgraph
+  SubGraph(const SubGraph &) = delete;
+  SubGraph &operator=(const SubGraph &) = delete;
 
 private:
-  // We define a custom comparator so that Node still preserves the default
-  // comparison operators
-  std::set<Node, CompareNodes> Nodes;
+  std::vector<Node> Nodes;
+  llvm::DenseMap<InnerNodeType, unsigned> Indices;
   Node *EntryNode;
 };
 
@@ -122,20 +122,23 @@ struct GraphTraits<SubGraph<InnerNodeType>> {
   using ChildIteratorType = typename GraphType::ChildIteratorType;
   using nodes_iterator = typename GraphType::nodes_iterator;
 
-  // TODO: here G should be const
-  static NodeRef getEntryNode(GraphType &G) { return G.EntryNode; }
+  static NodeRef getEntryNode(const GraphType &G) { return G.EntryNode; }
 
   static ChildIteratorType child_begin(NodeRef Parent) {
-    return Parent->Children.begin();
+    return GraphType::successors(Parent).begin();
   }
 
   static ChildIteratorType child_end(NodeRef Parent) {
-    return Parent->Children.end();
+    return GraphType::successors(Parent).end();
   }
 
-  static nodes_iterator nodes_begin(GraphType *G) { return G->Nodes.begin(); }
+  static nodes_iterator nodes_begin(GraphType *G) {
+    return nodes_iterator(G->Nodes.begin());
+  }
 
-  static nodes_iterator nodes_end(GraphType *G) { return G->Nodes.end(); }
+  static nodes_iterator nodes_end(GraphType *G) {
+    return nodes_iterator(G->Nodes.end());
+  }
 
   static unsigned size(GraphType *G) { return G->Nodes.size(); }
 };
@@ -0,0 +1,323 @@
+/// \file TranslationPipeline.cpp
+/// \brief Compile the lifted module to an object file in the revng-lift process
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <string>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Scalar.h"
+
+#include "revng/BasicAnalyses/ApplyProfile.h"
+#include "revng/BasicAnalyses/CSVAliasScopes.h"
+#include "revng/BasicAnalyses/DeadCSVStoreElimination.h"
+#include "revng/BasicAnalyses/DropNewPCCalls.h"
+#include "revng/BasicAnalyses/GuestMemoryIdioms.h"
+#include "revng/BasicAnalyses/InstrumentCoverage.h"
+#include "revng/BasicAnalyses/ShrinkInstructionOperandsPass.h"
+#include "revng/FunctionIsolation/IsolateFunctions.h"
+#include "revng/FunctionIsolation/PromoteStackSlots.h"
+#include "revng/StackAnalysis/FunctionBoundariesDetectionPass.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/Progress.h"
+#include "revng/Support/Statistics.h"
+
+#include "TranslationPipeline.h"
+
+using namespace llvm;
+
+static Logger<> PipelineLog("translation-pipeline");
+
+template<typename T>
+static cl::opt<T> *
+getOption(StringMap<cl::Option *> &Options, const char *Name) {
+  auto It = Options.find(Name);
+  revng_assert(It != Options.end(), "Unknown option");
+  return static_cast<cl::opt<T> *>(It->second);
+}
+
+/// \brief Serialize \p M as bitcode, if intermediate results have been
+///        requested
+static bool
+saveTemp(Module &M, const TranslationOptions &Options, const char *Phase) {
+  if (Options.SaveTempsPrefix.empty())
+    return true;
+
+  return writeBitcode(M, Options.SaveTempsPrefix + "." + Phase + ".bc");
+}
+
+bool writeBitcode(const Module &M, StringRef Path) {
+  // raw_fd_stream lets the writer flush and then seek back to patch the size
+  // of the blocks, which requires a regular file
+  std::error_code EC;
+  std::unique_ptr<raw_fd_ostream> Output;
+  if (Path == "-")
+    Output = std::make_unique<raw_fd_ostream>(Path, EC, sys::fs::OF_None);
+  else
+    Output = std::make_unique<raw_fd_stream>(Path, EC);
+
+  if (EC) {
+    errs() << "Couldn't open " << Path << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  WriteBitcodeToFile(M, *Output);
+  Output->flush();
+  if (Output->has_error()) {
+    errs() << "Couldn't write " << Path << ": " << Output->error().message()
+           << "\n";
+    Output->clear_error();
+    return false;
+  }
+
+  return true;
+}
+
+/// \brief Create a TargetMachine for the triple of \p M, or for the host if
+///        the module has none
+static std::unique_ptr<TargetMachine>
+createTargetMachine(Module &M, unsigned OptimizationLevel) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+
+  std::string TripleName = M.getTargetTriple();
+  if (TripleName.empty())
+    TripleName = sys::getDefaultTargetTriple();
+
+  std::string Error;
+  const Target *TheTarget = TargetRegistry::lookupTarget(TripleName, Error);
+  if (TheTarget == nullptr) {
+    errs() << "Couldn't find a target for " << TripleName << ": " << Error
+           << "\n";
+    return nullptr;
+  }
+
+  // Same as llc -O0 and llc -O2
+  auto Level = OptimizationLevel == 0 ? CodeGenOpt::None : CodeGenOpt::Default;
+  std::unique_ptr<TargetMachine> Result;
+  Result.reset(TheTarget->createTargetMachine(TripleName,
+                                              "",
+                                              "",
+                                              TargetOptions(),
+                                              None,
+                                              None,
+                                              Level));
+  if (Result == nullptr) {
+    errs() << "Couldn't create the target machine for " << TripleName << "\n";
+    return nullptr;
+  }
+
+  M.setTargetTriple(TripleName);
+  M.setDataLayout(Result->createDataLayout());
+
+  return Result;
+}
+
+/// \brief Run the equivalent of `opt -O2` on \p M
+///
+/// \param SplitCold outline the cold code, as opt -hot-cold-split.
+static void optimize(Module &M, TargetMachine &TM, bool SplitCold) {
+  // Same as opt -enable-pre=false -enable-load-pre=false
+  StringMap<cl::Option *> &Options(cl::getRegisteredOptions());
+  getOption<bool>(Options, "enable-pre")->setValue(false);
+  getOption<bool>(Options, "enable-load-pre")->setValue(false);
+  getOption<bool>(Options, "hot-cold-split")->setValue(SplitCold);
+
+  Triple TheTriple(M.getTargetTriple());
+
+  PassManagerBuilder Builder;
+  Builder.OptLevel = 2;
+  Builder.SizeLevel = 0;
+  Builder.Inliner = createFunctionInliningPass(2, 0, false);
+  Builder.LibraryInfo = new TargetLibraryInfoImpl(TheTriple);
+  TM.adjustPassManager(Builder);
+
+  // Once the loops are canonical, turn the ones filling or copying guest
+  // memory into memset/memmove and drop what's left of them
+  auto AddIdioms = [](const PassManagerBuilder &, legacy::PassManagerBase &PM) {
+    PM.add(new GuestMemoryIdioms());
+    PM.add(createLoopDeletionPass());
+  };
+  Builder.addExtension(PassManagerBuilder::EP_ScalarOptimizerLate, AddIdioms);
+
+  TargetIRAnalysis TargetAnalysis = TM.getTargetIRAnalysis();
+
+  legacy::FunctionPassManager FunctionPasses(&M);
+  FunctionPasses.add(createTargetTransformInfoWrapperPass(TargetAnalysis));
+  Builder.populateFunctionPassManager(FunctionPasses);
+
+  legacy::PassManager ModulePasses;
+  ModulePasses.add(createTargetTransformInfoWrapperPass(TargetAnalysis));
+  Builder.populateModulePassManager(ModulePasses);
+
+  FunctionPasses.doInitialization();
+  for (Function &F : M)
+    FunctionPasses.run(F);
+  FunctionPasses.doFinalization();
+
+  ModulePasses.run(M);
+}
+
+/// \brief Run the equivalent of `llc -filetype=obj -disable-machine-licm`
+static bool emitObject(Module &M, TargetMachine &TM, const std::string &Path) {
+  StringMap<cl::Option *> &Options(cl::getRegisteredOptions());
+  getOption<bool>(Options, "disable-machine-licm")->setValue(true);
+
+  std::error_code EC;
+  ToolOutputFile Output(Path, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "Couldn't open " << Path << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  legacy::PassManager CodeGenPasses;
+  Triple TheTriple(M.getTargetTriple());
+  CodeGenPasses.add(new TargetLibraryInfoWrapperPass(TheTriple));
+  if (TM.addPassesToEmitFile(CodeGenPasses,
+                             Output.os(),
+                             nullptr,
+                             CGFT_ObjectFile)) {
+    errs() << "The target can't emit object files\n";
+    return false;
+  }
+
+  CodeGenPasses.run(M);
+  Output.keep();
+
+  return true;
+}
+
+bool runTranslationPipeline(Module &M, const TranslationOptions &Options) {
+  revng_assert(Options.OptimizationLevel <= 2);
+
+  ScopedTimer Timer("translation-pipeline");
+
+  if (not saveTemp(M, Options, "lifted"))
+    return false;
+
+  {
+    ScopedTimer IsolationTimer("isolate");
+    Progress->setPhase("isolate");
+    legacy::PassManager PM;
+
+    // Instrument jump targets with coverage counters
+    if (Options.Coverage)
+      PM.add(new InstrumentCoverage());
+
+    // Perform function isolation
+    if (Options.Isolate) {
+      PM.add(new StackAnalysis::FunctionBoundariesDetectionPass());
+      PM.add(new IsolateFunctions());
+    }
+
+    // Apply the execution profile, while the jump targets still have newpc
+    if (not Options.ProfilePath.empty())
+      PM.add(new ApplyProfile(Options.ProfilePath));
+
+    // Without tracing, newpc has an empty body. -O2 inlines it, otherwise drop
+    // the calls so that they don't split the code at each instruction.
+    if (not Options.Trace and Options.OptimizationLevel < 2)
+      PM.add(new DropNewPCCalls());
+
+    // Promote the private stack slots of isolated functions, drop the stores
+    // to dead CSVs (e.g., flags) and tell -O2 that CSVs, guest memory and
+    // helpers don't alias
+    if (Options.OptimizationLevel == 2) {
+      if (Options.Isolate)
+        PM.add(new PromoteStackSlots());
+      PM.add(new DeadCSVStoreElimination());
+      PM.add(new CSVAliasScopes());
+      if (Options.ShrinkWholeFunctions)
+        PM.add(new ShrinkToDemandedBitsPass());
+    }
+
+    PM.run(M);
+  }
+
+  if (Options.Isolate and not saveTemp(M, Options, "isolated"))
+    return false;
+
+  {
+    ScopedTimer LinkTimer("link");
+    SMDiagnostic Diagnostic;
+    std::unique_ptr<Module> Support = parseIRFile(Options.SupportPath,
+                                                  Diagnostic,
+                                                  M.getContext());
+    if (Support == nullptr) {
+      Diagnostic.print("revng-lift", errs());
+      return false;
+    }
+
+    if (Linker::linkModules(M, std::move(Support))) {
+      errs() << "Couldn't link " << Options.SupportPath << "\n";
+      return false;
+    }
+  }
+
+  // -O2 drops the unreferenced globals by itself, otherwise the helpers, the
+  // CSVs and the globals nobody uses anymore would reach the object file
+  if (Options.OptimizationLevel < 2) {
+    ScopedTimer PruneTimer("prune");
+    legacy::PassManager PM;
+    PM.add(createGlobalDCEPass());
+    PM.run(M);
+  }
+
+  if (verifyModule(M, &errs())) {
+    errs() << "The translated module is not valid\n";
+    return false;
+  }
+
+  if (not saveTemp(M, Options, "linked"))
+    return false;
+
+  auto TM = createTargetMachine(M, Options.OptimizationLevel);
+  if (TM == nullptr)
+    return false;
+
+  if (Options.OptimizationLevel == 2) {
+    {
+      ScopedTimer OptimizeTimer("optimize");
+      Progress->setPhase("optimize");
+      optimize(M, *TM, not Options.ProfilePath.empty());
+    }
+
+    if (not saveTemp(M, Options, "opt"))
+      return false;
+  }
+
+  ScopedTimer CodeGenTimer("codegen");
+  Progress->setPhase("codegen");
+  if (not emitObject(M, *TM, Options.ObjectPath))
+    return false;
+
+  revng_log(PipelineLog, "Object file written to " << Options.ObjectPath);
+
+  return true;
+}
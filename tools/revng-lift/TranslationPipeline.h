@@ -0,0 +1,67 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+/// \brief Options of the in-process translation pipeline
+struct TranslationOptions {
+  /// Path of the support module to link in the translated program
+  std::string SupportPath;
+
+  /// Path where the object file has to be emitted
+  std::string ObjectPath;
+
+  /// If not empty, save the module as bitcode after each phase, using this
+  /// prefix (e.g., `<SaveTempsPrefix>.isolated.bc`)
+  std::string SaveTempsPrefix;
+
+  /// 0: no optimizations, 1: optimize only in the back end, 2: also optimize
+  /// the IR with -O2
+  unsigned OptimizationLevel = 0;
+
+  /// Detect the function boundaries and isolate the functions
+  bool Isolate = false;
+
+  /// Count the executions of each jump target
+  bool Coverage = false;
+
+  /// The support module is the tracing one, preserve the calls to newpc
+  bool Trace = false;
+
+  /// If not empty, path of a coverage CSV to guide the layout of the code
+  std::string ProfilePath;
+
+  /// At -O2, compute each instruction on the bits actually demanded by its
+  /// users before optimizing
+  bool ShrinkWholeFunctions = false;
+};
+
+/// \brief Write \p M as bitcode to \p Path
+///
+/// Unless \p Path is `-`, the bitcode writer flushes what it encoded so far
+/// to the file once it exceeds -bitcode-flush-threshold, in large blocks,
+/// instead of keeping the whole bitcode in memory up to the end.
+///
+/// \return true in case of success.
+bool writeBitcode(const llvm::Module &M, llvm::StringRef Path);
+
+/// \brief Turn the lifted module into an object file, without leaving the
+///        process
+///
+/// This performs the same steps of `revng translate` from the output of
+/// revng-lift up to the invocation of llc (coverage instrumentation, function
+/// isolation, applying the profile, dropping newpc, linking the support
+/// module, dropping the unused globals, -O2 and code generation), but the
+/// module is never serialized and parsed back in between.
+///
+/// \return true in case of success.
+bool runTranslationPipeline(llvm::Module &M, const TranslationOptions &Options);
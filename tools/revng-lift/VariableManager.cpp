@@ -43,6 +43,13 @@ static cl::alias A1("E",
                     cl::aliasopt(External),
                     cl::cat(MainCategory));
 
+static cl::opt<bool> ThreadLocalCSVs("thread-local-csvs",
+                                     cl::desc("emit the CPU state variables "
+                                              "as thread-local storage (does "
+                                              "not support multithreaded "
+                                              "programs)"),
+                                     cl::cat(MainCategory));
+
 class OffsetValueStack {
 
 private:
@@ -84,7 +91,7 @@ private:
 
 static std::pair<IntegerType *, unsigned>
 getTypeAtOffset(const DataLayout *TheLayout, Type *VarType, intptr_t Offset) {
-  static Logger<> Log("type-at-offset");
+  static VerboseLogger Log("type-at-offset");
 
   unsigned Depth = 0;
   while (1) {
@@ -245,6 +252,17 @@ VariableManager::VariableManager(Module &TheModule,
   }
 }
 
+std::pair<IntegerType *, unsigned>
+VariableManager::getCPUStateTypeAtOffset(intptr_t Offset) {
+  auto It = CPUStateTypeAtOffset.find(Offset);
+  if (It != CPUStateTypeAtOffset.end())
+    return It->second;
+
+  auto Result = getTypeAtOffset(ModuleLayout, CPUStateType, Offset);
+  CPUStateTypeAtOffset[Offset] = Result;
+  return Result;
+}
+
 Optional<StoreInst *>
 VariableManager::storeToCPUStateOffset(IRBuilder<> &Builder,
                                        unsigned StoreSize,
@@ -439,6 +457,21 @@ void VariableManager::finalize() {
       P.second->setLinkage(GlobalValue::InternalLinkage);
   }
 
+  if (ThreadLocalCSVs) {
+    // Note: this only separates the state of the host threads, creating a host
+    //       thread upon clone is up to the runtime, which doesn't do it yet.
+    //       Also, a new thread would need a copy of the parent's CSVs.
+
+    // Internal variables can't be preempted, use the cheapest model
+    auto Model = External ? GlobalValue::InitialExecTLSModel :
+                            GlobalValue::LocalExecTLSModel;
+    for (auto &P : CPUStateGlobals)
+      P.second->setThreadLocalMode(Model);
+    for (auto &P : OtherGlobals)
+      P.second->setThreadLocalMode(Model);
+    Env->setThreadLocalMode(GlobalValue::InitialExecTLSModel);
+  }
+
   IRBuilder<> Builder(Context);
 
   // Create the setRegister function
@@ -503,6 +536,7 @@ void VariableManager::finalize() {
 void VariableManager::newFunction(Instruction *Delimiter,
                                   PTCInstructionList *Instructions) {
   LocalTemporaries.clear();
+  LocalTemporariesPool.reset();
   newBasicBlock(Delimiter, Instructions);
 }
 
@@ -515,6 +549,8 @@ void VariableManager::newFunction(Instruction *Delimiter,
 void VariableManager::newBasicBlock(Instruction *Delimiter,
                                     PTCInstructionList *Instructions) {
   Temporaries.clear();
+  TemporariesPool.reset();
+  KnownValues.clear();
   if (Instructions != nullptr)
     this->Instructions = Instructions;
 
@@ -525,6 +561,8 @@ void VariableManager::newBasicBlock(Instruction *Delimiter,
 void VariableManager::newBasicBlock(BasicBlock *Delimiter,
                                     PTCInstructionList *Instructions) {
   Temporaries.clear();
+  TemporariesPool.reset();
+  KnownValues.clear();
   if (Instructions != nullptr)
     this->Instructions = Instructions;
 
@@ -532,6 +570,18 @@ void VariableManager::newBasicBlock(BasicBlock *Delimiter,
     Builder.SetInsertPoint(Delimiter);
 }
 
+void VariableManager::recordStore(unsigned TemporaryId, Value *V) {
+  revng_assert(Instructions != nullptr);
+
+  if (ptc_temp_is_global(Instructions, TemporaryId))
+    return;
+
+  if (ptc_temp_get(Instructions, TemporaryId)->temp_local)
+    return;
+
+  KnownValues[TemporaryId] = V;
+}
+
 bool VariableManager::isEnv(Value *TheValue) {
   auto *Load = dyn_cast<LoadInst>(TheValue);
   if (Load != nullptr)
@@ -575,8 +625,7 @@ VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
           && it->second->getName().startswith(UnknownCSVPref))) {
     Type *VariableType;
     unsigned Remaining;
-    std::tie(VariableType,
-             Remaining) = getTypeAtOffset(ModuleLayout, CPUStateType, Offset);
+    std::tie(VariableType, Remaining) = getCPUStateTypeAtOffset(Offset);
 
     // Unsupported type, let the caller handle the situation
     if (VariableType == nullptr)
@@ -667,7 +716,13 @@ Value *VariableManager::getOrCreate(unsigned TemporaryId, bool Reading) {
     if (it != LocalTemporaries.end()) {
       return it->second;
     } else {
-      AllocaInst *NewTemporary = Builder.CreateAlloca(VariableType);
+      // A recycled alloca would still hold the value of a previous
+      // translation block: if we're reading before any write, use a fresh one
+      AllocaInst *NewTemporary = nullptr;
+      if (Reading)
+        NewTemporary = Builder.CreateAlloca(VariableType);
+      else
+        NewTemporary = LocalTemporariesPool.get(Builder, VariableType);
       LocalTemporaries[TemporaryId] = NewTemporary;
       return NewTemporary;
     }
@@ -681,7 +736,9 @@ Value *VariableManager::getOrCreate(unsigned TemporaryId, bool Reading) {
       if (Reading)
         return nullptr;
 
-      AllocaInst *NewTemporary = Builder.CreateAlloca(VariableType);
+      // Temporaries do not outlive the basic block, recycle the allocas used
+      // by the previous ones
+      AllocaInst *NewTemporary = TemporariesPool.get(Builder, VariableType);
       Temporaries[TemporaryId] = NewTemporary;
       return NewTemporary;
     }
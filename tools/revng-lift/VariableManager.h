@@ -7,8 +7,11 @@
 #include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
 
 #include "revng/Support/CommandLine.h"
@@ -32,6 +35,35 @@ class VariableManager;
 // TODO: rename
 extern llvm::cl::opt<bool> External;
 
+/// \brief Pool of allocas reused across scopes
+///
+/// Each scope (e.g., a PTC basic block) requests a certain number of allocas
+/// of each type. Instead of creating new ones every time, the allocas handed
+/// out in the previous scopes are recycled. Allocas that have been removed in
+/// the meantime (e.g., promoted by SROA during harvesting) are recreated.
+class AllocaPool {
+private:
+  std::map<llvm::Type *, std::vector<llvm::WeakVH>> Allocas;
+  std::map<llvm::Type *, unsigned> Used;
+
+public:
+  /// \brief Begin a new scope, making all the allocas available again
+  void reset() { Used.clear(); }
+
+  llvm::AllocaInst *get(llvm::IRBuilder<> &Builder, llvm::Type *Ty) {
+    std::vector<llvm::WeakVH> &Available = Allocas[Ty];
+    unsigned &Index = Used[Ty];
+    if (Index == Available.size())
+      Available.emplace_back();
+
+    llvm::WeakVH &Slot = Available[Index++];
+    if (Slot == nullptr)
+      Slot = Builder.CreateAlloca(Ty);
+
+    return llvm::cast<llvm::AllocaInst>(Slot);
+  }
+};
+
 /// \brief Maintain the list of variables required by PTC
 ///
 /// It can be queried for a variable, which, if not already existing, will be
@@ -93,6 +125,22 @@ public:
   void newBasicBlock(llvm::BasicBlock *Delimiter,
                      PTCInstructionList *Instructions = nullptr);
 
+  /// \brief Record that \p V has just been stored in \p TemporaryId
+  ///
+  /// Only basic block-level temporaries are tracked, until the next call to
+  /// `newBasicBlock`.
+  void recordStore(unsigned TemporaryId, llvm::Value *V);
+
+  /// \brief Get the value last stored in \p TemporaryId in the current basic
+  ///        block, if known
+  ///
+  /// This allows the translator to use the value directly instead of emitting
+  /// a load, which in turn enables constant folding at emission time.
+  llvm::Value *getKnownValue(unsigned TemporaryId) const {
+    auto It = KnownValues.find(TemporaryId);
+    return It == KnownValues.end() ? nullptr : It->second;
+  }
+
   /// Returns true if the given variable is the env variable
   bool isEnv(llvm::Value *TheValue);
 
@@ -161,6 +209,16 @@ private:
   std::pair<llvm::GlobalVariable *, unsigned>
   getByCPUStateOffsetInternal(intptr_t Offset, std::string Name = "");
 
+  /// \brief Find the integer type containing \p Offset in CPUStateType, and
+  ///        the offset within it
+  ///
+  /// Results are memoized in a hash table by offset, since the same offsets
+  /// are looked up for every access to the CPU state. Only the offsets
+  /// actually accessed are recorded: the CPU state can contain large arrays
+  /// (e.g., TLBs).
+  std::pair<llvm::IntegerType *, unsigned>
+  getCPUStateTypeAtOffset(intptr_t Offset);
+
 private:
   llvm::Module &TheModule;
   llvm::IRBuilder<> Builder;
@@ -170,9 +228,14 @@ private:
   GlobalsMap OtherGlobals;
   TemporariesMap Temporaries;
   TemporariesMap LocalTemporaries;
+  AllocaPool TemporariesPool;
+  std::map<unsigned, llvm::Value *> KnownValues;
+  AllocaPool LocalTemporariesPool;
   PTCInstructionList *Instructions;
 
   llvm::StructType *CPUStateType;
+  using TypeAtOffset = std::pair<llvm::IntegerType *, unsigned>;
+  llvm::DenseMap<intptr_t, TypeAtOffset> CPUStateTypeAtOffset;
   const llvm::DataLayout *ModuleLayout;
   unsigned EnvOffset;
 
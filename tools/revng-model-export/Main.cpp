@@ -0,0 +1,191 @@
+/// \file Main.cpp
+/// \brief Stream out the functions of the model embedded in a module, one at a
+///        time
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/YAMLParser.h"
+
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/Support/CommandLine.h"
+
+using namespace llvm;
+using namespace llvm::cl;
+
+namespace {
+
+namespace ExportFormat {
+
+enum Values {
+  /// One JSON object per line, per function
+  NDJSON,
+  /// For each function, its size in bytes (ULEB128) followed by its binary
+  /// encoding (see TupleTreeBinary.h)
+  Binary
+};
+
+} // namespace ExportFormat
+
+opt<std::string> InputPath(Positional,
+                           Required,
+                           desc("<input module>"),
+                           cat(MainCategory));
+
+opt<std::string> OutputPath("o",
+                            init("-"),
+                            desc("output file"),
+                            value_desc("filename"),
+                            cat(MainCategory));
+
+opt<ExportFormat::Values> Format("format",
+                                 desc("output format"),
+                                 values(clEnumValN(ExportFormat::NDJSON,
+                                                   "ndjson",
+                                                   "one JSON object per "
+                                                   "line"),
+                                        clEnumValN(ExportFormat::Binary,
+                                                   "binary",
+                                                   "size-prefixed binary "
+                                                   "tuple trees")),
+                                 init(ExportFormat::NDJSON),
+                                 cat(MainCategory));
+
+opt<std::string> FunctionEntry("function",
+                               desc("export only the function with this "
+                                    "entry address"),
+                               value_desc("entry"),
+                               cat(MainCategory));
+
+} // namespace
+
+/// \brief Translate a YAML node, as produced by the model serialization, to
+///        JSON
+///
+/// Scalars are always emitted as strings, the model has no knowledge of which
+/// YAML scalars represent numbers.
+static json::Value toJSON(yaml::Node *Node) {
+  if (auto *Scalar = dyn_cast<yaml::ScalarNode>(Node)) {
+    SmallString<32> Storage;
+    return Scalar->getValue(Storage).str();
+  }
+
+  if (auto *Sequence = dyn_cast<yaml::SequenceNode>(Node)) {
+    json::Array Result;
+    for (yaml::Node &Element : *Sequence)
+      Result.push_back(toJSON(&Element));
+    return Result;
+  }
+
+  if (auto *Mapping = dyn_cast<yaml::MappingNode>(Node)) {
+    json::Object Result;
+    for (yaml::KeyValueNode &Pair : *Mapping) {
+      SmallString<32> Storage;
+      auto *Key = cast<yaml::ScalarNode>(Pair.getKey());
+      Result[Key->getValue(Storage)] = toJSON(Pair.getValue());
+    }
+    return Result;
+  }
+
+  return nullptr;
+}
+
+static void writeNDJSON(raw_ostream &Output, const model::Function &F) {
+  std::string Buffer;
+  {
+    raw_string_ostream Stream(Buffer);
+    yaml::Output YAMLOutput(Stream);
+    YAMLOutput << const_cast<model::Function &>(F);
+  }
+
+  SourceMgr SM;
+  yaml::Stream YAMLStream(Buffer, SM);
+  yaml::document_iterator Document = YAMLStream.begin();
+  revng_assert(Document != YAMLStream.end());
+  Output << toJSON(Document->getRoot()) << "\n";
+}
+
+static void writeBinary(raw_ostream &Output, const model::Function &F) {
+  SmallString<256> Buffer;
+  {
+    raw_svector_ostream Stream(Buffer);
+    tupletree::binary::serialize(Stream, F);
+  }
+
+  encodeULEB128(Buffer.size(), Output);
+  Output << Buffer;
+}
+
+int main(int argc, const char *argv[]) {
+  HideUnrelatedOptions({ &MainCategory });
+  ParseCommandLineOptions(argc, argv);
+
+  // Load the module lazily: we're only interested in the named metadata, not
+  // in the function bodies
+  LLVMContext Context;
+  SMDiagnostic Error;
+  std::unique_ptr<Module> M = getLazyIRFileModule(InputPath, Error, Context);
+  if (not M) {
+    Error.print(argv[0], errs());
+    return EXIT_FAILURE;
+  }
+
+  if (M->getNamedMetadata(ModelMetadataName) == nullptr) {
+    errs() << argv[0] << ": " << InputPath << " has no model\n";
+    return EXIT_FAILURE;
+  }
+
+  std::error_code EC;
+  ToolOutputFile Output(OutputPath, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << argv[0] << ": " << OutputPath << ": " << EC.message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  auto Write = [&Output](const model::Function &F) {
+    switch (Format) {
+    case ExportFormat::NDJSON:
+      writeNDJSON(Output.os(), F);
+      break;
+    case ExportFormat::Binary:
+      writeBinary(Output.os(), F);
+      break;
+    }
+  };
+
+  if (FunctionEntry.getNumOccurrences() > 0) {
+    MetaAddress Entry = MetaAddress::fromString(FunctionEntry);
+    if (Entry.isInvalid()) {
+      errs() << argv[0] << ": invalid entry address " << FunctionEntry << "\n";
+      return EXIT_FAILURE;
+    }
+
+    auto F = LoadModelPass::getFunction(*M, Entry);
+    if (not F) {
+      errs() << argv[0] << ": no function at " << FunctionEntry << "\n";
+      return EXIT_FAILURE;
+    }
+
+    Write(*F);
+  } else {
+    LoadModelPass::forEachFunction(*M, Write);
+  }
+
+  Output.keep();
+
+  return EXIT_SUCCESS;
+}